@@ -0,0 +1,61 @@
+#version 330 core
+// Gaussian beam envelope: one instance per beam, expanded into a camera-facing triangle
+// strip from gl_VertexID. Vertex 2i / 2i+1 are the upper / lower edge at sample i.
+layout (location = 0) in vec4 aStartWaist;   // start (mm), waist radius w0 (mm)
+layout (location = 1) in vec4 aEndRange;     // end (mm), Rayleigh range zR (mm)
+layout (location = 2) in vec4 aColor;
+layout (location = 3) in vec4 aWaistSamples; // waist distance from start (mm), sample count,
+                                             // 1 if propagation cuts this beam
+
+// Per-frame camera and shading state (std140, see FrameUniforms in viewport.h)
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+uniform vec3 uCameraUp;
+uniform float uPropagation = -1.0;   // beam propagation: path drawn so far in mm (< 0 = off)
+
+out vec3 FragPos;
+out vec3 Normal;
+flat out vec4 InstanceColor;
+flat out uint InstanceObjectId;   // envelopes are not pickable
+
+void main() {
+    vec3 start = aStartWaist.xyz;
+    vec3 axis = aEndRange.xyz - start;
+    float len = length(axis);
+    vec3 dir = axis / len;
+    float w0 = aStartWaist.w;
+    float zR = aEndRange.w;
+    float waistZ = aWaistSamples.x;
+    int samples = int(aWaistSamples.y);
+
+    // Samples are spaced evenly in u where z = zR sinh(u), so w(z) = w0 cosh(u) exactly
+    // and they crowd around the waist, where the envelope bends
+    int i = min(gl_VertexID / 2, samples - 1);
+    float u0 = asinh(-waistZ / zR);
+    float u1 = asinh((len - waistZ) / zR);
+    float u = mix(u0, u1, float(i) / float(samples - 1));
+    // Propagation animation: samples past the light's front collapse onto it
+    float reach = (uPropagation >= 0.0 && aWaistSamples.z > 0.0) ? min(uPropagation, len) : len;
+    float z = clamp(waistZ + zR * sinh(u), 0.0, reach);
+    float w = w0 * cosh(u);
+
+    // Billboard: widen perpendicular to the beam, facing the camera
+    vec3 toCamera = uViewPos - (start + aEndRange.xyz) * 0.5;
+    vec3 crossVec = cross(dir, toCamera);
+    if (dot(crossVec, crossVec) < 1e-12) crossVec = cross(dir, uCameraUp);
+    vec3 perp = normalize(crossVec);
+    float side = (gl_VertexID % 2 == 0) ? 1.0 : -1.0;
+
+    FragPos = start + dir * z + perp * (w * side);
+    Normal = normalize(toCamera);
+    InstanceColor = aColor;
+    InstanceObjectId = 0u;
+    gl_Position = uProjection * uView * vec4(FragPos, 1.0);
+}
@@ -1,19 +1,35 @@
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;   // picking id buffer, written only when bound
 
 in vec3 FragPos;
 in vec3 Normal;
 
+#ifdef INSTANCED
+flat in vec4 InstanceColor;
+flat in uint InstanceObjectId;
+#define uColor InstanceColor.rgb
+#define uAlpha InstanceColor.a
+#define uObjectId InstanceObjectId
+#else
 uniform vec3 uColor;
 uniform float uAlpha;
-uniform vec3 uLightPos;
-uniform vec3 uViewPos;
-uniform float uAmbientStrength = 0.14;
-uniform float uSpecularStrength = 0.55;
-uniform float uShininess = 48.0;
+uniform uint uObjectId = 0u;
+#endif
+// Per-frame camera and shading state (std140, see FrameUniforms in viewport.h)
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
 uniform float uEmissive = 0.0;
 
 void main() {
+    ObjectId = uObjectId;
     // Emissive path: bypass lighting and tonemapping (for beams, focal points, etc.)
     if (uEmissive > 0.5) {
         FragColor = vec4(uColor, uAlpha);
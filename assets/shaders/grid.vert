@@ -3,15 +3,44 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
 uniform mat4 uModel = mat4(1.0);
-uniform mat4 uView;
-uniform mat4 uProjection;
 uniform mat3 uNormalMatrix;
 
+// Per-frame camera and shading state (std140, see FrameUniforms in viewport.h)
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+
 out vec3 FragPos;
 out vec3 Normal;
 
+#ifdef INSTANCED
+// Per-instance attributes (divisor 1) replace the transform/material uniforms
+layout (location = 2) in mat4 aInstanceModel;         // locations 2-5
+layout (location = 6) in mat3 aInstanceNormalMatrix;  // locations 6-8
+layout (location = 9) in vec4 aInstanceColor;         // rgb + alpha
+layout (location = 10) in vec3 aInstanceMaterial;     // metallic, roughness, fresnel IOR
+layout (location = 11) in uint aInstanceObjectId;     // picking id (0 = none)
+flat out vec4 InstanceColor;
+flat out vec3 InstanceMaterial;
+flat out uint InstanceObjectId;
+#endif
+
 void main() {
+#ifdef INSTANCED
+    FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    Normal = aInstanceNormalMatrix * aNormal;
+    InstanceColor = aInstanceColor;
+    InstanceMaterial = aInstanceMaterial;
+    InstanceObjectId = aInstanceObjectId;
+#else
     FragPos = vec3(uModel * vec4(aPos, 1.0));
     Normal = uNormalMatrix * aNormal;
+#endif
     gl_Position = uProjection * uView * vec4(FragPos, 1.0);
 }
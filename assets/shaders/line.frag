@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;   // picking id buffer, written only when bound
+
+in vec4 Color;
+flat in uint LineObjectId;
+noperspective in float EdgeDistance;
+noperspective in float HalfWidth;
+
+// Screen-space lines (beams, markers, wireframes): per-vertex color, no lighting.
+// uColorScale boosts HDR output for Presentation mode bloom.
+uniform float uColorScale = 1.0;
+
+void main() {
+    // Coverage of this pixel from its distance to the line's center
+    float coverage = clamp(HalfWidth + 0.5 - abs(EdgeDistance), 0.0, 1.0);
+    if (coverage <= 0.0) discard;
+    ObjectId = LineObjectId;
+    FragColor = vec4(Color.rgb * uColorScale, Color.a * coverage);
+}
@@ -0,0 +1,84 @@
+#version 330 core
+// One instance per segment: both endpoints arrive as per-instance attributes, and the
+// four vertices of a triangle strip (gl_VertexID 0-3) place the corners of a quad
+// expanded in screen space. The buffer keeps the GL_LINES layout (vertex pairs).
+layout (location = 0) in vec3 aPosA;
+layout (location = 1) in vec4 aColorA;
+layout (location = 2) in float aWidthA;    // pixels
+layout (location = 3) in uint aObjectId;   // picking id (0 = none)
+layout (location = 4) in vec3 aPosB;
+layout (location = 5) in vec4 aColorB;
+layout (location = 6) in float aWidthB;
+layout (location = 7) in float aPathA;     // mm of optical path at each end (< 0 = not animated)
+layout (location = 8) in float aPathB;
+
+// Per-frame camera and shading state (std140, see FrameUniforms in viewport.h)
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+
+uniform vec2 uViewportSize;
+uniform float uPropagation = -1.0;   // beam propagation: path drawn so far in mm (< 0 = off)
+
+out vec4 Color;
+flat out uint LineObjectId;
+noperspective out float EdgeDistance;   // pixels from the line's center
+noperspective out float HalfWidth;
+
+// Corners 0/1 lie at A, 2/3 at B; even corners on the left of A->B. Quads come out
+// counter-clockwise on screen whichever way the segment points.
+vec4 expandLine(vec4 clipA, vec4 clipB, float width) {
+    // Clip to the near plane first, so an endpoint behind the camera does not flip over
+    float dA = clipA.z + clipA.w;
+    float dB = clipB.z + clipB.w;
+    if (dA < 0.0 && dB < 0.0) return vec4(0.0, 0.0, 2.0, 1.0);
+    if (dA < 0.0) clipA = mix(clipA, clipB, dA / (dA - dB));
+    if (dB < 0.0) clipB = mix(clipB, clipA, dB / (dB - dA));
+
+    int corner = gl_VertexID & 3;
+    bool atB = corner >= 2;
+    float side = (corner & 1) == 0 ? -1.0 : 1.0;
+
+    vec2 halfSize = 0.5 * uViewportSize;
+    vec2 dir = clipB.xy / clipB.w * halfSize - clipA.xy / clipA.w * halfSize;
+    float len = length(dir);
+    dir = len > 1e-4 ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(dir.y, -dir.x);
+
+    // One pixel of margin for the anti-aliased edge. The ends are pushed out as well,
+    // so the segments of a traced path overlap at their joints.
+    HalfWidth = max(width, 1.0) * 0.5;
+    float extent = HalfWidth + 1.0;
+    EdgeDistance = side * extent;
+    vec2 offset = normal * side * extent + dir * (atB ? extent : -extent);
+    vec4 clip = atB ? clipB : clipA;
+    return vec4(clip.xy + offset / halfSize * clip.w, clip.zw);
+}
+
+void main() {
+    // Propagation animation: a segment the light has not reached is dropped, one it is
+    // crossing ends where the light has got to
+    vec3 posB = aPosB;
+    if (uPropagation >= 0.0 && aPathA >= 0.0) {
+        if (aPathA >= uPropagation) {
+            gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+            return;
+        }
+        if (aPathB > uPropagation) posB = mix(aPosA, aPosB, (uPropagation - aPathA) / (aPathB - aPathA));
+    }
+
+    mat4 viewProjection = uProjection * uView;
+    bool atB = (gl_VertexID & 3) >= 2;
+    float width = atB ? aWidthB : aWidthA;
+    gl_Position = expandLine(viewProjection * vec4(aPosA, 1.0), viewProjection * vec4(posB, 1.0), width);
+    // Lines under a pixel wide are drawn one pixel wide and faded instead
+    Color = atB ? aColorB : aColorA;
+    Color.a *= clamp(width, 0.0, 1.0);
+    LineObjectId = aObjectId;
+}
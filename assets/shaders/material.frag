@@ -1,31 +1,63 @@
 #version 330 core
-out vec4 FragColor;
+#ifdef OIT
+// Weighted blended transparency (see Viewport::renderScene): both targets accumulate
+// unsorted and oit_composite.frag resolves them over the opaque scene
+layout (location = 0) out vec4 Accum;        // rgb: weighted premultiplied color, a: revealage
+layout (location = 1) out uint ObjectId;     // picking id buffer, written only when bound
+layout (location = 2) out vec4 AccumWeight;  // r: weighted coverage
+uniform float uOitDepthScale = 100.0;        // view distance that gets weight 10
+#else
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;   // picking id buffer, written only when bound
+#endif
 in vec3 FragPos;
 in vec3 Normal;
 
+#ifdef INSTANCED
+flat in vec4 InstanceColor;
+flat in uint InstanceObjectId;
+flat in vec3 InstanceMaterial;
+#define uColor InstanceColor.rgb
+#define uAlpha InstanceColor.a
+#define uObjectId InstanceObjectId
+#else
 uniform vec3 uColor;
 uniform float uAlpha;
-uniform vec3 uLightPos;
-uniform vec3 uViewPos;
-uniform float uAmbientStrength = 0.14;
-uniform float uSpecularStrength = 0.55;
-uniform float uShininess = 48.0;
+uniform uint uObjectId = 0u;
+#endif
+// Per-frame camera and shading state (std140, see FrameUniforms in viewport.h)
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
 
 // Material uniforms
+#ifdef INSTANCED
+#define uMetallic InstanceMaterial.x
+#define uRoughness InstanceMaterial.y
+#define uFresnelIOR InstanceMaterial.z
+#else
 uniform float uMetallic = 0.0;
 uniform float uRoughness = 0.5;
-uniform float uTransparency = 0.0;
 uniform float uFresnelIOR = 1.5;
+#endif
+uniform float uTransparency = 0.0;
 
 // HDRI environment map (equirectangular)
 uniform sampler2D uEnvMap;
 uniform bool uHasEnvMap = false;
 uniform float uEnvIntensity = 1.0;
 uniform float uEnvRotation = 0.0; // radians
+uniform float uEnvMaxLod = 0.0;   // blurriest prefiltered level
 
 const float PI = 3.14159265359;
 
-vec3 sampleEquirectangular(vec3 dir, float rotation) {
+vec3 sampleEquirectangular(vec3 dir, float rotation, float lod) {
     // Rotate direction around Y axis
     float cosR = cos(rotation);
     float sinR = sin(rotation);
@@ -33,10 +65,12 @@ vec3 sampleEquirectangular(vec3 dir, float rotation) {
     // Convert direction to equirectangular UV
     float u = atan(rd.z, rd.x) / (2.0 * PI) + 0.5;
     float v = asin(clamp(rd.y, -1.0, 1.0)) / PI + 0.5;
-    return texture(uEnvMap, vec2(u, v)).rgb;
+    // Explicit LOD: derivatives jump across the u seam
+    return textureLod(uEnvMap, vec2(u, v), lod).rgb;
 }
 
 void main() {
+    ObjectId = uObjectId;
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(uViewPos - FragPos);
     vec3 lightDir = normalize(uLightPos - FragPos);
@@ -78,9 +112,9 @@ void main() {
     // HDRI environment reflections
     if (uHasEnvMap) {
         vec3 reflectDir = reflect(-viewDir, norm);
-        vec3 envColor = sampleEquirectangular(reflectDir, uEnvRotation);
-        // Roughness attenuates reflection sharpness (approximation without prefiltered mips)
-        float envStrength = 1.0 - uRoughness * 0.85;
+        // Rougher surfaces read blurrier prefiltered levels
+        vec3 envColor = sampleEquirectangular(reflectDir, uEnvRotation, uRoughness * uEnvMaxLod);
+        float envStrength = 1.0 - uRoughness * 0.5;
         // Metallic surfaces reflect their base color; dielectrics reflect white
         vec3 envTint = mix(vec3(1.0), uColor, uMetallic);
         result += envColor * envTint * envStrength * fresnel * uEnvIntensity;
@@ -97,5 +131,14 @@ void main() {
     // Alpha: transparency reduces alpha, Fresnel increases it at edges
     float alpha = uAlpha * (1.0 - uTransparency * (1.0 - fresnel * 0.5));
 
+#ifdef OIT
+    // Nearer surfaces dominate where several overlap (McGuire & Bavoil's depth weight,
+    // measured relative to the camera's orbit distance so it holds at any scene scale)
+    float depth = length(uViewPos - FragPos) / uOitDepthScale;
+    float weight = clamp(10.0 / (1e-5 + pow(depth, 4.0)), 1e-2, 3e3);
+    Accum = vec4(result * alpha * weight, alpha);
+    AccumWeight = vec4(alpha * weight);
+#else
     FragColor = vec4(result, alpha);
+#endif
 }
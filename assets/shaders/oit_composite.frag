@@ -0,0 +1,17 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+
+// Weighted blended transparency resolve: the average of the accumulated colors, blended
+// over the opaque scene by the coverage left (1 - revealage)
+uniform sampler2D uAccum;    // rgb: weighted premultiplied color, a: revealage
+uniform sampler2D uWeight;   // r: weighted coverage
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(uAccum, texel, 0);
+    float revealage = accum.a;
+    if (revealage >= 0.999) discard;
+    float weight = max(texelFetch(uWeight, texel, 0).r, 1e-5);
+    FragColor = vec4(accum.rgb / weight, 1.0 - revealage);
+}
@@ -0,0 +1,86 @@
+#version 330 core
+// Wireframe edges as screen-space quads (see line.vert). Each edge is stored as four
+// vertices, corners 0-3 in a row, each holding its own end and the other one; index
+// buffers draw them as two triangles.
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aOtherPos;
+
+uniform mat4 uModel = mat4(1.0);
+uniform float uLineWidth = 1.0;   // pixels
+uniform vec2 uViewportSize;
+
+// Per-frame camera and shading state (std140, see FrameUniforms in viewport.h)
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+
+#ifdef INSTANCED
+// Same per-instance stream as grid.vert; the normal matrix and material go unused
+layout (location = 2) in mat4 aInstanceModel;         // locations 2-5
+layout (location = 9) in vec4 aInstanceColor;         // rgb + alpha
+layout (location = 11) in uint aInstanceObjectId;     // picking id (0 = none)
+#else
+uniform vec3 uColor;
+uniform float uAlpha = 1.0;
+uniform uint uObjectId = 0u;
+#endif
+
+out vec4 Color;
+flat out uint LineObjectId;
+noperspective out float EdgeDistance;   // pixels from the line's center
+noperspective out float HalfWidth;
+
+// Corners 0/1 lie at A, 2/3 at B; even corners on the left of A->B. Quads come out
+// counter-clockwise on screen whichever way the segment points.
+vec4 expandLine(vec4 clipA, vec4 clipB, float width) {
+    // Clip to the near plane first, so an endpoint behind the camera does not flip over
+    float dA = clipA.z + clipA.w;
+    float dB = clipB.z + clipB.w;
+    if (dA < 0.0 && dB < 0.0) return vec4(0.0, 0.0, 2.0, 1.0);
+    if (dA < 0.0) clipA = mix(clipA, clipB, dA / (dA - dB));
+    if (dB < 0.0) clipB = mix(clipB, clipA, dB / (dB - dA));
+
+    int corner = gl_VertexID & 3;
+    bool atB = corner >= 2;
+    float side = (corner & 1) == 0 ? -1.0 : 1.0;
+
+    vec2 halfSize = 0.5 * uViewportSize;
+    vec2 dir = clipB.xy / clipB.w * halfSize - clipA.xy / clipA.w * halfSize;
+    float len = length(dir);
+    dir = len > 1e-4 ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(dir.y, -dir.x);
+
+    // One pixel of margin for the anti-aliased edge; the ends are pushed out as well,
+    // so edges meeting at a corner overlap instead of leaving a notch
+    HalfWidth = max(width, 1.0) * 0.5;
+    float extent = HalfWidth + 1.0;
+    EdgeDistance = side * extent;
+    vec2 offset = normal * side * extent + dir * (atB ? extent : -extent);
+    vec4 clip = atB ? clipB : clipA;
+    return vec4(clip.xy + offset / halfSize * clip.w, clip.zw);
+}
+
+void main() {
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+    Color = aInstanceColor;
+    LineObjectId = aInstanceObjectId;
+#else
+    mat4 model = uModel;
+    Color = vec4(uColor, uAlpha);
+    LineObjectId = uObjectId;
+#endif
+    Color.a *= clamp(uLineWidth, 0.0, 1.0);
+    bool atB = (gl_VertexID & 3) >= 2;
+    vec3 posA = atB ? aOtherPos : aPos;
+    vec3 posB = atB ? aPos : aOtherPos;
+    mat4 modelViewProjection = uProjection * uView * model;
+    gl_Position = expandLine(modelViewProjection * vec4(posA, 1.0), modelViewProjection * vec4(posB, 1.0),
+                             uLineWidth);
+}
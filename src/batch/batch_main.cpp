@@ -0,0 +1,425 @@
+// OpticSketchBatch: renders and exports projects without the editor UI, for CI and
+// documentation pipelines. SVG and TikZ need no GL context; raster, PDF and animation
+// exports render through an offscreen framebuffer in a hidden GLFW window, so on a
+// display-less machine run them under a virtual display (e.g. xvfb-run).
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "render/viewport.h"
+#include "render/beam.h"
+#include "scene/scene.h"
+#include "style/scene_style.h"
+#include "project/project.h"
+#include "optics/ray_tracer.h"
+#include "export/export_svg.h"
+#include "export/export_pdf.h"
+#include "export/export_tikz.h"
+#include "export/export_animation.h"
+#include "jobs/job_system.h"
+#include "optics/parameter_sweep.h"
+#include "optics/tolerance_analysis.h"
+
+namespace fs = std::filesystem;
+
+struct BatchOptions {
+    std::vector<std::string> projects;
+    std::vector<std::string> forwarded;    // options passed unchanged to child processes
+    std::string outDir;                    // empty = next to each project
+    bool png = false, jpg = false, pdf = false, svg = false, tikz = false, vectorPdf = false;
+    std::string anim;                      // "gif", "mp4", "png" (frame folder) or empty
+    int frames = 120;
+    int fps = 30;
+    int width = 1920;
+    int height = 1080;
+    bool trace = false;
+    std::string view;                      // saved view preset or camera preset; empty = frame all
+    int jobs = 1;
+    std::vector<opticsketch::SweepAxis> sweep;  // parameter grid traced headlessly into a CSV
+    std::string detector;                  // sweep/tolerance detector id; empty = every detector
+    std::vector<opticsketch::ToleranceSpec> tolerances;  // Monte Carlo perturbations
+    int samples = 1000;
+    unsigned long long seed = 1;
+};
+
+static void printUsage() {
+    std::cout <<
+        "Usage: OpticSketchBatch [options] <project.optsk|project.optskb>...\n"
+        "  --png --jpg --pdf        raster exports (GL)\n"
+        "  --svg --tikz             vector exports (no GL)\n"
+        "  --vpdf                   vector PDF as <project>_vector.pdf (no GL)\n"
+        "  --anim gif|mp4|png       turntable animation (GL)\n"
+        "  --frames N  --fps N      animation length and rate (120, 30)\n"
+        "  --size WxH               render size (1920x1080)\n"
+        "  --view NAME              saved view preset, or top/front/side/isometric\n"
+        "  --trace                  run the ray tracer before exporting\n"
+        "  --sweep ID:PARAM:A:B:N   trace N values of PARAM (posX posY posZ rotY focalLength)\n"
+        "                           of element ID from A to B into <project>_sweep.csv;\n"
+        "                           repeat for a grid over several parameters (no GL)\n"
+        "  --tolerance ID:PARAM:uniform|gauss:AMOUNT\n"
+        "                           perturb PARAM (posX posY posZ tiltX tiltY tiltZ focalLength\n"
+        "                           ior reflectivity transmissivity) of element ID; all\n"
+        "                           perturbations are sampled together into\n"
+        "                           <project>_tolerance.csv (no GL)\n"
+        "  --samples N  --seed N    Monte Carlo sample count and seed (1000, 1)\n"
+        "  --detector ID            detector measured by --sweep/--tolerance (default: all)\n"
+        "  --out DIR                output folder (default: next to each project)\n"
+        "  --jobs N                 process N projects at once in separate processes\n";
+}
+
+// "ID:PARAM:START:END:STEPS"; the id may itself contain ':'
+static bool parseSweepAxis(const std::string& text, std::vector<opticsketch::SweepAxis>& axes) {
+    std::vector<std::string> parts;
+    size_t end = text.size();
+    for (int i = 0; i < 4; i++) {
+        size_t colon = text.rfind(':', end - 1);
+        if (colon == std::string::npos || colon == 0) return false;
+        parts.insert(parts.begin(), text.substr(colon + 1, end - colon - 1));
+        end = colon;
+    }
+    opticsketch::SweepAxis axis;
+    axis.elementId = text.substr(0, end);
+    if (!opticsketch::parseSweepParameter(parts[0], axis.parameter)) return false;
+    axis.start = static_cast<float>(std::atof(parts[1].c_str()));
+    axis.end = static_cast<float>(std::atof(parts[2].c_str()));
+    axis.steps = std::atoi(parts[3].c_str());
+    if (axis.steps < 1) return false;
+    axes.push_back(axis);
+    return true;
+}
+
+// "ID:PARAM:uniform|gauss:AMOUNT"; the id may itself contain ':'
+static bool parseToleranceSpec(const std::string& text, std::vector<opticsketch::ToleranceSpec>& specs) {
+    std::vector<std::string> parts;
+    size_t end = text.size();
+    for (int i = 0; i < 3; i++) {
+        size_t colon = text.rfind(':', end - 1);
+        if (colon == std::string::npos || colon == 0) return false;
+        parts.insert(parts.begin(), text.substr(colon + 1, end - colon - 1));
+        end = colon;
+    }
+    opticsketch::ToleranceSpec spec;
+    spec.elementId = text.substr(0, end);
+    if (!opticsketch::parseToleranceParameter(parts[0], spec.parameter)) return false;
+    if (parts[1] == "uniform") spec.distribution = opticsketch::ToleranceDistribution::Uniform;
+    else if (parts[1] == "gauss") spec.distribution = opticsketch::ToleranceDistribution::Gaussian;
+    else return false;
+    spec.amount = static_cast<float>(std::atof(parts[2].c_str()));
+    specs.push_back(spec);
+    return true;
+}
+
+static bool parseArgs(int argc, char** argv, BatchOptions& opts) {
+    for (int i = 1; i < argc; i++) {
+        int first = i;
+        std::string arg = argv[i];
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) return false;
+            out = argv[++i];
+            return true;
+        };
+        std::string v;
+        if (arg == "--png") opts.png = true;
+        else if (arg == "--jpg") opts.jpg = true;
+        else if (arg == "--pdf") opts.pdf = true;
+        else if (arg == "--svg") opts.svg = true;
+        else if (arg == "--tikz") opts.tikz = true;
+        else if (arg == "--vpdf") opts.vectorPdf = true;
+        else if (arg == "--trace") opts.trace = true;
+        else if (arg == "--anim") {
+            if (!value(opts.anim) || (opts.anim != "gif" && opts.anim != "mp4" && opts.anim != "png")) return false;
+        } else if (arg == "--frames") {
+            if (!value(v)) return false;
+            opts.frames = std::max(1, std::atoi(v.c_str()));
+        } else if (arg == "--fps") {
+            if (!value(v)) return false;
+            opts.fps = std::max(1, std::atoi(v.c_str()));
+        } else if (arg == "--size") {
+            if (!value(v) || std::sscanf(v.c_str(), "%dx%d", &opts.width, &opts.height) != 2 ||
+                opts.width <= 0 || opts.height <= 0) return false;
+        } else if (arg == "--sweep") {
+            if (!value(v) || !parseSweepAxis(v, opts.sweep)) return false;
+        } else if (arg == "--tolerance") {
+            if (!value(v) || !parseToleranceSpec(v, opts.tolerances)) return false;
+        } else if (arg == "--samples") {
+            if (!value(v)) return false;
+            opts.samples = std::max(1, std::atoi(v.c_str()));
+        } else if (arg == "--seed") {
+            if (!value(v)) return false;
+            opts.seed = std::strtoull(v.c_str(), nullptr, 10);
+        } else if (arg == "--detector") {
+            if (!value(opts.detector)) return false;
+        } else if (arg == "--view") {
+            if (!value(opts.view)) return false;
+        } else if (arg == "--out") {
+            if (!value(opts.outDir)) return false;
+        } else if (arg == "--jobs") {
+            if (!value(v)) return false;
+            opts.jobs = std::max(1, std::atoi(v.c_str()));
+            continue;   // not forwarded: children handle one project each
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return false;
+        } else {
+            opts.projects.push_back(arg);
+            continue;
+        }
+        // Re-emit the option (and its value) for child processes
+        for (int k = first; k <= i; k++) opts.forwarded.push_back(argv[k]);
+    }
+    return !opts.projects.empty();
+}
+
+static bool needsGL(const BatchOptions& opts) {
+    return opts.png || opts.jpg || opts.pdf || !opts.anim.empty();
+}
+
+static std::string quoteArg(const std::string& arg) {
+    return "\"" + arg + "\"";
+}
+
+// Frame every visible element, beam and traced ray (same as View > Frame All)
+static void frameScene(opticsketch::Camera& camera, opticsketch::Scene& scene) {
+    glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+    bool hasObjects = false;
+    for (const auto& elem : scene.getElements()) {
+        if (!elem->visible) continue;
+        glm::vec3 wMin, wMax;
+        elem->getWorldBounds(wMin, wMax);
+        sceneMin = glm::min(sceneMin, wMin);
+        sceneMax = glm::max(sceneMax, wMax);
+        hasObjects = true;
+    }
+    for (const auto& beam : scene.getBeams()) {
+        if (!beam->visible) continue;
+        sceneMin = glm::min(sceneMin, glm::min(beam->start, beam->end));
+        sceneMax = glm::max(sceneMax, glm::max(beam->start, beam->end));
+        hasObjects = true;
+    }
+    const opticsketch::TracedRayBuffer& traced = scene.getTracedRays();
+    for (size_t i = 0; i < traced.size(); i++) {
+        sceneMin = glm::min(sceneMin, glm::min(traced.start[i], traced.end[i]));
+        sceneMax = glm::max(sceneMax, glm::max(traced.start[i], traced.end[i]));
+        hasObjects = true;
+    }
+    if (hasObjects) camera.frameOn((sceneMin + sceneMax) * 0.5f, glm::length(sceneMax - sceneMin) * 0.5f);
+    else camera.resetView();
+}
+
+static void applyView(opticsketch::Camera& camera, opticsketch::Scene& scene, const std::string& view) {
+    frameScene(camera, scene);
+    if (view.empty()) return;
+    for (const auto& preset : scene.getViewPresets()) {
+        if (preset.name == view) {
+            camera.applyPreset(preset);
+            return;
+        }
+    }
+    camera.setPreset(view);
+}
+
+// Hidden window whose context drives the viewport's offscreen framebuffer
+static GLFWwindow* createOffscreenContext() {
+    if (!glfwInit()) {
+        std::cerr << "No GL context available (glfwInit failed); raster exports need a display\n";
+        return nullptr;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    #ifdef PLATFORM_LINUX
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    #endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "OpticSketchBatch", nullptr, nullptr);
+    if (!window) {
+        std::cerr << "Could not create an offscreen GL context\n";
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cerr << "Could not load OpenGL functions\n";
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+static bool exportAnimation(const BatchOptions& opts, const std::string& base, opticsketch::Viewport& viewport,
+                     opticsketch::Scene& scene, opticsketch::SceneStyle& style) {
+    opticsketch::AnimationExportSettings settings;
+    settings.type = opticsketch::AnimationType::Turntable;
+    settings.frameCount = opts.frames;
+    settings.fps = opts.fps;
+    settings.width = opts.width;
+    settings.height = opts.height;
+    if (opts.anim == "gif") {
+        settings.format = opticsketch::AnimationOutputFormat::GIF;
+        settings.outputPath = base + ".gif";
+    } else if (opts.anim == "mp4") {
+        settings.format = opticsketch::AnimationOutputFormat::MP4;
+        settings.outputPath = base + ".mp4";
+    } else {
+        settings.format = opticsketch::AnimationOutputFormat::ImageSequence;
+        settings.outputPath = base + "_frames";
+    }
+    if (settings.format != opticsketch::AnimationOutputFormat::ImageSequence && !opticsketch::isFFmpegAvailable()) {
+        std::cerr << "ffmpeg not found, cannot write " << settings.outputPath << "\n";
+        return false;
+    }
+    opticsketch::AnimationExportState state;
+    opticsketch::beginAnimationExport(state, settings, &viewport, &scene);
+    while (opticsketch::advanceAnimationFrame(state, settings, &viewport, &scene, &style)) {}
+    opticsketch::endAnimationExport(state, settings, &viewport);
+    // Assembly from temporary frames finishes on a job; its continuation sets the status
+    opticsketch::JobSystem::instance().wait(state.assembleJob);
+    opticsketch::JobSystem::instance().pumpMainThread();
+    std::cout << settings.outputPath << ": " << state.statusText << "\n";
+    return state.statusText == "Export complete";
+}
+
+// Load one project and write every requested export; returns true if all succeeded
+static bool processProject(const std::string& projectPath, const BatchOptions& opts, opticsketch::Viewport* viewport) {
+    opticsketch::Scene scene;
+    opticsketch::SceneStyle style;
+    if (!opticsketch::loadProject(projectPath, &scene, &style)) {
+        std::cerr << "Could not open project: " << projectPath << "\n";
+        return false;
+    }
+    if (opts.trace) {
+        opticsketch::RayTracer tracer;
+        tracer.traceScene(&scene);
+    }
+
+    fs::path project(projectPath);
+    fs::path dir = opts.outDir.empty() ? project.parent_path() : fs::path(opts.outDir);
+    std::error_code ec;
+    if (!dir.empty()) fs::create_directories(dir, ec);
+    std::string base = (dir / project.stem()).string();
+
+    bool ok = true;
+    auto report = [&](bool success, const std::string& path) {
+        if (success) std::cout << "Wrote " << path << "\n";
+        else std::cerr << "Failed to write " << path << "\n";
+        ok = ok && success;
+    };
+    if (opts.svg) report(opticsketch::exportSvg(base + ".svg", &scene, &style), base + ".svg");
+    if (opts.tikz) report(opticsketch::exportTikz(base + ".tex", &scene, &style), base + ".tex");
+    if (opts.vectorPdf)
+        report(opticsketch::exportPdf(base + "_vector.pdf", &scene, &style), base + "_vector.pdf");
+    if (!opts.sweep.empty()) {
+        opticsketch::SweepSettings sweep;
+        sweep.axes = opts.sweep;
+        sweep.detectorId = opts.detector;
+        opticsketch::SweepResult result;
+        bool swept = opticsketch::runParameterSweep(&scene, sweep, result);
+        report(swept && opticsketch::exportSweepCsv(base + "_sweep.csv", result), base + "_sweep.csv");
+    }
+    if (!opts.tolerances.empty()) {
+        opticsketch::ToleranceSettings tolerance;
+        tolerance.specs = opts.tolerances;
+        tolerance.samples = opts.samples;
+        tolerance.seed = opts.seed;
+        tolerance.detectorId = opts.detector;
+        opticsketch::ToleranceResult result;
+        bool ran = opticsketch::runToleranceAnalysis(&scene, tolerance, result);
+        for (const auto& d : result.detectors) {
+            std::printf("%s: throughput %.4f nominal, %.4f +/- %.4f (min %.4f), centroid drift "
+                        "mean %.4f rms %.4f p95 %.4f max %.4f mm, %d/%d samples missed\n",
+                        d.label.c_str(), d.nominalThroughput, d.meanThroughput, d.stdThroughput,
+                        d.minThroughput, d.meanDrift, d.rmsDrift, d.p95Drift, d.maxDrift,
+                        d.missedSamples, result.samples);
+        }
+        report(ran && opticsketch::exportToleranceCsv(base + "_tolerance.csv", result), base + "_tolerance.csv");
+    }
+
+    if (needsGL(opts)) {
+        if (!viewport) return false;
+        applyView(viewport->getCamera(), scene, opts.view);
+        // PNG and PDF are rendered in tiles, so --size is not limited by the GPU
+        if (opts.png) report(viewport->exportTiled(base + ".png", &scene, opts.width, opts.height), base + ".png");
+        if (opts.pdf) report(viewport->exportTiled(base + ".pdf", &scene, opts.width, opts.height), base + ".pdf");
+        viewport->resize(opts.width, opts.height);
+        if (opts.jpg) report(viewport->exportToJpg(base + ".jpg", &scene), base + ".jpg");
+        if (!opts.anim.empty()) ok = exportAnimation(opts, base, *viewport, scene, style) && ok;
+    }
+    return ok;
+}
+
+// Each project in its own child process, at most 'jobs' running at once
+static int runParallel(const char* exe, const BatchOptions& opts) {
+    std::string prefix = quoteArg(exe);
+    for (const std::string& arg : opts.forwarded) prefix += " " + quoteArg(arg);
+
+    std::atomic<size_t> next{0};
+    std::atomic<int> failures{0};
+    std::mutex outputMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < opts.projects.size(); i = next++) {
+            std::string cmd = prefix + " " + quoteArg(opts.projects[i]);
+#ifdef _WIN32
+            cmd = "\"" + cmd + "\"";   // cmd.exe strips one pair of outer quotes
+#endif
+            if (std::system(cmd.c_str()) != 0) {
+                failures++;
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cerr << "Failed: " << opts.projects[i] << "\n";
+            }
+        }
+    };
+    int count = std::min<int>(opts.jobs, static_cast<int>(opts.projects.size()));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; i++) threads.emplace_back(worker);
+    for (auto& t : threads) t.join();
+    return failures.load() == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    BatchOptions opts;
+    if (!parseArgs(argc, argv, opts)) {
+        printUsage();
+        return 2;
+    }
+    if (!opts.png && !opts.jpg && !opts.pdf && !opts.svg && !opts.tikz && !opts.vectorPdf && opts.anim.empty() &&
+        opts.sweep.empty() && opts.tolerances.empty()) {
+        std::cerr << "No export requested\n";
+        printUsage();
+        return 2;
+    }
+    if (opts.jobs > 1 && opts.projects.size() > 1) return runParallel(argv[0], opts);
+
+    GLFWwindow* window = nullptr;
+    std::unique_ptr<opticsketch::Viewport> viewport;
+    if (needsGL(opts)) {
+        window = createOffscreenContext();
+        if (window) {
+            viewport = std::make_unique<opticsketch::Viewport>();
+            // Tiled exports size their own framebuffer; poster sizes must not be allocated here
+            viewport->init(std::min(opts.width, 1920), std::min(opts.height, 1080));
+        }
+    }
+
+    int failures = 0;
+    for (const std::string& project : opts.projects) {
+        if (!processProject(project, opts, viewport.get())) failures++;
+    }
+
+    viewport.reset();   // GL objects are released while the context is still current
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    return failures == 0 ? 0 : 1;
+}
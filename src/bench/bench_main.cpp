@@ -0,0 +1,394 @@
+// OpticSketchBench: times the tracer, project I/O, vector export, scene lookups and
+// offscreen rendering on synthetic scenes of increasing size, and prints the results as
+// JSON so runs can be compared. GL benchmarks need a display (or xvfb-run); they are
+// skipped when no context can be created, or with --no-gl.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/gtc/quaternion.hpp>
+#include "render/viewport.h"
+#include "render/beam.h"
+#include "scene/scene.h"
+#include "elements/basic_elements.h"
+#include "style/scene_style.h"
+#include "project/project.h"
+#include "optics/ray_tracer.h"
+#include "export/export_svg.h"
+#include "export/export_tikz.h"
+#include "templates/templates.h"
+
+namespace fs = std::filesystem;
+
+struct BenchOptions {
+    std::vector<int> scales{1, 8, 64};
+    int iterations = 5;
+    std::string filter;        // run only benchmarks whose name contains this
+    std::string outPath;       // empty = stdout
+    bool gl = true;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string scene;
+    int scale = 0;
+    size_t elements = 0;
+    int iterations = 0;
+    double meanMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+};
+
+static void printUsage() {
+    std::cout <<
+        "Usage: OpticSketchBench [options]\n"
+        "  --scales A,B,...   scene sizes to generate (1,8,64)\n"
+        "  --iterations N     timed runs per benchmark, after one warm-up (5)\n"
+        "  --filter TEXT      only benchmarks whose name contains TEXT\n"
+        "  --out FILE         write the JSON results to FILE (default: stdout)\n"
+        "  --no-gl            skip the offscreen rendering benchmarks\n";
+}
+
+static bool parseArgs(int argc, char** argv, BenchOptions& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) return false;
+            out = argv[++i];
+            return true;
+        };
+        std::string v;
+        if (arg == "--scales") {
+            if (!value(v)) return false;
+            opts.scales.clear();
+            std::stringstream list(v);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                int scale = std::atoi(item.c_str());
+                if (scale < 1) return false;
+                opts.scales.push_back(scale);
+            }
+            if (opts.scales.empty()) return false;
+        } else if (arg == "--iterations") {
+            if (!value(v)) return false;
+            opts.iterations = std::max(1, std::atoi(v.c_str()));
+        } else if (arg == "--filter") {
+            if (!value(opts.filter)) return false;
+        } else if (arg == "--out") {
+            if (!value(opts.outPath)) return false;
+        } else if (arg == "--no-gl") {
+            opts.gl = false;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ── Synthetic scenes ───────────────────────────────────────────────
+
+static glm::quat rotY(float degrees) {
+    return glm::angleAxis(glm::radians(degrees), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void placeElement(std::vector<std::unique_ptr<opticsketch::Element>>& batch, opticsketch::ElementType type,
+                         const glm::vec3& pos, const glm::quat& rot = glm::quat(1, 0, 0, 0)) {
+    auto elem = opticsketch::createElement(type);
+    elem->transform.position = pos;
+    elem->transform.rotation = rot;
+    batch.push_back(std::move(elem));
+}
+
+// 'copies' copies of a template laid out on a square grid
+static void buildTiledTemplate(opticsketch::Scene& scene, const std::string& templateId, int copies) {
+    static constexpr float kTileSpacing = 40.0f;
+    opticsketch::Scene tile;
+    opticsketch::loadTemplate(templateId, &tile);
+
+    int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(copies))));
+    std::vector<std::unique_ptr<opticsketch::Element>> elements;
+    std::vector<std::unique_ptr<opticsketch::Beam>> beams;
+    for (int c = 0; c < copies; c++) {
+        glm::vec3 offset(static_cast<float>(c % side) * kTileSpacing, 0.0f, static_cast<float>(c / side) * kTileSpacing);
+        for (const auto& elem : tile.getElements()) {
+            auto copy = elem->clone();
+            copy->transform.position += offset;
+            elements.push_back(std::move(copy));
+        }
+        for (const auto& beam : tile.getBeams()) {
+            auto copy = std::make_unique<opticsketch::Beam>();
+            copy->start = beam->start + offset;
+            copy->end = beam->end + offset;
+            copy->color = beam->color;
+            copy->width = beam->width;
+            beams.push_back(std::move(copy));
+        }
+    }
+    scene.addElements(std::move(elements));
+    scene.addBeams(std::move(beams));
+}
+
+// One laser folded through 'mirrors' 45-degree mirrors in a staircase, into a detector
+static void buildMirrorMaze(opticsketch::Scene& scene, int mirrors) {
+    static constexpr float kStep = 4.0f;
+    std::vector<std::unique_ptr<opticsketch::Element>> batch;
+    placeElement(batch, opticsketch::ElementType::Laser, {0.0f, 0.0f, -kStep});
+    // Each mirror turns +Z into +X and +X into +Z
+    glm::vec3 pos(0.0f);
+    for (int i = 0; i < mirrors; i++) {
+        placeElement(batch, opticsketch::ElementType::Mirror, pos, rotY(-45.0f));
+        if (i % 2 == 0) pos.x += kStep;
+        else pos.z += kStep;
+    }
+    placeElement(batch, opticsketch::ElementType::Detector, pos, mirrors % 2 == 0 ? rotY(0.0f) : rotY(90.0f));
+    scene.addElements(std::move(batch));
+}
+
+// 'sources' white-light lasers side by side, each dispersed by a grating onto a screen
+static void buildGratingFan(opticsketch::Scene& scene, int sources) {
+    static constexpr float kSpacing = 12.0f;
+    std::vector<std::unique_ptr<opticsketch::Element>> batch;
+    for (int i = 0; i < sources; i++) {
+        float x = static_cast<float>(i) * kSpacing;
+        auto laser = opticsketch::createElement(opticsketch::ElementType::Laser);
+        laser->transform.position = {x, 0.0f, -10.0f};
+        laser->optics.sourceIsWhiteLight = true;
+        laser->optics.sourceRayCount = 8;
+        laser->optics.sourceBeamWidth = 2.0f;
+        batch.push_back(std::move(laser));
+        placeElement(batch, opticsketch::ElementType::Grating, {x, 0.0f, 0.0f}, rotY(15.0f));
+        placeElement(batch, opticsketch::ElementType::Screen, {x, 0.0f, 10.0f});
+    }
+    scene.addElements(std::move(batch));
+}
+
+struct SceneGenerator {
+    const char* name;
+    std::function<void(opticsketch::Scene&, int)> build;
+};
+
+static std::vector<SceneGenerator> sceneGenerators() {
+    std::vector<SceneGenerator> generators;
+    for (const char* id : {"michelson", "mach_zehnder", "beam_expander", "spectroscopy"}) {
+        generators.push_back({id, [id](opticsketch::Scene& s, int scale) { buildTiledTemplate(s, id, scale); }});
+    }
+    generators.push_back({"mirror_maze", [](opticsketch::Scene& s, int scale) { buildMirrorMaze(s, scale * 8); }});
+    generators.push_back({"grating_fan", [](opticsketch::Scene& s, int scale) { buildGratingFan(s, scale); }});
+    return generators;
+}
+
+// ── Timing ─────────────────────────────────────────────────────────
+
+// One untimed warm-up run, then 'iterations' timed ones
+static BenchResult timeRuns(const std::string& name, int iterations, const std::function<void()>& setup,
+                            const std::function<void()>& run) {
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.minMs = DBL_MAX;
+    double total = 0.0;
+    for (int i = -1; i < iterations; i++) {
+        if (setup) setup();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i < 0) continue;
+        total += ms;
+        result.minMs = std::min(result.minMs, ms);
+        result.maxMs = std::max(result.maxMs, ms);
+    }
+    result.meanMs = total / iterations;
+    return result;
+}
+
+// Hidden window whose context drives the viewport's offscreen framebuffer
+static GLFWwindow* createOffscreenContext() {
+    if (!glfwInit()) return nullptr;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    #ifdef PLATFORM_LINUX
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    #endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "OpticSketchBench", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+static void frameScene(opticsketch::Camera& camera, opticsketch::Scene& scene) {
+    glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+    for (const auto& elem : scene.getElements()) {
+        glm::vec3 wMin, wMax;
+        elem->getWorldBounds(wMin, wMax);
+        sceneMin = glm::min(sceneMin, wMin);
+        sceneMax = glm::max(sceneMax, wMax);
+    }
+    if (scene.getElements().empty()) camera.resetView();
+    else camera.frameOn((sceneMin + sceneMax) * 0.5f, glm::length(sceneMax - sceneMin) * 0.5f);
+}
+
+static void benchScene(const SceneGenerator& generator, int scale, const BenchOptions& opts,
+                       opticsketch::Viewport* viewport, const fs::path& tempDir, std::vector<BenchResult>& results) {
+    opticsketch::Scene scene;
+    opticsketch::SceneStyle style;
+    generator.build(scene, scale);
+    opticsketch::RayTracer tracer;
+
+    auto add = [&](const std::string& name, const std::function<void()>& setup, const std::function<void()>& run) {
+        if (!opts.filter.empty() && name.find(opts.filter) == std::string::npos) return;
+        BenchResult result = timeRuns(name, opts.iterations, setup, run);
+        result.scene = generator.name;
+        result.scale = scale;
+        result.elements = scene.getElements().size();
+        results.push_back(result);
+    };
+
+    add("trace", nullptr, [&]() { tracer.traceScene(&scene); });
+    // Later benchmarks see the traced rays, as an exported or saved project would
+
+    std::string text = (tempDir / "bench.optsk").string();
+    std::string binary = (tempDir / "bench.optskb").string();
+    add("save_text", nullptr, [&]() { opticsketch::saveProject(text, &scene, &style); });
+    add("load_text", nullptr, [&]() {
+        opticsketch::Scene loaded;
+        opticsketch::loadProject(text, &loaded);
+    });
+    add("save_binary", nullptr, [&]() { opticsketch::saveProject(binary, &scene, &style); });
+    add("load_binary", nullptr, [&]() {
+        opticsketch::Scene loaded;
+        opticsketch::loadProject(binary, &loaded);
+    });
+    add("export_svg", nullptr, [&]() { opticsketch::exportSvg((tempDir / "bench.svg").string(), &scene, &style); });
+    add("export_tikz", nullptr, [&]() { opticsketch::exportTikz((tempDir / "bench.tex").string(), &scene, &style); });
+
+    // Lookups in a shuffled order, so they don't follow the storage order
+    std::vector<std::string> ids;
+    for (const auto& elem : scene.getElements()) ids.push_back(elem->id);
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(1));
+    add("lookup_id", nullptr, [&]() {
+        for (const std::string& id : ids) {
+            if (!scene.getElement(id)) std::abort();
+        }
+    });
+    add("lookup_handle", nullptr, [&]() {
+        for (const std::string& id : ids) {
+            if (!scene.getElement(scene.findHandle(id))) std::abort();
+        }
+    });
+    add("select_additive", [&]() { scene.deselectAll(); }, [&]() {
+        for (const std::string& id : ids) scene.selectElement(id, true);
+    });
+    add("select_query", nullptr, [&]() {
+        size_t selected = 0;
+        for (const auto& elem : scene.getElements()) selected += scene.isSelected(elem->handle) ? 1 : 0;
+        if (selected > ids.size()) std::abort();
+    });
+    add("select_all", [&]() { scene.deselectAll(); }, [&]() { scene.selectAll(); });
+    scene.deselectAll();
+
+    if (viewport) {
+        frameScene(viewport->getCamera(), scene);
+        add("render_scene", nullptr, [&]() {
+            viewport->beginFrame();
+            viewport->renderGrid();
+            viewport->renderScene(&scene);
+            viewport->renderBeams(&scene);
+            viewport->endFrame();
+            glFinish();   // time the GPU work, not just its submission
+        });
+    }
+}
+
+static void writeJson(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "  {\"benchmark\":\"%s\",\"scene\":\"%s\",\"scale\":%d,\"elements\":%zu,"
+                      "\"iterations\":%d,\"mean_ms\":%.4f,\"min_ms\":%.4f,\"max_ms\":%.4f}",
+                      r.name.c_str(), r.scene.c_str(), r.scale, r.elements, r.iterations,
+                      r.meanMs, r.minMs, r.maxMs);
+        out << line << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opts;
+    if (!parseArgs(argc, argv, opts)) {
+        printUsage();
+        return 2;
+    }
+
+    std::error_code ec;
+    fs::path tempDir = fs::temp_directory_path(ec) / "opticsketch_bench";
+    fs::create_directories(tempDir, ec);
+    if (ec) {
+        std::cerr << "Could not create " << tempDir.string() << "\n";
+        return 1;
+    }
+
+    GLFWwindow* window = nullptr;
+    std::unique_ptr<opticsketch::Viewport> viewport;
+    if (opts.gl) {
+        window = createOffscreenContext();
+        if (window) {
+            viewport = std::make_unique<opticsketch::Viewport>();
+            viewport->init(1280, 720);
+        } else {
+            std::cerr << "No GL context available; skipping render benchmarks\n";
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (const SceneGenerator& generator : sceneGenerators()) {
+        for (int scale : opts.scales) {
+            std::cerr << generator.name << " x" << scale << "\n";
+            benchScene(generator, scale, opts, viewport.get(), tempDir, results);
+        }
+    }
+
+    viewport.reset();   // GL objects are released while the context is still current
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    fs::remove_all(tempDir, ec);
+
+    if (opts.outPath.empty()) {
+        writeJson(std::cout, results);
+    } else {
+        std::ofstream file(opts.outPath);
+        if (!file) {
+            std::cerr << "Could not write " << opts.outPath << "\n";
+            return 1;
+        }
+        writeJson(file, results);
+    }
+    return 0;
+}
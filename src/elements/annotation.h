@@ -1,5 +1,6 @@
 #pragma once
 
+#include "scene/object_handle.h"
 #include <glm/glm.hpp>
 #include <memory>
 #include <string>
@@ -12,6 +13,7 @@ public:
     explicit Annotation(const std::string& annotationId);
 
     std::string id;
+    ObjectHandle handle = kNoObjectHandle;   // set by the Scene it is added to
     std::string label;
     std::string text;
     glm::vec3 position{0.0f};
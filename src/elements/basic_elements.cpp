@@ -1,5 +1,5 @@
 #include "elements/basic_elements.h"
-#include "render/mesh_loader.h"
+#include "render/mesh_store.h"
 #include <sstream>
 #include <random>
 
@@ -172,25 +172,45 @@ std::unique_ptr<Element> createMount(const std::string& id) {
     return elem;
 }
 
-std::unique_ptr<Element> createMeshElement(const std::string& objPath, const std::string& id) {
-    MeshData data;
-    if (!loadObjFile(objPath, data)) return nullptr;
-
-    auto elem = std::make_unique<Element>(ElementType::ImportedMesh,
-                                          id.empty() ? generateId(ElementType::ImportedMesh) : id);
-    elem->meshVertices = std::move(data.vertices);
-    elem->meshSourcePath = objPath;
-    elem->boundsMin = data.boundsMin;
-    elem->boundsMax = data.boundsMax;
-
-    // Derive label from filename
-    std::string name = objPath;
+// Element label from a mesh file name, without folder or extension
+static std::string meshLabel(const std::string& path) {
+    std::string name = path;
     auto pos = name.find_last_of("/\\");
     if (pos != std::string::npos) name = name.substr(pos + 1);
     auto dot = name.rfind('.');
     if (dot != std::string::npos) name = name.substr(0, dot);
-    elem->label = name;
+    return name;
+}
+
+std::unique_ptr<Element> createMeshElement(const std::string& objPath, const std::string& id) {
+    return createMeshElement(MeshStore::instance().load(objPath), id);
+}
+
+std::unique_ptr<Element> createMeshElement(const std::shared_ptr<const MeshAsset>& asset, const std::string& id) {
+    if (!asset) return nullptr;
 
+    auto elem = std::make_unique<Element>(ElementType::ImportedMesh,
+                                          id.empty() ? generateId(ElementType::ImportedMesh) : id);
+    elem->mesh = asset;
+    elem->meshSourcePath = asset->sourcePath;
+    elem->boundsMin = asset->boundsMin;
+    elem->boundsMax = asset->boundsMax;
+    elem->label = meshLabel(asset->sourcePath);
+    // Mounts and housings block the rays that hit their triangles
+    elem->optics.opticalType = OpticalType::Absorber;
+    elem->optics.transmissivity = 0.0f;
+    return elem;
+}
+
+std::unique_ptr<Element> createMeshPlaceholder(const std::string& objPath, const std::string& id) {
+    auto elem = std::make_unique<Element>(ElementType::ImportedMesh,
+                                          id.empty() ? generateId(ElementType::ImportedMesh) : id);
+    elem->meshSourcePath = objPath;
+    elem->boundsMin = glm::vec3(-1.0f);
+    elem->boundsMax = glm::vec3(1.0f);
+    elem->label = meshLabel(objPath);
+    elem->optics.opticalType = OpticalType::Absorber;
+    elem->optics.transmissivity = 0.0f;
     return elem;
 }
 
@@ -20,9 +20,18 @@ std::unique_ptr<Element> createFiberCoupler(const std::string& id = "");
 std::unique_ptr<Element> createScreen(const std::string& id = "");
 std::unique_ptr<Element> createMount(const std::string& id = "");
 
+struct MeshAsset;
+
 // Create mesh element from OBJ file path
 std::unique_ptr<Element> createMeshElement(const std::string& objPath, const std::string& id = "");
 
+// Create mesh element from an already loaded asset (e.g. from a background import)
+std::unique_ptr<Element> createMeshElement(const std::shared_ptr<const MeshAsset>& asset, const std::string& id = "");
+
+// Mesh element whose geometry is loaded later (mesh stays null until then). Bounds default
+// to the unit cube imported meshes are normalized into.
+std::unique_ptr<Element> createMeshPlaceholder(const std::string& objPath, const std::string& id = "");
+
 // Helper to create element from type
 std::unique_ptr<Element> createElement(ElementType type, const std::string& id = "");
 
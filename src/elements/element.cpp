@@ -1,5 +1,8 @@
 #include "elements/element.h"
+#include <glm/gtc/matrix_inverse.hpp>
 #include <algorithm>
+#include <cfloat>
+#include <cstdint>
 
 namespace opticsketch {
 
@@ -24,9 +27,51 @@ Element::Element(ElementType t, const std::string& elementId)
     }
 }
 
-void Element::getWorldBounds(glm::vec3& outMin, glm::vec3& outMax) const {
-    glm::mat4 matrix = transform.getMatrix();
-    
+void Element::updateMatrixCache() const {
+    if (!matrixDirty) return;
+    cachedModel = transform.getMatrix();
+    cachedInvModel = glm::inverse(cachedModel);
+    cachedNormal = glm::mat3(glm::transpose(cachedInvModel));
+    matrixDirty = false;
+    transformGeneration++;
+}
+
+int ElementArray::gridSize() const {
+    int64_t cells = int64_t(std::max(1, count.x)) * std::max(1, count.y) * std::max(1, count.z);
+    return static_cast<int>(std::min<int64_t>(cells, kMaxInstances));
+}
+
+int ElementArray::size() const {
+    return std::min(kMaxInstances, gridSize() + static_cast<int>(instances.size()));
+}
+
+Transform ElementArray::offset(int i) const {
+    int grid = gridSize();
+    if (i >= grid) return instances[i - grid];
+    int nx = std::max(1, count.x), ny = std::max(1, count.y);
+    Transform t;
+    t.position = pitch * glm::vec3(static_cast<float>(i % nx), static_cast<float>((i / nx) % ny),
+                                   static_cast<float>(i / (nx * ny)));
+    return t;
+}
+
+Transform Element::getInstanceTransform(int instance) const {
+    if (instance == 0) return transform;
+    Transform o = array.offset(instance);
+    Transform t;
+    t.position = transform.position + transform.rotation * o.position;
+    t.rotation = transform.rotation * o.rotation;
+    t.scale = transform.scale * o.scale;
+    return t;
+}
+
+glm::mat4 Element::getInstanceModelMatrix(int instance) const {
+    if (instance == 0) return getModelMatrix();
+    return getInstanceTransform(instance).getMatrix();
+}
+
+void transformedBounds(const glm::mat4& matrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                       glm::vec3& outMin, glm::vec3& outMax) {
     // Transform all 8 corners of the bounding box
     glm::vec3 corners[8] = {
         glm::vec3(boundsMin.x, boundsMin.y, boundsMin.z),
@@ -49,13 +94,49 @@ void Element::getWorldBounds(glm::vec3& outMin, glm::vec3& outMax) const {
     }
 }
 
-// Pivot = bbox center in world. Equals position + R*(S*localCenter) by construction (getWorldBounds uses transform.getMatrix()).
+void Element::getWorldBounds(glm::vec3& outMin, glm::vec3& outMax) const {
+    transformedBounds(getModelMatrix(), boundsMin, boundsMax, outMin, outMax);
+}
+
+// Pivot = bbox center in world. Equals position + R*(S*localCenter) by construction (getWorldBounds uses getModelMatrix()).
 glm::vec3 Element::getWorldBoundsCenter() const {
     glm::vec3 outMin, outMax;
     getWorldBounds(outMin, outMax);
     return (outMin + outMax) * 0.5f;
 }
 
+void Element::getInstanceWorldBounds(int instance, glm::vec3& outMin, glm::vec3& outMax) const {
+    if (instance == 0) {
+        getWorldBounds(outMin, outMax);
+        return;
+    }
+    transformedBounds(getInstanceModelMatrix(instance), boundsMin, boundsMax, outMin, outMax);
+}
+
+void Element::getArrayWorldBounds(glm::vec3& outMin, glm::vec3& outMax) const {
+    getWorldBounds(outMin, outMax);
+    if (array.isSingle()) return;
+    auto include = [&](int instance) {
+        glm::vec3 imin, imax;
+        getInstanceWorldBounds(instance, imin, imax);
+        outMin = glm::min(outMin, imin);
+        outMax = glm::max(outMax, imax);
+    };
+    // Grid copies are translations of the prototype, so the corner cells bound them all
+    // (unless the grid was cut short at kMaxInstances)
+    int grid = array.gridSize();
+    glm::ivec3 n = glm::max(array.count, glm::ivec3(1));
+    if (grid == n.x * n.y * n.z) {
+        for (int corner = 1; corner < 8; corner++) {
+            int ix = (corner & 1) ? n.x - 1 : 0, iy = (corner & 2) ? n.y - 1 : 0, iz = (corner & 4) ? n.z - 1 : 0;
+            include(ix + n.x * (iy + n.y * iz));
+        }
+    } else {
+        for (int i = 1; i < grid; i++) include(i);
+    }
+    for (int i = grid; i < array.size(); i++) include(i);
+}
+
 std::unique_ptr<Element> Element::clone() const {
     auto e = std::make_unique<Element>(type, ""); // empty ID — Scene::addElement will ensure uniqueness
     e->label = label;
@@ -68,8 +149,9 @@ std::unique_ptr<Element> Element::clone() const {
     e->boundsMax = boundsMax;
     e->optics = optics;
     e->material = material;
-    e->meshVertices = meshVertices;
+    e->mesh = mesh;
     e->meshSourcePath = meshSourcePath;
+    e->array = array;
     return e;
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "scene/object_handle.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <memory>
@@ -8,6 +9,8 @@
 
 namespace opticsketch {
 
+struct MeshAsset;
+
 enum class ElementType {
     Laser,
     Mirror,
@@ -64,8 +67,41 @@ struct Transform {
         glm::mat4 S = glm::scale(glm::mat4(1.0f), scale);
         return T * R * S;
     }
+
+    bool operator==(const Transform& o) const {
+        return position == o.position && rotation == o.rotation && scale == o.scale;
+    }
+    bool operator!=(const Transform& o) const { return !(*this == o); }
+};
+
+// Regular repetition of one element: rows of posts, mounts or apertures on a breadboard.
+// The element itself is the prototype and instance 0. The grid places count.x * count.y *
+// count.z copies 'pitch' apart, then the explicit instances follow. Offsets are taken in
+// the element's rotated but unscaled frame, so moving or turning the element carries the
+// whole array. Copies share everything but their placement.
+struct ElementArray {
+    static constexpr int kMaxInstances = 65536;
+
+    glm::ivec3 count{1};                // grid cells along local X, Y, Z (>= 1 each)
+    glm::vec3 pitch{25.0f};             // mm between grid cells
+    std::vector<Transform> instances;   // further copies, relative to the prototype
+
+    int gridSize() const;
+    int size() const;
+    bool isSingle() const { return size() <= 1; }
+    // Placement of instance i (0 <= i < size()) relative to the prototype
+    Transform offset(int i) const;
+
+    bool operator==(const ElementArray& o) const {
+        return count == o.count && pitch == o.pitch && instances == o.instances;
+    }
+    bool operator!=(const ElementArray& o) const { return !(*this == o); }
 };
 
+// World-space box around the local box (boundsMin, boundsMax) under 'matrix'
+void transformedBounds(const glm::mat4& matrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+                       glm::vec3& outMin, glm::vec3& outMax);
+
 class Element {
 public:
     Element(ElementType t, const std::string& elementId);
@@ -73,6 +109,7 @@ public:
     
     // Identification
     std::string id;
+    ObjectHandle handle = kNoObjectHandle;   // set by the Scene it is added to
     std::string label;
     ElementType type;
     
@@ -95,12 +132,23 @@ public:
     // Material properties (for Presentation mode rendering)
     MaterialProperties material;
 
-    // Mesh data (for ImportedMesh type only)
-    std::vector<float> meshVertices;    // 6 floats per vertex (pos + normal)
+    // Mesh data (for ImportedMesh type only); shared between copies of the same mesh
+    std::shared_ptr<const MeshAsset> mesh;
     std::string meshSourcePath;         // original OBJ path for re-import
+
+    // Instanced copies of this element; call markTransformDirty() after editing it
+    ElementArray array;
     
-    // Get world-space bounds (transform.getMatrix() * local bounds corners)
+    // Get world-space bounds (getModelMatrix() * local bounds corners) of the prototype
     void getWorldBounds(glm::vec3& outMin, glm::vec3& outMax) const;
+
+    // Array instances (instance 0 is the element itself)
+    int getInstanceCount() const { return array.size(); }
+    Transform getInstanceTransform(int instance) const;
+    glm::mat4 getInstanceModelMatrix(int instance) const;
+    void getInstanceWorldBounds(int instance, glm::vec3& outMin, glm::vec3& outMax) const;
+    // World bounds of every instance; the prototype's own for a single element
+    void getArrayWorldBounds(glm::vec3& outMin, glm::vec3& outMax) const;
     
     // Transform pivot in world space = bbox center. Gizmo is drawn here; manipulator edits only transform, this is derived.
     glm::vec3 getWorldBoundsCenter() const;
@@ -112,6 +160,27 @@ public:
     glm::vec3 getLocalBoundsCenter() const {
         return (boundsMin + boundsMax) * 0.5f;
     }
+
+    // Cached world matrices, rebuilt on first access after markTransformDirty()
+    const glm::mat4& getModelMatrix() const { updateMatrixCache(); return cachedModel; }
+    const glm::mat4& getInverseModelMatrix() const { updateMatrixCache(); return cachedInvModel; }
+    const glm::mat3& getNormalMatrix() const { updateMatrixCache(); return cachedNormal; }
+
+    // Call after writing 'transform' (or 'array'); until then the cached matrices are kept
+    void markTransformDirty() { matrixDirty = true; }
+
+    // Incremented every time the cached matrices are rebuilt after markTransformDirty(),
+    // so it also moves for edits to the array
+    unsigned int getTransformGeneration() const { updateMatrixCache(); return transformGeneration; }
+
+private:
+    void updateMatrixCache() const;
+
+    mutable glm::mat4 cachedModel{1.0f};
+    mutable glm::mat4 cachedInvModel{1.0f};
+    mutable glm::mat3 cachedNormal{1.0f};
+    mutable bool matrixDirty = true;
+    mutable unsigned int transformGeneration = 0;
 };
 
 } // namespace opticsketch
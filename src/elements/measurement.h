@@ -1,5 +1,6 @@
 #pragma once
 
+#include "scene/object_handle.h"
 #include <glm/glm.hpp>
 #include <memory>
 #include <string>
@@ -12,6 +13,7 @@ public:
     explicit Measurement(const std::string& measId);
 
     std::string id;
+    ObjectHandle handle = kNoObjectHandle;   // set by the Scene it is added to
     std::string label;
     glm::vec3 startPoint{0.0f};
     glm::vec3 endPoint{0.0f};
@@ -5,9 +5,9 @@
 #include "camera/camera.h"
 #include "style/scene_style.h"
 #include "elements/element.h"
-#include "export/export_png.h"
+#include "export/frame_pipeline.h"
+#include "optics/parameter_sweep.h"
 #include <glad/glad.h>
-#include <glm/gtc/quaternion.hpp>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -38,7 +38,7 @@ float applyEasing(float t, EasingFunction easing) {
     }
 }
 
-bool isFFmpegAvailable() {
+static bool probeFFmpeg() {
 #ifdef _WIN32
     int ret = std::system("where ffmpeg >nul 2>nul");
 #else
@@ -47,6 +47,11 @@ bool isFFmpegAvailable() {
     return ret == 0;
 }
 
+bool isFFmpegAvailable() {
+    static const bool available = probeFFmpeg();
+    return available;
+}
+
 // Helper: get temp directory for intermediate frames (GIF/MP4 formats)
 static std::string getTempFrameDir(const std::string& outputPath) {
     namespace fs = std::filesystem;
@@ -56,6 +61,22 @@ static std::string getTempFrameDir(const std::string& outputPath) {
     return tempDir.string();
 }
 
+// ffmpeg command reading raw top-down RGB frames from stdin
+static std::string buildStreamCommand(const AnimationExportSettings& settings, int width, int height) {
+    std::ostringstream cmd;
+    cmd << "ffmpeg -y -loglevel error -f rawvideo -pix_fmt rgb24 -s " << width << "x" << height
+        << " -framerate " << settings.fps << " -i -";
+    if (settings.format == AnimationOutputFormat::GIF) {
+        // Palette generated from the same stream in one pass (ffmpeg buffers the frames)
+        cmd << " -filter_complex \"split[a][b];[a]palettegen[p];[b][p]paletteuse\"";
+    } else {
+        // yuv420p needs even dimensions
+        cmd << " -vf \"pad=ceil(iw/2)*2:ceil(ih/2)*2\" -c:v libx264 -crf 18 -pix_fmt yuv420p";
+    }
+    cmd << " \"" << settings.outputPath << "\"";
+    return cmd.str();
+}
+
 void beginAnimationExport(AnimationExportState& state, const AnimationExportSettings& settings,
                           Viewport* viewport, Scene* scene) {
     state.active = true;
@@ -71,21 +92,32 @@ void beginAnimationExport(AnimationExportState& state, const AnimationExportSett
     state.savedDistance = cam.getDistance();
     state.savedTarget = cam.target;
 
-    // Save beam endpoints for beam propagation
-    state.beamSnapshots.clear();
+    // Beam propagation: the light front sweeps the longest animated path over the export
+    state.propagationLength = 0.0f;
     if (settings.type == AnimationType::BeamPropagation) {
         for (const auto& beam : scene->getBeams()) {
             if (!beam->visible) continue;
             if (!settings.beamPropagation.allBeams && beam->id != settings.beamPropagation.beamId)
                 continue;
-            state.beamSnapshots.push_back({beam->id, beam->end});
+            state.propagationLength = std::max(state.propagationLength, beam->getLength());
+        }
+        // Traced rays propagate with all beams, from their sources
+        const TracedRayBuffer& traced = scene->getTracedRays();
+        for (size_t i = 0; settings.beamPropagation.allBeams && i < traced.size(); i++) {
+            if (traced.pathStart[i] < 0.0f) continue;
+            float reach = traced.pathStart[i] + glm::distance(traced.start[i], traced.end[i]);
+            state.propagationLength = std::max(state.propagationLength, reach);
         }
     }
 
+    state.pipeline = std::make_shared<FramePipeline>();
+
     // Create output directory
     if (settings.format == AnimationOutputFormat::ImageSequence) {
         std::filesystem::create_directories(settings.outputPath);
-    } else {
+    } else if (!settings.streamToFFmpeg || !isFFmpegAvailable() ||
+               !state.pipeline->openPipe(buildStreamCommand(settings, viewport->getWidth(), viewport->getHeight()),
+                                         viewport->getWidth(), viewport->getHeight())) {
         // GIF/MP4: create temp directory for intermediate PNG frames
         getTempFrameDir(settings.outputPath);
     }
@@ -114,33 +146,23 @@ bool advanceAnimationFrame(AnimationExportState& state, const AnimationExportSet
             break;
         }
         case AnimationType::BeamPropagation: {
-            for (const auto& snap : state.beamSnapshots) {
-                for (const auto& beam : scene->getBeams()) {
-                    if (beam->id == snap.id) {
-                        beam->end = beam->start + (snap.originalEnd - beam->start) * easedProgress;
-                        break;
-                    }
-                }
-            }
+            // One uniform per frame; the beam vertex stream is the same every frame
+            viewport->setBeamPropagation(state.propagationLength * easedProgress,
+                                         settings.beamPropagation.allBeams ? std::string()
+                                                                           : settings.beamPropagation.beamId);
             break;
         }
         case AnimationType::ParameterSweep: {
             auto* elem = scene->getElement(settings.parameterSweep.elementId);
-            if (elem) {
+            int index = settings.parameterSweep.parameterIndex;
+            if (elem && index >= 0 && index < kSweepParameterCount) {
                 float val = settings.parameterSweep.startValue +
                     (settings.parameterSweep.endValue - settings.parameterSweep.startValue) * easedProgress;
-                switch (settings.parameterSweep.parameterIndex) {
-                    case 0: elem->transform.position.x = val; break;
-                    case 1: elem->transform.position.y = val; break;
-                    case 2: elem->transform.position.z = val; break;
-                    case 3: {
-                        glm::vec3 up(0.0f, 1.0f, 0.0f);
-                        elem->transform.rotation = glm::angleAxis(glm::radians(val), up);
-                        break;
-                    }
-                    case 4: elem->optics.focalLength = val; break;
-                    default: break;
-                }
+                SweepParameter parameter = static_cast<SweepParameter>(index);
+                applySweepParameter(elem, parameter, val);
+                scene->recordChange(elem->handle, parameter == SweepParameter::FocalLength
+                                                      ? SceneChange::PropertyChanged
+                                                      : SceneChange::Transformed);
             }
             break;
         }
@@ -159,28 +181,21 @@ bool advanceAnimationFrame(AnimationExportState& state, const AnimationExportSet
         viewport->renderBloomPass();
     }
 
-    // Read pixels from the viewport texture (bottom-up OpenGL order)
-    int w = viewport->getWidth();
-    int h = viewport->getHeight();
-    std::vector<unsigned char> pixels(w * h * 3);
-    glBindTexture(GL_TEXTURE_2D, viewport->getTextureId());
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Build frame path
-    std::string frameDir;
-    if (settings.format == AnimationOutputFormat::ImageSequence) {
-        frameDir = settings.outputPath;
-    } else {
-        frameDir = getTempFrameDir(settings.outputPath);
+    // Queued readback; the PNG is written (or the frame streamed) by the pipeline's threads
+    if (!state.pipeline) state.pipeline = std::make_shared<FramePipeline>();
+    std::string framePath;
+    if (!state.pipeline->isPiped()) {
+        std::string frameDir;
+        if (settings.format == AnimationOutputFormat::ImageSequence) {
+            frameDir = settings.outputPath;
+        } else {
+            frameDir = getTempFrameDir(settings.outputPath);
+        }
+        std::ostringstream ss;
+        ss << frameDir << "/frame_" << std::setfill('0') << std::setw(5) << state.currentFrame << ".png";
+        framePath = ss.str();
     }
-
-    std::ostringstream framePath;
-    framePath << frameDir << "/frame_"
-              << std::setfill('0') << std::setw(5) << state.currentFrame << ".png";
-
-    // savePngToFile handles the vertical flip internally
-    savePngToFile(framePath.str(), w, h, pixels.data());
+    state.pipeline->submit(viewport->getTextureId(), viewport->getWidth(), viewport->getHeight(), framePath);
 
     state.currentFrame++;
     std::ostringstream ss;
@@ -191,56 +206,97 @@ bool advanceAnimationFrame(AnimationExportState& state, const AnimationExportSet
 }
 
 void endAnimationExport(AnimationExportState& state, const AnimationExportSettings& settings,
-                        Viewport* viewport, Scene* scene) {
+                        Viewport* viewport) {
+    // Flush the frames still being read back or encoded before assembling the output
+    int failedFrames = 0;
+    bool streamed = false;
+    bool encoderFailed = false;
+    if (state.pipeline) {
+        if (state.cancelled) state.pipeline->cancel();
+        else state.pipeline->finish();
+        failedFrames = state.pipeline->getFailedCount();
+        streamed = state.pipeline->isPiped();
+        if (streamed) encoderFailed = !state.pipeline->closePipe();
+        state.pipeline.reset();
+    }
+    if (streamed && state.cancelled) {
+        // ffmpeg finalizes whatever it received; a cancelled export leaves no file behind
+        std::error_code ec;
+        std::filesystem::remove(settings.outputPath, ec);
+    }
+
     // Restore camera
     Camera& cam = viewport->getCamera();
     cam.setSpherical(state.savedAzimuth, state.savedElevation, state.savedDistance);
     cam.target = state.savedTarget;
 
-    // Restore beam endpoints
-    for (const auto& snap : state.beamSnapshots) {
-        for (const auto& beam : scene->getBeams()) {
-            if (beam->id == snap.id) {
-                beam->end = snap.originalEnd;
-                break;
-            }
-        }
+    viewport->setBeamPropagation(-1.0f);
+
+    state.active = false;
+    std::string finalStatus;
+    if (state.cancelled) {
+        finalStatus = "Export cancelled";
+    } else if (encoderFailed) {
+        finalStatus = "Export failed: ffmpeg reported an error";
+    } else if (failedFrames > 0) {
+        finalStatus = "Export complete (" + std::to_string(failedFrames) + " frames failed)";
+    } else {
+        finalStatus = "Export complete";
     }
 
     // Assemble GIF or MP4 from temporary PNG frames using ffmpeg
-    if (!state.cancelled && settings.format != AnimationOutputFormat::ImageSequence && isFFmpegAvailable()) {
-        std::string tempDir = getTempFrameDir(settings.outputPath);
-        std::ostringstream cmd;
-
-        if (settings.format == AnimationOutputFormat::GIF) {
-            // Generate GIF with palette for good quality
-            std::string palettePath = tempDir + "/palette.png";
-            // Pass 1: generate palette
-            cmd << "ffmpeg -y -framerate " << settings.fps
-                << " -i \"" << tempDir << "/frame_%05d.png\""
-                << " -vf \"palettegen\" \"" << palettePath << "\"";
-            std::system(cmd.str().c_str());
-            // Pass 2: encode GIF using palette
-            cmd.str("");
-            cmd << "ffmpeg -y -framerate " << settings.fps
-                << " -i \"" << tempDir << "/frame_%05d.png\""
-                << " -i \"" << palettePath << "\""
-                << " -lavfi \"paletteuse\" \"" << settings.outputPath << "\"";
-            std::system(cmd.str().c_str());
-        } else if (settings.format == AnimationOutputFormat::MP4) {
-            cmd << "ffmpeg -y -framerate " << settings.fps
-                << " -i \"" << tempDir << "/frame_%05d.png\""
-                << " -c:v libx264 -crf 18 -pix_fmt yuv420p"
-                << " \"" << settings.outputPath << "\"";
-            std::system(cmd.str().c_str());
-        }
+    bool assemble = !state.cancelled && !streamed && settings.format != AnimationOutputFormat::ImageSequence;
+    if (!assemble || !isFFmpegAvailable()) {
+        state.statusText = finalStatus;
+        return;
+    }
 
-        // Clean up temp directory
-        std::filesystem::remove_all(tempDir);
+    std::string tempDir = getTempFrameDir(settings.outputPath);
+    std::vector<std::string> commands;
+    std::ostringstream cmd;
+    if (settings.format == AnimationOutputFormat::GIF) {
+        // Generate GIF with palette for good quality
+        std::string palettePath = tempDir + "/palette.png";
+        // Pass 1: generate palette
+        cmd << "ffmpeg -y -framerate " << settings.fps
+            << " -i \"" << tempDir << "/frame_%05d.png\""
+            << " -vf \"palettegen\" \"" << palettePath << "\"";
+        commands.push_back(cmd.str());
+        // Pass 2: encode GIF using palette
+        cmd.str("");
+        cmd << "ffmpeg -y -framerate " << settings.fps
+            << " -i \"" << tempDir << "/frame_%05d.png\""
+            << " -i \"" << palettePath << "\""
+            << " -lavfi \"paletteuse\" \"" << settings.outputPath << "\"";
+        commands.push_back(cmd.str());
+    } else if (settings.format == AnimationOutputFormat::MP4) {
+        cmd << "ffmpeg -y -framerate " << settings.fps
+            << " -i \"" << tempDir << "/frame_%05d.png\""
+            << " -c:v libx264 -crf 18 -pix_fmt yuv420p"
+            << " \"" << settings.outputPath << "\"";
+        commands.push_back(cmd.str());
     }
 
-    state.active = false;
-    state.statusText = state.cancelled ? "Export cancelled" : "Export complete";
+    // ffmpeg runs to completion on a worker; cancelling skips the passes not yet started
+    std::string name = std::filesystem::path(settings.outputPath).filename().string();
+    state.statusText = "Encoding " + name + "...";
+    AnimationExportState* exportState = &state;
+    auto cancelled = std::make_shared<bool>(false);
+    state.assembleJob = JobSystem::instance().submit("Encoding " + name, JobPriority::Normal,
+        [commands, tempDir, cancelled](JobContext& job) {
+            for (size_t i = 0; i < commands.size() && !job.isCancelled(); i++) {
+                std::system(commands[i].c_str());
+                job.setProgress(static_cast<float>(i + 1) / static_cast<float>(commands.size()));
+            }
+            *cancelled = job.isCancelled();
+            // Clean up temp directory
+            std::error_code ec;
+            std::filesystem::remove_all(tempDir, ec);
+        },
+        [exportState, finalStatus, cancelled]() {
+            exportState->assembleJob = 0;
+            exportState->statusText = *cancelled ? "Export cancelled" : finalStatus;
+        });
 }
 
 } // namespace opticsketch
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "jobs/job_system.h"
+#include <memory>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
@@ -9,6 +11,7 @@ namespace opticsketch {
 class Scene;
 class Viewport;
 struct SceneStyle;
+class FramePipeline;
 
 enum class AnimationType {
     Turntable,
@@ -57,6 +60,8 @@ struct AnimationExportSettings {
     int height = 720;
     EasingFunction easing = EasingFunction::Linear;
     std::string outputPath;
+    // GIF/MP4: pipe raw frames straight into ffmpeg instead of assembling temp PNGs
+    bool streamToFFmpeg = true;
 
     TurntableParams turntable;
     BeamPropagationParams beamPropagation;
@@ -76,12 +81,16 @@ struct AnimationExportState {
     float savedDistance = 0.0f;
     glm::vec3 savedTarget{0.0f};
 
-    // For beam propagation: saved beam endpoints
-    struct BeamSnapshot {
-        std::string id;
-        glm::vec3 originalEnd;
-    };
-    std::vector<BeamSnapshot> beamSnapshots;
+    // For beam propagation: the longest optical path animated, so progress 1 shows every
+    // beam whole. Beams are cut at render time (Viewport::setBeamPropagation), not edited.
+    float propagationLength = 0.0f;
+
+    // Async readback + parallel PNG encoding of the rendered frames
+    std::shared_ptr<FramePipeline> pipeline;
+
+    // ffmpeg assembling GIF/MP4 from temporary PNGs after the last frame; statusText
+    // gets its final value from the job's main-thread continuation
+    JobId assembleJob = 0;
 };
 
 // Apply easing function to normalized progress [0,1]
@@ -95,11 +104,13 @@ void beginAnimationExport(AnimationExportState& state, const AnimationExportSett
 bool advanceAnimationFrame(AnimationExportState& state, const AnimationExportSettings& settings,
                            Viewport* viewport, Scene* scene, SceneStyle* style);
 
-// End animation export (restore camera, finalize files)
+// End animation export (restore camera, finalize files). Assembling from temporary
+// PNGs continues on a job (state.assembleJob) after this returns.
 void endAnimationExport(AnimationExportState& state, const AnimationExportSettings& settings,
-                        Viewport* viewport, Scene* scene);
+                        Viewport* viewport);
 
-// Check if ffmpeg is available on the system
+// Check if ffmpeg is available on the system. The probe runs a shell command once and
+// the answer is cached; call it from a job first to keep the UI thread from waiting.
 bool isFFmpegAvailable();
 
 } // namespace opticsketch
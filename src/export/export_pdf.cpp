@@ -0,0 +1,391 @@
+#include "export/export_pdf.h"
+#include "export/optical_symbols.h"
+#include "export/text_writer.h"
+#include "export/vector_paths.h"
+#include "scene/scene.h"
+#include "elements/element.h"
+#include "elements/annotation.h"
+#include "elements/measurement.h"
+#include "profile/profiler.h"
+#include "render/beam.h"
+#include "style/scene_style.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace opticsketch {
+
+// Fixed objects; the symbol forms follow, two objects each (stream and its length)
+static constexpr int kCatalogObject = 1;
+static constexpr int kPagesObject = 2;
+static constexpr int kPageObject = 3;
+static constexpr int kContentObject = 4;
+static constexpr int kContentLengthObject = 5;
+static constexpr int kResourcesObject = 6;
+static constexpr int kFontObject = 7;
+static constexpr int kFirstFormObject = 8;
+
+// Average Times-Roman advance in em, for centering text without font metrics
+static constexpr float kApproxGlyphWidth = 0.45f;
+
+static FixedNumber fmt(float v, int prec = 2) {
+    return FixedNumber{v, prec};
+}
+
+// "r g b" with components in 0..1
+struct PdfRgb {
+    const glm::vec3& color;
+};
+
+static TextWriter& operator<<(TextWriter& out, PdfRgb c) {
+    return out << fmt(c.color.x, 3) << ' ' << fmt(c.color.y, 3) << ' ' << fmt(c.color.z, 3);
+}
+
+// UTF-8 as a PDF literal string in WinAnsiEncoding: Latin-1 characters are kept, the
+// rest become '?'
+static std::string pdfString(const std::string& text) {
+    std::string result = "(";
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        unsigned int code = c;
+        if (c >= 0x80) {
+            int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+            code = (extra == 1) ? ((c & 0x1Fu) << 6) : 0x100;
+            if (extra == 1 && i + 1 < text.size()) code |= static_cast<unsigned char>(text[i + 1]) & 0x3Fu;
+            i += std::min<size_t>(extra, text.size() - 1 - i);
+            if (code < 0xA0 || code > 0xFF) code = '?';
+        }
+        if (code == '(' || code == ')' || code == '\\') {
+            result += '\\';
+            result += static_cast<char>(code);
+        } else if (code < 0x20 || code >= 0x7F) {
+            char octal[5];
+            std::snprintf(octal, sizeof(octal), "\\%03o", code < 0x20 ? unsigned('?') : code);
+            result += octal;
+        } else {
+            result += static_cast<char>(code);
+        }
+    }
+    result += ')';
+    return result;
+}
+
+// Cross-reference offsets and the resources shared by the page and its forms
+class PdfDocument {
+public:
+    explicit PdfDocument(TextWriter& out) : out(out) {}
+
+    void beginObject(int number) {
+        if (static_cast<int>(offsets.size()) <= number) offsets.resize(number + 1, 0);
+        offsets[number] = out.tell();
+        out << number << " 0 obj\n";
+    }
+
+    // Graphics state with this fill (and, with 'stroke', stroke) opacity
+    std::string opacityState(float alpha, bool stroke) {
+        int percent = static_cast<int>(std::round(std::clamp(alpha, 0.0f, 1.0f) * 100.0f));
+        auto key = std::make_pair(percent, stroke);
+        auto it = opacityStates.find(key);
+        if (it == opacityStates.end()) it = opacityStates.emplace(key, static_cast<int>(opacityStates.size())).first;
+        return "/GS" + std::to_string(it->second);
+    }
+
+    // Form XObject for an element symbol of this type and size, e.g. "/S0"
+    struct Form {
+        ElementType type;
+        float w, h;
+        glm::vec3 color;
+    };
+    std::string formName(ElementType type, float w, float h, const glm::vec3& color) {
+        auto key = std::make_tuple(static_cast<int>(type), static_cast<int>(std::round(w * 100.0f)),
+                                   static_cast<int>(std::round(h * 100.0f)));
+        auto it = formIndex.find(key);
+        if (it == formIndex.end()) {
+            it = formIndex.emplace(key, static_cast<int>(forms.size())).first;
+            forms.push_back({type, w, h, color});
+        }
+        return "/S" + std::to_string(it->second);
+    }
+
+    void writeForms() {
+        for (size_t i = 0; i < forms.size(); i++) {
+            const Form& form = forms[i];
+            int object = kFirstFormObject + 2 * static_cast<int>(i);
+            // Strokes and arcs may reach past the nominal size
+            float extent = std::max(form.w, form.h) * 2.0f + 10.0f;
+            beginObject(object);
+            out << "<< /Type /XObject /Subtype /Form /BBox [" << fmt(-extent) << ' ' << fmt(-extent) << ' '
+                << fmt(extent) << ' ' << fmt(extent) << "] /Resources " << kResourcesObject
+                << " 0 R /Length " << (object + 1) << " 0 R >>\nstream\n";
+            size_t start = out.tell();
+            out << PdfRgb{form.color} << " RG " << PdfRgb{form.color} << " rg\n";
+            renderSymbolPdf(out, getOpticalSymbol(form.type), form.w, form.h,
+                            [this](float alpha) { return opacityState(alpha, false); });
+            size_t length = out.tell() - start;
+            out << "endstream\nendobj\n";
+            writeLength(object + 1, length);
+        }
+    }
+
+    void writeLength(int object, size_t length) {
+        beginObject(object);
+        out << static_cast<int>(length) << "\nendobj\n";
+    }
+
+    void writeResources() {
+        beginObject(kResourcesObject);
+        out << "<< /Font << /F1 " << kFontObject << " 0 R >>\n/ExtGState <<";
+        for (const auto& entry : opacityStates) {
+            float alpha = entry.first.first / 100.0f;
+            out << " /GS" << entry.second << " << /ca " << fmt(alpha);
+            if (entry.first.second) out << " /CA " << fmt(alpha);
+            out << " >>";
+        }
+        out << " >>\n/XObject <<";
+        for (size_t i = 0; i < forms.size(); i++)
+            out << " /S" << static_cast<int>(i) << ' ' << (kFirstFormObject + 2 * static_cast<int>(i)) << " 0 R";
+        out << " >>\n>>\nendobj\n";
+    }
+
+    void writeXref() {
+        size_t xref = out.tell();
+        out << "xref\n0 " << static_cast<int>(offsets.size()) << "\n0000000000 65535 f \n";
+        char entry[24];
+        for (size_t i = 1; i < offsets.size(); i++) {
+            std::snprintf(entry, sizeof(entry), "%010llu 00000 n \n", static_cast<unsigned long long>(offsets[i]));
+            out << std::string_view(entry, 20);
+        }
+        out << "trailer\n<< /Size " << static_cast<int>(offsets.size()) << " /Root " << kCatalogObject
+            << " 0 R >>\nstartxref\n" << static_cast<int>(xref) << "\n%%EOF\n";
+    }
+
+private:
+    TextWriter& out;
+    std::vector<size_t> offsets;
+    std::map<std::pair<int, bool>, int> opacityStates;
+    std::map<std::tuple<int, int, int>, int> formIndex;
+    std::vector<Form> forms;
+};
+
+// Text with its baseline at (x, y): the text matrix undoes the page's y flip
+static void writeText(TextWriter& out, float x, float y, float size, const std::string& text,
+                      const glm::vec3& color, bool centered) {
+    if (centered) x -= size * kApproxGlyphWidth * static_cast<float>(text.size()) * 0.5f;
+    out << "BT /F1 " << fmt(size, 1) << " Tf " << PdfRgb{color} << " rg 1 0 0 -1 " << fmt(x) << ' ' << fmt(y)
+        << " Tm " << pdfString(text) << " Tj ET\n";
+}
+
+// Filled arrowhead with its tip at (x, y), pointing along (dx, dy); sized like the SVG
+// markers, which scale with the stroke width
+static void writeArrowhead(TextWriter& out, float x, float y, float dx, float dy, float strokeWidth) {
+    float len = std::sqrt(dx * dx + dy * dy);
+    if (len < 1e-6f) return;
+    dx /= len;
+    dy /= len;
+    float back = 10.0f * strokeWidth;
+    float half = 3.5f * strokeWidth;
+    float bx = x - dx * back, by = y - dy * back;
+    out << fmt(x) << ' ' << fmt(y) << " m " << fmt(bx - dy * half) << ' ' << fmt(by + dx * half) << " l "
+        << fmt(bx + dy * half) << ' ' << fmt(by - dx * half) << " l h f\n";
+}
+
+bool exportPdf(const std::string& path, Scene* scene, SceneStyle* style,
+               const PdfExportOptions& opts) {
+    if (!scene) return false;
+    OPTICSKETCH_PROFILE_SCOPE("exportPdf");
+
+    TextWriter out;
+    if (!out.open(path)) return false;
+    PdfDocument doc(out);
+
+    // Same units as the SVG export: 1 mm = 1.6 pt
+    const float scale = 1.6f;
+    VectorBounds bounds = computeVectorBounds(*scene, scale);
+    float padding = 40.0f;
+    float vbX = bounds.minX - padding;
+    float vbY = bounds.minY - padding;
+    float vbW = (bounds.maxX - bounds.minX) + 2.0f * padding;
+    float vbH = (bounds.maxY - bounds.minY) + 2.0f * padding;
+
+    // Binary comment line marks the file as 8-bit for transfer tools
+    out << "%PDF-1.4\n%\xE2\xE3\xCF\xD3\n";
+
+    // --- Page content ---
+    doc.beginObject(kContentObject);
+    out << "<< /Length " << kContentLengthObject << " 0 R >>\nstream\n";
+    size_t contentStart = out.tell();
+    // Flip to the SVG's y-down coordinates, so every number below matches exportSvg
+    out << "1 0 0 -1 " << fmt(-vbX) << ' ' << fmt(vbY + vbH) << " cm\n";
+
+    // Optical axis
+    if (opts.showOpticalAxis) {
+        OpticalAxis axis = detectOpticalAxis(scene->getElements());
+        if (axis.valid) {
+            out << "q 0.5 0.5 0.5 RG 0.8 w [6 4] 0 d\n"
+                << fmt(axis.start.x * scale) << ' ' << fmt(-axis.start.y * scale) << " m "
+                << fmt(axis.end.x * scale) << ' ' << fmt(-axis.end.y * scale) << " l S Q\n";
+        }
+    }
+
+    // Elements: one form per symbol type and size, placed per copy
+    for (const auto& elem : scene->getElements()) {
+        if (!elem->visible) continue;
+        int colorIdx = static_cast<int>(elem->type);
+        glm::vec3 color = (style && colorIdx < kElementTypeCount) ?
+            style->elementColors[colorIdx] : glm::vec3(0.5f);
+
+        for (int instance = 0; instance < elem->getInstanceCount(); instance++) {
+            SymbolPlacement place = placeSymbol(*elem, instance, scale);
+            std::string form = doc.formName(elem->type, place.w, place.h, color);
+            float c = 1.0f, s = 0.0f;
+            if (std::abs(place.rotDeg) > 0.1f) {
+                float angle = glm::radians(-place.rotDeg);
+                c = std::cos(angle);
+                s = std::sin(angle);
+            }
+            out << "q " << fmt(c, 4) << ' ' << fmt(s, 4) << ' ' << fmt(-s, 4) << ' ' << fmt(c, 4) << ' '
+                << fmt(place.cx) << ' ' << fmt(place.cy) << " cm " << form << " Do Q\n";
+
+            if (instance == 0 && elem->showLabel)
+                writeText(out, place.cx, place.cy + place.h / 2 + 12, 10.0f, elem->label, color, true);
+        }
+    }
+
+    // Beams
+    for (const auto& beam : scene->getBeams()) {
+        if (!beam->visible) continue;
+
+        float sx = beam->start.x * scale;
+        float sy = -beam->start.z * scale;
+        float ex = beam->end.x * scale;
+        float ey = -beam->end.z * scale;
+        out << "q " << PdfRgb{beam->color} << " RG " << PdfRgb{beam->color} << " rg\n";
+
+        if (beam->isGaussian) {
+            float beamLen = beam->getLength();
+            if (beamLen > 1e-6f) {
+                glm::vec3 dir = beam->getDirection();
+                glm::vec3 perp(-dir.z, 0.0f, dir.x);
+
+                const int nSamples = 32;
+                std::vector<glm::vec2> upper, lower;
+                for (int i = 0; i <= nSamples; ++i) {
+                    float t = static_cast<float>(i) / nSamples;
+                    float dist = t * beamLen;
+                    float zFromWaist = dist - beam->waistPosition * beamLen;
+                    float zM = std::abs(zFromWaist) * 0.001f;
+                    float radiusMM = beam->beamRadiusAt(zM) * 1000.0f;
+
+                    glm::vec3 center = beam->start + dir * dist;
+                    glm::vec3 up = center + perp * radiusMM;
+                    glm::vec3 dn = center - perp * radiusMM;
+                    upper.push_back({up.x * scale, -up.z * scale});
+                    lower.push_back({dn.x * scale, -dn.z * scale});
+                }
+
+                out << doc.opacityState(0.15f, false) << " gs\n";
+                out << fmt(upper[0].x) << ' ' << fmt(upper[0].y) << " m\n";
+                for (size_t i = 1; i < upper.size(); ++i) out << fmt(upper[i].x) << ' ' << fmt(upper[i].y) << " l\n";
+                for (int i = static_cast<int>(lower.size()) - 1; i >= 0; --i)
+                    out << fmt(lower[i].x) << ' ' << fmt(lower[i].y) << " l\n";
+                out << "h f " << doc.opacityState(1.0f, false) << " gs\n";
+            }
+        }
+
+        // Centerline with arrowhead; the line stops where the head begins
+        float dx = ex - sx, dy = ey - sy;
+        float len = std::sqrt(dx * dx + dy * dy);
+        float shorten = len > 20.0f ? 20.0f / len : 0.0f;
+        out << "2 w " << fmt(sx) << ' ' << fmt(sy) << " m " << fmt(ex - dx * shorten) << ' '
+            << fmt(ey - dy * shorten) << " l S\n";
+        writeArrowhead(out, ex, ey, dx, dy, 2.0f);
+        out << "Q\n";
+    }
+
+    // Traced rays as merged polylines; consecutive runs share stroke state
+    std::vector<TracedPath> runs = buildTracedPaths(scene->getTracedRays(), opts.pathTolerance);
+    if (!runs.empty()) {
+        out << "q 2 w 1 j\n";
+        glm::vec3 lastColor(-1.0f);
+        std::string lastState;
+        for (const TracedPath& run : runs) {
+            if (run.color != lastColor) {
+                out << PdfRgb{run.color} << " RG\n";
+                lastColor = run.color;
+            }
+            std::string state = doc.opacityState(std::clamp(run.intensity, 0.15f, 1.0f), true);
+            if (state != lastState) {
+                out << state << " gs\n";
+                lastState = state;
+            }
+            for (size_t i = 0; i < run.points.size(); i++) {
+                out << fmt(run.points[i].x * scale) << ' ' << fmt(-run.points[i].z * scale)
+                    << (i == 0 ? " m\n" : " l\n");
+            }
+            out << "S\n";
+        }
+        out << "Q\n";
+    }
+
+    // Annotations
+    for (const auto& ann : scene->getAnnotations()) {
+        if (!ann->visible) continue;
+        writeText(out, ann->position.x * scale, -ann->position.z * scale, std::round(ann->fontSize),
+                  ann->text, ann->color, false);
+    }
+
+    // Measurements: dimension line with arrowheads at both ends and the distance above
+    for (const auto& meas : scene->getMeasurements()) {
+        if (!meas->visible) continue;
+
+        float sx = meas->startPoint.x * scale;
+        float sy = -meas->startPoint.z * scale;
+        float ex = meas->endPoint.x * scale;
+        float ey = -meas->endPoint.z * scale;
+        out << "q " << PdfRgb{meas->color} << " RG " << PdfRgb{meas->color} << " rg 1 w\n";
+        out << fmt(sx) << ' ' << fmt(sy) << " m " << fmt(ex) << ' ' << fmt(ey) << " l S\n";
+        writeArrowhead(out, ex, ey, ex - sx, ey - sy, 1.0f);
+        writeArrowhead(out, sx, sy, sx - ex, sy - ey, 1.0f);
+        out << "Q\n";
+
+        std::string distStr;
+        appendNumber(distStr, FixedNumber{meas->getDistance(), 1});
+        distStr += " mm";
+        writeText(out, (sx + ex) / 2.0f, (sy + ey) / 2.0f - 4, std::round(meas->fontSize), distStr,
+                  meas->color, true);
+    }
+
+    // Scale bar
+    if (opts.showScaleBar) {
+        float sceneExtent = std::max(bounds.maxX - bounds.minX, bounds.maxY - bounds.minY) / scale;
+        ScaleBar bar = chooseScaleBar(sceneExtent);
+        renderScaleBarPdf(out, bar, scale, bounds.maxX - bar.lengthMm * scale, bounds.maxY + 20.0f);
+    }
+
+    size_t contentLength = out.tell() - contentStart;
+    out << "endstream\nendobj\n";
+    doc.writeLength(kContentLengthObject, contentLength);
+
+    // --- Symbols, resources and document structure ---
+    doc.writeForms();
+    doc.writeResources();
+
+    doc.beginObject(kFontObject);
+    out << "<< /Type /Font /Subtype /Type1 /BaseFont /Times-Roman /Encoding /WinAnsiEncoding >>\nendobj\n";
+    doc.beginObject(kPageObject);
+    out << "<< /Type /Page /Parent " << kPagesObject << " 0 R /MediaBox [0 0 " << fmt(vbW) << ' ' << fmt(vbH)
+        << "] /Resources " << kResourcesObject << " 0 R /Contents " << kContentObject << " 0 R >>\nendobj\n";
+    doc.beginObject(kPagesObject);
+    out << "<< /Type /Pages /Kids [" << kPageObject << " 0 R] /Count 1 >>\nendobj\n";
+    doc.beginObject(kCatalogObject);
+    out << "<< /Type /Catalog /Pages " << kPagesObject << " 0 R >>\nendobj\n";
+    doc.writeXref();
+
+    return out.close();
+}
+
+} // namespace opticsketch
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+namespace opticsketch {
+
+class Scene;
+struct SceneStyle;
+
+struct PdfExportOptions {
+    bool showOpticalAxis = true;
+    bool showScaleBar = true;
+    // Traced rays are merged into polylines; interior points within this distance
+    // (world units) of a straight run are dropped
+    float pathTolerance = 0.0f;
+};
+
+// Export scene as a single-page vector PDF: the same top-down (XZ) figure as exportSvg,
+// drawn with PDF path operators. Each distinct element symbol (type and size) is written
+// once as a form XObject and placed per copy; text uses the standard Times-Roman font.
+// Returns true on success.
+bool exportPdf(const std::string& path, Scene* scene, SceneStyle* style,
+               const PdfExportOptions& opts = {});
+
+} // namespace opticsketch
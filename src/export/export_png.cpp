@@ -26,6 +26,11 @@ bool savePngToFile(const std::string& path, int width, int height, const unsigne
     return stbi_write_png(path.c_str(), width, height, 3, flipped.data(), width * 3) != 0;
 }
 
+bool savePngToFileTopDown(const std::string& path, int width, int height, const unsigned char* dataRGB) {
+    if (!dataRGB || width <= 0 || height <= 0) return false;
+    return stbi_write_png(path.c_str(), width, height, 3, dataRGB, width * 3) != 0;
+}
+
 bool saveJpgToFile(const std::string& path, int width, int height, const unsigned char* dataRGB, int quality) {
     if (!dataRGB || width <= 0 || height <= 0) return false;
     if (quality < 1) quality = 1;
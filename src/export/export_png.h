@@ -9,6 +9,10 @@ namespace opticsketch {
 // Returns true on success.
 bool savePngToFile(const std::string& path, int width, int height, const unsigned char* dataRGB);
 
+// Same as savePngToFile for rows already in top-down order (no flip copy).
+// Safe to call from worker threads.
+bool savePngToFileTopDown(const std::string& path, int width, int height, const unsigned char* dataRGB);
+
 // Write RGB image to JPEG file.
 // dataRGB: width * height * 3 bytes, row-major, bottom-up (OpenGL glReadPixels order).
 // quality: 1-100 (higher = better quality, larger file).
@@ -1,43 +1,51 @@
 #include "export/export_svg.h"
 #include "export/optical_symbols.h"
+#include "export/text_writer.h"
+#include "export/vector_paths.h"
 #include "scene/scene.h"
 #include "elements/element.h"
 #include "elements/annotation.h"
 #include "elements/measurement.h"
+#include "profile/profiler.h"
 #include "render/beam.h"
 #include "style/scene_style.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
 
 namespace opticsketch {
 
+static int toByte(float v) {
+    return static_cast<int>(std::round(v * 255.0f));
+}
+
+// rgb(r,g,b), written straight into the output
+struct SvgRgb {
+    const glm::vec3& color;
+};
+
+static TextWriter& operator<<(TextWriter& out, SvgRgb c) {
+    return out << "rgb(" << toByte(c.color.x) << ',' << toByte(c.color.y) << ',' << toByte(c.color.z) << ')';
+}
+
+// The same as a string, for a color reused by a whole element symbol
 static std::string colorToSvg(const glm::vec3& c) {
-    int r = static_cast<int>(std::round(c.x * 255.0f));
-    int g = static_cast<int>(std::round(c.y * 255.0f));
-    int b = static_cast<int>(std::round(c.z * 255.0f));
-    std::ostringstream oss;
-    oss << "rgb(" << r << "," << g << "," << b << ")";
-    return oss.str();
+    return "rgb(" + std::to_string(toByte(c.x)) + "," + std::to_string(toByte(c.y)) + "," +
+           std::to_string(toByte(c.z)) + ")";
 }
 
 static std::string colorToSvgFill(const glm::vec3& c, float opacity = 0.2f) {
-    int r = static_cast<int>(std::round(c.x * 255.0f));
-    int g = static_cast<int>(std::round(c.y * 255.0f));
-    int b = static_cast<int>(std::round(c.z * 255.0f));
-    std::ostringstream oss;
-    oss << "rgba(" << r << "," << g << "," << b << "," << opacity << ")";
-    return oss.str();
+    std::string result = "rgba(" + std::to_string(toByte(c.x)) + "," + std::to_string(toByte(c.y)) + "," +
+                         std::to_string(toByte(c.z)) + ",";
+    appendNumber(result, GeneralNumber{opacity});
+    result += ")";
+    return result;
 }
 
-static std::string fmt(float v, int prec = 2) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(prec) << v;
-    return oss.str();
+static FixedNumber fmt(float v, int prec = 2) {
+    return FixedNumber{v, prec};
 }
 
 static std::string escapeXml(const std::string& text) {
@@ -59,46 +67,17 @@ static std::string escapeXml(const std::string& text) {
 bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
                const SvgExportOptions& opts) {
     if (!scene) return false;
+    OPTICSKETCH_PROFILE_SCOPE("exportSvg");
 
-    std::ofstream out(path);
-    if (!out.is_open()) return false;
+    TextWriter out;
+    if (!out.open(path)) return false;
 
     // Scale: 25mm grid -> 40px (so 1mm = 1.6px)
     const float scale = 1.6f;
 
-    // Compute bounding box of all visible scene content
-    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
-
-    auto expandBounds = [&](float x, float y) {
-        if (x < minX) minX = x;
-        if (x > maxX) maxX = x;
-        if (y < minY) minY = y;
-        if (y > maxY) maxY = y;
-    };
-
-    for (const auto& elem : scene->getElements()) {
-        if (!elem->visible) continue;
-        glm::vec3 wMin, wMax;
-        elem->getWorldBounds(wMin, wMax);
-        expandBounds(wMin.x * scale, -wMax.z * scale);
-        expandBounds(wMax.x * scale, -wMin.z * scale);
-    }
-    for (const auto& beam : scene->getBeams()) {
-        if (!beam->visible) continue;
-        expandBounds(beam->start.x * scale, -beam->start.z * scale);
-        expandBounds(beam->end.x * scale, -beam->end.z * scale);
-    }
-    for (const auto& ann : scene->getAnnotations()) {
-        if (!ann->visible) continue;
-        expandBounds(ann->position.x * scale, -ann->position.z * scale);
-    }
-    for (const auto& meas : scene->getMeasurements()) {
-        if (!meas->visible) continue;
-        expandBounds(meas->startPoint.x * scale, -meas->startPoint.z * scale);
-        expandBounds(meas->endPoint.x * scale, -meas->endPoint.z * scale);
-    }
-
-    if (minX > maxX) { minX = 0; maxX = 100; minY = 0; maxY = 100; }
+    VectorBounds bounds = computeVectorBounds(*scene, scale);
+    float minX = bounds.minX, minY = bounds.minY, maxX = bounds.maxX, maxY = bounds.maxY;
+    const TracedRayBuffer& traced = scene->getTracedRays();
 
     float padding = 40.0f;
     float vbX = minX - padding;
@@ -145,36 +124,28 @@ bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
     for (const auto& elem : scene->getElements()) {
         if (!elem->visible) continue;
 
-        // XZ projection: world X -> SVG X, world Z -> SVG Y (inverted)
-        float cx = elem->transform.position.x * scale;
-        float cy = -elem->transform.position.z * scale;
-
-        // Y-axis rotation
-        glm::vec3 euler = glm::eulerAngles(elem->transform.rotation);
-        float rotDeg = glm::degrees(euler.y);
-
-        // Size
-        float w = (elem->boundsMax.x - elem->boundsMin.x) * elem->transform.scale.x * scale;
-        float h = (elem->boundsMax.z - elem->boundsMin.z) * elem->transform.scale.z * scale;
-        if (w < 4.0f) w = 16.0f;
-        if (h < 4.0f) h = 16.0f;
-
-        int colorIdx = static_cast<int>(elem->type);
-        glm::vec3 color = (style && colorIdx < kElementTypeCount) ?
-            style->elementColors[colorIdx] : glm::vec3(0.5f);
-        std::string strokeColor = colorToSvg(color);
-        std::string fillColor = colorToSvgFill(color, 0.2f);
-
-        // Render using optical symbol
-        OpticalSymbol sym = getOpticalSymbol(elem->type);
-        out << renderSymbolSvg(sym, cx, cy, w, h, rotDeg, strokeColor, fillColor);
-
-        // Label
-        if (elem->showLabel) {
-            out << "  <text x=\"" << fmt(cx) << "\" y=\"" << fmt(cy + h / 2 + 12)
-                << "\" text-anchor=\"middle\" font-size=\"10\" font-family=\"serif\" fill=\""
-                << strokeColor << "\">"
-                << escapeXml(elem->label) << "</text>\n";
+        // Arrayed elements draw one symbol per copy and label the prototype
+        for (int instance = 0; instance < elem->getInstanceCount(); instance++) {
+            SymbolPlacement place = placeSymbol(*elem, instance, scale);
+            float cx = place.cx, cy = place.cy, w = place.w, h = place.h;
+
+            int colorIdx = static_cast<int>(elem->type);
+            glm::vec3 color = (style && colorIdx < kElementTypeCount) ?
+                style->elementColors[colorIdx] : glm::vec3(0.5f);
+            std::string strokeColor = colorToSvg(color);
+            std::string fillColor = colorToSvgFill(color, 0.2f);
+
+            // Render using optical symbol
+            OpticalSymbol sym = getOpticalSymbol(elem->type);
+            renderSymbolSvg(out, sym, cx, cy, w, h, place.rotDeg, strokeColor, fillColor);
+
+            // Label
+            if (instance == 0 && elem->showLabel) {
+                out << "  <text x=\"" << fmt(cx) << "\" y=\"" << fmt(cy + h / 2 + 12)
+                    << "\" text-anchor=\"middle\" font-size=\"10\" font-family=\"serif\" fill=\""
+                    << strokeColor << "\">"
+                    << escapeXml(elem->label) << "</text>\n";
+            }
         }
     }
     out << "</g>\n\n";
@@ -189,7 +160,7 @@ bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
         float sy = -beam->start.z * scale;
         float ex = beam->end.x * scale;
         float ey = -beam->end.z * scale;
-        std::string beamColor = colorToSvg(beam->color);
+        SvgRgb beamColor{beam->color};
 
         if (beam->isGaussian) {
             float beamLen = beam->getLength();
@@ -231,6 +202,15 @@ bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
             << "\" stroke=\"" << beamColor << "\" stroke-width=\"2\" "
             << "marker-end=\"url(#arrowhead)\" />\n";
     }
+    for (const TracedPath& run : buildTracedPaths(traced, opts.pathTolerance)) {
+        out << "  <polyline points=\"";
+        for (size_t i = 0; i < run.points.size(); i++) {
+            if (i > 0) out << ' ';
+            out << fmt(run.points[i].x * scale) << ',' << fmt(-run.points[i].z * scale);
+        }
+        out << "\" fill=\"none\" stroke=\"" << SvgRgb{run.color} << "\" stroke-width=\"2\" "
+            << "stroke-linejoin=\"round\" stroke-opacity=\"" << fmt(std::clamp(run.intensity, 0.15f, 1.0f)) << "\" />\n";
+    }
     out << "</g>\n\n";
 
     // --- Annotations ---
@@ -244,7 +224,7 @@ bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
 
         out << "  <text x=\"" << fmt(ax) << "\" y=\"" << fmt(ay)
             << "\" font-size=\"" << fmt(ann->fontSize, 0) << "\" font-family=\"serif\" fill=\""
-            << colorToSvg(ann->color) << "\">"
+            << SvgRgb{ann->color} << "\">"
             << escapeXml(ann->text) << "</text>\n";
     }
     out << "</g>\n\n";
@@ -259,10 +239,11 @@ bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
         float sy = -meas->startPoint.z * scale;
         float ex = meas->endPoint.x * scale;
         float ey = -meas->endPoint.z * scale;
-        std::string measColor = colorToSvg(meas->color);
+        SvgRgb measColor{meas->color};
 
-        std::ostringstream distStr;
-        distStr << std::fixed << std::setprecision(1) << meas->getDistance() << " mm";
+        std::string distStr;
+        appendNumber(distStr, FixedNumber{meas->getDistance(), 1});
+        distStr += " mm";
 
         // Dimension line with arrowheads at both ends
         out << "  <line x1=\"" << fmt(sx) << "\" y1=\"" << fmt(sy)
@@ -276,7 +257,7 @@ bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
         out << "  <text x=\"" << fmt(mx) << "\" y=\"" << fmt(my - 4)
             << "\" text-anchor=\"middle\" font-size=\"" << fmt(meas->fontSize, 0)
             << "\" font-family=\"serif\" fill=\"" << measColor << "\">"
-            << escapeXml(distStr.str()) << "</text>\n";
+            << escapeXml(distStr) << "</text>\n";
     }
     out << "</g>\n\n";
 
@@ -287,12 +268,12 @@ bool exportSvg(const std::string& path, Scene* scene, SceneStyle* style,
         // Position at bottom-right
         float sbX = maxX - bar.lengthMm * scale;
         float sbY = maxY + 20.0f;
-        out << renderScaleBarSvg(bar, scale, sbX, sbY);
+        renderScaleBarSvg(out, bar, scale, sbX, sbY);
     }
 
     out << "</svg>\n";
 
-    return out.good();
+    return out.close();
 }
 
 } // namespace opticsketch
@@ -10,6 +10,9 @@ struct SceneStyle;
 struct SvgExportOptions {
     bool showOpticalAxis = true;
     bool showScaleBar = true;
+    // Traced rays are merged into polylines; interior points within this distance
+    // (world units) of a straight run are dropped
+    float pathTolerance = 0.0f;
 };
 
 // Export scene as an SVG file.
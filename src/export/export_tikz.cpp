@@ -1,46 +1,50 @@
 #include "export/export_tikz.h"
 #include "export/optical_symbols.h"
+#include "export/text_writer.h"
+#include "export/vector_paths.h"
 #include "scene/scene.h"
 #include "elements/element.h"
 #include "elements/annotation.h"
 #include "elements/measurement.h"
+#include "profile/profiler.h"
 #include "render/beam.h"
 #include "style/scene_style.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
 
 namespace opticsketch {
 
-// Convert glm::vec3 color [0,1] to LaTeX {rgb,255:r,g,b} format
-static std::string colorToTikz(const glm::vec3& c) {
-    int r = static_cast<int>(std::round(c.x * 255.0f));
-    int g = static_cast<int>(std::round(c.y * 255.0f));
-    int b = static_cast<int>(std::round(c.z * 255.0f));
-    std::ostringstream oss;
-    oss << "{rgb,255:red," << r << ";green," << g << ";blue," << b << "}";
-    return oss.str();
+static int toByte(float v) {
+    return static_cast<int>(std::round(v * 255.0f));
 }
 
-// Define a named color in the preamble
-static std::string defineColor(const std::string& name, const glm::vec3& c) {
-    int r = static_cast<int>(std::round(c.x * 255.0f));
-    int g = static_cast<int>(std::round(c.y * 255.0f));
-    int b = static_cast<int>(std::round(c.z * 255.0f));
-    std::ostringstream oss;
-    oss << "\\definecolor{" << name << "}{RGB}{" << r << "," << g << "," << b << "}";
-    return oss.str();
+// glm::vec3 color [0,1] in LaTeX {rgb,255:r,g,b} format, written straight into the output
+struct TikzRgb {
+    const glm::vec3& color;
+};
+
+static TextWriter& operator<<(TextWriter& out, TikzRgb c) {
+    return out << "{rgb,255:red," << toByte(c.color.x) << ";green," << toByte(c.color.y)
+               << ";blue," << toByte(c.color.z) << '}';
+}
+
+// Definition of a named color (preamble or a local scope)
+struct ColorDefinition {
+    std::string_view name;
+    const glm::vec3& color;
+};
+
+static TextWriter& operator<<(TextWriter& out, ColorDefinition d) {
+    return out << "\\definecolor{" << d.name << "}{RGB}{" << toByte(d.color.x) << ','
+               << toByte(d.color.y) << ',' << toByte(d.color.z) << '}';
 }
 
 // Format a float with fixed precision
-static std::string fmt(float v, int prec = 3) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(prec) << v;
-    return oss.str();
+static FixedNumber fmt(float v, int prec = 3) {
+    return FixedNumber{v, prec};
 }
 
 // Escape special LaTeX characters in text
@@ -68,9 +72,10 @@ static std::string escapeLatex(const std::string& text) {
 bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
                 const TikzExportOptions& opts) {
     if (!scene) return false;
+    OPTICSKETCH_PROFILE_SCOPE("exportTikz");
 
-    std::ofstream out(path);
-    if (!out.is_open()) return false;
+    TextWriter out;
+    if (!out.open(path)) return false;
 
     // Scale factor: world units (mm) to tikz cm
     const float scale = 1.0f / 25.0f; // 25mm grid spacing -> 1cm in tikz
@@ -85,7 +90,8 @@ bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
     out << "% Element colors\n";
     if (style) {
         for (int i = 0; i < kElementTypeCount; ++i) {
-            out << defineColor("elemcolor" + std::to_string(i), style->elementColors[i]) << "\n";
+            std::string name = "elemcolor" + std::to_string(i);
+            out << ColorDefinition{name, style->elementColors[i]} << "\n";
         }
     }
     out << "\n";
@@ -116,33 +122,37 @@ bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
     for (const auto& elem : scene->getElements()) {
         if (!elem->visible) continue;
 
-        // XZ projection: world X -> tikz X, world Z -> tikz Y
-        float tx = elem->transform.position.x * scale;
-        float ty = elem->transform.position.z * scale;
-
-        // Extract Y-axis rotation angle from quaternion
-        glm::vec3 euler = glm::eulerAngles(elem->transform.rotation);
-        float rotDeg = glm::degrees(euler.y);
-
-        // Size from bounds and scale
-        float w = (elem->boundsMax.x - elem->boundsMin.x) * elem->transform.scale.x * scale;
-        float h = (elem->boundsMax.z - elem->boundsMin.z) * elem->transform.scale.z * scale;
-        if (w < 0.1f) w = 0.4f;
-        if (h < 0.1f) h = 0.4f;
-
-        int colorIdx = static_cast<int>(elem->type);
-        std::string colorName = (style && colorIdx < kElementTypeCount) ?
-            "elemcolor" + std::to_string(colorIdx) : "black";
-
-        // Render using optical symbol
-        OpticalSymbol sym = getOpticalSymbol(elem->type);
-        out << renderSymbolTikz(sym, tx, ty, w, h, rotDeg, colorName);
-
-        // Label below the element
-        if (elem->showLabel) {
-            out << "\\node[below, " << colorName << "] at ("
-                << fmt(tx, 3) << "," << fmt(ty - h / 2.0f - 0.15f, 3) << ") {"
-                << escapeLatex(elem->label) << "};\n";
+        // Arrayed elements draw one symbol per copy and label the prototype
+        for (int instance = 0; instance < elem->getInstanceCount(); instance++) {
+            const Transform t = elem->getInstanceTransform(instance);
+            // XZ projection: world X -> tikz X, world Z -> tikz Y
+            float tx = t.position.x * scale;
+            float ty = t.position.z * scale;
+
+            // Extract Y-axis rotation angle from quaternion
+            glm::vec3 euler = glm::eulerAngles(t.rotation);
+            float rotDeg = glm::degrees(euler.y);
+
+            // Size from bounds and scale
+            float w = (elem->boundsMax.x - elem->boundsMin.x) * t.scale.x * scale;
+            float h = (elem->boundsMax.z - elem->boundsMin.z) * t.scale.z * scale;
+            if (w < 0.1f) w = 0.4f;
+            if (h < 0.1f) h = 0.4f;
+
+            int colorIdx = static_cast<int>(elem->type);
+            std::string colorName = (style && colorIdx < kElementTypeCount) ?
+                "elemcolor" + std::to_string(colorIdx) : "black";
+
+            // Render using optical symbol
+            OpticalSymbol sym = getOpticalSymbol(elem->type);
+            renderSymbolTikz(out, sym, tx, ty, w, h, rotDeg, colorName);
+
+            // Label below the element
+            if (instance == 0 && elem->showLabel) {
+                out << "\\node[below, " << colorName << "] at ("
+                    << fmt(tx, 3) << "," << fmt(ty - h / 2.0f - 0.15f, 3) << ") {"
+                    << escapeLatex(elem->label) << "};\n";
+            }
         }
     }
     out << "\n";
@@ -157,9 +167,9 @@ bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
         float ex = beam->end.x * scale;
         float ey = beam->end.z * scale;
 
-        std::string beamColor = defineColor("beamcol_" + beam->id, beam->color);
         // Inline color definition
-        out << "{ " << beamColor << "\n";
+        std::string beamColorName = "beamcol_" + beam->id;
+        out << "{ " << ColorDefinition{beamColorName, beam->color} << "\n";
 
         if (beam->isGaussian) {
             // Draw Gaussian envelope as a filled path
@@ -205,6 +215,17 @@ bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
             << fmt(ex, 3) << "," << fmt(ey, 3) << ");\n";
         out << "}\n";
     }
+    const TracedRayBuffer& traced = scene->getTracedRays();
+    for (const TracedPath& run : buildTracedPaths(traced, opts.pathTolerance)) {
+        out << "{ " << ColorDefinition{"tracedcol", run.color} << "\n";
+        out << "  \\draw[tracedcol, thick, opacity=" << fmt(std::clamp(run.intensity, 0.15f, 1.0f), 2) << "] ";
+        for (size_t i = 0; i < run.points.size(); i++) {
+            if (i > 0) out << " -- ";
+            out << '(' << fmt(run.points[i].x * scale, 3) << "," << fmt(run.points[i].z * scale, 3) << ')';
+        }
+        out << ";\n";
+        out << "}\n";
+    }
     out << "\n";
 
     // --- Annotations ---
@@ -215,7 +236,7 @@ bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
         float ax = ann->position.x * scale;
         float ay = ann->position.z * scale;
 
-        out << "\\node[anchor=south west, text=" << colorToTikz(ann->color)
+        out << "\\node[anchor=south west, text=" << TikzRgb{ann->color}
             << "] at (" << fmt(ax, 3) << "," << fmt(ay, 3) << ") {"
             << escapeLatex(ann->text) << "};\n";
     }
@@ -231,12 +252,13 @@ bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
         float ex = meas->endPoint.x * scale;
         float ey = meas->endPoint.z * scale;
 
-        std::ostringstream distStr;
-        distStr << std::fixed << std::setprecision(1) << meas->getDistance() << " mm";
+        std::string distStr;
+        appendNumber(distStr, FixedNumber{meas->getDistance(), 1});
+        distStr += " mm";
 
-        out << "\\draw[<->, " << colorToTikz(meas->color) << "] ("
+        out << "\\draw[<->, " << TikzRgb{meas->color} << "] ("
             << fmt(sx, 3) << "," << fmt(sy, 3) << ") -- node[midway, above, sloped] {"
-            << escapeLatex(distStr.str()) << "} ("
+            << escapeLatex(distStr) << "} ("
             << fmt(ex, 3) << "," << fmt(ey, 3) << ");\n";
     }
     out << "\n";
@@ -265,14 +287,14 @@ bool exportTikz(const std::string& path, Scene* scene, SceneStyle* style,
                 if (z < minZ) minZ = z;
             }
             barY = minZ - 0.8f;
-            out << renderScaleBarTikz(bar, scale, barX, barY);
+            renderScaleBarTikz(out, bar, scale, barX, barY);
         }
     }
 
     out << "\\end{tikzpicture}\n";
     out << "\\end{document}\n";
 
-    return out.good();
+    return out.close();
 }
 
 } // namespace opticsketch
@@ -0,0 +1,224 @@
+#include "export/frame_pipeline.h"
+#include "export/export_png.h"
+#include "jobs/job_system.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <csignal>
+#endif
+
+namespace opticsketch {
+
+FramePipeline::FramePipeline(int encoderThreads) {
+    if (encoderThreads <= 0) encoderThreads = std::clamp(JobSystem::resolveThreadCount(0) - 1, 1, 8);
+    this->encoderThreads = encoderThreads;
+}
+
+bool FramePipeline::openPipe(const std::string& command, int width, int height) {
+    if (pipe || maxEncoders > 0 || width <= 0 || height <= 0) return false;
+#ifdef _WIN32
+    pipe = popen(command.c_str(), "wb");
+#else
+    // An encoder that exits early must not take the editor down with it on the next write
+    std::signal(SIGPIPE, SIG_IGN);
+    pipe = popen(command.c_str(), "w");
+#endif
+    if (!pipe) {
+        std::cerr << "Failed to start: " << command << "\n";
+        return false;
+    }
+    pipeWidth = width;
+    pipeHeight = height;
+    return true;
+}
+
+bool FramePipeline::closePipe() {
+    if (!pipe) return false;
+    int status = pclose(pipe);
+    pipe = nullptr;
+    return status == 0;
+}
+
+FramePipeline::~FramePipeline() {
+    cancel();
+    {
+        // Encoder jobs reference this pipeline until they check out
+        std::unique_lock<std::mutex> lock(mutex);
+        spaceReady.wait(lock, [this] { return activeEncoders == 0; });
+    }
+    if (pipe) closePipe();
+    releaseGL();
+}
+
+void FramePipeline::releaseGL() {
+    for (Readback& slot : slots) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.pbo) glDeleteBuffers(1, &slot.pbo);
+        slot = Readback{};
+    }
+}
+
+void FramePipeline::submit(GLuint texture, int width, int height, const std::string& path) {
+    if (texture == 0 || width <= 0 || height <= 0) return;
+    if (pipe && (width != pipeWidth || height != pipeHeight)) {
+        // Raw video has a fixed frame size; a resized viewport cannot be streamed
+        std::cerr << "Frame size changed during export, frame skipped\n";
+        failed++;
+        return;
+    }
+    if (maxEncoders == 0) {
+        // A pipe takes frames in order, so it gets a single writer
+        maxEncoders = pipe ? 1 : encoderThreads;
+        // Enough queued frames to keep every encoder busy while the next ones are read back
+        maxQueued = static_cast<size_t>(maxEncoders) * 2;
+    }
+    Readback& slot = slots[nextSlot];
+    nextSlot = (nextSlot + 1) % kReadbackSlots;
+    // The ring is full: the oldest readback has had two frames to complete
+    if (slot.busy) retire(slot);
+
+    size_t bytes = static_cast<size_t>(width) * height * 3;
+    if (slot.pbo == 0) glGenBuffers(1, &slot.pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.capacity != bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+    // With a pack buffer bound the read is queued on the GPU and returns immediately
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.path = path;
+    slot.busy = true;
+}
+
+void FramePipeline::retire(Readback& slot) {
+    slot.busy = false;
+    if (slot.fence) {
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(10) * 1000000000);
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    Frame frame;
+    frame.path = std::move(slot.path);
+    frame.width = slot.width;
+    frame.height = slot.height;
+    {
+        // Wait for room before taking a buffer, which bounds the memory in flight
+        std::unique_lock<std::mutex> lock(mutex);
+        spaceReady.wait(lock, [this] { return queue.size() < maxQueued; });
+        if (!freeBuffers.empty()) {
+            frame.pixels = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+        }
+    }
+
+    const size_t rowBytes = static_cast<size_t>(frame.width) * 3;
+    frame.pixels.resize(rowBytes * frame.height);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const auto* src = static_cast<const unsigned char*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(slot.capacity), GL_MAP_READ_BIT));
+    bool mapped = src != nullptr;
+    if (mapped) {
+        // Flip to top-down while copying out of the mapping (GL rows are bottom-up)
+        for (int y = 0; y < frame.height; y++)
+            std::memcpy(&frame.pixels[static_cast<size_t>(y) * rowBytes],
+                        src + static_cast<size_t>(frame.height - 1 - y) * rowBytes, rowBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (!mapped) {
+        std::cerr << "Frame readback failed: " << frame.path << "\n";
+        failed++;
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(std::move(frame.pixels));
+        return;
+    }
+    bool startEncoder = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(frame));
+        // A running encoder picks the frame up; otherwise start one, up to the limit
+        if (activeEncoders < maxEncoders) {
+            activeEncoders++;
+            startEncoder = true;
+        }
+    }
+    if (startEncoder)
+        JobSystem::instance().submit("", JobPriority::Normal, [this](JobContext&) { drainQueue(); });
+}
+
+void FramePipeline::finish() {
+    // Retire in submission order: nextSlot is the oldest
+    for (int i = 0; i < kReadbackSlots; i++) {
+        Readback& slot = slots[(nextSlot + i) % kReadbackSlots];
+        if (slot.busy) retire(slot);
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    spaceReady.wait(lock, [this] { return queue.empty() && encoding == 0; });
+}
+
+void FramePipeline::cancel() {
+    for (Readback& slot : slots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        slot.busy = false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.clear();
+    spaceReady.notify_all();
+}
+
+bool FramePipeline::writeFrame(const Frame& frame) {
+    if (pipe) {
+        if (std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), pipe) == frame.pixels.size()) return true;
+        std::cerr << "Failed to stream frame to encoder\n";
+        return false;
+    }
+    if (savePngToFileTopDown(frame.path, frame.width, frame.height, frame.pixels.data())) return true;
+    std::cerr << "Failed to write frame: " << frame.path << "\n";
+    return false;
+}
+
+void FramePipeline::drainQueue() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!queue.empty()) {
+        Frame frame = std::move(queue.front());
+        queue.pop_front();
+        encoding++;
+        lock.unlock();
+        spaceReady.notify_all();
+
+        if (writeFrame(frame)) {
+            written++;
+        } else {
+            failed++;
+        }
+
+        lock.lock();
+        encoding--;
+        freeBuffers.push_back(std::move(frame.pixels));
+        spaceReady.notify_all();
+    }
+    // Checked out under the lock: once it is released the pipeline may be destroyed
+    activeEncoders--;
+    spaceReady.notify_all();
+}
+
+} // namespace opticsketch
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+// Pipelined frame writer for animation export. submit() only queues an asynchronous
+// readback of the rendered texture into one of a ring of pixel-pack buffers; the pixels
+// are mapped a few frames later, once the GPU has finished, and handed to encoder jobs
+// on the JobSystem pool that write the PNGs in parallel. The number of frames waiting
+// for an encoder is bounded, so submit() blocks instead of growing memory when encoding
+// falls behind. All GL calls happen on the thread that owns the context (submit/finish).
+// In pipe mode the frames are instead streamed as raw RGB, in order, into the stdin of
+// an external encoder (ffmpeg) by a single writer job.
+class FramePipeline {
+public:
+    // At most this many frames are encoded at once; <= 0 picks one per spare hardware thread
+    explicit FramePipeline(int encoderThreads = 0);
+    ~FramePipeline();   // discards frames not yet written
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Stream every frame of width x height into the stdin of 'command' instead of writing
+    // PNGs. Call before the first submit(); returns false if the process cannot be started.
+    bool openPipe(const std::string& command, int width, int height);
+    // Close the pipe after finish(); returns false if the encoder process failed
+    bool closePipe();
+    bool isPiped() const { return pipe != nullptr; }
+
+    // Start reading back an RGB texture of the given size; it is written to 'path'
+    // (ignored in pipe mode)
+    void submit(GLuint texture, int width, int height, const std::string& path);
+
+    // Read back and write everything submitted so far, then return
+    void finish();
+
+    // Drop queued frames (the ones being encoded still complete)
+    void cancel();
+
+    int getWrittenCount() const { return written.load(); }
+    int getFailedCount() const { return failed.load(); }
+
+private:
+    static constexpr int kReadbackSlots = 3;
+
+    struct Readback {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+        std::string path;
+        bool busy = false;
+    };
+    struct Frame {
+        std::string path;
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> pixels;   // top-down RGB
+    };
+
+    // Wait for a readback, copy it out flipped, and queue it for encoding
+    void retire(Readback& slot);
+    // Encoder job body: write queued frames until the queue is empty
+    void drainQueue();
+    bool writeFrame(const Frame& frame);
+    void releaseGL();
+
+    Readback slots[kReadbackSlots];
+    int nextSlot = 0;
+
+    std::mutex mutex;
+    std::condition_variable spaceReady;     // producer: queue below its bound / drained
+    std::deque<Frame> queue;
+    std::vector<std::vector<unsigned char>> freeBuffers;   // recycled pixel buffers
+    int encoderThreads = 1;
+    int maxEncoders = 0;        // set by the first submit(); 1 in pipe mode
+    int activeEncoders = 0;     // encoder jobs queued or running
+    size_t maxQueued = 2;
+    int encoding = 0;
+
+    FILE* pipe = nullptr;
+    int pipeWidth = 0;
+    int pipeHeight = 0;
+
+    std::atomic<int> written{0};
+    std::atomic<int> failed{0};
+};
+
+} // namespace opticsketch
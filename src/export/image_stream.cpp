@@ -0,0 +1,398 @@
+#include "export/image_stream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace opticsketch {
+
+static constexpr int kWindowSize = 32768;
+static constexpr int kWindowMask = kWindowSize - 1;
+static constexpr int kHashBits = 15;
+static constexpr int kMinMatch = 3;
+static constexpr int kMaxMatch = 258;
+static constexpr int kMaxChain = 32;                 // match candidates tried per position
+static constexpr size_t kDrainBytes = 256 * 1024;    // IDAT chunk size
+
+static const int kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                  513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                   8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static uint32_t hash3(const unsigned char* p) {
+    uint32_t v = (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// --- ScanlineDeflater ---
+
+ScanlineDeflater::ScanlineDeflater(int width)
+    : rowBytes(width * 3), prevRow(static_cast<size_t>(width) * 3, 0),
+      filtered(static_cast<size_t>(width) * 3 * 5), head(size_t(1) << kHashBits, -1), prev(kWindowSize, -1) {
+    out.push_back(0x78);   // zlib header: deflate, 32 KB window
+    out.push_back(0x01);
+}
+
+void ScanlineDeflater::filterRow(const unsigned char* row) {
+    // Adaptive filter choice as in libpng: the candidate with the smallest sum of
+    // absolute (signed) residuals
+    int best = 0;
+    long bestSum = -1;
+    for (int type = 0; type < 5; type++) {
+        unsigned char* dst = &filtered[static_cast<size_t>(type) * rowBytes];
+        long sum = 0;
+        for (int x = 0; x < rowBytes; x++) {
+            int a = x >= 3 ? row[x - 3] : 0;
+            int b = prevRow[x];
+            int c = x >= 3 ? prevRow[x - 3] : 0;
+            int predictor = 0;
+            switch (type) {
+                case 1: predictor = a; break;
+                case 2: predictor = b; break;
+                case 3: predictor = (a + b) >> 1; break;
+                case 4: {
+                    int p = a + b - c;
+                    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    break;
+                }
+                default: break;
+            }
+            dst[x] = static_cast<unsigned char>(row[x] - predictor);
+            sum += std::abs(static_cast<int>(static_cast<signed char>(dst[x])));
+        }
+        if (bestSum < 0 || sum < bestSum) {
+            bestSum = sum;
+            best = type;
+        }
+    }
+
+    const unsigned char* chosen = &filtered[static_cast<size_t>(best) * rowBytes];
+    window.push_back(static_cast<unsigned char>(best));
+    window.insert(window.end(), chosen, chosen + rowBytes);
+    std::memcpy(prevRow.data(), row, rowBytes);
+
+    // Adler-32 of the uncompressed stream (filter byte + row)
+    adlerA = (adlerA + static_cast<unsigned char>(best)) % 65521;
+    adlerB = (adlerB + adlerA) % 65521;
+    for (int x = 0; x < rowBytes;) {
+        int n = std::min(rowBytes - x, 5552);   // largest run without 32-bit overflow
+        for (int i = 0; i < n; i++, x++) {
+            adlerA += chosen[x];
+            adlerB += adlerA;
+        }
+        adlerA %= 65521;
+        adlerB %= 65521;
+    }
+}
+
+void ScanlineDeflater::addRows(const unsigned char* rgb, int rows) {
+    for (int y = 0; y < rows; y++) filterRow(rgb + static_cast<size_t>(y) * rowBytes);
+    compress(false);
+}
+
+void ScanlineDeflater::putBits(uint32_t bits, int count) {
+    bitBuffer |= bits << bitCount;
+    bitCount += count;
+    while (bitCount >= 8) {
+        out.push_back(static_cast<unsigned char>(bitBuffer & 0xFF));
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+void ScanlineDeflater::putCode(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) reversed = (reversed << 1) | ((code >> i) & 1);
+    putBits(reversed, length);
+}
+
+void ScanlineDeflater::putLiteral(int symbol) {
+    // Fixed Huffman table (RFC 1951, 3.2.6)
+    if (symbol < 144) putCode(0x30 + symbol, 8);
+    else if (symbol < 256) putCode(0x190 + (symbol - 144), 9);
+    else if (symbol < 280) putCode(symbol - 256, 7);
+    else putCode(0xC0 + (symbol - 280), 8);
+}
+
+void ScanlineDeflater::putMatch(int length, int distance) {
+    int l = 28;
+    while (kLengthBase[l] > length) l--;
+    putLiteral(257 + l);
+    if (kLengthExtra[l]) putBits(length - kLengthBase[l], kLengthExtra[l]);
+    int d = 29;
+    while (kDistBase[d] > distance) d--;
+    putCode(d, 5);
+    if (kDistExtra[d]) putBits(distance - kDistBase[d], kDistExtra[d]);
+}
+
+void ScanlineDeflater::flushBits() {
+    if (bitCount > 0) out.push_back(static_cast<unsigned char>(bitBuffer & 0xFF));
+    bitBuffer = 0;
+    bitCount = 0;
+}
+
+void ScanlineDeflater::compress(bool final) {
+    const int64_t end = windowBase + static_cast<int64_t>(window.size());
+    // Keep a full match length of lookahead until the last rows arrive
+    const int64_t limit = final ? end : end - kMaxMatch;
+    if (cursor >= limit) return;
+
+    // One non-final fixed-Huffman block per call; matches may reach into earlier blocks
+    putBits(0, 1);
+    putBits(1, 2);
+    auto insert = [&](int64_t pos) {
+        uint32_t h = hash3(&window[static_cast<size_t>(pos - windowBase)]);
+        prev[pos & kWindowMask] = head[h];
+        head[h] = pos;
+    };
+    while (cursor < limit) {
+        const size_t idx = static_cast<size_t>(cursor - windowBase);
+        const int avail = static_cast<int>(std::min<int64_t>(end - cursor, kMaxMatch));
+        int bestLen = 0;
+        int bestDist = 0;
+        if (avail >= kMinMatch) {
+            int64_t cand = head[hash3(&window[idx])];
+            for (int chain = 0; cand >= windowBase && cursor - cand <= kWindowSize && chain < kMaxChain; chain++) {
+                const unsigned char* a = &window[static_cast<size_t>(cand - windowBase)];
+                const unsigned char* b = &window[idx];
+                int len = 0;
+                while (len < avail && a[len] == b[len]) len++;
+                if (len > bestLen) {
+                    bestLen = len;
+                    bestDist = static_cast<int>(cursor - cand);
+                    if (len == avail) break;
+                }
+                int64_t next = prev[cand & kWindowMask];
+                if (next >= cand) break;   // slot reused by a newer position
+                cand = next;
+            }
+            insert(cursor);
+        }
+        if (bestLen >= kMinMatch) {
+            putMatch(bestLen, bestDist);
+            for (int i = 1; i < bestLen; i++)
+                if (cursor + i + kMinMatch <= end) insert(cursor + i);
+            cursor += bestLen;
+        } else {
+            putLiteral(window[idx]);
+            cursor++;
+        }
+    }
+    putLiteral(256);   // end of block
+
+    // Drop input older than the match window (amortized: only once it doubles)
+    int64_t keepFrom = cursor - kWindowSize;
+    if (keepFrom - windowBase > kWindowSize) {
+        window.erase(window.begin(), window.begin() + static_cast<size_t>(keepFrom - windowBase));
+        windowBase = keepFrom;
+    }
+}
+
+void ScanlineDeflater::finish() {
+    compress(true);
+    // Empty final block, then the Adler-32 trailer
+    putBits(1, 1);
+    putBits(1, 2);
+    putLiteral(256);
+    flushBits();
+    uint32_t adler = (adlerB << 16) | adlerA;
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<unsigned char>(adler >> shift));
+}
+
+// --- PngStreamWriter ---
+
+static uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t size) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static void putBigEndian(unsigned char* dst, uint32_t v) {
+    dst[0] = static_cast<unsigned char>(v >> 24);
+    dst[1] = static_cast<unsigned char>(v >> 16);
+    dst[2] = static_cast<unsigned char>(v >> 8);
+    dst[3] = static_cast<unsigned char>(v);
+}
+
+PngStreamWriter::~PngStreamWriter() {
+    if (file) std::fclose(file);
+}
+
+bool PngStreamWriter::open(const std::string& path, int w, int h) {
+    if (file || w <= 0 || h <= 0) return false;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    width = w;
+    height = h;
+    rowsWritten = 0;
+    ok = true;
+    deflater = std::make_unique<ScanlineDeflater>(width);
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    ok = std::fwrite(signature, 1, sizeof(signature), file) == sizeof(signature);
+    unsigned char ihdr[13] = {};
+    putBigEndian(ihdr, static_cast<uint32_t>(width));
+    putBigEndian(ihdr + 4, static_cast<uint32_t>(height));
+    ihdr[8] = 8;    // bit depth
+    ihdr[9] = 2;    // truecolor RGB
+    return writeChunk("IHDR", ihdr, sizeof(ihdr)) && ok;
+}
+
+bool PngStreamWriter::writeChunk(const char type[4], const unsigned char* data, size_t size) {
+    unsigned char header[8];
+    putBigEndian(header, static_cast<uint32_t>(size));
+    std::memcpy(header + 4, type, 4);
+    uint32_t crc = crc32Update(0xFFFFFFFFu, header + 4, 4);
+    crc = crc32Update(crc, data, size) ^ 0xFFFFFFFFu;
+    unsigned char trailer[4];
+    putBigEndian(trailer, crc);
+    ok = ok && std::fwrite(header, 1, 8, file) == 8;
+    ok = ok && (size == 0 || std::fwrite(data, 1, size, file) == size);
+    ok = ok && std::fwrite(trailer, 1, 4, file) == 4;
+    return ok;
+}
+
+bool PngStreamWriter::drain(bool force) {
+    const auto& bytes = deflater->getOutput();
+    if (bytes.empty() || (!force && bytes.size() < kDrainBytes)) return ok;
+    writeChunk("IDAT", bytes.data(), bytes.size());
+    deflater->clearOutput();
+    return ok;
+}
+
+bool PngStreamWriter::writeRows(const unsigned char* rgb, int rows) {
+    if (!file || rows <= 0 || rowsWritten + rows > height) return false;
+    deflater->addRows(rgb, rows);
+    rowsWritten += rows;
+    return drain(false);
+}
+
+bool PngStreamWriter::close() {
+    if (!file) return false;
+    bool complete = rowsWritten == height;
+    if (complete) {
+        deflater->finish();
+        drain(true);
+        writeChunk("IEND", nullptr, 0);
+    }
+    ok = (std::fclose(file) == 0) && ok && complete;
+    file = nullptr;
+    deflater.reset();
+    return ok;
+}
+
+// --- PdfStreamWriter ---
+
+PdfStreamWriter::~PdfStreamWriter() {
+    if (file) std::fclose(file);
+}
+
+bool PdfStreamWriter::write(const unsigned char* data, size_t size) {
+    ok = ok && std::fwrite(data, 1, size, file) == size;
+    written += size;
+    return ok;
+}
+
+bool PdfStreamWriter::write(const std::string& text) {
+    return write(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+}
+
+bool PdfStreamWriter::open(const std::string& path, int w, int h) {
+    if (file || w <= 0 || h <= 0) return false;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    width = w;
+    height = h;
+    rowsWritten = 0;
+    ok = true;
+    written = 0;
+    offsets.assign(1, 0);
+    deflater = std::make_unique<ScanlineDeflater>(width);
+
+    // One point per pixel like savePdfToFile, scaled down past the 14400 pt page limit
+    float scale = std::min(1.0f, 14400.0f / static_cast<float>(std::max(width, height)));
+    auto number = [](float v) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", v);
+        return std::string(buf);
+    };
+    std::string pageW = number(width * scale);
+    std::string pageH = number(height * scale);
+
+    write("%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+    offsets.push_back(written);
+    write("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+    offsets.push_back(written);
+    write("2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+    offsets.push_back(written);
+    write("3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + pageW + " " + pageH + "]"
+          " /Contents 4 0 R /Resources << /XObject << /Img 5 0 R >> >> >>\nendobj\n");
+    std::string content = "q\n" + pageW + " 0 0 " + pageH + " 0 0 cm\n/Img Do\nQ\n";
+    offsets.push_back(written);
+    write("4 0 obj\n<< /Length " + std::to_string(content.size()) + " >>\nstream\n" + content + "endstream\nendobj\n");
+
+    // Image length is not known up front: it goes into object 6 once the stream ends
+    offsets.push_back(written);
+    std::string columns = std::to_string(width);
+    write("5 0 obj\n<< /Type /XObject /Subtype /Image /Width " + columns + " /Height " + std::to_string(height) +
+          " /ColorSpace /DeviceRGB /BitsPerComponent 8 /Filter /FlateDecode"
+          " /DecodeParms << /Predictor 15 /Colors 3 /BitsPerComponent 8 /Columns " + columns + " >>"
+          " /Length 6 0 R >>\nstream\n");
+    streamStart = written;
+    return ok;
+}
+
+bool PdfStreamWriter::writeRows(const unsigned char* rgb, int rows) {
+    if (!file || rows <= 0 || rowsWritten + rows > height) return false;
+    deflater->addRows(rgb, rows);
+    rowsWritten += rows;
+    const auto& bytes = deflater->getOutput();
+    if (bytes.size() >= kDrainBytes) {
+        write(bytes.data(), bytes.size());
+        deflater->clearOutput();
+    }
+    return ok;
+}
+
+bool PdfStreamWriter::close() {
+    if (!file) return false;
+    bool complete = rowsWritten == height;
+    if (complete) {
+        deflater->finish();
+        const auto& bytes = deflater->getOutput();
+        write(bytes.data(), bytes.size());
+        size_t streamLength = written - streamStart;
+        write("\nendstream\nendobj\n");
+        offsets.push_back(written);
+        write("6 0 obj\n" + std::to_string(streamLength) + "\nendobj\n");
+
+        size_t xrefOffset = written;
+        std::string xref = "xref\n0 " + std::to_string(offsets.size()) + "\n0000000000 65535 f \n";
+        for (size_t i = 1; i < offsets.size(); i++) {
+            char entry[32];
+            std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offsets[i]);
+            xref += entry;
+        }
+        write(xref);
+        write("trailer\n<< /Size " + std::to_string(offsets.size()) + " /Root 1 0 R >>\nstartxref\n" +
+              std::to_string(xrefOffset) + "\n%%EOF\n");
+    }
+    ok = (std::fclose(file) == 0) && ok && complete;
+    file = nullptr;
+    deflater.reset();
+    return ok;
+}
+
+} // namespace opticsketch
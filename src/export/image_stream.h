@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+// Incremental zlib encoder for PNG-filtered RGB scanlines (fixed-Huffman deflate with
+// LZ77 over a 32 KB window). Rows are filtered, compressed and appended to an output
+// buffer as they arrive, so an image never has to be held in memory as a whole.
+class ScanlineDeflater {
+public:
+    explicit ScanlineDeflater(int width);
+
+    // Filter and compress top-down RGB rows (width * 3 bytes each)
+    void addRows(const unsigned char* rgb, int rows);
+    // Terminate the zlib stream (call once, after the last row)
+    void finish();
+
+    // Compressed bytes produced so far; the caller drains them with clearOutput()
+    const std::vector<unsigned char>& getOutput() const { return out; }
+    void clearOutput() { out.clear(); }
+
+private:
+    void filterRow(const unsigned char* row);
+    void compress(bool final);
+    void putBits(uint32_t bits, int count);
+    void putCode(uint32_t code, int length);   // Huffman codes go MSB first
+    void putLiteral(int symbol);
+    void putMatch(int length, int distance);
+    void flushBits();
+
+    int rowBytes = 0;
+    std::vector<unsigned char> prevRow;
+    std::vector<unsigned char> filtered;    // candidate filter output, 5 rows
+
+    // Sliding window: bytes still needed for matching plus unconsumed input
+    std::vector<unsigned char> window;
+    int64_t windowBase = 0;     // absolute stream position of window[0]
+    int64_t cursor = 0;         // next absolute position to encode
+    std::vector<int64_t> head;  // last position per 3-byte hash
+    std::vector<int64_t> prev;  // previous position with the same hash, by pos & mask
+    uint32_t adlerA = 1, adlerB = 0;
+
+    std::vector<unsigned char> out;
+    uint32_t bitBuffer = 0;
+    int bitCount = 0;
+};
+
+// Writes a PNG one band of rows at a time (top-down RGB)
+class PngStreamWriter {
+public:
+    ~PngStreamWriter();
+    bool open(const std::string& path, int width, int height);
+    bool writeRows(const unsigned char* rgb, int rows);
+    bool close();   // false if any write failed or not all rows were written
+
+private:
+    bool writeChunk(const char type[4], const unsigned char* data, size_t size);
+    bool drain(bool force);
+
+    FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    int rowsWritten = 0;
+    bool ok = true;
+    std::unique_ptr<ScanlineDeflater> deflater;
+};
+
+// Writes a single-page PDF whose page is one Flate-compressed RGB image, streamed the
+// same way (PNG predictors inside the image stream)
+class PdfStreamWriter {
+public:
+    ~PdfStreamWriter();
+    bool open(const std::string& path, int width, int height);
+    bool writeRows(const unsigned char* rgb, int rows);
+    bool close();
+
+private:
+    bool write(const std::string& text);
+    bool write(const unsigned char* data, size_t size);
+
+    FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    int rowsWritten = 0;
+    bool ok = true;
+    size_t written = 0;             // bytes so far, for the xref offsets
+    size_t streamStart = 0;
+    std::vector<size_t> offsets;    // object byte offsets, 1-based
+    std::unique_ptr<ScanlineDeflater> deflater;
+};
+
+} // namespace opticsketch
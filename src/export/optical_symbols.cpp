@@ -9,10 +9,8 @@ namespace opticsketch {
 
 // ============ Helpers ============
 
-static std::string fmt(float v, int prec = 2) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(prec) << v;
-    return oss.str();
+static FixedNumber fmt(float v, int prec = 2) {
+    return FixedNumber{v, prec};
 }
 
 static SymbolPath makePath(bool stroked = true, float strokeW = 1.5f,
@@ -382,12 +380,11 @@ OpticalSymbol getOpticalSymbol(ElementType type) {
 
 // ============ SVG Renderer ============
 
-std::string renderSymbolSvg(const OpticalSymbol& sym,
-                            float cx, float cy, float w, float h,
-                            float rotDeg,
-                            const std::string& strokeColor,
-                            const std::string& fillColor) {
-    std::ostringstream out;
+void renderSymbolSvg(TextWriter& out, const OpticalSymbol& sym,
+                     float cx, float cy, float w, float h,
+                     float rotDeg,
+                     std::string_view strokeColor,
+                     std::string_view fillColor) {
 
     float sx = (sym.nominalWidth > 0.001f) ? w / sym.nominalWidth : 1.0f;
     float sy = (sym.nominalHeight > 0.001f) ? h / sym.nominalHeight : 1.0f;
@@ -448,16 +445,14 @@ std::string renderSymbolSvg(const OpticalSymbol& sym,
     }
 
     out << "</g>\n";
-    return out.str();
 }
 
 // ============ TikZ Renderer ============
 
-std::string renderSymbolTikz(const OpticalSymbol& sym,
-                             float tx, float ty, float w, float h,
-                             float rotDeg,
-                             const std::string& colorName) {
-    std::ostringstream out;
+void renderSymbolTikz(TextWriter& out, const OpticalSymbol& sym,
+                      float tx, float ty, float w, float h,
+                      float rotDeg,
+                      std::string_view colorName) {
 
     float sx = (sym.nominalWidth > 0.001f) ? w / sym.nominalWidth : 1.0f;
     float sy = (sym.nominalHeight > 0.001f) ? h / sym.nominalHeight : 1.0f;
@@ -511,7 +506,108 @@ std::string renderSymbolTikz(const OpticalSymbol& sym,
     }
 
     out << "\\end{scope}\n";
-    return out.str();
+}
+
+// ============ PDF Renderer ============
+
+static void pdfPoint(TextWriter& out, float x, float y) {
+    out << fmt(x) << ' ' << fmt(y);
+}
+
+// SVG endpoint arc (rotation 0) as cubic Beziers, at most a quarter turn each
+static void pdfArc(TextWriter& out, float x0, float y0, float x1, float y1,
+                   float rx, float ry, bool largeArc, bool sweep) {
+    rx = std::abs(rx);
+    ry = std::abs(ry);
+    if (rx < 1e-6f || ry < 1e-6f || (x0 == x1 && y0 == y1)) {
+        pdfPoint(out, x1, y1);
+        out << " l\n";
+        return;
+    }
+    float hx = (x0 - x1) * 0.5f;
+    float hy = (y0 - y1) * 0.5f;
+    float lambda = (hx * hx) / (rx * rx) + (hy * hy) / (ry * ry);
+    if (lambda > 1.0f) {
+        rx *= std::sqrt(lambda);
+        ry *= std::sqrt(lambda);
+    }
+    float num = rx * rx * ry * ry - rx * rx * hy * hy - ry * ry * hx * hx;
+    float den = rx * rx * hy * hy + ry * ry * hx * hx;
+    float coef = std::sqrt(std::max(0.0f, num / den)) * (largeArc != sweep ? 1.0f : -1.0f);
+    float ccx = coef * rx * hy / ry;
+    float ccy = -coef * ry * hx / rx;
+    float cx = ccx + (x0 + x1) * 0.5f;
+    float cy = ccy + (y0 + y1) * 0.5f;
+
+    const float kPi = 3.14159265358979f;
+    float start = std::atan2((hy - ccy) / ry, (hx - ccx) / rx);
+    float end = std::atan2((-hy - ccy) / ry, (-hx - ccx) / rx);
+    float delta = end - start;
+    if (sweep && delta < 0.0f) delta += 2.0f * kPi;
+    if (!sweep && delta > 0.0f) delta -= 2.0f * kPi;
+
+    int pieces = std::max(1, static_cast<int>(std::ceil(std::abs(delta) / (kPi * 0.5f) - 1e-4f)));
+    float step = delta / pieces;
+    float k = 4.0f / 3.0f * std::tan(step * 0.25f);
+    float a = start;
+    for (int i = 0; i < pieces; i++) {
+        float b = a + step;
+        float ca = std::cos(a), sa = std::sin(a), cb = std::cos(b), sb = std::sin(b);
+        pdfPoint(out, cx + rx * (ca - k * sa), cy + ry * (sa + k * ca));
+        out << ' ';
+        pdfPoint(out, cx + rx * (cb + k * sb), cy + ry * (sb - k * cb));
+        out << ' ';
+        // The last piece lands exactly on the endpoint
+        if (i + 1 == pieces) pdfPoint(out, x1, y1);
+        else pdfPoint(out, cx + rx * cb, cy + ry * sb);
+        out << " c\n";
+        a = b;
+    }
+}
+
+void renderSymbolPdf(TextWriter& out, const OpticalSymbol& sym, float w, float h,
+                     const std::function<std::string(float)>& fillState) {
+    float sx = (sym.nominalWidth > 0.001f) ? w / sym.nominalWidth : 1.0f;
+    float sy = (sym.nominalHeight > 0.001f) ? h / sym.nominalHeight : 1.0f;
+
+    for (const auto& path : sym.paths) {
+        float curX = 0.0f, curY = 0.0f, startX = 0.0f, startY = 0.0f;
+        for (const auto& seg : path.segments) {
+            float px = seg.p.x * sx;
+            float py = seg.p.y * sy;
+            switch (seg.cmd) {
+                case PathCmd::MoveTo:
+                    pdfPoint(out, px, py);
+                    out << " m\n";
+                    startX = px;
+                    startY = py;
+                    break;
+                case PathCmd::LineTo:
+                    pdfPoint(out, px, py);
+                    out << " l\n";
+                    break;
+                case PathCmd::ArcTo:
+                    pdfArc(out, curX, curY, px, py, seg.radius * sx, seg.radius * sy, seg.largeArc, seg.sweep);
+                    break;
+                case PathCmd::Close:
+                    out << "h\n";
+                    px = startX;
+                    py = startY;
+                    break;
+            }
+            curX = px;
+            curY = py;
+        }
+
+        if (path.filled) out << fillState(path.fillOpacity) << " gs\n";
+        if (path.stroked) {
+            out << fmt(path.strokeWidth) << " w " << (path.isDashed ? "[4 3] 0 d" : "[] 0 d") << '\n';
+        }
+        if (path.filled && path.stroked) out << "B\n";
+        else if (path.filled) out << "f\n";
+        else if (path.stroked) out << "S\n";
+        else out << "n\n";
+    }
 }
 
 // ============ Optical Axis Detection ============
@@ -606,9 +702,8 @@ ScaleBar chooseScaleBar(float sceneExtentMm) {
     return bar;
 }
 
-std::string renderScaleBarSvg(const ScaleBar& bar, float scale,
-                               float x, float y) {
-    std::ostringstream out;
+void renderScaleBarSvg(TextWriter& out, const ScaleBar& bar, float scale,
+                       float x, float y) {
     float barLenPx = bar.lengthMm * scale;
 
     out << "<g id=\"scale-bar\" transform=\"translate(" << fmt(x) << "," << fmt(y) << ")\">\n";
@@ -623,12 +718,25 @@ std::string renderScaleBarSvg(const ScaleBar& bar, float scale,
         << "text-anchor=\"middle\" font-size=\"10\" font-family=\"serif\" fill=\"black\">"
         << bar.labelText << "</text>\n";
     out << "</g>\n";
-    return out.str();
 }
 
-std::string renderScaleBarTikz(const ScaleBar& bar, float scale,
-                                float x, float y) {
-    std::ostringstream out;
+void renderScaleBarPdf(TextWriter& out, const ScaleBar& bar, float scale,
+                       float x, float y) {
+    float barLenPx = bar.lengthMm * scale;
+
+    out << "q\n0 0 0 RG 0 0 0 rg [] 0 d\n";
+    out << "1 0 0 1 " << fmt(x) << ' ' << fmt(y) << " cm\n";
+    out << "1.5 w 0 0 m " << fmt(barLenPx) << " 0 l S\n";
+    // End caps
+    out << "1 w 0 -4 m 0 4 l " << fmt(barLenPx) << " -4 m " << fmt(barLenPx) << " 4 l S\n";
+    // Label, centered by an average Times glyph width; the text matrix undoes the y flip
+    float labelWidth = 10.0f * 0.45f * static_cast<float>(bar.labelText.size());
+    out << "BT /F1 10 Tf 1 0 0 -1 " << fmt(barLenPx * 0.5f - labelWidth * 0.5f) << " 14 Tm ("
+        << bar.labelText << ") Tj ET\nQ\n";
+}
+
+void renderScaleBarTikz(TextWriter& out, const ScaleBar& bar, float scale,
+                        float x, float y) {
     float barLenCm = bar.lengthMm * scale;
 
     out << "% Scale bar\n";
@@ -638,7 +746,6 @@ std::string renderScaleBarTikz(const ScaleBar& bar, float scale,
     out << "\\draw (" << fmt(x + barLenCm, 3) << "," << fmt(y - 0.1f, 3) << ") -- ++(0,0.2);\n";
     out << "\\node[below] at (" << fmt(x + barLenCm * 0.5f, 3) << "," << fmt(y, 3) << ") "
         << "{\\small " << bar.labelText << "};\n";
-    return out.str();
 }
 
 } // namespace opticsketch
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "elements/element.h"
+#include "export/text_writer.h"
 #include <glm/glm.hpp>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -45,18 +48,25 @@ struct OpticalSymbol {
 // Symbol is in local coordinates centered at (0,0).
 OpticalSymbol getOpticalSymbol(ElementType type);
 
-// Render symbol as SVG markup.
-std::string renderSymbolSvg(const OpticalSymbol& sym,
-                            float cx, float cy, float w, float h,
-                            float rotDeg,
-                            const std::string& strokeColor,
-                            const std::string& fillColor);
-
-// Render symbol as TikZ draw commands.
-std::string renderSymbolTikz(const OpticalSymbol& sym,
-                             float tx, float ty, float w, float h,
-                             float rotDeg,
-                             const std::string& colorName);
+// Write symbol as SVG markup.
+void renderSymbolSvg(TextWriter& out, const OpticalSymbol& sym,
+                     float cx, float cy, float w, float h,
+                     float rotDeg,
+                     std::string_view strokeColor,
+                     std::string_view fillColor);
+
+// Write symbol as TikZ draw commands.
+void renderSymbolTikz(TextWriter& out, const OpticalSymbol& sym,
+                      float tx, float ty, float w, float h,
+                      float rotDeg,
+                      std::string_view colorName);
+
+// Write symbol as PDF path operators, centered at the origin and unrotated, in the
+// exporters' y-down page space: the content of a form XObject placed once per copy.
+// Stroke and fill colors are set by the caller; each fill opacity is applied through the
+// graphics state named by fillState(opacity), e.g. "/GS0".
+void renderSymbolPdf(TextWriter& out, const OpticalSymbol& sym, float w, float h,
+                     const std::function<std::string(float)>& fillState);
 
 // --- Optical Axis Detection ---
 
@@ -79,12 +89,17 @@ struct ScaleBar {
 // Choose appropriate scale bar length for the scene extent.
 ScaleBar chooseScaleBar(float sceneExtentMm);
 
-// Render scale bar as SVG at given position.
-std::string renderScaleBarSvg(const ScaleBar& bar, float scale,
-                               float x, float y);
+// Write scale bar as SVG at given position.
+void renderScaleBarSvg(TextWriter& out, const ScaleBar& bar, float scale,
+                       float x, float y);
+
+// Write scale bar as PDF operators at given position (y-down page space). The label uses
+// the font resource "/F1".
+void renderScaleBarPdf(TextWriter& out, const ScaleBar& bar, float scale,
+                       float x, float y);
 
-// Render scale bar as TikZ at given position.
-std::string renderScaleBarTikz(const ScaleBar& bar, float scale,
-                                float x, float y);
+// Write scale bar as TikZ at given position.
+void renderScaleBarTikz(TextWriter& out, const ScaleBar& bar, float scale,
+                        float x, float y);
 
 } // namespace opticsketch
@@ -0,0 +1,104 @@
+#include "export/text_writer.h"
+#include <charconv>
+#include <cstring>
+
+namespace opticsketch {
+
+// Both return the end of the characters written into [first, last)
+static char* formatNumber(char* first, char* last, FixedNumber number) {
+    auto result = std::to_chars(first, last, number.value, std::chars_format::fixed, number.precision);
+    return result.ec == std::errc() ? result.ptr : first;
+}
+
+static char* formatNumber(char* first, char* last, GeneralNumber number) {
+    auto result = std::to_chars(first, last, number.value, std::chars_format::general, 6);
+    return result.ec == std::errc() ? result.ptr : first;
+}
+
+TextWriter::~TextWriter() {
+    if (file) close();
+}
+
+bool TextWriter::open(const std::string& path) {
+    if (file) close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    if (!chunk) chunk = std::make_unique<char[]>(kChunkBytes);
+    used = 0;
+    flushed = 0;
+    ok = true;
+    return true;
+}
+
+bool TextWriter::close() {
+    if (!file) return false;
+    flush();
+    if (std::fclose(file) != 0) ok = false;
+    file = nullptr;
+    return ok;
+}
+
+void TextWriter::flush() {
+    if (used > 0 && file && std::fwrite(chunk.get(), 1, used, file) != used) ok = false;
+    flushed += used;
+    used = 0;
+}
+
+char* TextWriter::reserve(size_t bytes) {
+    if (used + bytes > kChunkBytes) flush();
+    return chunk.get() + used;
+}
+
+TextWriter& TextWriter::operator<<(std::string_view text) {
+    if (!file) return *this;
+    if (text.size() > kChunkBytes) {
+        // Larger than a chunk: write through
+        flush();
+        if (std::fwrite(text.data(), 1, text.size(), file) != text.size()) ok = false;
+        flushed += text.size();
+        return *this;
+    }
+    std::memcpy(reserve(text.size()), text.data(), text.size());
+    used += text.size();
+    return *this;
+}
+
+TextWriter& TextWriter::operator<<(char c) {
+    if (!file) return *this;
+    *reserve(1) = c;
+    used++;
+    return *this;
+}
+
+TextWriter& TextWriter::operator<<(int value) {
+    if (!file) return *this;
+    char* first = reserve(kNumberBytes);
+    used += std::to_chars(first, first + kNumberBytes, value).ptr - first;
+    return *this;
+}
+
+TextWriter& TextWriter::operator<<(FixedNumber number) {
+    if (!file) return *this;
+    char* first = reserve(kNumberBytes);
+    used += formatNumber(first, first + kNumberBytes, number) - first;
+    return *this;
+}
+
+TextWriter& TextWriter::operator<<(GeneralNumber number) {
+    if (!file) return *this;
+    char* first = reserve(kNumberBytes);
+    used += formatNumber(first, first + kNumberBytes, number) - first;
+    return *this;
+}
+
+void appendNumber(std::string& out, FixedNumber number) {
+    char buffer[64];
+    out.append(buffer, formatNumber(buffer, buffer + sizeof(buffer), number));
+}
+
+void appendNumber(std::string& out, GeneralNumber number) {
+    char buffer[64];
+    out.append(buffer, formatNumber(buffer, buffer + sizeof(buffer), number));
+}
+
+} // namespace opticsketch
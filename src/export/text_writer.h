@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace opticsketch {
+
+// Number written in fixed notation, like std::fixed << std::setprecision(precision)
+struct FixedNumber {
+    float value;
+    int precision;
+};
+
+// Number written like a default-formatted stream (%g, 6 significant digits)
+struct GeneralNumber {
+    float value;
+};
+
+// Buffered text output for the vector exporters (SVG, TikZ, PDF). Text and numbers go
+// straight into a fixed chunk that is written to the file whenever it fills; numbers are
+// formatted with std::to_chars, so a coordinate costs no heap allocation.
+class TextWriter {
+public:
+    TextWriter() = default;
+    ~TextWriter();
+    TextWriter(const TextWriter&) = delete;
+    TextWriter& operator=(const TextWriter&) = delete;
+
+    bool open(const std::string& path);
+    bool close();   // flush and close; false if any write failed
+    bool good() const { return ok; }
+    // Bytes written since open, buffered ones included (PDF cross-reference offsets)
+    size_t tell() const { return flushed + used; }
+
+    TextWriter& operator<<(std::string_view text);
+    TextWriter& operator<<(const char* text) { return *this << std::string_view(text); }
+    TextWriter& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    TextWriter& operator<<(char c);
+    TextWriter& operator<<(int value);
+    TextWriter& operator<<(FixedNumber number);
+    TextWriter& operator<<(GeneralNumber number);
+
+private:
+    static constexpr size_t kChunkBytes = 64 * 1024;
+    // Room for any single formatted number
+    static constexpr size_t kNumberBytes = 64;
+
+    // Make room for 'bytes' more characters in the chunk
+    char* reserve(size_t bytes);
+    void flush();
+
+    FILE* file = nullptr;
+    std::unique_ptr<char[]> chunk;
+    size_t used = 0;
+    size_t flushed = 0;
+    bool ok = true;
+};
+
+// Append a number to a string with the writer's formatting (for small strings built once
+// per object, such as a color reused by several attributes)
+void appendNumber(std::string& out, FixedNumber number);
+void appendNumber(std::string& out, GeneralNumber number);
+
+} // namespace opticsketch
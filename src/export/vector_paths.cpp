@@ -0,0 +1,136 @@
+#include "export/vector_paths.h"
+#include "scene/traced_rays.h"
+#include "scene/scene.h"
+#include "elements/element.h"
+#include "elements/annotation.h"
+#include "elements/measurement.h"
+#include "render/beam.h"
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cfloat>
+
+namespace opticsketch {
+
+// Gap accepted between one segment's end and the next one's start: covers the offset
+// the tracer applies past each hit to avoid self-intersection
+static constexpr float kJoinDistance = 0.05f;
+static constexpr float kCollinearEpsilon = 1e-4f;
+
+static float distanceToLine(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 ab = b - a;
+    float len2 = glm::dot(ab, ab);
+    if (len2 <= 0.0f) return glm::length(p - a);
+    float t = std::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f);
+    return glm::length(p - (a + ab * t));
+}
+
+// Ramer-Douglas-Peucker over points[first..last], marking the points to keep
+static void simplifyRange(const std::vector<glm::vec3>& points, size_t first, size_t last,
+                          float tolerance, std::vector<char>& keep) {
+    std::vector<std::pair<size_t, size_t>> stack{{first, last}};
+    while (!stack.empty()) {
+        auto [a, b] = stack.back();
+        stack.pop_back();
+        if (b <= a + 1) continue;
+        float worst = -1.0f;
+        size_t worstIndex = a;
+        for (size_t i = a + 1; i < b; i++) {
+            float d = distanceToLine(points[i], points[a], points[b]);
+            if (d > worst) { worst = d; worstIndex = i; }
+        }
+        if (worst <= tolerance) continue;
+        keep[worstIndex] = 1;
+        stack.push_back({a, worstIndex});
+        stack.push_back({worstIndex, b});
+    }
+}
+
+static void simplifyPath(std::vector<glm::vec3>& points, float tolerance) {
+    if (points.size() < 3) return;
+    std::vector<char> keep(points.size(), 0);
+    keep.front() = keep.back() = 1;
+    simplifyRange(points, 0, points.size() - 1, tolerance, keep);
+    size_t out = 0;
+    for (size_t i = 0; i < points.size(); i++)
+        if (keep[i]) points[out++] = points[i];
+    points.resize(out);
+}
+
+std::vector<TracedPath> buildTracedPaths(const TracedRayBuffer& traced, float tolerance) {
+    std::vector<TracedPath> paths;
+    const float joinDist2 = kJoinDistance * kJoinDistance;
+    for (size_t i = 0; i < traced.size(); i++) {
+        // The tracer writes a branch depth-first, so a continuation is always the next segment
+        if (!paths.empty()) {
+            TracedPath& path = paths.back();
+            glm::vec3 gap = traced.start[i] - path.points.back();
+            if (path.source == traced.source[i] && path.color == traced.color[i] &&
+                path.intensity == traced.intensity[i] && glm::dot(gap, gap) <= joinDist2) {
+                path.points.push_back(traced.end[i]);
+                continue;
+            }
+        }
+        TracedPath path;
+        path.points = {traced.start[i], traced.end[i]};
+        path.color = traced.color[i];
+        path.intensity = traced.intensity[i];
+        path.source = traced.source[i];
+        paths.push_back(std::move(path));
+    }
+    float eps = std::max(tolerance, kCollinearEpsilon);
+    for (TracedPath& path : paths) simplifyPath(path.points, eps);
+    return paths;
+}
+
+VectorBounds computeVectorBounds(const Scene& scene, float scale) {
+    VectorBounds b{FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+    auto expand = [&](float x, float y) {
+        b.minX = std::min(b.minX, x);
+        b.maxX = std::max(b.maxX, x);
+        b.minY = std::min(b.minY, y);
+        b.maxY = std::max(b.maxY, y);
+    };
+    for (const auto& elem : scene.getElements()) {
+        if (!elem->visible) continue;
+        glm::vec3 wMin, wMax;
+        elem->getArrayWorldBounds(wMin, wMax);
+        expand(wMin.x * scale, -wMax.z * scale);
+        expand(wMax.x * scale, -wMin.z * scale);
+    }
+    for (const auto& beam : scene.getBeams()) {
+        if (!beam->visible) continue;
+        expand(beam->start.x * scale, -beam->start.z * scale);
+        expand(beam->end.x * scale, -beam->end.z * scale);
+    }
+    const TracedRayBuffer& traced = scene.getTracedRays();
+    for (size_t i = 0; i < traced.size(); i++) {
+        expand(traced.start[i].x * scale, -traced.start[i].z * scale);
+        expand(traced.end[i].x * scale, -traced.end[i].z * scale);
+    }
+    for (const auto& ann : scene.getAnnotations()) {
+        if (!ann->visible) continue;
+        expand(ann->position.x * scale, -ann->position.z * scale);
+    }
+    for (const auto& meas : scene.getMeasurements()) {
+        if (!meas->visible) continue;
+        expand(meas->startPoint.x * scale, -meas->startPoint.z * scale);
+        expand(meas->endPoint.x * scale, -meas->endPoint.z * scale);
+    }
+    if (b.minX > b.maxX) b = VectorBounds{0.0f, 0.0f, 100.0f, 100.0f};
+    return b;
+}
+
+SymbolPlacement placeSymbol(const Element& elem, int instance, float scale) {
+    const Transform t = elem.getInstanceTransform(instance);
+    SymbolPlacement p;
+    p.cx = t.position.x * scale;
+    p.cy = -t.position.z * scale;
+    p.rotDeg = glm::degrees(glm::eulerAngles(t.rotation).y);
+    p.w = (elem.boundsMax.x - elem.boundsMin.x) * t.scale.x * scale;
+    p.h = (elem.boundsMax.z - elem.boundsMin.z) * t.scale.z * scale;
+    if (p.w < 4.0f) p.w = 16.0f;
+    if (p.h < 4.0f) p.h = 16.0f;
+    return p;
+}
+
+} // namespace opticsketch
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace opticsketch {
+
+struct TracedRayBuffer;
+class Scene;
+class Element;
+
+// A run of traced segments drawn as one polyline
+struct TracedPath {
+    std::vector<glm::vec3> points;
+    glm::vec3 color{1.0f};
+    float intensity = 1.0f;
+    int source = -1;
+};
+
+// Merge contiguous traced segments of the same source, color and intensity into
+// polylines, in emission order. Interior points that lie within 'tolerance' (world
+// units) of the line through their neighbours are dropped; 0 only removes points that
+// are collinear to within rounding.
+std::vector<TracedPath> buildTracedPaths(const TracedRayBuffer& traced, float tolerance = 0.0f);
+
+// The top-down projection shared by the SVG and PDF exporters: world X * scale to the
+// right, world Z * scale up the page (negated, since page y grows downward)
+struct VectorBounds {
+    float minX, minY, maxX, maxY;
+};
+
+// Extent of the visible elements, beams, traced rays, annotations and measurements;
+// a 100 x 100 box at the origin for an empty scene
+VectorBounds computeVectorBounds(const Scene& scene, float scale);
+
+// Where one copy of an element's optical symbol goes: center, size and Y rotation
+struct SymbolPlacement {
+    float cx, cy;
+    float w, h;
+    float rotDeg;
+};
+
+SymbolPlacement placeSymbol(const Element& elem, int instance, float scale);
+
+} // namespace opticsketch
@@ -0,0 +1,260 @@
+#include "jobs/job_system.h"
+#include <algorithm>
+
+namespace opticsketch {
+
+JobSystem& JobSystem::instance() {
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+JobSystem::~JobSystem() {
+    shutdown();
+}
+
+int JobSystem::resolveThreadCount(int requested) {
+    if (requested > 0) return requested;
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw > 0 ? static_cast<int>(hw) : 1;
+}
+
+int JobSystem::getWorkerCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(workers.size());
+}
+
+// Called with mutex held. The pool starts at one thread per spare core and only grows
+// when a parallelFor asks for more.
+void JobSystem::ensureWorkers(int count) {
+    if (stopping) return;
+    while (static_cast<int>(workers.size()) < count)
+        workers.emplace_back(&JobSystem::workerLoop, this);
+}
+
+JobSystem::JobRef JobSystem::findJob(JobId id) const {
+    for (const JobRef& job : jobs)
+        if (job->id == id) return job;
+    return nullptr;
+}
+
+JobId JobSystem::submit(const std::string& label, JobPriority priority, std::function<void(JobContext&)> work,
+                        std::function<void()> done) {
+    auto job = std::make_shared<Job>();
+    job->label = label;
+    job->priority = priority;
+    job->work = std::move(work);
+    job->done = std::move(done);
+    bool runInline;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->id = nextId++;
+        runInline = stopping;
+        if (!runInline) {
+            ensureWorkers(std::max(1, resolveThreadCount(0) - 1));
+            jobs.push_back(job);
+            queues[static_cast<int>(priority)].push_back(job);
+        }
+    }
+    if (runInline) {
+        // No workers anymore (application exit): do it now
+        JobContext context(job->token, &job->progress);
+        if (job->work) job->work(context);
+        return job->id;
+    }
+    workReady.notify_one();
+    return job->id;
+}
+
+void JobSystem::cancel(JobId id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (JobRef job = findJob(id)) job->token.cancel();
+}
+
+bool JobSystem::isPending(JobId id) const {
+    if (id == 0) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    return findJob(id) != nullptr;
+}
+
+void JobSystem::wait(JobId id) {
+    if (id == 0) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    JobRef job = findJob(id);
+    if (!job) return;
+    if (!job->running) {
+        // Still queued: take it, rather than wait behind whatever is ahead of it
+        auto& queue = queues[static_cast<int>(job->priority)];
+        queue.erase(std::find(queue.begin(), queue.end(), job));
+        job->running = true;
+        lock.unlock();
+        run(job);
+        return;
+    }
+    jobDone.wait(lock, [&] { return !findJob(id); });
+}
+
+void JobSystem::run(const JobRef& job) {
+    JobContext context(job->token, &job->progress);
+    if (job->work) job->work(context);
+    job->work = nullptr;    // release captures on the worker, not on whoever holds the ref last
+
+    if (job->done) runOnMainThread(std::move(job->done));
+    if (job->id == 0) return;   // parallelFor helper, never listed
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.erase(std::remove(jobs.begin(), jobs.end(), job), jobs.end());
+    }
+    jobDone.notify_all();
+}
+
+void JobSystem::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        JobRef job;
+        workReady.wait(lock, [&] {
+            for (auto& queue : queues)
+                if (!queue.empty()) return true;
+            return stopping;
+        });
+        for (auto& queue : queues) {
+            if (queue.empty()) continue;
+            job = std::move(queue.front());
+            queue.pop_front();
+            break;
+        }
+        if (!job) return;   // stopping with nothing left to run
+        job->running = true;
+        lock.unlock();
+        run(job);
+        lock.lock();
+    }
+}
+
+void JobSystem::runOnMainThread(std::function<void()> fn) {
+    std::function<void()> wakeFn;
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        if (stopped) return;
+        mainQueue.push_back(std::move(fn));
+        mainPending.store(static_cast<int>(mainQueue.size()));
+        wakeFn = wake;
+    }
+    if (wakeFn) wakeFn();
+}
+
+int JobSystem::pumpMainThread() {
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        ready.swap(mainQueue);
+        mainPending.store(0);
+    }
+    // Continuations may submit more jobs or queue further continuations (next pump)
+    for (auto& fn : ready) fn();
+    return static_cast<int>(ready.size());
+}
+
+void JobSystem::setWakeCallback(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(mainMutex);
+    wake = std::move(fn);
+}
+
+// State shared by the caller and helpers of one parallelFor. Helpers that start after
+// the caller has finished the batch find it closed and leave without touching fn.
+struct ParallelBatch {
+    const std::function<void(int)>* fn = nullptr;
+    int jobCount = 0;
+    std::atomic<int> next{0};
+    std::mutex mutex;
+    std::condition_variable idle;
+    int active = 0;
+    bool closed = false;
+
+    void drain() {
+        for (;;) {
+            int index = next.fetch_add(1);
+            if (index >= jobCount) return;
+            (*fn)(index);
+        }
+    }
+};
+
+void JobSystem::parallelFor(int jobCount, int threadCount, const std::function<void(int)>& fn) {
+    if (jobCount <= 0) return;
+    int threads = std::min(resolveThreadCount(threadCount), jobCount);
+    if (threads <= 1 || stopped.load()) {
+        for (int i = 0; i < jobCount; i++) fn(i);
+        return;
+    }
+
+    auto batch = std::make_shared<ParallelBatch>();
+    batch->fn = &fn;
+    batch->jobCount = jobCount;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ensureWorkers(threads - 1);
+        // Helpers jump the queue: the caller (often the UI thread) is blocked on them
+        for (int i = 0; i < threads - 1; i++) {
+            auto helper = std::make_shared<Job>();
+            helper->priority = JobPriority::High;
+            helper->work = [batch](JobContext&) {
+                {
+                    std::lock_guard<std::mutex> batchLock(batch->mutex);
+                    if (batch->closed) return;
+                    batch->active++;
+                }
+                batch->drain();
+                std::lock_guard<std::mutex> batchLock(batch->mutex);
+                batch->active--;
+                batch->idle.notify_all();
+            };
+            queues[static_cast<int>(JobPriority::High)].push_front(helper);
+        }
+    }
+    workReady.notify_all();
+
+    // The calling thread works too, and can finish the batch alone if the pool is busy
+    batch->drain();
+
+    // Every helper that got in must check out before fn goes out of scope
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->closed = true;
+    batch->idle.wait(lock, [&] { return batch->active == 0; });
+}
+
+void JobSystem::activeJobs(std::vector<JobInfo>& out) const {
+    out.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const JobRef& job : jobs) {
+        if (job->label.empty()) continue;
+        out.push_back({job->id, job->label, job->priority, job->progress.load(std::memory_order_relaxed),
+                       job->running, job->token.isCancelled()});
+    }
+}
+
+bool JobSystem::isBusy() const {
+    if (mainPending.load() > 0) return true;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const JobRef& job : jobs)
+        if (!job->label.empty()) return true;
+    return false;
+}
+
+void JobSystem::shutdown() {
+    std::vector<std::thread> joining;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        for (const JobRef& job : jobs) job->token.cancel();
+        stopping = true;
+        joining.swap(workers);
+    }
+    workReady.notify_all();
+    for (auto& t : joining) t.join();
+    stopped.store(true);
+    std::lock_guard<std::mutex> lock(mainMutex);
+    mainQueue.clear();
+    mainPending.store(0);
+}
+
+} // namespace opticsketch
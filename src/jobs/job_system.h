@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace opticsketch {
+
+// Workers always take the most urgent queued job first
+enum class JobPriority {
+    High,       // the user is waiting on it: trace batches, saves, image writes
+    Normal,     // imports and mesh streaming
+    Low         // background chores: autosave, tool probes
+};
+static constexpr int kJobPriorityCount = 3;
+
+using JobId = uint64_t;     // 0 = no job
+
+// Shared cancel flag. Copies refer to the same flag, so one token can be handed to
+// several jobs (or to an API that polls a plain atomic) and cancelled once.
+class CancelToken {
+public:
+    CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+    void cancel() const { flag->store(true); }
+    bool isCancelled() const { return flag->load(std::memory_order_relaxed); }
+    // For code that polls a flag directly (MeshLoadControl::cancel)
+    const std::atomic<bool>* get() const { return flag.get(); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// What a running job sees of itself
+class JobContext {
+public:
+    bool isCancelled() const { return token.isCancelled(); }
+    const CancelToken& getToken() const { return token; }
+    // 0..1, shown in the jobs list
+    void setProgress(float p) { progress->store(p, std::memory_order_relaxed); }
+
+private:
+    friend class JobSystem;
+    JobContext(CancelToken token, std::atomic<float>* progress) : token(std::move(token)), progress(progress) {}
+    CancelToken token;
+    std::atomic<float>* progress;
+};
+
+// Application-wide worker pool. Features submit work here instead of owning threads:
+// the tracer's parallel batches, OBJ import, mesh streaming, autosave, project saves,
+// image and animation encoding. A job's 'done' continuation runs on the main thread
+// from pumpMainThread(), which is where results touch the scene or upload to GL.
+// Cancelling only raises the job's token; work always runs to its own exit, so a job
+// that must not be skipped (a save) simply never polls it.
+class JobSystem {
+public:
+    struct JobInfo {
+        JobId id;
+        std::string label;
+        JobPriority priority;
+        float progress;
+        bool running;
+        bool cancelRequested;
+    };
+
+    static JobSystem& instance();
+
+    // Queue 'work' for a worker. 'label' names it in the jobs list (empty keeps it out);
+    // 'done', if given, is queued for the main thread once work returns.
+    JobId submit(const std::string& label, JobPriority priority, std::function<void(JobContext&)> work,
+                 std::function<void()> done = {});
+
+    // Raise a job's cancel token; unknown or finished ids are ignored
+    void cancel(JobId id);
+    // True until the job's work has returned
+    bool isPending(JobId id) const;
+    // Block until the job's work has returned. A job still in the queue is run on the
+    // calling thread rather than waited for. Its continuation stays queued.
+    void wait(JobId id);
+
+    // Queue fn for the main thread (any thread may call this)
+    void runOnMainThread(std::function<void()> fn);
+    // Run the queued continuations; main thread, once per frame. Returns how many ran.
+    int pumpMainThread();
+    // Called from workers after queuing a continuation, so a main loop blocked waiting
+    // for events wakes up (glfwPostEmptyEvent)
+    void setWakeCallback(std::function<void()> fn);
+
+    // Fork-join: fn(index) for index in [0, jobCount) on up to threadCount threads
+    // (<= 0 = hardware concurrency), the caller included. Indices come from a shared
+    // counter, so threads that finish early keep pulling work. Blocks until all are done;
+    // safe to nest, since the caller alone can finish the batch.
+    void parallelFor(int jobCount, int threadCount, const std::function<void(int)>& fn);
+    static int resolveThreadCount(int requested);
+
+    // Labelled jobs that have not finished, oldest first
+    void activeJobs(std::vector<JobInfo>& out) const;
+    // Labelled jobs in flight or continuations waiting for the main thread
+    bool isBusy() const;
+    int getWorkerCount() const;
+
+    // Cancel everything, let the workers finish what is queued, and stop them. Queued
+    // continuations are dropped. Later submits run inline on the caller.
+    void shutdown();
+
+private:
+    JobSystem() = default;
+    ~JobSystem();
+
+    struct Job {
+        JobId id = 0;
+        std::string label;
+        JobPriority priority = JobPriority::Normal;
+        std::function<void(JobContext&)> work;
+        std::function<void()> done;
+        CancelToken token;
+        std::atomic<float> progress{0.0f};
+        bool running = false;
+    };
+    using JobRef = std::shared_ptr<Job>;
+
+    // Called with mutex held
+    void ensureWorkers(int count);
+    JobRef findJob(JobId id) const;
+    void workerLoop();
+    void run(const JobRef& job);
+
+    mutable std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable jobDone;
+    std::deque<JobRef> queues[kJobPriorityCount];
+    std::vector<JobRef> jobs;           // submitted and not finished, in submit order
+    std::vector<std::thread> workers;
+    JobId nextId = 1;
+    bool stopping = false;
+    std::atomic<bool> stopped{false};   // workers joined
+
+    std::mutex mainMutex;
+    std::vector<std::function<void()>> mainQueue;
+    std::function<void()> wake;
+    std::atomic<int> mainPending{0};
+};
+
+} // namespace opticsketch
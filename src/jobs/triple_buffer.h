@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+
+namespace opticsketch {
+
+// Lock-free handoff of the newest value from one producer thread to one consumer thread.
+// Of the three slots the producer owns one (back), the consumer one (front), and the third
+// holds the latest published value. Publishing and acquiring swap a slot with that middle
+// one, so neither side ever waits and no slot is touched by both at once; values the
+// consumer did not get to are overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer: the slot to fill, then publish() it. The slot handed back may hold an old
+    // value (one the consumer skipped or finished with), for reuse.
+    T& back() { return slots[backIndex]; }
+    void publish() {
+        backIndex = middle.exchange(backIndex | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // Consumer: switch front() to the newest published value; false if there is none since
+    // the previous acquire
+    bool acquire() {
+        if (!(middle.load(std::memory_order_acquire) & kFresh)) return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+    T& front() { return slots[frontIndex]; }
+
+    // Every slot, for setup and teardown while neither thread is running
+    T& slot(int index) { return slots[index]; }
+
+private:
+    static constexpr int kIndexMask = 3;
+    static constexpr int kFresh = 4;
+
+    T slots[3];
+    int backIndex = 0;      // producer only
+    int frontIndex = 1;     // consumer only
+    std::atomic<int> middle{2};
+};
+
+} // namespace opticsketch
@@ -21,8 +21,14 @@
 #include "render/gizmo.h"
 #include "render/beam.h"
 #include "render/mesh_loader.h"
+#include "render/environment_map.h"
+#include "render/render_thread.h"
 #include "scene/scene.h"
+#include "scene/pick_index.h"
 #include "project/project.h"
+#include "project/autosave.h"
+#include "project/project_journal.h"
+#include "project/mesh_streamer.h"
 #include "elements/basic_elements.h"
 #include "elements/annotation.h"
 #include "elements/measurement.h"
@@ -30,18 +36,25 @@
 #include "style/scene_style.h"
 #include "export/export_tikz.h"
 #include "export/export_svg.h"
+#include "export/export_pdf.h"
 #include "input/shortcut_manager.h"
 #include "optics/ray_tracer.h"
 #include "ui/style_editor_panel.h"
 #include "ui/shortcuts_panel.h"
 #include "ui/template_panel.h"
 #include "ui/animation_export_panel.h"
+#include "ui/spot_diagram_panel.h"
+#include "ui/profiler_panel.h"
+#include "profile/profiler.h"
+#include "jobs/job_system.h"
 #include "templates/templates.h"
 
 // Ensure path ends with .optsk for save (so Open can find the file)
 static std::string ensureOptskExtension(const std::string& path) {
     if (path.size() >= 6 && path.compare(path.size() - 6, 6, ".optsk") == 0)
         return path;
+    if (path.size() >= 7 && path.compare(path.size() - 7, 7, ".optskb") == 0)
+        return path;
     return path + ".optsk";
 }
 
@@ -95,6 +108,25 @@ static std::string trimPath(const char* path) {
     return s.substr(start, end == std::string::npos ? end : end - start + 1);
 }
 
+// Per-user cache directory (%APPDATA%, $XDG_CONFIG_HOME or ~/.config); empty if the
+// directory cannot be created, which disables that cache
+static std::string userCacheDirectory(const char* name) {
+    namespace fs = std::filesystem;
+#ifdef _WIN32
+    const char* base = std::getenv("APPDATA");
+    fs::path dir = base ? fs::path(base) : fs::path();
+#else
+    const char* xdg = std::getenv("XDG_CONFIG_HOME");
+    const char* home = std::getenv("HOME");
+    fs::path dir = (xdg && *xdg) ? fs::path(xdg) : home ? fs::path(home) / ".config" : fs::path();
+#endif
+    if (dir.empty()) return std::string();
+    dir = dir / "opticsketch" / name;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    return ec ? std::string() : dir.string();
+}
+
 // Input state
 struct InputState {
     bool leftMouseDown = false;
@@ -142,8 +174,34 @@ struct ManipulatorDragState {
 struct AppState {
     InputState input;
     opticsketch::Viewport* viewport = nullptr;
+    // On-demand rendering: input keeps the loop running for a few frames, after which it
+    // sleeps in glfwWaitEventsTimeout and the viewport texture is reused as-is
+    bool onDemandRendering = true;
+    int uiActiveFrames = 0;        // frames left before the loop may sleep
+    int viewportDirtyFrames = 0;   // frames left in which the viewport is re-rendered
+    bool continuousFrames = false; // camera/manipulator drags render every frame regardless
 };
 
+// Frames to keep rendering after the last event so ImGui and scene edits settle
+static constexpr int kActiveFramesAfterInput = 4;
+// Longest idle sleep; bounds the latency of anything not driven by input events
+static constexpr double kIdleWaitSeconds = 0.5;
+
+// Called from the GLFW input callbacks. Pure cursor motion only keeps the UI live;
+// everything else may have edited the scene, style or camera.
+static void noteInput(GLFWwindow* window, bool viewportChanged) {
+    AppState* app = static_cast<AppState*>(glfwGetWindowUserPointer(window));
+    if (!app) return;
+    app->uiActiveFrames = kActiveFramesAfterInput;
+    if (viewportChanged) app->viewportDirtyFrames = kActiveFramesAfterInput;
+}
+
+static void cursorPosCallback(GLFWwindow* window, double, double) { noteInput(window, false); }
+static void mouseButtonCallback(GLFWwindow* window, int, int, int) { noteInput(window, true); }
+static void keyCallback(GLFWwindow* window, int, int, int, int) { noteInput(window, true); }
+static void charCallback(GLFWwindow* window, unsigned int) { noteInput(window, true); }
+static void windowRefreshCallback(GLFWwindow* window) { noteInput(window, true); }
+
 // Snap-to-beam result
 struct BeamSnapResult {
     bool snapped = false;
@@ -154,32 +212,80 @@ struct BeamSnapResult {
     std::string beamId;
 };
 
-static BeamSnapResult findBeamSnap(const opticsketch::Scene& scene,
+static BeamSnapResult findBeamSnap(opticsketch::PickIndex& pickIndex, const opticsketch::Scene& scene,
                                    const glm::vec3& pos, float radius) {
     BeamSnapResult result;
-    float bestDistSq = radius * radius;
-    for (const auto& beam : scene.getBeams()) {
-        if (!beam->visible) continue;
-        float t;
-        glm::vec3 closest;
-        float distSq = opticsketch::Raycast::pointToSegmentSqDist(pos, beam->start, beam->end, t, closest);
-        if (distSq < bestDistSq) {
-            bestDistSq = distSq;
-            result.snapped = true;
-            result.snapPosition = closest;
-            result.beamDirection = glm::normalize(beam->end - beam->start);
-            result.beamStart = beam->start;
-            result.beamEnd = beam->end;
-            result.beamId = beam->id;
-        }
-    }
+    pickIndex.update(scene);
+    opticsketch::PickIndex::BeamPoint hit = pickIndex.nearestBeamPoint(pos, radius);
+    if (!hit.found) return result;
+    result.snapped = true;
+    result.snapPosition = hit.point;
+    result.beamDirection = glm::normalize(hit.end - hit.start);
+    result.beamStart = hit.start;
+    result.beamEnd = hit.end;
+    // Traced rays snap too; they have no beam id
+    if (hit.beam) result.beamId = hit.beam->id;
     return result;
 }
 
+// Paste the clipboard 1 unit along +X as one undo step: the copies go through the bulk
+// scene inserts (one pass for unique ids/labels) and become the selection. Clones share
+// imported mesh assets with the clipboard rather than copying them.
+static void pasteClipboard(opticsketch::Scene& scene, opticsketch::UndoStack& undoStack,
+                           const std::vector<std::unique_ptr<opticsketch::Element>>& clipElements,
+                           const std::vector<std::unique_ptr<opticsketch::Beam>>& clipBeams,
+                           const std::vector<std::unique_ptr<opticsketch::Annotation>>& clipAnnotations) {
+    if (clipElements.empty() && clipBeams.empty() && clipAnnotations.empty()) return;
+    const glm::vec3 offset(1.0f, 0.0f, 0.0f);
+    std::vector<std::unique_ptr<opticsketch::Element>> elements;
+    elements.reserve(clipElements.size());
+    for (const auto& ce : clipElements) {
+        elements.push_back(ce->clone());
+        elements.back()->transform.position += offset;
+    }
+    std::vector<std::unique_ptr<opticsketch::Beam>> beams;
+    beams.reserve(clipBeams.size());
+    for (const auto& cb : clipBeams) {
+        beams.push_back(cb->clone());
+        beams.back()->start += offset;
+        beams.back()->end += offset;
+    }
+    std::vector<std::unique_ptr<opticsketch::Annotation>> annotations;
+    annotations.reserve(clipAnnotations.size());
+    for (const auto& ca : clipAnnotations) {
+        annotations.push_back(ca->clone());
+        annotations.back()->position += offset;
+    }
+
+    scene.deselectAll();
+    std::vector<opticsketch::Element*> addedElements = scene.addElements(std::move(elements));
+    std::vector<opticsketch::Beam*> addedBeams = scene.addBeams(std::move(beams));
+    std::vector<opticsketch::Annotation*> addedAnnotations = scene.addAnnotations(std::move(annotations));
+    for (auto* e : addedElements) scene.selectElement(e->id, true);
+    for (auto* b : addedBeams) scene.selectBeam(b->id, true);
+    for (auto* a : addedAnnotations) scene.selectAnnotation(a->id, true);
+    undoStack.push(std::make_unique<opticsketch::AddObjectsCmd>(addedElements, addedBeams, addedAnnotations));
+}
+
+// Click selection: Shift toggles the hit, otherwise it becomes the only selection
+// (elements take precedence over beams; a miss clears the selection)
+static void applyClickSelection(opticsketch::Scene& scene, opticsketch::Element* element,
+                                opticsketch::Beam* beam, bool toggle) {
+    if (toggle) {
+        if (element) scene.toggleSelect(element->id);
+        else if (beam) scene.toggleSelect(beam->id);
+    } else {
+        if (element) scene.selectElement(element->id);
+        else if (beam) scene.selectBeam(beam->id);
+        else scene.deselectAll();
+    }
+}
+
 // Scroll callback - scroll wheel for zoom (even without CTRL)
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
     AppState* app = static_cast<AppState*>(glfwGetWindowUserPointer(window));
     if (!app || !app->viewport) return;
+    noteInput(window, true);
 
     if (!ImGui::GetIO().WantCaptureMouse) {
         app->viewport->getCamera().zoom(static_cast<float>(yoffset));
@@ -207,6 +313,8 @@ int main() {
     
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);  // VSync
+    // Finished jobs with main-thread continuations wake the idle wait below
+    opticsketch::JobSystem::instance().setWakeCallback([] { glfwPostEmptyEvent(); });
     
     // Load OpenGL functions
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -215,9 +323,15 @@ int main() {
         return -1;
     }
     
+    // Linked shader programs are cached per driver, so later launches skip compilation
+    opticsketch::Shader::setBinaryCacheDirectory(userCacheDirectory("shader_cache"));
+    opticsketch::setEnvironmentCacheDirectory(userCacheDirectory("environment_cache"));
+
     // Create viewport
     opticsketch::Viewport viewport;
     viewport.init(800, 600);
+    // Optional (View > Render Thread): draws the viewport on its own context from snapshots
+    opticsketch::RenderThread renderThread;
     
     // Create scene
     opticsketch::Scene scene;
@@ -225,6 +339,7 @@ int main() {
 
     // Undo/Redo stack
     opticsketch::UndoStack undoStack;
+    opticsketch::PickIndex pickIndex;   // picking, beam snapping and marquee queries
 
     // Clipboard for copy/paste (multi-select: stores vectors)
     std::vector<std::unique_ptr<opticsketch::Element>> clipboardElements;
@@ -242,6 +357,8 @@ int main() {
     opticsketch::ShortcutsPanel shortcutsPanel;
     opticsketch::TemplatePanel templatePanel;
     opticsketch::AnimationExportPanel animExportPanel;
+    opticsketch::SpotDiagramPanel spotDiagramPanel;
+    opticsketch::ProfilerPanel profilerPanel;
 
     // Keyboard shortcuts manager
     opticsketch::ShortcutManager shortcutMgr;
@@ -252,11 +369,10 @@ int main() {
     opticsketch::SceneStyle sceneStyle;
     viewport.setStyle(&sceneStyle);
 
-    // Generate 3D thumbnail previews for library panel
-    viewport.generateThumbnails();
-    for (int i = 0; i < (int)opticsketch::ElementType::ImportedMesh; i++) {
-        libraryPanel.setThumbnailTexture(i, viewport.getThumbnailTexture(i));
-    }
+    // 3D thumbnail previews for the library panel: cached ones load from disk, the rest
+    // are rendered a few per frame as their cards come on screen
+    viewport.loadThumbnailCache("opticsketch_thumbs.cache");
+    libraryPanel.setThumbnailProvider([&viewport](int typeIndex) { return viewport.acquireThumbnail(typeIndex); });
 
     // Application state
     AppState app;
@@ -269,8 +385,13 @@ int main() {
     app.input.lastMouseX = initMouseX;
     app.input.lastMouseY = initMouseY;
 
-    // Register scroll callback BEFORE ImGui — ImGui chains to it
+    // Register input callbacks BEFORE ImGui — ImGui chains to them
     glfwSetScrollCallback(window, scrollCallback);
+    glfwSetCursorPosCallback(window, cursorPosCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetCharCallback(window, charCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 
     // ImGui init
     IMGUI_CHECKVERSION();
@@ -296,9 +417,101 @@ int main() {
     style.AntiAliasedFill = true;
     style.AntiAliasedLinesUseTex = true; // Use texture-based anti-aliasing for lines
     
+    // Add a library element at a ground-plane drop position (snapping to beams if enabled)
+    // as one undoable step and select it
+    auto placeDroppedElement = [&](std::unique_ptr<opticsketch::Element> elem, const glm::vec3& dropPos) {
+        if (!elem) return;
+        elem->transform.position = dropPos;
+        // Snap dropped element to beam if enabled
+        if (sceneStyle.snapToBeam && sceneStyle.beamSnapRadius > 0.0f) {
+            BeamSnapResult dropSnap = findBeamSnap(pickIndex, scene, dropPos, sceneStyle.beamSnapRadius);
+            if (dropSnap.snapped) {
+                elem->transform.position = dropSnap.snapPosition;
+                if (sceneStyle.autoOrientToBeam) {
+                    glm::vec3 up(0.0f, 1.0f, 0.0f);
+                    float angle = std::atan2(dropSnap.beamDirection.x, dropSnap.beamDirection.z);
+                    elem->transform.rotation = glm::angleAxis(angle, up);
+                }
+            }
+        }
+        elem->markTransformDirty();
+        scene.addElement(std::move(elem));
+        auto* added = scene.getElements().back().get();
+        undoStack.push(std::make_unique<opticsketch::AddElementCmd>(*added));
+        scene.selectElement(added->id);
+    };
+
+    // Background OBJ import started by dropping an imported-mesh library item
+    opticsketch::MeshImportJob meshImport;
+    glm::vec3 pendingMeshDropPos(0.0f);
+
+    // Periodic crash-recovery saves, serialized and written by a background job
+    opticsketch::Autosave autosave;
+
+    // Imported mesh geometry of opened projects, loaded in the background most-visible first
+    opticsketch::MeshStreamer meshStreamer;
+    // Persistent so its BVH is refit, not rebuilt (and GPU trace buffers are reused)
+    opticsketch::RayTracer rayTracer;
+    // Saves of the open project append its changes to a journal beside it. Only the job
+    // running a save touches it; the UI waits for that job before re-attaching it.
+    opticsketch::ProjectJournal projectJournal;
+    // Saves embed/reference every mesh, so anything still streaming is loaded first. The
+    // scene is snapshotted here and written by a job; a failure is reported when it ends.
+    // 'compact' rewrites the whole project instead of appending to its journal.
+    opticsketch::JobId saveJob = 0;
+    auto saveProjectFile = [&](const std::string& path, bool compact) {
+        meshStreamer.finishAll(scene);
+        rayTracer.readBackGpuTrace(&scene);
+        auto& jobs = opticsketch::JobSystem::instance();
+        // One save at a time, so two writes never race on the same file
+        jobs.wait(saveJob);
+        std::shared_ptr<opticsketch::Scene> snapshot = scene.snapshot();
+        opticsketch::SceneStyle style = sceneStyle;
+        auto ok = std::make_shared<bool>(false);
+        std::string name = std::filesystem::path(path).filename().string();
+        saveJob = jobs.submit("Saving " + name, opticsketch::JobPriority::High,
+            [snapshot, style, path, compact, ok, &projectJournal](opticsketch::JobContext&) mutable {
+                *ok = projectJournal.save(path, snapshot.get(), &style, compact);
+            },
+            [ok, path]() {
+                if (*ok) return;
+                std::string msg = "Could not save project:\n" + path;
+                tinyfd_messageBox("Save failed", msg.c_str(), "ok", "error", 1);
+            });
+        return true;
+    };
+    // The scene now stands for 'path' on disk (empty = untitled)
+    auto attachProjectJournal = [&](const std::string& path) {
+        opticsketch::JobSystem::instance().wait(saveJob);
+        if (path.empty()) projectJournal.detach();
+        else projectJournal.attach(path, scene, &sceneStyle);
+    };
+    // Image exports render here and are encoded by a job; the message box follows when done
+    auto reportExport = [](const char* title, const char* savedMsg, const char* failedMsg) {
+        return [title, savedMsg, failedMsg](bool ok) {
+            if (ok) tinyfd_messageBox(title, savedMsg, "ok", "info", 1);
+            else tinyfd_messageBox("Export failed", failedMsg, "ok", "error", 1);
+        };
+    };
+
     // Main loop
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        bool idle = app.uiActiveFrames <= 0 && app.viewportDirtyFrames <= 0 && !app.continuousFrames &&
+                    !(renderThread.isRunning() ? renderThread.isFrameStale() : viewport.isFrameStale()) &&
+                    !animExportPanel.isExporting() && !meshImport.isRunning() &&
+                    !meshStreamer.isStreaming() && !viewport.hasPendingThumbnails() && !rayTracer.isTracing() &&
+                    !opticsketch::Profiler::instance().isCapturing() && !opticsketch::JobSystem::instance().isBusy();
+        if (app.onDemandRendering && idle) {
+            glfwWaitEventsTimeout(kIdleWaitSeconds);
+        } else {
+            glfwPollEvents();
+        }
+        // Frame time excludes the idle wait above
+        opticsketch::Profiler::instance().beginFrame();
+
+        // Results of finished jobs (GPU uploads, scene updates, message boxes)
+        if (opticsketch::JobSystem::instance().pumpMainThread() > 0)
+            app.viewportDirtyFrames = kActiveFramesAfterInput;
 
         // Poll mouse buttons — avoids callback ordering issues with ImGui
         {
@@ -362,43 +575,46 @@ int main() {
             // File shortcuts
             if (shortcutMgr.justPressed("file.new")) {
                 scene.clear();
+                meshStreamer.clear();
                 undoStack.clear();
                 projectPath.clear();
+                attachProjectJournal("");
                 glfwSetWindowTitle(window, "OpticSketch - Untitled");
             }
             if (shortcutMgr.justPressed("file.save_as")) {
-                const char* filters[] = { "*.optsk" };
-                const char* path = tinyfd_saveFileDialog("Save OpticSketch Project As", projectPath.empty() ? "untitled.optsk" : projectPath.c_str(), 1, filters, "OpticSketch Project (*.optsk)");
+                const char* filters[] = { "*.optsk", "*.optskb" };
+                const char* path = tinyfd_saveFileDialog("Save OpticSketch Project As", projectPath.empty() ? "untitled.optsk" : projectPath.c_str(), 2, filters, "OpticSketch Project (*.optsk, *.optskb)");
                 if (path) {
                     std::string savePath = ensureOptskExtension(path);
-                    if (opticsketch::saveProject(savePath, &scene, &sceneStyle)) {
+                    if (saveProjectFile(savePath, true)) {
                         projectPath = savePath;
                         glfwSetWindowTitle(window, ("OpticSketch - " + projectPath.substr(projectPath.find_last_of("/\\") + 1)).c_str());
                     }
                 }
             } else if (shortcutMgr.justPressed("file.save")) {
                 if (projectPath.empty()) {
-                    const char* filters[] = { "*.optsk" };
-                    const char* path = tinyfd_saveFileDialog("Save OpticSketch Project", "untitled.optsk", 1, filters, "OpticSketch Project (*.optsk)");
+                    const char* filters[] = { "*.optsk", "*.optskb" };
+                    const char* path = tinyfd_saveFileDialog("Save OpticSketch Project", "untitled.optsk", 2, filters, "OpticSketch Project (*.optsk, *.optskb)");
                     if (path) {
                         std::string savePath = ensureOptskExtension(path);
-                        if (opticsketch::saveProject(savePath, &scene, &sceneStyle)) {
+                        if (saveProjectFile(savePath, true)) {
                             projectPath = savePath;
                             glfwSetWindowTitle(window, ("OpticSketch - " + projectPath.substr(projectPath.find_last_of("/\\") + 1)).c_str());
                         }
                     }
                 } else {
-                    opticsketch::saveProject(projectPath, &scene, &sceneStyle);
+                    saveProjectFile(projectPath, false);
                 }
             }
             if (shortcutMgr.justPressed("file.open")) {
-                const char* filters[] = { "*.optsk" };
-                const char* path = tinyfd_openFileDialog("Open OpticSketch Project", projectPath.empty() ? nullptr : projectPath.c_str(), 1, filters, "OpticSketch Project (*.optsk)", 0);
+                const char* filters[] = { "*.optsk", "*.optskb" };
+                const char* path = tinyfd_openFileDialog("Open OpticSketch Project", projectPath.empty() ? nullptr : projectPath.c_str(), 2, filters, "OpticSketch Project (*.optsk, *.optskb)", 0);
                 if (path) {
                     std::string openPath = trimPath(path);
-                    if (!openPath.empty() && opticsketch::loadProject(openPath, &scene, &sceneStyle)) {
+                    if (!openPath.empty() && opticsketch::loadProject(openPath, &scene, &sceneStyle, &meshStreamer)) {
                         undoStack.clear();
                         projectPath = openPath;
+                        attachProjectJournal(projectPath);
                         glfwSetWindowTitle(window, ("OpticSketch - " + projectPath.substr(projectPath.find_last_of("/\\") + 1)).c_str());
                     } else if (!openPath.empty())
                         tinyfd_messageBox("Open failed", "Could not open project file or file format is invalid.", "ok", "error", 1);
@@ -410,10 +626,9 @@ int main() {
                 if (path) {
                     std::string p = ensurePngExtension(trimPath(path));
                     if (!p.empty()) {
-                        if (viewport.exportToPng(p, &scene))
-                            tinyfd_messageBox("Export PNG", "Image saved successfully.", "ok", "info", 1);
-                        else
-                            tinyfd_messageBox("Export failed", "Could not save PNG file.", "ok", "error", 1);
+                        meshStreamer.finishAll(scene);
+                        viewport.exportImageAsync(p, &scene, opticsketch::Viewport::ImageFormat::Png,
+                            reportExport("Export PNG", "Image saved successfully.", "Could not save PNG file."));
                     }
                 }
             }
@@ -458,7 +673,7 @@ int main() {
                     glm::vec3 unionMin(FLT_MAX), unionMax(-FLT_MAX);
                     for (auto* e : selElems) {
                         glm::vec3 bMin, bMax;
-                        e->getWorldBounds(bMin, bMax);
+                        e->getArrayWorldBounds(bMin, bMax);
                         unionMin = glm::min(unionMin, bMin);
                         unionMax = glm::max(unionMax, bMax);
                     }
@@ -505,7 +720,7 @@ int main() {
                 for (const auto& elem : scene.getElements()) {
                     if (!elem->visible) continue;
                     glm::vec3 wMin, wMax;
-                    elem->getWorldBounds(wMin, wMax);
+                    elem->getArrayWorldBounds(wMin, wMax);
                     sceneMin = glm::min(sceneMin, wMin);
                     sceneMax = glm::max(sceneMax, wMax);
                     hasObjects = true;
@@ -516,6 +731,12 @@ int main() {
                     sceneMax = glm::max(sceneMax, glm::max(beam->start, beam->end));
                     hasObjects = true;
                 }
+                const opticsketch::TracedRayBuffer& traced = scene.getTracedRays();
+                for (size_t i = 0; i < traced.size(); i++) {
+                    sceneMin = glm::min(sceneMin, glm::min(traced.start[i], traced.end[i]));
+                    sceneMax = glm::max(sceneMax, glm::max(traced.start[i], traced.end[i]));
+                    hasObjects = true;
+                }
                 if (hasObjects) {
                     glm::vec3 center = (sceneMin + sceneMax) * 0.5f;
                     float radius = glm::length(sceneMax - sceneMin) * 0.5f;
@@ -571,42 +792,24 @@ int main() {
                 }
             }
             if (shortcutMgr.justPressed("edit.paste")) {
-                if (!clipboardElements.empty() || !clipboardBeams.empty() || !clipboardAnnotations.empty()) {
-                    scene.deselectAll();
-                    auto compound = std::make_unique<opticsketch::CompoundUndoCmd>();
-                    for (const auto& ce : clipboardElements) {
-                        auto pasted = ce->clone();
-                        pasted->transform.position += glm::vec3(1.0f, 0.0f, 0.0f);
-                        scene.addElement(std::move(pasted));
-                        auto* added = scene.getElements().back().get();
-                        compound->addCommand(std::make_unique<opticsketch::AddElementCmd>(*added));
-                        scene.selectElement(added->id, true);
-                    }
-                    for (const auto& cb : clipboardBeams) {
-                        auto pasted = cb->clone();
-                        pasted->start += glm::vec3(1.0f, 0.0f, 0.0f);
-                        pasted->end += glm::vec3(1.0f, 0.0f, 0.0f);
-                        scene.addBeam(std::move(pasted));
-                        auto* added = scene.getBeams().back().get();
-                        compound->addCommand(std::make_unique<opticsketch::AddBeamCmd>(*added));
-                        scene.selectBeam(added->id, true);
-                    }
-                    for (const auto& ca : clipboardAnnotations) {
-                        auto pasted = ca->clone();
-                        pasted->position += glm::vec3(1.0f, 0.0f, 0.0f);
-                        scene.addAnnotation(std::move(pasted));
-                        auto* added = scene.getAnnotations().back().get();
-                        compound->addCommand(std::make_unique<opticsketch::AddAnnotationCmd>(*added));
-                        scene.selectAnnotation(added->id, true);
-                    }
-                    undoStack.push(std::move(compound));
-                }
+                pasteClipboard(scene, undoStack, clipboardElements, clipboardBeams, clipboardAnnotations);
             }
         }
+
+        // Thumbnails the library panel asked for last frame; the panel shows them next frame
+        if (viewport.renderPendingThumbnails() > 0)
+            app.uiActiveFrames = std::max(app.uiActiveFrames, 1);
         
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
+
+        // Input on secondary platform windows bypasses the GLFW callbacks above
+        if (ImGui::IsAnyItemActive() || ImGui::IsAnyMouseDown() || !io.InputQueueCharacters.empty()) {
+            noteInput(window, true);
+        } else if (io.MouseDelta.x != 0.0f || io.MouseDelta.y != 0.0f) {
+            noteInput(window, false);
+        }
         
         // Mouse position will be updated after viewport rendering
         
@@ -621,6 +824,9 @@ int main() {
 
         // Optics auto-trace state (declared here so it's visible to both menu and render code)
         static bool autoTrace = false;
+        static float autoTraceBudgetMs = 30.0f;   // per-frame limit so edits stay interactive
+        static bool progressiveTrace = true;      // auto-trace in time slices across frames
+        static float traceSliceMs = 8.0f;
         static opticsketch::TraceConfig traceConfig;
 
         // Menu bar
@@ -629,16 +835,19 @@ int main() {
             if (ImGui::BeginMenu("File")) {
                 if (ImGui::MenuItem("New Project", shortcutMgr.getDisplayString("file.new").c_str())) {
                     scene.clear();
+                    meshStreamer.clear();
                     projectPath.clear();
+                    attachProjectJournal("");
                     glfwSetWindowTitle(window, "OpticSketch - Untitled");
                 }
                 if (ImGui::MenuItem("Open Project...", shortcutMgr.getDisplayString("file.open").c_str())) {
-                    const char* filters[] = { "*.optsk" };
-                    const char* path = tinyfd_openFileDialog("Open OpticSketch Project", projectPath.empty() ? nullptr : projectPath.c_str(), 1, filters, "OpticSketch Project (*.optsk)", 0);
+                    const char* filters[] = { "*.optsk", "*.optskb" };
+                    const char* path = tinyfd_openFileDialog("Open OpticSketch Project", projectPath.empty() ? nullptr : projectPath.c_str(), 2, filters, "OpticSketch Project (*.optsk, *.optskb)", 0);
                     if (path) {
                         std::string openPath = trimPath(path);
-                        if (!openPath.empty() && opticsketch::loadProject(openPath, &scene, &sceneStyle)) {
+                        if (!openPath.empty() && opticsketch::loadProject(openPath, &scene, &sceneStyle, &meshStreamer)) {
                             projectPath = openPath;
+                            attachProjectJournal(projectPath);
                             glfwSetWindowTitle(window, ("OpticSketch - " + projectPath.substr(projectPath.find_last_of("/\\") + 1)).c_str());
                         } else if (!openPath.empty())
                             tinyfd_messageBox("Open failed", "Could not open project file or file format is invalid.", "ok", "error", 1);
@@ -646,25 +855,25 @@ int main() {
                 }
                 if (ImGui::MenuItem("Save Project", shortcutMgr.getDisplayString("file.save").c_str())) {
                     if (projectPath.empty()) {
-                        const char* filters[] = { "*.optsk" };
-                        const char* path = tinyfd_saveFileDialog("Save OpticSketch Project", "untitled.optsk", 1, filters, "OpticSketch Project (*.optsk)");
+                        const char* filters[] = { "*.optsk", "*.optskb" };
+                        const char* path = tinyfd_saveFileDialog("Save OpticSketch Project", "untitled.optsk", 2, filters, "OpticSketch Project (*.optsk, *.optskb)");
                         if (path) {
                             std::string savePath = ensureOptskExtension(path);
-                            if (opticsketch::saveProject(savePath, &scene, &sceneStyle)) {
+                            if (saveProjectFile(savePath, true)) {
                                 projectPath = savePath;
                                 glfwSetWindowTitle(window, ("OpticSketch - " + projectPath.substr(projectPath.find_last_of("/\\") + 1)).c_str());
                             }
                         }
                     } else {
-                        opticsketch::saveProject(projectPath, &scene, &sceneStyle);
+                        saveProjectFile(projectPath, false);
                     }
                 }
                 if (ImGui::MenuItem("Save Project As...", shortcutMgr.getDisplayString("file.save_as").c_str())) {
-                    const char* filters[] = { "*.optsk" };
-                    const char* path = tinyfd_saveFileDialog("Save OpticSketch Project As", projectPath.empty() ? "untitled.optsk" : projectPath.c_str(), 1, filters, "OpticSketch Project (*.optsk)");
+                    const char* filters[] = { "*.optsk", "*.optskb" };
+                    const char* path = tinyfd_saveFileDialog("Save OpticSketch Project As", projectPath.empty() ? "untitled.optsk" : projectPath.c_str(), 2, filters, "OpticSketch Project (*.optsk, *.optskb)");
                     if (path) {
                         std::string savePath = ensureOptskExtension(path);
-                        if (opticsketch::saveProject(savePath, &scene, &sceneStyle)) {
+                        if (saveProjectFile(savePath, true)) {
                             projectPath = savePath;
                             glfwSetWindowTitle(window, ("OpticSketch - " + projectPath.substr(projectPath.find_last_of("/\\") + 1)).c_str());
                         }
@@ -677,7 +886,21 @@ int main() {
                     if (path) {
                         std::string p = ensurePngExtension(trimPath(path));
                         if (!p.empty()) {
-                            if (viewport.exportToPng(p, &scene))
+                            meshStreamer.finishAll(scene);
+                            viewport.exportImageAsync(p, &scene, opticsketch::Viewport::ImageFormat::Png,
+                                reportExport("Export PNG", "Image saved successfully.", "Could not save PNG file."));
+                        }
+                    }
+                }
+                if (ImGui::MenuItem("Export PNG at 4x...")) {
+                    const char* filters[] = { "*.png" };
+                    const char* path = tinyfd_saveFileDialog("Export PNG at 4x", "viewport_4x.png", 1, filters, "PNG image (*.png)");
+                    if (path) {
+                        std::string p = ensurePngExtension(trimPath(path));
+                        if (!p.empty()) {
+                            meshStreamer.finishAll(scene);
+                            // Rendered in tiles, so the size is not limited by the framebuffer
+                            if (viewport.exportTiled(p, &scene, viewport.getWidth() * 4, viewport.getHeight() * 4))
                                 tinyfd_messageBox("Export PNG", "Image saved successfully.", "ok", "info", 1);
                             else
                                 tinyfd_messageBox("Export failed", "Could not save PNG file.", "ok", "error", 1);
@@ -690,23 +913,21 @@ int main() {
                     if (path) {
                         std::string p = ensureJpgExtension(trimPath(path));
                         if (!p.empty()) {
-                            if (viewport.exportToJpg(p, &scene))
-                                tinyfd_messageBox("Export JPEG", "Image saved successfully.", "ok", "info", 1);
-                            else
-                                tinyfd_messageBox("Export failed", "Could not save JPEG file.", "ok", "error", 1);
+                            meshStreamer.finishAll(scene);
+                            viewport.exportImageAsync(p, &scene, opticsketch::Viewport::ImageFormat::Jpg,
+                                reportExport("Export JPEG", "Image saved successfully.", "Could not save JPEG file."));
                         }
                     }
                 }
-                if (ImGui::MenuItem("Export PDF...")) {
+                if (ImGui::MenuItem("Export PDF (Raster)...")) {
                     const char* filters[] = { "*.pdf" };
                     const char* path = tinyfd_saveFileDialog("Export PDF", "viewport.pdf", 1, filters, "PDF document (*.pdf)");
                     if (path) {
                         std::string p = ensurePdfExtension(trimPath(path));
                         if (!p.empty()) {
-                            if (viewport.exportToPdf(p, &scene))
-                                tinyfd_messageBox("Export PDF", "PDF saved successfully.", "ok", "info", 1);
-                            else
-                                tinyfd_messageBox("Export failed", "Could not save PDF file.", "ok", "error", 1);
+                            meshStreamer.finishAll(scene);
+                            viewport.exportImageAsync(p, &scene, opticsketch::Viewport::ImageFormat::Pdf,
+                                reportExport("Export PDF", "PDF saved successfully.", "Could not save PDF file."));
                         }
                     }
                 }
@@ -716,6 +937,7 @@ int main() {
                     if (path) {
                         std::string p = ensureTexExtension(trimPath(path));
                         if (!p.empty()) {
+                            rayTracer.readBackGpuTrace(&scene);
                             if (opticsketch::exportTikz(p, &scene, &sceneStyle))
                                 tinyfd_messageBox("Export TikZ", "LaTeX file saved successfully.", "ok", "info", 1);
                             else
@@ -729,6 +951,7 @@ int main() {
                     if (path) {
                         std::string p = ensureSvgExtension(trimPath(path));
                         if (!p.empty()) {
+                            rayTracer.readBackGpuTrace(&scene);
                             if (opticsketch::exportSvg(p, &scene, &sceneStyle))
                                 tinyfd_messageBox("Export SVG", "SVG file saved successfully.", "ok", "info", 1);
                             else
@@ -736,6 +959,20 @@ int main() {
                         }
                     }
                 }
+                if (ImGui::MenuItem("Export PDF...")) {
+                    const char* filters[] = { "*.pdf" };
+                    const char* path = tinyfd_saveFileDialog("Export PDF", "diagram.pdf", 1, filters, "PDF document (*.pdf)");
+                    if (path) {
+                        std::string p = ensurePdfExtension(trimPath(path));
+                        if (!p.empty()) {
+                            rayTracer.readBackGpuTrace(&scene);
+                            if (opticsketch::exportPdf(p, &scene, &sceneStyle))
+                                tinyfd_messageBox("Export PDF", "PDF saved successfully.", "ok", "info", 1);
+                            else
+                                tinyfd_messageBox("Export failed", "Could not save PDF file.", "ok", "error", 1);
+                        }
+                    }
+                }
                 ImGui::Separator();
                 if (ImGui::MenuItem("Export Animation...", "Ctrl+Shift+E")) {
                     animExportPanel.show();
@@ -765,6 +1002,17 @@ int main() {
                     }
                 }
                 ImGui::Separator();
+                bool autosaveEnabled = autosave.isEnabled();
+                if (ImGui::MenuItem("Autosave", nullptr, &autosaveEnabled)) {
+                    autosave.setEnabled(autosaveEnabled);
+                }
+                bool journalEnabled = projectJournal.isEnabled();
+                if (ImGui::MenuItem("Journaled Saves", nullptr, &journalEnabled)) {
+                    // The journal belongs to a running save until it finishes
+                    opticsketch::JobSystem::instance().wait(saveJob);
+                    projectJournal.setEnabled(journalEnabled);
+                }
+                ImGui::Separator();
                 if (ImGui::MenuItem("Exit", "Alt+F4")) {
                     glfwSetWindowShouldClose(window, true);
                 }
@@ -821,34 +1069,7 @@ int main() {
                         clipboardAnnotations.push_back(a->clone());
                 }
                 if (ImGui::MenuItem("Paste", shortcutMgr.getDisplayString("edit.paste").c_str(), false, hasClipboard)) {
-                    scene.deselectAll();
-                    auto compound = std::make_unique<opticsketch::CompoundUndoCmd>();
-                    for (const auto& ce : clipboardElements) {
-                        auto pasted = ce->clone();
-                        pasted->transform.position += glm::vec3(1.0f, 0.0f, 0.0f);
-                        scene.addElement(std::move(pasted));
-                        auto* added = scene.getElements().back().get();
-                        compound->addCommand(std::make_unique<opticsketch::AddElementCmd>(*added));
-                        scene.selectElement(added->id, true);
-                    }
-                    for (const auto& cb : clipboardBeams) {
-                        auto pasted = cb->clone();
-                        pasted->start += glm::vec3(1.0f, 0.0f, 0.0f);
-                        pasted->end += glm::vec3(1.0f, 0.0f, 0.0f);
-                        scene.addBeam(std::move(pasted));
-                        auto* added = scene.getBeams().back().get();
-                        compound->addCommand(std::make_unique<opticsketch::AddBeamCmd>(*added));
-                        scene.selectBeam(added->id, true);
-                    }
-                    for (const auto& ca : clipboardAnnotations) {
-                        auto pasted = ca->clone();
-                        pasted->position += glm::vec3(1.0f, 0.0f, 0.0f);
-                        scene.addAnnotation(std::move(pasted));
-                        auto* added = scene.getAnnotations().back().get();
-                        compound->addCommand(std::make_unique<opticsketch::AddAnnotationCmd>(*added));
-                        scene.selectAnnotation(added->id, true);
-                    }
-                    undoStack.push(std::move(compound));
+                    pasteClipboard(scene, undoStack, clipboardElements, clipboardBeams, clipboardAnnotations);
                 }
                 ImGui::Separator();
                 if (ImGui::MenuItem("Delete", shortcutMgr.getDisplayString("edit.delete").c_str(), false, hasSelection)) {
@@ -920,6 +1141,25 @@ int main() {
                 ImGui::Separator();
                 ImGui::MenuItem("Show Labels", nullptr, &showViewportLabels);
                 ImGui::MenuItem("Show Grid Scale", nullptr, &showGridScale);
+                ImGui::MenuItem("On-Demand Rendering", nullptr, &app.onDemandRendering);
+                bool frustumCulling = viewport.getFrustumCulling();
+                if (ImGui::MenuItem("Frustum Culling", nullptr, &frustumCulling)) {
+                    viewport.setFrustumCulling(frustumCulling);
+                }
+                bool gpuPicking = viewport.isIdBufferEnabled();
+                if (ImGui::MenuItem("GPU Picking", nullptr, &gpuPicking, !renderThread.isRunning())) {
+                    viewport.setIdBufferEnabled(gpuPicking);
+                }
+                bool threaded = renderThread.isRunning();
+                if (ImGui::MenuItem("Render Thread", nullptr, &threaded)) {
+                    if (threaded && renderThread.start(window)) {
+                        // The ID buffer is only filled by the viewport that renders
+                        viewport.setIdBufferEnabled(false);
+                    } else if (!threaded) {
+                        renderThread.stop();
+                    }
+                    app.viewportDirtyFrames = std::max(app.viewportDirtyFrames, 2);
+                }
                 ImGui::Separator();
                 if (ImGui::BeginMenu("View Presets")) {
                     const auto& presets = scene.getViewPresets();
@@ -951,19 +1191,88 @@ int main() {
             // Optics menu
             if (ImGui::BeginMenu("Optics")) {
                 if (ImGui::MenuItem("Trace Rays")) {
-                    opticsketch::RayTracer tracer;
-                    tracer.traceScene(&scene, traceConfig);
+                    rayTracer.traceScene(&scene, traceConfig);
                 }
                 if (ImGui::MenuItem("Clear Traced Rays")) {
                     scene.clearTracedBeams();
                 }
                 ImGui::Separator();
                 ImGui::Checkbox("Auto-Trace", &autoTrace);
+                ImGui::Checkbox("Progressive", &progressiveTrace);
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("Auto-trace a little every frame; beams fill in while editing");
+                if (progressiveTrace)
+                    ImGui::DragFloat("Trace Slice (ms)", &traceSliceMs, 0.5f, 1.0f, 50.0f, "%.1f");
                 ImGui::Separator();
                 ImGui::Text("Trace Config");
                 ImGui::DragInt("Max Bounces", &traceConfig.maxBounces, 1, 1, 100);
                 ImGui::DragFloat("Max Distance (mm)", &traceConfig.maxDistance, 10.0f, 100.0f, 50000.0f, "%.0f");
                 ImGui::DragFloat("Min Intensity", &traceConfig.minIntensity, 0.001f, 0.001f, 1.0f, "%.3f");
+                ImGui::DragInt("Threads (0 = auto)", &traceConfig.threadCount, 1, 0, 64);
+                ImGui::DragInt("Max Segments (0 = no limit)", &traceConfig.maxSegments, 1000.0f, 0, 50000000);
+                ImGui::DragInt("Max Rays / Source (0 = no limit)", &traceConfig.maxRaysPerSource, 1000.0f, 0, 50000000);
+                if (!progressiveTrace)
+                    ImGui::DragFloat("Auto-Trace Budget (ms)", &autoTraceBudgetMs, 1.0f, 0.0f, 1000.0f, "%.0f");
+                ImGui::Checkbox("Merge Identical Rays", &traceConfig.mergeRays);
+                ImGui::SliderInt("White Light Wavelengths", &traceConfig.spectralSamples, 1, opticsketch::kMaxSpectralSamples);
+                {
+                    const char* spectra[] = {"Flat", "Daylight", "Incandescent"};
+                    int spectrum = static_cast<int>(traceConfig.spectrum);
+                    if (ImGui::Combo("Source Spectrum", &spectrum, spectra, 3))
+                        traceConfig.spectrum = static_cast<opticsketch::SourceSpectrum>(spectrum);
+                    bool importance = traceConfig.spectralSampling == opticsketch::SpectralSampling::Importance;
+                    if (ImGui::Checkbox("Importance Sample Spectrum", &importance))
+                        traceConfig.spectralSampling = importance ? opticsketch::SpectralSampling::Importance
+                                                                  : opticsketch::SpectralSampling::Uniform;
+                    if (ImGui::IsItemHovered())
+                        ImGui::SetTooltip("Place wavelengths by spectral power instead of evenly, each carrying an equal share");
+                }
+                ImGui::Checkbox("Share Spectral Paths", &traceConfig.shareSpectralPaths);
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("Trace white light as one ray until a grating or dispersive lens/prism splits it");
+                if (rayTracer.lastTraceTruncated())
+                    ImGui::TextColored(ImVec4(1.0f, 0.7f, 0.3f, 1.0f), "Last trace stopped at a budget");
+                {
+                    bool gpuSupported = opticsketch::GpuTracer::isSupported();
+                    bool useGpu = traceConfig.backend == opticsketch::TraceBackend::Gpu;
+                    if (!gpuSupported) ImGui::BeginDisabled();
+                    if (ImGui::Checkbox("GPU Tracing", &useGpu))
+                        traceConfig.backend = useGpu ? opticsketch::TraceBackend::Gpu : opticsketch::TraceBackend::Cpu;
+                    if (!gpuSupported) ImGui::EndDisabled();
+                    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+                        ImGui::SetTooltip(gpuSupported ? "Trace in a compute shader; segments stay on the GPU until export"
+                                                       : "Needs OpenGL 4.3 compute shaders");
+                }
+                if (ImGui::BeginMenu("Trace Statistics")) {
+                    const opticsketch::TraceStats& stats = rayTracer.lastTraceStats();
+                    const opticsketch::TraceCounters& total = stats.total;
+                    ImGui::Text("Wall time: %.2f ms%s", stats.wallMs, stats.truncated ? " (stopped at a budget)" : "");
+                    ImGui::Text("Rays spawned: %lld", static_cast<long long>(total.raysSpawned));
+                    ImGui::Text("Segments: %lld", static_cast<long long>(total.segments));
+                    if (stats.gpu) {
+                        ImGui::TextDisabled("GPU traces report no per-ray statistics");
+                    } else {
+                        ImGui::Text("Box tests: %lld", static_cast<long long>(total.boxTests));
+                        ImGui::Text("Surface tests: %lld", static_cast<long long>(total.surfaceTests));
+                        ImGui::Text("Max depth: %d", total.maxDepth);
+                        ImGui::Separator();
+                        ImGui::Text("Rays terminated");
+                        for (int i = 0; i < opticsketch::kRayTerminationCount; i++) {
+                            ImGui::BulletText("%s: %lld", opticsketch::rayTerminationName(static_cast<opticsketch::RayTermination>(i)),
+                                              static_cast<long long>(total.terminated[i]));
+                        }
+                        ImGui::Separator();
+                        ImGui::Text("Sources (thread time)");
+                        for (const auto& source : stats.sources) {
+                            ImGui::BulletText("%s: %.2f ms, %lld segments, depth %d",
+                                              source.label.empty() ? source.id.c_str() : source.label.c_str(),
+                                              source.counters.ms, static_cast<long long>(source.counters.segments),
+                                              source.counters.maxDepth);
+                        }
+                        if (stats.sources.empty()) ImGui::TextDisabled("No sources traced");
+                    }
+                    ImGui::EndMenu();
+                }
 
                 ImGui::EndMenu();
             }
@@ -994,6 +1303,12 @@ int main() {
                 if (ImGui::MenuItem("Templates", nullptr, templatePanel.isVisible())) {
                     templatePanel.setVisible(!templatePanel.isVisible());
                 }
+                if (ImGui::MenuItem("Spot Diagram", nullptr, spotDiagramPanel.isVisible())) {
+                    spotDiagramPanel.setVisible(!spotDiagramPanel.isVisible());
+                }
+                if (ImGui::MenuItem("Profiler", nullptr, profilerPanel.isVisible())) {
+                    profilerPanel.setVisible(!profilerPanel.isVisible());
+                }
                 ImGui::EndMenu();
             }
             
@@ -1102,6 +1417,39 @@ int main() {
         ImGui::SameLine();
         ImGui::Text("|");
         ImGui::SameLine();
+        // Background jobs (autosave, imports, saves, encodes) with progress and cancel
+        {
+            std::vector<opticsketch::JobSystem::JobInfo> jobs;
+            opticsketch::JobSystem::instance().activeJobs(jobs);
+            for (const auto& job : jobs) {
+                ImGui::PushID(static_cast<int>(job.id));
+                ImGui::Text("%s%s", job.label.c_str(), job.cancelRequested ? " (cancelling)" : job.running ? "" : " (queued)");
+                ImGui::SameLine();
+                ImGui::ProgressBar(job.progress, ImVec2(80, 0), "");
+                ImGui::SameLine();
+                if (!job.cancelRequested) {
+                    if (ImGui::SmallButton("x")) opticsketch::JobSystem::instance().cancel(job.id);
+                    if (ImGui::IsItemHovered()) ImGui::SetTooltip("Cancel");
+                    ImGui::SameLine();
+                }
+                ImGui::PopID();
+                ImGui::Text("|");
+                ImGui::SameLine();
+            }
+        }
+        if (meshStreamer.isStreaming()) {
+            ImGui::Text("Loading meshes: %zu", meshStreamer.getPendingCount());
+            ImGui::SameLine();
+            ImGui::Text("|");
+            ImGui::SameLine();
+        }
+        if (viewport.getFrustumCulling()) {
+            ImGui::Text("Culled: %d", renderThread.isRunning() ? renderThread.getCulledObjectCount()
+                                                               : viewport.getCulledObjectCount());
+            ImGui::SameLine();
+            ImGui::Text("|");
+            ImGui::SameLine();
+        }
         const char* modeStr = "";
         switch (viewport.getCamera().mode) {
             case opticsketch::CameraMode::TopDown2D: modeStr = "2D Top-Down"; break;
@@ -1111,51 +1459,79 @@ int main() {
         ImGui::Text("Camera: %s", modeStr);
         ImGui::End();
         
-        // Library Panel
-        libraryPanel.render();
-        
-        // Toolbox Panel
-        toolboxPanel.render();
-        
-        // Outliner (scene structure)
-        outlinerPanel.render(&scene);
-        
-        // Properties (selected element)
-        propertiesPanel.render(&scene);
+        {
+            OPTICSKETCH_PROFILE_SCOPE("Panels");
 
-        // Style editor
-        styleEditorPanel.render(&sceneStyle);
+            // Library Panel
+            libraryPanel.render();
 
-        // Regenerate thumbnails if style colors changed
-        {
-            static glm::vec3 prevColors[14] = {};
-            bool colorsChanged = false;
-            for (int ci = 0; ci < 14; ci++) {
-                if (prevColors[ci] != sceneStyle.elementColors[ci]) {
-                    colorsChanged = true;
-                    prevColors[ci] = sceneStyle.elementColors[ci];
-                }
-            }
-            if (colorsChanged) {
-                viewport.generateThumbnails();
-                for (int ci = 0; ci < (int)opticsketch::ElementType::ImportedMesh; ci++) {
-                    libraryPanel.setThumbnailTexture(ci, viewport.getThumbnailTexture(ci));
-                }
-            }
-        }
+            // Toolbox Panel
+            toolboxPanel.render();
 
-        // Keyboard shortcuts panel
-        shortcutsPanel.render(&shortcutMgr);
+            // Outliner (scene structure)
+            outlinerPanel.render(&scene);
 
-        // Templates panel
-        templatePanel.render(&scene, &undoStack, &projectPath, window);
-        animExportPanel.render(&viewport, &scene, &sceneStyle);
+            // Properties (selected element)
+            propertiesPanel.render(&scene, &undoStack);
+
+            // Style editor
+            styleEditorPanel.render(&sceneStyle);
+
+            // Keyboard shortcuts panel
+            shortcutsPanel.render(&shortcutMgr);
+
+            // Templates panel
+            templatePanel.render(&scene, &undoStack, &projectPath, window);
+            animExportPanel.render(&viewport, &scene, &sceneStyle);
+
+            // Detector spot diagram / irradiance analysis
+            spotDiagramPanel.render(&scene, &rayTracer, traceConfig);
+
+            // Frame timings (also switches the profiler on while shown)
+            profilerPanel.render();
+        }
 
         // Advance animation export if active (one frame per main loop iteration)
         if (animExportPanel.isExporting()) {
             animExportPanel.advanceExport(&viewport, &scene, &sceneStyle);
         }
 
+        // Autosave: only the scene snapshot is taken here, serializing runs on a worker
+        autosave.update(glfwGetTime(), scene, sceneStyle, projectPath);
+
+        // Deferred geometry of the opened project
+        if (meshStreamer.isStreaming() && meshStreamer.update(scene, viewport)) {
+            app.viewportDirtyFrames = kActiveFramesAfterInput;
+        }
+
+        // Background mesh import: progress while parsing, placement once the mesh is ready
+        if (meshImport.isRunning()) {
+            if (meshImport.isFinished()) {
+                bool cancelled = meshImport.isCancelled();
+                std::string importPath = meshImport.getPath();
+                opticsketch::MeshAssetRef asset = meshImport.takeResult();
+                if (asset) {
+                    placeDroppedElement(opticsketch::createMeshElement(asset), pendingMeshDropPos);
+                    app.viewportDirtyFrames = kActiveFramesAfterInput;
+                } else if (!cancelled) {
+                    std::string msg = "Could not load mesh:\n" + importPath;
+                    tinyfd_messageBox("Import failed", msg.c_str(), "ok", "error", 1);
+                }
+            } else {
+                ImGui::SetNextWindowSize(ImVec2(360, 0), ImGuiCond_FirstUseEver);
+                if (ImGui::Begin("Importing Mesh", nullptr, ImGuiWindowFlags_NoCollapse)) {
+                    std::string fileName = std::filesystem::path(meshImport.getPath()).filename().string();
+                    ImGui::Text("Loading %s...", fileName.c_str());
+                    ImGui::ProgressBar(meshImport.getProgress(), ImVec2(-1, 0));
+                    ImGui::Spacing();
+                    if (ImGui::Button(meshImport.isCancelled() ? "Cancelling..." : "Cancel", ImVec2(-1, 0))) {
+                        meshImport.cancel();
+                    }
+                }
+                ImGui::End();
+            }
+        }
+
         // Viewport window
         if (ImGui::Begin("3D Viewport", &viewportWindowVisible)) {
         
@@ -1203,7 +1579,11 @@ int main() {
             }
             
             // Draw viewport image first so we get current-frame rect; then input + drag use same rect for realtime follow
-            ImGui::Image(reinterpret_cast<void*>(static_cast<intptr_t>(viewport.getTextureId())),
+            // With the render thread, the newest frame it finished (the UI viewport's texture
+            // until the first one lands)
+            GLuint viewportTexture = renderThread.isRunning() ? renderThread.acquireFrame() : 0;
+            if (!viewportTexture) viewportTexture = viewport.getTextureId();
+            ImGui::Image(reinterpret_cast<void*>(static_cast<intptr_t>(viewportTexture)),
                         viewportSize,
                         ImVec2(0, 1), ImVec2(1, 0)); // Flip Y
             ImVec2 imageMin = ImGui::GetItemRectMin();
@@ -1220,6 +1600,7 @@ int main() {
             bool inViewport = (viewportX >= 0 && viewportX < viewportSize.x && viewportY >= 0 && viewportY < viewportSize.y);
             static ManipulatorDragState manipDrag;
             static BeamSnapResult lastBeamSnap;
+            static bool gpuPickToggle = false;   // Shift state of the click awaiting a GPU pick
             bool shiftPressed = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ||
                                glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS;
             opticsketch::ToolMode currentTool = toolboxPanel.getCurrentTool();
@@ -1602,43 +1983,21 @@ int main() {
                             selectionBoxStartY = viewportY;
                             selectionBoxActive = true;
                         }
+                    } else if (viewport.isIdBufferEnabled()) {
+                        // GPU picking: resolved from the id buffer once the readback lands
+                        viewport.requestPick(static_cast<int>(viewportX), static_cast<int>(viewportY));
+                        gpuPickToggle = shiftPressed;
+                        app.viewportDirtyFrames = std::max(app.viewportDirtyFrames, 2);
                     } else {
                         // In Move/Rotate/Scale mode: click-select (Shift=toggle, else exclusive)
                         opticsketch::Raycast::Ray ray = opticsketch::Raycast::screenToRay(
                             viewport.getCamera(), viewportX, viewportY, vpWidth, vpHeight);
-                        float closestT = std::numeric_limits<float>::max();
-                        opticsketch::Element* closestElement = nullptr;
-                        for (const auto& elem : scene.getElements()) {
-                            if (!elem->visible) continue;
-                            glm::mat4 transform = elem->transform.getMatrix();
-                            float t;
-                            if (opticsketch::Raycast::intersectElement(ray, elem.get(), transform, t)) {
-                                if (t > 0.0f && t < closestT) {
-                                    closestT = t;
-                                    closestElement = elem.get();
-                                }
-                            }
-                        }
-                        opticsketch::Beam* closestBeam = nullptr;
-                        float beamPickThreshold = 0.3f;
-                        float bestBeamDist = beamPickThreshold * beamPickThreshold;
-                        for (const auto& beam : scene.getBeams()) {
-                            if (!beam->visible) continue;
-                            float tRay, tSeg;
-                            float sqDist = opticsketch::Raycast::rayToSegmentSqDist(ray, beam->start, beam->end, tRay, tSeg);
-                            if (sqDist < bestBeamDist && tRay > 0.0f) {
-                                bestBeamDist = sqDist;
-                                closestBeam = beam.get();
-                            }
-                        }
-                        if (shiftPressed) {
-                            if (closestElement) scene.toggleSelect(closestElement->id);
-                            else if (closestBeam) scene.toggleSelect(closestBeam->id);
-                        } else {
-                            if (closestElement) scene.selectElement(closestElement->id);
-                            else if (closestBeam) scene.selectBeam(closestBeam->id);
-                            else scene.deselectAll();
-                        }
+                        float closestT;
+                        pickIndex.update(scene);
+                        opticsketch::Element* closestElement = pickIndex.pickElement(ray, closestT);
+                        const float beamPickThreshold = 0.3f;
+                        opticsketch::Beam* closestBeam = pickIndex.pickBeam(ray, beamPickThreshold);
+                        applyClickSelection(scene, closestElement, closestBeam, shiftPressed);
                     }
                 }
             }
@@ -1670,10 +2029,16 @@ int main() {
                     float rminY = std::min(selectionBoxStartY, viewportY);
                     float rmaxY = std::max(selectionBoxStartY, viewportY);
                     if (!shiftPressed) scene.deselectAll();
-                    for (const auto& elem : scene.getElements()) {
-                        if (!elem->visible) continue;
+                    // Candidates from the pick index, refined by projected bounds below
+                    std::vector<opticsketch::Element*> boxElements;
+                    std::vector<opticsketch::Beam*> boxBeams;
+                    pickIndex.update(scene);
+                    pickIndex.queryFrustum(opticsketch::PickIndex::rectFrustum(proj * view, rminX, rminY, rmaxX, rmaxY,
+                                                                                vpWidth, vpHeight),
+                                           boxElements, boxBeams);
+                    for (opticsketch::Element* elem : boxElements) {
                         glm::vec3 wMin, wMax;
-                        elem->getWorldBounds(wMin, wMax);
+                        elem->getArrayWorldBounds(wMin, wMax);
                         float vx, vy;
                         float minVx = std::numeric_limits<float>::max(), maxVx = -std::numeric_limits<float>::max();
                         float minVy = std::numeric_limits<float>::max(), maxVy = -std::numeric_limits<float>::max();
@@ -1695,8 +2060,7 @@ int main() {
                         bool overlaps = (rminX <= maxVx && rmaxX >= minVx && rminY <= maxVy && rmaxY >= minVy);
                         if (overlaps) scene.selectElement(elem->id, true);
                     }
-                    for (const auto& beam : scene.getBeams()) {
-                        if (!beam->visible) continue;
+                    for (opticsketch::Beam* beam : boxBeams) {
                         float svx, svy, evx, evy;
                         bool startVis = worldToViewport(beam->start, svx, svy);
                         bool endVis = worldToViewport(beam->end, evx, evy);
@@ -1724,41 +2088,18 @@ int main() {
                     if (clickedAnnSel) {
                         if (shiftPressed) scene.toggleSelect(clickedAnnSel->id);
                         else scene.selectAnnotation(clickedAnnSel->id);
+                    } else if (viewport.isIdBufferEnabled()) {
+                        viewport.requestPick(static_cast<int>(selectionBoxStartX), static_cast<int>(selectionBoxStartY));
+                        gpuPickToggle = shiftPressed;
+                        app.viewportDirtyFrames = std::max(app.viewportDirtyFrames, 2);
                     } else {
                         opticsketch::Raycast::Ray ray = opticsketch::Raycast::screenToRay(cam, selectionBoxStartX, selectionBoxStartY, vpWidth, vpHeight);
-                        float closestT = std::numeric_limits<float>::max();
-                        opticsketch::Element* closestElement = nullptr;
-                        for (const auto& elem : scene.getElements()) {
-                            if (!elem->visible) continue;
-                            glm::mat4 transform = elem->transform.getMatrix();
-                            float t;
-                            if (opticsketch::Raycast::intersectElement(ray, elem.get(), transform, t)) {
-                                if (t > 0.0f && t < closestT) {
-                                    closestT = t;
-                                    closestElement = elem.get();
-                                }
-                            }
-                        }
-                        opticsketch::Beam* closestBeam = nullptr;
-                        float beamPickThreshold = 0.3f;
-                        float bestBeamDist = beamPickThreshold * beamPickThreshold;
-                        for (const auto& beam : scene.getBeams()) {
-                            if (!beam->visible) continue;
-                            float tRay, tSeg;
-                            float sqDist = opticsketch::Raycast::rayToSegmentSqDist(ray, beam->start, beam->end, tRay, tSeg);
-                            if (sqDist < bestBeamDist && tRay > 0.0f) {
-                                bestBeamDist = sqDist;
-                                closestBeam = beam.get();
-                            }
-                        }
-                        if (shiftPressed) {
-                            if (closestElement) scene.toggleSelect(closestElement->id);
-                            else if (closestBeam) scene.toggleSelect(closestBeam->id);
-                        } else {
-                            if (closestElement) scene.selectElement(closestElement->id);
-                            else if (closestBeam) scene.selectBeam(closestBeam->id);
-                            else scene.deselectAll();
-                        }
+                        float closestT;
+                        pickIndex.update(scene);
+                        opticsketch::Element* closestElement = pickIndex.pickElement(ray, closestT);
+                        const float beamPickThreshold = 0.3f;
+                        opticsketch::Beam* closestBeam = pickIndex.pickBeam(ray, beamPickThreshold);
+                        applyClickSelection(scene, closestElement, closestBeam, shiftPressed);
                     }
                 }
                 selectionBoxActive = false;
@@ -1842,7 +2183,7 @@ int main() {
                                 bool found = false;
                                 int ax = manipDrag.handle;
                                 for (const auto& elem : scene.getElements()) {
-                                    if (!elem->visible || scene.isSelected(elem->id)) continue;
+                                    if (!elem->visible || scene.isSelected(elem->handle)) continue;
                                     float ec = (ax == 0) ? elem->transform.position.x : (ax == 1) ? elem->transform.position.y : elem->transform.position.z;
                                     float nc = (ax == 0) ? newCenter.x : (ax == 1) ? newCenter.y : newCenter.z;
                                     float d = std::abs(ec - nc);
@@ -1858,7 +2199,7 @@ int main() {
                             // Snap to beam (highest priority — overrides grid/element snap)
                             if (sceneStyle.snapToBeam && sceneStyle.beamSnapRadius > 0.0f) {
                                 glm::vec3 newCenter = manipDrag.initialGizmoCenter + delta;
-                                lastBeamSnap = findBeamSnap(scene, newCenter, sceneStyle.beamSnapRadius);
+                                lastBeamSnap = findBeamSnap(pickIndex, scene, newCenter, sceneStyle.beamSnapRadius);
                                 if (lastBeamSnap.snapped) {
                                     delta = lastBeamSnap.snapPosition - manipDrag.initialGizmoCenter;
                                 }
@@ -1869,7 +2210,10 @@ int main() {
                             // Apply delta to each selected element from its initial position
                             for (auto& [id, initT] : manipDrag.initialTransforms) {
                                 auto* e = scene.getElement(id);
-                                if (e) e->transform.position = initT.position + delta;
+                                if (e) {
+                                    e->transform.position = initT.position + delta;
+                                    e->markTransformDirty();
+                                }
                             }
 
                             // Auto-orient to beam if snapped
@@ -1882,7 +2226,10 @@ int main() {
                                 glm::quat orient = glm::angleAxis(angle, up);
                                 for (auto& [id, initT] : manipDrag.initialTransforms) {
                                     auto* e = scene.getElement(id);
-                                    if (e) e->transform.rotation = orient;
+                                    if (e) {
+                                        e->transform.rotation = orient;
+                                        e->markTransformDirty();
+                                    }
                                 }
                             }
                         }
@@ -1913,6 +2260,7 @@ int main() {
                                 glm::vec3 localCenter = primaryElem->getLocalBoundsCenter();
                                 glm::vec3 offset = glm::vec3(primaryElem->transform.rotation * glm::vec4(primaryElem->transform.scale * localCenter, 0.0f));
                                 primaryElem->transform.position = manipDrag.initialGizmoCenter - offset;
+                                primaryElem->markTransformDirty();
                             }
                         }
                         manipDrag.lastViewportX = viewportX;
@@ -1950,92 +2298,176 @@ int main() {
                                 glm::vec3 localCenter = primaryElem->getLocalBoundsCenter();
                                 glm::vec3 offset = glm::vec3(primaryElem->transform.rotation * glm::vec4(primaryElem->transform.scale * localCenter, 0.0f));
                                 primaryElem->transform.position = manipDrag.initialGizmoCenter - offset;
+                                primaryElem->markTransformDirty();
                             }
                         }
                     }
                 }
             }
 
-            // Auto-trace rays every frame when enabled (interactive feedback)
-            if (autoTrace) {
-                opticsketch::RayTracer tracer;
-                tracer.traceScene(&scene, traceConfig);
+            // GPU pick from an earlier click: the ids were read back at the end of the frame
+            // it was requested in. Ids from a scene layout that has since changed are dropped.
+            opticsketch::SceneHandle gpuPickHit;
+            if (viewport.takePickResult(gpuPickHit)) {
+                if (!gpuPickHit || scene.isHandleValid(gpuPickHit)) {
+                    applyClickSelection(scene, scene.getElement(gpuPickHit), scene.getBeam(gpuPickHit), gpuPickToggle);
+                }
+                app.viewportDirtyFrames = std::max(app.viewportDirtyFrames, 1);
+            } else if (viewport.isPickPending()) {
+                app.viewportDirtyFrames = std::max(app.viewportDirtyFrames, 1);
             }
 
-            // Render to framebuffer
-            viewport.beginFrame();
-            viewport.renderGrid(25.0f, 100);
-            viewport.renderScene(&scene);
-            viewport.renderBeams(&scene);
-            viewport.renderGaussianBeams(&scene);
-            viewport.renderFocalPoints(&scene);
-
-            // Render preview beam if drawing (using the previewBeam declared earlier)
-            if (currentTool == opticsketch::ToolMode::DrawBeam && beamStartPlaced && previewBeamPtr) {
-                viewport.renderBeam(*previewBeamPtr);
+            // This frame's transform edits (gizmo drags, nudges, panels) go into the scene's
+            // change journal before anything reads it
+            scene.journalTransforms();
+
+            // Auto-trace rays every frame when enabled (interactive feedback).
+            // Only sources whose rays are affected by a change are re-traced; a batched
+            // property edit in progress is traced once, when it closes.
+            if (autoTrace && !scene.isElementEditOpen()) {
+                bool traced;
+                if (progressiveTrace) {
+                    traced = rayTracer.traceSceneProgressive(&scene, traceConfig, traceSliceMs);
+                } else {
+                    opticsketch::TraceConfig autoConfig = traceConfig;
+                    autoConfig.timeBudgetMs = autoTraceBudgetMs;
+                    traced = rayTracer.traceSceneIncremental(&scene, autoConfig);
+                }
+                if (traced) app.viewportDirtyFrames = std::max(app.viewportDirtyFrames, 1);
             }
-            
-            // Render gizmo if element(s) selected and tool is not Select
-            if (hasSelectedElements && toolboxPanel.getCurrentTool() != opticsketch::ToolMode::Select) {
-                if (!app.input.leftMouseDown) manipDrag.active = false;
+
+            // Hover highlights follow the cursor inside the viewport
+            if (isViewportHovered && (io.MouseDelta.x != 0.0f || io.MouseDelta.y != 0.0f)) {
+                app.viewportDirtyFrames = std::max(app.viewportDirtyFrames, 1);
+            }
+            app.continuousFrames = manipDrag.active || app.input.isDraggingCamera || animExportPanel.isExporting();
+
+            // Re-render only when something may have changed; otherwise ImGui keeps showing
+            // the previous texture contents
+            bool redrawViewport = !app.onDemandRendering || app.continuousFrames || app.viewportDirtyFrames > 0 ||
+                                  (renderThread.isRunning() ? renderThread.isFrameStale() : viewport.isFrameStale());
+            if (redrawViewport) {
+                OPTICSKETCH_PROFILE_SCOPE("Viewport");
+                bool showPreviewBeam = currentTool == opticsketch::ToolMode::DrawBeam && beamStartPlaced && previewBeamPtr;
+
+                // Gizmo if element(s) selected and tool is not Select
+                bool showGizmo = hasSelectedElements && toolboxPanel.getCurrentTool() != opticsketch::ToolMode::Select;
                 int exclusiveHandle = -1;
-                if (manipDrag.active && app.input.leftMouseDown) exclusiveHandle = manipDrag.handle;
-                opticsketch::GizmoType gizmoType;
-                switch (toolboxPanel.getCurrentTool()) {
-                    case opticsketch::ToolMode::Move:
-                        gizmoType = opticsketch::GizmoType::Move;
-                        break;
-                    case opticsketch::ToolMode::Rotate:
-                        gizmoType = opticsketch::GizmoType::Rotate;
-                        break;
-                    case opticsketch::ToolMode::Scale:
-                        gizmoType = opticsketch::GizmoType::Scale;
-                        break;
-                    default:
-                        gizmoType = opticsketch::GizmoType::Move;
-                        break;
-                }
-                // Compute drag angle for rotation arc feedback
+                opticsketch::GizmoType gizmoType = opticsketch::GizmoType::Move;
                 float dragAngle = 0.0f;
                 float dragStartAngle = 0.0f;
-                if (manipDrag.active && gizmoType == opticsketch::GizmoType::Rotate && exclusiveHandle >= 0) {
-                    // Recompute current angle to pass to gizmo render
-                    glm::vec3 axisDir;
-                    float radius;
-                    opticsketch::Gizmo::getRotateAxis(exclusiveHandle, axisDir, radius);
-                    axisDir = manipDrag.dragOrientation * axisDir;
-                    glm::vec3 viewDir = glm::normalize(viewport.getCamera().position - manipDrag.initialGizmoCenter);
-                    glm::vec3 refRight = glm::normalize(glm::cross(axisDir, viewDir));
-                    glm::vec3 refUp = glm::cross(axisDir, refRight);
-                    // Use last mouse pos to get current angle
-                    opticsketch::Raycast::Ray curRay = opticsketch::Raycast::screenToRay(
-                        viewport.getCamera(), manipDrag.lastViewportX, manipDrag.lastViewportY, vpWidth, vpHeight);
-                    float t;
-                    if (opticsketch::Raycast::intersectPlane(curRay, manipDrag.initialGizmoCenter, axisDir, t)) {
-                        glm::vec3 hit = curRay.origin + t * curRay.direction;
-                        glm::vec3 toHit = hit - manipDrag.initialGizmoCenter;
-                        float currentAngle = std::atan2(glm::dot(toHit, refUp), glm::dot(toHit, refRight));
-                        dragAngle = currentAngle - manipDrag.initialAngle;
-                        dragStartAngle = manipDrag.initialAngle;
-                    }
-                }
-                // Use dragging orientation (frozen at drag start) if dragging, else current orientation
-                glm::mat3 renderOrientation = manipDrag.active ? manipDrag.dragOrientation : gizmoOrientation;
-                // Use centroid for gizmo placement (works for both single and multi-select)
-                viewport.renderGizmoAt(selectionCentroid, gizmoType, lastGizmoHoveredHandle, exclusiveHandle,
-                                       renderOrientation, dragAngle, dragStartAngle);
-            }
+                glm::mat3 renderOrientation = gizmoOrientation;
+                if (showGizmo) {
+                    if (!app.input.leftMouseDown) manipDrag.active = false;
+                    if (manipDrag.active && app.input.leftMouseDown) exclusiveHandle = manipDrag.handle;
+                    switch (toolboxPanel.getCurrentTool()) {
+                        case opticsketch::ToolMode::Move:
+                            gizmoType = opticsketch::GizmoType::Move;
+                            break;
+                        case opticsketch::ToolMode::Rotate:
+                            gizmoType = opticsketch::GizmoType::Rotate;
+                            break;
+                        case opticsketch::ToolMode::Scale:
+                            gizmoType = opticsketch::GizmoType::Scale;
+                            break;
+                        default:
+                            gizmoType = opticsketch::GizmoType::Move;
+                            break;
+                    }
+                    // Compute drag angle for rotation arc feedback
+                    if (manipDrag.active && gizmoType == opticsketch::GizmoType::Rotate && exclusiveHandle >= 0) {
+                        // Recompute current angle to pass to gizmo render
+                        glm::vec3 axisDir;
+                        float radius;
+                        opticsketch::Gizmo::getRotateAxis(exclusiveHandle, axisDir, radius);
+                        axisDir = manipDrag.dragOrientation * axisDir;
+                        glm::vec3 viewDir = glm::normalize(viewport.getCamera().position - manipDrag.initialGizmoCenter);
+                        glm::vec3 refRight = glm::normalize(glm::cross(axisDir, viewDir));
+                        glm::vec3 refUp = glm::cross(axisDir, refRight);
+                        // Use last mouse pos to get current angle
+                        opticsketch::Raycast::Ray curRay = opticsketch::Raycast::screenToRay(
+                            viewport.getCamera(), manipDrag.lastViewportX, manipDrag.lastViewportY, vpWidth, vpHeight);
+                        float t;
+                        if (opticsketch::Raycast::intersectPlane(curRay, manipDrag.initialGizmoCenter, axisDir, t)) {
+                            glm::vec3 hit = curRay.origin + t * curRay.direction;
+                            glm::vec3 toHit = hit - manipDrag.initialGizmoCenter;
+                            float currentAngle = std::atan2(glm::dot(toHit, refUp), glm::dot(toHit, refRight));
+                            dragAngle = currentAngle - manipDrag.initialAngle;
+                            dragStartAngle = manipDrag.initialAngle;
+                        }
+                    }
+                    // Use dragging orientation (frozen at drag start) if dragging, else current orientation
+                    if (manipDrag.active) renderOrientation = manipDrag.dragOrientation;
+                }
+                // Beam snap highlight when actively dragging and snapped
+                bool showBeamHighlight = manipDrag.active && lastBeamSnap.snapped;
+
+                if (renderThread.isRunning()) {
+                    opticsketch::RenderSnapshot& snap = renderThread.back();
+                    // Copy the scene only when something the render thread draws changed:
+                    // edits (journaled above), adds and removes, selection and traced rays
+                    struct SnapshotKey {
+                        uint64_t changes, structure, selection;
+                        uint32_t traced;
+                        bool operator==(const SnapshotKey& o) const {
+                            return changes == o.changes && structure == o.structure &&
+                                   selection == o.selection && traced == o.traced;
+                        }
+                    };
+                    static std::shared_ptr<opticsketch::Scene> lastSceneCopy;
+                    static SnapshotKey lastSceneKey{};
+                    SnapshotKey sceneKey{scene.getChangeVersion(), scene.getStructureRevision(),
+                                         scene.getSelectionRevision(), scene.getTracedRays().revision};
+                    if (!lastSceneCopy || !(sceneKey == lastSceneKey)) {
+                        lastSceneCopy = scene.snapshot(true);
+                        lastSceneKey = sceneKey;
+                    }
+                    snap.scene = lastSceneCopy;
+                    snap.style = sceneStyle;
+                    snap.camera = viewport.getCamera();
+                    snap.width = vpWidth;
+                    snap.height = vpHeight;
+                    snap.frustumCulling = viewport.getFrustumCulling();
+                    snap.previewBeam = showPreviewBeam ? std::shared_ptr<opticsketch::Beam>(previewBeamPtr->clone())
+                                                       : nullptr;
+                    snap.showGizmo = showGizmo;
+                    snap.gizmoCenter = selectionCentroid;
+                    snap.gizmoType = gizmoType;
+                    snap.gizmoHovered = lastGizmoHoveredHandle;
+                    snap.gizmoExclusive = exclusiveHandle;
+                    snap.gizmoOrientation = renderOrientation;
+                    snap.gizmoDragAngle = dragAngle;
+                    snap.gizmoDragStartAngle = dragStartAngle;
+                    snap.showBeamHighlight = showBeamHighlight;
+                    snap.highlightStart = lastBeamSnap.beamStart;
+                    snap.highlightEnd = lastBeamSnap.beamEnd;
+                    snap.highlightSnap = lastBeamSnap.snapPosition;
+                    renderThread.submit();
+                } else {
+                    // Render to framebuffer
+                    viewport.beginFrame();
+                    viewport.renderGrid(25.0f, 100);
+                    viewport.renderScene(&scene);
+                    viewport.renderBeams(&scene);
+                    viewport.renderGaussianBeams(&scene);
+                    viewport.renderFocalPoints(&scene);
+                    if (showPreviewBeam) viewport.renderBeam(*previewBeamPtr);
+                    if (showGizmo) {
+                        // Use centroid for gizmo placement (works for both single and multi-select)
+                        viewport.renderGizmoAt(selectionCentroid, gizmoType, lastGizmoHoveredHandle, exclusiveHandle,
+                                               renderOrientation, dragAngle, dragStartAngle);
+                    }
+                    if (showBeamHighlight) {
+                        viewport.renderBeamHighlight(lastBeamSnap.beamStart, lastBeamSnap.beamEnd,
+                                                     lastBeamSnap.snapPosition);
+                    }
+                    viewport.endFrame();
 
-            // Render beam snap highlight when actively dragging and snapped
-            if (manipDrag.active && lastBeamSnap.snapped) {
-                viewport.renderBeamHighlight(lastBeamSnap.beamStart, lastBeamSnap.beamEnd, lastBeamSnap.snapPosition);
+                    // Bloom post-process for Presentation mode
+                    viewport.renderBloomPass();
+                }
             }
 
-            viewport.endFrame();
-
-            // Bloom post-process for Presentation mode
-            viewport.renderBloomPass();
-
             // Set up drag-drop target on the image (must be after Image call)
             if (ImGui::BeginDragDropTarget()) {
                 if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("LIBRARY_ITEM")) {
@@ -2044,43 +2476,28 @@ int main() {
                         const auto& libItems = libraryPanel.getItems();
                         if (itemIndex >= 0 && itemIndex < static_cast<int>(libItems.size())) {
                             const auto& libItem = libItems[itemIndex];
-                            std::unique_ptr<opticsketch::Element> elem;
-                            if (libItem.type == opticsketch::ElementType::ImportedMesh && !libItem.meshPath.empty()) {
-                                elem = opticsketch::createMeshElement(libItem.meshPath);
-                            } else {
-                                elem = opticsketch::createElement(libItem.type);
-                            }
-                            if (elem) {
-                                // Ray-cast from viewport center to Y=0 ground plane
-                                glm::vec3 dropPos(0.0f, 0.0f, 0.0f);
-                                float centerX = vpWidth * 0.5f;
-                                float centerY = vpHeight * 0.5f;
-                                opticsketch::Raycast::Ray dropRay = opticsketch::Raycast::screenToRay(
-                                    viewport.getCamera(), centerX, centerY, vpWidth, vpHeight);
-                                if (std::abs(dropRay.direction.y) > 1e-5f) {
-                                    float t = -dropRay.origin.y / dropRay.direction.y;
-                                    if (t > 0.0f) {
-                                        dropPos = dropRay.origin + t * dropRay.direction;
-                                        dropPos.y = 0.0f;
-                                    }
+                            // Ray-cast from viewport center to Y=0 ground plane
+                            glm::vec3 dropPos(0.0f, 0.0f, 0.0f);
+                            float centerX = vpWidth * 0.5f;
+                            float centerY = vpHeight * 0.5f;
+                            opticsketch::Raycast::Ray dropRay = opticsketch::Raycast::screenToRay(
+                                viewport.getCamera(), centerX, centerY, vpWidth, vpHeight);
+                            if (std::abs(dropRay.direction.y) > 1e-5f) {
+                                float t = -dropRay.origin.y / dropRay.direction.y;
+                                if (t > 0.0f) {
+                                    dropPos = dropRay.origin + t * dropRay.direction;
+                                    dropPos.y = 0.0f;
                                 }
-                                elem->transform.position = dropPos;
-                                // Snap dropped element to beam if enabled
-                                if (sceneStyle.snapToBeam && sceneStyle.beamSnapRadius > 0.0f) {
-                                    BeamSnapResult dropSnap = findBeamSnap(scene, dropPos, sceneStyle.beamSnapRadius);
-                                    if (dropSnap.snapped) {
-                                        elem->transform.position = dropSnap.snapPosition;
-                                        if (sceneStyle.autoOrientToBeam) {
-                                            glm::vec3 up(0.0f, 1.0f, 0.0f);
-                                            float angle = std::atan2(dropSnap.beamDirection.x, dropSnap.beamDirection.z);
-                                            elem->transform.rotation = glm::angleAxis(angle, up);
-                                        }
-                                    }
+                            }
+                            if (libItem.type == opticsketch::ElementType::ImportedMesh && !libItem.meshPath.empty()) {
+                                // Parsed in the background; placed here when the import finishes
+                                if (meshImport.start(libItem.meshPath)) {
+                                    pendingMeshDropPos = dropPos;
+                                } else {
+                                    tinyfd_messageBox("Import in progress", "Another mesh is still being imported.", "ok", "info", 1);
                                 }
-                                scene.addElement(std::move(elem));
-                                auto* added = scene.getElements().back().get();
-                                undoStack.push(std::make_unique<opticsketch::AddElementCmd>(*added));
-                                scene.selectElement(added->id);
+                            } else {
+                                placeDroppedElement(opticsketch::createElement(libItem.type), dropPos);
                             }
                         }
                     }
@@ -2150,7 +2567,7 @@ int main() {
                     ImVec2 rmin(lx - px, ly - py);
                     ImVec2 rmax(lx + textSz.x + px, ly + textSz.y + py);
 
-                    bool isSel = scene.isSelected(ann->id);
+                    bool isSel = scene.isSelected(ann->handle);
                     ImU32 bgColor = IM_COL32(
                         (int)(ann->color.r * 255), (int)(ann->color.g * 255),
                         (int)(ann->color.b * 255), 200);
@@ -2220,7 +2637,7 @@ int main() {
                     if (!projectPoint(meas->startPoint, sx1, sy1)) continue;
                     if (!projectPoint(meas->endPoint, sx2, sy2)) continue;
                     drawDimensionLine(sx1, sy1, sx2, sy2, meas->getDistance(),
-                                      scene.isSelected(meas->id), meas->color);
+                                      scene.isSelected(meas->handle), meas->color);
                 }
 
                 // Render measurement preview (while placing)
@@ -2341,7 +2758,11 @@ int main() {
         glClearColor(0.05f, 0.05f, 0.06f, 1.0f);  // Match theme background
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            OPTICSKETCH_PROFILE_GPU_PASS("ImGui");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        renderThread.releaseFrame();
         
         // Multi-viewport support
         if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
@@ -2352,10 +2773,21 @@ int main() {
         }
         
         glfwSwapBuffers(window);
+        opticsketch::Profiler::instance().endFrame();
+
+        if (app.uiActiveFrames > 0) app.uiActiveFrames--;
+        if (app.viewportDirtyFrames > 0) app.viewportDirtyFrames--;
     }
     
+    // Before the job system goes: the render thread's viewport may still queue loads
+    renderThread.stop();
+
+    // Let a save in flight land; background jobs are cancelled and their results dropped
+    opticsketch::JobSystem::instance().shutdown();
+
     // Save keyboard shortcuts on exit
     shortcutMgr.saveToFile("opticsketch_keys.ini");
+    viewport.saveThumbnailCache("opticsketch_thumbs.cache");
 
     // Cleanup - must happen before destroying OpenGL context
     // Make sure OpenGL context is still current
@@ -2364,6 +2796,8 @@ int main() {
     // Explicitly clean up viewport resources while context is still valid
     // This ensures OpenGL resources are freed before context is destroyed
     viewport.cleanup();
+    rayTracer.releaseGpu();
+    opticsketch::Profiler::instance().cleanup();
     
     // Now shutdown ImGui (this may use OpenGL, so do it before destroying context)
     ImGui_ImplOpenGL3_Shutdown();
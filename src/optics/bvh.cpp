@@ -0,0 +1,281 @@
+#include "optics/bvh.h"
+#include "elements/element.h"
+#include "render/raycast.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <algorithm>
+#include <cfloat>
+
+namespace opticsketch {
+
+void ElementBVH::clear() {
+    elements.clear();
+    firstLeaf.clear();
+    shapes.clear();
+    prims.clear();
+    leafData.clear();
+    order.clear();
+    nodes.clear();
+    traversalStackSize = 0;
+}
+
+bool ElementBVH::matches(const std::vector<Element*>& list) const {
+    if (list != elements) return false;
+    for (size_t i = 0; i < list.size(); i++)
+        if (list[i]->getInstanceCount() != firstLeaf[i + 1] - firstLeaf[i]) return false;
+    return true;
+}
+
+void ElementBVH::updateLeafData(int primIndex) {
+    const Element* elem = prims[primIndex];
+    LeafData& d = leafData[primIndex];
+    elem->getInstanceWorldBounds(d.instance, d.boundsMin, d.boundsMax);
+    d.centroid = (d.boundsMin + d.boundsMax) * 0.5f;
+    if (d.instance == 0) {
+        d.invModel = elem->getInverseModelMatrix();
+        d.normalMatrix = elem->getNormalMatrix();
+    } else {
+        d.invModel = glm::inverse(elem->getInstanceModelMatrix(d.instance));
+        d.normalMatrix = glm::mat3(glm::transpose(d.invModel));
+    }
+}
+
+void ElementBVH::build(const std::vector<Element*>& list) {
+    clear();
+    if (list.empty()) return;
+
+    elements = list;
+    firstLeaf.resize(elements.size() + 1);
+    shapes.resize(elements.size());
+    for (size_t e = 0; e < elements.size(); e++) {
+        firstLeaf[e] = static_cast<int>(prims.size());
+        buildSurfaceShape(elements[e], shapes[e]);
+        int instances = elements[e]->getInstanceCount();
+        for (int i = 0; i < instances; i++) {
+            prims.push_back(elements[e]);
+            LeafData d;
+            d.instance = i;
+            d.shape = static_cast<int>(e);
+            leafData.push_back(d);
+        }
+    }
+    firstLeaf.back() = static_cast<int>(prims.size());
+
+    order.resize(prims.size());
+    for (size_t i = 0; i < prims.size(); i++) {
+        updateLeafData(static_cast<int>(i));
+        order[i] = static_cast<int>(i);
+    }
+
+    nodes.reserve(prims.size() * 2);
+    traversalStackSize = 1;
+    buildRecursive(0, static_cast<int>(order.size()), 1);
+}
+
+void ElementBVH::rangeBounds(int begin, int end, glm::vec3& bmin, glm::vec3& bmax) const {
+    bmin = glm::vec3(FLT_MAX);
+    bmax = glm::vec3(-FLT_MAX);
+    for (int i = begin; i < end; i++) {
+        bmin = glm::min(bmin, leafData[order[i]].boundsMin);
+        bmax = glm::max(bmax, leafData[order[i]].boundsMax);
+    }
+}
+
+void ElementBVH::nodeBounds(const Node& node, glm::vec3& bmin, glm::vec3& bmax) const {
+    bmin = glm::vec3(FLT_MAX);
+    bmax = glm::vec3(-FLT_MAX);
+    const Raycast::AABB4& b = node.bounds;
+    for (int lane = 0; lane < node.childCount; lane++) {
+        bmin = glm::min(bmin, glm::vec3(b.minX[lane], b.minY[lane], b.minZ[lane]));
+        bmax = glm::max(bmax, glm::vec3(b.maxX[lane], b.maxY[lane], b.maxZ[lane]));
+    }
+}
+
+// Median split along the longest centroid axis; returns the split position
+int ElementBVH::splitRange(int begin, int end) {
+    glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+    for (int i = begin; i < end; i++) {
+        cmin = glm::min(cmin, leafData[order[i]].centroid);
+        cmax = glm::max(cmax, leafData[order[i]].centroid);
+    }
+    glm::vec3 extent = cmax - cmin;
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+        [&](int a, int b) { return leafData[a].centroid[axis] < leafData[b].centroid[axis]; });
+    return mid;
+}
+
+int ElementBVH::buildRecursive(int begin, int end, int level) {
+    int nodeIndex = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    traversalStackSize = std::max(traversalStackSize, 3 * level + 1);
+
+    // Split into up to four ranges: halve once, then halve each half that is still large
+    int ranges[5];
+    int rangeCount = 0;
+    ranges[rangeCount++] = begin;
+    if (end - begin > kMaxLeafSize) {
+        int mid = splitRange(begin, end);
+        if (mid - begin > kMaxLeafSize) ranges[rangeCount++] = splitRange(begin, mid);
+        ranges[rangeCount++] = mid;
+        if (end - mid > kMaxLeafSize) ranges[rangeCount++] = splitRange(mid, end);
+    }
+    ranges[rangeCount] = end;
+
+    // Children are always allocated after their parent, which refit() relies on
+    for (int lane = 0; lane < rangeCount; lane++) {
+        int rb = ranges[lane], re = ranges[lane + 1];
+        glm::vec3 bmin, bmax;
+        rangeBounds(rb, re, bmin, bmax);
+        if (re - rb <= kMaxLeafSize) {
+            nodes[nodeIndex].first[lane] = rb;
+            nodes[nodeIndex].count[lane] = re - rb;
+        } else {
+            int child = buildRecursive(rb, re, level + 1);
+            nodes[nodeIndex].child[lane] = child;
+        }
+        nodes[nodeIndex].bounds.set(lane, bmin, bmax);
+    }
+    nodes[nodeIndex].childCount = rangeCount;
+    return nodeIndex;
+}
+
+void ElementBVH::refit() {
+    for (size_t e = 0; e < elements.size(); e++) buildSurfaceShape(elements[e], shapes[e]);
+    for (size_t i = 0; i < prims.size(); i++)
+        updateLeafData(static_cast<int>(i));
+
+    for (int n = static_cast<int>(nodes.size()) - 1; n >= 0; n--) {
+        Node& node = nodes[n];
+        for (int lane = 0; lane < node.childCount; lane++) {
+            glm::vec3 bmin, bmax;
+            if (node.count[lane] > 0)
+                rangeBounds(node.first[lane], node.first[lane] + node.count[lane], bmin, bmax);
+            else
+                nodeBounds(nodes[node.child[lane]], bmin, bmax);
+            node.bounds.set(lane, bmin, bmax);
+        }
+    }
+}
+
+bool ElementBVH::closestHit(const glm::vec3& origin, const glm::vec3& direction,
+                            float tMin, float tMax, const Element* ignore, int ignoreInstance,
+                            Hit& outHit) const {
+    outHit.boxTests = 0;
+    outHit.surfaceTests = 0;
+    if (nodes.empty()) return false;
+
+    glm::vec3 invDir = 1.0f / direction;
+    float closestT = tMax;
+    bool found = false;
+
+    struct StackEntry { int node; float tNear; };
+    StackEntry localStack[kLocalStackSize];
+    std::vector<StackEntry> deepStack;
+    StackEntry* stack = localStack;
+    if (traversalStackSize > kLocalStackSize) {
+        deepStack.resize(traversalStackSize);
+        stack = deepStack.data();
+    }
+    int stackSize = 0;
+    stack[stackSize++] = {0, -FLT_MAX};
+
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        if (entry.tNear > closestT) continue;
+        const Node& node = nodes[entry.node];
+
+        float tNear[4];
+        int mask = Raycast::intersectAABB4(origin, invDir, node.bounds, closestT, tNear) &
+                   ((1 << node.childCount) - 1);
+        outHit.boxTests += node.childCount;
+        if (!mask) continue;
+
+        // Leaf lanes first: their hits shrink closestT before children are pushed
+        int childLanes[4];
+        int childLaneCount = 0;
+        for (int lane = 0; lane < node.childCount; lane++) {
+            if (!(mask & (1 << lane))) continue;
+            if (node.count[lane] == 0) {
+                childLanes[childLaneCount++] = lane;
+                continue;
+            }
+            for (int i = node.first[lane]; i < node.first[lane] + node.count[lane]; i++) {
+                int p = order[i];
+                Element* elem = prims[p];
+                const LeafData& d = leafData[p];
+                if (elem == ignore && d.instance == ignoreInstance) continue;
+
+                // Transform ray to element local space. The direction is left unnormalized
+                // so the local hit parameter is the same world-space distance used for culling.
+                glm::vec3 localOrigin = glm::vec3(d.invModel * glm::vec4(origin, 1.0f));
+                glm::vec3 localDir = glm::vec3(d.invModel * glm::vec4(direction, 0.0f));
+
+                float t;
+                glm::vec3 localNormal;
+                bool exiting;
+                if (intersectSurface(shapes[d.shape], localOrigin, localDir, tMin, closestT, t, localNormal, exiting,
+                                     outHit.surfaceTests)) {
+                    closestT = t;
+                    outHit.element = elem;
+                    outHit.index = p;
+                    outHit.instance = d.instance;
+                    outHit.t = t;
+                    outHit.normal = glm::normalize(d.normalMatrix * localNormal);
+                    outHit.exiting = exiting;
+                    found = true;
+                }
+            }
+        }
+
+        // Push far children first so the nearest is visited next
+        std::sort(childLanes, childLanes + childLaneCount,
+            [&tNear](int a, int b) { return tNear[a] > tNear[b]; });
+        for (int c = 0; c < childLaneCount; c++) {
+            int lane = childLanes[c];
+            stack[stackSize++] = {node.child[lane], tNear[lane]};
+        }
+    }
+    return found;
+}
+
+void ElementBVH::queryFrustum(const Frustum& frustum, std::vector<Element*>& out) const {
+    if (nodes.empty()) return;
+    size_t first = out.size();
+    int localStack[kLocalStackSize];
+    std::vector<int> deepStack;
+    int* stack = localStack;
+    if (traversalStackSize > kLocalStackSize) {
+        deepStack.resize(traversalStackSize);
+        stack = deepStack.data();
+    }
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        const Raycast::AABB4& b = node.bounds;
+        for (int lane = 0; lane < node.childCount; lane++) {
+            if (!frustum.intersectsBox(glm::vec3(b.minX[lane], b.minY[lane], b.minZ[lane]),
+                                       glm::vec3(b.maxX[lane], b.maxY[lane], b.maxZ[lane])))
+                continue;
+            if (node.count[lane] == 0) {
+                stack[stackSize++] = node.child[lane];
+                continue;
+            }
+            for (int i = node.first[lane]; i < node.first[lane] + node.count[lane]; i++) {
+                const LeafData& d = leafData[order[i]];
+                if (frustum.intersectsBox(d.boundsMin, d.boundsMax)) out.push_back(prims[order[i]]);
+            }
+        }
+    }
+    // Several instances of one array may be inside
+    if (prims.size() != elements.size()) {
+        std::sort(out.begin() + first, out.end());
+        out.erase(std::unique(out.begin() + first, out.end()), out.end());
+    }
+}
+
+} // namespace opticsketch
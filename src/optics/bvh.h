@@ -0,0 +1,108 @@
+#pragma once
+
+#include "render/raycast.h"
+#include "render/frustum.h"
+#include "optics/surface_shape.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace opticsketch {
+
+class Element;
+
+// Bounding volume hierarchy over element world-space bounds, used by the ray tracer
+// for closest-hit queries. Nodes are 4-wide so each visit tests all child boxes with
+// one Raycast::intersectAABB4 call. Each leaf caches its element's inverse model and
+// normal matrix so traversal never rebuilds or inverts a transform, and its SurfaceShape
+// for the exact hit test run on leaves whose box the ray enters. Leaves are element
+// instances: an array contributes one per copy (own bounds and matrices) that all share
+// the element's shape.
+class ElementBVH {
+public:
+    struct Hit {
+        Element* element = nullptr;
+        int index = -1;             // leaf (instance) index, see getLeafCount()
+        int instance = 0;           // array instance of 'element' that was hit
+        float t = 0.0f;
+        glm::vec3 normal{0.0f};     // world space, not yet oriented against the ray
+        bool exiting = false;       // the ray started inside the element and leaves it here
+        int boxTests = 0;           // node boxes the query tested
+        int surfaceTests = 0;       // exact surface tests (one per mesh triangle)
+    };
+
+    // Build the hierarchy from scratch over the given elements
+    void build(const std::vector<Element*>& elements);
+
+    // Recompute leaf bounds/matrices from current transforms and propagate upward.
+    // Topology is kept, so quality degrades if elements move far; rebuild in that case.
+    void refit();
+
+    // True if the BVH was built over exactly these elements (same order and instance counts)
+    bool matches(const std::vector<Element*>& elements) const;
+
+    // Closest hit with tMin < t < tMax. Instance 'ignoreInstance' of 'ignore' is skipped
+    // (e.g. the emitting source copy); the element's other array copies are still hit.
+    bool closestHit(const glm::vec3& origin, const glm::vec3& direction,
+                    float tMin, float tMax, const Element* ignore, int ignoreInstance, Hit& outHit) const;
+
+    // Elements whose world bounds intersect the frustum (conservative, e.g. for marquee
+    // selection; callers refine with an exact test)
+    void queryFrustum(const Frustum& frustum, std::vector<Element*>& out) const;
+
+    // Elements the BVH was built over, in build order
+    const std::vector<Element*>& getElements() const { return elements; }
+
+    // Leaves in element order, each element's instances in a row
+    int getLeafCount() const { return static_cast<int>(prims.size()); }
+    Element* getLeafElement(int leaf) const { return prims[leaf]; }
+    int getLeafInstance(int leaf) const { return leafData[leaf].instance; }
+    // First leaf of getElements()[elementIndex]
+    int getFirstLeaf(int elementIndex) const { return firstLeaf[elementIndex]; }
+
+    void clear();
+    bool empty() const { return nodes.empty(); }
+
+private:
+    // Up to four children per node. A lane with count > 0 is a leaf range into
+    // 'order'; otherwise child[lane] is an inner node index.
+    struct Node {
+        Raycast::AABB4 bounds;
+        int child[4] = {-1, -1, -1, -1};
+        int first[4] = {0, 0, 0, 0};
+        int count[4] = {0, 0, 0, 0};
+        int childCount = 0;
+    };
+
+    struct LeafData {
+        glm::vec3 boundsMin{0.0f};
+        glm::vec3 boundsMax{0.0f};
+        glm::vec3 centroid{0.0f};
+        glm::mat4 invModel{1.0f};
+        glm::mat3 normalMatrix{1.0f};
+        int instance = 0;
+        int shape = 0;              // index into shapes
+    };
+
+    static constexpr int kMaxLeafSize = 2;
+    // Traversal stack entries kept on the call's stack; deeper trees use a vector
+    static constexpr int kLocalStackSize = 64;
+
+    int buildRecursive(int begin, int end, int level);
+    int splitRange(int begin, int end);
+    void rangeBounds(int begin, int end, glm::vec3& bmin, glm::vec3& bmax) const;
+    void nodeBounds(const Node& node, glm::vec3& bmin, glm::vec3& bmax) const;
+    void updateLeafData(int primIndex);
+
+    std::vector<Element*> elements;
+    std::vector<int> firstLeaf;         // per element, plus the total at the end
+    std::vector<SurfaceShape> shapes;   // per element
+    std::vector<Element*> prims;        // per leaf
+    std::vector<LeafData> leafData;     // indexed like prims
+    std::vector<int> order;             // leaf ranges index into this, values index prims
+    std::vector<Node> nodes;
+    // Most entries a depth-first traversal holds at once: up to three pending siblings per
+    // level above the deepest node plus the four children it pushes
+    int traversalStackSize = 0;
+};
+
+} // namespace opticsketch
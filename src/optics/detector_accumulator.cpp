@@ -0,0 +1,65 @@
+#include "optics/detector_accumulator.h"
+#include "elements/element.h"
+#include <algorithm>
+#include <cmath>
+
+namespace opticsketch {
+
+void DetectorAccumulator::reset(const Element* detector, int binCount) {
+    elementId = detector->id;
+    bins = std::max(1, binCount);
+    faceMin = glm::vec2(detector->boundsMin);
+    faceMax = glm::vec2(detector->boundsMax);
+    irradiance.assign(static_cast<size_t>(bins) * bins, 0.0f);
+    hitCount = 0;
+    totalIntensity = 0.0;
+    sumX = sumY = sumXX = sumYY = 0.0;
+}
+
+void DetectorAccumulator::add(const glm::vec3& localPos, float intensity) {
+    glm::vec2 extent = faceMax - faceMin;
+    if (extent.x > 0.0f && extent.y > 0.0f) {
+        glm::vec2 uv = (glm::vec2(localPos) - faceMin) / extent;
+        int bx = std::clamp(static_cast<int>(uv.x * bins), 0, bins - 1);
+        int by = std::clamp(static_cast<int>(uv.y * bins), 0, bins - 1);
+        irradiance[static_cast<size_t>(by) * bins + bx] += intensity;
+    }
+    hitCount++;
+    totalIntensity += intensity;
+    sumX += static_cast<double>(localPos.x) * intensity;
+    sumY += static_cast<double>(localPos.y) * intensity;
+    sumXX += static_cast<double>(localPos.x) * localPos.x * intensity;
+    sumYY += static_cast<double>(localPos.y) * localPos.y * intensity;
+}
+
+void DetectorAccumulator::merge(const DetectorAccumulator& other) {
+    if (other.irradiance.size() == irradiance.size()) {
+        for (size_t i = 0; i < irradiance.size(); i++) irradiance[i] += other.irradiance[i];
+    }
+    hitCount += other.hitCount;
+    totalIntensity += other.totalIntensity;
+    sumX += other.sumX;
+    sumY += other.sumY;
+    sumXX += other.sumXX;
+    sumYY += other.sumYY;
+}
+
+glm::vec2 DetectorAccumulator::centroid() const {
+    if (totalIntensity <= 0.0) return glm::vec2(0.0f);
+    return glm::vec2(static_cast<float>(sumX / totalIntensity), static_cast<float>(sumY / totalIntensity));
+}
+
+float DetectorAccumulator::rmsRadius() const {
+    if (totalIntensity <= 0.0) return 0.0f;
+    double mx = sumX / totalIntensity, my = sumY / totalIntensity;
+    double variance = sumXX / totalIntensity - mx * mx + sumYY / totalIntensity - my * my;
+    return static_cast<float>(std::sqrt(std::max(0.0, variance)));
+}
+
+float DetectorAccumulator::peak() const {
+    float best = 0.0f;
+    for (float v : irradiance) best = std::max(best, v);
+    return best;
+}
+
+} // namespace opticsketch
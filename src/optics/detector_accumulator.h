@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+class Element;
+
+// Irradiance histogram over a detector's local XY face plus running spot moments. Storage
+// is allocated once by reset(), so rays can be streamed in without creating segments.
+struct DetectorAccumulator {
+    std::string elementId;
+    int bins = 0;                   // bins x bins cells
+    glm::vec2 faceMin{0.0f};        // local XY extent covered by the histogram
+    glm::vec2 faceMax{0.0f};
+    std::vector<float> irradiance;  // row-major, row 0 at faceMin.y
+    uint64_t hitCount = 0;
+    double totalIntensity = 0.0;
+    double sumX = 0.0, sumY = 0.0;      // intensity-weighted moments
+    double sumXX = 0.0, sumYY = 0.0;
+
+    // Size the histogram to the element's local bounds and zero it
+    void reset(const Element* detector, int binCount);
+
+    void add(const glm::vec3& localPos, float intensity);
+    // Add another accumulator of the same detector and size (per-thread partials)
+    void merge(const DetectorAccumulator& other);
+
+    glm::vec2 centroid() const;
+    float rmsRadius() const;
+    float peak() const;
+};
+
+} // namespace opticsketch
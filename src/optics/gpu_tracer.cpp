@@ -0,0 +1,409 @@
+#include "optics/gpu_tracer.h"
+#include "optics/ray_tracer.h"
+#include "elements/element.h"
+#include "scene/traced_rays.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace opticsketch {
+
+// std430 mirrors of the shader's buffers (vec4/mat4 only, so no padding surprises)
+struct GpuElement {
+    glm::mat4 invModel;
+    glm::mat4 normalMatrix;   // mat3 in the upper-left
+    glm::vec4 boundsMin;      // local bounds, w = optical type
+    glm::vec4 boundsMax;      // w = ior
+    glm::vec4 center;         // world bounds center, w = Cauchy B
+    glm::vec4 axis;           // world +Z, w = focal length
+    glm::vec4 params;         // reflectivity, transmissivity, aperture diameter, grating lines/mm
+    glm::vec4 filterColor;    // w = half the local bounds diagonal (thin-lens blend)
+};
+
+struct GpuRay {
+    glm::vec4 origin;         // w = intensity
+    glm::vec4 direction;      // w = wavelength
+    glm::vec4 color;          // w unused
+    glm::ivec4 info;          // source index, ignored element, -, -
+};
+
+// Port of RayTracer::traceRay. Keep the two in step when the interaction model changes.
+static const char* kTraceCompute = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+
+struct Element {
+    mat4 invModel;
+    mat4 normalMatrix;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    vec4 center;
+    vec4 axis;
+    vec4 params;
+    vec4 filterColor;
+};
+struct PrimaryRay {
+    vec4 origin;
+    vec4 direction;
+    vec4 color;
+    ivec4 info;
+};
+struct TraceRay {
+    vec3 origin;
+    vec3 direction;
+    vec3 color;
+    float intensity;
+    int depth;
+};
+
+layout(std430, binding = 0) readonly buffer Elements { Element elements[]; };
+layout(std430, binding = 1) readonly buffer Rays { PrimaryRay rays[]; };
+layout(std430, binding = 2) writeonly buffer Lines { float lines[]; };
+
+uniform int uRayCount;
+uniform int uElementCount;
+uniform int uMaxBounces;
+uniform float uMaxDistance;
+uniform float uMinIntensity;
+uniform float uEpsilon;
+
+const int kStackSize = 32;
+TraceRay stack[kStackSize];
+int stackSize = 0;
+TraceRay children[3];
+int childCount = 0;
+
+// Mirrors Raycast::intersectAABBWithNormal
+bool intersectBox(vec3 ro, vec3 rd, vec3 bmin, vec3 bmax, out float t, out vec3 n) {
+    vec3 invDir = 1.0 / rd;
+    vec3 t1 = (bmin - ro) * invDir;
+    vec3 t2 = (bmax - ro) * invDir;
+    vec3 tMin = min(t1, t2);
+    vec3 tMax = max(t1, t2);
+    float tNear = max(max(tMin.x, tMin.y), tMin.z);
+    float tFar = min(min(tMax.x, tMax.y), tMax.z);
+    if (tNear > tFar || tFar < 0.0) return false;
+    t = tNear > 0.0 ? tNear : tFar;
+    if (t == tNear) {
+        if (tNear == tMin.x) n = vec3(rd.x > 0.0 ? -1.0 : 1.0, 0.0, 0.0);
+        else if (tNear == tMin.y) n = vec3(0.0, rd.y > 0.0 ? -1.0 : 1.0, 0.0);
+        else n = vec3(0.0, 0.0, rd.z > 0.0 ? -1.0 : 1.0);
+    } else {
+        if (t == tMax.x) n = vec3(rd.x > 0.0 ? 1.0 : -1.0, 0.0, 0.0);
+        else if (t == tMax.y) n = vec3(0.0, rd.y > 0.0 ? 1.0 : -1.0, 0.0);
+        else n = vec3(0.0, 0.0, rd.z > 0.0 ? 1.0 : -1.0);
+    }
+    return true;
+}
+
+float dispersionIOR(float baseIOR, float cauchyB, float wavelength) {
+    if (cauchyB == 0.0 || wavelength < 1e-12) return baseIOR;
+    float lambdaRef = 633e-9;
+    return baseIOR + cauchyB * (1.0 / (wavelength * wavelength) - 1.0 / (lambdaRef * lambdaRef));
+}
+
+float fresnelSchlick(float cosTheta, float n1, float n2) {
+    float r0 = (n1 - n2) / (n1 + n2);
+    r0 = r0 * r0;
+    float x = 1.0 - cosTheta;
+    return r0 + (1.0 - r0) * x * x * x * x * x;
+}
+
+void spawn(TraceRay parent, vec3 from, vec3 dir, float intensity, vec3 color) {
+    TraceRay c;
+    c.origin = from + dir * uEpsilon;
+    c.direction = dir;
+    c.intensity = intensity;
+    c.color = color;
+    c.depth = parent.depth + 1;
+    children[childCount++] = c;
+}
+
+// Two vertices per segment; the last float carries the raw intensity on the first vertex
+// and the source index on the second (-1 marks an unused slot)
+void writeSegment(int slot, vec3 a, vec3 b, vec3 color, float intensity, float source) {
+    int base = slot * 2 * VERTEX_FLOATS;
+    float alpha = source < 0.0 ? 0.0 : clamp(intensity, 0.15, 1.0);
+    lines[base + 0] = a.x; lines[base + 1] = a.y; lines[base + 2] = a.z;
+    lines[base + 3] = color.r; lines[base + 4] = color.g; lines[base + 5] = color.b; lines[base + 6] = alpha;
+    lines[base + 7] = intensity;
+    lines[base + 8] = b.x; lines[base + 9] = b.y; lines[base + 10] = b.z;
+    lines[base + 11] = color.r; lines[base + 12] = color.g; lines[base + 13] = color.b; lines[base + 14] = alpha;
+    lines[base + 15] = source;
+}
+
+void main() {
+    int rayIndex = int(gl_GlobalInvocationID.x);
+    if (rayIndex >= uRayCount) return;
+    PrimaryRay primary = rays[rayIndex];
+    float wavelength = primary.direction.w;
+    float source = float(primary.info.x);
+    int ignoreElement = primary.info.y;
+
+    int firstSlot = rayIndex * MAX_SEGMENTS;
+    int segments = 0;
+
+    TraceRay first;
+    first.origin = primary.origin.xyz;
+    first.direction = primary.direction.xyz;
+    first.color = primary.color.rgb;
+    first.intensity = primary.origin.w;
+    first.depth = 0;
+    stack[stackSize++] = first;
+
+    while (stackSize > 0 && segments < MAX_SEGMENTS) {
+        TraceRay ray = stack[--stackSize];
+        if (ray.depth >= uMaxBounces) continue;
+        if (ray.intensity < uMinIntensity) continue;
+
+        float closestT = uMaxDistance;
+        int hitIndex = -1;
+        vec3 hitNormal = vec3(0.0);
+        for (int e = 0; e < uElementCount; e++) {
+            if (ray.depth == 0 && e == ignoreElement) continue;
+            vec3 lo = (elements[e].invModel * vec4(ray.origin, 1.0)).xyz;
+            vec3 ld = (elements[e].invModel * vec4(ray.direction, 0.0)).xyz;
+            float t;
+            vec3 n;
+            if (intersectBox(lo, ld, elements[e].boundsMin.xyz, elements[e].boundsMax.xyz, t, n) &&
+                t > uEpsilon && t < closestT) {
+                closestT = t;
+                hitIndex = e;
+                hitNormal = normalize(mat3(elements[e].normalMatrix) * n);
+            }
+        }
+
+        vec3 endPoint = ray.origin + ray.direction * closestT;
+        writeSegment(firstSlot + segments, ray.origin, endPoint, ray.color, ray.intensity, source);
+        segments++;
+        if (hitIndex < 0) continue;
+
+        if (dot(hitNormal, ray.direction) > 0.0) hitNormal = -hitNormal;
+        vec3 hitPoint = endPoint;
+        Element elem = elements[hitIndex];
+        int type = int(elem.boundsMin.w);
+        float ior = elem.boundsMax.w;
+        float reflectivity = elem.params.x;
+        float transmissivity = elem.params.y;
+        childCount = 0;
+
+        if (type == OT_MIRROR) {
+            spawn(ray, hitPoint, reflect(ray.direction, hitNormal), ray.intensity * reflectivity, ray.color);
+        } else if (type == OT_LENS) {
+            vec3 opticalAxis = elem.axis.xyz;
+            vec3 elemCenter = elem.center.xyz;
+            vec3 toHit = hitPoint - elemCenter;
+            vec3 offset = toHit - dot(toHit, opticalAxis) * opticalAxis;
+            float h = length(offset);
+            float n = dispersionIOR(ior, elem.center.w, wavelength);
+            float f = elem.axis.w;
+            if (abs(n - 1.0) > 1e-6 && abs(ior - 1.0) > 1e-6) f = elem.axis.w * (ior - 1.0) / (n - 1.0);
+            float cosI = abs(dot(ray.direction, hitNormal));
+            float R = fresnelSchlick(cosI, 1.0, n);
+            if (R * ray.intensity > uMinIntensity)
+                spawn(ray, hitPoint, reflect(ray.direction, hitNormal), ray.intensity * R, ray.color);
+            float T = (1.0 - R) * transmissivity;
+            if (T * ray.intensity > uMinIntensity) {
+                vec3 exitDir = ray.direction;
+                if (abs(f) > 0.01 && h > 1e-6) {
+                    float sgn = dot(ray.direction, opticalAxis) >= 0.0 ? 1.0 : -1.0;
+                    vec3 focalPoint = elemCenter + sgn * opticalAxis * f;
+                    float blend = clamp(h / elem.filterColor.w, 0.0, 1.0);
+                    exitDir = normalize(mix(ray.direction, normalize(focalPoint - hitPoint), blend));
+                }
+                spawn(ray, hitPoint, exitDir, ray.intensity * T, ray.color);
+            }
+        } else if (type == OT_SPLITTER) {
+            if (reflectivity * ray.intensity > uMinIntensity)
+                spawn(ray, hitPoint, reflect(ray.direction, hitNormal), ray.intensity * reflectivity, ray.color);
+            if (transmissivity * ray.intensity > uMinIntensity)
+                spawn(ray, hitPoint, ray.direction, ray.intensity * transmissivity, ray.color);
+        } else if (type == OT_PRISM) {
+            float n2 = dispersionIOR(ior, elem.center.w, wavelength);
+            vec3 refracted = refract(ray.direction, hitNormal, 1.0 / n2);
+            if (refracted != vec3(0.0))
+                spawn(ray, hitPoint, normalize(refracted), ray.intensity * transmissivity, ray.color);
+            else
+                spawn(ray, hitPoint, reflect(ray.direction, hitNormal), ray.intensity, ray.color);
+        } else if (type == OT_ABSORBER) {
+            // Ray terminates here
+        } else if (type == OT_GRATING) {
+            float d = 1.0 / (elem.params.w * 1e3);
+            float cosI = abs(dot(ray.direction, hitNormal));
+            float sinI = sqrt(max(0.0, 1.0 - cosI * cosI));
+            if (dot(ray.direction, hitNormal) > 0.0) sinI = -sinI;
+            vec3 tangent = normalize(ray.direction - dot(ray.direction, hitNormal) * hitNormal);
+            float intensityPerOrder = ray.intensity / 3.0;
+            for (int m = -1; m <= 1; m++) {
+                float sinM = sinI + float(m) * wavelength / d;
+                if (abs(sinM) > 1.0 || intensityPerOrder < uMinIntensity) continue;
+                vec3 orderDir = ray.direction;
+                if (m != 0) {
+                    float cosM = sqrt(max(0.0, 1.0 - sinM * sinM));
+                    orderDir = normalize(sinM * tangent - cosM * hitNormal);
+                }
+                spawn(ray, hitPoint, orderDir, intensityPerOrder, ray.color);
+            }
+        } else if (type == OT_FILTER) {
+            if (transmissivity * ray.intensity > uMinIntensity)
+                spawn(ray, hitPoint, ray.direction, ray.intensity * transmissivity, ray.color * elem.filterColor.rgb);
+        } else if (type == OT_APERTURE) {
+            vec3 localHit = (elem.invModel * vec4(hitPoint, 1.0)).xyz;
+            vec3 size = elem.boundsMax.xyz - elem.boundsMin.xyz;
+            vec3 localCenter = (elem.boundsMin.xyz + elem.boundsMax.xyz) * 0.5;
+            vec2 openingHalf = elem.params.z * size.xy * 0.5;
+            vec2 q = (localHit.xy - localCenter.xy) / max(openingHalf, vec2(1e-6));
+            if (dot(q, q) < 1.0)
+                spawn(ray, hitPoint, ray.direction, ray.intensity, ray.color);
+        } else if (type == OT_FIBER) {
+            if (transmissivity * ray.intensity > uMinIntensity)
+                spawn(ray, elem.center.xyz, elem.axis.xyz, ray.intensity * transmissivity, ray.color);
+        } else {
+            // Source, Passive: pass through
+            spawn(ray, hitPoint, ray.direction, ray.intensity, ray.color);
+        }
+
+        // Reverse push so the first child is traced first, as on the CPU
+        for (int c = childCount - 1; c >= 0; c--) {
+            if (stackSize < kStackSize) stack[stackSize++] = children[c];
+        }
+    }
+
+    for (; segments < MAX_SEGMENTS; segments++)
+        writeSegment(firstSlot + segments, vec3(0.0), vec3(0.0), vec3(0.0), 0.0, -1.0);
+}
+)";
+
+bool GpuTracer::isSupported() {
+    return GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object;
+}
+
+bool GpuTracer::ensureProgram() {
+    if (program.getId() != 0) return true;
+    if (programFailed || !isSupported()) return false;
+
+    // Interaction types and buffer layout come from the C++ side
+    std::string defines;
+    auto define = [&defines](const char* name, int value) {
+        defines += "#define " + std::string(name) + " " + std::to_string(value) + "\n";
+    };
+    define("OT_MIRROR", static_cast<int>(OpticalType::Mirror));
+    define("OT_LENS", static_cast<int>(OpticalType::Lens));
+    define("OT_SPLITTER", static_cast<int>(OpticalType::Splitter));
+    define("OT_ABSORBER", static_cast<int>(OpticalType::Absorber));
+    define("OT_PRISM", static_cast<int>(OpticalType::Prism));
+    define("OT_GRATING", static_cast<int>(OpticalType::Grating));
+    define("OT_FILTER", static_cast<int>(OpticalType::Filter));
+    define("OT_APERTURE", static_cast<int>(OpticalType::Aperture));
+    define("OT_FIBER", static_cast<int>(OpticalType::FiberCoupler));
+    define("MAX_SEGMENTS", kMaxSegmentsPerRay);
+    define("VERTEX_FLOATS", kFloatsPerVertex);
+
+    if (!program.loadComputeFromSource(kTraceCompute, defines)) {
+        std::cerr << "GPU ray tracing unavailable, falling back to the CPU tracer\n";
+        programFailed = true;
+        return false;
+    }
+    return true;
+}
+
+void GpuTracer::uploadStorage(GLuint& buffer, const void* data, size_t bytes, size_t& capacity) {
+    if (buffer == 0) glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    // An empty array still needs a valid binding
+    size_t size = std::max<size_t>(bytes, 16);
+    if (size > capacity) {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_DRAW);
+        capacity = size;
+    }
+    if (bytes > 0) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(bytes), data);
+}
+
+bool GpuTracer::trace(const std::vector<InteractionRecord>& elements, const std::vector<PrimaryRay>& rays,
+                      const TraceConfig& config) {
+    if (!ensureProgram()) return false;
+
+    std::vector<GpuElement> packed(elements.size());
+    for (size_t i = 0; i < elements.size(); i++) {
+        const InteractionRecord& r = elements[i];
+        const OpticalProperties& o = r.element->optics;
+        GpuElement& g = packed[i];
+        g.invModel = r.worldToLocal;
+        g.normalMatrix = glm::mat4(r.normalMatrix);
+        g.boundsMin = glm::vec4(r.localMin, static_cast<float>(static_cast<int>(r.opticalType)));
+        g.boundsMax = glm::vec4(r.localMax, r.ior);
+        g.center = glm::vec4(r.center, r.cauchyB);
+        g.axis = glm::vec4(r.axis, r.focalLength);
+        g.params = glm::vec4(r.reflectivity, r.transmissivity, o.apertureDiameter, o.gratingLineDensity);
+        g.filterColor = glm::vec4(r.filterColor, r.lensBlendRadius);
+    }
+    std::vector<GpuRay> packedRays(rays.size());
+    for (size_t i = 0; i < rays.size(); i++) {
+        const PrimaryRay& r = rays[i];
+        packedRays[i].origin = glm::vec4(r.origin, r.intensity);
+        packedRays[i].direction = glm::vec4(r.direction, r.wavelength);
+        packedRays[i].color = glm::vec4(r.color, 0.0f);
+        packedRays[i].info = glm::ivec4(r.sourceIndex, r.ignoreElement, 0, 0);
+    }
+
+    uploadStorage(elementBuffer, packed.data(), packed.size() * sizeof(GpuElement), elementCapacity);
+    uploadStorage(rayBuffer, packedRays.data(), packedRays.size() * sizeof(GpuRay), rayCapacity);
+
+    // Output: every ray's fixed run of segments, two vertices each
+    lineVertexCount = static_cast<GLsizei>(rays.size() * kMaxSegmentsPerRay * 2);
+    size_t lineBytes = static_cast<size_t>(lineVertexCount) * kFloatsPerVertex * sizeof(float);
+    if (lineBuffer == 0) glGenBuffers(1, &lineBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lineBuffer);
+    if (lineBytes > lineCapacity || lineCapacity == 0) {
+        lineCapacity = std::max<size_t>(lineBytes, 16);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(lineCapacity), nullptr, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, elementBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rayBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, lineBuffer);
+
+    program.use();
+    program.setInt("uRayCount", static_cast<int>(rays.size()));
+    program.setInt("uElementCount", static_cast<int>(elements.size()));
+    program.setInt("uMaxBounces", config.maxBounces);
+    program.setFloat("uMaxDistance", config.maxDistance);
+    program.setFloat("uMinIntensity", config.minIntensity);
+    program.setFloat("uEpsilon", config.epsilon);
+    if (!rays.empty())
+        glDispatchCompute(static_cast<GLuint>((rays.size() + 63) / 64), 1, 1);
+    // The viewport sources the result as vertices; readBack() maps it
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    glUseProgram(0);
+    return true;
+}
+
+void GpuTracer::readBack(TracedRayBuffer& out, const std::vector<int>& sourceSlots) const {
+    if (lineBuffer == 0 || lineVertexCount == 0) return;
+    size_t floats = static_cast<size_t>(lineVertexCount) * kFloatsPerVertex;
+    std::vector<float> data(floats);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lineBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(floats * sizeof(float)), data.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    const size_t segmentFloats = 2 * kFloatsPerVertex;
+    for (size_t i = 0; i + segmentFloats <= floats; i += segmentFloats) {
+        const float* v = &data[i];
+        int source = static_cast<int>(v[kFloatsPerVertex + 7]);
+        if (source < 0 || source >= static_cast<int>(sourceSlots.size())) continue;   // unused slot
+        out.add(glm::vec3(v[0], v[1], v[2]), glm::vec3(v[8], v[9], v[10]),
+                glm::vec3(v[3], v[4], v[5]), v[7], sourceSlots[source]);
+    }
+}
+
+void GpuTracer::cleanup() {
+    program.cleanup();
+    if (elementBuffer) { glDeleteBuffers(1, &elementBuffer); elementBuffer = 0; }
+    if (rayBuffer) { glDeleteBuffers(1, &rayBuffer); rayBuffer = 0; }
+    if (lineBuffer) { glDeleteBuffers(1, &lineBuffer); lineBuffer = 0; }
+    elementCapacity = rayCapacity = lineCapacity = 0;
+    lineVertexCount = 0;
+}
+
+} // namespace opticsketch
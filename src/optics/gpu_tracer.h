@@ -0,0 +1,73 @@
+#pragma once
+
+#include "render/shader.h"
+#include "optics/interaction_record.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace opticsketch {
+
+class Element;
+struct TraceConfig;
+struct TracedRayBuffer;
+
+// Compute-shader backend for the ray tracer. Element transforms, local bounds and optical
+// properties are packed into a storage buffer, one invocation traces a primary ray and
+// everything it spawns (same interaction model as RayTracer::traceRay), and segments are
+// written as line vertices straight into a vertex buffer the viewport can draw. Each
+// primary ray owns a fixed run of kMaxSegmentsPerRay segments, so output order is
+// deterministic; unused slots are transparent zero-length lines. Needs a current context
+// with ARB_compute_shader and ARB_shader_storage_buffer_object (GL 4.3).
+class GpuTracer {
+public:
+    struct PrimaryRay {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        glm::vec3 color;
+        float intensity = 1.0f;
+        float wavelength = 633e-9f;   // meters
+        int sourceIndex = 0;          // written back with every segment
+        int ignoreElement = -1;       // element index skipped by the first hit (the source)
+    };
+
+    static constexpr int kMaxSegmentsPerRay = 128;
+    static constexpr int kFloatsPerVertex = 8;   // position, rgba, payload (see trace())
+
+    GpuTracer() = default;
+    ~GpuTracer() = default;   // GL objects are freed by cleanup(), like Shader
+    GpuTracer(const GpuTracer&) = delete;
+    GpuTracer& operator=(const GpuTracer&) = delete;
+
+    static bool isSupported();
+
+    // Trace the rays against the compiled element records. Returns false if the backend is
+    // unavailable (unsupported context or shader error); the caller then traces on the CPU.
+    bool trace(const std::vector<InteractionRecord>& elements, const std::vector<PrimaryRay>& rays,
+               const TraceConfig& config);
+
+    GLuint getLineBuffer() const { return lineBuffer; }
+    GLsizei getLineVertexCount() const { return lineVertexCount; }
+
+    // Append the traced segments to 'out' in ray order, skipping unused slots. sourceSlots
+    // maps PrimaryRay::sourceIndex to the buffer's source index.
+    void readBack(TracedRayBuffer& out, const std::vector<int>& sourceSlots) const;
+
+    void cleanup();
+
+private:
+    bool ensureProgram();
+    static void uploadStorage(GLuint& buffer, const void* data, size_t bytes, size_t& capacity);
+
+    Shader program;
+    bool programFailed = false;
+    GLuint elementBuffer = 0;
+    GLuint rayBuffer = 0;
+    GLuint lineBuffer = 0;
+    size_t elementCapacity = 0;
+    size_t rayCapacity = 0;
+    size_t lineCapacity = 0;
+    GLsizei lineVertexCount = 0;
+};
+
+} // namespace opticsketch
@@ -0,0 +1,68 @@
+#include "optics/interaction_record.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cmath>
+
+namespace opticsketch {
+
+// Cauchy dispersion: n(lambda) = baseIOR + B / lambda^2
+// baseIOR is the IOR at a reference wavelength (e.g. 633nm)
+// cauchyB is in m^2 units. Set to 0 for no dispersion.
+float dispersionIOR(float baseIOR, float cauchyB, float wavelength) {
+    if (cauchyB == 0.0f || wavelength < 1e-12f) return baseIOR;
+    // Compute offset from reference wavelength (633nm)
+    float lambdaRef = kLaserWavelength;
+    float nRef = baseIOR; // baseIOR is defined at the reference wavelength
+    // n(lambda) = A + B/lambda^2, where A = nRef - B/lambdaRef^2
+    return nRef + cauchyB * (1.0f / (wavelength * wavelength) - 1.0f / (lambdaRef * lambdaRef));
+}
+
+float InteractionRecord::iorFor(float wavelength, int spectralIndex) const {
+    if (cauchyB == 0.0f) return ior;
+    if (spectralIndex >= 0) return iorAt[spectralIndex];
+    return dispersionIOR(ior, cauchyB, wavelength);
+}
+
+void compileInteractionRecord(const Element* element, const SpectralTable& spectral, InteractionRecord& out,
+                              int instance) {
+    const OpticalProperties& optics = element->optics;
+    out.element = element;
+    out.opticalType = optics.opticalType;
+    out.recordsHits = element->type == ElementType::Detector || element->type == ElementType::Screen;
+
+    glm::mat4 model;
+    if (instance == 0) {
+        model = element->getModelMatrix();
+        out.worldToLocal = element->getInverseModelMatrix();
+        out.normalMatrix = element->getNormalMatrix();
+    } else {
+        model = element->getInstanceModelMatrix(instance);
+        out.worldToLocal = glm::inverse(model);
+        out.normalMatrix = glm::mat3(glm::transpose(out.worldToLocal));
+    }
+    out.localMin = element->boundsMin;
+    out.localMax = element->boundsMax;
+    glm::vec3 worldMin, worldMax;
+    element->getInstanceWorldBounds(instance, worldMin, worldMax);
+    out.center = (worldMin + worldMax) * 0.5f;
+    out.axis = glm::normalize(glm::vec3(model * glm::vec4(0, 0, 1, 0)));
+
+    out.focalLength = optics.focalLength;
+    out.lensBlendRadius = glm::length(element->boundsMax - element->boundsMin) * 0.5f;
+
+    // Aperture opening is centered, extends apertureDiameter fraction of bounds height
+    glm::vec2 size = glm::vec2(element->boundsMax - element->boundsMin);
+    out.apertureCenter = glm::vec2(element->boundsMin + element->boundsMax) * 0.5f;
+    out.apertureHalf = size * (optics.apertureDiameter * 0.5f);
+
+    out.reflectivity = optics.reflectivity;
+    out.transmissivity = optics.transmissivity;
+    out.gratingSpacing = 1.0f / (optics.gratingLineDensity * 1e3f); // lines/mm -> meters
+    out.filterColor = optics.filterColor;
+
+    out.ior = optics.ior;
+    out.cauchyB = optics.cauchyB;
+    for (int i = 0; i < spectral.count; i++)
+        out.iorAt[i] = dispersionIOR(optics.ior, optics.cauchyB, spectral.wavelength[i]);
+}
+
+} // namespace opticsketch
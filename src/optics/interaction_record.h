@@ -0,0 +1,55 @@
+#pragma once
+
+#include "elements/element.h"
+#include "optics/spectrum.h"
+#include <glm/glm.hpp>
+
+namespace opticsketch {
+
+// Everything the tracer needs about an element at a hit, compiled once per trace from
+// its transform, bounds and optics so the per-hit code is plain arithmetic. The GPU
+// backend packs its element buffer from the same records.
+struct InteractionRecord {
+    const Element* element = nullptr;
+    OpticalType opticalType = OpticalType::Passive;
+    bool recordsHits = false;           // Detector or Screen
+
+    glm::mat4 worldToLocal{1.0f};
+    glm::mat3 normalMatrix{1.0f};
+    glm::vec3 localMin{0.0f};
+    glm::vec3 localMax{0.0f};
+    glm::vec3 center{0.0f};             // world bounds center
+    glm::vec3 axis{0.0f, 0.0f, 1.0f};   // world direction of local +Z
+
+    // Thin lens
+    float focalLength = 50.0f;
+    float lensBlendRadius = 1.0f;       // half the local bounds diagonal
+
+    // Aperture opening in local XY
+    glm::vec2 apertureCenter{0.0f};
+    glm::vec2 apertureHalf{0.0f};
+
+    float reflectivity = 0.0f;
+    float transmissivity = 1.0f;
+    float gratingSpacing = 1.0f;        // meters between lines
+    glm::vec3 filterColor{1.0f};
+
+    // Dispersion
+    float ior = 1.5f;                   // at the 633 nm reference
+    float cauchyB = 0.0f;
+    float iorAt[kMaxSpectralSamples] = {};   // at the trace's spectral table wavelengths
+
+    // Refractive index at 'wavelength'; spectralIndex >= 0 is its slot in the spectral
+    // table, so white-light rays skip evaluating Cauchy
+    float iorFor(float wavelength, int spectralIndex = -1) const;
+};
+
+// Record of one array instance of 'element' (0 = the element itself). Matrix caches of
+// 'element' must be current (the tracer refreshes them first).
+void compileInteractionRecord(const Element* element, const SpectralTable& spectral, InteractionRecord& out,
+                              int instance = 0);
+
+// Cauchy dispersion: n(lambda) = baseIOR + B / lambda^2 with baseIOR at 633 nm
+float dispersionIOR(float baseIOR, float cauchyB, float wavelength);
+
+} // namespace opticsketch
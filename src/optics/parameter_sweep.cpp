@@ -0,0 +1,190 @@
+#include "optics/parameter_sweep.h"
+#include "optics/trace_workers.h"
+#include "scene/scene.h"
+#include "elements/element.h"
+#include "export/text_writer.h"
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+namespace opticsketch {
+
+static const char* const kSweepParameterNames[kSweepParameterCount] = {
+    "posX", "posY", "posZ", "rotY", "focalLength"
+};
+
+const char* sweepParameterName(SweepParameter parameter) {
+    int index = static_cast<int>(parameter);
+    return index >= 0 && index < kSweepParameterCount ? kSweepParameterNames[index] : "";
+}
+
+bool parseSweepParameter(const std::string& name, SweepParameter& out) {
+    for (int i = 0; i < kSweepParameterCount; i++) {
+        if (name == kSweepParameterNames[i]) {
+            out = static_cast<SweepParameter>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void applySweepParameter(Element* element, SweepParameter parameter, float value) {
+    if (!element) return;
+    switch (parameter) {
+        case SweepParameter::PositionX: element->transform.position.x = value; break;
+        case SweepParameter::PositionY: element->transform.position.y = value; break;
+        case SweepParameter::PositionZ: element->transform.position.z = value; break;
+        case SweepParameter::RotationY:
+            element->transform.rotation = glm::angleAxis(glm::radians(value), glm::vec3(0.0f, 1.0f, 0.0f));
+            break;
+        case SweepParameter::FocalLength: element->optics.focalLength = value; break;
+    }
+    element->markTransformDirty();
+}
+
+float SweepAxis::valueAt(int step) const {
+    if (steps <= 1) return start;
+    return start + (end - start) * (static_cast<float>(step) / static_cast<float>(steps - 1));
+}
+
+// A hit counts if the segment ends on (or within tolerance of) the detector's oriented box
+static bool endsOnDetector(const glm::vec3& point, const Element* detector, float tolerance) {
+    const glm::mat4& model = detector->getModelMatrix();
+    glm::vec3 local = glm::vec3(glm::inverse(model) * glm::vec4(point, 1.0f));
+    glm::vec3 closest = glm::clamp(local, detector->boundsMin, detector->boundsMax);
+    glm::vec3 world = glm::vec3(model * glm::vec4(closest, 1.0f));
+    return glm::length(world - point) <= tolerance;
+}
+
+static void measureSample(const Scene& scene, const std::vector<const Element*>& detectors,
+                          float tolerance, SweepSample& sample) {
+    const TracedRayBuffer& rays = scene.getTracedRays();
+    sample.segmentCount = rays.size();
+
+    std::vector<glm::vec3> hits;
+    std::vector<float> weights;
+    for (size_t i = 0; i < rays.size(); i++) {
+        for (const Element* detector : detectors) {
+            if (!endsOnDetector(rays.end[i], detector, tolerance)) continue;
+            hits.push_back(rays.end[i]);
+            weights.push_back(rays.intensity[i]);
+            break;
+        }
+    }
+
+    sample.hitCount = static_cast<int>(hits.size());
+    glm::vec3 sum(0.0f);
+    float total = 0.0f;
+    for (size_t i = 0; i < hits.size(); i++) {
+        sum += hits[i] * weights[i];
+        total += weights[i];
+    }
+    sample.hitIntensity = total;
+    if (total <= 0.0f) return;
+    sample.spotCenter = sum / total;
+    float spread = 0.0f;
+    for (size_t i = 0; i < hits.size(); i++) {
+        glm::vec3 d = hits[i] - sample.spotCenter;
+        spread += glm::dot(d, d) * weights[i];
+    }
+    sample.spotRadius = std::sqrt(spread / total);
+}
+
+bool runParameterSweep(const Scene* scene, const SweepSettings& settings, SweepResult& out) {
+    out = SweepResult{};
+    if (!scene || settings.axes.empty()) return false;
+
+    size_t sampleCount = 1;
+    for (const SweepAxis& axis : settings.axes) {
+        const Element* elem = nullptr;
+        for (const auto& e : scene->getElements()) {
+            if (e->id == axis.elementId) {
+                elem = e.get();
+                break;
+            }
+        }
+        if (!elem) {
+            std::cerr << "Sweep element not found: " << axis.elementId << "\n";
+            return false;
+        }
+        if (axis.steps < 1) return false;
+        out.axisLabels.push_back(elem->label + "." + sweepParameterName(axis.parameter));
+        sampleCount *= static_cast<size_t>(axis.steps);
+    }
+    out.axes = settings.axes;
+    out.samples.resize(sampleCount);
+
+    // Worker threads run on their own scene copies; GL is only available on the main thread
+    TraceConfig config = settings.trace;
+    config.backend = TraceBackend::Cpu;
+    config.threadCount = 1;
+
+    int workerCount = std::min(TraceWorkers::resolveThreadCount(settings.threadCount),
+                               static_cast<int>(sampleCount));
+    std::atomic<size_t> nextSample{0};
+    auto runWorker = [&](int) {
+        std::unique_ptr<Scene> copy = scene->snapshot();
+        std::vector<Element*> targets;
+        for (const SweepAxis& axis : settings.axes) targets.push_back(copy->getElement(axis.elementId));
+        std::vector<const Element*> detectors;
+        for (const auto& e : copy->getElements()) {
+            if (e->type != ElementType::Detector) continue;
+            if (!settings.detectorId.empty() && e->id != settings.detectorId) continue;
+            detectors.push_back(e.get());
+        }
+
+        RayTracer tracer;
+        for (size_t s = nextSample++; s < sampleCount; s = nextSample++) {
+            SweepSample& sample = out.samples[s];
+            sample.values.resize(settings.axes.size());
+            // Grid index -> per-axis step, last axis fastest
+            size_t rest = s;
+            for (size_t a = settings.axes.size(); a-- > 0;) {
+                const SweepAxis& axis = settings.axes[a];
+                int step = static_cast<int>(rest % static_cast<size_t>(axis.steps));
+                rest /= static_cast<size_t>(axis.steps);
+                sample.values[a] = axis.valueAt(step);
+                applySweepParameter(targets[a], axis.parameter, sample.values[a]);
+            }
+            tracer.traceScene(copy.get(), config);
+            measureSample(*copy, detectors, config.epsilon * 2.0f, sample);
+        }
+    };
+
+    TraceWorkers pool;
+    pool.parallelFor(workerCount, workerCount, runWorker);
+    return true;
+}
+
+bool exportSweepCsv(const std::string& path, const SweepResult& result) {
+    TextWriter out;
+    if (!out.open(path)) return false;
+
+    for (const std::string& label : result.axisLabels) {
+        // Labels are user text: quote them, doubling embedded quotes
+        out << '"';
+        for (char c : label) {
+            if (c == '"') out << '"';
+            out << c;
+        }
+        out << "\",";
+    }
+    out << "hits,intensity,spot_x,spot_y,spot_z,spot_rms,segments\n";
+
+    for (const SweepSample& sample : result.samples) {
+        for (float value : sample.values) out << GeneralNumber{value} << ',';
+        out << sample.hitCount << ','
+            << GeneralNumber{sample.hitIntensity} << ','
+            << GeneralNumber{sample.spotCenter.x} << ','
+            << GeneralNumber{sample.spotCenter.y} << ','
+            << GeneralNumber{sample.spotCenter.z} << ','
+            << GeneralNumber{sample.spotRadius} << ','
+            << static_cast<int>(sample.segmentCount) << '\n';
+    }
+    return out.close();
+}
+
+} // namespace opticsketch
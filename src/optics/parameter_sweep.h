@@ -0,0 +1,68 @@
+#pragma once
+
+#include "optics/ray_tracer.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+class Scene;
+class Element;
+
+// Element parameters a sweep can drive (same order as ParameterSweepParams::parameterIndex)
+enum class SweepParameter { PositionX, PositionY, PositionZ, RotationY, FocalLength };
+
+static constexpr int kSweepParameterCount = 5;
+
+const char* sweepParameterName(SweepParameter parameter);
+// Parses the names above ("posX", "rotY", "focalLength", ...); false if unknown
+bool parseSweepParameter(const std::string& name, SweepParameter& out);
+
+// Set one parameter of an element (rotY in degrees, around +Y)
+void applySweepParameter(Element* element, SweepParameter parameter, float value);
+
+// One swept parameter: 'steps' evenly spaced values from start to end inclusive
+struct SweepAxis {
+    std::string elementId;
+    SweepParameter parameter = SweepParameter::PositionX;
+    float start = 0.0f;
+    float end = 1.0f;
+    int steps = 10;
+
+    float valueAt(int step) const;
+};
+
+struct SweepSettings {
+    // Several axes form a grid (every combination); the last axis varies fastest
+    std::vector<SweepAxis> axes;
+    std::string detectorId;     // empty = every Detector element
+    TraceConfig trace;          // always traced on the CPU, one thread per sample
+    int threadCount = 0;        // samples traced at once (0 = hardware concurrency)
+};
+
+// Metrics of one grid point, taken from the segments that end on a detector
+struct SweepSample {
+    std::vector<float> values;      // one per axis
+    int hitCount = 0;
+    float hitIntensity = 0.0f;      // summed intensity arriving at the detectors
+    glm::vec3 spotCenter{0.0f};     // intensity-weighted mean hit position
+    float spotRadius = 0.0f;        // intensity-weighted RMS distance from spotCenter
+    size_t segmentCount = 0;        // all traced segments
+};
+
+struct SweepResult {
+    std::vector<SweepAxis> axes;
+    std::vector<std::string> axisLabels;    // "<element label>.<parameter>"
+    std::vector<SweepSample> samples;       // grid order
+};
+
+// Trace every grid point of 'settings' without touching 'scene'. Each worker thread
+// traces its own snapshot of the scene, so samples run in parallel. Returns false if an
+// axis names a missing element or the grid is empty.
+bool runParameterSweep(const Scene* scene, const SweepSettings& settings, SweepResult& out);
+
+// One row per sample: the axis values followed by the metrics
+bool exportSweepCsv(const std::string& path, const SweepResult& result);
+
+} // namespace opticsketch
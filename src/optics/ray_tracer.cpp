@@ -1,16 +1,41 @@
 #include "optics/ray_tracer.h"
 #include "scene/scene.h"
 #include "elements/element.h"
-#include "render/beam.h"
 #include "render/raycast.h"
+#include "profile/profiler.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 namespace opticsketch {
 
+const char* rayTerminationName(RayTermination reason) {
+    switch (reason) {
+        case RayTermination::MinIntensity: return "Below min intensity";
+        case RayTermination::MaxBounces: return "Max bounces";
+        case RayTermination::Escaped: return "Escaped";
+        case RayTermination::Absorbed: return "Absorbed";
+        case RayTermination::Evanescent: return "Evanescent order";
+        case RayTermination::Merged: return "Merged";
+        case RayTermination::Budget: return "Budget";
+    }
+    return "";
+}
+
+void TraceCounters::add(const TraceCounters& o) {
+    raysSpawned += o.raysSpawned;
+    segments += o.segments;
+    boxTests += o.boxTests;
+    surfaceTests += o.surfaceTests;
+    maxDepth = std::max(maxDepth, o.maxDepth);
+    for (int i = 0; i < kRayTerminationCount; i++) terminated[i] += o.terminated[i];
+    ms += o.ms;
+}
+
 glm::vec3 RayTracer::reflect(const glm::vec3& incident, const glm::vec3& normal) {
     return incident - 2.0f * glm::dot(incident, normal) * normal;
 }
@@ -39,99 +64,492 @@ float RayTracer::fresnelSchlick(float cosTheta, float n1, float n2) {
     return r0 + (1.0f - r0) * x * x * x * x * x;
 }
 
-// Convert wavelength in meters to visible spectrum RGB color
-// Based on Dan Bruton's approximate CIE algorithm
-static glm::vec3 wavelengthToRGB(float wavelength) {
-    float nm = wavelength * 1e9f; // convert to nanometers
-    float r = 0.0f, g = 0.0f, b = 0.0f;
-
-    if (nm >= 380.0f && nm < 440.0f) {
-        r = -(nm - 440.0f) / (440.0f - 380.0f);
-        g = 0.0f;
-        b = 1.0f;
-    } else if (nm >= 440.0f && nm < 490.0f) {
-        r = 0.0f;
-        g = (nm - 440.0f) / (490.0f - 440.0f);
-        b = 1.0f;
-    } else if (nm >= 490.0f && nm < 510.0f) {
-        r = 0.0f;
-        g = 1.0f;
-        b = -(nm - 510.0f) / (510.0f - 490.0f);
-    } else if (nm >= 510.0f && nm < 580.0f) {
-        r = (nm - 510.0f) / (580.0f - 510.0f);
-        g = 1.0f;
-        b = 0.0f;
-    } else if (nm >= 580.0f && nm < 645.0f) {
-        r = 1.0f;
-        g = -(nm - 645.0f) / (645.0f - 580.0f);
-        b = 0.0f;
-    } else if (nm >= 645.0f && nm <= 780.0f) {
-        r = 1.0f;
-        g = 0.0f;
-        b = 0.0f;
-    }
-
-    // Intensity falloff at edges of visible spectrum
-    float factor = 1.0f;
-    if (nm >= 380.0f && nm < 420.0f) {
-        factor = 0.3f + 0.7f * (nm - 380.0f) / (420.0f - 380.0f);
-    } else if (nm >= 700.0f && nm <= 780.0f) {
-        factor = 0.3f + 0.7f * (780.0f - nm) / (780.0f - 700.0f);
-    }
-
-    return glm::vec3(r * factor, g * factor, b * factor);
-}
-
-// Cauchy dispersion: n(lambda) = baseIOR + B / lambda^2
-// baseIOR is the IOR at a reference wavelength (e.g. 633nm)
-// cauchyB is in m^2 units. Set to 0 for no dispersion.
-static float dispersionIOR(float baseIOR, float cauchyB, float wavelength) {
-    if (cauchyB == 0.0f || wavelength < 1e-12f) return baseIOR;
-    // Compute offset from reference wavelength (633nm)
-    float lambdaRef = 633e-9f;
-    float nRef = baseIOR; // baseIOR is defined at the reference wavelength
-    // n(lambda) = A + B/lambda^2, where A = nRef - B/lambdaRef^2
-    return nRef + cauchyB * (1.0f / (wavelength * wavelength) - 1.0f / (lambdaRef * lambdaRef));
+// Elements passing 'keep(hot, slot)' in scene order, filtered on the scene's contiguous
+// component rows rather than by visiting every Element
+template <typename Ptr, typename Keep>
+static void collectElements(Scene* scene, std::vector<Ptr>& out, const Keep& keep) {
+    const ElementComponents& hot = scene->syncElementComponents();
+    const auto& elements = scene->getElements();
+    for (size_t slot = 0; slot < hot.size(); slot++)
+        if (keep(hot, slot)) out.push_back(elements[slot].get());
+}
+
+static bool isVisibleRow(const ElementComponents& hot, size_t slot) {
+    return hot.visible[slot] != 0;
+}
+
+static bool isActiveSourceRow(const ElementComponents& hot, size_t slot) {
+    return hot.visible[slot] && hot.opticalType[slot] == OpticalType::Source;
+}
+
+void RayTracer::updateAcceleration(Scene* scene, const TraceConfig& config) {
+    traceables.clear();
+    collectElements(scene, traceables, isVisibleRow);
+    if (bvh.matches(traceables))
+        bvh.refit();
+    else
+        bvh.build(traceables);
+    compileRecords(config);
+}
+
+void RayTracer::compileRecords(const TraceConfig& config) {
+    buildSpectralTable(config.spectrum, config.spectralSampling, config.spectralSamples, spectral);
+    // One record per array instance, in the order the BVH lays out its leaves
+    firstRecord.resize(traceables.size() + 1);
+    size_t count = 0;
+    for (size_t i = 0; i < traceables.size(); i++) {
+        firstRecord[i] = static_cast<int>(count);
+        count += traceables[i]->getInstanceCount();
+    }
+    firstRecord.back() = static_cast<int>(count);
+    records.resize(count);
+    for (size_t i = 0; i < traceables.size(); i++) {
+        for (int instance = 0; instance < firstRecord[i + 1] - firstRecord[i]; instance++)
+            compileInteractionRecord(traceables[i], spectral, records[firstRecord[i] + instance], instance);
+    }
+}
+
+static bool sameConfig(const TraceConfig& a, const TraceConfig& b) {
+    return a.maxBounces == b.maxBounces && a.maxDistance == b.maxDistance &&
+           a.minIntensity == b.minIntensity && a.epsilon == b.epsilon && a.backend == b.backend &&
+           a.maxSegments == b.maxSegments && a.maxRaysPerSource == b.maxRaysPerSource &&
+           a.mergeRays == b.mergeRays && a.mergeCell == b.mergeCell &&
+           a.spectralSamples == b.spectralSamples && a.spectralSampling == b.spectralSampling &&
+           a.spectrum == b.spectrum && a.shareSpectralPaths == b.shareSpectralPaths;
+}
+
+static bool sameOptics(const OpticalProperties& a, const OpticalProperties& b) {
+    return a.opticalType == b.opticalType && a.ior == b.ior &&
+           a.reflectivity == b.reflectivity && a.transmissivity == b.transmissivity &&
+           a.focalLength == b.focalLength && a.curvatureR1 == b.curvatureR1 &&
+           a.curvatureR2 == b.curvatureR2 && a.apertureDiameter == b.apertureDiameter &&
+           a.gratingLineDensity == b.gratingLineDensity && a.filterColor == b.filterColor &&
+           a.cauchyB == b.cauchyB && a.sourceRayCount == b.sourceRayCount &&
+           a.sourceBeamWidth == b.sourceBeamWidth && a.sourceIsWhiteLight == b.sourceIsWhiteLight;
+}
+
+// Segment vs AABB slab test (conservative: used only to decide what to re-trace)
+static bool segmentHitsBox(const glm::vec3& a, const glm::vec3& b,
+                           const glm::vec3& bmin, const glm::vec3& bmax) {
+    glm::vec3 d = b - a;
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        if (std::abs(d[axis]) < 1e-12f) {
+            if (a[axis] < bmin[axis] || a[axis] > bmax[axis]) return false;
+            continue;
+        }
+        float inv = 1.0f / d[axis];
+        float tNear = (bmin[axis] - a[axis]) * inv;
+        float tFar = (bmax[axis] - a[axis]) * inv;
+        if (tNear > tFar) std::swap(tNear, tFar);
+        t0 = std::max(t0, tNear);
+        t1 = std::min(t1, tFar);
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+static bool isActiveSource(const Element* elem) {
+    return elem->visible && elem->optics.opticalType == OpticalType::Source;
+}
+
+// Elements whose incoming rays are recorded as hits
+static bool recordsHits(const Element* elem) {
+    return elem->type == ElementType::Detector || elem->type == ElementType::Screen;
+}
+
+// Identity of a ray for merging: quantized origin, direction and color, exact wavelength
+// (0 for white-light bundles)
+struct RayKey {
+    int32_t cell[3];
+    int32_t dir[3];
+    uint32_t color;
+    uint32_t wavelength;
+
+    bool operator==(const RayKey& o) const { return std::memcmp(this, &o, sizeof(RayKey)) == 0; }
+};
+
+struct RayKeyHash {
+    size_t operator()(const RayKey& k) const {
+        // FNV-1a over the key bytes
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&k);
+        uint64_t h = 1469598103934665603ull;
+        for (size_t i = 0; i < sizeof(RayKey); i++) h = (h ^ bytes[i]) * 1099511628211ull;
+        return static_cast<size_t>(h);
+    }
+};
+
+// Merge state of one ray: its slot while still on the stack, -1 once popped
+struct RaySeen { int stackIndex; };
+
+// Open-addressing RayKey -> RaySeen map for traceRay. Slots are stamped with the
+// generation that wrote them, so clearing it between primary rays costs nothing and
+// the table keeps its capacity; a thread's tracing no longer allocates once warm.
+class RaySeenTable {
+public:
+    void clear() {
+        if (++generation == 0) {
+            // Stamp wrapped: old slots could look current again
+            for (Slot& slot : slots) slot.stamp = 0;
+            generation = 1;
+        }
+        used = 0;
+    }
+
+    RaySeen* find(const RayKey& key) {
+        if (slots.empty()) return nullptr;
+        for (size_t i = RayKeyHash{}(key) & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.stamp != generation) return nullptr;
+            if (slot.key == key) return &slot.value;
+        }
+    }
+
+    // Entry for key, added as {-1} if missing
+    RaySeen& insert(const RayKey& key) {
+        if ((used + 1) * 2 > slots.size()) grow();
+        for (size_t i = RayKeyHash{}(key) & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.stamp != generation) {
+                slot.stamp = generation;
+                slot.key = key;
+                slot.value = {-1};
+                used++;
+                return slot.value;
+            }
+            if (slot.key == key) return slot.value;
+        }
+    }
+
+private:
+    struct Slot {
+        RayKey key;
+        RaySeen value;
+        uint32_t stamp = 0;
+    };
+
+    static constexpr size_t kMinSlots = 64;
+
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(std::max(kMinSlots, old.size() * 2));
+        mask = slots.size() - 1;
+        uint32_t live = generation;
+        generation = 1;
+        used = 0;
+        for (const Slot& slot : old)
+            if (slot.stamp == live) insert(slot.key) = slot.value;
+    }
+
+    std::vector<Slot> slots;    // power of two
+    size_t mask = 0;
+    size_t used = 0;
+    uint32_t generation = 1;
+};
+
+static RayKey makeRayKey(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& color,
+                         float wavelength, float cell) {
+    RayKey k;
+    for (int a = 0; a < 3; a++) {
+        k.cell[a] = static_cast<int32_t>(std::floor(origin[a] / cell));
+        k.dir[a] = static_cast<int32_t>(std::lround(direction[a] * 4096.0f));
+    }
+    auto channel = [](float v) { return static_cast<uint32_t>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    k.color = channel(color.r) | (channel(color.g) << 8) | (channel(color.b) << 16);
+    std::memcpy(&k.wavelength, &wavelength, sizeof(float));
+    return k;
+}
+
+struct WavelengthEntry {
+    float lambda;
+    float intensityScale;
+    int spectralIndex;
+    glm::vec3 color;
+    bool bundle;
+};
+
+// Wavelengths a source emits and the share of its power each carries. White light is
+// the spectral table, or a single bundle standing for all of it.
+static void sourceWavelengths(const Element* source, const SpectralTable& spectral, bool bundles,
+                              std::vector<WavelengthEntry>& out) {
+    out.clear();
+    if (!source->optics.sourceIsWhiteLight) {
+        out.push_back({kLaserWavelength, 1.0f, -1, wavelengthToRGB(kLaserWavelength), false});
+    } else if (bundles) {
+        out.push_back({0.0f, 1.0f, -1, spectral.mixColor, true});
+    } else {
+        for (int i = 0; i < spectral.count; i++)
+            out.push_back({spectral.wavelength[i], spectral.weight[i], i, spectral.color[i], false});
+    }
+}
+
+// Per-thread temporaries of traceRay and the primary ray builders, kept warm across
+// rays and traces so the tracer's hot loops stop allocating
+struct RayTracer::TraceScratch {
+    std::vector<TraceRay> stack;
+    std::vector<TraceRay> children;
+    RaySeenTable seen;
+    std::vector<WavelengthEntry> wavelengths;
+};
+
+RayTracer::TraceScratch& RayTracer::traceScratch() {
+    thread_local TraceScratch scratch;
+    return scratch;
+}
+
+// Sorted, duplicate-free element list for planRetrace's lookups
+static void sortTouched(std::vector<const Element*>& touched) {
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
 }
 
 void RayTracer::traceScene(Scene* scene, const TraceConfig& config) {
     if (!scene) return;
+    OPTICSKETCH_PROFILE_SCOPE("traceScene");
 
     // Clear previous traced beams
     scene->clearTracedBeams();
+    progressive.active = false;
+
+    if (config.backend == TraceBackend::Gpu && traceSceneGpu(scene, config)) return;
+    gpuTraced = false;
+    auto start = std::chrono::steady_clock::now();
 
-    std::vector<TraceSegment> segments;
+    updateAcceleration(scene, config);
 
     // Find all Source elements and fire rays from them
-    for (const auto& elem : scene->getElements()) {
-        if (!elem->visible) continue;
-        if (elem->optics.opticalType != OpticalType::Source) continue;
+    activeSources.clear();
+    collectElements(scene, activeSources, isActiveSourceRow);
+    traceSources(activeSources, config, sourceTraces);
+    for (const auto& trace : sourceTraces)
+        emitBeams(scene, trace);
+    publishStats(sourceTraces, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    snapshotState(scene, config);
+}
 
-        // Fire ray along element's local +Z axis (forward direction)
-        glm::mat4 model = elem->transform.getMatrix();
-        glm::vec3 forward = glm::normalize(glm::vec3(model * glm::vec4(0, 0, 1, 0)));
-        glm::vec3 origin = elem->getWorldBoundsCenter();
+bool RayTracer::planRetrace(Scene* scene, const TraceConfig& config, bool& full,
+                            std::vector<const Element*>& retrace) {
+    full = false;
+    retrace.clear();
+    const auto& elements = scene->getElements();
+
+    // Anything structural invalidates every recorded ray tree
+    bool structural = !hasTraceState || !sameConfig(config, lastConfig) ||
+                      elements.size() != trackedElements.size() ||
+                      scene->getTracedBeamCount() != tracedBeamCount;
+
+    std::vector<const Element*>& changed = changedElements;
+    changed.clear();
+    for (size_t i = 0; !structural && i < elements.size(); i++) {
+        if (elements[i].get() != trackedElements[i]) {
+            structural = true;
+            break;
+        }
+        if (!stateMatches(elements[i].get(), trackedStates[i]))
+            changed.push_back(elements[i].get());
+    }
 
-        // Offset origin slightly along forward to avoid self-intersection
-        origin += forward * config.epsilon;
+    // GPU traces keep no per-source ray trees, and re-tracing everything is their fast path
+    if (structural || (!changed.empty() && gpuTraced)) {
+        full = true;
+        return true;
+    }
+    if (changed.empty()) return false;
+
+    updateAcceleration(scene, config);
 
-        float baseWavelength = 633e-9f; // Default HeNe red
-        int rayCount = std::max(1, elem->optics.sourceRayCount);
-        float beamWidth = elem->optics.sourceBeamWidth;
+    // World bounds of changed elements, to catch elements moving into existing rays
+    changedBounds.clear();
+    for (const Element* e : changed) {
+        if (!e->visible) continue;
+        glm::vec3 bmin, bmax;
+        e->getArrayWorldBounds(bmin, bmax);
+        changedBounds.push_back({bmin, bmax});
+    }
 
-        // Determine wavelengths to trace
-        struct WavelengthEntry { float lambda; float intensityScale; };
-        std::vector<WavelengthEntry> wavelengths;
+    bool removed = false;
+    for (auto it = sourceTraces.begin(); it != sourceTraces.end();) {
+        const Element* source = it->source;
 
-        if (elem->optics.sourceIsWhiteLight) {
-            // 7 spectral wavelengths spanning visible range
-            const float spectra[] = { 380e-9f, 450e-9f, 490e-9f, 530e-9f, 580e-9f, 620e-9f, 700e-9f };
-            for (float lam : spectra) {
-                wavelengths.push_back({lam, 1.0f / 7.0f});
+        bool dirty = false;
+        for (const Element* e : changed) {
+            if (std::binary_search(it->touched.begin(), it->touched.end(), e)) { dirty = true; break; }
+        }
+        for (size_t b = 0; !dirty && b < changedBounds.size(); b++) {
+            for (const auto& seg : it->segments) {
+                if (segmentHitsBox(seg.start, seg.end, changedBounds[b].first, changedBounds[b].second)) {
+                    dirty = true;
+                    break;
+                }
             }
-        } else {
-            wavelengths.push_back({baseWavelength, 1.0f});
         }
+        if (!dirty) { ++it; continue; }
+
+        scene->clearTracedBeams(source->id);
+        removed = true;
+        if (!isActiveSource(source)) {
+            it = sourceTraces.erase(it);
+            continue;
+        }
+        retrace.push_back(source);
+        ++it;
+    }
+
+    // Elements that just became sources have no recorded trace yet
+    for (const Element* e : changed) {
+        if (!isActiveSource(e)) continue;
+        bool known = std::any_of(sourceTraces.begin(), sourceTraces.end(),
+            [e](const SourceTrace& t) { return t.source == e; });
+        if (!known) retrace.push_back(e);
+    }
+    return removed || !retrace.empty();
+}
+
+void RayTracer::storeSourceTrace(SourceTrace& trace) {
+    auto existing = std::find_if(sourceTraces.begin(), sourceTraces.end(),
+        [&trace](const SourceTrace& t) { return t.source == trace.source; });
+    if (existing != sourceTraces.end())
+        std::swap(*existing, trace);
+    else
+        sourceTraces.push_back(std::move(trace));
+}
+
+bool RayTracer::traceSceneIncremental(Scene* scene, const TraceConfig& config) {
+    if (!scene) return false;
+    OPTICSKETCH_PROFILE_SCOPE("traceSceneIncremental");
+    progressive.active = false;
+
+    bool full = false;
+    std::vector<const Element*>& retrace = retraceSources;
+    if (!planRetrace(scene, config, full, retrace)) return false;
+    if (full) {
+        traceScene(scene, config);
+        return true;
+    }
+
+    // Re-trace all affected sources in one parallel batch
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SourceTrace>& results = retraceResults;
+    traceSources(retrace, config, results);
+    for (const auto& trace : results) emitBeams(scene, trace);
+    publishStats(results, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    for (auto& trace : results) storeSourceTrace(trace);
+
+    snapshotState(scene, config);
+    return true;
+}
+
+bool RayTracer::traceSceneProgressive(Scene* scene, const TraceConfig& config, float sliceMs) {
+    if (!scene) return false;
+    // The GPU backend traces a whole scene in well under a frame
+    if (config.backend == TraceBackend::Gpu) return traceSceneIncremental(scene, config);
+    OPTICSKETCH_PROFILE_SCOPE("traceSceneProgressive");
+
+    bool changed = false;
+    bool full = false;
+    std::vector<const Element*>& retrace = retraceSources;
+    if (planRetrace(scene, config, full, retrace)) {
+        // Sources of an unfinished job are only partly in the buffer: start them over too
+        if (progressive.active && !full) {
+            for (const Element* source : progressive.sources) {
+                if (std::find(retrace.begin(), retrace.end(), source) != retrace.end()) continue;
+                scene->clearTracedBeams(source->id);
+                if (isActiveSource(source)) retrace.push_back(source);
+            }
+        }
+        if (full) {
+            scene->clearTracedBeams();
+            gpuTraced = false;
+            sourceTraces.clear();
+            retrace.clear();
+            collectElements(scene, retrace, isActiveSourceRow);
+            updateAcceleration(scene, config);
+        }
+
+        progressive.active = true;
+        progressive.sources = retrace;
+        progressive.rays.clear();
+        progressive.results.resize(retrace.size());
+        for (size_t s = 0; s < retrace.size(); s++) {
+            progressive.results[s].reset(retrace[s]);
+            progressive.results[s].touched.push_back(retrace[s]);
+            collectPrimaryRays(retrace[s], static_cast<int>(s), config, progressive.rays);
+        }
+        progressive.raysOfSource.assign(retrace.size(), 0);
+        for (const TraceRay& r : progressive.rays) progressive.raysOfSource[r.sourceIndex]++;
+        progressive.nextRay = 0;
+        progressive.truncated = false;
+        progressive.wallMs = 0.0;
+        // The state being traced is what later changes are measured against
+        snapshotState(scene, config);
+        changed = true;
+    }
+    if (!progressive.active) return changed;
+
+    // Trace chunks of primary rays until the slice is spent; every finished chunk is
+    // published to the scene right away
+    auto sliceStart = std::chrono::steady_clock::now();
+    auto deadline = sliceStart +
+        std::chrono::microseconds(static_cast<int64_t>(std::max(sliceMs, 0.1f) * 1000.0f));
+    const size_t chunk = static_cast<size_t>(TraceWorkers::resolveThreadCount(config.threadCount)) * 4;
+    std::atomic<bool> truncated{false};
+    while (progressive.nextRay < progressive.rays.size()) {
+        size_t begin = progressive.nextRay;
+        size_t end = std::min(progressive.rays.size(), begin + chunk);
+        tracePrimaries(progressive.sources, progressive.rays, progressive.raysOfSource, begin, end,
+                       config, nullptr, truncated);
+        for (size_t r = begin; r < end; r++) {
+            SourceTrace& partial = jobTraces[r - begin];
+            emitBeams(scene, partial);
+            SourceTrace& dst = progressive.results[progressive.rays[r].sourceIndex];
+            dst.segments.insert(dst.segments.end(), partial.segments.begin(), partial.segments.end());
+            dst.hits.insert(dst.hits.end(), partial.hits.begin(), partial.hits.end());
+            dst.touched.insert(dst.touched.end(), partial.touched.begin(), partial.touched.end());
+            dst.counters.add(partial.counters);
+        }
+        progressive.nextRay = end;
+        changed = true;
+        if (std::chrono::steady_clock::now() >= deadline) break;
+    }
+    progressive.truncated = progressive.truncated || truncated.load();
+    progressive.wallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sliceStart).count();
+    // Our own appends are not outside edits
+    tracedBeamCount = scene->getTracedBeamCount();
+
+    if (progressive.nextRay >= progressive.rays.size()) {
+        traceTruncated = progressive.truncated;
+        publishStats(progressive.results, progressive.wallMs);
+        for (auto& trace : progressive.results) {
+            sortTouched(trace.touched);
+            storeSourceTrace(trace);
+        }
+        progressive.active = false;
+    }
+    return changed;
+}
+
+void RayTracer::collectPrimaryRays(const Element* source, int sourceIndex, const TraceConfig& config,
+                                   std::vector<TraceRay>& out, bool allowBundles) const {
+    int rayCount = std::max(1, source->optics.sourceRayCount);
+    float beamWidth = source->optics.sourceBeamWidth;
+
+    // Determine wavelengths to trace
+    std::vector<WavelengthEntry>& wavelengths = traceScratch().wavelengths;
+    sourceWavelengths(source, spectral, allowBundles && config.shareSpectralPaths, wavelengths);
+
+    // Every instance of an arrayed source emits the full beam
+    for (int instance = 0; instance < source->getInstanceCount(); instance++) {
+        // Fire ray along element's local +Z axis (forward direction)
+        glm::mat4 model = source->getInstanceModelMatrix(instance);
+        glm::vec3 forward = glm::normalize(glm::vec3(model * glm::vec4(0, 0, 1, 0)));
+        glm::vec3 bmin, bmax;
+        source->getInstanceWorldBounds(instance, bmin, bmax);
+        glm::vec3 origin = (bmin + bmax) * 0.5f;
+
+        // Offset origin slightly along forward to avoid self-intersection
+        origin += forward * config.epsilon;
 
         // For each wavelength, fire rayCount parallel rays across beam width
         for (const auto& wl : wavelengths) {
@@ -150,380 +568,710 @@ void RayTracer::traceScene(Scene* scene, const TraceConfig& config) {
                 ray.direction = forward;
                 ray.intensity = wl.intensityScale;
                 ray.wavelength = wl.lambda;
-                ray.color = wavelengthToRGB(wl.lambda);
-                ray.sourceId = elem->id;
-
-                traceRay(ray, scene, config, 0, segments);
+                ray.spectralIndex = wl.spectralIndex;
+                ray.color = wl.color;
+                ray.bundle = wl.bundle;
+                ray.sourceIndex = sourceIndex;
+                ray.instance = instance;
+                out.push_back(ray);
             }
         }
     }
+}
 
-    // Convert trace segments into Beam objects
-    for (const auto& seg : segments) {
-        auto beam = std::make_unique<Beam>();
-        beam->start = seg.start;
-        beam->end = seg.end;
-        beam->color = seg.color;
-        beam->width = 2.0f;
-        beam->isTraced = true;
-        beam->intensity = seg.intensity;
-        beam->sourceElementId = seg.sourceElementId;
-        scene->addBeam(std::move(beam));
+RayTracer::TraceRay RayTracer::analysisPrimaryRay(const Element* source, int sourceIndex, int rayIndex,
+                                                  int rayCount, const TraceConfig& config, float& weight) const {
+    // Arrayed sources deal the rays out over their instances, each carrying full power
+    int instanceCount = source->getInstanceCount();
+    int instance = rayIndex % instanceCount;
+    rayIndex /= instanceCount;
+    rayCount = (rayCount + instanceCount - 1) / instanceCount;
+
+    std::vector<WavelengthEntry>& wavelengths = traceScratch().wavelengths;
+    sourceWavelengths(source, spectral, config.shareSpectralPaths, wavelengths);
+    int wavelengthCount = static_cast<int>(wavelengths.size());
+    const WavelengthEntry& wl = wavelengths[rayIndex % wavelengthCount];
+    int k = rayIndex / wavelengthCount;
+    int perWavelength = (rayCount + wavelengthCount - 1) / wavelengthCount;
+
+    glm::mat4 model = source->getInstanceModelMatrix(instance);
+    glm::vec3 forward = glm::normalize(glm::vec3(model * glm::vec4(0, 0, 1, 0)));
+    glm::vec3 bmin, bmax;
+    source->getInstanceWorldBounds(instance, bmin, bmax);
+    glm::vec3 origin = (bmin + bmax) * 0.5f + forward * config.epsilon;
+
+    // Vogel spiral: evenly spread, deterministic samples of the beam cross-section
+    float radius = 0.5f * source->optics.sourceBeamWidth *
+                   std::sqrt((static_cast<float>(k) + 0.5f) / static_cast<float>(perWavelength));
+    float angle = static_cast<float>(k) * 2.39996323f;   // golden angle
+    if (radius > 0.0f) {
+        glm::vec3 localRight = glm::normalize(glm::vec3(model * glm::vec4(1, 0, 0, 0)));
+        glm::vec3 localUp = glm::normalize(glm::vec3(model * glm::vec4(0, 1, 0, 0)));
+        origin += (localRight * std::cos(angle) + localUp * std::sin(angle)) * radius;
     }
-}
 
-void RayTracer::traceRay(const TraceRay& ray, Scene* scene, const TraceConfig& config,
-                          int depth, std::vector<TraceSegment>& segments) {
-    if (depth >= config.maxBounces) return;
-    if (ray.intensity < config.minIntensity) return;
+    TraceRay ray;
+    ray.origin = origin;
+    ray.direction = forward;
+    // Traced at full per-wavelength intensity so minIntensity cuts off the same branches
+    // as a normal trace; the hit is scaled by the ray's share of the power instead
+    ray.intensity = wl.intensityScale;
+    ray.wavelength = wl.lambda;
+    ray.spectralIndex = wl.spectralIndex;
+    ray.color = wl.color;
+    ray.bundle = wl.bundle;
+    ray.sourceIndex = sourceIndex;
+    ray.instance = instance;
+    weight = 1.0f / static_cast<float>(perWavelength);
+    return ray;
+}
 
-    // Find closest element intersection
-    float closestT = config.maxDistance;
-    Element* hitElement = nullptr;
-    glm::vec3 hitNormalWorld(0.0f);
+void RayTracer::traceAnalysis(Scene* scene, const TraceConfig& config, const AnalysisConfig& analysis,
+                              std::vector<DetectorAccumulator>& out) {
+    out.clear();
+    if (!scene) return;
+    OPTICSKETCH_PROFILE_SCOPE("traceAnalysis");
+    updateAcceleration(scene, config);
 
+    std::vector<const Element*> sources, detectors;
     for (const auto& elem : scene->getElements()) {
-        if (!elem->visible) continue;
-        // Skip the source element itself on the first bounce to avoid self-hit
-        if (elem->optics.opticalType == OpticalType::Source && depth == 0 && elem->id == ray.sourceId) continue;
-        // Skip passive/source elements for intersection (they don't interact with rays)
-        // Actually, passive elements should just pass through, but we still need to detect them
-        // to know to keep going. Let's include all visible elements.
-
-        glm::mat4 model = elem->transform.getMatrix();
-        glm::mat4 invModel = glm::inverse(model);
-
-        // Transform ray to local space
-        glm::vec3 localOrigin = glm::vec3(invModel * glm::vec4(ray.origin, 1.0f));
-        glm::vec3 localDir = glm::normalize(glm::vec3(invModel * glm::vec4(ray.direction, 0.0f)));
-
-        Raycast::Ray localRay{localOrigin, localDir};
-        float t;
-        glm::vec3 localNormal;
-
-        if (Raycast::intersectAABBWithNormal(localRay, elem->boundsMin, elem->boundsMax, t, localNormal)) {
-            if (t > config.epsilon && t < closestT) {
-                closestT = t;
-                hitElement = elem.get();
-                // Transform normal to world space
-                glm::mat3 normalMatrix = glm::mat3(glm::transpose(invModel));
-                hitNormalWorld = glm::normalize(normalMatrix * localNormal);
-            }
+        if (isActiveSource(elem.get())) sources.push_back(elem.get());
+        if (elem->visible && recordsHits(elem.get())) detectors.push_back(elem.get());
+    }
+    out.resize(detectors.size());
+    for (size_t d = 0; d < detectors.size(); d++) out[d].reset(detectors[d], analysis.bins);
+    if (sources.empty() || detectors.empty()) return;
+
+    // Contiguous ray ranges, a few per thread; each job owns a zeroed copy of the
+    // accumulators, merged once at the end, so the hot loop takes no locks
+    int64_t raysPerSource = std::max(1, analysis.raysPerSource);
+    int64_t totalRays = raysPerSource * static_cast<int64_t>(sources.size());
+    int threads = TraceWorkers::resolveThreadCount(config.threadCount);
+    int jobCount = static_cast<int>(std::min<int64_t>(threads * 4, (totalRays + 1023) / 1024));
+    jobCount = std::max(1, jobCount);
+    analysisPartials.resize(jobCount);
+    for (auto& partial : analysisPartials) partial = out;
+
+    workers.parallelFor(jobCount, config.threadCount, [&](int j) {
+        AnalysisSink sink;
+        sink.detectors = &detectors;
+        sink.accumulators = analysisPartials[j].data();
+        SourceTrace scratch;
+        int64_t begin = totalRays * j / jobCount;
+        int64_t end = totalRays * (j + 1) / jobCount;
+        for (int64_t r = begin; r < end; r++) {
+            int s = static_cast<int>(r / raysPerSource);
+            int i = static_cast<int>(r % raysPerSource);
+            scratch.source = sources[s];
+            TraceRay ray = analysisPrimaryRay(sources[s], s, i, static_cast<int>(raysPerSource), config, sink.weight);
+            traceRay(ray, config, scratch, &sink);
         }
+    });
+
+    for (int j = 0; j < jobCount; j++) {
+        for (size_t d = 0; d < out.size(); d++) out[d].merge(analysisPartials[j][d]);
     }
+}
 
-    // Create a beam segment from ray origin to hit point (or max distance)
-    glm::vec3 endPoint = ray.origin + ray.direction * closestT;
+void RayTracer::tracePrimaries(const std::vector<const Element*>& sources, const std::vector<TraceRay>& rays,
+                               const std::vector<int>& raysOfSource, size_t begin, size_t end,
+                               const TraceConfig& config, const std::chrono::steady_clock::time_point* deadline,
+                               std::atomic<bool>& truncated) {
+    int jobCount = static_cast<int>(end - begin);
+    OPTICSKETCH_PROFILE_COUNT(TracedRays, jobCount);
+    if (static_cast<int>(jobTraces.size()) < jobCount) jobTraces.resize(jobCount);
+    for (int j = 0; j < jobCount; j++) jobTraces[j].reset(nullptr);
+
+    // Each primary ray gets an equal share of its source's and of the whole trace's
+    // segment budget (all of 'rays', not just this range); the deadline is shared
+    const int primaryCount = static_cast<int>(rays.size());
+    auto jobBudget = [&](const TraceRay& ray) {
+        RayBudget budget;
+        int limit = 0;
+        if (config.maxSegments > 0) limit = std::max(1, config.maxSegments / std::max(primaryCount, 1));
+        if (config.maxRaysPerSource > 0) {
+            int share = std::max(1, config.maxRaysPerSource / raysOfSource[ray.sourceIndex]);
+            limit = limit > 0 ? std::min(limit, share) : share;
+        }
+        budget.maxSegments = limit;
+        budget.deadline = deadline;
+        budget.truncated = &truncated;
+        return budget;
+    };
+
+    // traceRay only reads the BVH and element state. Element matrix caches were
+    // refreshed by updateAcceleration(), so concurrent getters don't write.
+    workers.parallelFor(jobCount, config.threadCount, [&](int j) {
+        const TraceRay& ray = rays[begin + j];
+        jobTraces[j].source = sources[ray.sourceIndex];
+        RayBudget budget = jobBudget(ray);
+        auto start = std::chrono::steady_clock::now();
+        traceRay(ray, config, jobTraces[j], nullptr, &budget);
+        jobTraces[j].counters.ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    });
+}
 
-    TraceSegment seg;
-    seg.start = ray.origin;
-    seg.end = endPoint;
-    seg.color = ray.color;
-    seg.intensity = ray.intensity;
-    seg.sourceElementId = ray.sourceId;
-    segments.push_back(seg);
+void RayTracer::traceSources(const std::vector<const Element*>& sources, const TraceConfig& config,
+                             std::vector<SourceTrace>& out) {
+    // Entries are reset rather than recreated, so their buffers keep their capacity
+    out.resize(sources.size());
+
+    // Every primary ray is an independent job
+    std::vector<TraceRay>& jobRays = primaryRays;
+    jobRays.clear();
+    for (size_t s = 0; s < sources.size(); s++) {
+        out[s].reset(sources[s]);
+        out[s].touched.push_back(sources[s]);
+        collectPrimaryRays(sources[s], static_cast<int>(s), config, jobRays);
+    }
 
-    if (!hitElement) return; // Ray escaped the scene
+    std::vector<int>& raysOfSource = primaryRaysOfSource;
+    raysOfSource.assign(sources.size(), 0);
+    for (const TraceRay& r : jobRays) raysOfSource[r.sourceIndex]++;
+    std::atomic<bool> truncated{false};
+    std::chrono::steady_clock::time_point deadline;
+    if (config.timeBudgetMs > 0.0f) {
+        deadline = std::chrono::steady_clock::now() +
+            std::chrono::microseconds(static_cast<int64_t>(config.timeBudgetMs * 1000.0f));
+    }
+    tracePrimaries(sources, jobRays, raysOfSource, 0, jobRays.size(), config,
+                   config.timeBudgetMs > 0.0f ? &deadline : nullptr, truncated);
+    traceTruncated = truncated.load();
+    int jobCount = static_cast<int>(jobRays.size());
+
+    // Merge per-ray buffers in emission order so beam order stays deterministic
+    for (int j = 0; j < jobCount; j++) {
+        SourceTrace& dst = out[jobRays[j].sourceIndex];
+        SourceTrace& src = jobTraces[j];
+        dst.segments.insert(dst.segments.end(), src.segments.begin(), src.segments.end());
+        dst.hits.insert(dst.hits.end(), src.hits.begin(), src.hits.end());
+        dst.touched.insert(dst.touched.end(), src.touched.begin(), src.touched.end());
+        dst.counters.add(src.counters);
+    }
+    for (SourceTrace& trace : out) sortTouched(trace.touched);
+}
 
-    // Ensure normal faces against the ray direction
-    if (glm::dot(hitNormalWorld, ray.direction) > 0.0f) {
-        hitNormalWorld = -hitNormalWorld;
+bool RayTracer::traceSceneGpu(Scene* scene, const TraceConfig& config) {
+    if (!GpuTracer::isSupported()) return false;
+
+    // Matrix caches are refreshed here, before the elements are packed
+    traceables.clear();
+    collectElements(scene, traceables, isVisibleRow);
+    compileRecords(config);
+
+    std::vector<const Element*> sources;
+    collectElements(scene, sources, isActiveSourceRow);
+    std::vector<TraceRay> primaries;
+    for (size_t s = 0; s < sources.size(); s++)
+        collectPrimaryRays(sources[s], static_cast<int>(s), config, primaries, false);
+
+    std::vector<GpuTracer::PrimaryRay> rays(primaries.size());
+    for (size_t i = 0; i < primaries.size(); i++) {
+        const TraceRay& p = primaries[i];
+        GpuTracer::PrimaryRay& r = rays[i];
+        r.origin = p.origin;
+        r.direction = p.direction;
+        r.color = p.color;
+        r.intensity = p.intensity;
+        r.wavelength = p.wavelength;
+        r.sourceIndex = p.sourceIndex;
+        auto it = std::find(traceables.begin(), traceables.end(), sources[p.sourceIndex]);
+        r.ignoreElement = it != traceables.end() ? firstRecord[it - traceables.begin()] + p.instance : -1;
     }
+    auto start = std::chrono::steady_clock::now();
+    if (!gpu.trace(records, rays, config)) return false;
+
+    // Source ids are registered now so readBack() can map segment sources to them
+    TracedRayBuffer& traced = scene->getTracedRays();
+    gpuSourceSlots.clear();
+    for (const Element* source : sources) gpuSourceSlots.push_back(traced.sourceIndex(source->id));
+    traced.gpuLineBuffer = gpu.getLineBuffer();
+    traced.gpuLineVertices = static_cast<uint32_t>(gpu.getLineVertexCount());
+    traced.revision++;
+
+    sourceTraces.clear();
+    gpuTraced = true;
+    stats = TraceStats{};
+    stats.gpu = true;
+    stats.total.raysSpawned = static_cast<int64_t>(rays.size());
+    stats.total.segments = static_cast<int64_t>(gpu.getLineVertexCount() / 2);
+    stats.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    snapshotState(scene, config);
+    return true;
+}
 
-    glm::vec3 hitPoint = endPoint;
-    const OpticalProperties& optics = hitElement->optics;
+void RayTracer::readBackGpuTrace(Scene* scene) {
+    if (!scene || !gpuTraced) return;
+    TracedRayBuffer& traced = scene->getTracedRays();
+    if (!traced.onGpu() || !traced.empty()) return;
+    gpu.readBack(traced, gpuSourceSlots);
+    // The arrays now mirror the GPU buffer; that is not an outside edit
+    tracedBeamCount = scene->getTracedBeamCount();
+}
 
-    switch (optics.opticalType) {
-        case OpticalType::Mirror: {
-            // Pure reflection
-            glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
-            TraceRay newRay;
-            newRay.origin = hitPoint + reflected * config.epsilon;
-            newRay.direction = reflected;
-            newRay.intensity = ray.intensity * optics.reflectivity;
-            newRay.color = ray.color;
-            newRay.sourceId = ray.sourceId;
-            newRay.wavelength = ray.wavelength;
-            traceRay(newRay, scene, config, depth + 1, segments);
-            break;
+void RayTracer::emitBeams(Scene* scene, const SourceTrace& trace) {
+    // Append trace segments to the scene's traced ray buffer
+    TracedRayBuffer& rays = scene->getTracedRays();
+    int sourceIdx = rays.sourceIndex(trace.source->id);
+    rays.reserve(rays.size() + trace.segments.size());
+    OPTICSKETCH_PROFILE_COUNT(TracedSegments, trace.segments.size());
+    for (const auto& seg : trace.segments)
+        rays.add(seg.start, seg.end, seg.color, seg.intensity, sourceIdx, seg.pathStart);
+
+    const Element* lastDetector = nullptr;
+    int detectorIdx = -1;
+    for (const auto& hit : trace.hits) {
+        if (hit.detector != lastDetector) {
+            lastDetector = hit.detector;
+            detectorIdx = rays.hits.detectorIndex(hit.detector->id);
         }
+        rays.hits.add(hit.local, hit.intensity, hit.wavelength, detectorIdx, sourceIdx);
+    }
+}
 
-        case OpticalType::Lens: {
-            // Thin lens model using focalLength with wavelength-dependent dispersion
-            glm::mat4 elemModel = hitElement->transform.getMatrix();
-            glm::vec3 opticalAxis = glm::normalize(glm::vec3(elemModel * glm::vec4(0, 0, 1, 0)));
-            glm::vec3 elemCenter = hitElement->getWorldBoundsCenter();
-
-            // Project hit point onto the lens plane to get displacement from optical axis
-            glm::vec3 toHit = hitPoint - elemCenter;
-            glm::vec3 offset = toHit - glm::dot(toHit, opticalAxis) * opticalAxis;
-            float h = glm::length(offset);
-
-            // Wavelength-dependent IOR and focal length
-            float n = dispersionIOR(optics.ior, optics.cauchyB, ray.wavelength);
-            // Focal length scales inversely with (n-1): f(λ) = f_ref * (n_ref - 1) / (n(λ) - 1)
-            float nRef = optics.ior; // IOR at reference wavelength
-            float f = optics.focalLength;
-            if (std::abs(n - 1.0f) > 1e-6f && std::abs(nRef - 1.0f) > 1e-6f) {
-                f = optics.focalLength * (nRef - 1.0f) / (n - 1.0f);
-            }
+void RayTracer::publishStats(const std::vector<SourceTrace>& traces, double wallMs) {
+    stats = TraceStats{};
+    stats.wallMs = wallMs;
+    stats.truncated = traceTruncated;
+    for (const SourceTrace& trace : traces) {
+        stats.sources.push_back({trace.source->id, trace.source->label, trace.counters});
+        stats.total.add(trace.counters);
+    }
+}
 
-            // Compute Fresnel reflectance for reflected component
-            float cosI = std::abs(glm::dot(ray.direction, hitNormalWorld));
-            float R = fresnelSchlick(cosI, 1.0f, n);
-
-            // Reflected component
-            if (R * ray.intensity > config.minIntensity) {
-                glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
-                TraceRay reflRay;
-                reflRay.origin = hitPoint + reflected * config.epsilon;
-                reflRay.direction = reflected;
-                reflRay.intensity = ray.intensity * R;
-                reflRay.color = ray.color;
-                reflRay.sourceId = ray.sourceId;
-                reflRay.wavelength = ray.wavelength;
-                traceRay(reflRay, scene, config, depth + 1, segments);
-            }
+RayTracer::ElementState RayTracer::captureState(const Element* elem) {
+    ElementState st;
+    st.id = elem->id;
+    st.transformGeneration = elem->getTransformGeneration();
+    st.visible = elem->visible;
+    st.boundsMin = elem->boundsMin;
+    st.boundsMax = elem->boundsMax;
+    st.optics = elem->optics;
+    st.mesh = elem->mesh.get();
+    return st;
+}
 
-            // Transmitted component with thin-lens deflection
-            float T = (1.0f - R) * optics.transmissivity;
-            if (T * ray.intensity > config.minIntensity) {
-                glm::vec3 exitDir;
-                if (std::abs(f) > 0.01f && h > 1e-6f) {
-                    // Focal point on the exit side of the lens
-                    // Determine which side the ray is coming from
-                    float rayDotAxis = glm::dot(ray.direction, opticalAxis);
-                    float sign = (rayDotAxis >= 0.0f) ? 1.0f : -1.0f;
-                    glm::vec3 focalPoint = elemCenter + sign * opticalAxis * f;
-
-                    // The exit ray goes from hitPoint toward focalPoint (for parallel rays)
-                    // For general rays: use the thin lens equation
-                    // exitDir = normalize(focalPoint - hitPoint) approximately
-                    // More accurate: deflect by angle theta = -h/f
-                    glm::vec3 toFocal = focalPoint - hitPoint;
-                    exitDir = glm::normalize(toFocal);
-
-                    // Blend with incident direction for rays not parallel to axis
-                    // A ray through the center should pass undeviated
-                    float blend = h / (glm::length(hitElement->boundsMax - hitElement->boundsMin) * 0.5f);
-                    blend = std::clamp(blend, 0.0f, 1.0f);
-                    exitDir = glm::normalize(glm::mix(ray.direction, exitDir, blend));
-                } else {
-                    // Ray through center or infinite focal length — pass straight through
-                    exitDir = ray.direction;
-                }
+bool RayTracer::stateMatches(const Element* elem, const ElementState& state) {
+    return elem->getTransformGeneration() == state.transformGeneration &&
+           elem->visible == state.visible &&
+           elem->boundsMin == state.boundsMin && elem->boundsMax == state.boundsMax &&
+           elem->mesh.get() == state.mesh &&
+           elem->id == state.id && sameOptics(elem->optics, state.optics);
+}
 
-                TraceRay transRay;
-                transRay.origin = hitPoint + exitDir * config.epsilon;
-                transRay.direction = exitDir;
-                transRay.intensity = ray.intensity * T;
-                transRay.color = ray.color;
-                transRay.sourceId = ray.sourceId;
-                transRay.wavelength = ray.wavelength;
-                traceRay(transRay, scene, config, depth + 1, segments);
+void RayTracer::snapshotState(Scene* scene, const TraceConfig& config) {
+    trackedElements.clear();
+    trackedStates.clear();
+    for (const auto& elem : scene->getElements()) {
+        trackedElements.push_back(elem.get());
+        trackedStates.push_back(captureState(elem.get()));
+    }
+    lastConfig = config;
+    tracedBeamCount = scene->getTracedBeamCount();
+    hasTraceState = true;
+}
+
+void RayTracer::traceRay(const TraceRay& primary, const TraceConfig& config,
+                         SourceTrace& out, const AnalysisSink* sink, const RayBudget* budget) const {
+    // Depth-first over an explicit stack instead of recursion, so deep maxBounces
+    // can't overflow the call stack and child rays are plain copies
+    TraceScratch& scratch = traceScratch();
+    std::vector<TraceRay>& stack = scratch.stack;
+    stack.clear();
+    stack.push_back(primary);
+
+    // Rays spawned by one interaction (at most 3 grating orders per wavelength of a bundle)
+    std::vector<TraceRay>& children = scratch.children;
+
+    RaySeenTable& seen = scratch.seen;
+    const bool merging = config.mergeRays && config.mergeCell > 0.0f;
+    auto keyOf = [&](const TraceRay& r) {
+        return makeRayKey(r.origin, r.direction, r.color, r.wavelength, config.mergeCell);
+    };
+    if (merging) {
+        seen.clear();
+        seen.insert(keyOf(primary)) = {0};
+    }
+
+    TraceCounters& counters = out.counters;
+    auto terminate = [&](RayTermination reason, int64_t rays) {
+        counters.terminated[static_cast<int>(reason)] += rays;
+    };
+    counters.raysSpawned++;
+
+    int emitted = 0;
+    unsigned int iterations = 0;
+    while (!stack.empty()) {
+        if (budget) {
+            bool overSegments = budget->maxSegments > 0 && emitted >= budget->maxSegments;
+            // The clock is only read every few rays
+            bool overTime = budget->deadline && (++iterations & 63u) == 0 &&
+                            std::chrono::steady_clock::now() > *budget->deadline;
+            if (overSegments || overTime) {
+                if (budget->truncated) budget->truncated->store(true);
+                terminate(RayTermination::Budget, static_cast<int64_t>(stack.size()));
+                break;
             }
-            break;
         }
 
-        case OpticalType::Splitter: {
-            // Both reflect and transmit
-            float R = optics.reflectivity;
-            float T = optics.transmissivity;
-
-            // Reflected
-            if (R * ray.intensity > config.minIntensity) {
-                glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
-                TraceRay reflRay;
-                reflRay.origin = hitPoint + reflected * config.epsilon;
-                reflRay.direction = reflected;
-                reflRay.intensity = ray.intensity * R;
-                reflRay.color = ray.color;
-                reflRay.sourceId = ray.sourceId;
-                reflRay.wavelength = ray.wavelength;
-                traceRay(reflRay, scene, config, depth + 1, segments);
-            }
+        TraceRay ray = stack.back();
+        stack.pop_back();
+        // No longer pending: later twins are traced on their own
+        if (merging) seen.insert(keyOf(ray)) = {-1};
 
-            // Transmitted (continues in same direction through thin splitter)
-            if (T * ray.intensity > config.minIntensity) {
-                TraceRay transRay;
-                transRay.origin = hitPoint + ray.direction * config.epsilon;
-                transRay.direction = ray.direction;
-                transRay.intensity = ray.intensity * T;
-                transRay.color = ray.color;
-                transRay.sourceId = ray.sourceId;
-                transRay.wavelength = ray.wavelength;
-                traceRay(transRay, scene, config, depth + 1, segments);
-            }
-            break;
+        if (ray.depth >= config.maxBounces) {
+            terminate(RayTermination::MaxBounces, 1);
+            continue;
+        }
+        if (ray.intensity < config.minIntensity) {
+            terminate(RayTermination::MinIntensity, 1);
+            continue;
+        }
+        emitted++;
+        counters.segments++;
+        counters.maxDepth = std::max(counters.maxDepth, ray.depth);
+
+        // Find closest element intersection
+        float closestT = config.maxDistance;
+        const InteractionRecord* rec = nullptr;
+        glm::vec3 hitNormalWorld(0.0f);
+        bool exiting = false;   // leaving the element from inside (second surface of a lens or prism)
+
+        // Skip the emitting source copy on the first bounce to avoid self-hit
+        ElementBVH::Hit hit;
+        if (bvh.closestHit(ray.origin, ray.direction, config.epsilon, closestT,
+                           ray.depth == 0 ? out.source : nullptr, ray.instance, hit)) {
+            closestT = hit.t;
+            rec = &records[hit.index];
+            hitNormalWorld = hit.normal;
+            exiting = hit.exiting;
+        }
+        counters.boxTests += hit.boxTests;
+        counters.surfaceTests += hit.surfaceTests;
+
+        // Create a beam segment from ray origin to hit point (or max distance)
+        glm::vec3 endPoint = ray.origin + ray.direction * closestT;
+
+        if (!sink) {
+            TraceSegment seg;
+            seg.start = ray.origin;
+            seg.end = endPoint;
+            seg.color = ray.color;
+            seg.intensity = ray.intensity;
+            seg.sourceIndex = ray.sourceIndex;
+            seg.pathStart = ray.pathLength;
+            out.segments.push_back(seg);
         }
 
-        case OpticalType::Prism: {
-            // Refract through prism surface with wavelength-dependent dispersion
-            float n1 = 1.0f;
-            float n2 = dispersionIOR(optics.ior, optics.cauchyB, ray.wavelength);
-
-            glm::vec3 refracted;
-            if (refract(ray.direction, hitNormalWorld, n1, n2, refracted)) {
-                TraceRay transRay;
-                transRay.origin = hitPoint + refracted * config.epsilon;
-                transRay.direction = refracted;
-                transRay.intensity = ray.intensity * optics.transmissivity;
-                transRay.color = ray.color;
-                transRay.sourceId = ray.sourceId;
-                transRay.wavelength = ray.wavelength;
-                traceRay(transRay, scene, config, depth + 1, segments);
+        if (!rec) {
+            terminate(RayTermination::Escaped, 1);
+            continue;
+        }
+        const Element* hitElement = rec->element;
+        // Consecutive hits on one element are common (lens and prism faces); the list is
+        // sorted and deduplicated when the source's trace is merged
+        if (!sink && (out.touched.empty() || out.touched.back() != hitElement)) out.touched.push_back(hitElement);
+
+        if (rec->recordsHits) {
+            glm::vec3 local = glm::vec3(rec->worldToLocal * glm::vec4(endPoint, 1.0f));
+            if (sink) {
+                const auto& detectors = *sink->detectors;
+                for (size_t d = 0; d < detectors.size(); d++) {
+                    if (detectors[d] != hitElement) continue;
+                    sink->accumulators[d].add(local, ray.intensity * sink->weight);
+                    break;
+                }
+            } else if (ray.bundle) {
+                // Spot diagrams and exports see each wavelength of a bundle
+                for (int i = 0; i < spectral.count; i++)
+                    out.hits.push_back({hitElement, local, ray.intensity * spectral.weight[i], spectral.wavelength[i]});
             } else {
-                // Total internal reflection at prism surface
-                glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
-                TraceRay newRay;
-                newRay.origin = hitPoint + reflected * config.epsilon;
-                newRay.direction = reflected;
-                newRay.intensity = ray.intensity;
-                newRay.color = ray.color;
-                newRay.sourceId = ray.sourceId;
-                newRay.wavelength = ray.wavelength;
-                traceRay(newRay, scene, config, depth + 1, segments);
+                out.hits.push_back({hitElement, local, ray.intensity, ray.wavelength});
             }
-            break;
         }
 
-        case OpticalType::Absorber: {
-            // Ray terminates here
-            break;
+        // Ensure normal faces against the ray direction
+        if (glm::dot(hitNormalWorld, ray.direction) > 0.0f) {
+            hitNormalWorld = -hitNormalWorld;
         }
 
-        case OpticalType::Grating: {
-            // Diffraction grating using grating equation:
-            // sin(theta_m) = sin(theta_i) + m * lambda * lineDensity * 1e3
-            // (lineDensity in lines/mm, lambda in meters, factor 1e3 converts mm->m)
-            float lineDensity = optics.gratingLineDensity; // lines/mm
-            float lambda = ray.wavelength;                 // meters
-            float d = 1.0f / (lineDensity * 1e3f);        // grating spacing in meters
-
-            // Compute incident angle relative to grating normal
-            float cosI = std::abs(glm::dot(ray.direction, hitNormalWorld));
-            float sinI = std::sqrt(std::max(0.0f, 1.0f - cosI * cosI));
-            // Sign of incidence
-            if (glm::dot(ray.direction, hitNormalWorld) > 0.0f) sinI = -sinI;
-
-            // Grating tangent direction (in the plane of incidence)
-            glm::vec3 tangent = glm::normalize(ray.direction - glm::dot(ray.direction, hitNormalWorld) * hitNormalWorld);
-
-            float intensityPerOrder = ray.intensity / 3.0f; // Split among 3 orders
-
-            // Generate orders m = -1, 0, +1
-            for (int m = -1; m <= 1; m++) {
-                float sinM = sinI + static_cast<float>(m) * lambda / d;
-                if (std::abs(sinM) > 1.0f) continue; // Evanescent order, skip
-
-                if (intensityPerOrder < config.minIntensity) continue;
-
-                glm::vec3 orderDir;
-                if (m == 0) {
-                    // 0th order: transmitted straight through
-                    orderDir = ray.direction;
-                } else {
-                    float cosM = std::sqrt(std::max(0.0f, 1.0f - sinM * sinM));
-                    // Reconstruct diffracted direction
-                    // Normal component points away from surface (transmitted side)
-                    orderDir = sinM * tangent - cosM * hitNormalWorld;
-                    orderDir = glm::normalize(orderDir);
+        glm::vec3 hitPoint = endPoint;
+
+        // Child ray leaving the hit point (or 'from') along dir
+        children.clear();
+        auto spawn = [&](const glm::vec3& from, const glm::vec3& dir, float intensity, const glm::vec3& color) {
+            children.push_back(ray);
+            TraceRay& c = children.back();
+            c.origin = from + dir * config.epsilon;
+            c.direction = dir;
+            c.intensity = intensity;
+            c.color = color;
+            c.depth = ray.depth + 1;
+            c.pathLength = ray.pathLength + glm::distance(ray.origin, from);
+        };
+
+        // A bundle shares its path until an element whose effect depends on wavelength;
+        // there it splits and each wavelength interacts on its own
+        bool dispersive = rec->opticalType == OpticalType::Grating ||
+                          (rec->cauchyB != 0.0f && (rec->opticalType == OpticalType::Lens ||
+                                                    rec->opticalType == OpticalType::Prism));
+        const bool split = ray.bundle && dispersive;
+        const TraceRay arriving = ray;
+        const int components = split ? spectral.count : 1;
+        for (int comp = 0; comp < components; comp++) {
+            if (split) {
+                ray = arriving;
+                ray.bundle = false;
+                ray.wavelength = spectral.wavelength[comp];
+                ray.spectralIndex = comp;
+                ray.intensity = arriving.intensity * spectral.weight[comp];
+                ray.color = spectral.color[comp] * arriving.tint;
+                ray.tint = glm::vec3(1.0f);
+            }
+
+            switch (rec->opticalType) {
+                case OpticalType::Mirror: {
+                    // Pure reflection
+                    glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
+                    spawn(hitPoint, reflected, ray.intensity * rec->reflectivity, ray.color);
+                    break;
                 }
 
-                TraceRay orderRay;
-                orderRay.origin = hitPoint + orderDir * config.epsilon;
-                orderRay.direction = orderDir;
-                orderRay.intensity = intensityPerOrder;
-                orderRay.color = ray.color;
-                orderRay.sourceId = ray.sourceId;
-                orderRay.wavelength = ray.wavelength;
-                traceRay(orderRay, scene, config, depth + 1, segments);
-            }
-            break;
-        }
+                case OpticalType::Lens: {
+                    if (exiting) {
+                        // The thin-lens deflection was applied where the ray entered the glass
+                        spawn(hitPoint, ray.direction, ray.intensity, ray.color);
+                        break;
+                    }
+                    // Thin lens model using focalLength with wavelength-dependent dispersion
+                    const glm::vec3& opticalAxis = rec->axis;
+                    const glm::vec3& elemCenter = rec->center;
+
+                    // Project hit point onto the lens plane to get displacement from optical axis
+                    glm::vec3 toHit = hitPoint - elemCenter;
+                    glm::vec3 offset = toHit - glm::dot(toHit, opticalAxis) * opticalAxis;
+                    float h = glm::length(offset);
+
+                    // Wavelength-dependent IOR and focal length
+                    float n = rec->iorFor(ray.wavelength, ray.spectralIndex);
+                    // Focal length scales inversely with (n-1): f(λ) = f_ref * (n_ref - 1) / (n(λ) - 1)
+                    float nRef = rec->ior; // IOR at reference wavelength
+                    float f = rec->focalLength;
+                    if (std::abs(n - 1.0f) > 1e-6f && std::abs(nRef - 1.0f) > 1e-6f) {
+                        f = rec->focalLength * (nRef - 1.0f) / (n - 1.0f);
+                    }
+
+                    // Compute Fresnel reflectance for reflected component
+                    float cosI = std::abs(glm::dot(ray.direction, hitNormalWorld));
+                    float R = fresnelSchlick(cosI, 1.0f, n);
+
+                    // Reflected component
+                    if (R * ray.intensity > config.minIntensity) {
+                        glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
+                        spawn(hitPoint, reflected, ray.intensity * R, ray.color);
+                    } else {
+                        terminate(RayTermination::MinIntensity, 1);
+                    }
+
+                    // Transmitted component with thin-lens deflection
+                    float T = (1.0f - R) * rec->transmissivity;
+                    if (T * ray.intensity > config.minIntensity) {
+                        glm::vec3 exitDir;
+                        if (std::abs(f) > 0.01f && h > 1e-6f) {
+                            // Focal point on the exit side of the lens
+                            // Determine which side the ray is coming from
+                            float rayDotAxis = glm::dot(ray.direction, opticalAxis);
+                            float sign = (rayDotAxis >= 0.0f) ? 1.0f : -1.0f;
+                            glm::vec3 focalPoint = elemCenter + sign * opticalAxis * f;
+
+                            // The exit ray goes from hitPoint toward focalPoint (for parallel rays)
+                            // For general rays: use the thin lens equation
+                            // exitDir = normalize(focalPoint - hitPoint) approximately
+                            // More accurate: deflect by angle theta = -h/f
+                            glm::vec3 toFocal = focalPoint - hitPoint;
+                            exitDir = glm::normalize(toFocal);
+
+                            // Blend with incident direction for rays not parallel to axis
+                            // A ray through the center should pass undeviated
+                            float blend = h / rec->lensBlendRadius;
+                            blend = std::clamp(blend, 0.0f, 1.0f);
+                            exitDir = glm::normalize(glm::mix(ray.direction, exitDir, blend));
+                        } else {
+                            // Ray through center or infinite focal length — pass straight through
+                            exitDir = ray.direction;
+                        }
+
+                        spawn(hitPoint, exitDir, ray.intensity * T, ray.color);
+                    } else {
+                        terminate(RayTermination::MinIntensity, 1);
+                    }
+                    break;
+                }
 
-        case OpticalType::Filter: {
-            // Transmit with attenuation and color tint
-            float T = optics.transmissivity;
-            if (T * ray.intensity > config.minIntensity) {
-                TraceRay transRay;
-                transRay.origin = hitPoint + ray.direction * config.epsilon;
-                transRay.direction = ray.direction;
-                transRay.intensity = ray.intensity * T;
-                transRay.color = ray.color * optics.filterColor;
-                transRay.sourceId = ray.sourceId;
-                transRay.wavelength = ray.wavelength;
-                traceRay(transRay, scene, config, depth + 1, segments);
-            }
-            break;
-        }
+                case OpticalType::Splitter: {
+                    // Both reflect and transmit
+                    float R = rec->reflectivity;
+                    float T = rec->transmissivity;
+
+                    // Reflected
+                    if (R * ray.intensity > config.minIntensity) {
+                        glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
+                        spawn(hitPoint, reflected, ray.intensity * R, ray.color);
+                    } else {
+                        terminate(RayTermination::MinIntensity, 1);
+                    }
+
+                    // Transmitted (continues in same direction through thin splitter)
+                    if (T * ray.intensity > config.minIntensity) {
+                        spawn(hitPoint, ray.direction, ray.intensity * T, ray.color);
+                    } else {
+                        terminate(RayTermination::MinIntensity, 1);
+                    }
+                    break;
+                }
 
-        case OpticalType::Aperture: {
-            // Check if hit point falls within the opening
-            glm::mat4 elemModel = hitElement->transform.getMatrix();
-            glm::mat4 invElemModel = glm::inverse(elemModel);
-            glm::vec3 localHit = glm::vec3(invElemModel * glm::vec4(hitPoint, 1.0f));
-
-            // Aperture opening is centered, extends apertureDiameter fraction of bounds height
-            float boundsHeight = hitElement->boundsMax.y - hitElement->boundsMin.y;
-            float boundsWidth = hitElement->boundsMax.x - hitElement->boundsMin.x;
-            float openingHalfY = (optics.apertureDiameter * boundsHeight) * 0.5f;
-            float openingHalfX = (optics.apertureDiameter * boundsWidth) * 0.5f;
-
-            float localCenterY = (hitElement->boundsMin.y + hitElement->boundsMax.y) * 0.5f;
-            float localCenterX = (hitElement->boundsMin.x + hitElement->boundsMax.x) * 0.5f;
-
-            bool insideOpening = std::abs(localHit.y - localCenterY) < openingHalfY &&
-                                 std::abs(localHit.x - localCenterX) < openingHalfX;
-
-            if (insideOpening) {
-                // Pass through the opening
-                TraceRay passRay;
-                passRay.origin = hitPoint + ray.direction * config.epsilon;
-                passRay.direction = ray.direction;
-                passRay.intensity = ray.intensity;
-                passRay.color = ray.color;
-                passRay.sourceId = ray.sourceId;
-                passRay.wavelength = ray.wavelength;
-                traceRay(passRay, scene, config, depth + 1, segments);
-            }
-            // else: ray is absorbed by the aperture body
-            break;
-        }
+                case OpticalType::Prism: {
+                    // Refract through prism surface with wavelength-dependent dispersion:
+                    // air to glass where the ray enters, glass to air where it leaves
+                    float n = rec->iorFor(ray.wavelength, ray.spectralIndex);
+                    float n1 = exiting ? n : 1.0f;
+                    float n2 = exiting ? 1.0f : n;
+
+                    glm::vec3 refracted;
+                    if (refract(ray.direction, hitNormalWorld, n1, n2, refracted)) {
+                        spawn(hitPoint, refracted, ray.intensity * rec->transmissivity, ray.color);
+                    } else {
+                        // Total internal reflection at prism surface
+                        glm::vec3 reflected = reflect(ray.direction, hitNormalWorld);
+                        spawn(hitPoint, reflected, ray.intensity, ray.color);
+                    }
+                    break;
+                }
 
-        case OpticalType::FiberCoupler: {
-            // Absorb incoming ray, emit along element's local +Z axis
-            glm::mat4 elemModel = hitElement->transform.getMatrix();
-            glm::vec3 fiberAxis = glm::normalize(glm::vec3(elemModel * glm::vec4(0, 0, 1, 0)));
-            glm::vec3 elemCenter = hitElement->getWorldBoundsCenter();
-
-            float T = optics.transmissivity; // coupling efficiency
-            if (T * ray.intensity > config.minIntensity) {
-                TraceRay fiberRay;
-                fiberRay.origin = elemCenter + fiberAxis * config.epsilon;
-                fiberRay.direction = fiberAxis;
-                fiberRay.intensity = ray.intensity * T;
-                fiberRay.color = ray.color;
-                fiberRay.sourceId = ray.sourceId;
-                fiberRay.wavelength = ray.wavelength;
-                traceRay(fiberRay, scene, config, depth + 1, segments);
+                case OpticalType::Absorber: {
+                    // Ray terminates here
+                    terminate(RayTermination::Absorbed, 1);
+                    break;
+                }
+
+                case OpticalType::Grating: {
+                    // Diffraction grating using grating equation:
+                    // sin(theta_m) = sin(theta_i) + m * lambda * lineDensity * 1e3
+                    // (lineDensity in lines/mm, lambda in meters, factor 1e3 converts mm->m)
+                    float lambda = ray.wavelength;                 // meters
+                    float d = rec->gratingSpacing;                 // grating spacing in meters
+
+                    // Compute incident angle relative to grating normal
+                    float cosI = std::abs(glm::dot(ray.direction, hitNormalWorld));
+                    float sinI = std::sqrt(std::max(0.0f, 1.0f - cosI * cosI));
+                    // Sign of incidence
+                    if (glm::dot(ray.direction, hitNormalWorld) > 0.0f) sinI = -sinI;
+
+                    // Grating tangent direction (in the plane of incidence)
+                    glm::vec3 tangent = glm::normalize(ray.direction - glm::dot(ray.direction, hitNormalWorld) * hitNormalWorld);
+
+                    float intensityPerOrder = ray.intensity / 3.0f; // Split among 3 orders
+
+                    // Generate orders m = -1, 0, +1
+                    for (int m = -1; m <= 1; m++) {
+                        float sinM = sinI + static_cast<float>(m) * lambda / d;
+                        if (std::abs(sinM) > 1.0f) { // Evanescent order, skip
+                            terminate(RayTermination::Evanescent, 1);
+                            continue;
+                        }
+
+                        if (intensityPerOrder < config.minIntensity) {
+                            terminate(RayTermination::MinIntensity, 1);
+                            continue;
+                        }
+
+                        glm::vec3 orderDir;
+                        if (m == 0) {
+                            // 0th order: transmitted straight through
+                            orderDir = ray.direction;
+                        } else {
+                            float cosM = std::sqrt(std::max(0.0f, 1.0f - sinM * sinM));
+                            // Reconstruct diffracted direction
+                            // Normal component points away from surface (transmitted side)
+                            orderDir = sinM * tangent - cosM * hitNormalWorld;
+                            orderDir = glm::normalize(orderDir);
+                        }
+
+                        spawn(hitPoint, orderDir, intensityPerOrder, ray.color);
+                    }
+                    break;
+                }
+
+                case OpticalType::Filter: {
+                    // Transmit with attenuation and color tint
+                    float T = rec->transmissivity;
+                    if (T * ray.intensity > config.minIntensity) {
+                        spawn(hitPoint, ray.direction, ray.intensity * T, ray.color * rec->filterColor);
+                        children.back().tint *= rec->filterColor;
+                    } else {
+                        terminate(RayTermination::MinIntensity, 1);
+                    }
+                    break;
+                }
+
+                case OpticalType::Aperture: {
+                    // Check if hit point falls within the (elliptical, for non-square bounds) opening
+                    glm::vec3 localHit = glm::vec3(rec->worldToLocal * glm::vec4(hitPoint, 1.0f));
+                    glm::vec2 q = (glm::vec2(localHit) - rec->apertureCenter) / glm::max(rec->apertureHalf, glm::vec2(1e-6f));
+                    bool insideOpening = glm::dot(q, q) < 1.0f;
+
+                    if (insideOpening) {
+                        // Pass through the opening
+                        spawn(hitPoint, ray.direction, ray.intensity, ray.color);
+                    } else {
+                        // Absorbed by the aperture body
+                        terminate(RayTermination::Absorbed, 1);
+                    }
+                    break;
+                }
+
+                case OpticalType::FiberCoupler: {
+                    // Absorb incoming ray, emit along element's local +Z axis
+                    const glm::vec3& fiberAxis = rec->axis;
+                    const glm::vec3& elemCenter = rec->center;
+
+                    float T = rec->transmissivity; // coupling efficiency
+                    if (T * ray.intensity > config.minIntensity) {
+                        spawn(elemCenter, fiberAxis, ray.intensity * T, ray.color);
+                    } else {
+                        terminate(RayTermination::MinIntensity, 1);
+                    }
+                    break;
+                }
+
+                case OpticalType::Source:
+                case OpticalType::Passive:
+                default: {
+                    // Pass through
+                    spawn(hitPoint, ray.direction, ray.intensity, ray.color);
+                    break;
+                }
             }
-            break;
         }
 
-        case OpticalType::Source:
-        case OpticalType::Passive:
-        default: {
-            // Pass through
-            TraceRay passRay;
-            passRay.origin = hitPoint + ray.direction * config.epsilon;
-            passRay.direction = ray.direction;
-            passRay.intensity = ray.intensity;
-            passRay.color = ray.color;
-            passRay.sourceId = ray.sourceId;
-            passRay.wavelength = ray.wavelength;
-            traceRay(passRay, scene, config, depth + 1, segments);
-            break;
+        // Push in reverse so the first spawned child is traced first, matching the
+        // segment order of the former recursive trace
+        counters.raysSpawned += static_cast<int64_t>(children.size());
+        for (int c = static_cast<int>(children.size()) - 1; c >= 0; c--) {
+            if (merging) {
+                // An identical ray still pending carries both intensities through its whole
+                // path. A twin that was already traced can't take the weight any more
+                // (its segments, children and hits are out), so this ray is traced itself.
+                RaySeen& known = seen.insert(keyOf(children[c]));
+                if (known.stackIndex >= 0) {
+                    stack[known.stackIndex].intensity += children[c].intensity;
+                    terminate(RayTermination::Merged, 1);
+                    continue;
+                }
+                known = {static_cast<int>(stack.size())};
+            }
+            stack.push_back(children[c]);
         }
     }
 }
@@ -1,9 +1,20 @@
 #pragma once
 
+#include "optics/bvh.h"
+#include "optics/trace_workers.h"
+#include "optics/gpu_tracer.h"
+#include "optics/detector_accumulator.h"
+#include "optics/interaction_record.h"
+#include "optics/spectrum.h"
+#include "elements/element.h"
 #include <glm/glm.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace opticsketch {
 
@@ -11,11 +22,80 @@ class Scene;
 class Element;
 class Beam;
 
+// Cpu traces on the worker pool. Gpu traces every primary ray in a compute shader
+// straight into a line vertex buffer; it needs GL 4.3 compute and storage buffers on the
+// current context and silently falls back to Cpu without them.
+enum class TraceBackend { Cpu, Gpu };
+
 struct TraceConfig {
     int maxBounces = 20;
     float maxDistance = 5000.0f;   // mm
     float minIntensity = 0.01f;   // stop tracing when intensity drops below this
     float epsilon = 0.01f;        // offset to avoid self-intersection
+    int threadCount = 0;          // worker threads (0 = hardware concurrency, 1 = single-threaded)
+    TraceBackend backend = TraceBackend::Cpu;
+
+    // Budgets (0 = unlimited). Segment budgets are split evenly over a source's primary
+    // rays, so which branches get cut does not depend on thread timing. A trace that hits
+    // a budget keeps what it has and RayTracer::lastTraceTruncated() reports it.
+    int maxSegments = 500000;       // whole trace
+    int maxRaysPerSource = 100000;  // segments per source
+    float timeBudgetMs = 0.0f;      // wall clock (the editor sets it for auto-trace)
+
+    // Merge rays of one ray tree that leave the same origin cell with the same direction,
+    // wavelength and color while both are still untraced, summing their intensity
+    // (recombining splitter arms)
+    bool mergeRays = true;
+    float mergeCell = 0.05f;        // mm
+
+    // White-light sources emit spectralSamples wavelengths drawn from 'spectrum'. With
+    // shareSpectralPaths each primary is one ray carrying all of them until it reaches a
+    // dispersive element (a grating, or a lens or prism with a nonzero Cauchy B), where it
+    // splits per wavelength; mirrors, splitters and filters are traced once for all.
+    int spectralSamples = 7;
+    SpectralSampling spectralSampling = SpectralSampling::Uniform;
+    SourceSpectrum spectrum = SourceSpectrum::Flat;
+    bool shareSpectralPaths = true;
+};
+
+// High-ray-count trace that only bins where rays land on Detector and Screen elements
+struct AnalysisConfig {
+    int raysPerSource = 100000;     // spread over each source's beam width as a filled disk
+    int bins = 128;                 // histogram resolution per detector side
+};
+
+// Why a ray stopped. MinIntensity also covers children that were never spawned because
+// they'd start below the threshold; Merged rays were folded into an identical one.
+enum class RayTermination { MinIntensity, MaxBounces, Escaped, Absorbed, Evanescent, Merged, Budget };
+static constexpr int kRayTerminationCount = 7;
+const char* rayTerminationName(RayTermination reason);
+
+// Work done tracing one ray tree, one source or a whole trace
+struct TraceCounters {
+    int64_t raysSpawned = 0;        // primaries and every child
+    int64_t segments = 0;
+    int64_t boxTests = 0;           // BVH node boxes tested
+    int64_t surfaceTests = 0;       // exact element surface tests (mesh triangles count singly)
+    int maxDepth = 0;
+    int64_t terminated[kRayTerminationCount] = {};
+    double ms = 0.0;                // thread time; overlaps with other sources'
+
+    void add(const TraceCounters& o);
+};
+
+// What the last trace call did. An incremental trace only covers the sources it re-traced.
+// GPU traces only report their primaries and segments.
+struct TraceStats {
+    struct Source {
+        std::string id;
+        std::string label;
+        TraceCounters counters;
+    };
+    TraceCounters total;
+    std::vector<Source> sources;
+    double wallMs = 0.0;
+    bool truncated = false;
+    bool gpu = false;
 };
 
 struct TraceSegment {
@@ -23,7 +103,8 @@ struct TraceSegment {
     glm::vec3 end;
     glm::vec3 color;
     float intensity;
-    std::string sourceElementId;
+    int sourceIndex;   // index of the emitting source within its trace batch
+    float pathStart;   // mm of optical path from the source to 'start'
 };
 
 class RayTracer {
@@ -31,18 +112,163 @@ public:
     // Trace all Source elements in the scene, creating beam segments
     void traceScene(Scene* scene, const TraceConfig& config = TraceConfig());
 
+    // Re-trace only sources affected by element changes since the last trace.
+    // Falls back to a full trace when elements were added/removed, the config changed,
+    // or traced beams were modified outside the tracer. Returns true if anything was re-traced.
+    bool traceSceneIncremental(Scene* scene, const TraceConfig& config = TraceConfig());
+
+    // Time-sliced variant of traceSceneIncremental for interactive editing: call once per
+    // frame. Changes start (or restart) a trace job over the affected sources; each call
+    // then traces primary rays for about sliceMs and appends their segments to the scene
+    // at once, so beams fill in over a few frames. Returns true if the traced rays changed.
+    bool traceSceneProgressive(Scene* scene, const TraceConfig& config, float sliceMs);
+
+    // True while a progressive trace has rays left to trace
+    bool isTracing() const { return progressive.active; }
+
+    // Fire analysis.raysPerSource rays from every source without creating segments and
+    // stream their detector hits into one accumulator per visible Detector/Screen (scene
+    // order). Each source (each instance of an arrayed one) carries one unit of power per
+    // wavelength; the instances of an arrayed detector share its bins. Always runs on the CPU
+    // and leaves the scene's traced rays untouched.
+    void traceAnalysis(Scene* scene, const TraceConfig& config, const AnalysisConfig& analysis,
+                       std::vector<DetectorAccumulator>& out);
+
+    // After a GPU trace, copy the segments into the scene's TracedRayBuffer arrays (call
+    // before anything reads them, e.g. exports and saves). No-op for CPU traces.
+    void readBackGpuTrace(Scene* scene);
+
+    // True if the last CPU trace stopped early on a segment or time budget
+    bool lastTraceTruncated() const { return traceTruncated; }
+
+    // True if the last trace ran on the GPU backend
+    bool lastTraceOnGpu() const { return gpuTraced; }
+
+    // Statistics of the last traceScene, traceSceneIncremental or finished progressive trace
+    const TraceStats& lastTraceStats() const { return stats; }
+
+    // Free the GPU backend's GL objects (context must be current)
+    void releaseGpu() { gpu.cleanup(); }
+
 private:
+    // Plain-data ray record; the emitting source is referenced by index, not id
     struct TraceRay {
         glm::vec3 origin;
         glm::vec3 direction;
-        float intensity;
         glm::vec3 color;
-        std::string sourceId;
-        float wavelength = 633e-9f;  // meters (default HeNe red)
+        float intensity;
+        float wavelength = kLaserWavelength;  // meters
+        int spectralIndex = -1;      // slot in the spectral table (-1 = not a table wavelength)
+        int sourceIndex = 0;         // index into the sources being traced
+        int instance = 0;            // array instance of the source that emitted it
+        int depth = 0;               // bounces so far (0 = primary ray)
+        float pathLength = 0.0f;     // mm travelled from the source to 'origin'
+        // A white-light bundle carries every spectral table wavelength at once; 'tint' is
+        // the filter color it picked up, reapplied to each wavelength when it splits
+        bool bundle = false;
+        glm::vec3 tint{1.0f};
+    };
+
+    // A ray arriving at a Detector or Screen, in the element's local frame
+    struct TraceHit {
+        const Element* detector = nullptr;
+        glm::vec3 local;
+        float intensity;
+        float wavelength;
+    };
+
+    // Result of tracing one source: its segments, detector hits and every element its ray tree hit
+    struct SourceTrace {
+        const Element* source = nullptr;
+        std::vector<TraceSegment> segments;
+        std::vector<TraceHit> hits;
+        std::vector<const Element*> touched;   // sorted once the trace is complete
+        TraceCounters counters;
+
+        // Empty it for another trace, keeping the buffers' capacity
+        void reset(const Element* s) {
+            source = s;
+            segments.clear();
+            hits.clear();
+            touched.clear();
+            counters = TraceCounters{};
+        }
+    };
+
+    // Analysis mode target for traceRay: hits are binned instead of segments being stored
+    struct AnalysisSink {
+        const std::vector<const Element*>* detectors = nullptr;
+        DetectorAccumulator* accumulators = nullptr;   // parallel to *detectors
+        float weight = 1.0f;                            // per-ray share of the source power
+    };
+
+    // Snapshot of the element state that affects tracing, for change detection
+    struct ElementState {
+        std::string id;
+        unsigned int transformGeneration = 0;
+        bool visible = true;
+        glm::vec3 boundsMin{0.0f};
+        glm::vec3 boundsMax{0.0f};
+        OpticalProperties optics;
+        const MeshAsset* mesh = nullptr;    // a streamed-in mesh replaces the placeholder box
     };
 
-    void traceRay(const TraceRay& ray, Scene* scene, const TraceConfig& config,
-                  int depth, std::vector<TraceSegment>& segments);
+    // Rebuild the BVH if the set of traceable elements changed, otherwise refit it, then
+    // compile the interaction records
+    void updateAcceleration(Scene* scene, const TraceConfig& config);
+    // Spectral table for the config, then one InteractionRecord per traceable element
+    void compileRecords(const TraceConfig& config);
+
+    // Primary rays a source emits (one per wavelength and beam-width offset). White light
+    // is emitted as bundles when the config shares spectral paths and allowBundles is set.
+    void collectPrimaryRays(const Element* source, int sourceIndex, const TraceConfig& config,
+                            std::vector<TraceRay>& out, bool allowBundles = true) const;
+    // Primary ray rayIndex of rayCount for analysis traces (Vogel spiral over the beam disk);
+    // 'weight' receives the ray's share of its wavelength's power
+    TraceRay analysisPrimaryRay(const Element* source, int sourceIndex, int rayIndex, int rayCount,
+                                const TraceConfig& config, float& weight) const;
+
+    // Decide what an incremental trace must redo: 'full' for a structural change, otherwise
+    // the sources in 'retrace', whose beams are already cleared. False if nothing changed.
+    bool planRetrace(Scene* scene, const TraceConfig& config, bool& full, std::vector<const Element*>& retrace);
+    // Replace the recorded trace of the same source, or add it. A replaced trace is
+    // swapped into 'trace', so its buffers are reused by the next trace.
+    void storeSourceTrace(SourceTrace& trace);
+
+    // Trace rays[begin, end) in parallel into jobTraces[0, end - begin). raysOfSource
+    // counts the primaries per source index, for the segment budgets.
+    void tracePrimaries(const std::vector<const Element*>& sources, const std::vector<TraceRay>& rays,
+                        const std::vector<int>& raysOfSource, size_t begin, size_t end,
+                        const TraceConfig& config, const std::chrono::steady_clock::time_point* deadline,
+                        std::atomic<bool>& truncated);
+    // Trace the given sources, one result per source in the same order. Primary rays are
+    // traced in parallel into per-job buffers, then merged per source in emission order.
+    void traceSources(const std::vector<const Element*>& sources, const TraceConfig& config,
+                      std::vector<SourceTrace>& out);
+    // Limits for one traceRay call
+    struct RayBudget {
+        int maxSegments = 0;                                        // 0 = unlimited
+        const std::chrono::steady_clock::time_point* deadline = nullptr;
+        std::atomic<bool>* truncated = nullptr;                     // set when a limit is hit
+    };
+
+    // Trace a primary ray and everything it spawns into 'out' (out.source must be set).
+    // With a sink, nothing is stored in 'out' and detector hits go to the accumulators.
+    void traceRay(const TraceRay& primary, const TraceConfig& config, SourceTrace& out,
+                  const AnalysisSink* sink = nullptr, const RayBudget* budget = nullptr) const;
+    // traceRay's stack and merge table, and the wavelength list, per tracing thread
+    struct TraceScratch;
+    static TraceScratch& traceScratch();
+    // Trace every source with the GPU backend; false if it is unavailable
+    bool traceSceneGpu(Scene* scene, const TraceConfig& config);
+    static void emitBeams(Scene* scene, const SourceTrace& trace);
+    // Fill 'stats' from the traced sources
+    void publishStats(const std::vector<SourceTrace>& traces, double wallMs);
+
+    // Record element states and config after a trace
+    void snapshotState(Scene* scene, const TraceConfig& config);
+    static ElementState captureState(const Element* elem);
+    static bool stateMatches(const Element* elem, const ElementState& state);
 
     // Snell's law refraction. Returns false if total internal reflection occurs.
     static bool refract(const glm::vec3& incident, const glm::vec3& normal,
@@ -53,6 +279,51 @@ private:
 
     // Fresnel reflectance (Schlick approximation)
     static float fresnelSchlick(float cosTheta, float n1, float n2);
+
+    // Kept across traceScene calls so unchanged layouts only pay for a refit
+    ElementBVH bvh;
+    std::vector<Element*> traceables;
+    std::vector<InteractionRecord> records;   // per traceable instance (= BVH leaf indices)
+    std::vector<int> firstRecord;             // per traceable, then the record count
+    SpectralTable spectral;                   // white-light wavelengths of the current trace
+
+    TraceWorkers workers;
+    GpuTracer gpu;
+    bool gpuTraced = false;
+    bool traceTruncated = false;
+    TraceStats stats;
+    std::vector<int> gpuSourceSlots;      // GPU source index -> TracedRayBuffer source index
+    std::vector<SourceTrace> jobTraces;   // per primary ray, reused between traces
+    // Working lists of one trace, kept so dragging and auto-trace don't reallocate them
+    std::vector<const Element*> activeSources;
+    std::vector<const Element*> changedElements;
+    std::vector<std::pair<glm::vec3, glm::vec3>> changedBounds;
+    std::vector<const Element*> retraceSources;
+    std::vector<SourceTrace> retraceResults;
+    std::vector<TraceRay> primaryRays;
+    std::vector<int> primaryRaysOfSource;
+    std::vector<std::vector<DetectorAccumulator>> analysisPartials;   // per analysis job
+
+    // Progressive trace in flight: primary rays of 'sources', traced from nextRay on
+    struct ProgressiveJob {
+        bool active = false;
+        bool truncated = false;
+        std::vector<const Element*> sources;
+        std::vector<TraceRay> rays;
+        std::vector<int> raysOfSource;
+        std::vector<SourceTrace> results;   // per source, accumulated as chunks finish
+        size_t nextRay = 0;
+        double wallMs = 0.0;                // summed over the slices so far
+    };
+    ProgressiveJob progressive;
+
+    // Incremental trace state
+    bool hasTraceState = false;
+    TraceConfig lastConfig;
+    std::vector<const Element*> trackedElements;
+    std::vector<ElementState> trackedStates;
+    std::vector<SourceTrace> sourceTraces;
+    size_t tracedBeamCount = 0;
 };
 
 } // namespace opticsketch
@@ -0,0 +1,110 @@
+#include "optics/spectrum.h"
+#include <algorithm>
+#include <cmath>
+
+namespace opticsketch {
+
+static float planck(float wavelength, float temperature) {
+    // Second radiation constant hc/k in meter-kelvin
+    const float c2 = 1.4388e-2f;
+    double x = c2 / (static_cast<double>(wavelength) * temperature);
+    double l = wavelength * 1e6;   // micrometers keep l^5 in float range
+    return static_cast<float>(1.0 / (l * l * l * l * l * std::expm1(x)));
+}
+
+float spectralDensity(SourceSpectrum spectrum, float wavelength) {
+    switch (spectrum) {
+        case SourceSpectrum::Daylight: return planck(wavelength, 6504.0f);
+        case SourceSpectrum::Incandescent: return planck(wavelength, 2856.0f);
+        case SourceSpectrum::Flat:
+        default: return 1.0f;
+    }
+}
+
+void buildSpectralTable(SourceSpectrum spectrum, SpectralSampling sampling, int count, SpectralTable& out) {
+    out = SpectralTable{};
+    out.count = std::clamp(count, 1, kMaxSpectralSamples);
+    const float span = kSpectrumMax - kSpectrumMin;
+
+    if (sampling == SpectralSampling::Importance) {
+        // Tabulated CDF at 1 nm steps, inverted at the centre of each of 'count' strata
+        static constexpr int kSteps = 320;
+        float cdf[kSteps + 1];
+        cdf[0] = 0.0f;
+        for (int s = 0; s < kSteps; s++) {
+            float mid = kSpectrumMin + span * (static_cast<float>(s) + 0.5f) / kSteps;
+            cdf[s + 1] = cdf[s] + spectralDensity(spectrum, mid);
+        }
+        float total = std::max(cdf[kSteps], 1e-30f);
+        int s = 0;
+        for (int i = 0; i < out.count; i++) {
+            float target = total * (static_cast<float>(i) + 0.5f) / static_cast<float>(out.count);
+            while (s < kSteps - 1 && cdf[s + 1] < target) s++;
+            float width = std::max(cdf[s + 1] - cdf[s], 1e-30f);
+            float u = std::clamp((target - cdf[s]) / width, 0.0f, 1.0f);
+            out.wavelength[i] = kSpectrumMin + span * (static_cast<float>(s) + u) / kSteps;
+            out.weight[i] = 1.0f / static_cast<float>(out.count);
+        }
+    } else {
+        float sum = 0.0f;
+        for (int i = 0; i < out.count; i++) {
+            float t = out.count > 1 ? static_cast<float>(i) / static_cast<float>(out.count - 1) : 0.5f;
+            out.wavelength[i] = kSpectrumMin + span * t;
+            out.weight[i] = spectralDensity(spectrum, out.wavelength[i]);
+            sum += out.weight[i];
+        }
+        for (int i = 0; i < out.count; i++) out.weight[i] /= std::max(sum, 1e-30f);
+    }
+
+    glm::vec3 mix(0.0f);
+    for (int i = 0; i < out.count; i++) {
+        out.color[i] = wavelengthToRGB(out.wavelength[i]);
+        mix += out.color[i] * out.weight[i];
+    }
+    float peak = std::max(mix.r, std::max(mix.g, mix.b));
+    out.mixColor = peak > 0.0f ? mix / peak : glm::vec3(1.0f);
+}
+
+// Based on Dan Bruton's approximate CIE algorithm
+glm::vec3 wavelengthToRGB(float wavelength) {
+    float nm = wavelength * 1e9f; // convert to nanometers
+    float r = 0.0f, g = 0.0f, b = 0.0f;
+
+    if (nm >= 380.0f && nm < 440.0f) {
+        r = -(nm - 440.0f) / (440.0f - 380.0f);
+        g = 0.0f;
+        b = 1.0f;
+    } else if (nm >= 440.0f && nm < 490.0f) {
+        r = 0.0f;
+        g = (nm - 440.0f) / (490.0f - 440.0f);
+        b = 1.0f;
+    } else if (nm >= 490.0f && nm < 510.0f) {
+        r = 0.0f;
+        g = 1.0f;
+        b = -(nm - 510.0f) / (510.0f - 490.0f);
+    } else if (nm >= 510.0f && nm < 580.0f) {
+        r = (nm - 510.0f) / (580.0f - 510.0f);
+        g = 1.0f;
+        b = 0.0f;
+    } else if (nm >= 580.0f && nm < 645.0f) {
+        r = 1.0f;
+        g = -(nm - 645.0f) / (645.0f - 580.0f);
+        b = 0.0f;
+    } else if (nm >= 645.0f && nm <= 780.0f) {
+        r = 1.0f;
+        g = 0.0f;
+        b = 0.0f;
+    }
+
+    // Intensity falloff at edges of visible spectrum
+    float factor = 1.0f;
+    if (nm >= 380.0f && nm < 420.0f) {
+        factor = 0.3f + 0.7f * (nm - 380.0f) / (420.0f - 380.0f);
+    } else if (nm >= 700.0f && nm <= 780.0f) {
+        factor = 0.3f + 0.7f * (780.0f - nm) / (780.0f - 700.0f);
+    }
+
+    return glm::vec3(r * factor, g * factor, b * factor);
+}
+
+} // namespace opticsketch
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace opticsketch {
+
+// How white-light sources pick their wavelengths. Uniform spaces them evenly over the
+// visible band and weights each by the source spectrum; Importance places them at equal
+// quantiles of the spectrum (stratified inverse-CDF sampling) so each carries equal power.
+enum class SpectralSampling { Uniform, Importance };
+
+// Spectral power distribution of white-light sources. Daylight is approximated by a
+// 6504 K blackbody, Incandescent is CIE illuminant A (a 2856 K blackbody).
+enum class SourceSpectrum { Flat, Daylight, Incandescent };
+
+static constexpr int kMaxSpectralSamples = 32;
+static constexpr float kLaserWavelength = 633e-9f;   // HeNe red, also the IOR reference
+static constexpr float kSpectrumMin = 380e-9f;   // meters
+static constexpr float kSpectrumMax = 700e-9f;
+
+// Wavelengths a white-light source emits, in ascending order
+struct SpectralTable {
+    int count = 0;
+    float wavelength[kMaxSpectralSamples] = {};   // meters
+    float weight[kMaxSpectralSamples] = {};       // share of the source power, sums to 1
+    glm::vec3 color[kMaxSpectralSamples] = {};
+    glm::vec3 mixColor{1.0f};   // power-weighted sum of the colors, brightest channel 1
+};
+
+// 'count' is clamped to [1, kMaxSpectralSamples]
+void buildSpectralTable(SourceSpectrum spectrum, SpectralSampling sampling, int count, SpectralTable& out);
+
+// Relative spectral power of 'spectrum' at 'wavelength' (meters)
+float spectralDensity(SourceSpectrum spectrum, float wavelength);
+
+// Convert wavelength in meters to visible spectrum RGB color
+glm::vec3 wavelengthToRGB(float wavelength);
+
+} // namespace opticsketch
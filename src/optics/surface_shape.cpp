@@ -0,0 +1,221 @@
+#include "optics/surface_shape.h"
+#include "elements/element.h"
+#include "render/raycast.h"
+#include "render/mesh_store.h"
+#include <algorithm>
+#include <cmath>
+
+namespace opticsketch {
+
+// Radii beyond this are treated as flat
+static constexpr float kFlatRadius = 1e6f;
+
+static SurfaceConstraint plane(const glm::vec3& point, const glm::vec3& normal) {
+    SurfaceConstraint c;
+    c.type = SurfaceConstraint::Plane;
+    c.point = point;
+    c.normal = normal;
+    return c;
+}
+
+static SurfaceConstraint sphere(const glm::vec3& center, float radius, bool inside) {
+    SurfaceConstraint c;
+    c.type = SurfaceConstraint::Sphere;
+    c.point = center;
+    c.radius = radius;
+    c.inside = inside;
+    return c;
+}
+
+static SurfaceConstraint cylinder(const glm::vec2& axis, float radius) {
+    SurfaceConstraint c;
+    c.type = SurfaceConstraint::Cylinder;
+    c.point = glm::vec3(axis, 0.0f);
+    c.radius = radius;
+    return c;
+}
+
+// Signed sag of a spherical surface of radius R at height r (positive R bends toward +Z)
+static float sag(float R, float r) {
+    float h = std::min(r, std::abs(R));
+    return R - std::copysign(std::sqrt(std::max(0.0f, R * R - h * h)), R);
+}
+
+static bool isFlat(float R) { return R == 0.0f || std::abs(R) > kFlatRadius; }
+
+static void addSlab(SurfaceShape& out) {
+    out.constraints[out.constraintCount++] = plane(out.boundsMin, glm::vec3(0.0f, 0.0f, -1.0f));
+    out.constraints[out.constraintCount++] = plane(out.boundsMax, glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+static void buildLens(const OpticalProperties& optics, SurfaceShape& out) {
+    glm::vec2 axis = glm::vec2(out.boundsMin + out.boundsMax) * 0.5f;
+    glm::vec2 half = glm::vec2(out.boundsMax - out.boundsMin) * 0.5f;
+    float rim = std::min(half.x, half.y);
+    float R1 = optics.curvatureR1, R2 = optics.curvatureR2;
+
+    // Vertices are placed so each cap stays inside the bounds out to the rim
+    float v1 = out.boundsMin.z - (isFlat(R1) ? 0.0f : std::min(0.0f, sag(R1, rim)));
+    float v2 = out.boundsMax.z - (isFlat(R2) ? 0.0f : std::max(0.0f, sag(R2, rim)));
+    if (v1 >= v2) return;   // caps overlap: keep the box
+
+    out.kind = SurfaceKind::Lens;
+    addSlab(out);
+    out.constraints[out.constraintCount++] = cylinder(axis, rim);
+    // Front: glass on the +Z side, so inside a sphere centred ahead of the vertex
+    if (!isFlat(R1))
+        out.constraints[out.constraintCount++] = sphere(glm::vec3(axis, v1 + R1), std::abs(R1), R1 > 0.0f);
+    // Back: glass on the -Z side
+    if (!isFlat(R2))
+        out.constraints[out.constraintCount++] = sphere(glm::vec3(axis, v2 + R2), std::abs(R2), R2 < 0.0f);
+}
+
+static void buildPrism(bool rightAngle, SurfaceShape& out) {
+    const glm::vec3& lo = out.boundsMin;
+    const glm::vec3& hi = out.boundsMax;
+    // Counter-clockwise, matching the viewport meshes: apex up, or the right angle at -X -Y
+    glm::vec2 tri[3] = {
+        glm::vec2(lo.x, lo.y),
+        glm::vec2(hi.x, lo.y),
+        rightAngle ? glm::vec2(lo.x, hi.y) : glm::vec2((lo.x + hi.x) * 0.5f, hi.y)
+    };
+    out.kind = SurfaceKind::Prism;
+    addSlab(out);
+    for (int i = 0; i < 3; i++) {
+        glm::vec2 edge = tri[(i + 1) % 3] - tri[i];
+        float len = glm::length(edge);
+        if (len < 1e-9f) continue;
+        glm::vec3 normal(edge.y / len, -edge.x / len, 0.0f);
+        out.constraints[out.constraintCount++] = plane(glm::vec3(tri[i], 0.0f), normal);
+    }
+}
+
+static void buildDisc(SurfaceShape& out) {
+    glm::vec2 axis = glm::vec2(out.boundsMin + out.boundsMax) * 0.5f;
+    glm::vec2 half = glm::vec2(out.boundsMax - out.boundsMin) * 0.5f;
+    out.kind = SurfaceKind::Disc;
+    addSlab(out);
+    out.constraints[out.constraintCount++] = cylinder(axis, std::min(half.x, half.y));
+}
+
+void buildSurfaceShape(const Element* element, SurfaceShape& out) {
+    out = SurfaceShape{};
+    out.boundsMin = element->boundsMin;
+    out.boundsMax = element->boundsMax;
+    if (element->type == ElementType::ImportedMesh) {
+        // Placeholders still streaming in keep the box
+        if (element->mesh && !element->mesh->bvh.empty()) {
+            out.kind = SurfaceKind::Mesh;
+            out.mesh = &element->mesh->bvh;
+        }
+        return;
+    }
+    switch (element->optics.opticalType) {
+        case OpticalType::Lens: buildLens(element->optics, out); break;
+        case OpticalType::Prism: buildPrism(element->type == ElementType::PrismRA, out); break;
+        case OpticalType::Aperture: buildDisc(out); break;
+        default: break;
+    }
+}
+
+// Signed distance-like value: <= 0 inside the constraint
+static float constraintValue(const SurfaceConstraint& c, const glm::vec3& p) {
+    switch (c.type) {
+        case SurfaceConstraint::Plane: return glm::dot(c.normal, p - c.point);
+        case SurfaceConstraint::Sphere: {
+            float d = glm::length(p - c.point) - c.radius;
+            return c.inside ? d : -d;
+        }
+        case SurfaceConstraint::Cylinder:
+        default: return glm::length(glm::vec2(p) - glm::vec2(c.point)) - c.radius;
+    }
+}
+
+static glm::vec3 constraintNormal(const SurfaceConstraint& c, const glm::vec3& p) {
+    switch (c.type) {
+        case SurfaceConstraint::Plane: return c.normal;
+        case SurfaceConstraint::Sphere: {
+            glm::vec3 n = (p - c.point) / c.radius;
+            return c.inside ? n : -n;
+        }
+        case SurfaceConstraint::Cylinder:
+        default: return glm::vec3((glm::vec2(p) - glm::vec2(c.point)) / c.radius, 0.0f);
+    }
+}
+
+// Ray parameters where the ray crosses the constraint's surface; returns the count (0-2)
+static int constraintRoots(const SurfaceConstraint& c, const glm::vec3& o, const glm::vec3& d, float roots[2]) {
+    if (c.type == SurfaceConstraint::Plane) {
+        float denom = glm::dot(c.normal, d);
+        if (std::abs(denom) < 1e-12f) return 0;
+        roots[0] = glm::dot(c.normal, c.point - o) / denom;
+        return 1;
+    }
+    glm::vec3 oc = o - c.point;
+    glm::vec3 dir = d;
+    if (c.type == SurfaceConstraint::Cylinder) {
+        oc.z = 0.0f;
+        dir.z = 0.0f;
+    }
+    float a = glm::dot(dir, dir);
+    if (a < 1e-12f) return 0;
+    float b = glm::dot(oc, dir);
+    float disc = b * b - a * (glm::dot(oc, oc) - c.radius * c.radius);
+    if (disc < 0.0f) return 0;
+    float s = std::sqrt(disc);
+    roots[0] = (-b - s) / a;
+    roots[1] = (-b + s) / a;
+    return 2;
+}
+
+bool intersectSurface(const SurfaceShape& shape, const glm::vec3& origin, const glm::vec3& direction,
+                      float tMin, float tMax, float& t, glm::vec3& normal, bool& exiting, int& tests) {
+    if (shape.kind == SurfaceKind::Mesh) {
+        if (!shape.mesh->intersect(origin, direction, tMin, tMax, t, normal, tests)) return false;
+        // Closed meshes wind counter-clockwise seen from outside
+        exiting = glm::dot(normal, direction) > 0.0f;
+        return true;
+    }
+    tests++;
+    if (shape.kind == SurfaceKind::Box) {
+        // Fast path: the slab test already finds the exit face for rays inside the box
+        Raycast::Ray ray{origin, direction};
+        if (!Raycast::intersectAABBWithNormal(ray, shape.boundsMin, shape.boundsMax, t, normal)) return false;
+        if (t <= tMin || t >= tMax) return false;
+        exiting = glm::dot(normal, direction) > 0.0f;
+        return true;
+    }
+
+    // Every crossing of a constraint surface, nearest first; the first one lying on the
+    // boundary of the solid (all other constraints hold there) is the hit
+    struct Candidate { float t; int constraint; };
+    Candidate candidates[SurfaceShape::kMaxConstraints * 2];
+    int count = 0;
+    for (int i = 0; i < shape.constraintCount; i++) {
+        float roots[2];
+        int n = constraintRoots(shape.constraints[i], origin, direction, roots);
+        for (int r = 0; r < n; r++) {
+            if (roots[r] > tMin && roots[r] < tMax) candidates[count++] = {roots[r], i};
+        }
+    }
+    std::sort(candidates, candidates + count, [](const Candidate& a, const Candidate& b) { return a.t < b.t; });
+
+    glm::vec3 extent = shape.boundsMax - shape.boundsMin;
+    float tolerance = 1e-4f * std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f));
+    for (int k = 0; k < count; k++) {
+        glm::vec3 p = origin + direction * candidates[k].t;
+        bool onBoundary = true;
+        for (int i = 0; i < shape.constraintCount && onBoundary; i++) {
+            if (i != candidates[k].constraint && constraintValue(shape.constraints[i], p) > tolerance)
+                onBoundary = false;
+        }
+        if (!onBoundary) continue;
+        t = candidates[k].t;
+        normal = constraintNormal(shape.constraints[candidates[k].constraint], p);
+        exiting = glm::dot(normal, direction) > 0.0f;
+        return true;
+    }
+    return false;
+}
+
+} // namespace opticsketch
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace opticsketch {
+
+class Element;
+class MeshBVH;
+
+// Exact local-space geometry of an element, the narrow phase behind the BVH's box test.
+// Lenses are two spherical caps (curvatureR1 facing -Z, curvatureR2 facing +Z) inside a
+// cylinder about local Z, prisms their triangle in local XY extruded along Z, apertures
+// a disc, and imported meshes their triangles (through the asset's MeshBVH, whatever
+// their optical type). Everything else, and lenses whose caps don't fit their bounds,
+// is the box.
+enum class SurfaceKind { Box, Lens, Prism, Disc, Mesh };
+
+// One bounding surface. The solid is where every constraint holds.
+struct SurfaceConstraint {
+    enum Type { Plane, Sphere, Cylinder };
+    Type type = Plane;
+    bool inside = true;         // Sphere: solid inside (true) or outside the sphere
+    glm::vec3 point{0.0f};      // Plane: a point on it; Sphere/Cylinder: center (axis along Z)
+    glm::vec3 normal{0.0f};     // Plane: outward normal
+    float radius = 0.0f;
+};
+
+struct SurfaceShape {
+    static constexpr int kMaxConstraints = 6;
+
+    SurfaceKind kind = SurfaceKind::Box;
+    glm::vec3 boundsMin{0.0f};
+    glm::vec3 boundsMax{0.0f};
+    SurfaceConstraint constraints[kMaxConstraints];
+    int constraintCount = 0;
+    const MeshBVH* mesh = nullptr;  // Mesh: owned by the element's MeshAsset
+};
+
+// Shape for the element's optical type and local bounds
+void buildSurfaceShape(const Element* element, SurfaceShape& out);
+
+// Closest surface crossing with tMin < t < tMax for a local-space ray (direction need not
+// be normalized; t is in its units). 'normal' is the outward local normal; 'exiting' is
+// set when the ray leaves the solid there, i.e. it started inside. 'tests' is incremented
+// by the primitive tests run (triangles for meshes, otherwise one).
+bool intersectSurface(const SurfaceShape& shape, const glm::vec3& origin, const glm::vec3& direction,
+                      float tMin, float tMax, float& t, glm::vec3& normal, bool& exiting, int& tests);
+
+} // namespace opticsketch
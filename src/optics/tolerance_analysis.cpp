@@ -0,0 +1,259 @@
+#include "optics/tolerance_analysis.h"
+#include "optics/trace_workers.h"
+#include "scene/scene.h"
+#include "elements/element.h"
+#include "export/text_writer.h"
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+namespace opticsketch {
+
+static const char* const kToleranceParameterNames[kToleranceParameterCount] = {
+    "posX", "posY", "posZ", "tiltX", "tiltY", "tiltZ", "focalLength", "ior", "reflectivity", "transmissivity"
+};
+
+const char* toleranceParameterName(ToleranceParameter parameter) {
+    int index = static_cast<int>(parameter);
+    return index >= 0 && index < kToleranceParameterCount ? kToleranceParameterNames[index] : "";
+}
+
+bool parseToleranceParameter(const std::string& name, ToleranceParameter& out) {
+    for (int i = 0; i < kToleranceParameterCount; i++) {
+        if (name == kToleranceParameterNames[i]) {
+            out = static_cast<ToleranceParameter>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// SplitMix64: tiny state, so every sample gets its own stream seeded from its index
+struct SampleRng {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [0, 1)
+    float uniform() { return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f); }
+    // Standard normal (Box-Muller)
+    float gaussian() {
+        float u1 = std::max(uniform(), 1e-7f);
+        float u2 = uniform();
+        return std::sqrt(-2.0f * std::log(u1)) * std::cos(6.28318531f * u2);
+    }
+};
+
+static float drawDelta(SampleRng& rng, const ToleranceSpec& spec) {
+    if (spec.distribution == ToleranceDistribution::Gaussian) return rng.gaussian() * spec.amount;
+    return (rng.uniform() * 2.0f - 1.0f) * spec.amount;
+}
+
+static void applyTolerance(Element* element, ToleranceParameter parameter, float delta) {
+    auto tilt = [element](const glm::vec3& axis, float degrees) {
+        element->transform.rotation = element->transform.rotation * glm::angleAxis(glm::radians(degrees), axis);
+    };
+    OpticalProperties& optics = element->optics;
+    switch (parameter) {
+        case ToleranceParameter::PositionX: element->transform.position.x += delta; break;
+        case ToleranceParameter::PositionY: element->transform.position.y += delta; break;
+        case ToleranceParameter::PositionZ: element->transform.position.z += delta; break;
+        case ToleranceParameter::TiltX: tilt(glm::vec3(1.0f, 0.0f, 0.0f), delta); break;
+        case ToleranceParameter::TiltY: tilt(glm::vec3(0.0f, 1.0f, 0.0f), delta); break;
+        case ToleranceParameter::TiltZ: tilt(glm::vec3(0.0f, 0.0f, 1.0f), delta); break;
+        case ToleranceParameter::FocalLength: optics.focalLength += delta; break;
+        case ToleranceParameter::Ior: optics.ior = std::max(1.0f, optics.ior + delta); break;
+        case ToleranceParameter::Reflectivity: optics.reflectivity = std::clamp(optics.reflectivity + delta, 0.0f, 1.0f); break;
+        case ToleranceParameter::Transmissivity: optics.transmissivity = std::clamp(optics.transmissivity + delta, 0.0f, 1.0f); break;
+    }
+    element->markTransformDirty();
+}
+
+// Throughput and local centroid per detector from the hits of the last trace
+static void measureDetectors(const TracedRayBuffer& traced, const std::vector<const Element*>& detectors,
+                             float* throughput, glm::vec2* centroid) {
+    const DetectorHitBuffer& hits = traced.hits;
+    // Hit buffer detector index -> slot in 'detectors' (-1 = not measured)
+    std::vector<int> slot(hits.detectorIds.size(), -1);
+    for (size_t i = 0; i < hits.detectorIds.size(); i++) {
+        for (size_t d = 0; d < detectors.size(); d++) {
+            if (detectors[d]->id == hits.detectorIds[i]) slot[i] = static_cast<int>(d);
+        }
+    }
+    std::vector<glm::vec3> sums(detectors.size(), glm::vec3(0.0f));   // x*w, y*w, w
+    for (size_t i = 0; i < hits.size(); i++) {
+        int d = slot[hits.detector[i]];
+        if (d < 0) continue;
+        float w = hits.intensity[i];
+        sums[d] += glm::vec3(hits.local[i].x * w, hits.local[i].y * w, w);
+    }
+    for (size_t d = 0; d < detectors.size(); d++) {
+        throughput[d] = sums[d].z;
+        centroid[d] = sums[d].z > 0.0f ? glm::vec2(sums[d].x, sums[d].y) / sums[d].z : glm::vec2(0.0f);
+    }
+}
+
+bool runToleranceAnalysis(const Scene* scene, const ToleranceSettings& settings, ToleranceResult& out) {
+    out = ToleranceResult{};
+    if (!scene || settings.samples < 1) return false;
+
+    for (const ToleranceSpec& spec : settings.specs) {
+        bool found = std::any_of(scene->getElements().begin(), scene->getElements().end(),
+            [&spec](const std::unique_ptr<Element>& e) { return e->id == spec.elementId; });
+        if (!found) {
+            std::cerr << "Tolerance element not found: " << spec.elementId << "\n";
+            return false;
+        }
+    }
+    std::vector<std::string> detectorIds;
+    for (const auto& e : scene->getElements()) {
+        if (e->type != ElementType::Detector && e->type != ElementType::Screen) continue;
+        if (!settings.detectorId.empty() && e->id != settings.detectorId) continue;
+        detectorIds.push_back(e->id);
+        ToleranceDetectorStats stats;
+        stats.detectorId = e->id;
+        stats.label = e->label;
+        out.detectors.push_back(stats);
+    }
+    if (detectorIds.empty()) {
+        std::cerr << "Tolerance analysis needs a Detector or Screen\n";
+        return false;
+    }
+
+    const size_t detectorCount = detectorIds.size();
+    const int sampleCount = settings.samples;
+    out.samples = sampleCount;
+    out.throughput.assign(static_cast<size_t>(sampleCount) * detectorCount, 0.0f);
+    out.centroid.assign(static_cast<size_t>(sampleCount) * detectorCount, glm::vec2(0.0f));
+
+    // Worker threads run on their own scene copies; GL is only available on the main thread
+    TraceConfig config = settings.trace;
+    config.backend = TraceBackend::Cpu;
+    config.threadCount = 1;
+
+    // Nominal reference
+    std::vector<float> nominalThroughput(detectorCount);
+    std::vector<glm::vec2> nominalCentroid(detectorCount);
+    {
+        std::unique_ptr<Scene> copy = scene->snapshot();
+        std::vector<const Element*> detectors;
+        for (const std::string& id : detectorIds) detectors.push_back(copy->getElement(id));
+        RayTracer tracer;
+        tracer.traceScene(copy.get(), config);
+        measureDetectors(copy->getTracedRays(), detectors, nominalThroughput.data(), nominalCentroid.data());
+    }
+
+    int workerCount = std::min(TraceWorkers::resolveThreadCount(settings.threadCount), sampleCount);
+    std::atomic<int> nextSample{0};
+    auto runWorker = [&](int) {
+        std::unique_ptr<Scene> copy = scene->snapshot();
+        std::vector<Element*> targets;
+        std::vector<Transform> nominalTransforms;
+        std::vector<OpticalProperties> nominalOptics;
+        for (const ToleranceSpec& spec : settings.specs) {
+            Element* e = copy->getElement(spec.elementId);
+            targets.push_back(e);
+            nominalTransforms.push_back(e->transform);
+            nominalOptics.push_back(e->optics);
+        }
+        std::vector<const Element*> detectors;
+        for (const std::string& id : detectorIds) detectors.push_back(copy->getElement(id));
+
+        // The element set never changes, so after the first sample the BVH is only refitted
+        RayTracer tracer;
+        for (int s = nextSample++; s < sampleCount; s = nextSample++) {
+            for (size_t i = 0; i < targets.size(); i++) {
+                targets[i]->transform = nominalTransforms[i];
+                targets[i]->markTransformDirty();
+                targets[i]->optics = nominalOptics[i];
+            }
+            SampleRng rng{settings.seed * 0x2545F4914F6CDD1Dull + static_cast<uint64_t>(s)};
+            for (size_t i = 0; i < targets.size(); i++)
+                applyTolerance(targets[i], settings.specs[i].parameter, drawDelta(rng, settings.specs[i]));
+            tracer.traceScene(copy.get(), config);
+            size_t row = static_cast<size_t>(s) * detectorCount;
+            measureDetectors(copy->getTracedRays(), detectors, &out.throughput[row], &out.centroid[row]);
+        }
+    };
+    TraceWorkers pool;
+    pool.parallelFor(workerCount, workerCount, runWorker);
+
+    for (size_t d = 0; d < detectorCount; d++) {
+        ToleranceDetectorStats& stats = out.detectors[d];
+        stats.nominalThroughput = nominalThroughput[d];
+        stats.nominalCentroid = nominalCentroid[d];
+        stats.minThroughput = out.throughput[d];
+        stats.maxThroughput = out.throughput[d];
+
+        double sum = 0.0, sumSq = 0.0, driftSum = 0.0, driftSq = 0.0;
+        std::vector<float> drifts;
+        drifts.reserve(sampleCount);
+        for (int s = 0; s < sampleCount; s++) {
+            size_t i = static_cast<size_t>(s) * detectorCount + d;
+            float t = out.throughput[i];
+            sum += t;
+            sumSq += static_cast<double>(t) * t;
+            stats.minThroughput = std::min(stats.minThroughput, t);
+            stats.maxThroughput = std::max(stats.maxThroughput, t);
+            if (t <= 0.0f) {
+                stats.missedSamples++;
+                continue;
+            }
+            float drift = glm::length(out.centroid[i] - nominalCentroid[d]);
+            driftSum += drift;
+            driftSq += static_cast<double>(drift) * drift;
+            drifts.push_back(drift);
+        }
+        double mean = sum / sampleCount;
+        stats.meanThroughput = static_cast<float>(mean);
+        stats.stdThroughput = static_cast<float>(std::sqrt(std::max(0.0, sumSq / sampleCount - mean * mean)));
+        if (!drifts.empty()) {
+            stats.meanDrift = static_cast<float>(driftSum / drifts.size());
+            stats.rmsDrift = static_cast<float>(std::sqrt(driftSq / drifts.size()));
+            size_t p95 = std::min(drifts.size() - 1, drifts.size() * 95 / 100);
+            std::nth_element(drifts.begin(), drifts.begin() + p95, drifts.end());
+            stats.p95Drift = drifts[p95];
+            stats.maxDrift = *std::max_element(drifts.begin(), drifts.end());
+        }
+    }
+    return true;
+}
+
+bool exportToleranceCsv(const std::string& path, const ToleranceResult& result) {
+    TextWriter out;
+    if (!out.open(path)) return false;
+
+    out << "sample";
+    for (const ToleranceDetectorStats& d : result.detectors) {
+        // Labels are user text: quote them, doubling embedded quotes
+        std::string quoted;
+        for (char c : d.label) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        out << ",\"" << quoted << ".throughput\",\"" << quoted << ".x\",\"" << quoted << ".y\"";
+    }
+    out << '\n';
+
+    const size_t detectorCount = result.detectors.size();
+    for (int s = 0; s < result.samples; s++) {
+        out << s;
+        for (size_t d = 0; d < detectorCount; d++) {
+            size_t i = static_cast<size_t>(s) * detectorCount + d;
+            out << ',' << GeneralNumber{result.throughput[i]}
+                << ',' << GeneralNumber{result.centroid[i].x}
+                << ',' << GeneralNumber{result.centroid[i].y};
+        }
+        out << '\n';
+    }
+    return out.close();
+}
+
+} // namespace opticsketch
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "optics/ray_tracer.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+class Scene;
+
+// Perturbations applied on top of an element's nominal state. Tilts are in degrees about
+// the element's local axes, positions in mm, optical values in their own units.
+enum class ToleranceParameter { PositionX, PositionY, PositionZ, TiltX, TiltY, TiltZ,
+                                FocalLength, Ior, Reflectivity, Transmissivity };
+
+static constexpr int kToleranceParameterCount = 10;
+
+enum class ToleranceDistribution { Uniform, Gaussian };
+
+const char* toleranceParameterName(ToleranceParameter parameter);
+bool parseToleranceParameter(const std::string& name, ToleranceParameter& out);
+
+struct ToleranceSpec {
+    std::string elementId;
+    ToleranceParameter parameter = ToleranceParameter::PositionX;
+    ToleranceDistribution distribution = ToleranceDistribution::Uniform;
+    float amount = 0.1f;        // half-width (Uniform) or standard deviation (Gaussian)
+};
+
+struct ToleranceSettings {
+    std::vector<ToleranceSpec> specs;
+    int samples = 1000;
+    uint64_t seed = 1;          // a run is reproducible for a given seed, whatever the thread count
+    std::string detectorId;     // empty = every Detector and Screen
+    TraceConfig trace;          // always traced on the CPU, one thread per sample
+    int threadCount = 0;        // samples traced at once (0 = hardware concurrency)
+};
+
+// Statistics of one detector over all samples. Throughput is the summed hit intensity;
+// drift is the distance of the sample's spot centroid (local XY) from the nominal one.
+struct ToleranceDetectorStats {
+    std::string detectorId;
+    std::string label;
+    float nominalThroughput = 0.0f;
+    glm::vec2 nominalCentroid{0.0f};
+    float meanThroughput = 0.0f;
+    float stdThroughput = 0.0f;
+    float minThroughput = 0.0f;
+    float maxThroughput = 0.0f;
+    float meanDrift = 0.0f;
+    float rmsDrift = 0.0f;
+    float p95Drift = 0.0f;
+    float maxDrift = 0.0f;
+    int missedSamples = 0;      // samples where no light reached the detector
+};
+
+struct ToleranceResult {
+    std::vector<ToleranceDetectorStats> detectors;
+    // Per sample and detector (sample-major): throughput and centroid
+    std::vector<float> throughput;
+    std::vector<glm::vec2> centroid;
+    int samples = 0;
+};
+
+// Trace the nominal layout once, then settings.samples perturbed copies in parallel. Each
+// worker owns a scene snapshot and a tracer whose BVH is only refitted between samples.
+// Returns false if a spec names a missing element or there is no detector.
+bool runToleranceAnalysis(const Scene* scene, const ToleranceSettings& settings, ToleranceResult& out);
+
+// One row per sample with throughput and centroid columns for every detector
+bool exportToleranceCsv(const std::string& path, const ToleranceResult& result);
+
+} // namespace opticsketch
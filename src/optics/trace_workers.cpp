@@ -0,0 +1,14 @@
+#include "optics/trace_workers.h"
+#include "jobs/job_system.h"
+
+namespace opticsketch {
+
+int TraceWorkers::resolveThreadCount(int requested) {
+    return JobSystem::resolveThreadCount(requested);
+}
+
+void TraceWorkers::parallelFor(int jobCount, int threadCount, const std::function<void(int)>& fn) {
+    JobSystem::instance().parallelFor(jobCount, threadCount, fn);
+}
+
+} // namespace opticsketch
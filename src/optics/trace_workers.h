@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+
+namespace opticsketch {
+
+// The ray tracer's fork-join front end. Batches run on the shared JobSystem pool, so
+// tracing competes fairly with imports and exports instead of owning its own threads;
+// the calling thread participates and the call blocks until all jobs are done.
+class TraceWorkers {
+public:
+    // Run fn(jobIndex) for jobIndex in [0, jobCount) on up to threadCount threads.
+    // threadCount <= 0 uses the hardware concurrency.
+    void parallelFor(int jobCount, int threadCount, const std::function<void(int)>& fn);
+
+    static int resolveThreadCount(int requested);
+};
+
+} // namespace opticsketch
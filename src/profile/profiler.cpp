@@ -0,0 +1,236 @@
+#include "profile/profiler.h"
+#include "export/text_writer.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+
+namespace opticsketch {
+
+// Chrome trace track for GPU passes
+static constexpr int kGpuTrack = 1000;
+
+static const char* const kCounterNames[Profiler::kCounterCount] = {
+    "Draw calls", "Buffer uploads", "Upload bytes", "Traced rays", "Traced segments"
+};
+
+const char* Profiler::counterName(Counter counter) {
+    return kCounterNames[counter];
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() {
+    for (auto& c : counters) c.store(0);
+    epochNs = nowNs();
+}
+
+int64_t Profiler::nowNs() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() - epochNs;
+}
+
+int Profiler::threadIndex() {
+    static std::atomic<int> nextThread{0};
+    thread_local int index = nextThread++;
+    return index;
+}
+
+// Open scopes of the calling thread
+struct OpenScope {
+    const char* name;
+    int64_t startNs;
+};
+
+static std::vector<OpenScope>& openScopes() {
+    thread_local std::vector<OpenScope> stack;
+    return stack;
+}
+
+void Profiler::beginScope(const char* name) {
+    if (!enabled) return;
+    openScopes().push_back({name, nowNs()});
+}
+
+void Profiler::endScope() {
+    std::vector<OpenScope>& stack = openScopes();
+    // Scopes opened before the profiler was enabled have nothing to close
+    if (stack.empty()) return;
+    OpenScope scope = stack.back();
+    stack.pop_back();
+    ScopeEvent event{scope.name, threadIndex(), static_cast<int>(stack.size()), scope.startNs, nowNs()};
+    std::lock_guard<std::mutex> lock(eventMutex);
+    frameEvents.push_back(event);
+}
+
+void Profiler::beginGpuPass(const char* name) {
+    // Queries belong to the main context; passes on the render thread are not timed
+    if (!enabled || threadIndex() != mainThread) return;
+    if (gpuPassOpen) {
+        gpuPassDepth++;
+        return;
+    }
+    GpuFrame& frame = gpuFrames[gpuFrameIndex];
+    if (frame.passCount >= kMaxGpuPasses) return;
+    if (!queriesCreated) {
+        for (auto& f : gpuFrames) glGenQueries(kMaxGpuPasses, f.queries);
+        queriesCreated = true;
+    }
+    int pass = frame.passCount++;
+    frame.names[pass] = name;
+    frame.issuedNs[pass] = nowNs();
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[pass]);
+    gpuPassOpen = true;
+}
+
+void Profiler::endGpuPass() {
+    if (threadIndex() != mainThread || !gpuPassOpen) return;
+    if (gpuPassDepth > 0) {
+        gpuPassDepth--;
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuPassOpen = false;
+}
+
+bool Profiler::resolveGpuFrame(GpuFrame& frame) {
+    if (!frame.pending) return true;
+    if (frame.passCount > 0) {
+        // Queries finish in order, so the last one being ready means all are
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[frame.passCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return false;
+    }
+    last.gpuPasses.clear();
+    for (int i = 0; i < frame.passCount; i++) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+        last.gpuPasses.push_back({frame.names[i], static_cast<double>(elapsed) * 1e-6});
+        if (frame.captured) {
+            captureGpuEvents.push_back({frame.names[i], kGpuTrack, 0, frame.issuedNs[i],
+                                        frame.issuedNs[i] + static_cast<int64_t>(elapsed)});
+        }
+    }
+    frame.pending = false;
+    return true;
+}
+
+void Profiler::beginFrame() {
+    if (!enabled && captureFramesLeft <= 0) return;
+    enabled = true;
+    mainThread = threadIndex();
+    frameStartNs = nowNs();
+    for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(eventMutex);
+    frameEvents.clear();
+}
+
+void Profiler::endFrame() {
+    if (!enabled) return;
+    int64_t endNs = nowNs();
+    if (gpuPassOpen) {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuPassOpen = false;
+        gpuPassDepth = 0;
+    }
+
+    last.frameMs = static_cast<double>(endNs - frameStartNs) * 1e-6;
+    for (int i = 0; i < kCounterCount; i++) last.counters[i] = counters[i].load(std::memory_order_relaxed);
+    history[historyNext] = static_cast<float>(last.frameMs);
+    historyNext = (historyNext + 1) % kHistoryFrames;
+    historyCount = std::min(historyCount + 1, kHistoryFrames);
+
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        // Scopes close innermost first; call order is start order
+        std::sort(frameEvents.begin(), frameEvents.end(),
+            [](const ScopeEvent& a, const ScopeEvent& b) { return a.startNs < b.startNs; });
+        last.scopes.clear();
+        for (const ScopeEvent& e : frameEvents) {
+            if (e.thread == mainThread)
+                last.scopes.push_back({e.name, e.depth, static_cast<double>(e.endNs - e.startNs) * 1e-6});
+        }
+        if (captureFramesLeft > 0) {
+            captureEvents.insert(captureEvents.end(), frameEvents.begin(), frameEvents.end());
+            CounterSample sample;
+            sample.timeNs = frameStartNs;
+            std::copy(last.counters, last.counters + kCounterCount, sample.values);
+            captureCounters.push_back(sample);
+        }
+    }
+
+    // Hand this frame's queries to the GPU, then read back the oldest frame in flight
+    GpuFrame& current = gpuFrames[gpuFrameIndex];
+    current.pending = current.passCount > 0;
+    current.captured = captureFramesLeft > 0;
+    gpuFrameIndex = (gpuFrameIndex + 1) % kGpuFramesInFlight;
+    GpuFrame& next = gpuFrames[gpuFrameIndex];
+    if (!resolveGpuFrame(next)) next.pending = false;   // GPU is far behind; drop it rather than stall
+    next.passCount = 0;
+
+    if (captureFramesLeft > 0) captureFramesLeft--;
+}
+
+void Profiler::frameHistory(std::vector<float>& out) const {
+    out.clear();
+    int start = (historyNext - historyCount + kHistoryFrames) % kHistoryFrames;
+    for (int i = 0; i < historyCount; i++) out.push_back(history[(start + i) % kHistoryFrames]);
+}
+
+void Profiler::startCapture(int frames) {
+    captureEvents.clear();
+    captureGpuEvents.clear();
+    captureCounters.clear();
+    captureFramesLeft = std::max(1, frames);
+    captureStartNs = nowNs();
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    TextWriter out;
+    if (!out.open(path)) return false;
+
+    // Timestamps and durations are in microseconds from the start of the capture. Names
+    // are string literals from the instrumentation, so they need no escaping.
+    bool first = true;
+    auto separator = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    auto writeEvent = [&](const ScopeEvent& e) {
+        separator();
+        out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+            << ",\"ts\":" << static_cast<int>((e.startNs - captureStartNs) / 1000)
+            << ",\"dur\":" << FixedNumber{static_cast<float>(e.endNs - e.startNs) * 1e-3f, 3} << '}';
+    };
+
+    out << "{\"traceEvents\":[";
+    separator();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << kGpuTrack
+        << ",\"args\":{\"name\":\"GPU\"}}";
+    for (const ScopeEvent& e : captureEvents) writeEvent(e);
+    for (const ScopeEvent& e : captureGpuEvents) writeEvent(e);
+    for (const CounterSample& s : captureCounters) {
+        for (int i = 0; i < kCounterCount; i++) {
+            separator();
+            out << "{\"name\":\"" << kCounterNames[i] << "\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+                << static_cast<int>((s.timeNs - captureStartNs) / 1000)
+                << ",\"args\":{\"value\":" << GeneralNumber{static_cast<float>(s.values[i])} << "}}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.close();
+}
+
+void Profiler::cleanup() {
+    if (!queriesCreated) return;
+    for (auto& f : gpuFrames) {
+        glDeleteQueries(kMaxGpuPasses, f.queries);
+        f.pending = false;
+        f.passCount = 0;
+    }
+    queriesCreated = false;
+}
+
+} // namespace opticsketch
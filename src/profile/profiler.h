@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+// Frame profiler: nested CPU scopes, GPU pass times from GL_TIME_ELAPSED queries and
+// per-frame counters, shown by the profiler panel and dumpable as a Chrome trace
+// (chrome://tracing, Perfetto). Instrument code with the OPTICSKETCH_PROFILE_* macros
+// below; they compile to nothing unless OPTICSKETCH_PROFILE is defined (Debug builds,
+// or configure with -DOPTICSKETCH_PROFILING=ON). Nothing is recorded while disabled.
+class Profiler {
+public:
+    enum Counter { DrawCalls, BufferUploads, UploadBytes, TracedRays, TracedSegments };
+    static constexpr int kCounterCount = 5;
+    static const char* counterName(Counter counter);
+
+    struct ScopeTiming {
+        const char* name;
+        int depth;
+        double ms;
+    };
+    struct PassTiming {
+        const char* name;
+        double ms;
+    };
+    // The last finished frame; GPU passes are from an older frame, since their queries are
+    // only read once the GPU is done with them
+    struct FrameStats {
+        double frameMs = 0.0;
+        std::vector<ScopeTiming> scopes;    // main thread, in call order
+        std::vector<PassTiming> gpuPasses;
+        int64_t counters[kCounterCount] = {};
+    };
+
+    static constexpr int kHistoryFrames = 240;
+
+    static Profiler& instance();
+
+    void setEnabled(bool on) { enabled = on; }
+    bool isEnabled() const { return enabled; }
+
+    // Frame boundaries, on the thread that owns the GL context
+    void beginFrame();
+    void endFrame();
+
+    // CPU scopes nest per thread; any thread may record them
+    void beginScope(const char* name);
+    void endScope();
+
+    // GPU passes must not nest (GL allows one GL_TIME_ELAPSED query at a time); an inner
+    // pass is ignored. Main thread only; passes issued elsewhere (the render thread) are
+    // ignored.
+    void beginGpuPass(const char* name);
+    void endGpuPass();
+
+    void count(Counter counter, int64_t amount) {
+        if (enabled) counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    const FrameStats& lastFrame() const { return last; }
+    // Frame times in ms, oldest first
+    void frameHistory(std::vector<float>& out) const;
+
+    // Record the next 'frames' frames for writeChromeTrace (enables the profiler meanwhile)
+    void startCapture(int frames);
+    bool isCapturing() const { return captureFramesLeft > 0; }
+    bool hasCapture() const { return !captureEvents.empty(); }
+    bool writeChromeTrace(const std::string& path) const;
+
+    // Free the GL query objects (context must be current)
+    void cleanup();
+
+private:
+    Profiler();
+
+    struct ScopeEvent {
+        const char* name;
+        int thread;
+        int depth;
+        int64_t startNs;
+        int64_t endNs;
+    };
+    struct CounterSample {
+        int64_t timeNs;
+        int64_t values[kCounterCount];
+    };
+
+    // One set of queries per frame in flight
+    static constexpr int kGpuFramesInFlight = 4;
+    static constexpr int kMaxGpuPasses = 32;
+    struct GpuFrame {
+        unsigned int queries[kMaxGpuPasses] = {};
+        const char* names[kMaxGpuPasses] = {};
+        int64_t issuedNs[kMaxGpuPasses] = {};
+        int passCount = 0;
+        bool pending = false;
+        bool captured = false;      // results belong in the Chrome trace
+    };
+
+    int64_t nowNs() const;
+    static int threadIndex();
+    // Read back a finished frame's queries; false if the GPU isn't done with them yet
+    bool resolveGpuFrame(GpuFrame& frame);
+
+    bool enabled = false;
+    int64_t epochNs = 0;
+    int64_t frameStartNs = 0;
+    std::atomic<int> mainThread{-1};
+    std::atomic<int64_t> counters[kCounterCount];
+
+    std::mutex eventMutex;
+    std::vector<ScopeEvent> frameEvents;   // scopes closed during the current frame
+
+    GpuFrame gpuFrames[kGpuFramesInFlight];
+    int gpuFrameIndex = 0;
+    bool gpuPassOpen = false;
+    int gpuPassDepth = 0;
+    bool queriesCreated = false;
+
+    FrameStats last;
+    float history[kHistoryFrames] = {};
+    int historyNext = 0;
+    int historyCount = 0;
+
+    int captureFramesLeft = 0;
+    int64_t captureStartNs = 0;
+    std::vector<ScopeEvent> captureEvents;
+    std::vector<ScopeEvent> captureGpuEvents;
+    std::vector<CounterSample> captureCounters;
+};
+
+// Scope timer for the enclosing block
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) { Profiler::instance().beginScope(name); }
+    ~ProfileScope() { Profiler::instance().endScope(); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+// GPU pass timer for the enclosing block, paired with a CPU scope of the same name
+class ProfileGpuPass {
+public:
+    explicit ProfileGpuPass(const char* name) : scope(name) { Profiler::instance().beginGpuPass(name); }
+    ~ProfileGpuPass() { Profiler::instance().endGpuPass(); }
+    ProfileGpuPass(const ProfileGpuPass&) = delete;
+    ProfileGpuPass& operator=(const ProfileGpuPass&) = delete;
+
+private:
+    ProfileScope scope;
+};
+
+} // namespace opticsketch
+
+#define OPTICSKETCH_PROFILE_CONCAT_(a, b) a##b
+#define OPTICSKETCH_PROFILE_CONCAT(a, b) OPTICSKETCH_PROFILE_CONCAT_(a, b)
+
+#ifdef OPTICSKETCH_PROFILE
+#define OPTICSKETCH_PROFILE_SCOPE(name) \
+    ::opticsketch::ProfileScope OPTICSKETCH_PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define OPTICSKETCH_PROFILE_GPU_PASS(name) \
+    ::opticsketch::ProfileGpuPass OPTICSKETCH_PROFILE_CONCAT(profileGpuPass_, __LINE__)(name)
+#define OPTICSKETCH_PROFILE_COUNT(counter, amount) \
+    ::opticsketch::Profiler::instance().count(::opticsketch::Profiler::counter, static_cast<int64_t>(amount))
+#define OPTICSKETCH_PROFILE_UPLOAD(bytes) \
+    (OPTICSKETCH_PROFILE_COUNT(BufferUploads, 1), OPTICSKETCH_PROFILE_COUNT(UploadBytes, bytes))
+#else
+#define OPTICSKETCH_PROFILE_SCOPE(name) ((void)0)
+#define OPTICSKETCH_PROFILE_GPU_PASS(name) ((void)0)
+#define OPTICSKETCH_PROFILE_COUNT(counter, amount) ((void)0)
+#define OPTICSKETCH_PROFILE_UPLOAD(bytes) ((void)0)
+#endif
@@ -0,0 +1,127 @@
+#include "project/autosave.h"
+#include "project/project.h"
+#include "scene/scene.h"
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace opticsketch {
+
+static uint64_t hashBytes(uint64_t h, const std::string& s) {
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Write and flush to disk before returning, so a rotated-in file is never half written
+static bool writeFileDurable(const std::string& path, const std::string& text) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = ok && std::fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = (std::fclose(f) == 0) && ok;
+    return ok;
+}
+
+static std::string rotatedPath(const std::string& base, int index) {
+    return base + ".autosave-" + std::to_string(index) + ".optsk";
+}
+
+Autosave::~Autosave() {
+    JobSystem::instance().wait(job);
+}
+
+std::string Autosave::basePath(const std::string& projectPath) const {
+    namespace fs = std::filesystem;
+    fs::path dir = directory;
+    std::string name = "untitled";
+    if (!projectPath.empty()) {
+        fs::path project(projectPath);
+        name = project.stem().string();
+        if (dir.empty()) dir = project.parent_path();
+    }
+    if (dir.empty()) {
+        std::error_code ec;
+        dir = fs::temp_directory_path(ec) / "opticsketch";
+    }
+    return (dir / name).string();
+}
+
+void Autosave::update(double now, const Scene& scene, const SceneStyle& style, const std::string& projectPath) {
+    if (!enabled || saving.load()) return;
+    if (lastStart < 0.0) lastStart = now;   // first autosave one interval after startup
+    if (now - lastStart < interval) return;
+    lastStart = now;
+    saveNow(scene, style, projectPath);
+}
+
+bool Autosave::saveNow(const Scene& scene, const SceneStyle& style, const std::string& projectPath) {
+    if (saving.load()) return false;
+    saving.store(true);
+    // Snapshot on the caller's thread; everything after this runs on the job
+    std::shared_ptr<Scene> snapshot = scene.snapshot();
+    SceneStyle styleCopy = style;
+    std::string base = basePath(projectPath);
+    int keep = keepCount;
+    job = JobSystem::instance().submit("Autosave", JobPriority::Low,
+        [this, snapshot, styleCopy, base, keep](JobContext& context) mutable {
+            run(context, snapshot.get(), &styleCopy, base, keep);
+            saving.store(false);
+        });
+    return true;
+}
+
+void Autosave::run(JobContext& job, Scene* snapshot, SceneStyle* style, const std::string& base, int keep) {
+    std::string text;
+    saveProjectToString(snapshot, style, text);
+
+    uint64_t hash = hashBytes(hashBytes(1469598103934665603ull, base), text);
+    // Unchanged, or the application is closing: the previous autosaves stay as they are
+    if (hash == lastContentHash || job.isCancelled()) return;
+
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::create_directories(fs::path(base).parent_path(), ec);
+
+    std::string tempPath = base + ".autosave.tmp";
+    if (!writeFileDurable(tempPath, text)) {
+        std::cerr << "Autosave failed: " << tempPath << "\n";
+        fs::remove(tempPath, ec);
+        return;
+    }
+
+    // Shift older autosaves up one slot, dropping the oldest
+    fs::remove(rotatedPath(base, keep), ec);
+    for (int i = keep - 1; i >= 1; i--) {
+        fs::rename(rotatedPath(base, i), rotatedPath(base, i + 1), ec);
+    }
+    std::string newest = rotatedPath(base, 1);
+    fs::rename(tempPath, newest, ec);
+    if (ec) {
+        std::cerr << "Autosave failed: " << newest << " (" << ec.message() << ")\n";
+    } else {
+        lastContentHash = hash;
+        std::lock_guard<std::mutex> lock(pathMutex);
+        lastSavedPath = newest;
+    }
+}
+
+std::string Autosave::getLastSavedPath() const {
+    std::lock_guard<std::mutex> lock(pathMutex);
+    return lastSavedPath;
+}
+
+} // namespace opticsketch
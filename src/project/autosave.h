@@ -0,0 +1,65 @@
+#pragma once
+
+#include "style/scene_style.h"
+#include "jobs/job_system.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace opticsketch {
+
+class Scene;
+
+// Periodic crash-recovery saves. The UI thread only takes a Scene::snapshot(); a
+// low-priority job serializes it, skips the write if nothing changed since the last autosave,
+// and otherwise writes + fsyncs a temp file and rotates it into
+// "<name>.autosave-1.optsk" ... "<name>.autosave-N.optsk" (1 = newest).
+class Autosave {
+public:
+    Autosave() = default;
+    ~Autosave();
+    Autosave(const Autosave&) = delete;
+    Autosave& operator=(const Autosave&) = delete;
+
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+    // Seconds between autosaves
+    void setInterval(double seconds) { interval = seconds; }
+    double getInterval() const { return interval; }
+    // Number of rotated autosave files kept (at least 1)
+    void setKeepCount(int count) { keepCount = count < 1 ? 1 : count; }
+    int getKeepCount() const { return keepCount; }
+    // Folder for autosaves; empty = next to the project, or the temp folder when untitled
+    void setDirectory(const std::string& dir) { directory = dir; }
+
+    // Call once per frame. Starts a background save once the interval has elapsed
+    // since the previous one and no save is still running.
+    void update(double now, const Scene& scene, const SceneStyle& style, const std::string& projectPath);
+
+    // Start a background save immediately. Returns false if one is still running.
+    bool saveNow(const Scene& scene, const SceneStyle& style, const std::string& projectPath);
+
+    bool isSaving() const { return saving.load(); }
+    // Newest autosave file written so far (empty if none)
+    std::string getLastSavedPath() const;
+
+private:
+    std::string basePath(const std::string& projectPath) const;
+    void run(JobContext& job, Scene* snapshot, SceneStyle* style, const std::string& base, int keep);
+
+    bool enabled = true;
+    double interval = 120.0;
+    int keepCount = 3;
+    std::string directory;
+    double lastStart = -1.0;
+
+    JobId job = 0;
+    std::atomic<bool> saving{false};
+    uint64_t lastContentHash = 0;   // job only
+    mutable std::mutex pathMutex;
+    std::string lastSavedPath;
+};
+
+} // namespace opticsketch
@@ -0,0 +1,121 @@
+#include "project/mesh_streamer.h"
+#include "project/project_binary.h"
+#include "render/viewport.h"
+#include "scene/scene.h"
+#include "elements/element.h"
+#include <filesystem>
+#include <iostream>
+
+namespace opticsketch {
+
+MeshStreamer::~MeshStreamer() {
+    JobSystem::instance().wait(job);
+}
+
+void MeshStreamer::add(const DeferredMeshSource& source) {
+    if (source.sourcePath.empty() && source.projectPath.empty()) return;
+    pending.emplace(source.sourcePath, source);
+}
+
+void MeshStreamer::clear() {
+    pending.clear();
+    generation++;   // results of the load in flight are ignored
+}
+
+MeshAssetRef MeshStreamer::load(const DeferredMeshSource& source) {
+    // The embedded copy avoids re-parsing; it is skipped if the project file changed since
+    if (!source.projectPath.empty()) {
+        MeshAssetRef asset = loadProjectMesh(source.projectPath, source.chunkOffset, source.chunkSize,
+                                             source.sourcePath, source.contentHash);
+        if (asset) return asset;
+    }
+    if (source.sourcePath.empty()) return nullptr;
+    return MeshStore::instance().load(source.sourcePath);
+}
+
+bool MeshStreamer::attach(Scene& scene, const std::string& sourcePath, const MeshAssetRef& asset) {
+    bool attached = false;
+    // Matched by path rather than id so copies made while the mesh was loading get it too
+    for (const auto& elem : scene.getElements()) {
+        if (elem->type != ElementType::ImportedMesh || elem->mesh || elem->meshSourcePath != sourcePath) continue;
+        elem->mesh = asset;
+        elem->boundsMin = asset->boundsMin;
+        elem->boundsMax = asset->boundsMax;
+        elem->markTransformDirty();
+        scene.recordChange(elem->handle, SceneChange::PropertyChanged);
+        attached = true;
+    }
+    return attached;
+}
+
+bool MeshStreamer::collectResults(Scene& scene) {
+    std::vector<Result> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(results);
+    }
+    bool attached = false;
+    for (const Result& r : done) {
+        inFlight = false;
+        if (r.generation != generation) continue;
+        if (!r.asset) {
+            std::cerr << "Could not load mesh: " << r.sourcePath << "\n";
+            continue;
+        }
+        attached |= attach(scene, r.sourcePath, r.asset);
+    }
+    return attached;
+}
+
+bool MeshStreamer::update(Scene& scene, const Viewport& viewport) {
+    bool attached = collectResults(scene);
+    if (inFlight || pending.empty()) return attached;
+
+    // Most visible source first: the largest on-screen element waiting on it
+    const DeferredMeshSource* best = nullptr;
+    float bestScore = -1.0f;
+    for (const auto& elem : scene.getElements()) {
+        if (elem->type != ElementType::ImportedMesh || elem->mesh) continue;
+        auto it = pending.find(elem->meshSourcePath);
+        if (it == pending.end()) continue;
+        float score = 0.0f;
+        if (elem->visible && viewport.isElementInView(*elem)) score = 1.0f + viewport.getProjectedRadius(*elem);
+        if (score > bestScore) {
+            bestScore = score;
+            best = &it->second;
+        }
+    }
+    if (!best) {
+        // No element waits on any queued source anymore (deleted, or a new scene)
+        pending.clear();
+        return attached;
+    }
+
+    DeferredMeshSource source = *best;
+    uint32_t jobGeneration = generation;
+    pending.erase(source.sourcePath);
+    std::string name = std::filesystem::path(source.sourcePath).filename().string();
+    std::string label = "Loading " + (name.empty() ? std::string("mesh") : name);
+    job = JobSystem::instance().submit(label, JobPriority::Normal, [this, source, jobGeneration](JobContext&) {
+        MeshAssetRef asset = load(source);
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back({source.sourcePath, std::move(asset), jobGeneration});
+    });
+    inFlight = true;
+    return attached;
+}
+
+void MeshStreamer::finishAll(Scene& scene) {
+    if (inFlight) JobSystem::instance().wait(job);
+    collectResults(scene);
+
+    std::unordered_map<std::string, DeferredMeshSource> remaining;
+    remaining.swap(pending);
+    for (const auto& [path, source] : remaining) {
+        MeshAssetRef asset = load(source);
+        if (asset) attach(scene, path, asset);
+        else std::cerr << "Could not load mesh: " << path << "\n";
+    }
+}
+
+} // namespace opticsketch
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "render/mesh_store.h"
+#include "jobs/job_system.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace opticsketch {
+
+class Scene;
+class Viewport;
+
+// Where a deferred mesh payload is read from
+struct DeferredMeshSource {
+    std::string sourcePath;     // OBJ path; also the key elements are matched by
+    // Embedded copy in a binary project (MESH chunk payload), tried before the OBJ
+    std::string projectPath;
+    uint64_t chunkOffset = 0;
+    uint64_t chunkSize = 0;
+    uint64_t contentHash = 0;
+};
+
+// Streams imported mesh payloads in after a project opens. The loaders create
+// ImportedMesh elements with null meshes (drawn as bounds outlines) and queue their
+// sources here; one JobSystem job at a time loads a mesh, most visible first, and
+// update() attaches each finished asset to every element waiting on its source path.
+class MeshStreamer {
+public:
+    MeshStreamer() = default;
+    ~MeshStreamer();
+    MeshStreamer(const MeshStreamer&) = delete;
+    MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+    // Queue a source; repeated paths are loaded once
+    void add(const DeferredMeshSource& source);
+
+    // Drop all queued sources; a load in flight is discarded when it finishes
+    void clear();
+
+    // Once per frame: attach finished meshes, then hand the most visible pending source
+    // to a job. Returns true if any element received its mesh.
+    bool update(Scene& scene, const Viewport& viewport);
+
+    // Load everything still pending before returning (e.g. before saving or exporting)
+    void finishAll(Scene& scene);
+
+    bool isStreaming() const { return !pending.empty() || inFlight; }
+    size_t getPendingCount() const { return pending.size() + (inFlight ? 1 : 0); }
+
+private:
+    struct Result {
+        std::string sourcePath;
+        MeshAssetRef asset;
+        uint32_t generation = 0;
+    };
+
+    bool collectResults(Scene& scene);
+    static MeshAssetRef load(const DeferredMeshSource& source);
+    static bool attach(Scene& scene, const std::string& sourcePath, const MeshAssetRef& asset);
+
+    // UI thread state
+    std::unordered_map<std::string, DeferredMeshSource> pending;   // by source path
+    bool inFlight = false;
+    JobId job = 0;
+    uint32_t generation = 0;
+
+    // Shared with the job
+    std::mutex mutex;
+    std::vector<Result> results;
+};
+
+} // namespace opticsketch
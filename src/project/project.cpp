@@ -1,4 +1,9 @@
 #include "project/project.h"
+#include "project/project_binary.h"
+#include "project/project_journal.h"
+#include "project/project_text.h"
+#include "project/mapped_file.h"
+#include "project/mesh_streamer.h"
 #include "scene/scene.h"
 #include "elements/element.h"
 #include "elements/basic_elements.h"
@@ -10,57 +15,144 @@
 #include "scene/group.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <charconv>
 #include <fstream>
-#include <sstream>
-#include <algorithm>
-#include <cctype>
 
-static void skipBOM(std::istream& in) {
-    char buf[3] = {0};
-    in.read(buf, 3);
-    if (in.gcount() == 3 &&
-        (unsigned char)buf[0] == 0xEF &&
-        (unsigned char)buf[1] == 0xBB &&
-        (unsigned char)buf[2] == 0xBF)
-        return;
-    in.clear();
-    in.seekg(0);
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
 }
 
-static void trim(std::string& s) {
-    auto it = std::find_if_not(s.begin(), s.end(), [](unsigned char c) { return std::isspace(c); });
-    s.erase(s.begin(), it);
-    it = std::find_if_not(s.rbegin(), s.rend(), [](unsigned char c) { return std::isspace(c); }).base();
-    s.erase(it, s.end());
+static std::string_view trimView(std::string_view s) {
+    size_t b = 0, e = s.size();
+    while (b < e && isSpace(s[b])) b++;
+    while (e > b && isSpace(s[e - 1])) e--;
+    return s.substr(b, e - b);
+}
+
+static std::string_view skipBOM(std::string_view s) {
+    if (s.size() >= 3 && (unsigned char)s[0] == 0xEF && (unsigned char)s[1] == 0xBB && (unsigned char)s[2] == 0xBF)
+        s.remove_prefix(3);
+    return s;
+}
+
+// Line cursor over a whole file held in memory; lines are returned trimmed, without copies
+class LineReader {
+public:
+    explicit LineReader(std::string_view text) : text(text) {}
+
+    bool next(std::string_view& line) {
+        if (pos >= text.size()) return false;
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos) eol = text.size();
+        line = trimView(text.substr(pos, eol - pos));
+        pos = eol + 1;
+        return true;
+    }
+
+private:
+    std::string_view text;
+    size_t pos = 0;
+};
+
+// "key value": true if the line starts with the key as a whole word; value is the trimmed rest
+static bool matchKey(std::string_view line, std::string_view key, std::string_view& value) {
+    if (line.size() < key.size() || line.compare(0, key.size(), key) != 0) return false;
+    if (line.size() > key.size() && !isSpace(line[key.size()])) return false;
+    value = trimView(line.substr(key.size()));
+    return true;
+}
+
+// Parse one number from the front of 's' and advance past it
+template <typename T>
+static bool parseNumber(std::string_view& s, T& value) {
+    const char* first = s.data();
+    const char* last = s.data() + s.size();
+    while (first < last && isSpace(*first)) first++;
+    if (first < last && *first == '+') first++;   // from_chars rejects an explicit '+'
+    T parsed;
+    auto res = std::from_chars(first, last, parsed);
+    if (res.ec != std::errc()) return false;
+    value = parsed;
+    s.remove_prefix(static_cast<size_t>(res.ptr - s.data()));
+    return true;
+}
+
+// Parse whitespace-separated numbers in order. Stops at the first missing or malformed one,
+// which keeps its previous value.
+template <typename... T>
+static bool readNumbers(std::string_view s, T&... values) {
+    return (parseNumber(s, values) && ...);
+}
+
+static bool readFlag(std::string_view s, bool& flag) {
+    int v;
+    if (!parseNumber(s, v)) return false;
+    flag = (v != 0);
+    return true;
+}
+
+// Text output is built in one pre-sized buffer and written with a single call
+template <typename T>
+static void appendNumber(std::string& out, T value) {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, static_cast<size_t>(res.ptr - buf));
+}
+
+template <typename... T>
+static void writeNumbers(std::string& out, std::string_view key, T... values) {
+    out.append(key);
+    ((out += ' ', appendNumber(out, values)), ...);
+    out += '\n';
+}
+
+static void writeString(std::string& out, std::string_view key, std::string_view value) {
+    out.append(key);
+    out += ' ';
+    out.append(value);
+    out += '\n';
+}
+
+static bool writeWholeFile(const std::string& path, const std::string& text) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return false;
+    f.write(text.data(), static_cast<std::streamsize>(text.size()));
+    f.flush();
+    return f.good();
 }
 
 // Encode text for single-line storage (newlines become literal \n)
-static std::string encodeText(const std::string& s) {
-    std::string out;
+static void appendEncodedText(std::string& out, std::string_view s) {
     for (char c : s) {
         if (c == '\n') out += "\\n";
         else if (c == '\\') out += "\\\\";
         else out += c;
     }
-    return out;
 }
 
-static std::string decodeText(const std::string& s) {
+static std::string decodeText(std::string_view s) {
     std::string out;
-    for (size_t i = 0; i < s.size(); i++) {
-        if (s[i] == '\\' && i + 1 < s.size()) {
-            if (s[i+1] == 'n') { out += '\n'; i++; }
-            else if (s[i+1] == '\\') { out += '\\'; i++; }
-            else out += s[i];
-        } else {
-            out += s[i];
-        }
+    out.reserve(s.size());
+    size_t runStart = 0;
+    for (size_t i = 0; i + 1 < s.size(); i++) {
+        if (s[i] != '\\' || (s[i + 1] != 'n' && s[i + 1] != '\\')) continue;
+        out.append(s.data() + runStart, i - runStart);
+        out += (s[i + 1] == 'n') ? '\n' : '\\';
+        i++;
+        runStart = i + 1;
     }
+    out.append(s.data() + runStart, s.size() - runStart);
     return out;
 }
 
 namespace opticsketch {
 
+// Rough serialized sizes, used to reserve the output buffer up front
+static constexpr size_t kElementTextBytes = 768;
+static constexpr size_t kBeamTextBytes = 256;
+static constexpr size_t kRecordTextBytes = 192;   // annotations, measurements, groups, presets
+static constexpr size_t kStyleTextBytes = 1024;
+
 static const char* typeToString(ElementType t) {
     switch (t) {
         case ElementType::Laser:         return "Laser";
@@ -81,7 +173,7 @@ static const char* typeToString(ElementType t) {
     }
 }
 
-static ElementType stringToType(const std::string& s) {
+static ElementType stringToType(std::string_view s) {
     if (s == "Mirror") return ElementType::Mirror;
     if (s == "Lens") return ElementType::Lens;
     if (s == "BeamSplitter") return ElementType::BeamSplitter;
@@ -100,170 +192,183 @@ static ElementType stringToType(const std::string& s) {
 
 bool saveProject(const std::string& path, Scene* scene, SceneStyle* style) {
     if (!scene) return false;
-    std::ofstream f(path);
-    if (!f) return false;
+    if (path.size() >= 7 && path.compare(path.size() - 7, 7, ".optskb") == 0)
+        return saveProjectBinary(path, scene, style);
+    std::string text;
+    saveProjectToString(scene, style, text);
+    return writeWholeFile(path, text);
+}
 
-    f << "optsk 1\n";
-    for (const auto& elem : scene->getElements()) {
-        if (!elem) continue;
-        const Element& e = *elem;
-        f << "element\n";
-        f << "type " << typeToString(e.type) << "\n";
-        f << "id " << e.id << "\n";
-        f << "label " << e.label << "\n";
-        f << "position " << e.transform.position.x << " " << e.transform.position.y << " " << e.transform.position.z << "\n";
-        f << "rotation " << e.transform.rotation.x << " " << e.transform.rotation.y << " " << e.transform.rotation.z << " " << e.transform.rotation.w << "\n";
-        f << "scale " << e.transform.scale.x << " " << e.transform.scale.y << " " << e.transform.scale.z << "\n";
-        f << "visible " << (e.visible ? 1 : 0) << "\n";
-        f << "locked " << (e.locked ? 1 : 0) << "\n";
-        f << "showlabel " << (e.showLabel ? 1 : 0) << "\n";
-        f << "layer " << e.layer << "\n";
-        // Optical properties
-        f << "opticaltype " << static_cast<int>(e.optics.opticalType) << "\n";
-        f << "ior " << e.optics.ior << "\n";
-        f << "reflectivity " << e.optics.reflectivity << "\n";
-        f << "transmissivity " << e.optics.transmissivity << "\n";
-        f << "focallength " << e.optics.focalLength << "\n";
-        f << "curvature " << e.optics.curvatureR1 << " " << e.optics.curvatureR2 << "\n";
-        f << "aperturedia " << e.optics.apertureDiameter << "\n";
-        f << "gratingdensity " << e.optics.gratingLineDensity << "\n";
-        f << "filtercolor " << e.optics.filterColor.x << " " << e.optics.filterColor.y << " " << e.optics.filterColor.z << "\n";
-        f << "cauchyb " << e.optics.cauchyB << "\n";
-        f << "sourceraycount " << e.optics.sourceRayCount << "\n";
-        f << "sourcebeamwidth " << e.optics.sourceBeamWidth << "\n";
-        f << "sourcewhitelight " << (e.optics.sourceIsWhiteLight ? 1 : 0) << "\n";
-        // Material properties
-        f << "metallic " << e.material.metallic << "\n";
-        f << "roughness " << e.material.roughness << "\n";
-        f << "transparency " << e.material.transparency << "\n";
-        f << "fresnelior " << e.material.fresnelIOR << "\n";
-        if (e.type == ElementType::ImportedMesh && !e.meshSourcePath.empty()) {
-            f << "meshpath " << e.meshSourcePath << "\n";
+void writeElementRecord(std::string& f, const Element& e) {
+    f += "element\n";
+    writeString(f, "type", typeToString(e.type));
+    writeString(f, "id", e.id);
+    writeString(f, "label", e.label);
+    writeNumbers(f, "position", e.transform.position.x, e.transform.position.y, e.transform.position.z);
+    writeNumbers(f, "rotation", e.transform.rotation.x, e.transform.rotation.y, e.transform.rotation.z, e.transform.rotation.w);
+    writeNumbers(f, "scale", e.transform.scale.x, e.transform.scale.y, e.transform.scale.z);
+    writeNumbers(f, "visible", e.visible ? 1 : 0);
+    writeNumbers(f, "locked", e.locked ? 1 : 0);
+    writeNumbers(f, "showlabel", e.showLabel ? 1 : 0);
+    writeNumbers(f, "layer", e.layer);
+    // Optical properties
+    writeNumbers(f, "opticaltype", static_cast<int>(e.optics.opticalType));
+    writeNumbers(f, "ior", e.optics.ior);
+    writeNumbers(f, "reflectivity", e.optics.reflectivity);
+    writeNumbers(f, "transmissivity", e.optics.transmissivity);
+    writeNumbers(f, "focallength", e.optics.focalLength);
+    writeNumbers(f, "curvature", e.optics.curvatureR1, e.optics.curvatureR2);
+    writeNumbers(f, "aperturedia", e.optics.apertureDiameter);
+    writeNumbers(f, "gratingdensity", e.optics.gratingLineDensity);
+    writeNumbers(f, "filtercolor", e.optics.filterColor.x, e.optics.filterColor.y, e.optics.filterColor.z);
+    writeNumbers(f, "cauchyb", e.optics.cauchyB);
+    writeNumbers(f, "sourceraycount", e.optics.sourceRayCount);
+    writeNumbers(f, "sourcebeamwidth", e.optics.sourceBeamWidth);
+    writeNumbers(f, "sourcewhitelight", e.optics.sourceIsWhiteLight ? 1 : 0);
+    // Material properties
+    writeNumbers(f, "metallic", e.material.metallic);
+    writeNumbers(f, "roughness", e.material.roughness);
+    writeNumbers(f, "transparency", e.material.transparency);
+    writeNumbers(f, "fresnelior", e.material.fresnelIOR);
+    if (e.type == ElementType::ImportedMesh && !e.meshSourcePath.empty()) {
+        writeString(f, "meshpath", e.meshSourcePath);
+    }
+    // Arrays: the grid, then one line per explicitly placed copy
+    if (!e.array.isSingle()) {
+        const ElementArray& a = e.array;
+        writeNumbers(f, "array", a.count.x, a.count.y, a.count.z, a.pitch.x, a.pitch.y, a.pitch.z);
+        for (const Transform& t : a.instances) {
+            writeNumbers(f, "instance", t.position.x, t.position.y, t.position.z,
+                         t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w, t.scale.x, t.scale.y, t.scale.z);
         }
-        f << "end\n";
     }
+    f += "end\n";
+}
+
+void writeBeamRecord(std::string& f, const Beam& b) {
+    f += "beam\n";
+    writeString(f, "id", b.id);
+    writeString(f, "label", b.label);
+    writeNumbers(f, "start", b.start.x, b.start.y, b.start.z);
+    writeNumbers(f, "end", b.end.x, b.end.y, b.end.z);
+    writeNumbers(f, "color", b.color.x, b.color.y, b.color.z);
+    writeNumbers(f, "width", b.width);
+    writeNumbers(f, "visible", b.visible ? 1 : 0);
+    writeNumbers(f, "layer", b.layer);
+    if (b.isTraced) {
+        f += "traced 1\n";
+        writeString(f, "sourceid", b.sourceElementId);
+    }
+    if (b.isGaussian) {
+        f += "gaussian 1\n";
+        writeNumbers(f, "waist", b.waistW0);
+        writeNumbers(f, "wavelength", b.wavelength);
+        writeNumbers(f, "waistpos", b.waistPosition);
+    }
+    f += "end\n";
+}
+
+void writeAnnotationRecord(std::string& f, const Annotation& a) {
+    f += "annotation\n";
+    writeString(f, "id", a.id);
+    writeString(f, "label", a.label);
+    f += "text ";
+    appendEncodedText(f, a.text);
+    f += '\n';
+    writeNumbers(f, "position", a.position.x, a.position.y, a.position.z);
+    writeNumbers(f, "color", a.color.x, a.color.y, a.color.z);
+    writeNumbers(f, "fontsize", a.fontSize);
+    writeNumbers(f, "visible", a.visible ? 1 : 0);
+    writeNumbers(f, "layer", a.layer);
+    f += "end\n";
+}
+
+void writeMeasurementRecord(std::string& f, const Measurement& m) {
+    f += "measurement\n";
+    writeString(f, "id", m.id);
+    writeString(f, "label", m.label);
+    writeNumbers(f, "start", m.startPoint.x, m.startPoint.y, m.startPoint.z);
+    writeNumbers(f, "end", m.endPoint.x, m.endPoint.y, m.endPoint.z);
+    writeNumbers(f, "color", m.color.x, m.color.y, m.color.z);
+    writeNumbers(f, "fontsize", m.fontSize);
+    writeNumbers(f, "visible", m.visible ? 1 : 0);
+    writeNumbers(f, "layer", m.layer);
+    f += "end\n";
+}
+
+void writeGroupRecord(std::string& f, const Scene& scene, const Group& g) {
+    f += "group\n";
+    writeString(f, "id", g.id);
+    writeString(f, "name", g.name);
+    f += "members";
+    for (ObjectHandle member : g.members) {
+        f += ' ';
+        f += scene.getObjectId(member);
+    }
+    f += "\n";
+    f += "end\n";
+}
+
+void writeViewPresetRecord(std::string& f, const ViewPreset& vp) {
+    f += "viewpreset\n";
+    writeString(f, "name", vp.name);
+    writeNumbers(f, "mode", static_cast<int>(vp.mode));
+    writeNumbers(f, "position", vp.position.x, vp.position.y, vp.position.z);
+    writeNumbers(f, "target", vp.target.x, vp.target.y, vp.target.z);
+    writeNumbers(f, "up", vp.up.x, vp.up.y, vp.up.z);
+    writeNumbers(f, "fov", vp.fov);
+    writeNumbers(f, "orthosize", vp.orthoSize);
+    writeNumbers(f, "distance", vp.distance);
+    writeNumbers(f, "azimuth", vp.azimuth);
+    writeNumbers(f, "elevation", vp.elevation);
+    f += "end\n";
+}
+
+void saveProjectToString(Scene* scene, SceneStyle* style, std::string& f) {
+    f.clear();
+    if (!scene) return;
+    const TracedRayBuffer& traced = scene->getTracedRays();
+    f.reserve(scene->getElements().size() * kElementTextBytes +
+              (scene->getBeams().size() + traced.size()) * kBeamTextBytes +
+              (scene->getAnnotations().size() + scene->getMeasurements().size() +
+               scene->getGroups().size() + scene->getViewPresets().size()) * kRecordTextBytes +
+              kStyleTextBytes);
+
+    f += "optsk 1\n";
+    for (const auto& elem : scene->getElements())
+        if (elem) writeElementRecord(f, *elem);
     // Save beams
-    for (const auto& beam : scene->getBeams()) {
-        if (!beam) continue;
-        const Beam& b = *beam;
-        f << "beam\n";
-        f << "id " << b.id << "\n";
-        f << "label " << b.label << "\n";
-        f << "start " << b.start.x << " " << b.start.y << " " << b.start.z << "\n";
-        f << "end " << b.end.x << " " << b.end.y << " " << b.end.z << "\n";
-        f << "color " << b.color.x << " " << b.color.y << " " << b.color.z << "\n";
-        f << "width " << b.width << "\n";
-        f << "visible " << (b.visible ? 1 : 0) << "\n";
-        f << "layer " << b.layer << "\n";
-        if (b.isTraced) {
-            f << "traced 1\n";
-            f << "sourceid " << b.sourceElementId << "\n";
-        }
-        if (b.isGaussian) {
-            f << "gaussian 1\n";
-            f << "waist " << b.waistW0 << "\n";
-            f << "wavelength " << b.wavelength << "\n";
-            f << "waistpos " << b.waistPosition << "\n";
-        }
-        f << "end\n";
+    for (const auto& beam : scene->getBeams())
+        if (beam) writeBeamRecord(f, *beam);
+    // Save traced rays in the beam block layout so older files and readers stay compatible
+    for (size_t i = 0; i < traced.size(); i++) {
+        f += "beam\n";
+        f += "id traced_";
+        appendNumber(f, i);
+        f += '\n';
+        writeNumbers(f, "start", traced.start[i].x, traced.start[i].y, traced.start[i].z);
+        writeNumbers(f, "end", traced.end[i].x, traced.end[i].y, traced.end[i].z);
+        writeNumbers(f, "color", traced.color[i].x, traced.color[i].y, traced.color[i].z);
+        writeNumbers(f, "intensity", traced.intensity[i]);
+        f += "traced 1\n";
+        writeString(f, "sourceid", traced.sourceIds[traced.source[i]]);
+        f += "end\n";
     }
     // Save annotations
-    for (const auto& ann : scene->getAnnotations()) {
-        if (!ann) continue;
-        const Annotation& a = *ann;
-        f << "annotation\n";
-        f << "id " << a.id << "\n";
-        f << "label " << a.label << "\n";
-        f << "text " << encodeText(a.text) << "\n";
-        f << "position " << a.position.x << " " << a.position.y << " " << a.position.z << "\n";
-        f << "color " << a.color.x << " " << a.color.y << " " << a.color.z << "\n";
-        f << "fontsize " << a.fontSize << "\n";
-        f << "visible " << (a.visible ? 1 : 0) << "\n";
-        f << "layer " << a.layer << "\n";
-        f << "end\n";
-    }
+    for (const auto& ann : scene->getAnnotations())
+        if (ann) writeAnnotationRecord(f, *ann);
     // Save measurements
-    for (const auto& meas : scene->getMeasurements()) {
-        if (!meas) continue;
-        const Measurement& m = *meas;
-        f << "measurement\n";
-        f << "id " << m.id << "\n";
-        f << "label " << m.label << "\n";
-        f << "start " << m.startPoint.x << " " << m.startPoint.y << " " << m.startPoint.z << "\n";
-        f << "end " << m.endPoint.x << " " << m.endPoint.y << " " << m.endPoint.z << "\n";
-        f << "color " << m.color.x << " " << m.color.y << " " << m.color.z << "\n";
-        f << "fontsize " << m.fontSize << "\n";
-        f << "visible " << (m.visible ? 1 : 0) << "\n";
-        f << "layer " << m.layer << "\n";
-        f << "end\n";
-    }
+    for (const auto& meas : scene->getMeasurements())
+        if (meas) writeMeasurementRecord(f, *meas);
     // Save groups
-    for (const auto& g : scene->getGroups()) {
-        f << "group\n";
-        f << "id " << g.id << "\n";
-        f << "name " << g.name << "\n";
-        f << "members";
-        for (const auto& mid : g.memberIds)
-            f << " " << mid;
-        f << "\n";
-        f << "end\n";
-    }
+    for (const auto& g : scene->getGroups()) writeGroupRecord(f, *scene, g);
     // Save style
-    if (style) {
-        f << "style\n";
-        f << "rendermode " << static_cast<int>(style->renderMode) << "\n";
-        f << "bgcolor " << style->bgColor.x << " " << style->bgColor.y << " " << style->bgColor.z << "\n";
-        f << "gridcolor " << style->gridColor.x << " " << style->gridColor.y << " " << style->gridColor.z << "\n";
-        f << "gridalpha " << style->gridAlpha << "\n";
-        f << "wireframecolor " << style->wireframeColor.x << " " << style->wireframeColor.y << " " << style->wireframeColor.z << "\n";
-        f << "selbrightness " << style->selectionBrightness << "\n";
-        f << "ambient " << style->ambientStrength << "\n";
-        f << "specular " << style->specularStrength << "\n";
-        f << "shininess " << style->specularShininess << "\n";
-        for (int i = 0; i < kElementTypeCount; i++) {
-            f << "elemcolor " << i << " " << style->elementColors[i].x << " " << style->elementColors[i].y << " " << style->elementColors[i].z << "\n";
-        }
-        f << "snaptogrid " << (style->snapToGrid ? 1 : 0) << "\n";
-        f << "snapgridspacing " << style->gridSpacing << "\n";
-        f << "snaptoelem " << (style->snapToElement ? 1 : 0) << "\n";
-        f << "snapelemradius " << style->elementSnapRadius << "\n";
-        f << "snaptobeam " << (style->snapToBeam ? 1 : 0) << "\n";
-        f << "snapbeamradius " << style->beamSnapRadius << "\n";
-        f << "autoorientbeam " << (style->autoOrientToBeam ? 1 : 0) << "\n";
-        f << "showfocalpoints " << (style->showFocalPoints ? 1 : 0) << "\n";
-        f << "bloomthreshold " << style->bloomThreshold << "\n";
-        f << "bloomintensity " << style->bloomIntensity << "\n";
-        f << "bloomblurpasses " << style->bloomBlurPasses << "\n";
-        f << "bgmode " << static_cast<int>(style->bgMode) << "\n";
-        f << "bggradtop " << style->bgGradientTop.x << " " << style->bgGradientTop.y << " " << style->bgGradientTop.z << "\n";
-        f << "bggradbot " << style->bgGradientBottom.x << " " << style->bgGradientBottom.y << " " << style->bgGradientBottom.z << "\n";
-        if (!style->hdriPath.empty()) {
-            f << "hdripath " << style->hdriPath << "\n";
-        }
-        f << "hdriintensity " << style->hdriIntensity << "\n";
-        f << "hdrirotation " << style->hdriRotation << "\n";
-        f << "end\n";
-    }
+    if (style) writeStyleBlock(f, *style);
     // Save view presets
-    for (const auto& vp : scene->getViewPresets()) {
-        f << "viewpreset\n";
-        f << "name " << vp.name << "\n";
-        f << "mode " << static_cast<int>(vp.mode) << "\n";
-        f << "position " << vp.position.x << " " << vp.position.y << " " << vp.position.z << "\n";
-        f << "target " << vp.target.x << " " << vp.target.y << " " << vp.target.z << "\n";
-        f << "up " << vp.up.x << " " << vp.up.y << " " << vp.up.z << "\n";
-        f << "fov " << vp.fov << "\n";
-        f << "orthosize " << vp.orthoSize << "\n";
-        f << "distance " << vp.distance << "\n";
-        f << "azimuth " << vp.azimuth << "\n";
-        f << "elevation " << vp.elevation << "\n";
-        f << "end\n";
-    }
-    f.flush();
-    return f.good();
+    for (const auto& vp : scene->getViewPresets()) writeViewPresetRecord(f, vp);
 }
 
-static bool parseElementBlock(std::istream& in, Scene* scene) {
+static bool parseElementBlock(LineReader& in, Scene* scene, MeshStreamer* streamer) {
     std::string typeStr = "Laser", id, label, meshpath;
     float px = 0, py = 0, pz = 0;
     float qx = 0, qy = 0, qz = 0, qw = 1;
@@ -284,86 +389,91 @@ static bool parseElementBlock(std::istream& in, Scene* scene) {
     int sourcewhitelight = -1;
     // Material properties
     float metallic = -1, roughness = -1, transparency = -1, fresnelior = -1;
+    ElementArray array;
 
-    std::string line;
-    while (std::getline(in, line)) {
-        trim(line);
+    std::string_view line, v;
+    while (in.next(line)) {
         if (line.empty()) continue;
         if (line == "end") break;
 
-        if (line.compare(0, 5, "type ") == 0) {
-            typeStr = line.substr(5);
-            trim(typeStr);
-        } else if (line.compare(0, 3, "id ") == 0) {
-            id = line.substr(3);
-            trim(id);
-        } else if (line.compare(0, 6, "label ") == 0) {
-            label = line.substr(6);
-            trim(label);
-        } else if (line.compare(0, 9, "position ") == 0) {
-            std::istringstream ls(line.substr(9));
-            ls >> px >> py >> pz;
-        } else if (line.compare(0, 9, "rotation ") == 0) {
-            std::istringstream ls(line.substr(9));
-            ls >> qx >> qy >> qz >> qw;
-        } else if (line.compare(0, 6, "scale ") == 0) {
-            std::istringstream ls(line.substr(6));
-            ls >> sx >> sy >> sz;
-        } else if (line.compare(0, 8, "visible ") == 0) {
-            visible = std::stoi(line.substr(8));
-        } else if (line.compare(0, 7, "locked ") == 0) {
-            locked = std::stoi(line.substr(7));
-        } else if (line.compare(0, 10, "showlabel ") == 0) {
-            showlabel = std::stoi(line.substr(10));
-        } else if (line.compare(0, 6, "layer ") == 0) {
-            layer = std::stoi(line.substr(6));
-        } else if (line.compare(0, 9, "meshpath ") == 0) {
-            meshpath = line.substr(9);
-            trim(meshpath);
-        } else if (line.compare(0, 12, "opticaltype ") == 0) {
-            opticaltype = std::stoi(line.substr(12));
-        } else if (line.compare(0, 4, "ior ") == 0) {
-            ior = std::stof(line.substr(4));
-        } else if (line.compare(0, 14, "reflectivity ") == 0) {
-            reflectivity = std::stof(line.substr(14));
-        } else if (line.compare(0, 15, "transmissivity ") == 0) {
-            transmissivity = std::stof(line.substr(15));
-        } else if (line.compare(0, 12, "focallength ") == 0) {
-            focallength = std::stof(line.substr(12));
-        } else if (line.compare(0, 10, "curvature ") == 0) {
-            std::istringstream ls(line.substr(10));
-            ls >> curvR1 >> curvR2;
+        if (matchKey(line, "type", v)) {
+            typeStr = v;
+        } else if (matchKey(line, "id", v)) {
+            id = v;
+        } else if (matchKey(line, "label", v)) {
+            label = v;
+        } else if (matchKey(line, "position", v)) {
+            readNumbers(v, px, py, pz);
+        } else if (matchKey(line, "rotation", v)) {
+            readNumbers(v, qx, qy, qz, qw);
+        } else if (matchKey(line, "scale", v)) {
+            readNumbers(v, sx, sy, sz);
+        } else if (matchKey(line, "visible", v)) {
+            readNumbers(v, visible);
+        } else if (matchKey(line, "locked", v)) {
+            readNumbers(v, locked);
+        } else if (matchKey(line, "showlabel", v)) {
+            readNumbers(v, showlabel);
+        } else if (matchKey(line, "layer", v)) {
+            readNumbers(v, layer);
+        } else if (matchKey(line, "meshpath", v)) {
+            meshpath = v;
+        } else if (matchKey(line, "opticaltype", v)) {
+            readNumbers(v, opticaltype);
+        } else if (matchKey(line, "ior", v)) {
+            readNumbers(v, ior);
+        } else if (matchKey(line, "reflectivity", v)) {
+            readNumbers(v, reflectivity);
+        } else if (matchKey(line, "transmissivity", v)) {
+            readNumbers(v, transmissivity);
+        } else if (matchKey(line, "focallength", v)) {
+            readNumbers(v, focallength);
+        } else if (matchKey(line, "curvature", v)) {
+            readNumbers(v, curvR1, curvR2);
             hasCurvature = true;
-        } else if (line.compare(0, 12, "aperturedia ") == 0) {
-            aperturedia = std::stof(line.substr(12));
-        } else if (line.compare(0, 15, "gratingdensity ") == 0) {
-            gratingdensity = std::stof(line.substr(15));
-        } else if (line.compare(0, 12, "filtercolor ") == 0) {
-            std::istringstream ls(line.substr(12));
-            ls >> filterColorR >> filterColorG >> filterColorB;
+        } else if (matchKey(line, "aperturedia", v)) {
+            readNumbers(v, aperturedia);
+        } else if (matchKey(line, "gratingdensity", v)) {
+            readNumbers(v, gratingdensity);
+        } else if (matchKey(line, "filtercolor", v)) {
+            readNumbers(v, filterColorR, filterColorG, filterColorB);
             hasFilterColor = true;
-        } else if (line.compare(0, 8, "cauchyb ") == 0) {
-            cauchyb = std::stof(line.substr(8));
-        } else if (line.compare(0, 15, "sourceraycount ") == 0) {
-            sourceraycount = std::stoi(line.substr(15));
-        } else if (line.compare(0, 16, "sourcebeamwidth ") == 0) {
-            sourcebeamwidth = std::stof(line.substr(16));
-        } else if (line.compare(0, 17, "sourcewhitelight ") == 0) {
-            sourcewhitelight = std::stoi(line.substr(17));
-        } else if (line.compare(0, 9, "metallic ") == 0) {
-            metallic = std::stof(line.substr(9));
-        } else if (line.compare(0, 10, "roughness ") == 0) {
-            roughness = std::stof(line.substr(10));
-        } else if (line.compare(0, 13, "transparency ") == 0) {
-            transparency = std::stof(line.substr(13));
-        } else if (line.compare(0, 10, "fresnelior ") == 0) {
-            fresnelior = std::stof(line.substr(10));
+        } else if (matchKey(line, "cauchyb", v)) {
+            readNumbers(v, cauchyb);
+        } else if (matchKey(line, "sourceraycount", v)) {
+            readNumbers(v, sourceraycount);
+        } else if (matchKey(line, "sourcebeamwidth", v)) {
+            readNumbers(v, sourcebeamwidth);
+        } else if (matchKey(line, "sourcewhitelight", v)) {
+            readNumbers(v, sourcewhitelight);
+        } else if (matchKey(line, "metallic", v)) {
+            readNumbers(v, metallic);
+        } else if (matchKey(line, "roughness", v)) {
+            readNumbers(v, roughness);
+        } else if (matchKey(line, "transparency", v)) {
+            readNumbers(v, transparency);
+        } else if (matchKey(line, "fresnelior", v)) {
+            readNumbers(v, fresnelior);
+        } else if (matchKey(line, "array", v)) {
+            readNumbers(v, array.count.x, array.count.y, array.count.z, array.pitch.x, array.pitch.y, array.pitch.z);
+            array.count = glm::max(array.count, glm::ivec3(1));
+        } else if (matchKey(line, "instance", v)) {
+            Transform t;
+            if (readNumbers(v, t.position.x, t.position.y, t.position.z, t.rotation.x, t.rotation.y, t.rotation.z,
+                            t.rotation.w, t.scale.x, t.scale.y, t.scale.z) &&
+                array.size() < ElementArray::kMaxInstances)
+                array.instances.push_back(t);
         }
     }
-
     ElementType type = stringToType(typeStr);
     std::unique_ptr<Element> elem;
-    if (type == ElementType::ImportedMesh && !meshpath.empty()) {
+    if (type == ElementType::ImportedMesh && !meshpath.empty() && streamer) {
+        // Geometry is re-imported in the background; the element starts as a placeholder
+        DeferredMeshSource source;
+        source.sourcePath = meshpath;
+        streamer->add(source);
+        elem = createMeshPlaceholder(meshpath, id);
+    } else if (type == ElementType::ImportedMesh && !meshpath.empty()) {
         elem = createMeshElement(meshpath, id);
     } else {
         elem = createElement(type, id);
@@ -374,6 +484,7 @@ static bool parseElementBlock(std::istream& in, Scene* scene) {
     elem->transform.position = glm::vec3(px, py, pz);
     elem->transform.rotation = glm::quat(qw, qx, qy, qz);
     elem->transform.scale = glm::vec3(sx, sy, sz);
+    elem->markTransformDirty();
     elem->visible = (visible != 0);
     elem->locked = (locked != 0);
     elem->showLabel = (showlabel != 0);
@@ -400,12 +511,14 @@ static bool parseElementBlock(std::istream& in, Scene* scene) {
     if (roughness >= 0) elem->material.roughness = roughness;
     if (transparency >= 0) elem->material.transparency = transparency;
     if (fresnelior >= 0) elem->material.fresnelIOR = fresnelior;
+    elem->array = std::move(array);
 
     scene->addElement(std::move(elem));
     return true;
 }
 
-static bool parseBeamBlock(std::istream& in, Scene* scene) {
+
+static bool parseBeamBlock(LineReader& in, Scene* scene) {
     std::string id, label;
     float sx = 0, sy = 0, sz = 0;
     float ex = 0, ey = 0, ez = 0;
@@ -413,53 +526,57 @@ static bool parseBeamBlock(std::istream& in, Scene* scene) {
     float width = 2.0f;
     int visible = 1, layer = 0;
     int traced = 0;
+    float intensity = 1.0f;
     std::string sourceid;
     int gaussian = 0;
     float waist = 0.001f, wl = 633e-9f, waistpos = 0.0f;
 
-    std::string line;
-    while (std::getline(in, line)) {
-        trim(line);
+    std::string_view line, v;
+    while (in.next(line)) {
         if (line.empty()) continue;
         if (line == "end") break;
 
-        if (line.compare(0, 3, "id ") == 0) {
-            id = line.substr(3);
-            trim(id);
-        } else if (line.compare(0, 6, "label ") == 0) {
-            label = line.substr(6);
-            trim(label);
-        } else if (line.compare(0, 6, "start ") == 0) {
-            std::istringstream ls(line.substr(6));
-            ls >> sx >> sy >> sz;
-        } else if (line.compare(0, 4, "end ") == 0 && line.length() > 4) {
-            std::istringstream ls(line.substr(4));
-            ls >> ex >> ey >> ez;
-        } else if (line.compare(0, 6, "color ") == 0) {
-            std::istringstream ls(line.substr(6));
-            ls >> cr >> cg >> cb;
-        } else if (line.compare(0, 6, "width ") == 0) {
-            width = std::stof(line.substr(6));
-        } else if (line.compare(0, 8, "visible ") == 0) {
-            visible = std::stoi(line.substr(8));
-        } else if (line.compare(0, 6, "layer ") == 0) {
-            layer = std::stoi(line.substr(6));
-        } else if (line.compare(0, 7, "traced ") == 0) {
-            traced = std::stoi(line.substr(7));
-        } else if (line.compare(0, 9, "sourceid ") == 0) {
-            sourceid = line.substr(9);
-            trim(sourceid);
-        } else if (line.compare(0, 9, "gaussian ") == 0) {
-            gaussian = std::stoi(line.substr(9));
-        } else if (line.compare(0, 6, "waist ") == 0) {
-            waist = std::stof(line.substr(6));
-        } else if (line.compare(0, 11, "wavelength ") == 0) {
-            wl = std::stof(line.substr(11));
-        } else if (line.compare(0, 9, "waistpos ") == 0) {
-            waistpos = std::stof(line.substr(9));
+        if (matchKey(line, "id", v)) {
+            id = v;
+        } else if (matchKey(line, "label", v)) {
+            label = v;
+        } else if (matchKey(line, "start", v)) {
+            readNumbers(v, sx, sy, sz);
+        } else if (matchKey(line, "end", v)) {
+            readNumbers(v, ex, ey, ez);
+        } else if (matchKey(line, "color", v)) {
+            readNumbers(v, cr, cg, cb);
+        } else if (matchKey(line, "width", v)) {
+            readNumbers(v, width);
+        } else if (matchKey(line, "visible", v)) {
+            readNumbers(v, visible);
+        } else if (matchKey(line, "layer", v)) {
+            readNumbers(v, layer);
+        } else if (matchKey(line, "traced", v)) {
+            readNumbers(v, traced);
+        } else if (matchKey(line, "sourceid", v)) {
+            sourceid = v;
+        } else if (matchKey(line, "intensity", v)) {
+            readNumbers(v, intensity);
+        } else if (matchKey(line, "gaussian", v)) {
+            readNumbers(v, gaussian);
+        } else if (matchKey(line, "waist", v)) {
+            readNumbers(v, waist);
+        } else if (matchKey(line, "wavelength", v)) {
+            readNumbers(v, wl);
+        } else if (matchKey(line, "waistpos", v)) {
+            readNumbers(v, waistpos);
         }
     }
 
+    // Traced segments go to the scene's traced ray buffer, not the beam list
+    if (traced != 0) {
+        TracedRayBuffer& rays = scene->getTracedRays();
+        rays.add(glm::vec3(sx, sy, sz), glm::vec3(ex, ey, ez), glm::vec3(cr, cg, cb),
+                 intensity, rays.sourceIndex(sourceid));
+        return true;
+    }
+
     auto beam = std::make_unique<Beam>(id);
     beam->label = label;
     beam->start = glm::vec3(sx, sy, sz);
@@ -468,8 +585,6 @@ static bool parseBeamBlock(std::istream& in, Scene* scene) {
     beam->width = width;
     beam->visible = (visible != 0);
     beam->layer = layer;
-    beam->isTraced = (traced != 0);
-    beam->sourceElementId = sourceid;
     beam->isGaussian = (gaussian != 0);
     beam->waistW0 = waist;
     beam->wavelength = wl;
@@ -479,39 +594,34 @@ static bool parseBeamBlock(std::istream& in, Scene* scene) {
     return true;
 }
 
-static bool parseAnnotationBlock(std::istream& in, Scene* scene) {
+static bool parseAnnotationBlock(LineReader& in, Scene* scene) {
     std::string id, label, text;
     float px = 0, py = 0, pz = 0;
     float cr = 0.95f, cg = 0.95f, cb = 0.85f;
     float fontSize = 14.0f;
     int visible = 1, layer = 0;
 
-    std::string line;
-    while (std::getline(in, line)) {
-        trim(line);
+    std::string_view line, v;
+    while (in.next(line)) {
         if (line.empty()) continue;
         if (line == "end") break;
 
-        if (line.compare(0, 3, "id ") == 0) {
-            id = line.substr(3);
-            trim(id);
-        } else if (line.compare(0, 6, "label ") == 0) {
-            label = line.substr(6);
-            trim(label);
-        } else if (line.compare(0, 5, "text ") == 0) {
-            text = decodeText(line.substr(5));
-        } else if (line.compare(0, 9, "position ") == 0) {
-            std::istringstream ls(line.substr(9));
-            ls >> px >> py >> pz;
-        } else if (line.compare(0, 6, "color ") == 0) {
-            std::istringstream ls(line.substr(6));
-            ls >> cr >> cg >> cb;
-        } else if (line.compare(0, 9, "fontsize ") == 0) {
-            fontSize = std::stof(line.substr(9));
-        } else if (line.compare(0, 8, "visible ") == 0) {
-            visible = std::stoi(line.substr(8));
-        } else if (line.compare(0, 6, "layer ") == 0) {
-            layer = std::stoi(line.substr(6));
+        if (matchKey(line, "id", v)) {
+            id = v;
+        } else if (matchKey(line, "label", v)) {
+            label = v;
+        } else if (matchKey(line, "text", v)) {
+            text = decodeText(v);
+        } else if (matchKey(line, "position", v)) {
+            readNumbers(v, px, py, pz);
+        } else if (matchKey(line, "color", v)) {
+            readNumbers(v, cr, cg, cb);
+        } else if (matchKey(line, "fontsize", v)) {
+            readNumbers(v, fontSize);
+        } else if (matchKey(line, "visible", v)) {
+            readNumbers(v, visible);
+        } else if (matchKey(line, "layer", v)) {
+            readNumbers(v, layer);
         }
     }
 
@@ -528,115 +638,106 @@ static bool parseAnnotationBlock(std::istream& in, Scene* scene) {
     return true;
 }
 
-static bool parseStyleBlock(std::istream& in, SceneStyle* style) {
+
+static bool parseStyleBlock(LineReader& in, SceneStyle* style) {
+    std::string_view line, v;
     if (!style) {
         // Skip the block if no style pointer
-        std::string line;
-        while (std::getline(in, line)) {
-            trim(line);
+        while (in.next(line)) {
             if (line == "end") break;
         }
         return true;
     }
 
-    std::string line;
-    while (std::getline(in, line)) {
-        trim(line);
+    while (in.next(line)) {
         if (line.empty()) continue;
         if (line == "end") break;
 
-        if (line.compare(0, 8, "bgcolor ") == 0) {
-            std::istringstream ls(line.substr(8));
-            ls >> style->bgColor.x >> style->bgColor.y >> style->bgColor.z;
-        } else if (line.compare(0, 10, "gridcolor ") == 0) {
-            std::istringstream ls(line.substr(10));
-            ls >> style->gridColor.x >> style->gridColor.y >> style->gridColor.z;
-        } else if (line.compare(0, 10, "gridalpha ") == 0) {
-            style->gridAlpha = std::stof(line.substr(10));
-        } else if (line.compare(0, 15, "wireframecolor ") == 0) {
-            std::istringstream ls(line.substr(15));
-            ls >> style->wireframeColor.x >> style->wireframeColor.y >> style->wireframeColor.z;
-        } else if (line.compare(0, 14, "selbrightness ") == 0) {
-            style->selectionBrightness = std::stof(line.substr(14));
-        } else if (line.compare(0, 8, "ambient ") == 0) {
-            style->ambientStrength = std::stof(line.substr(8));
-        } else if (line.compare(0, 9, "specular ") == 0) {
-            style->specularStrength = std::stof(line.substr(9));
-        } else if (line.compare(0, 10, "shininess ") == 0) {
-            style->specularShininess = std::stof(line.substr(10));
-        } else if (line.compare(0, 10, "elemcolor ") == 0) {
-            std::istringstream ls(line.substr(10));
-            int idx;
+        if (matchKey(line, "bgcolor", v)) {
+            readNumbers(v, style->bgColor.x, style->bgColor.y, style->bgColor.z);
+        } else if (matchKey(line, "gridcolor", v)) {
+            readNumbers(v, style->gridColor.x, style->gridColor.y, style->gridColor.z);
+        } else if (matchKey(line, "gridalpha", v)) {
+            readNumbers(v, style->gridAlpha);
+        } else if (matchKey(line, "wireframecolor", v)) {
+            readNumbers(v, style->wireframeColor.x, style->wireframeColor.y, style->wireframeColor.z);
+        } else if (matchKey(line, "selbrightness", v)) {
+            readNumbers(v, style->selectionBrightness);
+        } else if (matchKey(line, "ambient", v)) {
+            readNumbers(v, style->ambientStrength);
+        } else if (matchKey(line, "specular", v)) {
+            readNumbers(v, style->specularStrength);
+        } else if (matchKey(line, "shininess", v)) {
+            readNumbers(v, style->specularShininess);
+        } else if (matchKey(line, "elemcolor", v)) {
+            int idx = -1;
             float r, g, b;
-            ls >> idx >> r >> g >> b;
-            if (idx >= 0 && idx < kElementTypeCount) {
+            if (readNumbers(v, idx, r, g, b) && idx >= 0 && idx < kElementTypeCount) {
                 style->elementColors[idx] = glm::vec3(r, g, b);
             }
-        } else if (line.compare(0, 11, "snaptogrid ") == 0) {
-            style->snapToGrid = (std::stoi(line.substr(11)) != 0);
-        } else if (line.compare(0, 16, "snapgridspacing ") == 0) {
-            style->gridSpacing = std::stof(line.substr(16));
-        } else if (line.compare(0, 11, "snaptoelem ") == 0) {
-            style->snapToElement = (std::stoi(line.substr(11)) != 0);
-        } else if (line.compare(0, 15, "snapelemradius ") == 0) {
-            style->elementSnapRadius = std::stof(line.substr(15));
-        } else if (line.compare(0, 11, "snaptobeam ") == 0) {
-            style->snapToBeam = (std::stoi(line.substr(11)) != 0);
-        } else if (line.compare(0, 15, "snapbeamradius ") == 0) {
-            style->beamSnapRadius = std::stof(line.substr(15));
-        } else if (line.compare(0, 15, "autoorientbeam ") == 0) {
-            style->autoOrientToBeam = (std::stoi(line.substr(15)) != 0);
-        } else if (line.compare(0, 11, "rendermode ") == 0) {
-            int rm = std::stoi(line.substr(11));
+        } else if (matchKey(line, "snaptogrid", v)) {
+            readFlag(v, style->snapToGrid);
+        } else if (matchKey(line, "snapgridspacing", v)) {
+            readNumbers(v, style->gridSpacing);
+        } else if (matchKey(line, "snaptoelem", v)) {
+            readFlag(v, style->snapToElement);
+        } else if (matchKey(line, "snapelemradius", v)) {
+            readNumbers(v, style->elementSnapRadius);
+        } else if (matchKey(line, "snaptobeam", v)) {
+            readFlag(v, style->snapToBeam);
+        } else if (matchKey(line, "snapbeamradius", v)) {
+            readNumbers(v, style->beamSnapRadius);
+        } else if (matchKey(line, "autoorientbeam", v)) {
+            readFlag(v, style->autoOrientToBeam);
+        } else if (matchKey(line, "rendermode", v)) {
+            int rm = -1;
+            readNumbers(v, rm);
             if (rm >= 0 && rm <= 2) style->renderMode = static_cast<RenderMode>(rm);
-        } else if (line.compare(0, 16, "showfocalpoints ") == 0) {
-            style->showFocalPoints = (std::stoi(line.substr(16)) != 0);
-        } else if (line.compare(0, 15, "bloomthreshold ") == 0) {
-            style->bloomThreshold = std::stof(line.substr(15));
-        } else if (line.compare(0, 15, "bloomintensity ") == 0) {
-            style->bloomIntensity = std::stof(line.substr(15));
-        } else if (line.compare(0, 16, "bloomblurpasses ") == 0) {
-            style->bloomBlurPasses = std::stoi(line.substr(16));
-        } else if (line.compare(0, 7, "bgmode ") == 0) {
-            int m = std::stoi(line.substr(7));
+        } else if (matchKey(line, "showfocalpoints", v)) {
+            readFlag(v, style->showFocalPoints);
+        } else if (matchKey(line, "bloomthreshold", v)) {
+            readNumbers(v, style->bloomThreshold);
+        } else if (matchKey(line, "bloomintensity", v)) {
+            readNumbers(v, style->bloomIntensity);
+        } else if (matchKey(line, "bloomblurpasses", v)) {
+            readNumbers(v, style->bloomBlurPasses);
+        } else if (matchKey(line, "bgmode", v)) {
+            int m = -1;
+            readNumbers(v, m);
             if (m >= 0 && m <= 1) style->bgMode = static_cast<BackgroundMode>(m);
-        } else if (line.compare(0, 10, "bggradtop ") == 0) {
-            std::istringstream ls(line.substr(10));
-            ls >> style->bgGradientTop.x >> style->bgGradientTop.y >> style->bgGradientTop.z;
-        } else if (line.compare(0, 10, "bggradbot ") == 0) {
-            std::istringstream ls(line.substr(10));
-            ls >> style->bgGradientBottom.x >> style->bgGradientBottom.y >> style->bgGradientBottom.z;
-        } else if (line.compare(0, 9, "hdripath ") == 0) {
-            style->hdriPath = line.substr(9);
-            // Trim whitespace
-            while (!style->hdriPath.empty() && (style->hdriPath.back() == ' ' || style->hdriPath.back() == '\r'))
-                style->hdriPath.pop_back();
-        } else if (line.compare(0, 14, "hdriintensity ") == 0) {
-            style->hdriIntensity = std::stof(line.substr(14));
-        } else if (line.compare(0, 13, "hdrirotation ") == 0) {
-            style->hdriRotation = std::stof(line.substr(13));
+        } else if (matchKey(line, "bggradtop", v)) {
+            readNumbers(v, style->bgGradientTop.x, style->bgGradientTop.y, style->bgGradientTop.z);
+        } else if (matchKey(line, "bggradbot", v)) {
+            readNumbers(v, style->bgGradientBottom.x, style->bgGradientBottom.y, style->bgGradientBottom.z);
+        } else if (matchKey(line, "hdripath", v)) {
+            style->hdriPath = v;
+        } else if (matchKey(line, "hdriintensity", v)) {
+            readNumbers(v, style->hdriIntensity);
+        } else if (matchKey(line, "hdrirotation", v)) {
+            readNumbers(v, style->hdriRotation);
         }
     }
     return true;
 }
 
-static bool parseGroupBlock(std::istream& in, Scene* scene) {
+static bool parseGroupBlock(LineReader& in, Scene* scene) {
     Group g;
-    std::string line;
-    while (std::getline(in, line)) {
-        trim(line);
+    std::string_view line, v;
+    while (in.next(line)) {
         if (line.empty()) continue;
         if (line == "end") break;
 
-        if (line.compare(0, 3, "id ") == 0) {
-            g.id = line.substr(3); trim(g.id);
-        } else if (line.compare(0, 5, "name ") == 0) {
-            g.name = line.substr(5); trim(g.name);
-        } else if (line.compare(0, 7, "members") == 0) {
-            std::istringstream ls(line.substr(7));
-            std::string mid;
-            while (ls >> mid)
-                g.memberIds.push_back(mid);
+        if (matchKey(line, "id", v)) {
+            g.id = v;
+        } else if (matchKey(line, "name", v)) {
+            g.name = v;
+        } else if (matchKey(line, "members", v)) {
+            while (!v.empty()) {
+                size_t space = 0;
+                while (space < v.size() && !isSpace(v[space])) space++;
+                g.members.push_back(scene->getObjectHandle(std::string(v.substr(0, space))));
+                v = trimView(v.substr(space));
+            }
         }
     }
     if (g.id.empty()) g.id = Group::generateId();
@@ -644,7 +745,7 @@ static bool parseGroupBlock(std::istream& in, Scene* scene) {
     return true;
 }
 
-static bool parseMeasurementBlock(std::istream& in, Scene* scene) {
+static bool parseMeasurementBlock(LineReader& in, Scene* scene) {
     std::string id, label;
     float sx = 0, sy = 0, sz = 0;
     float ex = 0, ey = 0, ez = 0;
@@ -652,31 +753,27 @@ static bool parseMeasurementBlock(std::istream& in, Scene* scene) {
     float fontSize = 12.0f;
     int visible = 1, layer = 0;
 
-    std::string line;
-    while (std::getline(in, line)) {
-        trim(line);
+    std::string_view line, v;
+    while (in.next(line)) {
         if (line.empty()) continue;
         if (line == "end") break;
 
-        if (line.compare(0, 3, "id ") == 0) {
-            id = line.substr(3); trim(id);
-        } else if (line.compare(0, 6, "label ") == 0) {
-            label = line.substr(6); trim(label);
-        } else if (line.compare(0, 6, "start ") == 0) {
-            std::istringstream ls(line.substr(6));
-            ls >> sx >> sy >> sz;
-        } else if (line.compare(0, 4, "end ") == 0 && line.length() > 4) {
-            std::istringstream ls(line.substr(4));
-            ls >> ex >> ey >> ez;
-        } else if (line.compare(0, 6, "color ") == 0) {
-            std::istringstream ls(line.substr(6));
-            ls >> cr >> cg >> cb;
-        } else if (line.compare(0, 9, "fontsize ") == 0) {
-            fontSize = std::stof(line.substr(9));
-        } else if (line.compare(0, 8, "visible ") == 0) {
-            visible = std::stoi(line.substr(8));
-        } else if (line.compare(0, 6, "layer ") == 0) {
-            layer = std::stoi(line.substr(6));
+        if (matchKey(line, "id", v)) {
+            id = v;
+        } else if (matchKey(line, "label", v)) {
+            label = v;
+        } else if (matchKey(line, "start", v)) {
+            readNumbers(v, sx, sy, sz);
+        } else if (matchKey(line, "end", v)) {
+            readNumbers(v, ex, ey, ez);
+        } else if (matchKey(line, "color", v)) {
+            readNumbers(v, cr, cg, cb);
+        } else if (matchKey(line, "fontsize", v)) {
+            readNumbers(v, fontSize);
+        } else if (matchKey(line, "visible", v)) {
+            readNumbers(v, visible);
+        } else if (matchKey(line, "layer", v)) {
+            readNumbers(v, layer);
         }
     }
 
@@ -693,141 +790,160 @@ static bool parseMeasurementBlock(std::istream& in, Scene* scene) {
     return true;
 }
 
-static bool parseViewPresetBlock(std::istream& in, Scene* scene) {
+static bool parseViewPresetBlock(LineReader& in, Scene* scene) {
     ViewPreset vp;
-    std::string line;
-    while (std::getline(in, line)) {
-        trim(line);
+    std::string_view line, v;
+    while (in.next(line)) {
         if (line.empty()) continue;
         if (line == "end") break;
 
-        if (line.compare(0, 5, "name ") == 0) {
-            vp.name = line.substr(5);
-            trim(vp.name);
-        } else if (line.compare(0, 5, "mode ") == 0) {
-            vp.mode = static_cast<CameraMode>(std::stoi(line.substr(5)));
-        } else if (line.compare(0, 9, "position ") == 0) {
-            std::istringstream ls(line.substr(9));
-            ls >> vp.position.x >> vp.position.y >> vp.position.z;
-        } else if (line.compare(0, 7, "target ") == 0) {
-            std::istringstream ls(line.substr(7));
-            ls >> vp.target.x >> vp.target.y >> vp.target.z;
-        } else if (line.compare(0, 3, "up ") == 0) {
-            std::istringstream ls(line.substr(3));
-            ls >> vp.up.x >> vp.up.y >> vp.up.z;
-        } else if (line.compare(0, 4, "fov ") == 0) {
-            vp.fov = std::stof(line.substr(4));
-        } else if (line.compare(0, 10, "orthosize ") == 0) {
-            vp.orthoSize = std::stof(line.substr(10));
-        } else if (line.compare(0, 9, "distance ") == 0) {
-            vp.distance = std::stof(line.substr(9));
-        } else if (line.compare(0, 8, "azimuth ") == 0) {
-            vp.azimuth = std::stof(line.substr(8));
-        } else if (line.compare(0, 10, "elevation ") == 0) {
-            vp.elevation = std::stof(line.substr(10));
+        if (matchKey(line, "name", v)) {
+            vp.name = v;
+        } else if (matchKey(line, "mode", v)) {
+            int mode;
+            if (readNumbers(v, mode)) vp.mode = static_cast<CameraMode>(mode);
+        } else if (matchKey(line, "position", v)) {
+            readNumbers(v, vp.position.x, vp.position.y, vp.position.z);
+        } else if (matchKey(line, "target", v)) {
+            readNumbers(v, vp.target.x, vp.target.y, vp.target.z);
+        } else if (matchKey(line, "up", v)) {
+            readNumbers(v, vp.up.x, vp.up.y, vp.up.z);
+        } else if (matchKey(line, "fov", v)) {
+            readNumbers(v, vp.fov);
+        } else if (matchKey(line, "orthosize", v)) {
+            readNumbers(v, vp.orthoSize);
+        } else if (matchKey(line, "distance", v)) {
+            readNumbers(v, vp.distance);
+        } else if (matchKey(line, "azimuth", v)) {
+            readNumbers(v, vp.azimuth);
+        } else if (matchKey(line, "elevation", v)) {
+            readNumbers(v, vp.elevation);
         }
     }
     scene->addViewPreset(vp);
     return true;
 }
 
-bool loadProject(const std::string& path, Scene* scene, SceneStyle* style) {
-    if (!scene) return false;
-    std::ifstream f(path);
-    if (!f) return false;
-
-    skipBOM(f);
-    std::string line;
-    if (!std::getline(f, line)) return false;
-    trim(line);
-    // Require first line to be "optsk " (version); only clear scene after we know the file is valid
-    if (line.size() < 5 || line.compare(0, 5, "optsk") != 0) return false;
+void writeStyleBlock(std::string& out, const SceneStyle& style) {
+    out += "style\n";
+    writeNumbers(out, "rendermode", static_cast<int>(style.renderMode));
+    writeNumbers(out, "bgcolor", style.bgColor.x, style.bgColor.y, style.bgColor.z);
+    writeNumbers(out, "gridcolor", style.gridColor.x, style.gridColor.y, style.gridColor.z);
+    writeNumbers(out, "gridalpha", style.gridAlpha);
+    writeNumbers(out, "wireframecolor", style.wireframeColor.x, style.wireframeColor.y, style.wireframeColor.z);
+    writeNumbers(out, "selbrightness", style.selectionBrightness);
+    writeNumbers(out, "ambient", style.ambientStrength);
+    writeNumbers(out, "specular", style.specularStrength);
+    writeNumbers(out, "shininess", style.specularShininess);
+    for (int i = 0; i < kElementTypeCount; i++) {
+        writeNumbers(out, "elemcolor", i, style.elementColors[i].x, style.elementColors[i].y, style.elementColors[i].z);
+    }
+    writeNumbers(out, "snaptogrid", style.snapToGrid ? 1 : 0);
+    writeNumbers(out, "snapgridspacing", style.gridSpacing);
+    writeNumbers(out, "snaptoelem", style.snapToElement ? 1 : 0);
+    writeNumbers(out, "snapelemradius", style.elementSnapRadius);
+    writeNumbers(out, "snaptobeam", style.snapToBeam ? 1 : 0);
+    writeNumbers(out, "snapbeamradius", style.beamSnapRadius);
+    writeNumbers(out, "autoorientbeam", style.autoOrientToBeam ? 1 : 0);
+    writeNumbers(out, "showfocalpoints", style.showFocalPoints ? 1 : 0);
+    writeNumbers(out, "bloomthreshold", style.bloomThreshold);
+    writeNumbers(out, "bloomintensity", style.bloomIntensity);
+    writeNumbers(out, "bloomblurpasses", style.bloomBlurPasses);
+    writeNumbers(out, "bgmode", static_cast<int>(style.bgMode));
+    writeNumbers(out, "bggradtop", style.bgGradientTop.x, style.bgGradientTop.y, style.bgGradientTop.z);
+    writeNumbers(out, "bggradbot", style.bgGradientBottom.x, style.bgGradientBottom.y, style.bgGradientBottom.z);
+    if (!style.hdriPath.empty()) {
+        writeString(out, "hdripath", style.hdriPath);
+    }
+    writeNumbers(out, "hdriintensity", style.hdriIntensity);
+    writeNumbers(out, "hdrirotation", style.hdriRotation);
+    out += "end\n";
+}
 
-    scene->clear();
+bool readStyleBlock(std::string_view text, SceneStyle* style) {
+    LineReader in(text);
+    std::string_view line;
+    if (!in.next(line) || line != "style") return false;
+    return parseStyleBlock(in, style);
+}
 
-    while (std::getline(f, line)) {
-        trim(line);
+bool readProjectRecords(std::string_view text, Scene* scene, SceneStyle* style, MeshStreamer* streamer) {
+    LineReader in(text);
+    std::string_view line;
+    while (in.next(line)) {
         if (line == "element") {
-            if (!parseElementBlock(f, scene)) return false;
+            if (!parseElementBlock(in, scene, streamer)) return false;
         } else if (line == "beam") {
-            if (!parseBeamBlock(f, scene)) return false;
+            if (!parseBeamBlock(in, scene)) return false;
         } else if (line == "annotation") {
-            if (!parseAnnotationBlock(f, scene)) return false;
+            if (!parseAnnotationBlock(in, scene)) return false;
         } else if (line == "measurement") {
-            if (!parseMeasurementBlock(f, scene)) return false;
+            if (!parseMeasurementBlock(in, scene)) return false;
         } else if (line == "group") {
-            if (!parseGroupBlock(f, scene)) return false;
+            if (!parseGroupBlock(in, scene)) return false;
         } else if (line == "style") {
-            if (!parseStyleBlock(f, style)) return false;
+            if (!parseStyleBlock(in, style)) return false;
         } else if (line == "viewpreset") {
-            if (!parseViewPresetBlock(f, scene)) return false;
+            if (!parseViewPresetBlock(in, scene)) return false;
         }
     }
     return true;
 }
 
+// Map a text file as one buffer (BOM stripped); the view is valid while 'file' is open
+static bool mapTextFile(const std::string& path, MappedFile& file, std::string_view& text) {
+    if (!file.open(path)) return false;
+    text = skipBOM(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()));
+    return true;
+}
+
+bool loadProject(const std::string& path, Scene* scene, SceneStyle* style, MeshStreamer* streamer) {
+    if (!scene) return false;
+    if (isBinaryProjectFile(path))
+        return loadProjectBinary(path, scene, style, streamer) && replayProjectJournal(path, scene, style, streamer);
+    MappedFile file;
+    std::string_view text;
+    if (!mapTextFile(path, file, text)) return false;
+
+    LineReader in(text);
+    std::string_view line;
+    if (!in.next(line)) return false;
+    // Require first line to be "optsk " (version); only clear scene after we know the file is valid
+    if (line.size() < 5 || line.compare(0, 5, "optsk") != 0) return false;
+
+    scene->clear();
+    if (streamer) streamer->clear();
+    // The header line is not a record, so the reader skips it
+    if (!readProjectRecords(text, scene, style, streamer)) return false;
+    return replayProjectJournal(path, scene, style, streamer);
+}
+
 bool saveStylePreset(const std::string& path, const SceneStyle* style) {
     if (!style) return false;
-    std::ofstream f(path);
-    if (!f.is_open()) return false;
-
-    f << "optstyle 1\n";
-    f << "style\n";
-    f << "rendermode " << static_cast<int>(style->renderMode) << "\n";
-    f << "bgcolor " << style->bgColor.x << " " << style->bgColor.y << " " << style->bgColor.z << "\n";
-    f << "gridcolor " << style->gridColor.x << " " << style->gridColor.y << " " << style->gridColor.z << "\n";
-    f << "gridalpha " << style->gridAlpha << "\n";
-    f << "wireframecolor " << style->wireframeColor.x << " " << style->wireframeColor.y << " " << style->wireframeColor.z << "\n";
-    f << "selbrightness " << style->selectionBrightness << "\n";
-    f << "ambient " << style->ambientStrength << "\n";
-    f << "specular " << style->specularStrength << "\n";
-    f << "shininess " << style->specularShininess << "\n";
-    for (int i = 0; i < kElementTypeCount; i++) {
-        f << "elemcolor " << i << " " << style->elementColors[i].x << " " << style->elementColors[i].y << " " << style->elementColors[i].z << "\n";
-    }
-    f << "snaptogrid " << (style->snapToGrid ? 1 : 0) << "\n";
-    f << "snapgridspacing " << style->gridSpacing << "\n";
-    f << "snaptoelem " << (style->snapToElement ? 1 : 0) << "\n";
-    f << "snapelemradius " << style->elementSnapRadius << "\n";
-    f << "snaptobeam " << (style->snapToBeam ? 1 : 0) << "\n";
-    f << "snapbeamradius " << style->beamSnapRadius << "\n";
-    f << "autoorientbeam " << (style->autoOrientToBeam ? 1 : 0) << "\n";
-    f << "showfocalpoints " << (style->showFocalPoints ? 1 : 0) << "\n";
-    f << "bloomthreshold " << style->bloomThreshold << "\n";
-    f << "bloomintensity " << style->bloomIntensity << "\n";
-    f << "bloomblurpasses " << style->bloomBlurPasses << "\n";
-    f << "bgmode " << static_cast<int>(style->bgMode) << "\n";
-    f << "bggradtop " << style->bgGradientTop.x << " " << style->bgGradientTop.y << " " << style->bgGradientTop.z << "\n";
-    f << "bggradbot " << style->bgGradientBottom.x << " " << style->bgGradientBottom.y << " " << style->bgGradientBottom.z << "\n";
-    if (!style->hdriPath.empty()) {
-        f << "hdripath " << style->hdriPath << "\n";
-    }
-    f << "hdriintensity " << style->hdriIntensity << "\n";
-    f << "hdrirotation " << style->hdriRotation << "\n";
-    f << "end\n";
-
-    return f.good();
+    std::string f;
+    f.reserve(kStyleTextBytes);
+    f += "optstyle 1\n";
+    writeStyleBlock(f, *style);
+    return writeWholeFile(path, f);
 }
 
 bool loadStylePreset(const std::string& path, SceneStyle* style) {
     if (!style) return false;
-    std::ifstream f(path);
-    if (!f.is_open()) return false;
-
-    skipBOM(f);
+    MappedFile file;
+    std::string_view text;
+    if (!mapTextFile(path, file, text)) return false;
 
-    std::string line;
+    LineReader in(text);
+    std::string_view line;
     // Read header
-    if (!std::getline(f, line)) return false;
-    trim(line);
+    if (!in.next(line)) return false;
     if (line != "optstyle 1") return false;
 
     // Read style block
-    if (!std::getline(f, line)) return false;
-    trim(line);
+    if (!in.next(line)) return false;
     if (line != "style") return false;
 
-    return parseStyleBlock(f, style);
+    return parseStyleBlock(in, style);
 }
 
 } // namespace opticsketch
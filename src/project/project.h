@@ -1,16 +1,30 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace opticsketch {
 
 class Scene;
+class MeshStreamer;
 struct SceneStyle;
 
+// Save in the text format, or the binary format when the path ends in ".optskb".
+// loadProject detects the format from the file contents. With a streamer, imported
+// meshes open as placeholders and their geometry is loaded in the background.
 bool saveProject(const std::string& path, Scene* scene, SceneStyle* style = nullptr);
-bool loadProject(const std::string& path, Scene* scene, SceneStyle* style = nullptr);
+bool loadProject(const std::string& path, Scene* scene, SceneStyle* style = nullptr,
+                 MeshStreamer* streamer = nullptr);
+
+// Text format into a string (replacing its contents), as saveProject writes it
+void saveProjectToString(Scene* scene, SceneStyle* style, std::string& out);
 
 bool saveStylePreset(const std::string& path, const SceneStyle* style);
 bool loadStylePreset(const std::string& path, SceneStyle* style);
 
+// Text "style ... end" block, shared by projects, presets and the binary format.
+// writeStyleBlock appends to 'out'; readStyleBlock parses a block it produced.
+void writeStyleBlock(std::string& out, const SceneStyle& style);
+bool readStyleBlock(std::string_view text, SceneStyle* style);
+
 } // namespace opticsketch
@@ -0,0 +1,855 @@
+#include "project/project_binary.h"
+#include "project/project.h"
+#include "project/mapped_file.h"
+#include "project/mesh_streamer.h"
+#include "scene/scene.h"
+#include "scene/group.h"
+#include "elements/element.h"
+#include "elements/basic_elements.h"
+#include "elements/annotation.h"
+#include "elements/measurement.h"
+#include "render/beam.h"
+#include "render/mesh_store.h"
+#include "style/scene_style.h"
+#include "camera/camera.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+namespace opticsketch {
+
+// File layout (little-endian, as written by x86/ARM hosts):
+//   FileHeader
+//   chunkCount x { ChunkHeader, payload (size bytes) }
+// Strings are stored once in the STRS chunk and referenced by index (0 = empty).
+// Readers skip chunks with unknown tags, so new chunks can be added without a version bump.
+
+static const char kBinaryMagic[8] = {'O', 'P', 'T', 'S', 'K', 'B', 'I', 'N'};
+static constexpr uint32_t kBinaryVersion = 1;
+static constexpr uint32_t kNoMesh = 0xFFFFFFFFu;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunkCount;
+};
+
+struct ChunkHeader {
+    char tag[4];
+    uint32_t count;   // records in the chunk (meaning depends on tag)
+    uint64_t size;    // payload bytes following this header
+};
+
+// Record flag bits
+static constexpr uint32_t kFlagVisible    = 1u << 0;
+static constexpr uint32_t kFlagLocked     = 1u << 1;
+static constexpr uint32_t kFlagShowLabel  = 1u << 2;
+static constexpr uint32_t kFlagWhiteLight = 1u << 3;
+static constexpr uint32_t kFlagTraced     = 1u << 4;
+static constexpr uint32_t kFlagGaussian   = 1u << 5;
+
+struct ElementRecord {
+    uint32_t type, id, label, meshPath;
+    uint32_t mesh;                    // index of the MESH chunk, or kNoMesh
+    uint32_t flags;
+    int32_t layer, opticalType, sourceRayCount;
+    float position[3], rotation[4], scale[3];   // rotation as x, y, z, w
+    float ior, reflectivity, transmissivity, focalLength, curvatureR1, curvatureR2;
+    float apertureDiameter, gratingLineDensity, filterColor[3], cauchyB, sourceBeamWidth;
+    float metallic, roughness, transparency, fresnelIOR;
+};
+static_assert(sizeof(ElementRecord) == 144, "ElementRecord layout is part of the file format");
+
+// Element arrays (ARRY), for the elements that have one; explicit copies are a range of
+// the AINS chunk
+struct ArrayRecord {
+    uint32_t element;                       // index in the ELEM chunk
+    int32_t count[3];
+    float pitch[3];
+    uint32_t firstInstance, instanceCount;
+};
+static_assert(sizeof(ArrayRecord) == 36, "ArrayRecord layout is part of the file format");
+
+struct ArrayInstanceRecord {
+    float position[3], rotation[4], scale[3];   // rotation as x, y, z, w
+};
+static_assert(sizeof(ArrayInstanceRecord) == 40, "ArrayInstanceRecord layout is part of the file format");
+
+struct BeamRecord {
+    uint32_t id, label, sourceId, flags;
+    int32_t layer;
+    float start[3], end[3], color[3];
+    float width, intensity, waistW0, wavelength, waistPosition;
+};
+static_assert(sizeof(BeamRecord) == 76, "BeamRecord layout is part of the file format");
+
+struct TracedRayRecord {
+    float start[3], end[3], color[3];
+    float intensity;
+    uint32_t sourceId;
+};
+static_assert(sizeof(TracedRayRecord) == 44, "TracedRayRecord layout is part of the file format");
+
+struct AnnotationRecord {
+    uint32_t id, label, text, flags;
+    int32_t layer;
+    float position[3], color[3];
+    float fontSize;
+};
+static_assert(sizeof(AnnotationRecord) == 48, "AnnotationRecord layout is part of the file format");
+
+struct MeasurementRecord {
+    uint32_t id, label, flags;
+    int32_t layer;
+    float start[3], end[3], color[3];
+    float fontSize;
+};
+static_assert(sizeof(MeasurementRecord) == 56, "MeasurementRecord layout is part of the file format");
+
+struct GroupRecord {
+    uint32_t id, name;
+    uint32_t firstMember, memberCount;   // range in the GMEM chunk
+};
+static_assert(sizeof(GroupRecord) == 16, "GroupRecord layout is part of the file format");
+
+struct ViewPresetRecord {
+    uint32_t name;
+    int32_t mode;
+    float position[3], target[3], up[3];
+    float fov, orthoSize, distance, azimuth, elevation;
+};
+static_assert(sizeof(ViewPresetRecord) == 64, "ViewPresetRecord layout is part of the file format");
+
+// MESH payload: MeshRecord, levelCount x MeshLevelRecord, then per level the vertex
+// floats followed by the uint32 indices. Level 0 is the full mesh.
+struct MeshRecord {
+    uint32_t sourcePath;
+    uint32_t levelCount;
+    uint64_t contentHash;
+    float boundsMin[3], boundsMax[3];
+};
+static_assert(sizeof(MeshRecord) == 40, "MeshRecord layout is part of the file format");
+
+struct MeshLevelRecord {
+    uint64_t vertexFloats;
+    uint64_t indexCount;
+};
+
+static void copyVec3(float* out, const glm::vec3& v) { out[0] = v.x; out[1] = v.y; out[2] = v.z; }
+static glm::vec3 toVec3(const float* v) { return glm::vec3(v[0], v[1], v[2]); }
+
+// ---------------------------------------------------------------------------
+// Writing
+
+namespace {
+
+class StringTable {
+public:
+    StringTable() { intern(""); }
+
+    uint32_t intern(const std::string& s) {
+        auto it = index.find(s);
+        if (it != index.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(strings.size());
+        strings.push_back(s);
+        index.emplace(s, id);
+        return id;
+    }
+
+    const std::vector<std::string>& all() const { return strings; }
+
+private:
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> index;
+};
+
+struct Chunk {
+    char tag[4];
+    uint32_t count = 0;
+    std::vector<unsigned char> bytes;
+    const MeshAsset* mesh = nullptr;   // MESH chunks stream their arrays at write time
+
+    Chunk(const char* t) { std::memcpy(tag, t, 4); }
+
+    template <typename T>
+    void append(const T& value) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+};
+
+} // namespace
+
+static uint64_t meshPayloadSize(const MeshAsset& mesh) {
+    uint64_t size = sizeof(MeshRecord) + (1 + mesh.lods.size()) * sizeof(MeshLevelRecord);
+    size += mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t);
+    for (const MeshLod& level : mesh.lods) {
+        size += level.vertices.size() * sizeof(float) + level.indices.size() * sizeof(uint32_t);
+    }
+    return size;
+}
+
+static void writeMeshPayload(std::ostream& out, const MeshAsset& mesh, uint32_t sourcePath) {
+    MeshRecord record{};
+    record.sourcePath = sourcePath;
+    record.levelCount = static_cast<uint32_t>(1 + mesh.lods.size());
+    record.contentHash = mesh.contentHash;
+    copyVec3(record.boundsMin, mesh.boundsMin);
+    copyVec3(record.boundsMax, mesh.boundsMax);
+    out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+
+    auto writeLevelRecord = [&](const std::vector<float>& v, const std::vector<uint32_t>& i) {
+        MeshLevelRecord level{v.size(), i.size()};
+        out.write(reinterpret_cast<const char*>(&level), sizeof(level));
+    };
+    writeLevelRecord(mesh.vertices, mesh.indices);
+    for (const MeshLod& lod : mesh.lods) writeLevelRecord(lod.vertices, lod.indices);
+
+    auto writeLevelData = [&](const std::vector<float>& v, const std::vector<uint32_t>& i) {
+        out.write(reinterpret_cast<const char*>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(float)));
+        out.write(reinterpret_cast<const char*>(i.data()), static_cast<std::streamsize>(i.size() * sizeof(uint32_t)));
+    };
+    writeLevelData(mesh.vertices, mesh.indices);
+    for (const MeshLod& lod : mesh.lods) writeLevelData(lod.vertices, lod.indices);
+}
+
+bool saveProjectBinary(const std::string& path, Scene* scene, SceneStyle* style) {
+    if (!scene) return false;
+
+    StringTable strings;
+    std::vector<Chunk> chunks;
+
+    // Imported meshes: one MESH chunk per unique asset
+    std::unordered_map<const MeshAsset*, uint32_t> meshIndex;
+    std::vector<Chunk> meshChunks;
+    std::vector<uint32_t> meshPathIds;
+    for (const auto& elem : scene->getElements()) {
+        if (!elem || !elem->mesh || meshIndex.count(elem->mesh.get())) continue;
+        meshIndex.emplace(elem->mesh.get(), static_cast<uint32_t>(meshChunks.size()));
+        meshChunks.emplace_back("MESH");
+        meshChunks.back().count = 1;
+        meshChunks.back().mesh = elem->mesh.get();
+        meshPathIds.push_back(strings.intern(elem->mesh->sourcePath));
+    }
+
+    Chunk elementChunk("ELEM");
+    Chunk arrayChunk("ARRY");
+    Chunk arrayInstanceChunk("AINS");
+    for (const auto& elem : scene->getElements()) {
+        if (!elem) continue;
+        const Element& e = *elem;
+        if (!e.array.isSingle()) {
+            ArrayRecord a{};
+            a.element = elementChunk.count;
+            a.count[0] = e.array.count.x;
+            a.count[1] = e.array.count.y;
+            a.count[2] = e.array.count.z;
+            copyVec3(a.pitch, e.array.pitch);
+            a.firstInstance = arrayInstanceChunk.count;
+            a.instanceCount = static_cast<uint32_t>(e.array.instances.size());
+            for (const Transform& t : e.array.instances) {
+                ArrayInstanceRecord ir{};
+                copyVec3(ir.position, t.position);
+                ir.rotation[0] = t.rotation.x;
+                ir.rotation[1] = t.rotation.y;
+                ir.rotation[2] = t.rotation.z;
+                ir.rotation[3] = t.rotation.w;
+                copyVec3(ir.scale, t.scale);
+                arrayInstanceChunk.append(ir);
+                arrayInstanceChunk.count++;
+            }
+            arrayChunk.append(a);
+            arrayChunk.count++;
+        }
+        ElementRecord r{};
+        r.type = static_cast<uint32_t>(e.type);
+        r.id = strings.intern(e.id);
+        r.label = strings.intern(e.label);
+        r.meshPath = strings.intern(e.meshSourcePath);
+        r.mesh = e.mesh ? meshIndex[e.mesh.get()] : kNoMesh;
+        r.flags = (e.visible ? kFlagVisible : 0u) | (e.locked ? kFlagLocked : 0u) |
+                  (e.showLabel ? kFlagShowLabel : 0u) | (e.optics.sourceIsWhiteLight ? kFlagWhiteLight : 0u);
+        r.layer = e.layer;
+        r.opticalType = static_cast<int32_t>(e.optics.opticalType);
+        r.sourceRayCount = e.optics.sourceRayCount;
+        copyVec3(r.position, e.transform.position);
+        r.rotation[0] = e.transform.rotation.x;
+        r.rotation[1] = e.transform.rotation.y;
+        r.rotation[2] = e.transform.rotation.z;
+        r.rotation[3] = e.transform.rotation.w;
+        copyVec3(r.scale, e.transform.scale);
+        r.ior = e.optics.ior;
+        r.reflectivity = e.optics.reflectivity;
+        r.transmissivity = e.optics.transmissivity;
+        r.focalLength = e.optics.focalLength;
+        r.curvatureR1 = e.optics.curvatureR1;
+        r.curvatureR2 = e.optics.curvatureR2;
+        r.apertureDiameter = e.optics.apertureDiameter;
+        r.gratingLineDensity = e.optics.gratingLineDensity;
+        copyVec3(r.filterColor, e.optics.filterColor);
+        r.cauchyB = e.optics.cauchyB;
+        r.sourceBeamWidth = e.optics.sourceBeamWidth;
+        r.metallic = e.material.metallic;
+        r.roughness = e.material.roughness;
+        r.transparency = e.material.transparency;
+        r.fresnelIOR = e.material.fresnelIOR;
+        elementChunk.append(r);
+        elementChunk.count++;
+    }
+
+    Chunk beamChunk("BEAM");
+    for (const auto& beam : scene->getBeams()) {
+        if (!beam) continue;
+        const Beam& b = *beam;
+        BeamRecord r{};
+        r.id = strings.intern(b.id);
+        r.label = strings.intern(b.label);
+        r.sourceId = strings.intern(b.sourceElementId);
+        r.flags = (b.visible ? kFlagVisible : 0u) | (b.isTraced ? kFlagTraced : 0u) | (b.isGaussian ? kFlagGaussian : 0u);
+        r.layer = b.layer;
+        copyVec3(r.start, b.start);
+        copyVec3(r.end, b.end);
+        copyVec3(r.color, b.color);
+        r.width = b.width;
+        r.intensity = b.intensity;
+        r.waistW0 = b.waistW0;
+        r.wavelength = b.wavelength;
+        r.waistPosition = b.waistPosition;
+        beamChunk.append(r);
+        beamChunk.count++;
+    }
+
+    Chunk tracedChunk("TRAY");
+    const TracedRayBuffer& traced = scene->getTracedRays();
+    tracedChunk.bytes.reserve(traced.size() * sizeof(TracedRayRecord));
+    for (size_t i = 0; i < traced.size(); i++) {
+        TracedRayRecord r{};
+        copyVec3(r.start, traced.start[i]);
+        copyVec3(r.end, traced.end[i]);
+        copyVec3(r.color, traced.color[i]);
+        r.intensity = traced.intensity[i];
+        r.sourceId = strings.intern(traced.sourceIds[traced.source[i]]);
+        tracedChunk.append(r);
+        tracedChunk.count++;
+    }
+
+    Chunk annotationChunk("ANNO");
+    for (const auto& ann : scene->getAnnotations()) {
+        if (!ann) continue;
+        AnnotationRecord r{};
+        r.id = strings.intern(ann->id);
+        r.label = strings.intern(ann->label);
+        r.text = strings.intern(ann->text);
+        r.flags = ann->visible ? kFlagVisible : 0u;
+        r.layer = ann->layer;
+        copyVec3(r.position, ann->position);
+        copyVec3(r.color, ann->color);
+        r.fontSize = ann->fontSize;
+        annotationChunk.append(r);
+        annotationChunk.count++;
+    }
+
+    Chunk measurementChunk("MEAS");
+    for (const auto& meas : scene->getMeasurements()) {
+        if (!meas) continue;
+        MeasurementRecord r{};
+        r.id = strings.intern(meas->id);
+        r.label = strings.intern(meas->label);
+        r.flags = meas->visible ? kFlagVisible : 0u;
+        r.layer = meas->layer;
+        copyVec3(r.start, meas->startPoint);
+        copyVec3(r.end, meas->endPoint);
+        copyVec3(r.color, meas->color);
+        r.fontSize = meas->fontSize;
+        measurementChunk.append(r);
+        measurementChunk.count++;
+    }
+
+    Chunk groupChunk("GRUP");
+    Chunk memberChunk("GMEM");
+    for (const auto& g : scene->getGroups()) {
+        GroupRecord r{};
+        r.id = strings.intern(g.id);
+        r.name = strings.intern(g.name);
+        r.firstMember = memberChunk.count;
+        r.memberCount = static_cast<uint32_t>(g.members.size());
+        for (ObjectHandle member : g.members) {
+            memberChunk.append(strings.intern(scene->getObjectId(member)));
+            memberChunk.count++;
+        }
+        groupChunk.append(r);
+        groupChunk.count++;
+    }
+
+    Chunk viewChunk("VIEW");
+    for (const auto& vp : scene->getViewPresets()) {
+        ViewPresetRecord r{};
+        r.name = strings.intern(vp.name);
+        r.mode = static_cast<int32_t>(vp.mode);
+        copyVec3(r.position, vp.position);
+        copyVec3(r.target, vp.target);
+        copyVec3(r.up, vp.up);
+        r.fov = vp.fov;
+        r.orthoSize = vp.orthoSize;
+        r.distance = vp.distance;
+        r.azimuth = vp.azimuth;
+        r.elevation = vp.elevation;
+        viewChunk.append(r);
+        viewChunk.count++;
+    }
+
+    // Style is small and evolves often; it is kept as the text block
+    Chunk styleChunk("STYL");
+    if (style) {
+        std::string text;
+        writeStyleBlock(text, *style);
+        styleChunk.bytes.assign(text.begin(), text.end());
+        styleChunk.count = 1;
+    }
+
+    // String table last to build, first in the file: offsets[count + 1], then the bytes
+    Chunk stringChunk("STRS");
+    const auto& all = strings.all();
+    stringChunk.count = static_cast<uint32_t>(all.size());
+    uint32_t offset = 0;
+    for (const auto& s : all) {
+        stringChunk.append(offset);
+        offset += static_cast<uint32_t>(s.size());
+    }
+    stringChunk.append(offset);
+    for (const auto& s : all) stringChunk.bytes.insert(stringChunk.bytes.end(), s.begin(), s.end());
+
+    chunks.push_back(std::move(stringChunk));
+    for (auto& c : meshChunks) chunks.push_back(std::move(c));
+    chunks.push_back(std::move(elementChunk));
+    if (arrayChunk.count > 0) {
+        chunks.push_back(std::move(arrayChunk));
+        chunks.push_back(std::move(arrayInstanceChunk));
+    }
+    chunks.push_back(std::move(beamChunk));
+    chunks.push_back(std::move(tracedChunk));
+    chunks.push_back(std::move(annotationChunk));
+    chunks.push_back(std::move(measurementChunk));
+    chunks.push_back(std::move(groupChunk));
+    chunks.push_back(std::move(memberChunk));
+    chunks.push_back(std::move(viewChunk));
+    if (style) chunks.push_back(std::move(styleChunk));
+
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return false;
+
+    FileHeader header{};
+    std::memcpy(header.magic, kBinaryMagic, sizeof(header.magic));
+    header.version = kBinaryVersion;
+    header.chunkCount = static_cast<uint32_t>(chunks.size());
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    size_t meshOrdinal = 0;
+    for (const Chunk& c : chunks) {
+        ChunkHeader ch{};
+        std::memcpy(ch.tag, c.tag, 4);
+        ch.count = c.count;
+        ch.size = c.mesh ? meshPayloadSize(*c.mesh) : c.bytes.size();
+        f.write(reinterpret_cast<const char*>(&ch), sizeof(ch));
+        if (c.mesh) {
+            writeMeshPayload(f, *c.mesh, meshPathIds[meshOrdinal++]);
+        } else {
+            f.write(reinterpret_cast<const char*>(c.bytes.data()), static_cast<std::streamsize>(c.bytes.size()));
+        }
+    }
+    f.flush();
+    return f.good();
+}
+
+// ---------------------------------------------------------------------------
+// Reading
+
+namespace {
+
+struct ChunkView {
+    char tag[4];
+    uint32_t count;
+    const unsigned char* data;
+    uint64_t size;
+
+    bool is(const char* t) const { return std::memcmp(tag, t, 4) == 0; }
+};
+
+// Bounds-checked access to the string table in the mapped file
+struct StringView {
+    const unsigned char* offsets = nullptr;
+    const char* bytes = nullptr;
+    uint32_t count = 0;
+    uint64_t byteCount = 0;
+
+    std::string get(uint32_t index) const {
+        if (index >= count) return std::string();
+        uint32_t begin, end;
+        std::memcpy(&begin, offsets + index * sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(&end, offsets + (index + 1) * sizeof(uint32_t), sizeof(uint32_t));
+        if (begin > end || end > byteCount) return std::string();
+        return std::string(bytes + begin, end - begin);
+    }
+};
+
+} // namespace
+
+// Records are copied out with memcpy: the mapped payloads carry no alignment guarantee
+template <typename Record>
+static bool readRecords(const ChunkView& chunk, std::vector<Record>& out) {
+    if (chunk.size != static_cast<uint64_t>(chunk.count) * sizeof(Record)) return false;
+    out.resize(chunk.count);
+    if (chunk.count > 0) std::memcpy(out.data(), chunk.data, chunk.count * sizeof(Record));
+    return true;
+}
+
+static bool readMeshRecord(const unsigned char* data, uint64_t size, MeshRecord& record) {
+    if (size < sizeof(MeshRecord)) return false;
+    std::memcpy(&record, data, sizeof(record));
+    uint64_t headerSize = sizeof(MeshRecord) + static_cast<uint64_t>(record.levelCount) * sizeof(MeshLevelRecord);
+    return record.levelCount > 0 && headerSize <= size;
+}
+
+// Build an asset from a MESH chunk payload, or reuse the live one with the same source and hash
+static MeshAssetRef readMesh(const ChunkView& chunk, const std::string& sourcePath) {
+    MeshRecord record;
+    if (!readMeshRecord(chunk.data, chunk.size, record)) return nullptr;
+    uint64_t headerSize = sizeof(MeshRecord) + static_cast<uint64_t>(record.levelCount) * sizeof(MeshLevelRecord);
+    if (MeshAssetRef existing = MeshStore::instance().find(sourcePath, record.contentHash)) return existing;
+
+    std::vector<MeshLevelRecord> levels(record.levelCount);
+    std::memcpy(levels.data(), chunk.data + sizeof(MeshRecord), levels.size() * sizeof(MeshLevelRecord));
+    uint64_t dataSize = 0;
+    for (const auto& level : levels) dataSize += level.vertexFloats * sizeof(float) + level.indexCount * sizeof(uint32_t);
+    if (headerSize + dataSize != chunk.size) return nullptr;
+
+    auto asset = std::make_shared<MeshAsset>();
+    asset->sourcePath = sourcePath;
+    asset->contentHash = record.contentHash;
+    asset->boundsMin = toVec3(record.boundsMin);
+    asset->boundsMax = toVec3(record.boundsMax);
+
+    // Straight block copies out of the mapping; no text parsing or welding
+    const unsigned char* cursor = chunk.data + headerSize;
+    auto readLevel = [&](const MeshLevelRecord& level, std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+        vertices.resize(level.vertexFloats);
+        std::memcpy(vertices.data(), cursor, vertices.size() * sizeof(float));
+        cursor += vertices.size() * sizeof(float);
+        indices.resize(level.indexCount);
+        std::memcpy(indices.data(), cursor, indices.size() * sizeof(uint32_t));
+        cursor += indices.size() * sizeof(uint32_t);
+    };
+    readLevel(levels[0], asset->vertices, asset->indices);
+    asset->lods.resize(levels.size() - 1);
+    for (size_t i = 1; i < levels.size(); i++) readLevel(levels[i], asset->lods[i - 1].vertices, asset->lods[i - 1].indices);
+
+    // Indices must stay inside their level's vertex range
+    auto indicesValid = [](const std::vector<float>& v, const std::vector<uint32_t>& idx) {
+        size_t vertexCount = v.size() / 6;
+        for (uint32_t i : idx) if (i >= vertexCount) return false;
+        return true;
+    };
+    if (!indicesValid(asset->vertices, asset->indices)) return nullptr;
+    for (const MeshLod& lod : asset->lods) if (!indicesValid(lod.vertices, lod.indices)) return nullptr;
+    asset->bvh.build(asset->vertices, asset->indices);
+
+    return MeshStore::instance().adopt(std::move(asset));
+}
+
+std::shared_ptr<const MeshAsset> loadProjectMesh(const std::string& path, uint64_t offset, uint64_t size,
+                                                 const std::string& sourcePath, uint64_t contentHash) {
+    MappedFile file;
+    if (!file.open(path) || offset > file.size() || size > file.size() - offset) return nullptr;
+    ChunkView chunk;
+    std::memcpy(chunk.tag, "MESH", 4);
+    chunk.count = 1;
+    chunk.data = file.data() + offset;
+    chunk.size = size;
+    // The file may have been overwritten since it was opened
+    MeshRecord record;
+    if (!readMeshRecord(chunk.data, chunk.size, record) || record.contentHash != contentHash) return nullptr;
+    return readMesh(chunk, sourcePath);
+}
+
+bool isBinaryProjectFile(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    char magic[sizeof(kBinaryMagic)] = {};
+    f.read(magic, sizeof(magic));
+    return f.gcount() == sizeof(magic) && std::memcmp(magic, kBinaryMagic, sizeof(magic)) == 0;
+}
+
+bool loadProjectBinary(const std::string& path, Scene* scene, SceneStyle* style, MeshStreamer* streamer) {
+    if (!scene) return false;
+    MappedFile file;
+    if (!file.open(path)) return false;
+
+    const unsigned char* data = file.data();
+    uint64_t size = file.size();
+    if (size < sizeof(FileHeader)) return false;
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0) return false;
+    if (header.version != kBinaryVersion) {
+        std::cerr << "Unsupported binary project version " << header.version << ": " << path << "\n";
+        return false;
+    }
+
+    // Chunk directory; validated completely before the scene is touched
+    std::vector<ChunkView> chunks;
+    uint64_t offset = sizeof(FileHeader);
+    for (uint32_t i = 0; i < header.chunkCount; i++) {
+        if (size - offset < sizeof(ChunkHeader)) return false;
+        ChunkHeader ch;
+        std::memcpy(&ch, data + offset, sizeof(ch));
+        offset += sizeof(ChunkHeader);
+        if (ch.size > size - offset) return false;
+        ChunkView view;
+        std::memcpy(view.tag, ch.tag, 4);
+        view.count = ch.count;
+        view.data = data + offset;
+        view.size = ch.size;
+        chunks.push_back(view);
+        offset += ch.size;
+    }
+
+    StringView strings;
+    for (const ChunkView& c : chunks) {
+        if (!c.is("STRS")) continue;
+        uint64_t tableBytes = (static_cast<uint64_t>(c.count) + 1) * sizeof(uint32_t);
+        if (tableBytes > c.size) return false;
+        strings.offsets = c.data;
+        strings.bytes = reinterpret_cast<const char*>(c.data + tableBytes);
+        strings.count = c.count;
+        strings.byteCount = c.size - tableBytes;
+    }
+
+    std::vector<ElementRecord> elements;
+    std::vector<ArrayRecord> arrays;
+    std::vector<ArrayInstanceRecord> arrayInstances;
+    std::vector<BeamRecord> beams;
+    std::vector<TracedRayRecord> tracedRays;
+    std::vector<AnnotationRecord> annotations;
+    std::vector<MeasurementRecord> measurements;
+    std::vector<GroupRecord> groups;
+    std::vector<uint32_t> groupMembers;
+    std::vector<ViewPresetRecord> viewPresets;
+    std::vector<const ChunkView*> meshChunks;
+    const ChunkView* styleChunk = nullptr;
+    for (const ChunkView& c : chunks) {
+        bool ok = true;
+        if (c.is("ELEM")) ok = readRecords(c, elements);
+        else if (c.is("ARRY")) ok = readRecords(c, arrays);
+        else if (c.is("AINS")) ok = readRecords(c, arrayInstances);
+        else if (c.is("BEAM")) ok = readRecords(c, beams);
+        else if (c.is("TRAY")) ok = readRecords(c, tracedRays);
+        else if (c.is("ANNO")) ok = readRecords(c, annotations);
+        else if (c.is("MEAS")) ok = readRecords(c, measurements);
+        else if (c.is("GRUP")) ok = readRecords(c, groups);
+        else if (c.is("GMEM")) ok = readRecords(c, groupMembers);
+        else if (c.is("VIEW")) ok = readRecords(c, viewPresets);
+        else if (c.is("MESH")) meshChunks.push_back(&c);
+        else if (c.is("STYL")) styleChunk = &c;
+        if (!ok) return false;
+    }
+
+    // Meshes are resolved before clearing: a failure leaves the current scene intact, and
+    // clearing first could free assets this file would otherwise share. With a streamer,
+    // only live assets are picked up here; the rest are read by its worker later.
+    std::vector<MeshAssetRef> meshes(meshChunks.size());
+    std::vector<MeshRecord> meshRecords(meshChunks.size());
+    std::vector<std::string> meshPaths(meshChunks.size());
+    std::vector<bool> meshValid(meshChunks.size(), false);
+    for (size_t i = 0; i < meshChunks.size(); i++) {
+        if (!readMeshRecord(meshChunks[i]->data, meshChunks[i]->size, meshRecords[i])) continue;
+        meshValid[i] = true;
+        meshPaths[i] = strings.get(meshRecords[i].sourcePath);
+        if (streamer) meshes[i] = MeshStore::instance().find(meshPaths[i], meshRecords[i].contentHash);
+        else meshes[i] = readMesh(*meshChunks[i], meshPaths[i]);
+    }
+
+    scene->clear();
+    if (streamer) streamer->clear();
+
+    // ELEM index -> element created from it (records that fail to load are skipped)
+    std::vector<Element*> loadedElements(elements.size(), nullptr);
+    for (size_t index = 0; index < elements.size(); index++) {
+        const ElementRecord& r = elements[index];
+        ElementType type = r.type <= static_cast<uint32_t>(ElementType::ImportedMesh)
+                               ? static_cast<ElementType>(r.type) : ElementType::Laser;
+        std::string id = strings.get(r.id);
+        std::unique_ptr<Element> elem;
+        if (type == ElementType::ImportedMesh) {
+            std::string meshPath = strings.get(r.meshPath);
+            bool embedded = r.mesh < meshChunks.size() && meshValid[r.mesh];
+            if (meshPath.empty() && embedded) meshPath = meshPaths[r.mesh];
+            if (embedded && meshes[r.mesh]) {
+                elem = createMeshElement(meshes[r.mesh], id);
+            } else if (streamer && !meshPath.empty()) {
+                // Placeholder with the stored bounds; the payload streams in later
+                DeferredMeshSource source;
+                source.sourcePath = meshPath;
+                elem = createMeshPlaceholder(meshPath, id);
+                if (embedded) {
+                    const MeshRecord& record = meshRecords[r.mesh];
+                    source.projectPath = path;
+                    source.chunkOffset = static_cast<uint64_t>(meshChunks[r.mesh]->data - data);
+                    source.chunkSize = meshChunks[r.mesh]->size;
+                    source.contentHash = record.contentHash;
+                    elem->boundsMin = toVec3(record.boundsMin);
+                    elem->boundsMax = toVec3(record.boundsMax);
+                }
+                streamer->add(source);
+            } else if (!meshPath.empty()) {
+                // Blob missing or corrupt: fall back to the source OBJ
+                elem = createMeshElement(meshPath, id);
+            }
+        } else {
+            elem = createElement(type, id);
+        }
+        if (!elem) continue;
+
+        elem->label = strings.get(r.label);
+        elem->meshSourcePath = strings.get(r.meshPath);
+        elem->transform.position = toVec3(r.position);
+        elem->transform.rotation = glm::quat(r.rotation[3], r.rotation[0], r.rotation[1], r.rotation[2]);
+        elem->transform.scale = toVec3(r.scale);
+        elem->markTransformDirty();
+        elem->visible = (r.flags & kFlagVisible) != 0;
+        elem->locked = (r.flags & kFlagLocked) != 0;
+        elem->showLabel = (r.flags & kFlagShowLabel) != 0;
+        elem->layer = r.layer;
+        if (r.opticalType >= 0 && r.opticalType <= static_cast<int32_t>(OpticalType::FiberCoupler))
+            elem->optics.opticalType = static_cast<OpticalType>(r.opticalType);
+        elem->optics.ior = r.ior;
+        elem->optics.reflectivity = r.reflectivity;
+        elem->optics.transmissivity = r.transmissivity;
+        elem->optics.focalLength = r.focalLength;
+        elem->optics.curvatureR1 = r.curvatureR1;
+        elem->optics.curvatureR2 = r.curvatureR2;
+        elem->optics.apertureDiameter = r.apertureDiameter;
+        elem->optics.gratingLineDensity = r.gratingLineDensity;
+        elem->optics.filterColor = toVec3(r.filterColor);
+        elem->optics.cauchyB = r.cauchyB;
+        elem->optics.sourceRayCount = r.sourceRayCount;
+        elem->optics.sourceBeamWidth = r.sourceBeamWidth;
+        elem->optics.sourceIsWhiteLight = (r.flags & kFlagWhiteLight) != 0;
+        elem->material.metallic = r.metallic;
+        elem->material.roughness = r.roughness;
+        elem->material.transparency = r.transparency;
+        elem->material.fresnelIOR = r.fresnelIOR;
+        loadedElements[index] = elem.get();
+        scene->addElement(std::move(elem));
+    }
+
+    for (const ArrayRecord& r : arrays) {
+        if (r.element >= loadedElements.size() || !loadedElements[r.element]) continue;
+        ElementArray& array = loadedElements[r.element]->array;
+        array.count = glm::max(glm::ivec3(r.count[0], r.count[1], r.count[2]), glm::ivec3(1));
+        array.pitch = toVec3(r.pitch);
+        if (static_cast<uint64_t>(r.firstInstance) + r.instanceCount <= arrayInstances.size()) {
+            for (uint32_t i = 0; i < r.instanceCount && array.size() < ElementArray::kMaxInstances; i++) {
+                const ArrayInstanceRecord& ir = arrayInstances[r.firstInstance + i];
+                Transform t;
+                t.position = toVec3(ir.position);
+                t.rotation = glm::quat(ir.rotation[3], ir.rotation[0], ir.rotation[1], ir.rotation[2]);
+                t.scale = toVec3(ir.scale);
+                array.instances.push_back(t);
+            }
+        }
+        loadedElements[r.element]->markTransformDirty();
+    }
+
+    TracedRayBuffer& rays = scene->getTracedRays();
+    rays.reserve(tracedRays.size());
+    for (const BeamRecord& r : beams) {
+        // Traced segments belong in the traced ray buffer, as in the text loader
+        if (r.flags & kFlagTraced) {
+            rays.add(toVec3(r.start), toVec3(r.end), toVec3(r.color), r.intensity,
+                     rays.sourceIndex(strings.get(r.sourceId)));
+            continue;
+        }
+        auto beam = std::make_unique<Beam>(strings.get(r.id));
+        beam->label = strings.get(r.label);
+        beam->start = toVec3(r.start);
+        beam->end = toVec3(r.end);
+        beam->color = toVec3(r.color);
+        beam->width = r.width;
+        beam->intensity = r.intensity;
+        beam->visible = (r.flags & kFlagVisible) != 0;
+        beam->layer = r.layer;
+        beam->isGaussian = (r.flags & kFlagGaussian) != 0;
+        beam->waistW0 = r.waistW0;
+        beam->wavelength = r.wavelength;
+        beam->waistPosition = r.waistPosition;
+        scene->addBeam(std::move(beam));
+    }
+    for (const TracedRayRecord& r : tracedRays) {
+        rays.add(toVec3(r.start), toVec3(r.end), toVec3(r.color), r.intensity,
+                 rays.sourceIndex(strings.get(r.sourceId)));
+    }
+
+    for (const AnnotationRecord& r : annotations) {
+        std::string id = strings.get(r.id);
+        auto ann = std::make_unique<Annotation>(id.empty() ? Annotation::generateId() : id);
+        ann->label = strings.get(r.label);
+        ann->text = strings.get(r.text);
+        ann->position = toVec3(r.position);
+        ann->color = toVec3(r.color);
+        ann->fontSize = r.fontSize;
+        ann->visible = (r.flags & kFlagVisible) != 0;
+        ann->layer = r.layer;
+        scene->addAnnotation(std::move(ann));
+    }
+
+    for (const MeasurementRecord& r : measurements) {
+        std::string id = strings.get(r.id);
+        auto meas = std::make_unique<Measurement>(id.empty() ? Measurement::generateId() : id);
+        meas->label = strings.get(r.label);
+        meas->startPoint = toVec3(r.start);
+        meas->endPoint = toVec3(r.end);
+        meas->color = toVec3(r.color);
+        meas->fontSize = r.fontSize;
+        meas->visible = (r.flags & kFlagVisible) != 0;
+        meas->layer = r.layer;
+        scene->addMeasurement(std::move(meas));
+    }
+
+    for (const GroupRecord& r : groups) {
+        Group g;
+        g.id = strings.get(r.id);
+        g.name = strings.get(r.name);
+        if (static_cast<uint64_t>(r.firstMember) + r.memberCount <= groupMembers.size()) {
+            for (uint32_t i = 0; i < r.memberCount; i++)
+                g.members.push_back(scene->getObjectHandle(strings.get(groupMembers[r.firstMember + i])));
+        }
+        if (g.id.empty()) g.id = Group::generateId();
+        scene->addGroup(g);
+    }
+
+    for (const ViewPresetRecord& r : viewPresets) {
+        ViewPreset vp;
+        vp.name = strings.get(r.name);
+        vp.mode = static_cast<CameraMode>(r.mode);
+        vp.position = toVec3(r.position);
+        vp.target = toVec3(r.target);
+        vp.up = toVec3(r.up);
+        vp.fov = r.fov;
+        vp.orthoSize = r.orthoSize;
+        vp.distance = r.distance;
+        vp.azimuth = r.azimuth;
+        vp.elevation = r.elevation;
+        scene->addViewPreset(vp);
+    }
+
+    if (styleChunk && style) {
+        readStyleBlock(std::string_view(reinterpret_cast<const char*>(styleChunk->data), styleChunk->size), style);
+    }
+    return true;
+}
+
+} // namespace opticsketch
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace opticsketch {
+
+class Scene;
+class MeshStreamer;
+struct SceneStyle;
+struct MeshAsset;
+
+// Chunked binary project format (.optskb): a header, a string table, fixed-layout
+// records for scene objects and raw mesh blobs. Imported meshes are embedded, so on
+// load they are used straight from the memory-mapped file without re-parsing the OBJ.
+bool saveProjectBinary(const std::string& path, Scene* scene, SceneStyle* style = nullptr);
+// With a streamer, embedded meshes not already live are left to it (elements start as
+// placeholders) instead of being read before the function returns.
+bool loadProjectBinary(const std::string& path, Scene* scene, SceneStyle* style = nullptr,
+                       MeshStreamer* streamer = nullptr);
+
+// Read one embedded mesh: the MESH chunk payload at 'offset'. Returns nullptr if the
+// file no longer holds a mesh with 'contentHash' there.
+std::shared_ptr<const MeshAsset> loadProjectMesh(const std::string& path, uint64_t offset, uint64_t size,
+                                                 const std::string& sourcePath, uint64_t contentHash);
+
+// True if the file starts with the binary project magic
+bool isBinaryProjectFile(const std::string& path);
+
+} // namespace opticsketch
@@ -0,0 +1,326 @@
+#include "project/project_journal.h"
+#include "project/project.h"
+#include "project/project_text.h"
+#include "scene/scene.h"
+#include "render/beam.h"
+#include "elements/annotation.h"
+#include "elements/measurement.h"
+#include "style/scene_style.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace opticsketch {
+
+namespace fs = std::filesystem;
+
+static constexpr const char* kJournalMagic = "optskjournal 2";
+// Compact once the journal outgrows half the base, but never over less than this
+static constexpr size_t kMinCompactBytes = size_t(1) << 20;
+
+static uint64_t hashBytes(const char* data, size_t size, uint64_t h = 1469598103934665603ull) {
+    for (size_t i = 0; i < size; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t hashText(const std::string& s) {
+    return hashBytes(s.data(), s.size());
+}
+
+// Size and content hash of a base file, as stamped into its journal
+static bool stampBase(const std::string& path, ProjectJournal::BaseStamp& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    out = {};
+    out.hash = 1469598103934665603ull;
+    char buffer[1 << 16];
+    while (in) {
+        in.read(buffer, sizeof(buffer));
+        size_t got = static_cast<size_t>(in.gcount());
+        out.hash = hashBytes(buffer, got, out.hash);
+        out.bytes += got;
+    }
+    return in.eof();
+}
+
+// Append and flush to disk before returning: a save that reports success is durable
+static bool appendFileDurable(const std::string& path, const std::string& text) {
+    FILE* f = std::fopen(path.c_str(), "ab");
+    if (!f) return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = ok && std::fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = (std::fclose(f) == 0) && ok;
+    return ok;
+}
+
+// Base stamp recorded in a journal's first line; false if it is not a journal
+static bool readJournalStamp(std::string_view header, ProjectJournal::BaseStamp& base) {
+    std::string_view magic(kJournalMagic);
+    if (header.size() <= magic.size() || header.compare(0, magic.size(), magic) != 0) return false;
+    std::istringstream in(std::string(header.substr(magic.size())));
+    return static_cast<bool>(in >> base.bytes >> std::hex >> base.hash);
+}
+
+std::string ProjectJournal::journalPath(const std::string& projectPath) {
+    return projectPath + ".journal";
+}
+
+void ProjectJournal::capture(const Scene& scene, const SceneStyle* style, State& out,
+                             const State* previous, std::string* batch) {
+    out.records.clear();
+    out.records.reserve(scene.getElements().size() + scene.getBeams().size() +
+                        scene.getAnnotations().size() + scene.getMeasurements().size());
+    std::string record;
+    std::string key;
+    auto visit = [&](char kind, const std::string& id) {
+        uint64_t h = hashText(record);
+        key.assign(1, kind);
+        key += id;
+        if (batch) {
+            auto it = previous->records.find(key);
+            if (it == previous->records.end() || it->second != h) batch->append(record);
+        }
+        out.records.emplace(key, h);
+        record.clear();
+    };
+    for (const auto& e : scene.getElements()) {
+        writeElementRecord(record, *e);
+        visit('e', e->id);
+    }
+    for (const auto& b : scene.getBeams()) {
+        writeBeamRecord(record, *b);
+        visit('b', b->id);
+    }
+    for (const auto& a : scene.getAnnotations()) {
+        writeAnnotationRecord(record, *a);
+        visit('a', a->id);
+    }
+    for (const auto& m : scene.getMeasurements()) {
+        writeMeasurementRecord(record, *m);
+        visit('m', m->id);
+    }
+    if (batch) {
+        for (const auto& entry : previous->records) {
+            if (out.records.count(entry.first)) continue;
+            *batch += "@remove ";
+            batch->append(entry.first, 1, std::string::npos);
+            *batch += '\n';
+        }
+    }
+
+    // Small whole-scene lists: replaced as a unit
+    for (const Group& g : scene.getGroups()) writeGroupRecord(record, scene, g);
+    out.groups = hashText(record);
+    if (batch && out.groups != previous->groups) {
+        *batch += "@groups\n";
+        batch->append(record);
+    }
+    record.clear();
+    for (const ViewPreset& vp : scene.getViewPresets()) writeViewPresetRecord(record, vp);
+    out.presets = hashText(record);
+    if (batch && out.presets != previous->presets) {
+        *batch += "@viewpresets\n";
+        batch->append(record);
+    }
+    record.clear();
+    if (style) writeStyleBlock(record, *style);
+    out.style = hashText(record);
+    if (batch && style && out.style != previous->style) batch->append(record);
+}
+
+void ProjectJournal::attach(const std::string& path, const Scene& scene, const SceneStyle* style) {
+    attached = false;
+    projectPath = path;
+    journalBytes = 0;
+    if (!stampBase(path, base)) return;
+
+    std::error_code ec;
+    std::string journal = journalPath(path);
+    if (fs::exists(journal, ec)) {
+        std::ifstream in(journal, std::ios::binary);
+        std::string header;
+        BaseStamp stamp;
+        // A stale journal is left for the next save to replace
+        if (!std::getline(in, header) || !readJournalStamp(header, stamp) || !(stamp == base)) return;
+        journalBytes = static_cast<size_t>(fs::file_size(journal, ec));
+    }
+    capture(scene, style, state, nullptr, nullptr);
+    attached = true;
+}
+
+void ProjectJournal::detach() {
+    attached = false;
+    projectPath.clear();
+    journalBytes = 0;
+    state = State{};
+}
+
+bool ProjectJournal::save(const std::string& path, Scene* scene, SceneStyle* style, bool compact) {
+    if (!scene) return false;
+    bool canAppend = enabled && !compact && attached && path == projectPath &&
+                     journalBytes < std::max<uint64_t>(kMinCompactBytes, base.bytes / 2);
+    if (canAppend && append(scene, style)) return true;
+    return saveFull(path, scene, style);
+}
+
+bool ProjectJournal::saveFull(const std::string& path, Scene* scene, SceneStyle* style) {
+    attached = false;
+    if (!saveProject(path, scene, style)) return false;
+    std::error_code ec;
+    fs::remove(journalPath(path), ec);
+    if (ec) {
+        std::cerr << "Could not remove project journal " << journalPath(path) << ": " << ec.message() << "\n";
+        return true;    // the base is saved; the stale journal is ignored by its stamp
+    }
+    if (!stampBase(path, base)) return true;
+    projectPath = path;
+    journalBytes = 0;
+    capture(*scene, style, state, nullptr, nullptr);
+    attached = true;
+    return true;
+}
+
+bool ProjectJournal::append(Scene* scene, SceneStyle* style) {
+    State next;
+    std::string batch;
+    capture(*scene, style, next, &state, &batch);
+    if (batch.empty()) {
+        state = std::move(next);
+        return true;    // nothing changed since the last save
+    }
+
+    std::string out;
+    if (journalBytes == 0) {
+        out += kJournalMagic;
+        out += ' ';
+        char stamp[48];
+        std::snprintf(stamp, sizeof(stamp), "%llu %016llx", static_cast<unsigned long long>(base.bytes),
+                      static_cast<unsigned long long>(base.hash));
+        out += stamp;
+        out += '\n';
+    }
+    // The leading blank line keeps a batch torn by a crash from running into this one
+    out += "\n@batch\n";
+    out += batch;
+    out += "@end\n";
+    if (!appendFileDurable(journalPath(projectPath), out)) {
+        attached = false;   // the journal may hold a partial batch: start over with a full save
+        return false;
+    }
+    journalBytes += out.size();
+    state = std::move(next);
+    return true;
+}
+
+// Apply one complete batch: removals, then the records (replacing objects with the same id)
+static bool applyBatch(std::string_view text, const std::unordered_set<std::string>& removed,
+                       bool groupsReplaced, bool presetsReplaced,
+                       Scene* scene, SceneStyle* style, MeshStreamer* streamer) {
+    Scene records;
+    if (!readProjectRecords(text, &records, style, streamer)) return false;
+    if (!removed.empty()) scene->removeObjects(removed);
+
+    // Group members are handles of the scratch scene until re-interned here
+    std::vector<Group> groups;
+    if (groupsReplaced) {
+        for (const Group& g : records.getGroups()) {
+            Group copy;
+            copy.id = g.id;
+            copy.name = g.name;
+            for (ObjectHandle member : g.members)
+                copy.members.push_back(scene->getObjectHandle(records.getObjectId(member)));
+            groups.push_back(std::move(copy));
+        }
+    }
+    std::vector<ViewPreset> presets = records.getViewPresets();
+
+    scene->mergeObjects(records);
+    if (groupsReplaced) {
+        while (!scene->getGroups().empty()) scene->removeGroup(scene->getGroups().front().id);
+        for (const Group& g : groups) scene->addGroup(g);
+    }
+    if (presetsReplaced) {
+        while (!scene->getViewPresets().empty()) scene->removeViewPreset(0);
+        for (const ViewPreset& vp : presets) scene->addViewPreset(vp);
+    }
+    return true;
+}
+
+bool replayProjectJournal(const std::string& path, Scene* scene, SceneStyle* style, MeshStreamer* streamer) {
+    std::string journal = ProjectJournal::journalPath(path);
+    std::error_code ec;
+    if (!scene || !fs::exists(journal, ec)) return true;
+
+    std::ifstream in(journal, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t eol = text.find('\n');
+    ProjectJournal::BaseStamp stamp, base;
+    if (eol == std::string::npos || !readJournalStamp(std::string_view(text).substr(0, eol), stamp) ||
+        !stampBase(path, base) || !(stamp == base)) {
+        std::cerr << "Ignoring project journal " << journal << ": it does not belong to this file\n";
+        return true;
+    }
+
+    std::string_view view(text);
+    size_t pos = eol + 1;
+    size_t batchStart = std::string::npos;
+    std::unordered_set<std::string> removed;
+    bool groupsReplaced = false, presetsReplaced = false;
+    int applied = 0;
+    while (pos < view.size()) {
+        size_t end = view.find('\n', pos);
+        if (end == std::string_view::npos) end = view.size();
+        std::string_view line = view.substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        size_t lineStart = pos;
+        pos = end + 1;
+        if (line.empty() || line[0] != '@') continue;
+
+        if (line == "@batch") {
+            // A batch still open here was torn by a crash: drop it
+            batchStart = pos;
+            removed.clear();
+            groupsReplaced = presetsReplaced = false;
+        } else if (batchStart == std::string::npos) {
+            continue;
+        } else if (line == "@end") {
+            if (!applyBatch(view.substr(batchStart, lineStart - batchStart), removed, groupsReplaced,
+                            presetsReplaced, scene, style, streamer)) {
+                std::cerr << "Project journal " << journal << " is damaged; later changes were not applied\n";
+                break;
+            }
+            applied++;
+            batchStart = std::string::npos;
+        } else if (line.compare(0, 8, "@remove ") == 0) {
+            removed.emplace(line.substr(8));
+        } else if (line == "@groups") {
+            groupsReplaced = true;
+        } else if (line == "@viewpresets") {
+            presetsReplaced = true;
+        }
+    }
+    // Traced rays are not journaled; those from the base may predate the edits
+    if (applied > 0) scene->clearTracedBeams();
+    return true;
+}
+
+} // namespace opticsketch
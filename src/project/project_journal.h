@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace opticsketch {
+
+class Scene;
+class MeshStreamer;
+struct SceneStyle;
+
+// Journaled saves. A project is a base file (written by saveProject) plus an append-only
+// "<project>.journal" beside it. Each save appends one batch with the records that changed
+// since the previous save: whole element/beam/annotation/measurement records in the text
+// format, removed ids, and the style, groups and view presets when they changed. Moving
+// one mirror appends one element record instead of rewriting the project. Batches are
+// only applied when complete, so a crash mid-append loses just that save.
+//
+// The journal is compacted (the base rewritten and the journal deleted) when it grows
+// past a share of the base, or when a save asks for it. Traced rays are not journaled:
+// a project opened with a journal has them cleared, to be traced again. A journal is
+// tied to its base by the base's size and content hash, so one left beside a rewritten
+// (or restored, or hand-edited) base is ignored.
+//
+// Not thread-safe; saves are serialized by the caller (they run one job at a time).
+class ProjectJournal {
+public:
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+
+    // The scene now matches 'path' on disk (just opened, base + journal). Later saves to
+    // the same path append to its journal. An unusable journal forces a full save first.
+    void attach(const std::string& path, const Scene& scene, const SceneStyle* style);
+    // Forget the attached project (new or untitled scene)
+    void detach();
+
+    // Save to 'path': append a batch when the path is the attached project and the
+    // journal is small, otherwise (or with 'compact') write the whole project and start
+    // an empty journal
+    bool save(const std::string& path, Scene* scene, SceneStyle* style, bool compact = false);
+
+    size_t getJournalBytes() const { return journalBytes; }
+
+    // "<project>.journal"
+    static std::string journalPath(const std::string& projectPath);
+
+    // Identity of the base file a journal applies to
+    struct BaseStamp {
+        uint64_t bytes = 0;
+        uint64_t hash = 0;      // FNV-1a of the file contents
+        bool operator==(const BaseStamp& o) const { return bytes == o.bytes && hash == o.hash; }
+    };
+
+private:
+    // Record fingerprints of the scene, keyed by kind and id
+    using Fingerprints = std::unordered_map<std::string, uint64_t>;
+    struct State {
+        Fingerprints records;
+        uint64_t style = 0;
+        uint64_t groups = 0;
+        uint64_t presets = 0;
+    };
+    // Fingerprint the scene; with 'batch', append the records that differ from 'state'
+    // (and the removals) to it
+    static void capture(const Scene& scene, const SceneStyle* style, State& out,
+                        const State* previous, std::string* batch);
+    bool saveFull(const std::string& path, Scene* scene, SceneStyle* style);
+    bool append(Scene* scene, SceneStyle* style);
+
+    bool enabled = true;
+    bool attached = false;
+    std::string projectPath;
+    BaseStamp base;
+    size_t journalBytes = 0;
+    State state;
+};
+
+// Apply "<path>.journal" to a scene just loaded from 'path'. Called by loadProject; a
+// missing journal is not an error.
+bool replayProjectJournal(const std::string& path, Scene* scene, SceneStyle* style, MeshStreamer* streamer);
+
+} // namespace opticsketch
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace opticsketch {
+
+class Scene;
+class Element;
+class Beam;
+class Annotation;
+class Measurement;
+class MeshStreamer;
+struct Group;
+struct SceneStyle;
+struct ViewPreset;
+
+// Single records of the text project format, as saveProjectToString writes them
+// ("element ... end" and so on), for the project journal
+void writeElementRecord(std::string& out, const Element& e);
+void writeBeamRecord(std::string& out, const Beam& b);
+void writeAnnotationRecord(std::string& out, const Annotation& a);
+void writeMeasurementRecord(std::string& out, const Measurement& m);
+void writeGroupRecord(std::string& out, const Scene& scene, const Group& g);
+void writeViewPresetRecord(std::string& out, const ViewPreset& vp);
+
+// Add every record block in 'text' to the scene (and style); other lines are skipped
+bool readProjectRecords(std::string_view text, Scene* scene, SceneStyle* style, MeshStreamer* streamer);
+
+} // namespace opticsketch
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "scene/object_handle.h"
 #include <glm/glm.hpp>
 #include <memory>
 #include <string>
@@ -13,6 +14,7 @@ public:
     Beam(const std::string& beamId = "");
     
     std::string id;
+    ObjectHandle handle = kNoObjectHandle;   // set by the Scene it is added to
     std::string label;
     
     // Beam segment endpoints
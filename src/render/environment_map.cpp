@@ -0,0 +1,183 @@
+#include "render/environment_map.h"
+#include "render/half_float.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+namespace opticsketch {
+
+namespace fs = std::filesystem;
+
+static constexpr char kEnvironmentCacheMagic[4] = {'O', 'S', 'E', 'N'};
+static constexpr uint32_t kEnvironmentCacheVersion = 1;
+static constexpr int kMaxEnvironmentWidth = 4096;   // wider sources are halved first
+static constexpr int kMinEnvironmentWidth = 8;      // the blurriest level
+
+static std::mutex cacheDirectoryMutex;
+static std::string cacheDirectory;
+
+void setEnvironmentCacheDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(cacheDirectoryMutex);
+    cacheDirectory = directory;
+}
+
+// Identifies one version of a source file; 0 if it cannot be stat'ed
+static uint64_t sourceKey(const std::string& path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    uint64_t size = fs::file_size(path, ec);
+    if (ec) return 0;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) return 0;
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const void* data, size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; i++) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+    };
+    std::string name = absolute.string();
+    int64_t ticks = static_cast<int64_t>(mtime.time_since_epoch().count());
+    mix(name.data(), name.size());
+    mix(&size, sizeof(size));
+    mix(&ticks, sizeof(ticks));
+    return h;
+}
+
+static std::string cachePath(uint64_t key) {
+    std::lock_guard<std::mutex> lock(cacheDirectoryMutex);
+    if (cacheDirectory.empty() || key == 0) return std::string();
+    char name[32];
+    std::snprintf(name, sizeof(name), "env_%016llx.bin", static_cast<unsigned long long>(key));
+    return (fs::path(cacheDirectory) / name).string();
+}
+
+static bool readCache(const std::string& path, uint64_t key, EnvironmentMap& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    char magic[4];
+    uint32_t header[2];   // version, level count
+    uint64_t storedKey = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+    if (!in || std::memcmp(magic, kEnvironmentCacheMagic, sizeof(magic)) != 0 ||
+        header[0] != kEnvironmentCacheVersion || storedKey != key || header[1] == 0 || header[1] > 16) {
+        return false;
+    }
+    out.levels.assign(header[1], EnvironmentMap::Level{});
+    for (EnvironmentMap::Level& level : out.levels) {
+        int32_t size[2];
+        in.read(reinterpret_cast<char*>(size), sizeof(size));
+        if (!in || size[0] <= 0 || size[1] <= 0 || size[0] > kMaxEnvironmentWidth || size[1] > kMaxEnvironmentWidth)
+            return false;
+        level.width = size[0];
+        level.height = size[1];
+        level.texels.resize(static_cast<size_t>(level.width) * level.height * 3);
+        in.read(reinterpret_cast<char*>(level.texels.data()),
+                static_cast<std::streamsize>(level.texels.size() * sizeof(uint16_t)));
+    }
+    if (!in) {
+        std::cerr << "Truncated environment cache: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+static void writeCache(const std::string& path, uint64_t key, const EnvironmentMap& map) {
+    // Written aside and renamed, so a reader never sees half a file
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary);
+        uint32_t header[2] = {kEnvironmentCacheVersion, static_cast<uint32_t>(map.levels.size())};
+        out.write(kEnvironmentCacheMagic, sizeof(kEnvironmentCacheMagic));
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        for (const EnvironmentMap::Level& level : map.levels) {
+            int32_t size[2] = {level.width, level.height};
+            out.write(reinterpret_cast<const char*>(size), sizeof(size));
+            out.write(reinterpret_cast<const char*>(level.texels.data()),
+                      static_cast<std::streamsize>(level.texels.size() * sizeof(uint16_t)));
+        }
+        if (!out) {
+            std::cerr << "Failed to write environment cache: " << path << "\n";
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    if (ec) fs::remove(temp, ec);
+}
+
+// Half the size with a [1 3 3 1] tent per axis: u wraps (the map is a full turn), v clamps
+static std::vector<float> downsample(const std::vector<float>& src, int width, int height,
+                                     int& outWidth, int& outHeight) {
+    outWidth = std::max(1, width / 2);
+    outHeight = std::max(1, height / 2);
+    static constexpr float kTent[4] = {0.125f, 0.375f, 0.375f, 0.125f};
+    std::vector<float> dst(static_cast<size_t>(outWidth) * outHeight * 3, 0.0f);
+    for (int y = 0; y < outHeight; y++) {
+        for (int x = 0; x < outWidth; x++) {
+            float* texel = &dst[(static_cast<size_t>(y) * outWidth + x) * 3];
+            for (int j = 0; j < 4; j++) {
+                int sy = std::clamp(2 * y - 1 + j, 0, height - 1);
+                for (int i = 0; i < 4; i++) {
+                    int sx = ((2 * x - 1 + i) % width + width) % width;
+                    const float* s = &src[(static_cast<size_t>(sy) * width + sx) * 3];
+                    float w = kTent[i] * kTent[j];
+                    texel[0] += s[0] * w;
+                    texel[1] += s[1] * w;
+                    texel[2] += s[2] * w;
+                }
+            }
+        }
+    }
+    return dst;
+}
+
+static void appendLevel(EnvironmentMap& map, const std::vector<float>& texels, int width, int height) {
+    EnvironmentMap::Level level;
+    level.width = width;
+    level.height = height;
+    level.texels.resize(texels.size());
+    for (size_t i = 0; i < texels.size(); i++) level.texels[i] = floatToHalf(texels[i]);
+    map.levels.push_back(std::move(level));
+}
+
+static bool decodeAndPrefilter(const std::string& path, EnvironmentMap& out) {
+    // Not stbi_set_flip_vertically_on_load: it is global, and other jobs decode images too
+    int w, h, c;
+    float* data = stbi_loadf(path.c_str(), &w, &h, &c, 3);
+    if (!data) return false;
+    size_t rowFloats = static_cast<size_t>(w) * 3;
+    std::vector<float> texels(rowFloats * h);
+    for (int y = 0; y < h; y++)
+        std::memcpy(&texels[rowFloats * (h - 1 - y)], data + rowFloats * y, rowFloats * sizeof(float));
+    stbi_image_free(data);
+
+    while (w > kMaxEnvironmentWidth) texels = downsample(texels, w, h, w, h);
+    out.levels.clear();
+    appendLevel(out, texels, w, h);
+    while (w > kMinEnvironmentWidth && h > 1) {
+        texels = downsample(texels, w, h, w, h);
+        appendLevel(out, texels, w, h);
+    }
+    return true;
+}
+
+bool loadEnvironmentMap(const std::string& path, EnvironmentMap& out) {
+    uint64_t key = sourceKey(path);
+    std::string cached = cachePath(key);
+    if (!cached.empty() && readCache(cached, key, out)) return true;
+    if (!decodeAndPrefilter(path, out)) return false;
+    if (!cached.empty()) writeCache(cached, key, out);
+    return true;
+}
+
+} // namespace opticsketch
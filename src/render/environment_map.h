@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+// Prefiltered equirectangular environment for glossy reflections. Level 0 is the decoded
+// HDRI (downsampled if very wide); each further level halves it with a tent filter that
+// wraps around horizontally, so the shader can pick a blur level from the surface roughness
+// with textureLod. Texels are RGB half floats, rows bottom-up, ready for a GL_RGB16F upload.
+struct EnvironmentMap {
+    struct Level {
+        int width = 0;
+        int height = 0;
+        std::vector<uint16_t> texels;
+    };
+    std::vector<Level> levels;
+};
+
+// Directory for prefiltered environment files, keyed by the source path, size and
+// modification time; empty (the default) disables the cache
+void setEnvironmentCacheDirectory(const std::string& directory);
+
+// Worker side: read the cached levels for 'path', or decode and prefilter it and write the
+// cache. False if the file cannot be decoded.
+bool loadEnvironmentMap(const std::string& path, EnvironmentMap& out);
+
+} // namespace opticsketch
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace opticsketch {
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance), extracted
+// from a combined projection * view matrix. Used to skip off-screen draws.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    void extract(const glm::mat4& viewProj) {
+        // Rows of the matrix (glm is column-major: m[col][row])
+        glm::vec4 row[4];
+        for (int r = 0; r < 4; r++) {
+            row[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+        }
+        planes[0] = row[3] + row[0];  // left
+        planes[1] = row[3] - row[0];  // right
+        planes[2] = row[3] + row[1];  // bottom
+        planes[3] = row[3] - row[1];  // top
+        planes[4] = row[3] + row[2];  // near
+        planes[5] = row[3] - row[2];  // far
+        for (glm::vec4& p : planes) {
+            float len = glm::length(glm::vec3(p));
+            if (len > 1e-8f) p = p / len;
+        }
+    }
+
+    // Conservative: true unless the box lies entirely outside one plane
+    bool intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+        for (const glm::vec4& p : planes) {
+            // Corner farthest along the plane normal
+            glm::vec3 positive(p.x >= 0.0f ? boxMax.x : boxMin.x,
+                               p.y >= 0.0f ? boxMax.y : boxMin.y,
+                               p.z >= 0.0f ? boxMax.z : boxMin.z);
+            if (glm::dot(glm::vec3(p), positive) + p.w < 0.0f) return false;
+        }
+        return true;
+    }
+
+    bool intersectsSegment(const glm::vec3& a, const glm::vec3& b, float padding = 0.0f) const {
+        glm::vec3 pad(padding);
+        return intersectsBox(glm::min(a, b) - pad, glm::max(a, b) + pad);
+    }
+};
+
+} // namespace opticsketch
@@ -1,6 +1,7 @@
 #include "render/gizmo.h"
 #include "render/shader.h"
 #include "render/raycast.h"
+#include "profile/profiler.h"
 #include <cmath>
 #include <algorithm>
 #include <glm/gtc/matrix_inverse.hpp>
@@ -19,8 +20,6 @@ void Gizmo::render(const Camera& camera, const Element* element, GizmoType type,
                    const glm::mat3& orientation, float dragAngle, float dragStartAngle) {
     if (!element) return;
 
-    glm::mat4 view = camera.getViewMatrix();
-    glm::mat4 proj = camera.getProjectionMatrix();
     glm::vec3 position = element->getWorldBoundsCenter();
     // Gizmo vertices are built in world space; use identity model so we don't double-transform (shader does uModel * aPos)
     if (gizmoShader) gizmoShader->setMat4("uModel", glm::mat4(1.0f));
@@ -35,13 +34,13 @@ void Gizmo::render(const Camera& camera, const Element* element, GizmoType type,
 
     switch (type) {
         case GizmoType::Move:
-            renderMoveGizmo(camera, position, view, proj, viewportWidth, viewportHeight, hoveredHandle, exclusiveHandle, orientation);
+            renderMoveGizmo(camera, position, viewportWidth, viewportHeight, hoveredHandle, exclusiveHandle, orientation);
             break;
         case GizmoType::Rotate:
-            renderRotateGizmo(camera, position, view, proj, viewportWidth, viewportHeight, hoveredHandle, exclusiveHandle, orientation, dragAngle, dragStartAngle);
+            renderRotateGizmo(camera, position, viewportWidth, viewportHeight, hoveredHandle, exclusiveHandle, orientation, dragAngle, dragStartAngle);
             break;
         case GizmoType::Scale:
-            renderScaleGizmo(camera, position, view, proj, viewportWidth, viewportHeight, hoveredHandle, exclusiveHandle, orientation);
+            renderScaleGizmo(camera, position, viewportWidth, viewportHeight, hoveredHandle, exclusiveHandle, orientation);
             break;
     }
 
@@ -59,7 +58,7 @@ static float thickLineHalfWidthWorld(const glm::vec3& camPos, const glm::vec3& l
 }
 
 void Gizmo::renderMoveGizmo(const Camera& camera, const glm::vec3& position,
-                            const glm::mat4& view, const glm::mat4& proj, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation) {
+                            int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation) {
     const float axisLength = 1.0f;
     const float coneLength = 0.15f;
     const float coneRadius = 0.06f;
@@ -68,11 +67,7 @@ void Gizmo::renderMoveGizmo(const Camera& camera, const glm::vec3& position,
     if (!gizmoShader) return;
     gizmoShader->use();
     gizmoShader->setMat4("uModel", glm::mat4(1.0f));
-    gizmoShader->setMat4("uView", view);
-    gizmoShader->setMat4("uProjection", proj);
     gizmoShader->setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gizmoShader->setVec3("uLightPos", camera.position);
-    gizmoShader->setVec3("uViewPos", camera.position);
     gizmoShader->setFloat("uAlpha", 1.0f);
 
     glm::vec3 axes[3] = { orientation * glm::vec3(1,0,0), orientation * glm::vec3(0,1,0), orientation * glm::vec3(0,0,1) };
@@ -157,18 +152,14 @@ void Gizmo::renderMoveGizmo(const Camera& camera, const glm::vec3& position,
 }
 
 void Gizmo::renderRotateGizmo(const Camera& camera, const glm::vec3& position,
-                              const glm::mat4& view, const glm::mat4& proj, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation, float dragAngle, float dragStartAngle) {
+                              int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation, float dragAngle, float dragStartAngle) {
     const float radius = 0.8f;
     const int segments = 32;
     float halfWidth = thickLineHalfWidthWorld(camera.position, position, camera.fov, viewportHeight);
     if (!gizmoShader) return;
     gizmoShader->use();
     gizmoShader->setMat4("uModel", glm::mat4(1.0f));
-    gizmoShader->setMat4("uView", view);
-    gizmoShader->setMat4("uProjection", proj);
     gizmoShader->setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gizmoShader->setVec3("uLightPos", camera.position);
-    gizmoShader->setVec3("uViewPos", camera.position);
     gizmoShader->setFloat("uAlpha", 1.0f);
 
     glm::vec3 axes[3] = { orientation * glm::vec3(1,0,0), orientation * glm::vec3(0,1,0), orientation * glm::vec3(0,0,1) };
@@ -215,7 +206,7 @@ void Gizmo::renderRotateGizmo(const Camera& camera, const glm::vec3& position,
 }
 
 void Gizmo::renderScaleGizmo(const Camera& camera, const glm::vec3& position,
-                            const glm::mat4& view, const glm::mat4& proj, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation) {
+                            int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation) {
     const float axisLength = 1.0f;
     const float cubeHalf = 0.05f;
     const float lineLength = axisLength - cubeHalf;
@@ -223,11 +214,7 @@ void Gizmo::renderScaleGizmo(const Camera& camera, const glm::vec3& position,
     if (!gizmoShader) return;
     gizmoShader->use();
     gizmoShader->setMat4("uModel", glm::mat4(1.0f));
-    gizmoShader->setMat4("uView", view);
-    gizmoShader->setMat4("uProjection", proj);
     gizmoShader->setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gizmoShader->setVec3("uLightPos", camera.position);
-    gizmoShader->setVec3("uViewPos", camera.position);
     gizmoShader->setFloat("uAlpha", 1.0f);
 
     glm::vec3 axes[3] = { orientation * glm::vec3(1,0,0), orientation * glm::vec3(0,1,0), orientation * glm::vec3(0,0,1) };
@@ -306,7 +293,9 @@ void Gizmo::renderSolid(const std::vector<float>& vertices) {
     glBindBuffer(GL_ARRAY_BUFFER, solidVBO);
     // Buffer orphaning: upload new data each call
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
+    OPTICSKETCH_PROFILE_UPLOAD(vertices.size() * sizeof(float));
     glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size() / 6));
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
 }
 
 void Gizmo::makeThickLineQuad(const glm::vec3& camPos, const glm::vec3& a, const glm::vec3& b, float halfWidth, std::vector<float>& outVertices) {
@@ -65,9 +65,9 @@ private:
     GLuint solidVAO = 0, solidVBO = 0;
     
     // Gizmo rendering helpers
-    void renderMoveGizmo(const Camera& camera, const glm::vec3& position, const glm::mat4& view, const glm::mat4& proj, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation);
-    void renderRotateGizmo(const Camera& camera, const glm::vec3& position, const glm::mat4& view, const glm::mat4& proj, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation, float dragAngle, float dragStartAngle);
-    void renderScaleGizmo(const Camera& camera, const glm::vec3& position, const glm::mat4& view, const glm::mat4& proj, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation);
+    void renderMoveGizmo(const Camera& camera, const glm::vec3& position, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation);
+    void renderRotateGizmo(const Camera& camera, const glm::vec3& position, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation, float dragAngle, float dragStartAngle);
+    void renderScaleGizmo(const Camera& camera, const glm::vec3& position, int viewportWidth, int viewportHeight, int hoveredHandle, int exclusiveHandle, const glm::mat3& orientation);
     
     // Thick lines as quads (glLineWidth > 1 is ignored in OpenGL core profile)
     void renderSolid(const std::vector<float>& vertices);
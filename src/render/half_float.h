@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace opticsketch {
+
+// IEEE 754 binary32 -> binary16, round to nearest; out-of-range values saturate to inf
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7C00u);
+    if (exponent <= 0) {
+        // Subnormal half (or flush to zero)
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1u) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u) half++;  // carries into the exponent correctly
+    return static_cast<uint16_t>(half);
+}
+
+} // namespace opticsketch
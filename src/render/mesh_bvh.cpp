@@ -0,0 +1,238 @@
+#include "render/mesh_bvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace opticsketch {
+
+static constexpr int kSahBins = 12;
+static constexpr int kMaxLeafTriangles = 4;
+static constexpr float kTraversalCost = 1.0f;   // relative to one triangle test
+
+struct BuildPrim {
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 centroid;
+    uint32_t triangle;
+};
+
+// Half the surface area of a box of the given extent; only ratios matter
+static float halfArea(const glm::vec3& bmin, const glm::vec3& bmax) {
+    glm::vec3 e = glm::max(bmax - bmin, glm::vec3(0.0f));
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+static int binOf(float c, float lo, float scale) {
+    return std::min(kSahBins - 1, static_cast<int>((c - lo) * scale));
+}
+
+void MeshBVH::build(const std::vector<float>& vertices, const std::vector<uint32_t>& indices) {
+    nodes.clear();
+    triangles.clear();
+
+    const size_t vertexCount = vertices.size() / 6;
+    auto position = [&](uint32_t i) {
+        return glm::vec3(vertices[i * 6 + 0], vertices[i * 6 + 1], vertices[i * 6 + 2]);
+    };
+    std::vector<BuildPrim> prims;
+    prims.reserve(indices.size() / 3);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        if (indices[t] >= vertexCount || indices[t + 1] >= vertexCount || indices[t + 2] >= vertexCount) continue;
+        glm::vec3 a = position(indices[t]), b = position(indices[t + 1]), c = position(indices[t + 2]);
+        BuildPrim p;
+        p.boundsMin = glm::min(a, glm::min(b, c));
+        p.boundsMax = glm::max(a, glm::max(b, c));
+        p.centroid = (a + b + c) / 3.0f;
+        p.triangle = static_cast<uint32_t>(t);
+        prims.push_back(p);
+    }
+    if (prims.empty()) return;
+
+    nodes.reserve(prims.size() * 2);
+    nodes.emplace_back();
+    struct Task { int node; int begin; int end; int depth; };
+    std::vector<Task> tasks;
+    tasks.push_back({0, 0, static_cast<int>(prims.size()), 0});
+
+    while (!tasks.empty()) {
+        Task task = tasks.back();
+        tasks.pop_back();
+
+        glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+        for (int i = task.begin; i < task.end; i++) {
+            bmin = glm::min(bmin, prims[i].boundsMin);
+            bmax = glm::max(bmax, prims[i].boundsMax);
+            cmin = glm::min(cmin, prims[i].centroid);
+            cmax = glm::max(cmax, prims[i].centroid);
+        }
+        nodes[task.node].boundsMin = bmin;
+        nodes[task.node].boundsMax = bmax;
+        const int count = task.end - task.begin;
+
+        // Binned SAH: cheapest of kSahBins - 1 planes per axis
+        int bestAxis = -1;
+        int bestPlane = 0;
+        float bestCost = FLT_MAX;
+        if (count > 1 && task.depth < kMaxDepth) {
+            for (int axis = 0; axis < 3; axis++) {
+                float extent = cmax[axis] - cmin[axis];
+                if (extent <= 0.0f) continue;
+                float scale = static_cast<float>(kSahBins) / extent;
+                int binCount[kSahBins] = {};
+                glm::vec3 binMin[kSahBins], binMax[kSahBins];
+                std::fill(binMin, binMin + kSahBins, glm::vec3(FLT_MAX));
+                std::fill(binMax, binMax + kSahBins, glm::vec3(-FLT_MAX));
+                for (int i = task.begin; i < task.end; i++) {
+                    int b = binOf(prims[i].centroid[axis], cmin[axis], scale);
+                    binCount[b]++;
+                    binMin[b] = glm::min(binMin[b], prims[i].boundsMin);
+                    binMax[b] = glm::max(binMax[b], prims[i].boundsMax);
+                }
+                // Right-to-left sweep for the area and count right of each plane
+                float rightArea[kSahBins];
+                int rightCount[kSahBins];
+                glm::vec3 rmin(FLT_MAX), rmax(-FLT_MAX);
+                int rn = 0;
+                for (int b = kSahBins - 1; b > 0; b--) {
+                    rmin = glm::min(rmin, binMin[b]);
+                    rmax = glm::max(rmax, binMax[b]);
+                    rn += binCount[b];
+                    rightArea[b] = rn > 0 ? halfArea(rmin, rmax) : 0.0f;
+                    rightCount[b] = rn;
+                }
+                glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX);
+                int ln = 0;
+                for (int plane = 1; plane < kSahBins; plane++) {
+                    lmin = glm::min(lmin, binMin[plane - 1]);
+                    lmax = glm::max(lmax, binMax[plane - 1]);
+                    ln += binCount[plane - 1];
+                    if (ln == 0 || rightCount[plane] == 0) continue;
+                    float cost = halfArea(lmin, lmax) * static_cast<float>(ln) +
+                                 rightArea[plane] * static_cast<float>(rightCount[plane]);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestPlane = plane;
+                    }
+                }
+            }
+        }
+
+        // Split when it beats testing every triangle, and always above the leaf size
+        float area = halfArea(bmin, bmax);
+        bool split = bestAxis >= 0 &&
+                     (count > kMaxLeafTriangles ||
+                      kTraversalCost * area + bestCost < area * static_cast<float>(count));
+        int mid = task.begin;
+        if (split) {
+            float scale = static_cast<float>(kSahBins) / (cmax[bestAxis] - cmin[bestAxis]);
+            auto it = std::partition(prims.begin() + task.begin, prims.begin() + task.end, [&](const BuildPrim& p) {
+                return binOf(p.centroid[bestAxis], cmin[bestAxis], scale) < bestPlane;
+            });
+            mid = static_cast<int>(it - prims.begin());
+        } else if (count > kMaxLeafTriangles && task.depth < kMaxDepth) {
+            // Coincident centroids: halve the range so leaves stay small
+            split = true;
+            mid = task.begin + count / 2;
+        }
+        if (!split || mid == task.begin || mid == task.end) {
+            nodes[task.node].first = task.begin;
+            nodes[task.node].count = count;
+            continue;
+        }
+
+        int left = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[task.node].first = left;
+        nodes[task.node].count = 0;
+        tasks.push_back({left + 1, mid, task.end, task.depth + 1});
+        tasks.push_back({left, task.begin, mid, task.depth + 1});
+    }
+
+    triangles.reserve(prims.size());
+    for (const BuildPrim& p : prims) {
+        glm::vec3 a = position(indices[p.triangle]);
+        glm::vec3 b = position(indices[p.triangle + 1]);
+        glm::vec3 c = position(indices[p.triangle + 2]);
+        triangles.push_back({a, b - a, c - a});
+    }
+}
+
+// Slab test; tNear is where the ray enters the box (negative if it starts inside)
+static bool slab(const glm::vec3& bmin, const glm::vec3& bmax, const glm::vec3& origin, const glm::vec3& invDir,
+                 float tMax, float& tNear) {
+    glm::vec3 t0 = (bmin - origin) * invDir;
+    glm::vec3 t1 = (bmax - origin) * invDir;
+    glm::vec3 lo = glm::min(t0, t1), hi = glm::max(t0, t1);
+    tNear = std::max(std::max(lo.x, lo.y), lo.z);
+    float tFar = std::min(std::min(hi.x, hi.y), hi.z);
+    return tFar >= std::max(tNear, 0.0f) && tNear <= tMax;
+}
+
+bool MeshBVH::intersect(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax,
+                        float& t, glm::vec3& normal, int& tests) const {
+    if (nodes.empty()) return false;
+    glm::vec3 invDir = 1.0f / direction;
+    float closest = tMax;
+    const Triangle* best = nullptr;
+
+    // Each level pushes at most one deferred child, so the depth limit bounds the stack
+    struct Entry { int node; float tNear; };
+    Entry stack[kMaxDepth + 2];
+    int stackSize = 0;
+    float rootNear;
+    if (!slab(nodes[0].boundsMin, nodes[0].boundsMax, origin, invDir, closest, rootNear)) return false;
+    stack[stackSize++] = {0, rootNear};
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        if (entry.tNear > closest) continue;
+        const Node& node = nodes[entry.node];
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const Triangle& tri = triangles[i];
+                tests++;
+                // Moller-Trumbore, two-sided
+                glm::vec3 p = glm::cross(direction, tri.e2);
+                float det = glm::dot(tri.e1, p);
+                if (std::abs(det) < 1e-12f) continue;
+                float invDet = 1.0f / det;
+                glm::vec3 s = origin - tri.v0;
+                float u = glm::dot(s, p) * invDet;
+                if (u < 0.0f || u > 1.0f) continue;
+                glm::vec3 q = glm::cross(s, tri.e1);
+                float v = glm::dot(direction, q) * invDet;
+                if (v < 0.0f || u + v > 1.0f) continue;
+                float hitT = glm::dot(tri.e2, q) * invDet;
+                if (hitT > tMin && hitT < closest) {
+                    closest = hitT;
+                    best = &tri;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        float nearA, nearB;
+        bool hitA = slab(nodes[node.first].boundsMin, nodes[node.first].boundsMax, origin, invDir, closest, nearA);
+        bool hitB = slab(nodes[node.first + 1].boundsMin, nodes[node.first + 1].boundsMax, origin, invDir, closest, nearB);
+        if (hitA && hitB) {
+            bool aFirst = nearA <= nearB;
+            stack[stackSize++] = aFirst ? Entry{node.first + 1, nearB} : Entry{node.first, nearA};
+            stack[stackSize++] = aFirst ? Entry{node.first, nearA} : Entry{node.first + 1, nearB};
+        } else if (hitA) {
+            stack[stackSize++] = {node.first, nearA};
+        } else if (hitB) {
+            stack[stackSize++] = {node.first + 1, nearB};
+        }
+    }
+
+    if (!best) return false;
+    t = closest;
+    normal = glm::normalize(glm::cross(best->e1, best->e2));
+    return true;
+}
+
+} // namespace opticsketch
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace opticsketch {
+
+// Binary BVH over the triangles of an imported mesh, in the mesh's own (element local)
+// space. Built once per MeshAsset with a binned surface area heuristic, so the tracer's
+// exact hit test costs O(log n) triangles instead of the element's box.
+class MeshBVH {
+public:
+    // 'vertices' holds 6 floats per vertex (position, normal), 'indices' a triangle list
+    void build(const std::vector<float>& vertices, const std::vector<uint32_t>& indices);
+
+    // Closest triangle crossing with tMin < t < tMax. The direction need not be normalized
+    // (t is in its units); 'normal' is the unit face normal from the triangle winding.
+    // 'tests' is incremented per triangle tested.
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, float tMin, float tMax,
+                   float& t, glm::vec3& normal, int& tests) const;
+
+    bool empty() const { return nodes.empty(); }
+    size_t triangleCount() const { return triangles.size(); }
+    size_t memoryBytes() const {
+        return nodes.capacity() * sizeof(Node) + triangles.capacity() * sizeof(Triangle);
+    }
+
+private:
+    // Leaves (count > 0) cover triangles[first, first + count); inner nodes have their
+    // children at 'first' and first + 1
+    struct Node {
+        glm::vec3 boundsMin{0.0f};
+        int first = 0;
+        glm::vec3 boundsMax{0.0f};
+        int count = 0;
+    };
+
+    // Vertex and edges, as Moller-Trumbore wants them
+    struct Triangle {
+        glm::vec3 v0;
+        glm::vec3 e1;
+        glm::vec3 e2;
+    };
+
+    static constexpr int kMaxDepth = 48;
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;    // in leaf order
+};
+
+} // namespace opticsketch
@@ -0,0 +1,61 @@
+#include "render/mesh_import.h"
+#include <filesystem>
+
+namespace opticsketch {
+
+MeshImportJob::~MeshImportJob() {
+    cancel();
+    JobSystem::instance().wait(job);
+}
+
+void MeshImportJob::cancel() {
+    cancelRequested.store(true);
+    JobSystem::instance().cancel(job);
+}
+
+bool MeshImportJob::start(const std::string& objPath) {
+    if (active) return false;
+    JobSystem::instance().wait(job);
+
+    path = objPath;
+    active = true;
+    finished.store(false);
+    cancelRequested.store(false);
+    progress.store(0.0f);
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result.reset();
+    }
+
+    std::string label = "Importing " + std::filesystem::path(objPath).filename().string();
+    job = JobSystem::instance().submit(label, JobPriority::Normal, [this, objPath](JobContext& context) {
+        MeshLoadControl control;
+        control.progress = [this, &context](float p) {
+            progress.store(p, std::memory_order_relaxed);
+            context.setProgress(p);
+        };
+        // Raised by cancel() or by the jobs list
+        control.cancel = context.getToken().get();
+        MeshAssetRef asset = MeshStore::instance().load(objPath, &control);
+        bool cancelled = context.isCancelled();
+        if (cancelled) cancelRequested.store(true);
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            result = cancelled ? nullptr : std::move(asset);
+        }
+        progress.store(1.0f);
+        finished.store(true);
+    });
+    return true;
+}
+
+MeshAssetRef MeshImportJob::takeResult() {
+    if (!isFinished()) return nullptr;
+    JobSystem::instance().wait(job);
+    job = 0;
+    active = false;
+    std::lock_guard<std::mutex> lock(resultMutex);
+    return std::move(result);
+}
+
+} // namespace opticsketch
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "render/mesh_store.h"
+#include "jobs/job_system.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace opticsketch {
+
+// Loads one OBJ file as a JobSystem job so large imports don't stall the UI.
+// Poll from the UI thread: show getProgress() while isRunning(), then takeResult()
+// once isFinished(). The asset's GPU buffers are created lazily by the viewport on
+// the render thread the first time an element using it is drawn.
+class MeshImportJob {
+public:
+    MeshImportJob() = default;
+    ~MeshImportJob();
+    MeshImportJob(const MeshImportJob&) = delete;
+    MeshImportJob& operator=(const MeshImportJob&) = delete;
+
+    // Start loading 'path'. Returns false if a job is already in progress.
+    bool start(const std::string& path);
+
+    // Ask the worker to stop; the job then finishes with a null result
+    void cancel();
+
+    // True from start() until takeResult()
+    bool isRunning() const { return active; }
+    // True once the worker is done (successfully, with an error, or cancelled)
+    bool isFinished() const { return active && finished.load(); }
+    bool isCancelled() const { return cancelRequested.load(); }
+
+    float getProgress() const { return progress.load(); }
+    const std::string& getPath() const { return path; }
+
+    // Collect the finished asset (nullptr on failure or cancel) and make the job reusable
+    MeshAssetRef takeResult();
+
+private:
+    JobId job = 0;
+    std::string path;
+    bool active = false;
+    std::atomic<bool> finished{false};
+    std::atomic<bool> cancelRequested{false};
+    std::atomic<float> progress{0.0f};
+
+    std::mutex resultMutex;
+    MeshAssetRef result;
+};
+
+} // namespace opticsketch
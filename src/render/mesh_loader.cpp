@@ -3,18 +3,92 @@
 
 #include "render/mesh_loader.h"
 #include <iostream>
+#include <fstream>
 #include <algorithm>
 #include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <unordered_map>
 
 namespace opticsketch {
 
-bool loadObjFile(const std::string& path, MeshData& outData) {
+// Bitwise key of one welded vertex (position + normal)
+struct VertexKey {
+    uint32_t bits[6];
+    bool operator==(const VertexKey& o) const { return std::memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& k) const {
+        uint64_t h = 1469598103934665603ull;
+        for (uint32_t b : k.bits) {
+            h ^= b;
+            h *= 1099511628211ull;
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+// Share of the progress range spent in tinyobj parsing; welding takes the rest
+static constexpr float kParseProgressShare = 0.85f;
+
+static bool isCancelled(const MeshLoadControl* control) {
+    return control && control->cancel && control->cancel->load(std::memory_order_relaxed);
+}
+
+// Reads the file in chunks for tinyobj, reporting bytes consumed and ending the stream
+// early on cancellation
+class ProgressStreambuf : public std::streambuf {
+public:
+    ProgressStreambuf(std::ifstream& file, std::streamoff size, const MeshLoadControl* control)
+        : file(file), size(size), control(control) {}
+
+protected:
+    int_type underflow() override {
+        if (isCancelled(control)) return traits_type::eof();
+        file.read(buffer, sizeof(buffer));
+        std::streamsize n = file.gcount();
+        if (n <= 0) return traits_type::eof();
+        consumed += n;
+        if (control && control->progress && size > 0) {
+            control->progress(kParseProgressShare * static_cast<float>(consumed) / static_cast<float>(size));
+        }
+        setg(buffer, buffer, buffer + n);
+        return traits_type::to_int_type(buffer[0]);
+    }
+
+private:
+    std::ifstream& file;
+    std::streamoff size;
+    std::streamoff consumed = 0;
+    const MeshLoadControl* control;
+    char buffer[1 << 16];
+};
+
+bool loadObjFile(const std::string& path, MeshData& outData, const MeshLoadControl* control) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string warn, err;
 
-    bool ok = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str());
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open OBJ: " << path << "\n";
+        return false;
+    }
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    // Materials are resolved relative to the OBJ, as tinyobj's path-based loader does
+    std::string baseDir;
+    auto slash = path.find_last_of("/\\");
+    if (slash != std::string::npos) baseDir = path.substr(0, slash + 1);
+    tinyobj::MaterialFileReader materialReader(baseDir);
+
+    ProgressStreambuf streambuf(file, fileSize, control);
+    std::istream stream(&streambuf);
+    bool ok = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader);
+    if (isCancelled(control)) return false;
     if (!ok) {
         std::cerr << "Failed to load OBJ: " << path << "\n";
         if (!err.empty()) std::cerr << "  Error: " << err << "\n";
@@ -24,37 +98,63 @@ bool loadObjFile(const std::string& path, MeshData& outData) {
         std::cerr << "OBJ warning: " << warn << "\n";
     }
 
-    // Collect all triangulated vertices with normals
-    std::vector<float> rawVertices;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> welded;
+    size_t cornerCount = 0;
+    for (const auto& shape : shapes) cornerCount += shape.mesh.indices.size();
+    welded.reserve(cornerCount);
+    indices.reserve(cornerCount);
+
     bool hasNormals = !attrib.normals.empty();
 
+    // Per-face scratch, reused across faces
+    std::vector<glm::vec3> facePositions;
+    std::vector<glm::vec3> faceNormals;
+    std::vector<uint32_t> faceVertices;
+
+    auto addVertex = [&](const glm::vec3& pos, const glm::vec3& normal) {
+        VertexKey key;
+        const float values[6] = {pos.x, pos.y, pos.z, normal.x, normal.y, normal.z};
+        std::memcpy(key.bits, values, sizeof(values));
+        auto [it, inserted] = welded.emplace(key, static_cast<uint32_t>(vertices.size() / 6));
+        if (inserted) vertices.insert(vertices.end(), values, values + 6);
+        return it->second;
+    };
+
+    size_t cornersDone = 0;
     for (const auto& shape : shapes) {
         size_t indexOffset = 0;
         for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
             int fv = shape.mesh.num_face_vertices[f];
 
+            if ((f & 0xFFFF) == 0 && f > 0) {
+                if (isCancelled(control)) return false;
+                if (control && control->progress) {
+                    float welded01 = static_cast<float>(cornersDone + indexOffset) / static_cast<float>(cornerCount);
+                    control->progress(kParseProgressShare + (1.0f - kParseProgressShare) * welded01);
+                }
+            }
+
             // Collect face vertices
-            std::vector<glm::vec3> facePositions;
-            std::vector<glm::vec3> faceNormals;
+            facePositions.clear();
+            faceNormals.clear();
             bool faceHasNormals = true;
-
             for (int v = 0; v < fv; v++) {
                 tinyobj::index_t idx = shape.mesh.indices[indexOffset + v];
 
-                glm::vec3 pos(
+                facePositions.emplace_back(
                     attrib.vertices[3 * idx.vertex_index + 0],
                     attrib.vertices[3 * idx.vertex_index + 1],
                     attrib.vertices[3 * idx.vertex_index + 2]
                 );
-                facePositions.push_back(pos);
 
                 if (hasNormals && idx.normal_index >= 0) {
-                    glm::vec3 norm(
+                    faceNormals.emplace_back(
                         attrib.normals[3 * idx.normal_index + 0],
                         attrib.normals[3 * idx.normal_index + 1],
                         attrib.normals[3 * idx.normal_index + 2]
                     );
-                    faceNormals.push_back(norm);
                 } else {
                     faceHasNormals = false;
                 }
@@ -70,39 +170,33 @@ bool loadObjFile(const std::string& path, MeshData& outData) {
                 if (len > 1e-8f) computedNormal = n / len;
             }
 
+            faceVertices.clear();
+            for (int v = 0; v < fv; v++) {
+                faceVertices.push_back(addVertex(facePositions[v],
+                                                 faceHasNormals ? faceNormals[v] : computedNormal));
+            }
+
             // Triangulate (fan from first vertex)
             for (int v = 1; v + 1 < fv; v++) {
-                int indices[3] = {0, v, v + 1};
-                for (int i = 0; i < 3; i++) {
-                    int vi = indices[i];
-                    rawVertices.push_back(facePositions[vi].x);
-                    rawVertices.push_back(facePositions[vi].y);
-                    rawVertices.push_back(facePositions[vi].z);
-                    if (faceHasNormals) {
-                        rawVertices.push_back(faceNormals[vi].x);
-                        rawVertices.push_back(faceNormals[vi].y);
-                        rawVertices.push_back(faceNormals[vi].z);
-                    } else {
-                        rawVertices.push_back(computedNormal.x);
-                        rawVertices.push_back(computedNormal.y);
-                        rawVertices.push_back(computedNormal.z);
-                    }
-                }
+                indices.push_back(faceVertices[0]);
+                indices.push_back(faceVertices[v]);
+                indices.push_back(faceVertices[v + 1]);
             }
 
             indexOffset += fv;
         }
+        cornersDone += indexOffset;
     }
 
-    if (rawVertices.empty()) {
+    if (indices.empty()) {
         std::cerr << "OBJ file has no geometry: " << path << "\n";
         return false;
     }
 
-    // Compute AABB from raw positions
+    // Compute AABB from welded positions
     glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX);
-    for (size_t i = 0; i < rawVertices.size(); i += 6) {
-        glm::vec3 p(rawVertices[i], rawVertices[i + 1], rawVertices[i + 2]);
+    for (size_t i = 0; i < vertices.size(); i += 6) {
+        glm::vec3 p(vertices[i], vertices[i + 1], vertices[i + 2]);
         bmin = glm::min(bmin, p);
         bmax = glm::max(bmax, p);
     }
@@ -113,26 +207,85 @@ bool loadObjFile(const std::string& path, MeshData& outData) {
     float maxExtent = std::max({extent.x, extent.y, extent.z});
     float scale = (maxExtent > 1e-8f) ? (2.0f / maxExtent) : 1.0f;
 
-    for (size_t i = 0; i < rawVertices.size(); i += 6) {
-        rawVertices[i + 0] = (rawVertices[i + 0] - center.x) * scale;
-        rawVertices[i + 1] = (rawVertices[i + 1] - center.y) * scale;
-        rawVertices[i + 2] = (rawVertices[i + 2] - center.z) * scale;
+    for (size_t i = 0; i < vertices.size(); i += 6) {
+        vertices[i + 0] = (vertices[i + 0] - center.x) * scale;
+        vertices[i + 1] = (vertices[i + 1] - center.y) * scale;
+        vertices[i + 2] = (vertices[i + 2] - center.z) * scale;
         // Normals stay unchanged
     }
 
-    // Recompute bounds after normalization
-    bmin = glm::vec3(FLT_MAX);
-    bmax = glm::vec3(-FLT_MAX);
-    for (size_t i = 0; i < rawVertices.size(); i += 6) {
-        glm::vec3 p(rawVertices[i], rawVertices[i + 1], rawVertices[i + 2]);
-        bmin = glm::min(bmin, p);
-        bmax = glm::max(bmax, p);
+    // Normalized bounds follow directly from the transform above
+    outData.boundsMin = (bmin - center) * scale;
+    outData.boundsMax = (bmax - center) * scale;
+    outData.vertices = std::move(vertices);
+    outData.indices = std::move(indices);
+    return true;
+}
+
+void simplifyMesh(const MeshData& source, int gridResolution, MeshData& outData) {
+    outData.vertices.clear();
+    outData.indices.clear();
+    outData.boundsMin = source.boundsMin;
+    outData.boundsMax = source.boundsMax;
+    size_t vertexCount = source.vertices.size() / 6;
+    if (vertexCount == 0 || gridResolution < 1) return;
+
+    glm::vec3 extent = glm::max(source.boundsMax - source.boundsMin, glm::vec3(1e-6f));
+    glm::vec3 cellScale = glm::vec3(static_cast<float>(gridResolution)) / extent;
+    auto cellOf = [&](const float* v) {
+        glm::vec3 p = (glm::vec3(v[0], v[1], v[2]) - source.boundsMin) * cellScale;
+        glm::ivec3 c = glm::clamp(glm::ivec3(p), glm::ivec3(0), glm::ivec3(gridResolution - 1));
+        return static_cast<uint32_t>((c.z * gridResolution + c.y) * gridResolution + c.x);
+    };
+
+    // Cell representative: mean position of its vertices
+    std::unordered_map<uint32_t, uint32_t> cellSlots;
+    std::vector<glm::vec4> cellSums;  // xyz sum, w count
+    std::vector<uint32_t> vertexCell(vertexCount);
+    cellSlots.reserve(vertexCount / 4 + 1);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const float* v = &source.vertices[i * 6];
+        auto [it, inserted] = cellSlots.emplace(cellOf(v), static_cast<uint32_t>(cellSums.size()));
+        if (inserted) cellSums.emplace_back(0.0f);
+        cellSums[it->second] += glm::vec4(v[0], v[1], v[2], 1.0f);
+        vertexCell[i] = it->second;
     }
 
-    outData.vertices = std::move(rawVertices);
-    outData.boundsMin = bmin;
-    outData.boundsMax = bmax;
-    return true;
+    // Output vertex per (cell, coarse normal direction); normals averaged within it
+    std::unordered_map<uint64_t, uint32_t> outSlots;
+    std::vector<glm::vec3> normalSums;
+    std::vector<uint32_t> vertexRemap(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const float* v = &source.vertices[i * 6];
+        glm::ivec3 dir = glm::ivec3(glm::round(glm::vec3(v[3], v[4], v[5]) * 2.0f)) + glm::ivec3(2);
+        uint64_t key = (static_cast<uint64_t>(vertexCell[i]) << 8) | static_cast<uint64_t>((dir.z * 5 + dir.y) * 5 + dir.x);
+        auto [it, inserted] = outSlots.emplace(key, static_cast<uint32_t>(normalSums.size()));
+        if (inserted) {
+            const glm::vec4& sum = cellSums[vertexCell[i]];
+            glm::vec3 p = glm::vec3(sum) / sum.w;
+            outData.vertices.insert(outData.vertices.end(), {p.x, p.y, p.z, 0.0f, 0.0f, 0.0f});
+            normalSums.emplace_back(0.0f);
+        }
+        normalSums[it->second] += glm::vec3(v[3], v[4], v[5]);
+        vertexRemap[i] = it->second;
+    }
+    for (size_t i = 0; i < normalSums.size(); i++) {
+        float len = glm::length(normalSums[i]);
+        glm::vec3 n = len > 1e-8f ? normalSums[i] / len : glm::vec3(0.0f, 1.0f, 0.0f);
+        outData.vertices[i * 6 + 3] = n.x;
+        outData.vertices[i * 6 + 4] = n.y;
+        outData.vertices[i * 6 + 5] = n.z;
+    }
+
+    // Keep triangles whose corners still span three cells
+    outData.indices.reserve(source.indices.size() / 2);
+    for (size_t t = 0; t + 2 < source.indices.size(); t += 3) {
+        uint32_t a = source.indices[t], b = source.indices[t + 1], c = source.indices[t + 2];
+        if (vertexCell[a] == vertexCell[b] || vertexCell[b] == vertexCell[c] || vertexCell[a] == vertexCell[c]) continue;
+        outData.indices.push_back(vertexRemap[a]);
+        outData.indices.push_back(vertexRemap[b]);
+        outData.indices.push_back(vertexRemap[c]);
+    }
 }
 
 } // namespace opticsketch
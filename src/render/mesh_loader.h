@@ -3,17 +3,33 @@
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <atomic>
+#include <functional>
 
 namespace opticsketch {
 
 struct MeshData {
-    std::vector<float> vertices;    // 6 floats per vertex: pos(3) + normal(3)
+    std::vector<float> vertices;    // unique vertices, 6 floats each: pos(3) + normal(3)
+    std::vector<uint32_t> indices;  // triangle list into 'vertices'
     glm::vec3 boundsMin{0.0f};
     glm::vec3 boundsMax{0.0f};
 };
 
-// Load an OBJ file into MeshData. Centers mesh at origin and normalizes to fit
-// within a unit bounding box. Returns true on success.
-bool loadObjFile(const std::string& path, MeshData& outData);
+// Optional hooks for long-running loads (e.g. on an import worker thread)
+struct MeshLoadControl {
+    std::function<void(float)> progress;          // called with 0..1 as parsing advances
+    const std::atomic<bool>* cancel = nullptr;    // polled; loading stops and fails when set
+};
+
+// Load an OBJ file into indexed MeshData; corners with identical position and normal
+// are welded into one vertex. Centers mesh at origin and normalizes to fit within a
+// unit bounding box. Returns true on success (false if cancelled).
+bool loadObjFile(const std::string& path, MeshData& outData, const MeshLoadControl* control = nullptr);
+
+// Coarser copy of an indexed mesh by vertex clustering: positions are merged per cell of a
+// gridResolution^3 grid over [boundsMin, boundsMax] (normals only within similar directions,
+// so hard edges survive) and triangles that collapse are dropped.
+void simplifyMesh(const MeshData& source, int gridResolution, MeshData& outData);
 
 } // namespace opticsketch
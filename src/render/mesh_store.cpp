@@ -0,0 +1,98 @@
+#include "render/mesh_store.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace opticsketch {
+
+// Clustering grid resolutions for the generated detail levels, finest first. A level is
+// only kept if it cuts the triangle count of the previous one substantially.
+static constexpr int kLodGridResolutions[] = {48, 16};
+static constexpr float kLodMinReduction = 0.7f;
+
+// FNV-1a over the raw file bytes; returns false if the file cannot be read
+static bool hashFile(const std::string& path, uint64_t& outHash) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    uint64_t hash = 1469598103934665603ull;
+    char buffer[1 << 16];
+    while (file) {
+        file.read(buffer, sizeof(buffer));
+        std::streamsize n = file.gcount();
+        for (std::streamsize i = 0; i < n; i++) {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    outHash = hash;
+    return true;
+}
+
+MeshStore& MeshStore::instance() {
+    static MeshStore store;
+    return store;
+}
+
+std::string MeshStore::makeKey(const std::string& path, uint64_t contentHash) {
+    return path + "#" + std::to_string(contentHash);
+}
+
+void MeshStore::pruneExpired() {
+    for (auto it = assets.begin(); it != assets.end();) {
+        if (it->second.expired()) it = assets.erase(it);
+        else ++it;
+    }
+}
+
+MeshAssetRef MeshStore::find(const std::string& path, uint64_t contentHash) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = assets.find(makeKey(path, contentHash));
+    return it != assets.end() ? it->second.lock() : nullptr;
+}
+
+MeshAssetRef MeshStore::adopt(std::shared_ptr<MeshAsset> asset) {
+    if (!asset) return nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = assets[makeKey(asset->sourcePath, asset->contentHash)];
+    if (MeshAssetRef existing = slot.lock()) return existing;
+    slot = asset;
+    pruneExpired();
+    return asset;
+}
+
+MeshAssetRef MeshStore::load(const std::string& path, const MeshLoadControl* control) {
+    uint64_t hash = 0;
+    if (!hashFile(path, hash)) {
+        std::cerr << "Failed to open mesh: " << path << "\n";
+        return nullptr;
+    }
+    if (MeshAssetRef existing = find(path, hash)) return existing;
+
+    // Not cached (or freed): parse the file
+    MeshData data;
+    if (!loadObjFile(path, data, control)) return nullptr;
+    auto asset = std::make_shared<MeshAsset>();
+    size_t previousIndexCount = data.indices.size();
+    for (int resolution : kLodGridResolutions) {
+        MeshData coarse;
+        simplifyMesh(data, resolution, coarse);
+        if (coarse.indices.empty() ||
+            static_cast<float>(coarse.indices.size()) > kLodMinReduction * static_cast<float>(previousIndexCount)) {
+            continue;
+        }
+        previousIndexCount = coarse.indices.size();
+        asset->lods.push_back({std::move(coarse.vertices), std::move(coarse.indices)});
+    }
+    asset->sourcePath = path;
+    asset->contentHash = hash;
+    asset->vertices = std::move(data.vertices);
+    asset->indices = std::move(data.indices);
+    asset->boundsMin = data.boundsMin;
+    asset->boundsMax = data.boundsMax;
+    asset->bvh.build(asset->vertices, asset->indices);
+
+    // A concurrent load of the same file keeps whichever lands first
+    return adopt(std::move(asset));
+}
+
+} // namespace opticsketch
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "render/mesh_loader.h"
+#include "render/mesh_bvh.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace opticsketch {
+
+// One simplified detail level of an imported mesh
+struct MeshLod {
+    std::vector<float> vertices;    // 6 floats per vertex: pos(3) + normal(3)
+    std::vector<uint32_t> indices;
+};
+
+// Immutable imported geometry, shared by every element that references it
+struct MeshAsset {
+    std::string sourcePath;
+    uint64_t contentHash = 0;       // FNV-1a of the source file bytes
+    std::vector<float> vertices;    // unique vertices, 6 floats each: pos(3) + normal(3)
+    std::vector<uint32_t> indices;  // triangle list into 'vertices'
+    glm::vec3 boundsMin{0.0f};
+    glm::vec3 boundsMax{0.0f};
+    std::vector<MeshLod> lods;      // progressively coarser levels, for small on-screen sizes
+    MeshBVH bvh;                    // triangles of the full-detail level, for the ray tracer
+};
+
+using MeshAssetRef = std::shared_ptr<const MeshAsset>;
+
+// Process-wide store of imported meshes keyed by source path + content hash, so
+// duplicated or re-loaded elements share one asset (and one GPU buffer). The store
+// only holds weak references: an asset is freed with the last element using it.
+class MeshStore {
+public:
+    static MeshStore& instance();
+
+    // Return the shared asset for an OBJ file, parsing it only if no live asset has the
+    // same path and file contents. Returns nullptr if the file cannot be loaded or the
+    // load was cancelled through 'control'. Safe to call from worker threads.
+    MeshAssetRef load(const std::string& path, const MeshLoadControl* control = nullptr);
+
+    // Live asset for a path + content hash, or nullptr
+    MeshAssetRef find(const std::string& path, uint64_t contentHash);
+
+    // Register an asset built elsewhere (e.g. embedded in a binary project). If a live
+    // asset with the same path and hash exists, that one is returned instead.
+    MeshAssetRef adopt(std::shared_ptr<MeshAsset> asset);
+
+private:
+    MeshStore() = default;
+    static std::string makeKey(const std::string& path, uint64_t contentHash);
+    // Called with mutex held
+    void pruneExpired();
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<const MeshAsset>> assets;  // "path#hash"
+};
+
+} // namespace opticsketch
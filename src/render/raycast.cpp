@@ -1,6 +1,15 @@
 #include "render/raycast.h"
 #include <glm/gtc/matrix_inverse.hpp>
 #include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPTICSKETCH_RAYCAST_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define OPTICSKETCH_RAYCAST_NEON 1
+#include <arm_neon.h>
+#endif
 
 namespace opticsketch {
 
@@ -87,21 +96,130 @@ bool Raycast::intersectAABBWithNormal(const Ray& ray, const glm::vec3& min, cons
     return true;
 }
 
-bool Raycast::intersectElement(const Ray& ray, const Element* element,
-                               glm::mat4 transform, float& t) {
+void Raycast::AABB4::set(int lane, const glm::vec3& bmin, const glm::vec3& bmax) {
+    minX[lane] = bmin.x; minY[lane] = bmin.y; minZ[lane] = bmin.z;
+    maxX[lane] = bmax.x; maxY[lane] = bmax.y; maxZ[lane] = bmax.z;
+}
+
+int Raycast::intersectAABB4(const glm::vec3& origin, const glm::vec3& invDir,
+                            const AABB4& boxes, float tMax, float outNear[4]) {
+#if defined(OPTICSKETCH_RAYCAST_SSE)
+    __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+    __m128 ix = _mm_set1_ps(invDir.x), iy = _mm_set1_ps(invDir.y), iz = _mm_set1_ps(invDir.z);
+
+    __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.minX), ox), ix);
+    __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.maxX), ox), ix);
+    __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.minY), oy), iy);
+    __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.maxY), oy), iy);
+    __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.minZ), oz), iz);
+    __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.maxZ), oz), iz);
+
+    __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2));
+    __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2));
+
+    __m128 hit = _mm_and_ps(_mm_cmple_ps(tNear, tFar),
+                 _mm_and_ps(_mm_cmpge_ps(tFar, _mm_setzero_ps()), _mm_cmple_ps(tNear, _mm_set1_ps(tMax))));
+    _mm_storeu_ps(outNear, tNear);
+    return _mm_movemask_ps(hit);
+#elif defined(OPTICSKETCH_RAYCAST_NEON)
+    float32x4_t ox = vdupq_n_f32(origin.x), oy = vdupq_n_f32(origin.y), oz = vdupq_n_f32(origin.z);
+    float32x4_t ix = vdupq_n_f32(invDir.x), iy = vdupq_n_f32(invDir.y), iz = vdupq_n_f32(invDir.z);
+
+    float32x4_t tx1 = vmulq_f32(vsubq_f32(vld1q_f32(boxes.minX), ox), ix);
+    float32x4_t tx2 = vmulq_f32(vsubq_f32(vld1q_f32(boxes.maxX), ox), ix);
+    float32x4_t ty1 = vmulq_f32(vsubq_f32(vld1q_f32(boxes.minY), oy), iy);
+    float32x4_t ty2 = vmulq_f32(vsubq_f32(vld1q_f32(boxes.maxY), oy), iy);
+    float32x4_t tz1 = vmulq_f32(vsubq_f32(vld1q_f32(boxes.minZ), oz), iz);
+    float32x4_t tz2 = vmulq_f32(vsubq_f32(vld1q_f32(boxes.maxZ), oz), iz);
+
+    float32x4_t tNear = vmaxq_f32(vmaxq_f32(vminq_f32(tx1, tx2), vminq_f32(ty1, ty2)), vminq_f32(tz1, tz2));
+    float32x4_t tFar = vminq_f32(vminq_f32(vmaxq_f32(tx1, tx2), vmaxq_f32(ty1, ty2)), vmaxq_f32(tz1, tz2));
+
+    uint32x4_t hit = vandq_u32(vcleq_f32(tNear, tFar),
+                     vandq_u32(vcgeq_f32(tFar, vdupq_n_f32(0.0f)), vcleq_f32(tNear, vdupq_n_f32(tMax))));
+    vst1q_f32(outNear, tNear);
+    uint32_t lanes[4];
+    vst1q_u32(lanes, hit);
+    return (lanes[0] ? 1 : 0) | (lanes[1] ? 2 : 0) | (lanes[2] ? 4 : 0) | (lanes[3] ? 8 : 0);
+#else
+    int mask = 0;
+    for (int i = 0; i < 4; i++) {
+        float tx1 = (boxes.minX[i] - origin.x) * invDir.x, tx2 = (boxes.maxX[i] - origin.x) * invDir.x;
+        float ty1 = (boxes.minY[i] - origin.y) * invDir.y, ty2 = (boxes.maxY[i] - origin.y) * invDir.y;
+        float tz1 = (boxes.minZ[i] - origin.z) * invDir.z, tz2 = (boxes.maxZ[i] - origin.z) * invDir.z;
+        float tNear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::min(tz1, tz2));
+        float tFar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::max(tz1, tz2));
+        outNear[i] = tNear;
+        if (tNear <= tFar && tFar >= 0.0f && tNear <= tMax) mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+Element* Raycast::pickElement(const Ray& ray, const std::vector<std::unique_ptr<Element>>& elements,
+                              float& outT) {
+    glm::vec3 invDir = 1.0f / ray.direction;
+    float closestT = std::numeric_limits<float>::max();
+    Element* closest = nullptr;
+
+    AABB4 boxes;
+    Element* lanes[4];
+    int laneCount = 0;
+
+    // Exact tests only for elements whose world box the ray enters
+    auto flush = [&]() {
+        float tNear[4];
+        int mask = intersectAABB4(ray.origin, invDir, boxes, closestT, tNear) & ((1 << laneCount) - 1);
+        for (int i = 0; i < laneCount; i++) {
+            if (!(mask & (1 << i))) continue;
+            float t;
+            if (intersectElement(ray, lanes[i], t) && t > 0.0f && t < closestT) {
+                closestT = t;
+                closest = lanes[i];
+            }
+        }
+        laneCount = 0;
+    };
+
+    for (const auto& elem : elements) {
+        if (!elem->visible) continue;
+        glm::vec3 bmin, bmax;
+        elem->getArrayWorldBounds(bmin, bmax);
+        boxes.set(laneCount, bmin, bmax);
+        lanes[laneCount++] = elem.get();
+        if (laneCount == 4) flush();
+    }
+    if (laneCount > 0) flush();
+
+    outT = closestT;
+    return closest;
+}
+
+bool Raycast::intersectElement(const Ray& ray, const Element* element, float& t) {
     if (!element) return false;
     
-    // Transform ray to element's local space
-    glm::mat4 invTransform = glm::inverse(transform);
-    glm::vec3 localOrigin = glm::vec3(invTransform * glm::vec4(ray.origin, 1.0f));
-    glm::vec3 localDir = glm::normalize(glm::vec3(invTransform * glm::vec4(ray.direction, 0.0f)));
-    
-    Ray localRay;
-    localRay.origin = localOrigin;
-    localRay.direction = localDir;
-    
-    // Test against element's bounding box
-    return intersectAABB(localRay, element->boundsMin, element->boundsMax, t);
+    // Transform ray to element's local space. The direction stays unnormalized so t
+    // is measured along the world ray and comparable across differently scaled elements.
+    auto intersectLocal = [&](const glm::mat4& invTransform, float& hitT) {
+        Ray localRay;
+        localRay.origin = glm::vec3(invTransform * glm::vec4(ray.origin, 1.0f));
+        localRay.direction = glm::vec3(invTransform * glm::vec4(ray.direction, 0.0f));
+        // Test against element's bounding box
+        return intersectAABB(localRay, element->boundsMin, element->boundsMax, hitT);
+    };
+    if (element->array.isSingle()) return intersectLocal(element->getInverseModelMatrix(), t);
+
+    // Arrays: the nearest copy
+    bool hit = false;
+    for (int i = 0; i < element->getInstanceCount(); i++) {
+        float hitT;
+        if (intersectLocal(glm::inverse(element->getInstanceModelMatrix(i)), hitT) && hitT > 0.0f &&
+            (!hit || hitT < t)) {
+            t = hitT;
+            hit = true;
+        }
+    }
+    return hit;
 }
 
 bool Raycast::intersectPlane(const Ray& ray, const glm::vec3& planePos, const glm::vec3& planeNormal,
@@ -16,6 +16,18 @@ public:
         glm::vec3 origin;
         glm::vec3 direction;
     };
+
+    // Four axis-aligned boxes in SoA layout, for the packet kernel below
+    struct AABB4 {
+        alignas(16) float minX[4];
+        alignas(16) float minY[4];
+        alignas(16) float minZ[4];
+        alignas(16) float maxX[4];
+        alignas(16) float maxY[4];
+        alignas(16) float maxZ[4];
+
+        void set(int lane, const glm::vec3& bmin, const glm::vec3& bmax);
+    };
     
     // Generate ray from screen coordinates
     static Ray screenToRay(const Camera& camera, float screenX, float screenY, 
@@ -29,9 +41,20 @@ public:
     static bool intersectAABBWithNormal(const Ray& ray, const glm::vec3& min, const glm::vec3& max,
                                         float& t, glm::vec3& faceNormal);
     
-    // Test ray against element bounds
-    static bool intersectElement(const Ray& ray, const Element* element, 
-                                 glm::mat4 transform, float& t);
+    // Test one ray against four boxes at once (SSE/NEON, scalar fallback).
+    // invDir is 1 / direction. Returns a bitmask of lanes whose slab interval overlaps
+    // [0, tMax]; entry distances are written to outNear. Unused lanes must be masked
+    // off by the caller.
+    static int intersectAABB4(const glm::vec3& origin, const glm::vec3& invDir,
+                              const AABB4& boxes, float tMax, float outNear[4]);
+
+    // Closest visible element under the ray. World bounds are pre-tested four at a
+    // time before the exact local-space test. Returns nullptr if nothing is hit.
+    static Element* pickElement(const Ray& ray, const std::vector<std::unique_ptr<Element>>& elements,
+                                float& outT);
+
+    // Test ray against element bounds (uses the element's cached inverse model matrix)
+    static bool intersectElement(const Ray& ray, const Element* element, float& t);
     
     // Ray vs plane (plane: point on plane, normal)
     static bool intersectPlane(const Ray& ray, const glm::vec3& planePos, const glm::vec3& planeNormal,
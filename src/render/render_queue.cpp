@@ -0,0 +1,51 @@
+#include "render/render_queue.h"
+#include <algorithm>
+#include <cstring>
+
+namespace opticsketch {
+
+// Key layout, most significant first: pass (2 bits), shader (6), mesh ordinal (24),
+// depth (32). Non-negative floats order like their bit patterns.
+static uint32_t depthBits(float depth) {
+    depth = std::max(depth, 0.0f);
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+void RenderQueue::clear() {
+    items.clear();
+    order.clear();
+    meshOrdinals.clear();
+}
+
+void RenderQueue::push(RenderPass pass, uint32_t shader, float depth, const DrawItem& item) {
+    uint64_t key = (static_cast<uint64_t>(pass) << 62) | (static_cast<uint64_t>(shader & 0x3Fu) << 56);
+    if (pass == RenderPass::Transparent) {
+        // Back to front regardless of shader or mesh, for the blended fallback
+        key |= static_cast<uint64_t>(~depthBits(depth)) << 24;
+    } else {
+        // Ordinals in first-seen order keep the sort stable from frame to frame
+        auto it = meshOrdinals.emplace(item.mesh, static_cast<uint32_t>(meshOrdinals.size())).first;
+        key |= (static_cast<uint64_t>(it->second & 0xFFFFFFu) << 32) | depthBits(depth);
+    }
+    order.emplace_back(key, static_cast<uint32_t>(items.size()));
+    items.push_back(item);
+}
+
+void RenderQueue::sort() {
+    // The item index breaks ties, so equal keys keep submission order
+    std::sort(order.begin(), order.end());
+}
+
+std::pair<size_t, size_t> RenderQueue::passRange(RenderPass pass) const {
+    auto passKey = [](const std::pair<uint64_t, uint32_t>& entry) { return entry.first >> 62; };
+    const uint64_t p = static_cast<uint64_t>(pass);
+    auto begin = std::partition_point(order.begin(), order.end(),
+                                      [&](const auto& entry) { return passKey(entry) < p; });
+    auto end = std::partition_point(begin, order.end(),
+                                    [&](const auto& entry) { return passKey(entry) <= p; });
+    return {static_cast<size_t>(begin - order.begin()), static_cast<size_t>(end - order.begin())};
+}
+
+} // namespace opticsketch
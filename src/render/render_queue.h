@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace opticsketch {
+
+struct CachedMesh;
+
+// Passes of the scene draw, in submission order
+enum class RenderPass : uint8_t {
+    Opaque = 0,
+    Overlay,        // blended wireframe outlines over the solids
+    Transparent     // Presentation-mode glass, blended or OIT-accumulated
+};
+
+// One mesh draw: a single element (or array copy) with everything the scene shaders
+// read per object
+struct DrawItem {
+    const CachedMesh* mesh = nullptr;
+    glm::mat4 model{1.0f};
+    glm::mat3 normalMatrix{1.0f};
+    glm::vec3 color{1.0f};
+    float alpha = 1.0f;
+    glm::vec3 material{0.0f};   // metallic, roughness, fresnel IOR
+    float transparency = 0.0f;
+    uint32_t objectId = 0;
+};
+
+// Draws collected for a frame and submitted in sort-key order, so draws sharing a
+// shader and a mesh are adjacent (and can go out as one instanced call). Keys are
+// pass | shader | mesh | depth; opaque draws within a mesh run front to back, the
+// transparent pass orders by depth alone, back to front.
+class RenderQueue {
+public:
+    void clear();
+
+    // 'shader' is a caller-defined slot (< 64); 'depth' is the distance from the camera
+    void push(RenderPass pass, uint32_t shader, float depth, const DrawItem& item);
+
+    // Orders the items pushed since clear(); call once before reading them
+    void sort();
+
+    size_t size() const { return order.size(); }
+    bool empty() const { return order.empty(); }
+    const DrawItem& operator[](size_t i) const { return items[order[i].second]; }
+    RenderPass passOf(size_t i) const { return static_cast<RenderPass>(order[i].first >> 62); }
+    uint32_t shaderOf(size_t i) const { return static_cast<uint32_t>(order[i].first >> 56) & 0x3Fu; }
+
+    // [begin, end) of a pass in sorted order
+    std::pair<size_t, size_t> passRange(RenderPass pass) const;
+
+private:
+    std::vector<DrawItem> items;
+    std::vector<std::pair<uint64_t, uint32_t>> order;     // key, index into items
+    std::unordered_map<const CachedMesh*, uint32_t> meshOrdinals;
+};
+
+} // namespace opticsketch
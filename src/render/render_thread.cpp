@@ -0,0 +1,203 @@
+#include "render/render_thread.h"
+#include "render/viewport.h"
+#include "render/beam.h"
+#include "scene/scene.h"
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+namespace opticsketch {
+
+RenderThread::~RenderThread() {
+    stop();
+}
+
+bool RenderThread::start(GLFWwindow* share) {
+    if (context) return true;
+    // Same context hints as the window's; hidden, since it is never presented
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    context = glfwCreateWindow(1, 1, "OpticSketch render", nullptr, share);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!context) {
+        std::cerr << "Could not create the render thread's GL context" << std::endl;
+        return false;
+    }
+    stopping = false;
+    snapshotReady = false;
+    hasFrame = false;
+    frontStale = false;
+    frontCulled = 0;
+    thread = std::thread(&RenderThread::run, this);
+    return true;
+}
+
+void RenderThread::stop() {
+    if (!context) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    for (int i = 0; i < 3; i++) {
+        RenderSnapshot& snap = snapshots.slot(i);
+        if (snap.uiFence) glDeleteSync(snap.uiFence);
+        snap = RenderSnapshot{};
+    }
+    glfwDestroyWindow(context);
+    context = nullptr;
+    hasFrame = false;
+}
+
+void RenderThread::submit() {
+    RenderSnapshot& snap = snapshots.back();
+    snap.uiFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();  // the other context can only wait on a fence that reached the GPU
+    snapshots.publish();
+    // A snapshot the render thread skipped still holds its fence
+    RenderSnapshot& reused = snapshots.back();
+    if (reused.uiFence) {
+        glDeleteSync(reused.uiFence);
+        reused.uiFence = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshotReady = true;
+    }
+    wake.notify_one();
+}
+
+GLuint RenderThread::acquireFrame() {
+    if (frames.acquire()) {
+        Frame& frame = frames.front();
+        if (frame.rendered) {
+            glWaitSync(frame.rendered, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(frame.rendered);
+            frame.rendered = nullptr;
+        }
+        frontStale = frame.stale;
+        frontCulled = frame.culled;
+        hasFrame = true;
+    }
+    return hasFrame ? frames.front().texture : 0;
+}
+
+void RenderThread::releaseFrame() {
+    if (!hasFrame) return;
+    Frame& frame = frames.front();
+    if (frame.released) glDeleteSync(frame.released);
+    frame.released = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+}
+
+void RenderThread::run() {
+    glfwMakeContextCurrent(context);
+    glGenFramebuffers(1, &readFBO);
+    glGenFramebuffers(1, &drawFBO);
+    {
+        Viewport viewport;
+        bool initialized = false;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || snapshotReady; });
+                if (stopping) break;
+                snapshotReady = false;
+            }
+            if (!snapshots.acquire()) continue;
+            RenderSnapshot& snap = snapshots.front();
+            if (snap.uiFence) {
+                glWaitSync(snap.uiFence, 0, GL_TIMEOUT_IGNORED);
+                glDeleteSync(snap.uiFence);
+                snap.uiFence = nullptr;
+            }
+            if (!snap.scene || snap.width <= 0 || snap.height <= 0) continue;
+
+            if (!initialized) {
+                viewport.init(snap.width, snap.height);
+                initialized = true;
+            } else if (viewport.getWidth() != snap.width || viewport.getHeight() != snap.height) {
+                viewport.resize(snap.width, snap.height);
+            }
+            renderSnapshot(viewport, snap);
+            copyToFrame(viewport, frames.back());
+            frames.publish();
+            glfwPostEmptyEvent();   // wake a UI loop sleeping in glfwWaitEvents
+        }
+        if (initialized) viewport.cleanup();
+    }
+    for (int i = 0; i < 3; i++) {
+        Frame& frame = frames.slot(i);
+        if (frame.texture) glDeleteTextures(1, &frame.texture);
+        if (frame.rendered) glDeleteSync(frame.rendered);
+        if (frame.released) glDeleteSync(frame.released);
+        frame = Frame{};
+    }
+    glDeleteFramebuffers(1, &readFBO);
+    glDeleteFramebuffers(1, &drawFBO);
+    readFBO = drawFBO = 0;
+    glfwMakeContextCurrent(nullptr);
+}
+
+void RenderThread::renderSnapshot(Viewport& viewport, RenderSnapshot& snap) {
+    Scene* scene = snap.scene.get();
+    viewport.getCamera() = snap.camera;
+    viewport.setStyle(&snap.style);
+    viewport.setFrustumCulling(snap.frustumCulling);
+
+    viewport.beginFrame();
+    viewport.renderGrid(25.0f, 100);
+    viewport.renderScene(scene);
+    viewport.renderBeams(scene);
+    viewport.renderGaussianBeams(scene);
+    viewport.renderFocalPoints(scene);
+    if (snap.previewBeam) viewport.renderBeam(*snap.previewBeam);
+    if (snap.showGizmo) {
+        viewport.renderGizmoAt(snap.gizmoCenter, snap.gizmoType, snap.gizmoHovered, snap.gizmoExclusive,
+                               snap.gizmoOrientation, snap.gizmoDragAngle, snap.gizmoDragStartAngle);
+    }
+    if (snap.showBeamHighlight) viewport.renderBeamHighlight(snap.highlightStart, snap.highlightEnd, snap.highlightSnap);
+    viewport.endFrame();
+    viewport.renderBloomPass();
+}
+
+void RenderThread::copyToFrame(Viewport& viewport, Frame& frame) {
+    // The UI may still be drawing this texture from its last turn on screen
+    if (frame.released) {
+        glWaitSync(frame.released, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(frame.released);
+        frame.released = nullptr;
+    }
+    if (frame.rendered) {
+        glDeleteSync(frame.rendered);   // published but never shown
+        frame.rendered = nullptr;
+    }
+
+    int w = viewport.getWidth();
+    int h = viewport.getHeight();
+    if (!frame.texture || frame.width != w || frame.height != h) {
+        if (!frame.texture) glGenTextures(1, &frame.texture);
+        glBindTexture(GL_TEXTURE_2D, frame.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        frame.width = w;
+        frame.height = h;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, viewport.getTextureId(), 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frame.texture, 0);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    frame.rendered = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    frame.stale = viewport.isFrameStale();
+    frame.culled = viewport.getCulledObjectCount();
+}
+
+} // namespace opticsketch
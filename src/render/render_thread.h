@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "camera/camera.h"
+#include "jobs/triple_buffer.h"
+#include "render/gizmo.h"
+#include "style/scene_style.h"
+
+struct GLFWwindow;
+
+namespace opticsketch {
+
+class Scene;
+class Beam;
+class Viewport;
+
+// Everything one viewport frame draws, copied from the UI thread: the scene (a
+// Scene::snapshot with the selection), style, camera and the interaction overlays
+struct RenderSnapshot {
+    std::shared_ptr<Scene> scene;       // unchanged scenes share one copy across frames
+    SceneStyle style;
+    Camera camera;
+    int width = 0;
+    int height = 0;
+    bool frustumCulling = true;
+
+    std::shared_ptr<Beam> previewBeam;  // beam being drawn, or none
+    bool showGizmo = false;
+    glm::vec3 gizmoCenter{0.0f};
+    GizmoType gizmoType = GizmoType::Move;
+    int gizmoHovered = -1;
+    int gizmoExclusive = -1;
+    glm::mat3 gizmoOrientation{1.0f};
+    float gizmoDragAngle = 0.0f;
+    float gizmoDragStartAngle = 0.0f;
+    bool showBeamHighlight = false;
+    glm::vec3 highlightStart{0.0f}, highlightEnd{0.0f}, highlightSnap{0.0f};
+
+    // Fence after the UI thread's GL work for this frame (GPU traces, uploads), waited on
+    // before drawing
+    GLsync uiFence = nullptr;
+};
+
+// Optional viewport render thread. A second Viewport renders on its own GL context
+// (shared with the window's) from triple-buffered RenderSnapshots, so a slow scene or
+// bloom pass no longer holds up input and ImGui; the UI shows the newest finished frame.
+// Frames are copied into three shared textures. Fences order the UI's GL work before
+// each snapshot is drawn, and each frame's copy before it is shown. A texture that was
+// on screen is reused only once the UI's last draw using it has finished.
+//
+// The UI thread keeps its own Viewport for camera input, gizmo hit tests, thumbnails and
+// exports; ID-buffer picking needs the rendering viewport, so the UI picks on the CPU.
+class RenderThread {
+public:
+    RenderThread() = default;
+    ~RenderThread();
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Main thread (GLFW creates windows there), with 'share' current
+    bool start(GLFWwindow* share);
+    void stop();
+    bool isRunning() const { return context != nullptr; }
+
+    // UI thread: fill back(), then submit() it; the previous back slot's contents are
+    // handed back for reuse
+    RenderSnapshot& back() { return snapshots.back(); }
+    void submit();
+
+    // UI thread, before building the ImGui frame: switch to the newest finished frame.
+    // Returns its texture, or 0 while none has finished.
+    GLuint acquireFrame();
+    // UI thread, after ImGui's draw data is rendered: the frame on screen may be reused
+    // once the GPU has finished with the draws just issued
+    void releaseFrame();
+
+    // Of the frame on screen
+    bool isFrameStale() const { return frontStale; }
+    int getCulledObjectCount() const { return frontCulled; }
+
+private:
+    struct Frame {
+        GLuint texture = 0;
+        int width = 0;
+        int height = 0;
+        GLsync rendered = nullptr;  // the copy into texture
+        GLsync released = nullptr;  // the UI's last draw reading texture
+        bool stale = false;
+        int culled = 0;
+    };
+
+    void run();
+    void renderSnapshot(Viewport& viewport, RenderSnapshot& snap);
+    void copyToFrame(Viewport& viewport, Frame& frame);
+
+    GLFWwindow* context = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool snapshotReady = false;
+
+    TripleBuffer<RenderSnapshot> snapshots;   // UI -> render thread
+    TripleBuffer<Frame> frames;               // render thread -> UI
+    GLuint readFBO = 0, drawFBO = 0;          // render thread
+    bool frontStale = false;
+    int frontCulled = 0;
+    bool hasFrame = false;
+};
+
+} // namespace opticsketch
@@ -2,9 +2,14 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
 
 namespace opticsketch {
 
+std::string Shader::binaryCacheDirectory;
+
 Shader::~Shader() {
     // Destructor - cleanup will be called explicitly before context is destroyed
     // Don't do anything here to avoid double cleanup
@@ -17,6 +22,7 @@ void Shader::cleanup() {
         glDeleteProgram(id);
         id = 0;
     }
+    uniformLocations.clear();
 }
 
 std::string Shader::readFile(const std::string& filepath) {
@@ -43,7 +49,8 @@ GLuint Shader::compileShader(GLenum type, const std::string& source) {
     if (!success) {
         char infoLog[512];
         glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "Shader compilation error (" << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << "):\n" << infoLog << std::endl;
+        const char* stage = type == GL_VERTEX_SHADER ? "vertex" : type == GL_COMPUTE_SHADER ? "compute" : "fragment";
+        std::cerr << "Shader compilation error (" << stage << "):\n" << infoLog << std::endl;
         glDeleteShader(shader);
         return 0;
     }
@@ -51,10 +58,11 @@ GLuint Shader::compileShader(GLenum type, const std::string& source) {
     return shader;
 }
 
-GLuint Shader::linkProgram(GLuint vertex, GLuint fragment) {
+GLuint Shader::linkProgram(GLuint vertex, GLuint fragment, bool retrievable) {
     GLuint program = glCreateProgram();
+    if (retrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(program, vertex);
-    glAttachShader(program, fragment);
+    if (fragment) glAttachShader(program, fragment);
     glLinkProgram(program);
     
     // Check linking errors
@@ -71,25 +79,167 @@ GLuint Shader::linkProgram(GLuint vertex, GLuint fragment) {
     return program;
 }
 
-bool Shader::loadFromSource(const std::string& vertexSource, const std::string& fragmentSource) {
-    GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
+void Shader::cacheUniformLocations() {
+    uniformLocations.clear();
+    if (id == 0) return;
+    
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id, i, static_cast<GLsizei>(name.size()), &length, &size, &type, &name[0]);
+        std::string uniformName(name.data(), length);
+        // Arrays are reported as "name[0]"; store them under the base name too
+        size_t bracket = uniformName.find('[');
+        GLint location = glGetUniformLocation(id, uniformName.c_str());
+        if (location < 0) continue;  // uniform block members have no location
+        uniformLocations[uniformName] = location;
+        if (bracket != std::string::npos) {
+            uniformLocations[uniformName.substr(0, bracket)] = location;
+        }
+    }
+}
+
+std::string Shader::injectDefines(const std::string& source, const std::string& defines) {
+    if (defines.empty()) return source;
+    // #version must stay the first directive
+    size_t versionPos = source.find("#version");
+    if (versionPos == std::string::npos) return defines + source;
+    size_t lineEnd = source.find('\n', versionPos);
+    if (lineEnd == std::string::npos) return source + "\n" + defines;
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+void Shader::setBinaryCacheDirectory(const std::string& directory) {
+    binaryCacheDirectory = directory;
+}
+
+// FNV-1a, continued across calls
+static void hashString(uint64_t& h, const char* text) {
+    for (const char* c = text; c && *c; c++) {
+        h ^= static_cast<unsigned char>(*c);
+        h *= 1099511628211ull;
+    }
+    h ^= 0xff;  // separator, so concatenations of different fields never collide
+    h *= 1099511628211ull;
+}
+
+std::string Shader::binaryCachePath(const std::string& vertexSource, const std::string& fragmentSource) {
+    if (binaryCacheDirectory.empty() || !GLAD_GL_ARB_get_program_binary) return "";
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) return "";
+
+    uint64_t h = 14695981039346656037ull;
+    hashString(h, vertexSource.c_str());
+    hashString(h, fragmentSource.c_str());
+    hashString(h, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    hashString(h, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    hashString(h, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(h));
+    return binaryCacheDirectory + "/" + name;
+}
+
+GLuint Shader::loadProgramBinary(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return 0;
+    GLenum format = 0;
+    if (!file.read(reinterpret_cast<char*>(&format), sizeof(format))) return 0;
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Driver update or a different GPU: recompile and overwrite the entry
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void Shader::saveProgramBinary(GLuint program, const std::string& path) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write shader cache: " << path << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), length);
+}
+
+bool Shader::loadFromSource(const std::string& vertexSource, const std::string& fragmentSource,
+                            const std::string& defines) {
+    std::string vertexText = injectDefines(vertexSource, defines);
+    std::string fragmentText = injectDefines(fragmentSource, defines);
+    std::string cachePath = binaryCachePath(vertexText, fragmentText);
+    if (!cachePath.empty()) {
+        id = loadProgramBinary(cachePath);
+        if (id != 0) {
+            cacheUniformLocations();
+            return true;
+        }
+    }
+    
+    GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexText);
     if (vertex == 0) return false;
     
-    GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentText);
     if (fragment == 0) {
         glDeleteShader(vertex);
         return false;
     }
     
-    id = linkProgram(vertex, fragment);
+    id = linkProgram(vertex, fragment, !cachePath.empty());
+    cacheUniformLocations();
     
     glDeleteShader(vertex);
     glDeleteShader(fragment);
     
+    if (id != 0 && !cachePath.empty()) saveProgramBinary(id, cachePath);
+    return id != 0;
+}
+
+bool Shader::loadComputeFromSource(const std::string& computeSource, const std::string& defines) {
+    std::string computeText = injectDefines(computeSource, defines);
+    std::string cachePath = binaryCachePath(computeText, "");
+    if (!cachePath.empty()) {
+        id = loadProgramBinary(cachePath);
+        if (id != 0) {
+            cacheUniformLocations();
+            return true;
+        }
+    }
+    
+    GLuint compute = compileShader(GL_COMPUTE_SHADER, computeText);
+    if (compute == 0) return false;
+    
+    id = linkProgram(compute, 0, !cachePath.empty());
+    cacheUniformLocations();
+    glDeleteShader(compute);
+    
+    if (id != 0 && !cachePath.empty()) saveProgramBinary(id, cachePath);
     return id != 0;
 }
 
-bool Shader::loadFromFiles(const std::string& vertexPath, const std::string& fragmentPath) {
+bool Shader::loadFromFiles(const std::string& vertexPath, const std::string& fragmentPath,
+                           const std::string& defines) {
     std::string vertexSource = readFile(vertexPath);
     std::string fragmentSource = readFile(fragmentPath);
     
@@ -97,43 +247,94 @@ bool Shader::loadFromFiles(const std::string& vertexPath, const std::string& fra
         return false;
     }
     
-    return loadFromSource(vertexSource, fragmentSource);
+    return loadFromSource(vertexSource, fragmentSource, defines);
 }
 
 void Shader::use() const {
     glUseProgram(id);
 }
 
+GLint Shader::uniformLocation(const std::string& name) const {
+    auto it = uniformLocations.find(name);
+    return it != uniformLocations.end() ? it->second : -1;
+}
+
+void Shader::bindUniformBlock(const char* blockName, GLuint binding) const {
+    if (id == 0) return;
+    GLuint index = glGetUniformBlockIndex(id, blockName);
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(id, index, binding);
+}
+
 void Shader::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(id, name.c_str()), (int)value);
+    setBool(uniformLocation(name), value);
 }
 
 void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(id, name.c_str()), value);
+    setInt(uniformLocation(name), value);
+}
+
+void Shader::setUint(const std::string& name, GLuint value) const {
+    setUint(uniformLocation(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(id, name.c_str()), value);
+    setFloat(uniformLocation(name), value);
 }
 
 void Shader::setVec2(const std::string& name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(id, name.c_str()), 1, glm::value_ptr(value));
+    setVec2(uniformLocation(name), value);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(id, name.c_str()), 1, glm::value_ptr(value));
+    setVec3(uniformLocation(name), value);
 }
 
 void Shader::setVec4(const std::string& name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(id, name.c_str()), 1, glm::value_ptr(value));
+    setVec4(uniformLocation(name), value);
 }
 
 void Shader::setMat3(const std::string& name, const glm::mat3& value) const {
-    glUniformMatrix3fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    setMat3(uniformLocation(name), value);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& value) const {
-    glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    setMat4(uniformLocation(name), value);
+}
+
+void Shader::setBool(GLint location, bool value) const {
+    glUniform1i(location, (int)value);
+}
+
+void Shader::setInt(GLint location, int value) const {
+    glUniform1i(location, value);
+}
+
+void Shader::setUint(GLint location, GLuint value) const {
+    glUniform1ui(location, value);
+}
+
+void Shader::setFloat(GLint location, float value) const {
+    glUniform1f(location, value);
+}
+
+void Shader::setVec2(GLint location, const glm::vec2& value) const {
+    glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setVec3(GLint location, const glm::vec3& value) const {
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setVec4(GLint location, const glm::vec4& value) const {
+    glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void Shader::setMat3(GLint location, const glm::mat3& value) const {
+    glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setMat4(GLint location, const glm::mat4& value) const {
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
 } // namespace opticsketch
@@ -2,6 +2,7 @@
 
 #include <glad/glad.h>
 #include <string>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -12,18 +13,37 @@ public:
     Shader() : id(0) {}
     ~Shader();
     
-    // Load and compile shader from source strings
-    bool loadFromSource(const std::string& vertexSource, const std::string& fragmentSource);
+    // Load and compile shader from source strings. 'defines' (e.g. "#define INSTANCED\n")
+    // is inserted after the #version line of both stages.
+    bool loadFromSource(const std::string& vertexSource, const std::string& fragmentSource,
+                        const std::string& defines = "");
+    
+    // Load and compile a compute program (needs GL 4.3 or ARB_compute_shader)
+    bool loadComputeFromSource(const std::string& computeSource, const std::string& defines = "");
+    
+    // Directory for linked program binaries (empty disables the cache). Programs are keyed
+    // by their final sources plus the driver's vendor, renderer and version; a missing or
+    // rejected binary falls back to compiling, and the result is stored for the next run.
+    static void setBinaryCacheDirectory(const std::string& directory);
     
     // Load and compile shader from files
-    bool loadFromFiles(const std::string& vertexPath, const std::string& fragmentPath);
+    bool loadFromFiles(const std::string& vertexPath, const std::string& fragmentPath,
+                       const std::string& defines = "");
     
     // Use this shader
     void use() const;
     
+    // Location of an active uniform, resolved once at link time (-1 if not active).
+    // Hot paths should resolve handles up front and use the GLint setters below.
+    GLint uniformLocation(const std::string& name) const;
+    
+    // Attach a uniform block to a buffer binding point (no-op if the block is not active)
+    void bindUniformBlock(const char* blockName, GLuint binding) const;
+    
     // Set uniform values
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
+    void setUint(const std::string& name, GLuint value) const;
     void setFloat(const std::string& name, float value) const;
     void setVec2(const std::string& name, const glm::vec2& value) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
@@ -31,6 +51,17 @@ public:
     void setMat3(const std::string& name, const glm::mat3& value) const;
     void setMat4(const std::string& name, const glm::mat4& value) const;
     
+    // Set uniform values by pre-resolved location (-1 is ignored by GL)
+    void setBool(GLint location, bool value) const;
+    void setInt(GLint location, int value) const;
+    void setUint(GLint location, GLuint value) const;
+    void setFloat(GLint location, float value) const;
+    void setVec2(GLint location, const glm::vec2& value) const;
+    void setVec3(GLint location, const glm::vec3& value) const;
+    void setVec4(GLint location, const glm::vec4& value) const;
+    void setMat3(GLint location, const glm::mat3& value) const;
+    void setMat4(GLint location, const glm::mat4& value) const;
+    
     GLuint getId() const { return id; }
     
     // Explicit cleanup method
@@ -38,10 +69,19 @@ public:
     
 private:
     GLuint id;
+    std::unordered_map<std::string, GLint> uniformLocations;
     
     std::string readFile(const std::string& filepath);
+    static std::string injectDefines(const std::string& source, const std::string& defines);
     GLuint compileShader(GLenum type, const std::string& source);
-    GLuint linkProgram(GLuint vertex, GLuint fragment);
+    // Compute programs pass their single stage as 'vertex' and 0 for 'fragment'
+    GLuint linkProgram(GLuint vertex, GLuint fragment, bool retrievable);
+    static std::string binaryCachePath(const std::string& vertexSource, const std::string& fragmentSource);
+    static GLuint loadProgramBinary(const std::string& path);
+    static void saveProgramBinary(GLuint program, const std::string& path);
+    
+    static std::string binaryCacheDirectory;
+    void cacheUniformLocations();
 };
 
 } // namespace opticsketch
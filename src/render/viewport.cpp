@@ -3,13 +3,22 @@
 #include "render/beam.h"
 #include "scene/scene.h"
 #include "elements/element.h"
+#include "render/mesh_store.h"
+#include "render/half_float.h"
+#include "render/environment_map.h"
 #include "export/export_png.h"
+#include "export/image_stream.h"
+#include "profile/profiler.h"
+#include "jobs/job_system.h"
 #include "stb_image.h"
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <cmath>
 #include <algorithm>
 #include <cfloat>
+#include <cstddef>
+#include <cstring>
 #include <limits>
 #include <tuple>
 #include <glm/gtc/matrix_inverse.hpp>
@@ -18,7 +27,23 @@ namespace opticsketch {
 
 // Forward declarations for helper functions defined later in this file
 static CachedMesh createCachedMesh(const std::vector<float>& vertices, int floatsPerVertex = 6);
+static CachedMesh createIndexedMesh(const std::vector<float>& vertices, const std::vector<uint32_t>& indices,
+                                    bool quantized);
+static void drawCachedMesh(const CachedMesh& mesh, GLenum mode);
 static void deleteCachedMesh(CachedMesh& mesh);
+static void deleteLineBatch(LineBatch& batch);
+static void appendInstance(std::vector<float>& out, const glm::mat4& model, const glm::mat3& normalMatrix,
+                           const glm::vec3& color, float alpha, const glm::vec3& material, uint32_t objectId);
+static float packObjectId(uint32_t objectId);
+static uint32_t encodeObjectId(SceneObjectKind kind, size_t slot);
+
+// Selects the per-instance attribute path in grid.vert / grid.frag / material.frag
+static const char* kInstancedDefine = "#define INSTANCED\n";
+// Selects the weighted blended transparency outputs of material.frag
+static const char* kOitDefine = "#define OIT\n";
+
+// Width in pixels of traced ray segments
+static constexpr float kTracedLineWidth = 2.0f;
 
 Viewport::Viewport() {
     camera.setAspectRatio(static_cast<float>(width) / height);
@@ -33,26 +58,45 @@ void Viewport::cleanup() {
     // Cleanup OpenGL resources
     // This should be called explicitly before destroying the OpenGL context
     destroyFramebuffer();
+    destroyPickReadback();
     if (gridVAO != 0) {
         glDeleteVertexArrays(1, &gridVAO);
         glDeleteBuffers(1, &gridVBO);
         gridVAO = 0;
         gridVBO = 0;
     }
+    gridInitialized = false;
+    gridBuiltSize = -1;
+    gridVertexCount = 0;
     // Delete prototype geometry caches
     for (int i = 0; i < kMaxPrototypes; i++) {
-        deleteCachedMesh(prototypeGeometry[i]);
+        for (int lod = 0; lod < kLodLevels; lod++) deleteCachedMesh(prototypeGeometry[lod][i]);
         deleteCachedMesh(prototypeWireframe[i]);
     }
+    deleteCachedMesh(meshPlaceholder);
     prototypesInitialized = false;
     // Delete per-instance mesh caches
-    for (auto& [id, mesh] : meshCache) {
-        deleteCachedMesh(mesh);
+    for (auto& [asset, mesh] : meshCache) {
+        for (CachedMesh& level : mesh.gpu) deleteCachedMesh(level);
     }
     meshCache.clear();
     // Delete beam buffer
-    deleteCachedMesh(beamBuffer);
     deleteCachedMesh(gaussianBuffer);
+    deleteLineBatch(beamBatch);
+    deleteLineBatch(overlayBatch);
+    if (gpuTraceVAO != 0) {
+        glDeleteVertexArrays(1, &gpuTraceVAO);
+        gpuTraceVAO = 0;
+        gpuTraceVAOBuffer = 0;
+    }
+    if (instanceVBO != 0) {
+        glDeleteBuffers(1, &instanceVBO);
+        instanceVBO = 0;
+    }
+    if (frameUBO != 0) {
+        glDeleteBuffers(1, &frameUBO);
+        frameUBO = 0;
+    }
     // HDRI cleanup
     destroyHdriTexture();
     // Thumbnail cleanup
@@ -90,6 +134,7 @@ void Viewport::init(int w, int h) {
         fragPath.replace(fragPath.find(".vert"), 5, ".frag");
         
         if (gridShader.loadFromFiles(vertPath, fragPath)) {
+            gridInstancedShader.loadFromFiles(vertPath, fragPath, kInstancedDefine);
             shaderLoaded = true;
             break;
         }
@@ -103,31 +148,71 @@ void Viewport::init(int w, int h) {
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 uniform mat4 uModel = mat4(1.0);
-uniform mat4 uView;
-uniform mat4 uProjection;
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
 uniform mat3 uNormalMatrix;
 out vec3 FragPos;
 out vec3 Normal;
+#ifdef INSTANCED
+layout (location = 2) in mat4 aInstanceModel;
+layout (location = 6) in mat3 aInstanceNormalMatrix;
+layout (location = 9) in vec4 aInstanceColor;
+layout (location = 10) in vec3 aInstanceMaterial;
+layout (location = 11) in uint aInstanceObjectId;
+flat out vec4 InstanceColor;
+flat out vec3 InstanceMaterial;
+flat out uint InstanceObjectId;
+#endif
 void main() {
+#ifdef INSTANCED
+    FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    Normal = aInstanceNormalMatrix * aNormal;
+    InstanceColor = aInstanceColor;
+    InstanceMaterial = aInstanceMaterial;
+    InstanceObjectId = aInstanceObjectId;
+#else
     FragPos = vec3(uModel * vec4(aPos, 1.0));
     Normal = uNormalMatrix * aNormal;
+#endif
     gl_Position = uProjection * uView * vec4(FragPos, 1.0);
 }
 )";
         const char* fragSource = R"(
 #version 330 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;
 in vec3 FragPos;
 in vec3 Normal;
+#ifdef INSTANCED
+flat in vec4 InstanceColor;
+flat in uint InstanceObjectId;
+#define uColor InstanceColor.rgb
+#define uAlpha InstanceColor.a
+#define uObjectId InstanceObjectId
+#else
 uniform vec3 uColor;
 uniform float uAlpha;
-uniform vec3 uLightPos;
-uniform vec3 uViewPos;
-uniform float uAmbientStrength = 0.14;
-uniform float uSpecularStrength = 0.55;
-uniform float uShininess = 48.0;
+uniform uint uObjectId = 0u;
+#endif
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
 uniform float uEmissive = 0.0;
 void main() {
+    ObjectId = uObjectId;
     if (uEmissive > 0.5) { FragColor = vec4(uColor, uAlpha); return; }
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(uViewPos - FragPos);
@@ -147,6 +232,7 @@ void main() {
 }
 )";
         gridShader.loadFromSource(vertSource, fragSource);
+        gridInstancedShader.loadFromSource(vertSource, fragSource, kInstancedDefine);
     }
     
     // Load material shader (uses same vertex shader as grid)
@@ -163,6 +249,8 @@ void main() {
             std::string dir = fp.substr(0, fp.rfind('/'));
             std::string vertPath = dir + "/grid.vert";
             if (materialShader.loadFromFiles(vertPath.c_str(), fragPath)) {
+                materialInstancedShader.loadFromFiles(vertPath.c_str(), fragPath, kInstancedDefine);
+                materialOitShader.loadFromFiles(vertPath.c_str(), fragPath, kOitDefine);
                 matShaderLoaded = true;
                 break;
             }
@@ -174,46 +262,101 @@ void main() {
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 uniform mat4 uModel = mat4(1.0);
-uniform mat4 uView;
-uniform mat4 uProjection;
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
 uniform mat3 uNormalMatrix;
 out vec3 FragPos;
 out vec3 Normal;
+#ifdef INSTANCED
+layout (location = 2) in mat4 aInstanceModel;
+layout (location = 6) in mat3 aInstanceNormalMatrix;
+layout (location = 9) in vec4 aInstanceColor;
+layout (location = 10) in vec3 aInstanceMaterial;
+layout (location = 11) in uint aInstanceObjectId;
+flat out vec4 InstanceColor;
+flat out vec3 InstanceMaterial;
+flat out uint InstanceObjectId;
+#endif
 void main() {
+#ifdef INSTANCED
+    FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    Normal = aInstanceNormalMatrix * aNormal;
+    InstanceColor = aInstanceColor;
+    InstanceMaterial = aInstanceMaterial;
+    InstanceObjectId = aInstanceObjectId;
+#else
     FragPos = vec3(uModel * vec4(aPos, 1.0));
     Normal = uNormalMatrix * aNormal;
+#endif
     gl_Position = uProjection * uView * vec4(FragPos, 1.0);
 }
 )";
             const char* matFragSource = R"(
 #version 330 core
-out vec4 FragColor;
+#ifdef OIT
+layout (location = 0) out vec4 Accum;
+layout (location = 1) out uint ObjectId;
+layout (location = 2) out vec4 AccumWeight;
+uniform float uOitDepthScale = 100.0;
+#else
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;
+#endif
 in vec3 FragPos;
 in vec3 Normal;
+#ifdef INSTANCED
+flat in vec4 InstanceColor;
+flat in uint InstanceObjectId;
+flat in vec3 InstanceMaterial;
+#define uColor InstanceColor.rgb
+#define uAlpha InstanceColor.a
+#define uObjectId InstanceObjectId
+#else
 uniform vec3 uColor;
 uniform float uAlpha;
-uniform vec3 uLightPos;
-uniform vec3 uViewPos;
-uniform float uAmbientStrength = 0.14;
-uniform float uSpecularStrength = 0.55;
-uniform float uShininess = 48.0;
+uniform uint uObjectId = 0u;
+#endif
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+#ifdef INSTANCED
+#define uMetallic InstanceMaterial.x
+#define uRoughness InstanceMaterial.y
+#define uFresnelIOR InstanceMaterial.z
+#else
 uniform float uMetallic = 0.0;
 uniform float uRoughness = 0.5;
-uniform float uTransparency = 0.0;
 uniform float uFresnelIOR = 1.5;
+#endif
+uniform float uTransparency = 0.0;
 uniform sampler2D uEnvMap;
 uniform bool uHasEnvMap = false;
 uniform float uEnvIntensity = 1.0;
 uniform float uEnvRotation = 0.0;
+uniform float uEnvMaxLod = 0.0;
 const float PI = 3.14159265359;
-vec3 sampleEquirectangular(vec3 dir, float rotation) {
+vec3 sampleEquirectangular(vec3 dir, float rotation, float lod) {
     float cosR = cos(rotation); float sinR = sin(rotation);
     vec3 rd = vec3(cosR*dir.x + sinR*dir.z, dir.y, -sinR*dir.x + cosR*dir.z);
     float u = atan(rd.z, rd.x) / (2.0*PI) + 0.5;
     float v = asin(clamp(rd.y, -1.0, 1.0)) / PI + 0.5;
-    return texture(uEnvMap, vec2(u, v)).rgb;
+    return textureLod(uEnvMap, vec2(u, v), lod).rgb;
 }
 void main() {
+    ObjectId = uObjectId;
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(uViewPos - FragPos);
     vec3 lightDir = normalize(uLightPos - FragPos);
@@ -237,18 +380,27 @@ void main() {
     vec3 result = (ambient + diffuse + fillLight) * baseColor + specular;
     if (uHasEnvMap) {
         vec3 reflectDir = reflect(-viewDir, norm);
-        vec3 envColor = sampleEquirectangular(reflectDir, uEnvRotation);
-        float envStrength = 1.0 - uRoughness * 0.85;
+        vec3 envColor = sampleEquirectangular(reflectDir, uEnvRotation, uRoughness * uEnvMaxLod);
+        float envStrength = 1.0 - uRoughness * 0.5;
         vec3 envTint = mix(vec3(1.0), uColor, uMetallic);
         result += envColor * envTint * envStrength * fresnel * uEnvIntensity;
     }
     if (uTransparency > 0.01) { result += fresnel * vec3(0.3) * uTransparency; }
     result = result / (1.0 + 0.15 * length(result));
     float alpha = uAlpha * (1.0 - uTransparency * (1.0 - fresnel * 0.5));
+#ifdef OIT
+    float depth = length(uViewPos - FragPos) / uOitDepthScale;
+    float weight = clamp(10.0 / (1e-5 + pow(depth, 4.0)), 1e-2, 3e3);
+    Accum = vec4(result * alpha * weight, alpha);
+    AccumWeight = vec4(alpha * weight);
+#else
     FragColor = vec4(result, alpha);
+#endif
 }
 )";
             materialShader.loadFromSource(matVertSource, matFragSource);
+            materialInstancedShader.loadFromSource(matVertSource, matFragSource, kInstancedDefine);
+            materialOitShader.loadFromSource(matVertSource, matFragSource, kOitDefine);
         }
     }
 
@@ -292,10 +444,358 @@ void main() {
         }
     }
 
+    // Scene shaders read camera and shading state from the shared frame block
+    for (Shader* shader : {&gridShader, &gridInstancedShader, &materialShader, &materialInstancedShader,
+                           &materialOitShader}) {
+        shader->bindUniformBlock("FrameData", kFrameBlockBinding);
+    }
+
+    initLineShader();
+    initWireShaders();
+    initGaussianShader();
     initGrid();
     initPrototypeGeometry();
 }
 
+// Fallback sources for line.vert / wire.vert / line.frag when the files are missing.
+// Both vertex stages share the screen-space expansion.
+static const char* kLineFrameBlock = R"(
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+uniform vec2 uViewportSize;
+out vec4 Color;
+flat out uint LineObjectId;
+noperspective out float EdgeDistance;
+noperspective out float HalfWidth;
+vec4 expandLine(vec4 clipA, vec4 clipB, float width) {
+    float dA = clipA.z + clipA.w;
+    float dB = clipB.z + clipB.w;
+    if (dA < 0.0 && dB < 0.0) return vec4(0.0, 0.0, 2.0, 1.0);
+    if (dA < 0.0) clipA = mix(clipA, clipB, dA / (dA - dB));
+    if (dB < 0.0) clipB = mix(clipB, clipA, dB / (dB - dA));
+    int corner = gl_VertexID & 3;
+    bool atB = corner >= 2;
+    float side = (corner & 1) == 0 ? -1.0 : 1.0;
+    vec2 halfSize = 0.5 * uViewportSize;
+    vec2 dir = clipB.xy / clipB.w * halfSize - clipA.xy / clipA.w * halfSize;
+    float len = length(dir);
+    dir = len > 1e-4 ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(dir.y, -dir.x);
+    HalfWidth = max(width, 1.0) * 0.5;
+    float extent = HalfWidth + 1.0;
+    EdgeDistance = side * extent;
+    vec2 offset = normal * side * extent + dir * (atB ? extent : -extent);
+    vec4 clip = atB ? clipB : clipA;
+    return vec4(clip.xy + offset / halfSize * clip.w, clip.zw);
+}
+)";
+
+static const char* kLineFragSource = R"(
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out uint ObjectId;
+in vec4 Color;
+flat in uint LineObjectId;
+noperspective in float EdgeDistance;
+noperspective in float HalfWidth;
+uniform float uColorScale = 1.0;
+void main() {
+    float coverage = clamp(HalfWidth + 0.5 - abs(EdgeDistance), 0.0, 1.0);
+    if (coverage <= 0.0) discard;
+    ObjectId = LineObjectId;
+    FragColor = vec4(Color.rgb * uColorScale, Color.a * coverage);
+}
+)";
+
+void Viewport::initLineShader() {
+    const char* linePaths[] = {
+        "assets/shaders/line.frag",
+        "../assets/shaders/line.frag",
+        "../../assets/shaders/line.frag"
+    };
+    for (const char* fragPath : linePaths) {
+        std::string fp(fragPath);
+        std::string dir = fp.substr(0, fp.rfind('/'));
+        std::string vertPath = dir + "/line.vert";
+        if (lineShader.loadFromFiles(vertPath.c_str(), fragPath)) {
+            lineShader.bindUniformBlock("FrameData", kFrameBlockBinding);
+            return;
+        }
+    }
+
+    std::string lineVert = std::string("#version 330 core\n") + R"(
+layout (location = 0) in vec3 aPosA;
+layout (location = 1) in vec4 aColorA;
+layout (location = 2) in float aWidthA;
+layout (location = 3) in uint aObjectId;
+layout (location = 4) in vec3 aPosB;
+layout (location = 5) in vec4 aColorB;
+layout (location = 6) in float aWidthB;
+layout (location = 7) in float aPathA;
+layout (location = 8) in float aPathB;
+uniform float uPropagation = -1.0;
+)" + kLineFrameBlock + R"(
+void main() {
+    vec3 posB = aPosB;
+    if (uPropagation >= 0.0 && aPathA >= 0.0) {
+        if (aPathA >= uPropagation) {
+            gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+            return;
+        }
+        if (aPathB > uPropagation) posB = mix(aPosA, aPosB, (uPropagation - aPathA) / (aPathB - aPathA));
+    }
+    mat4 viewProjection = uProjection * uView;
+    bool atB = (gl_VertexID & 3) >= 2;
+    float width = atB ? aWidthB : aWidthA;
+    gl_Position = expandLine(viewProjection * vec4(aPosA, 1.0), viewProjection * vec4(posB, 1.0), width);
+    Color = atB ? aColorB : aColorA;
+    Color.a *= clamp(width, 0.0, 1.0);
+    LineObjectId = aObjectId;
+}
+)";
+    lineShader.loadFromSource(lineVert, kLineFragSource);
+    lineShader.bindUniformBlock("FrameData", kFrameBlockBinding);
+}
+
+void Viewport::initWireShaders() {
+    const char* wirePaths[] = {
+        "assets/shaders/wire.vert",
+        "../assets/shaders/wire.vert",
+        "../../assets/shaders/wire.vert"
+    };
+    bool loaded = false;
+    for (const char* vertPath : wirePaths) {
+        std::string vp(vertPath);
+        std::string fragPath = vp.substr(0, vp.rfind('/')) + "/line.frag";
+        if (wireShader.loadFromFiles(vertPath, fragPath)) {
+            wireInstancedShader.loadFromFiles(vertPath, fragPath, kInstancedDefine);
+            loaded = true;
+            break;
+        }
+    }
+    if (!loaded) {
+        std::string wireVert = std::string("#version 330 core\n") + R"(
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aOtherPos;
+uniform mat4 uModel = mat4(1.0);
+uniform float uLineWidth = 1.0;
+#ifdef INSTANCED
+layout (location = 2) in mat4 aInstanceModel;
+layout (location = 9) in vec4 aInstanceColor;
+layout (location = 11) in uint aInstanceObjectId;
+#else
+uniform vec3 uColor;
+uniform float uAlpha = 1.0;
+uniform uint uObjectId = 0u;
+#endif
+)" + kLineFrameBlock + R"(
+void main() {
+#ifdef INSTANCED
+    mat4 model = aInstanceModel;
+    Color = aInstanceColor;
+    LineObjectId = aInstanceObjectId;
+#else
+    mat4 model = uModel;
+    Color = vec4(uColor, uAlpha);
+    LineObjectId = uObjectId;
+#endif
+    Color.a *= clamp(uLineWidth, 0.0, 1.0);
+    bool atB = (gl_VertexID & 3) >= 2;
+    vec3 posA = atB ? aOtherPos : aPos;
+    vec3 posB = atB ? aPos : aOtherPos;
+    mat4 modelViewProjection = uProjection * uView * model;
+    gl_Position = expandLine(modelViewProjection * vec4(posA, 1.0), modelViewProjection * vec4(posB, 1.0),
+                             uLineWidth);
+}
+)";
+        wireShader.loadFromSource(wireVert, kLineFragSource);
+        wireInstancedShader.loadFromSource(wireVert, kLineFragSource, kInstancedDefine);
+    }
+    for (Shader* shader : {&wireShader, &wireInstancedShader}) {
+        shader->bindUniformBlock("FrameData", kFrameBlockBinding);
+    }
+}
+
+void Viewport::initGaussianShader() {
+    // Lit like the instanced scene shader: grid.frag with per-instance color
+    const char* vertPaths[] = {
+        "assets/shaders/gaussian_envelope.vert",
+        "../assets/shaders/gaussian_envelope.vert",
+        "../../assets/shaders/gaussian_envelope.vert"
+    };
+    for (const char* vertPath : vertPaths) {
+        std::string vp(vertPath);
+        std::string fragPath = vp.substr(0, vp.rfind('/')) + "/grid.frag";
+        if (gaussianShader.loadFromFiles(vertPath, fragPath, kInstancedDefine)) {
+            gaussianShader.bindUniformBlock("FrameData", kFrameBlockBinding);
+            return;
+        }
+    }
+
+    const char* gaussVert = R"(
+#version 330 core
+layout (location = 0) in vec4 aStartWaist;
+layout (location = 1) in vec4 aEndRange;
+layout (location = 2) in vec4 aColor;
+layout (location = 3) in vec4 aWaistSamples;
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+uniform vec3 uCameraUp;
+uniform float uPropagation = -1.0;
+out vec3 FragPos;
+out vec3 Normal;
+flat out vec4 InstanceColor;
+void main() {
+    vec3 start = aStartWaist.xyz;
+    vec3 axis = aEndRange.xyz - start;
+    float len = length(axis);
+    vec3 dir = axis / len;
+    float zR = aEndRange.w;
+    float waistZ = aWaistSamples.x;
+    int samples = int(aWaistSamples.y);
+    int i = min(gl_VertexID / 2, samples - 1);
+    float u = mix(asinh(-waistZ / zR), asinh((len - waistZ) / zR), float(i) / float(samples - 1));
+    float reach = (uPropagation >= 0.0 && aWaistSamples.z > 0.0) ? min(uPropagation, len) : len;
+    float z = clamp(waistZ + zR * sinh(u), 0.0, reach);
+    float w = aStartWaist.w * cosh(u);
+    vec3 toCamera = uViewPos - (start + aEndRange.xyz) * 0.5;
+    vec3 crossVec = cross(dir, toCamera);
+    if (dot(crossVec, crossVec) < 1e-12) crossVec = cross(dir, uCameraUp);
+    float side = (gl_VertexID % 2 == 0) ? 1.0 : -1.0;
+    FragPos = start + dir * z + normalize(crossVec) * (w * side);
+    Normal = normalize(toCamera);
+    InstanceColor = aColor;
+    gl_Position = uProjection * uView * vec4(FragPos, 1.0);
+}
+)";
+    const char* gaussFrag = R"(
+#version 330 core
+out vec4 FragColor;
+in vec3 FragPos;
+in vec3 Normal;
+flat in vec4 InstanceColor;
+layout (std140) uniform FrameData {
+    mat4 uView;
+    mat4 uProjection;
+    vec3 uLightPos;
+    float uAmbientStrength;
+    vec3 uViewPos;
+    float uSpecularStrength;
+    float uShininess;
+};
+void main() {
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(uViewPos - FragPos);
+    vec3 lightDir = normalize(uLightPos - FragPos);
+    vec3 diffuse = vec3(max(dot(norm, lightDir), 0.0));
+    vec3 fillLight = max(dot(norm, normalize(-uLightPos - FragPos)), 0.0) * vec3(0.4, 0.45, 0.5);
+    vec3 ambient = vec3(uAmbientStrength);
+    float spec = pow(max(dot(norm, normalize(lightDir + viewDir)), 0.0), uShininess);
+    vec3 result = (ambient + diffuse + fillLight + uSpecularStrength * spec) * InstanceColor.rgb;
+    result = result / (1.0 + 0.15 * length(result));
+    FragColor = vec4(result, InstanceColor.a);
+}
+)";
+    gaussianShader.loadFromSource(gaussVert, gaussFrag);
+    gaussianShader.bindUniformBlock("FrameData", kFrameBlockBinding);
+}
+
+void LineBatch::addVertex(const glm::vec3& p, const glm::vec4& c, uint32_t objectId, float width, float path) {
+    vertices.push_back(p.x); vertices.push_back(p.y); vertices.push_back(p.z);
+    vertices.push_back(c.r); vertices.push_back(c.g); vertices.push_back(c.b); vertices.push_back(c.a);
+    vertices.push_back(width);
+    vertices.push_back(packObjectId(objectId));
+    vertices.push_back(path);
+}
+
+// Point line.vert at the bound buffer: one instance per vertex pair. Without per-vertex
+// width, id and path (the GPU tracer's layout) those attributes stay disabled and read
+// the current generic values.
+static void setLineSegmentAttributes(int floatsPerVertex, bool widthAndId) {
+    const GLsizei stride = 2 * floatsPerVertex * sizeof(float);
+    const size_t second = floatsPerVertex * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)second);
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (void*)(second + 3 * sizeof(float)));
+    if (widthAndId) {
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, stride, (void*)(8 * sizeof(float)));
+        glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, stride, (void*)(second + 7 * sizeof(float)));
+        glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, stride, (void*)(9 * sizeof(float)));
+        glVertexAttribPointer(8, 1, GL_FLOAT, GL_FALSE, stride, (void*)(second + 9 * sizeof(float)));
+    }
+    const GLuint locations[] = {0, 1, 4, 5, 2, 3, 6, 7, 8};
+    for (int i = 0; i < (widthAndId ? 9 : 4); i++) {
+        glEnableVertexAttribArray(locations[i]);
+        glVertexAttribDivisor(locations[i], 1);
+    }
+}
+
+// Size of the current GL viewport (the window, an export tile or a thumbnail), which
+// screen-space line widths are measured against
+static glm::vec2 currentViewportSize() {
+    GLint vp[4];
+    glGetIntegerv(GL_VIEWPORT, vp);
+    return glm::vec2(static_cast<float>(std::max(vp[2], 1)), static_cast<float>(std::max(vp[3], 1)));
+}
+
+void Viewport::uploadLineBatch(LineBatch& batch) {
+    // Lazy-init VAO/VBO
+    if (batch.vao == 0) {
+        glGenVertexArrays(1, &batch.vao);
+        glGenBuffers(1, &batch.vbo);
+        glBindVertexArray(batch.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+        setLineSegmentAttributes(LineBatch::kFloatsPerVertex, true);
+        batch.uploaded.clear();
+    }
+
+    glBindVertexArray(batch.vao);
+    if (batch.vertices != batch.uploaded) {
+        // Orphan and refill the whole buffer in one call
+        glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(batch.vertices.size() * sizeof(float)),
+                     batch.vertices.data(), GL_DYNAMIC_DRAW);
+        OPTICSKETCH_PROFILE_UPLOAD(batch.vertices.size() * sizeof(float));
+        batch.uploaded = batch.vertices;
+    }
+}
+
+void Viewport::beginLineDraw(float colorScale) {
+    lineShader.use();
+    lineShader.setFloat("uColorScale", colorScale);
+    lineShader.setVec2("uViewportSize", currentViewportSize());
+    lineShader.setFloat("uPropagation", propagationDistance);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Viewport::drawLineSegments(GLsizei segmentCount) {
+    if (segmentCount <= 0) return;
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, segmentCount);
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+}
+
+void Viewport::endLineDraw() {
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+}
+
 void Viewport::resize(int w, int h) {
     if (width == w && height == h) return;
     
@@ -305,9 +805,14 @@ void Viewport::resize(int w, int h) {
     
     destroyFramebuffer();
     createFramebuffer();
+    if (bloomInitialized) {
+        destroyBloomTargets();
+        createBloomTargets();
+    }
 }
 
 void Viewport::createFramebuffer() {
+    frameStale = true;
     // Create framebuffer
     glGenFramebuffers(1, &framebufferId);
     glBindFramebuffer(GL_FRAMEBUFFER, framebufferId);
@@ -319,6 +824,17 @@ void Viewport::createFramebuffer() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureId, 0);
+
+    // Object ids for GPU picking; only drawn into while setIdWrites() routes output 1 there
+    if (idBufferEnabled) {
+        glGenTextures(1, &idTextureId);
+        glBindTexture(GL_TEXTURE_2D, idTextureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, idTextureId, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
     
     // Create renderbuffer for depth/stencil
     glGenRenderbuffers(1, &renderbufferId);
@@ -344,10 +860,17 @@ void Viewport::destroyFramebuffer() {
         glDeleteTextures(1, &textureId);
         textureId = 0;
     }
+    if (idTextureId != 0) {
+        glDeleteTextures(1, &idTextureId);
+        idTextureId = 0;
+    }
+    idWrites = false;
     if (renderbufferId != 0) {
         glDeleteRenderbuffers(1, &renderbufferId);
         renderbufferId = 0;
     }
+    // Shares the depth buffer and id texture just deleted
+    destroyOitTargets();
 }
 
 void Viewport::beginFrame() {
@@ -360,6 +883,13 @@ void Viewport::beginFrame() {
     if (isSchematic) bg = glm::vec3(1.0f, 1.0f, 1.0f);
     glClearColor(bg.r, bg.g, bg.b, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (idTextureId != 0) {
+        // Draw buffer 1 is the id attachment while writes are enabled
+        const GLuint noObject[4] = {0, 0, 0, 0};
+        setIdWrites(true);
+        glClearBufferuiv(GL_COLOR, 1, noObject);
+        setIdWrites(false);
+    }
 
     // Gradient background (not in Schematic mode)
     if (!isSchematic && style && style->bgMode == BackgroundMode::Gradient) {
@@ -367,10 +897,12 @@ void Viewport::beginFrame() {
         glDisable(GL_DEPTH_TEST);
         glDepthMask(GL_FALSE);
         gradientShader.use();
-        gradientShader.setVec3("uTopColor", style->bgGradientTop);
-        gradientShader.setVec3("uBottomColor", style->bgGradientBottom);
+        // A tile shows only part of the gradient (the full range outside tiled export)
+        gradientShader.setVec3("uTopColor", glm::mix(style->bgGradientBottom, style->bgGradientTop, tileSpanTop));
+        gradientShader.setVec3("uBottomColor", glm::mix(style->bgGradientBottom, style->bgGradientTop, tileSpanBottom));
         glBindVertexArray(fullscreenVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
         glBindVertexArray(0);
         glDepthMask(GL_TRUE);
     }
@@ -379,27 +911,198 @@ void Viewport::beginFrame() {
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
+
+    // Camera and lighting state for every pass this frame (Schematic: fully flat, no specular)
+    frameUniforms.view = camera.getViewMatrix();
+    frameUniforms.projection = tileProjection * camera.getProjectionMatrix();
+    frameUniforms.lightPos = camera.position;
+    frameUniforms.viewPos = camera.position;
+    if (isSchematic) {
+        frameAmbient = 1.0f;
+        frameSpecular = 0.0f;
+        frameShininess = 1.0f;
+    } else {
+        frameAmbient = style ? style->ambientStrength : 0.14f;
+        frameSpecular = style ? style->specularStrength : 0.55f;
+        frameShininess = style ? style->specularShininess : 48.0f;
+    }
+    frameUniforms.ambientStrength = frameAmbient;
+    frameUniforms.specularStrength = frameSpecular;
+    frameUniforms.shininess = frameShininess;
+    uploadFrameUniforms();
+
+    frustum.extract(frameUniforms.projection * frameUniforms.view);
+    culledObjects = 0;
+}
+
+bool Viewport::cullBox(const glm::vec3& worldMin, const glm::vec3& worldMax) {
+    if (!frustumCulling || frustum.intersectsBox(worldMin, worldMax)) return false;
+    culledObjects++;
+    return true;
+}
+
+bool Viewport::cullSegment(const glm::vec3& a, const glm::vec3& b, float padding) {
+    if (!frustumCulling || frustum.intersectsSegment(a, b, padding)) return false;
+    culledObjects++;
+    return true;
+}
+
+void Viewport::uploadFrameUniforms() {
+    if (frameUBO == 0) {
+        glGenBuffers(1, &frameUBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frameUniforms);
+    OPTICSKETCH_PROFILE_UPLOAD(sizeof(FrameUniforms));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, kFrameBlockBinding, frameUBO);
+}
+
+void Viewport::setFrameShading(float ambient, float specular, float shininess) {
+    frameUniforms.ambientStrength = ambient;
+    frameUniforms.specularStrength = specular;
+    frameUniforms.shininess = shininess;
+    uploadFrameUniforms();
+}
+
+void Viewport::restoreFrameShading() {
+    setFrameShading(frameAmbient, frameSpecular, frameShininess);
 }
 
 void Viewport::endFrame() {
+    frameStale = false;
+    setIdWrites(false);
+    if (pickRequested && idTextureId != 0) readPickRegion();
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
 }
 
+void Viewport::setIdBufferEnabled(bool enabled) {
+    if (enabled == idBufferEnabled) return;
+    idBufferEnabled = enabled;
+    destroyPickReadback();
+    if (framebufferId != 0) {
+        destroyFramebuffer();
+        createFramebuffer();
+    }
+}
+
+void Viewport::setIdWrites(bool enabled) {
+    if (idTextureId == 0 || enabled == idWrites) return;
+    idWrites = enabled;
+    // Integer attachments ignore blending, so translucent draws still write their id
+    const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(enabled ? 2 : 1, buffers);
+}
+
+void Viewport::requestPick(int x, int y) {
+    // A newer click supersedes a read still in flight
+    if (pickFence) {
+        glDeleteSync(pickFence);
+        pickFence = nullptr;
+    }
+    pickRequested = true;
+    pickX = x;
+    pickY = y;
+}
+
+void Viewport::readPickRegion() {
+    pickRequested = false;
+    const int size = kPickRadius * 2 + 1;
+    // Top-left origin to GL rows, with the block kept inside the framebuffer
+    int x0 = std::clamp(pickX - kPickRadius, 0, std::max(width - size, 0));
+    int y0 = std::clamp(height - 1 - pickY - kPickRadius, 0, std::max(height - size, 0));
+    int w = std::min(size, width);
+    int h = std::min(size, height);
+
+    if (pickPBO == 0) {
+        glGenBuffers(1, &pickPBO);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pickPBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size * size * sizeof(uint32_t), nullptr, GL_STREAM_READ);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferId);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pickPBO);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // Queued on the GPU; the result is mapped on a later frame once the fence has passed
+    glReadPixels(x0, y0, w, h, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    pickFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // Where the requested pixel landed in the block (it shifts at the framebuffer edges)
+    pickRegionW = w;
+    pickRegionH = h;
+    pickCenterX = std::clamp(pickX - x0, 0, w - 1);
+    pickCenterY = std::clamp(height - 1 - pickY - y0, 0, h - 1);
+    pickGeneration = idLayoutGeneration;
+}
+
+bool Viewport::takePickResult(SceneHandle& out) {
+    if (!pickFence) return false;
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(pickFence, GL_SYNC_STATUS, 1, nullptr, &status);
+    if (status != GL_SIGNALED) return false;
+    glDeleteSync(pickFence);
+    pickFence = nullptr;
+
+    out = SceneHandle{};
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pickPBO);
+    const auto* ids = static_cast<const uint32_t*>(glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, pickRegionW * pickRegionH * sizeof(uint32_t), GL_MAP_READ_BIT));
+    if (ids) {
+        // The object closest to the requested pixel wins, so thin beams pick without
+        // pixel-exact aim
+        int bestDist = std::numeric_limits<int>::max();
+        uint32_t best = 0;
+        for (int y = 0; y < pickRegionH; y++) {
+            for (int x = 0; x < pickRegionW; x++) {
+                uint32_t id = ids[y * pickRegionW + x];
+                if (id == 0) continue;
+                int dx = x - pickCenterX, dy = y - pickCenterY;
+                int dist = dx * dx + dy * dy;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = id;
+                }
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        if (best != 0) {
+            out.kind = static_cast<SceneObjectKind>(best >> 24);
+            out.index = (best & 0xFFFFFFu) - 1;
+            out.generation = pickGeneration;
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void Viewport::destroyPickReadback() {
+    if (pickFence) {
+        glDeleteSync(pickFence);
+        pickFence = nullptr;
+    }
+    if (pickPBO != 0) {
+        glDeleteBuffers(1, &pickPBO);
+        pickPBO = 0;
+    }
+    pickRequested = false;
+}
+
 void Viewport::initGrid() {
     if (gridInitialized) return;
     
-    // Create a large grid - we'll regenerate it dynamically in renderGrid
-    // For now, create a placeholder
-    std::vector<float> vertices;
-    
+    // Vertices are filled by renderGrid() once the spacing and size are known
     glGenVertexArrays(1, &gridVAO);
     glGenBuffers(1, &gridVBO);
     
     glBindVertexArray(gridVAO);
     glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
     
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -420,6 +1123,7 @@ static CachedMesh createCachedMesh(const std::vector<float>& vertices, int float
     glBindVertexArray(mesh.vao);
     glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    OPTICSKETCH_PROFILE_UPLOAD(vertices.size() * sizeof(float));
     // Position attribute (location 0)
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, floatsPerVertex * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -430,6 +1134,95 @@ static CachedMesh createCachedMesh(const std::vector<float>& vertices, int float
     return mesh;
 }
 
+// Pack a unit normal as signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV)
+static uint32_t packNormal1010102(float x, float y, float z) {
+    auto snorm10 = [](float v) {
+        int q = static_cast<int>(std::round(std::clamp(v, -1.0f, 1.0f) * 511.0f));
+        return static_cast<uint32_t>(q) & 0x3FFu;
+    };
+    return snorm10(x) | (snorm10(y) << 10) | (snorm10(z) << 20);
+}
+
+// Indexed mesh for welded 6-float vertices. Indices are 16-bit when every vertex fits.
+// Quantized meshes store half-float positions + packed normals: 12 bytes/vertex instead of 24.
+static CachedMesh createIndexedMesh(const std::vector<float>& vertices, const std::vector<uint32_t>& indices,
+                                    bool quantized) {
+    CachedMesh mesh;
+    mesh.vertexCount = static_cast<GLsizei>(vertices.size() / 6);
+    mesh.indexCount = static_cast<GLsizei>(indices.size());
+    if (mesh.vertexCount == 0 || mesh.indexCount == 0) {
+        mesh.vertexCount = 0;
+        mesh.indexCount = 0;
+        return mesh;
+    }
+
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+
+    if (quantized) {
+        // Per vertex: half x,y,z,1 (8 bytes) + int 2_10_10_10 normal (4 bytes)
+        struct PackedVertex {
+            uint16_t position[4];
+            uint32_t normal;
+        };
+        static_assert(sizeof(PackedVertex) == 12, "PackedVertex must be tightly packed");
+        std::vector<PackedVertex> packed(mesh.vertexCount);
+        for (GLsizei i = 0; i < mesh.vertexCount; i++) {
+            const float* v = &vertices[i * 6];
+            packed[i].position[0] = floatToHalf(v[0]);
+            packed[i].position[1] = floatToHalf(v[1]);
+            packed[i].position[2] = floatToHalf(v[2]);
+            packed[i].position[3] = floatToHalf(1.0f);
+            packed[i].normal = packNormal1010102(v[3], v[4], v[5]);
+        }
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+        OPTICSKETCH_PROFILE_UPLOAD(packed.size() * sizeof(PackedVertex));
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, normal));
+        glEnableVertexAttribArray(1);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        OPTICSKETCH_PROFILE_UPLOAD(vertices.size() * sizeof(float));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+    }
+
+    // The element buffer binding is VAO state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    if (mesh.vertexCount <= 0xFFFF) {
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(),
+                     GL_STATIC_DRAW);
+        OPTICSKETCH_PROFILE_UPLOAD(shortIndices.size() * sizeof(uint16_t));
+        mesh.indexType = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        OPTICSKETCH_PROFILE_UPLOAD(indices.size() * sizeof(uint32_t));
+        mesh.indexType = GL_UNSIGNED_INT;
+    }
+    glBindVertexArray(0);
+    return mesh;
+}
+
+// Bind and draw a mesh, indexed when it has an element buffer
+static void drawCachedMesh(const CachedMesh& mesh, GLenum mode) {
+    glBindVertexArray(mesh.vao);
+    if (mesh.indexCount > 0) {
+        glDrawElements(mode, mesh.indexCount, mesh.indexType, (void*)0);
+        OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+    } else {
+        glDrawArrays(mode, 0, mesh.vertexCount);
+        OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+    }
+}
+
 static void deleteCachedMesh(CachedMesh& mesh) {
     if (mesh.vao != 0) {
         glDeleteVertexArrays(1, &mesh.vao);
@@ -438,48 +1231,93 @@ static void deleteCachedMesh(CachedMesh& mesh) {
         mesh.vbo = 0;
         mesh.vertexCount = 0;
     }
+    if (mesh.ebo != 0) {
+        glDeleteBuffers(1, &mesh.ebo);
+        mesh.ebo = 0;
+        mesh.indexType = 0;
+        mesh.indexCount = 0;
+    }
+}
+
+// The bits of an object id, stored in a float slot of an interleaved vertex stream and
+// read back as an integer attribute (glVertexAttribIPointer)
+static float packObjectId(uint32_t objectId) {
+    float bits;
+    std::memcpy(&bits, &objectId, sizeof(bits));
+    return bits;
+}
+
+static uint32_t encodeObjectId(SceneObjectKind kind, size_t slot) {
+    return (static_cast<uint32_t>(kind) << 24) | static_cast<uint32_t>(slot + 1);
+}
+
+// Append one instance record (layout: mat4 model, mat3 normal, vec4 color, vec3 material, id)
+static void appendInstance(std::vector<float>& out, const glm::mat4& model, const glm::mat3& normalMatrix,
+                           const glm::vec3& color, float alpha, const glm::vec3& material, uint32_t objectId) {
+    const float* m = glm::value_ptr(model);
+    out.insert(out.end(), m, m + 16);
+    const float* n = glm::value_ptr(normalMatrix);
+    out.insert(out.end(), n, n + 9);
+    out.push_back(color.r); out.push_back(color.g); out.push_back(color.b); out.push_back(alpha);
+    out.push_back(material.x); out.push_back(material.y); out.push_back(material.z);
+    out.push_back(packObjectId(objectId));
+}
+
+static void deleteLineBatch(LineBatch& batch) {
+    if (batch.vao != 0) {
+        glDeleteVertexArrays(1, &batch.vao);
+        glDeleteBuffers(1, &batch.vbo);
+        batch.vao = 0;
+        batch.vbo = 0;
+    }
+    batch.vertices.clear();
+    batch.uploaded.clear();
 }
 
 void Viewport::renderGrid(float spacing, int gridSize) {
     // Suppress grid in Schematic mode (clean white background)
     if (style && style->renderMode == RenderMode::Schematic) return;
+    OPTICSKETCH_PROFILE_GPU_PASS("renderGrid");
 
     if (!gridInitialized) {
         initGrid();
     }
     
-    // Generate grid vertices (position + normal for ground plane)
-    std::vector<float> vertices;
-    const float halfSize = (gridSize * spacing) / 2.0f;
-    const float nx = 0.0f, ny = 1.0f, nz = 0.0f;
-    
-    for (int i = -gridSize / 2; i <= gridSize / 2; ++i) {
-        float z = i * spacing;
-        vertices.insert(vertices.end(), {-halfSize, 0.0f, z, nx, ny, nz});
-        vertices.insert(vertices.end(), {halfSize,  0.0f, z, nx, ny, nz});
-    }
-    for (int i = -gridSize / 2; i <= gridSize / 2; ++i) {
-        float x = i * spacing;
-        vertices.insert(vertices.end(), {x, 0.0f, -halfSize, nx, ny, nz});
-        vertices.insert(vertices.end(), {x, 0.0f, halfSize,  nx, ny, nz});
-    }
-    
     glBindVertexArray(gridVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
+    if (spacing != gridBuiltSpacing || gridSize != gridBuiltSize) {
+        // Generate grid vertices (position + normal for ground plane)
+        std::vector<float> vertices;
+        const float halfSize = (gridSize * spacing) / 2.0f;
+        const float nx = 0.0f, ny = 1.0f, nz = 0.0f;
+        
+        for (int i = -gridSize / 2; i <= gridSize / 2; ++i) {
+            float z = i * spacing;
+            vertices.insert(vertices.end(), {-halfSize, 0.0f, z, nx, ny, nz});
+            vertices.insert(vertices.end(), {halfSize,  0.0f, z, nx, ny, nz});
+        }
+        for (int i = -gridSize / 2; i <= gridSize / 2; ++i) {
+            float x = i * spacing;
+            vertices.insert(vertices.end(), {x, 0.0f, -halfSize, nx, ny, nz});
+            vertices.insert(vertices.end(), {x, 0.0f, halfSize,  nx, ny, nz});
+        }
+        
+        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        OPTICSKETCH_PROFILE_UPLOAD(vertices.size() * sizeof(float));
+        gridVertexCount = static_cast<GLsizei>(vertices.size() / 6);
+        gridBuiltSpacing = spacing;
+        gridBuiltSize = gridSize;
+    }
     
     gridShader.use();
     gridShader.setMat4("uModel", glm::mat4(1.0f));
-    gridShader.setMat4("uView", camera.getViewMatrix());
-    gridShader.setMat4("uProjection", camera.getProjectionMatrix());
     gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gridShader.setVec3("uLightPos", camera.position);
-    gridShader.setVec3("uViewPos", camera.position);
     gridShader.setVec3("uColor", style ? style->gridColor : glm::vec3(0.3f, 0.3f, 0.35f));
     gridShader.setFloat("uAlpha", style ? style->gridAlpha : 0.5f);
     
     glLineWidth(1.0f);
-    glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(vertices.size() / 6));
+    glDrawArrays(GL_LINES, 0, gridVertexCount);
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
     glBindVertexArray(0);
 }
 
@@ -873,15 +1711,36 @@ static std::vector<float> generatePlaneWireframe(float size) {
     };
 }
 
-// Wireframe line list is 6 floats per segment (x1,y1,z1, x2,y2,z2). Expand to 6 floats per vertex (pos+normal) for grid shader.
-static std::vector<float> wireframeLinesToVertices(const std::vector<float>& lines, float nx = 0.0f, float ny = 1.0f, float nz = 0.0f) {
-    std::vector<float> out;
-    out.reserve(lines.size() * 2);
+// Wireframe line list is 6 floats per segment (x1,y1,z1, x2,y2,z2). Expand to wire.vert's
+// quads: four vertices per segment (position, other end), drawn as two indexed triangles.
+static CachedMesh createWireMesh(const std::vector<float>& lines) {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    vertices.reserve(lines.size() * 4);
+    indices.reserve(lines.size());
     for (size_t i = 0; i + 5 < lines.size(); i += 6) {
-        out.insert(out.end(), {lines[i], lines[i+1], lines[i+2], nx, ny, nz});
-        out.insert(out.end(), {lines[i+3], lines[i+4], lines[i+5], nx, ny, nz});
+        const float* a = &lines[i];
+        const float* b = &lines[i + 3];
+        uint32_t base = static_cast<uint32_t>(vertices.size() / 6);
+        for (int corner = 0; corner < 4; corner++) {
+            const float* self = corner < 2 ? a : b;
+            const float* other = corner < 2 ? b : a;
+            vertices.insert(vertices.end(), {self[0], self[1], self[2], other[0], other[1], other[2]});
+        }
+        indices.insert(indices.end(), {base, base + 1, base + 2, base + 1, base + 3, base + 2});
     }
-    return out;
+    // Locations 0 and 1 carry this end and the other one
+    CachedMesh mesh = createCachedMesh(vertices);
+    if (mesh.vao == 0) return mesh;
+    glBindVertexArray(mesh.vao);
+    glGenBuffers(1, &mesh.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    OPTICSKETCH_PROFILE_UPLOAD(indices.size() * sizeof(uint32_t));
+    glBindVertexArray(0);
+    mesh.indexType = GL_UNSIGNED_INT;
+    mesh.indexCount = static_cast<GLsizei>(indices.size());
+    return mesh;
 }
 
 // Plane wireframe: quad outline only (no diagonals).
@@ -1118,10 +1977,15 @@ static void offsetWireframeLines(std::vector<float>& v, float dx, float dy, floa
     }
 }
 
+// Segment count for a detail level: halved per level, never below a hexagon
+static int lodSegments(int segments, int lod) {
+    return std::max(6, segments >> lod);
+}
+
 // --- Laser: elongated cylinder body + smaller nose cylinder ---
-static std::vector<float> generateLaserSolid() {
-    auto body = generateCylinderSolid(0.25f, 1.4f, 16);
-    auto nose = generateCylinderSolid(0.12f, 0.3f, 12);
+static std::vector<float> generateLaserSolid(int lod) {
+    auto body = generateCylinderSolid(0.25f, 1.4f, lodSegments(16, lod));
+    auto nose = generateCylinderSolid(0.12f, 0.3f, lodSegments(12, lod));
     offsetVertices(nose, 0.0f, 0.85f, 0.0f);
     appendVertices(body, nose);
     offsetVertices(body, 0.0f, -0.15f, 0.0f);
@@ -1340,9 +2204,9 @@ static std::vector<float> generateDetectorWireframe() {
 }
 
 // --- Mount: post cylinder on base plate ---
-static std::vector<float> generateMountSolid() {
-    auto post = generateCylinderSolid(0.06f, 1.1f, 12);
-    auto base = generateCylinderSolid(0.28f, 0.07f, 16);
+static std::vector<float> generateMountSolid(int lod) {
+    auto post = generateCylinderSolid(0.06f, 1.1f, lodSegments(12, lod));
+    auto base = generateCylinderSolid(0.28f, 0.07f, lodSegments(16, lod));
     offsetVertices(base, 0.0f, -0.585f, 0.0f);
     appendVertices(post, base);
     return post;
@@ -1357,9 +2221,9 @@ static std::vector<float> generateMountWireframe() {
 }
 
 // --- Fiber coupler: body cylinder + fiber stub ---
-static std::vector<float> generateFiberCouplerSolid() {
-    auto body = generateCylinderSolid(0.18f, 0.45f, 16);
-    auto stub = generateCylinderSolid(0.05f, 0.35f, 8);
+static std::vector<float> generateFiberCouplerSolid(int lod) {
+    auto body = generateCylinderSolid(0.18f, 0.45f, lodSegments(16, lod));
+    auto stub = generateCylinderSolid(0.05f, 0.35f, lodSegments(8, lod));
     offsetVertices(stub, 0.0f, 0.4f, 0.0f);
     appendVertices(body, stub);
     offsetVertices(body, 0.0f, -0.175f, 0.0f);
@@ -1427,61 +2291,60 @@ static std::vector<float> generateMirrorDiscWireframe(float radius, float capDep
 void Viewport::initPrototypeGeometry() {
     if (prototypesInitialized) return;
 
-    // Solid geometry for each built-in ElementType
-    prototypeGeometry[(int)ElementType::Laser]        = createCachedMesh(generateLaserSolid());
-    prototypeGeometry[(int)ElementType::Mirror]       = createCachedMesh(generateMirrorDiscSolid(0.5f, 0.05f, 0.08f, 24));
-    prototypeGeometry[(int)ElementType::Lens]         = createCachedMesh(generateBiconvexLensSolid(0.5f, 0.22f, 0.03f, 24, 8));
-    prototypeGeometry[(int)ElementType::BeamSplitter] = createCachedMesh(generateBoxSolid(0.8f, 0.8f, 0.8f));
-    prototypeGeometry[(int)ElementType::Detector]     = createCachedMesh(generateDetectorSolid());
-    prototypeGeometry[(int)ElementType::Filter]       = createCachedMesh(generateCylinderSolid(0.5f, 0.05f, 24));
-    prototypeGeometry[(int)ElementType::Aperture]     = createCachedMesh(generateAnnularRingSolid(0.5f, 0.15f, 0.06f, 24));
-    prototypeGeometry[(int)ElementType::Prism]        = createCachedMesh(generateTriangularPrismSolid(1.0f, 1.0f, false));
-    prototypeGeometry[(int)ElementType::PrismRA]      = createCachedMesh(generateTriangularPrismSolid(1.0f, 1.0f, true));
-    prototypeGeometry[(int)ElementType::Grating]      = createCachedMesh(generateBoxSolid(1.0f, 1.0f, 0.04f));
-    prototypeGeometry[(int)ElementType::FiberCoupler] = createCachedMesh(generateFiberCouplerSolid());
-    prototypeGeometry[(int)ElementType::Screen]       = createCachedMesh(generateBoxSolid(1.5f, 2.0f, 0.04f));
-    prototypeGeometry[(int)ElementType::Mount]        = createCachedMesh(generateMountSolid());
+    // Solid geometry for each built-in ElementType, one mesh per detail level. Boxes and
+    // prisms have nothing to simplify and share the same geometry at every level.
+    for (int lod = 0; lod < kLodLevels; lod++) {
+        CachedMesh* solids = prototypeGeometry[lod];
+        solids[(int)ElementType::Laser]        = createCachedMesh(generateLaserSolid(lod));
+        solids[(int)ElementType::Mirror]       = createCachedMesh(generateMirrorDiscSolid(0.5f, 0.05f, 0.08f, lodSegments(24, lod)));
+        solids[(int)ElementType::Lens]         = createCachedMesh(generateBiconvexLensSolid(0.5f, 0.22f, 0.03f, lodSegments(24, lod), std::max(2, 8 >> lod)));
+        solids[(int)ElementType::BeamSplitter] = createCachedMesh(generateBoxSolid(0.8f, 0.8f, 0.8f));
+        solids[(int)ElementType::Detector]     = createCachedMesh(generateDetectorSolid());
+        solids[(int)ElementType::Filter]       = createCachedMesh(generateCylinderSolid(0.5f, 0.05f, lodSegments(24, lod)));
+        solids[(int)ElementType::Aperture]     = createCachedMesh(generateAnnularRingSolid(0.5f, 0.15f, 0.06f, lodSegments(24, lod)));
+        solids[(int)ElementType::Prism]        = createCachedMesh(generateTriangularPrismSolid(1.0f, 1.0f, false));
+        solids[(int)ElementType::PrismRA]      = createCachedMesh(generateTriangularPrismSolid(1.0f, 1.0f, true));
+        solids[(int)ElementType::Grating]      = createCachedMesh(generateBoxSolid(1.0f, 1.0f, 0.04f));
+        solids[(int)ElementType::FiberCoupler] = createCachedMesh(generateFiberCouplerSolid(lod));
+        solids[(int)ElementType::Screen]       = createCachedMesh(generateBoxSolid(1.5f, 2.0f, 0.04f));
+        solids[(int)ElementType::Mount]        = createCachedMesh(generateMountSolid(lod));
+    }
 
     // Wireframe geometry (needs pos+normal format for the shader)
-    prototypeWireframe[(int)ElementType::Laser]        = createCachedMesh(wireframeLinesToVertices(generateLaserWireframe()));
-    prototypeWireframe[(int)ElementType::Mirror]       = createCachedMesh(wireframeLinesToVertices(generateMirrorDiscWireframe(0.5f, 0.05f, 0.08f, 24)));
-    prototypeWireframe[(int)ElementType::Lens]         = createCachedMesh(wireframeLinesToVertices(generateBiconvexLensWireframe(0.5f, 0.22f, 0.03f, 24)));
-    prototypeWireframe[(int)ElementType::BeamSplitter] = createCachedMesh(wireframeLinesToVertices(generateBoxWireframe(0.8f, 0.8f, 0.8f)));
-    prototypeWireframe[(int)ElementType::Detector]     = createCachedMesh(wireframeLinesToVertices(generateDetectorWireframe()));
-    prototypeWireframe[(int)ElementType::Filter]       = createCachedMesh(wireframeLinesToVertices(generateCylinderWireframe(0.5f, 0.05f, 24)));
-    prototypeWireframe[(int)ElementType::Aperture]     = createCachedMesh(wireframeLinesToVertices(generateAnnularRingWireframe(0.5f, 0.15f, 0.06f, 24)));
-    prototypeWireframe[(int)ElementType::Prism]        = createCachedMesh(wireframeLinesToVertices(generateTriangularPrismWireframe(1.0f, 1.0f, false)));
-    prototypeWireframe[(int)ElementType::PrismRA]      = createCachedMesh(wireframeLinesToVertices(generateTriangularPrismWireframe(1.0f, 1.0f, true)));
-    prototypeWireframe[(int)ElementType::Grating]      = createCachedMesh(wireframeLinesToVertices(generateBoxWireframe(1.0f, 1.0f, 0.04f)));
-    prototypeWireframe[(int)ElementType::FiberCoupler] = createCachedMesh(wireframeLinesToVertices(generateFiberCouplerWireframe()));
-    prototypeWireframe[(int)ElementType::Screen]       = createCachedMesh(wireframeLinesToVertices(generateBoxWireframe(1.5f, 2.0f, 0.04f)));
-    prototypeWireframe[(int)ElementType::Mount]        = createCachedMesh(wireframeLinesToVertices(generateMountWireframe()));
+    prototypeWireframe[(int)ElementType::Laser]        = createWireMesh(generateLaserWireframe());
+    prototypeWireframe[(int)ElementType::Mirror]       = createWireMesh(generateMirrorDiscWireframe(0.5f, 0.05f, 0.08f, 24));
+    prototypeWireframe[(int)ElementType::Lens]         = createWireMesh(generateBiconvexLensWireframe(0.5f, 0.22f, 0.03f, 24));
+    prototypeWireframe[(int)ElementType::BeamSplitter] = createWireMesh(generateBoxWireframe(0.8f, 0.8f, 0.8f));
+    prototypeWireframe[(int)ElementType::Detector]     = createWireMesh(generateDetectorWireframe());
+    prototypeWireframe[(int)ElementType::Filter]       = createWireMesh(generateCylinderWireframe(0.5f, 0.05f, 24));
+    prototypeWireframe[(int)ElementType::Aperture]     = createWireMesh(generateAnnularRingWireframe(0.5f, 0.15f, 0.06f, 24));
+    prototypeWireframe[(int)ElementType::Prism]        = createWireMesh(generateTriangularPrismWireframe(1.0f, 1.0f, false));
+    prototypeWireframe[(int)ElementType::PrismRA]      = createWireMesh(generateTriangularPrismWireframe(1.0f, 1.0f, true));
+    prototypeWireframe[(int)ElementType::Grating]      = createWireMesh(generateBoxWireframe(1.0f, 1.0f, 0.04f));
+    prototypeWireframe[(int)ElementType::FiberCoupler] = createWireMesh(generateFiberCouplerWireframe());
+    prototypeWireframe[(int)ElementType::Screen]       = createWireMesh(generateBoxWireframe(1.5f, 2.0f, 0.04f));
+    prototypeWireframe[(int)ElementType::Mount]        = createWireMesh(generateMountWireframe());
+    // Imported meshes whose payload hasn't arrived yet: outline of their [-1, 1] bounds
+    meshPlaceholder = createWireMesh(generateCubeWireframe(2.0f));
 
     prototypesInitialized = true;
 }
 
 void Viewport::renderScene(Scene* scene, bool forExport) {
     if (!scene) return;
+    OPTICSKETCH_PROFILE_GPU_PASS("renderScene");
 
     if (!prototypesInitialized) initPrototypeGeometry();
 
-    // Clean up stale mesh cache entries (for deleted ImportedMesh elements)
-    if (!meshCache.empty()) {
-        const auto& elements = scene->getElements();
-        auto it = meshCache.begin();
-        while (it != meshCache.end()) {
-            bool found = false;
-            for (const auto& elem : elements) {
-                if (elem->id == it->first) { found = true; break; }
-            }
-            if (!found) {
-                deleteCachedMesh(it->second);
-                it = meshCache.erase(it);
-            } else {
-                ++it;
-            }
-        }
+    // Removing elements may have dropped the last reference to an imported mesh
+    journalEvents.clear();
+    bool elementsRemoved = !scene->getChangeJournal().changesSince(meshJournalVersion, journalEvents);
+    for (size_t i = 0; !elementsRemoved && i < journalEvents.size(); i++) {
+        elementsRemoved = journalEvents[i].kind == SceneObjectKind::Element &&
+                          journalEvents[i].change == SceneChange::Removed;
     }
+    if (elementsRemoved) releaseUnusedMeshes();
+    meshJournalVersion = scene->getChangeVersion();
 
     // Disable face culling for solid elements — generators have mixed winding
     // conventions; per-vertex normals handle lighting correctly, and depth
@@ -1491,57 +2354,112 @@ void Viewport::renderScene(Scene* scene, bool forExport) {
     bool isSchematic = style && style->renderMode == RenderMode::Schematic;
     bool isPresentation = style && style->renderMode == RenderMode::Presentation;
 
+    // Element ids for GPU picking (exports don't pick)
+    if (!forExport) {
+        setIdWrites(true);
+        idLayoutGeneration = scene->getLayoutGeneration();
+    }
+
     // Choose shader based on render mode
     Shader& activeShader = isPresentation ? materialShader : gridShader;
 
-    activeShader.use();
-    activeShader.setMat4("uView", camera.getViewMatrix());
-    activeShader.setMat4("uProjection", camera.getProjectionMatrix());
-    // Set lighting uniforms from style (Schematic: fully flat, no specular)
-    if (isSchematic) {
-        activeShader.setFloat("uAmbientStrength", 1.0f);
-        activeShader.setFloat("uSpecularStrength", 0.0f);
-        activeShader.setFloat("uShininess", 1.0f);
-    } else {
-        activeShader.setFloat("uAmbientStrength", style ? style->ambientStrength : 0.14f);
-        activeShader.setFloat("uSpecularStrength", style ? style->specularStrength : 0.55f);
-        activeShader.setFloat("uShininess", style ? style->specularShininess : 48.0f);
-    }
+    // Draws are queued per element, then submitted pass by pass; runs sharing a mesh are
+    // drawn instanced when the INSTANCED shader variants are available
+    Shader& instancedShader = isPresentation ? materialInstancedShader : gridInstancedShader;
+    bool useInstancing = instancedShader.getId() != 0 && gridInstancedShader.getId() != 0;
+    renderQueue.clear();
 
     // HDRI environment map (Presentation mode only)
     if (isPresentation && style) {
         if (!style->hdriPath.empty()) {
-            loadHdriTexture(style->hdriPath);
-        } else if (hdriTexture != 0) {
-            destroyHdriTexture();
+            requestHdriTexture(style->hdriPath, forExport);
+        } else {
+            if (hdriTexture != 0 || hdriLoad) destroyHdriTexture();
+            failedHdriPath.clear();
         }
         if (hdriTexture != 0) {
             glActiveTexture(GL_TEXTURE1);
             glBindTexture(GL_TEXTURE_2D, hdriTexture);
-            activeShader.setInt("uEnvMap", 1);
-            activeShader.setBool("uHasEnvMap", true);
-            activeShader.setFloat("uEnvIntensity", style->hdriIntensity);
-            activeShader.setFloat("uEnvRotation", glm::radians(style->hdriRotation));
             glActiveTexture(GL_TEXTURE0);
-        } else {
-            activeShader.setBool("uHasEnvMap", false);
         }
     }
 
-    // In Presentation mode, collect transparent elements for a second pass
-    struct TransparentDraw {
-        const Element* elem;
-        CachedMesh* mesh;
-        glm::vec3 color;
-        bool isSelected;
+    // Camera, lighting and shading come from the frame block; only the
+    // environment map is per shader
+    auto setFrameUniforms = [&](Shader& shader, bool material) {
+        shader.use();
+        if (material && style) {
+            if (hdriTexture != 0) {
+                shader.setInt("uEnvMap", 1);
+                shader.setBool("uHasEnvMap", true);
+                shader.setFloat("uEnvIntensity", style->hdriIntensity);
+                shader.setFloat("uEnvRotation", glm::radians(style->hdriRotation));
+                shader.setFloat("uEnvMaxLod", hdriMaxLod);
+            } else {
+                shader.setBool("uHasEnvMap", false);
+            }
+            shader.setFloat("uTransparency", 0.0f);
+        }
     };
-    std::vector<TransparentDraw> transparentElements;
-
-    for (const auto& elem : scene->getElements()) {
-        if (!elem->visible) continue;
+    // Outlines are one width for the whole pass, in pixels
+    const glm::vec2 viewportSize = currentViewportSize();
+    for (Shader* shader : {&wireShader, &wireInstancedShader}) {
+        shader->use();
+        shader->setFloat("uLineWidth", isSchematic ? 2.2f : 1.4f);
+        shader->setVec2("uViewportSize", viewportSize);
+    }
+    if (useInstancing) {
+        setFrameUniforms(instancedShader, isPresentation);
+        if (isPresentation) setFrameUniforms(gridInstancedShader, false);
+    }
+    setFrameUniforms(activeShader, isPresentation);
+
+    // Shader slots of the queue's sort keys
+    enum : uint32_t { kSolidSlot, kWireSlot, kGlassSlot };
+
+    // Visibility, bounds and instance matrices come from the scene's component arrays;
+    // the Element itself is only read for what it draws
+    const ElementComponents& hot = scene->syncElementComponents();
+    const auto& elements = scene->getElements();
+    for (size_t slot = 0; slot < elements.size(); slot++) {
+        if (!hot.visible[slot]) continue;
+        // Solid and wireframe share the element's bounds
+        if (cullBox(hot.worldMin[slot], hot.worldMax[slot])) continue;
+
+        const auto& elem = elements[slot];
+        const uint32_t objectId = encodeObjectId(SceneObjectKind::Element, slot);
+        // Arrays draw every copy of the prototype mesh with the element's id; copies
+        // outside the view are skipped one by one
+        const int instanceCount = hot.instanceCount(slot);
+        const uint32_t firstRow = hot.firstInstance[slot];
+        auto instanceCulled = [&](int instance) {
+            if (instanceCount == 1 || !frustumCulling) return false;
+            return !frustum.intersectsBox(hot.instanceMin[firstRow + instance], hot.instanceMax[firstRow + instance]);
+        };
+        auto instanceDepth = [&](int instance) {
+            glm::vec3 center = (hot.instanceMin[firstRow + instance] + hot.instanceMax[firstRow + instance]) * 0.5f;
+            return glm::distance(camera.position, center);
+        };
 
-        glm::mat4 model = elem->transform.getMatrix();
-        activeShader.setMat4("uModel", model);
+        // Imported mesh still streaming in: outline its bounds until the geometry arrives
+        if (elem->type == ElementType::ImportedMesh && !elem->mesh) {
+            if (!forExport && meshPlaceholder.vao != 0) {
+                glm::vec3 center = (elem->boundsMin + elem->boundsMax) * 0.5f;
+                glm::vec3 halfExtent = (elem->boundsMax - elem->boundsMin) * 0.5f;
+                bool selected = scene->isSelected(elem->handle);
+                DrawItem outline;
+                outline.mesh = &meshPlaceholder;
+                outline.color = selected && style ? style->wireframeColor : glm::vec3(0.6f);
+                outline.objectId = objectId;
+                for (int instance = 0; instance < instanceCount; instance++) {
+                    if (instanceCulled(instance)) continue;
+                    const glm::mat4& model = hot.instanceModel[firstRow + instance];
+                    outline.model = glm::scale(glm::translate(model, center), halfExtent);
+                    renderQueue.push(RenderPass::Overlay, kWireSlot, instanceDepth(instance), outline);
+                }
+            }
+            continue;
+        }
 
         // Determine color and which cached mesh to use
         glm::vec3 color;
@@ -1569,48 +2487,18 @@ void Viewport::renderScene(Scene* scene, bool forExport) {
             }
         }
 
+        // Exports always render at full detail
+        int lod = forExport ? 0 : selectLod(*elem);
         if (elem->type == ElementType::ImportedMesh) {
-            // Per-instance cache for imported meshes
-            auto it = meshCache.find(elem->id);
-            if (it == meshCache.end()) {
-                auto inserted = meshCache.emplace(elem->id, createCachedMesh(elem->meshVertices));
-                solidMesh = &inserted.first->second;
-            } else {
-                solidMesh = &it->second;
-            }
+            // Shared per-asset cache for imported meshes
+            solidMesh = getAssetMesh(elem->mesh, lod);
         } else {
-            solidMesh = &prototypeGeometry[typeIdx];
+            solidMesh = &prototypeGeometry[lod][typeIdx];
         }
 
-        bool isSelected = !forExport && scene->isSelected(elem->id);
+        bool isSelected = !forExport && scene->isSelected(elem->handle);
         if (isSelected) color = color * (style ? style->selectionBrightness : 1.3f);
 
-        // In Presentation mode, defer transparent elements to second pass
-        if (isPresentation && elem->material.transparency > 0.01f) {
-            transparentElements.push_back({elem.get(), solidMesh, color, isSelected});
-            // Still draw wireframe for schematic/selected
-        } else {
-            glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
-            activeShader.setVec3("uColor", color);
-            activeShader.setFloat("uAlpha", isSelected ? 1.0f : 0.9f);
-            activeShader.setMat3("uNormalMatrix", normalMatrix);
-            activeShader.setVec3("uLightPos", camera.position);
-            activeShader.setVec3("uViewPos", camera.position);
-
-            // Set material uniforms in Presentation mode
-            if (isPresentation) {
-                activeShader.setFloat("uMetallic", elem->material.metallic);
-                activeShader.setFloat("uRoughness", elem->material.roughness);
-                activeShader.setFloat("uTransparency", 0.0f); // opaque pass
-                activeShader.setFloat("uFresnelIOR", elem->material.fresnelIOR);
-            }
-
-            if (solidMesh && solidMesh->vao != 0) {
-                glBindVertexArray(solidMesh->vao);
-                glDrawArrays(GL_TRIANGLES, 0, solidMesh->vertexCount);
-            }
-        }
-
         // Wireframe overlay: Schematic draws on ALL elements (dark outlines);
         // Standard/Presentation only draw on selected elements (green).
         bool drawWireframe = false;
@@ -1621,209 +2509,425 @@ void Viewport::renderScene(Scene* scene, bool forExport) {
         } else if (isSelected && !forExport && elem->type != ElementType::ImportedMesh) {
             drawWireframe = true;
         }
-
-        if (drawWireframe) {
-            CachedMesh& wf = prototypeWireframe[typeIdx];
-            if (wf.vao != 0) {
-                // Use gridShader for wireframe (simpler, no material needed)
-                gridShader.use();
-                gridShader.setMat4("uView", camera.getViewMatrix());
-                gridShader.setMat4("uProjection", camera.getProjectionMatrix());
-                gridShader.setMat4("uModel", model);
-                gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
-                gridShader.setVec3("uLightPos", camera.position);
-                gridShader.setVec3("uViewPos", camera.position);
-                glBindVertexArray(wf.vao);
-                glLineWidth(isSchematic ? 2.2f : 1.4f);
-                gridShader.setVec3("uColor", wireColor);
-                gridShader.setFloat("uAlpha", 1.0f);
-                glDrawArrays(GL_LINES, 0, wf.vertexCount);
-                glLineWidth(1.0f);
-                // Switch back to active shader
-                activeShader.use();
+        drawWireframe = drawWireframe && prototypeWireframe[typeIdx].vao != 0;
+        bool hasSolid = solidMesh && solidMesh->vao != 0;
+        // In Presentation mode, transparent elements go to the second pass
+        bool transparent = isPresentation && elem->material.transparency > 0.01f;
+
+        DrawItem solid;
+        solid.mesh = solidMesh;
+        solid.color = color;
+        solid.alpha = isSelected ? 1.0f : 0.9f;
+        solid.material = glm::vec3(elem->material.metallic, elem->material.roughness, elem->material.fresnelIOR);
+        solid.transparency = transparent ? elem->material.transparency : 0.0f;
+        solid.objectId = objectId;
+        DrawItem wire;
+        wire.mesh = &prototypeWireframe[typeIdx];
+        wire.color = wireColor;
+        wire.objectId = objectId;
+        for (int instance = 0; instance < instanceCount; instance++) {
+            if (instanceCulled(instance)) continue;
+            const float depth = instanceDepth(instance);
+            if (hasSolid) {
+                solid.model = hot.instanceModel[firstRow + instance];
+                solid.normalMatrix = hot.instanceNormal[firstRow + instance];
+                renderQueue.push(transparent ? RenderPass::Transparent : RenderPass::Opaque,
+                                 transparent ? kGlassSlot : kSolidSlot, depth, solid);
+            }
+            if (drawWireframe) {
+                wire.model = hot.instanceModel[firstRow + instance];
+                renderQueue.push(RenderPass::Overlay, kWireSlot, depth, wire);
             }
         }
     }
+    renderQueue.sort();
 
-    // Second pass: render transparent elements with blending (Presentation mode)
-    if (isPresentation && !transparentElements.empty()) {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glDepthMask(GL_FALSE);
+    drawQueuedPass(RenderPass::Opaque, activeShader, useInstancing ? &instancedShader : nullptr);
 
-        for (const auto& td : transparentElements) {
-            glm::mat4 model = td.elem->transform.getMatrix();
-            glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
-
-            activeShader.setMat4("uModel", model);
-            activeShader.setVec3("uColor", td.color);
-            activeShader.setFloat("uAlpha", td.isSelected ? 1.0f : 0.9f);
-            activeShader.setMat3("uNormalMatrix", normalMatrix);
-            activeShader.setVec3("uLightPos", camera.position);
-            activeShader.setVec3("uViewPos", camera.position);
-            activeShader.setFloat("uMetallic", td.elem->material.metallic);
-            activeShader.setFloat("uRoughness", td.elem->material.roughness);
-            activeShader.setFloat("uTransparency", td.elem->material.transparency);
-            activeShader.setFloat("uFresnelIOR", td.elem->material.fresnelIOR);
-
-            if (td.mesh && td.mesh->vao != 0) {
-                glBindVertexArray(td.mesh->vao);
-                glDrawArrays(GL_TRIANGLES, 0, td.mesh->vertexCount);
-            }
+    // Outlines blend for their anti-aliased edges
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    bool instancedWire = useInstancing && wireInstancedShader.getId() != 0;
+    drawQueuedPass(RenderPass::Overlay, wireShader, instancedWire ? &wireInstancedShader : nullptr);
+    glDisable(GL_BLEND);
+
+    // Second pass: transparent elements (Presentation mode). Weighted blended OIT
+    // accumulates them and resolves once over the opaque scene; without its targets
+    // they are blended back to front, the order the queue sorts them in.
+    auto transparentRange = renderQueue.passRange(RenderPass::Transparent);
+    if (isPresentation && transparentRange.first != transparentRange.second) {
+        bool oit = beginTransparencyAccumulation();
+        Shader& glassShader = oit ? materialOitShader : activeShader;
+        if (oit) {
+            setFrameUniforms(materialOitShader, true);
+            materialOitShader.setFloat("uOitDepthScale",
+                                       std::max(glm::length(camera.position - camera.target), 1e-3f));
+        } else {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         }
+        glDepthMask(GL_FALSE);
+
+        drawQueuedPass(RenderPass::Transparent, glassShader, nullptr);
 
         glDepthMask(GL_TRUE);
+        if (oit) compositeTransparency();
         glDisable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     }
 
     glBindVertexArray(0);
-    glLineWidth(1.0f);
+    setIdWrites(false);
 
     // Re-enable face culling for subsequent passes
     glEnable(GL_CULL_FACE);
 }
 
-void Viewport::renderBeams(Scene* scene) {
-    if (!scene) return;
-
-    gridShader.use();
-    gridShader.setMat4("uView", camera.getViewMatrix());
-    gridShader.setMat4("uProjection", camera.getProjectionMatrix());
-    gridShader.setMat4("uModel", glm::mat4(1.0f));
-    gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gridShader.setVec3("uLightPos", camera.position);
-    gridShader.setVec3("uViewPos", camera.position);
-
-    // Beams are self-luminous — use emissive mode to bypass lighting and tonemapping.
-    // This is critical for Presentation mode bloom (HDR values must survive to the FBO).
-    gridShader.setFloat("uEmissive", 1.0f);
-
-    // Lazy-init reusable beam buffer
-    if (beamBuffer.vao == 0) {
-        glGenVertexArrays(1, &beamBuffer.vao);
-        glGenBuffers(1, &beamBuffer.vbo);
-        glBindVertexArray(beamBuffer.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
-        glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+CachedMesh* Viewport::getAssetMesh(const std::shared_ptr<const MeshAsset>& asset, int lod) {
+    if (!asset) return nullptr;
+    auto it = meshCache.find(asset.get());
+    if (it != meshCache.end()) {
+        if (it->second.asset.lock() == asset) {
+            return &it->second.gpu[std::min(lod, it->second.levelCount - 1)];
+        }
+        // A freed asset's address was reused; its buffers are stale
+        for (CachedMesh& level : it->second.gpu) deleteCachedMesh(level);
+        meshCache.erase(it);
     }
+    SharedMesh& entry = meshCache[asset.get()];
+    entry.asset = asset;
+    entry.gpu[0] = createIndexedMesh(asset->vertices, asset->indices, quantizeImportedMeshes);
+    entry.levelCount = 1;
+    for (const MeshLod& level : asset->lods) {
+        if (entry.levelCount == kLodLevels) break;
+        entry.gpu[entry.levelCount++] = createIndexedMesh(level.vertices, level.indices, quantizeImportedMeshes);
+    }
+    return &entry.gpu[std::min(lod, entry.levelCount - 1)];
+}
 
-    // Enable blending for intensity-based alpha modulation on traced beams
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    glBindVertexArray(beamBuffer.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
+void Viewport::setQuantizeImportedMeshes(bool enabled) {
+    if (enabled == quantizeImportedMeshes) return;
+    quantizeImportedMeshes = enabled;
+    for (auto& entry : meshCache) {
+        for (CachedMesh& level : entry.second.gpu) deleteCachedMesh(level);
+    }
+    meshCache.clear();
+}
 
-    for (const auto& beam : scene->getBeams()) {
-        if (!beam->visible) continue;
+void Viewport::releaseUnusedMeshes() {
+    for (auto it = meshCache.begin(); it != meshCache.end();) {
+        if (it->second.asset.expired()) {
+            for (CachedMesh& level : it->second.gpu) deleteCachedMesh(level);
+            it = meshCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
 
-        bool isSelected = scene->isSelected(beam->id);
-        glLineWidth(isSelected ? 4.0f : 2.0f);
+// Projected diameter (in framebuffer pixels) below which each coarser level is used
+static constexpr float kLodPixelThresholds[] = {96.0f, 32.0f};
 
-        float vertices[12] = {
-            beam->start.x, beam->start.y, beam->start.z, 0.0f, 0.0f, 1.0f,
-            beam->end.x, beam->end.y, beam->end.z, 0.0f, 0.0f, 1.0f
-        };
+float Viewport::getProjectedRadius(const Element& elem) const {
+    const glm::mat4& model = elem.getModelMatrix();
+    glm::vec3 localCenter = (elem.boundsMin + elem.boundsMax) * 0.5f;
+    glm::vec3 worldCenter = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+    // Bounding-sphere radius from the scaled local box
+    glm::vec3 halfExtent = (elem.boundsMax - elem.boundsMin) * 0.5f * glm::abs(elem.transform.scale);
+    float radius = glm::length(halfExtent);
 
-        {
-            glm::vec3 beamColor = isSelected ? glm::vec3(1.0f, 1.0f, 1.0f) : beam->color;
-            // Boost beam brightness in Presentation mode for bloom
-            if (style && style->renderMode == RenderMode::Presentation) {
-                beamColor *= 2.5f;
-            }
-            gridShader.setVec3("uColor", beamColor);
-        }
+    // Works for both projections: w is the view depth for perspective and 1 for ortho
+    glm::vec4 clip = frameUniforms.projection * frameUniforms.view * glm::vec4(worldCenter, 1.0f);
+    float w = std::max(std::abs(clip.w), 1e-4f);
+    return radius * frameUniforms.projection[1][1] / w * static_cast<float>(height);
+}
 
-        // Modulate alpha by beam intensity (traced beams show power loss visually)
-        float alpha = std::clamp(beam->intensity, 0.15f, 1.0f);
-        gridShader.setFloat("uAlpha", alpha);
+bool Viewport::isElementInView(const Element& elem) const {
+    glm::vec3 worldMin, worldMax;
+    elem.getArrayWorldBounds(worldMin, worldMax);
+    return frustum.intersectsBox(worldMin, worldMax);
+}
 
-        // Buffer orphaning: upload new data into existing buffer
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-        glDrawArrays(GL_LINES, 0, 2);
+int Viewport::selectLod(const Element& elem) const {
+    float pixels = getProjectedRadius(elem);
+    int lod = 0;
+    for (float threshold : kLodPixelThresholds) {
+        if (pixels >= threshold) break;
+        lod++;
     }
+    return std::min(lod, kLodLevels - 1);
+}
 
+void Viewport::drawMeshInstances(const CachedMesh& mesh, const std::vector<float>& data, GLenum mode) {
+    if (data.empty() || mesh.vao == 0) return;
+    if (instanceVBO == 0) glGenBuffers(1, &instanceVBO);
+    const GLsizei stride = kInstanceFloats * sizeof(float);
+    GLsizei count = static_cast<GLsizei>(data.size() / kInstanceFloats);
+
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(data.size() * sizeof(float)),
+                 data.data(), GL_STREAM_DRAW);
+    OPTICSKETCH_PROFILE_UPLOAD(data.size() * sizeof(float));
+
+    // Attribute layout must match grid.vert's INSTANCED block
+    for (int c = 0; c < 4; c++) {
+        glVertexAttribPointer(2 + c, 4, GL_FLOAT, GL_FALSE, stride, (void*)(c * 4 * sizeof(float)));
+    }
+    for (int c = 0; c < 3; c++) {
+        glVertexAttribPointer(6 + c, 3, GL_FLOAT, GL_FALSE, stride, (void*)((16 + c * 3) * sizeof(float)));
+    }
+    glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, stride, (void*)(25 * sizeof(float)));
+    glVertexAttribPointer(10, 3, GL_FLOAT, GL_FALSE, stride, (void*)(29 * sizeof(float)));
+    glVertexAttribIPointer(11, 1, GL_UNSIGNED_INT, stride, (void*)(32 * sizeof(float)));
+    for (GLuint loc = 2; loc <= 11; loc++) {
+        glEnableVertexAttribArray(loc);
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    if (mesh.indexCount > 0)
+        glDrawElementsInstanced(mode, mesh.indexCount, mesh.indexType, (void*)0, count);
+    else
+        glDrawArraysInstanced(mode, 0, mesh.vertexCount, count);
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+
+    // Leave the VAO usable by the non-instanced shaders
+    for (GLuint loc = 2; loc <= 11; loc++) glDisableVertexAttribArray(loc);
     glBindVertexArray(0);
-    glLineWidth(1.0f);
-    glDisable(GL_BLEND);
-    gridShader.setFloat("uEmissive", 0.0f);
 }
 
-void Viewport::renderBeam(const Beam& beam) {
-    gridShader.use();
-    gridShader.setMat4("uView", camera.getViewMatrix());
-    gridShader.setMat4("uProjection", camera.getProjectionMatrix());
-    gridShader.setMat4("uModel", glm::mat4(1.0f));
-    gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gridShader.setVec3("uLightPos", camera.position);
-    gridShader.setVec3("uViewPos", camera.position);
-    gridShader.setFloat("uEmissive", 1.0f);
-    gridShader.setVec3("uColor", beam.color);
-    gridShader.setFloat("uAlpha", 0.7f);
-
-    // Lazy-init reusable beam buffer
-    if (beamBuffer.vao == 0) {
-        glGenVertexArrays(1, &beamBuffer.vao);
-        glGenBuffers(1, &beamBuffer.vbo);
-        glBindVertexArray(beamBuffer.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
-        glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+// Per-draw uniform handles of a scene shader
+struct DrawUniforms {
+    GLint model, normalMatrix, color, alpha;
+    GLint metallic, roughness, transparency, fresnelIOR;
+    GLint objectId;
+};
+
+static DrawUniforms resolveDrawUniforms(const Shader& shader) {
+    return DrawUniforms{
+        shader.uniformLocation("uModel"), shader.uniformLocation("uNormalMatrix"),
+        shader.uniformLocation("uColor"), shader.uniformLocation("uAlpha"),
+        shader.uniformLocation("uMetallic"), shader.uniformLocation("uRoughness"),
+        shader.uniformLocation("uTransparency"), shader.uniformLocation("uFresnelIOR"),
+        shader.uniformLocation("uObjectId")};
+}
+
+void Viewport::drawQueuedPass(RenderPass pass, const Shader& shader, const Shader* instancedShader) {
+    auto range = renderQueue.passRange(pass);
+    if (range.first == range.second) return;
+
+    if (instancedShader) {
+        instancedShader->use();
+        for (size_t i = range.first; i < range.second;) {
+            const CachedMesh* mesh = renderQueue[i].mesh;
+            queueInstances.clear();
+            for (; i < range.second && renderQueue[i].mesh == mesh; i++) {
+                const DrawItem& item = renderQueue[i];
+                appendInstance(queueInstances, item.model, item.normalMatrix, item.color, item.alpha,
+                               item.material, item.objectId);
+            }
+            drawMeshInstances(*mesh, queueInstances, GL_TRIANGLES);
+        }
+        return;
     }
 
-    float vertices[12] = {
-        beam.start.x, beam.start.y, beam.start.z, 0.0f, 0.0f, 1.0f,
-        beam.end.x, beam.end.y, beam.end.z, 0.0f, 0.0f, 1.0f
+    // Material uniforms are inactive (-1) in the grid and wire shaders, so setting them is free
+    shader.use();
+    const DrawUniforms loc = resolveDrawUniforms(shader);
+    GLuint boundVao = 0;
+    for (size_t i = range.first; i < range.second; i++) {
+        const DrawItem& item = renderQueue[i];
+        shader.setMat4(loc.model, item.model);
+        shader.setMat3(loc.normalMatrix, item.normalMatrix);
+        shader.setVec3(loc.color, item.color);
+        shader.setFloat(loc.alpha, item.alpha);
+        shader.setFloat(loc.metallic, item.material.x);
+        shader.setFloat(loc.roughness, item.material.y);
+        shader.setFloat(loc.fresnelIOR, item.material.z);
+        shader.setFloat(loc.transparency, item.transparency);
+        shader.setUint(loc.objectId, item.objectId);
+
+        const CachedMesh& mesh = *item.mesh;
+        if (mesh.vao != boundVao) {
+            glBindVertexArray(mesh.vao);
+            boundVao = mesh.vao;
+        }
+        if (mesh.indexCount > 0)
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, (void*)0);
+        else
+            glDrawArrays(GL_TRIANGLES, 0, mesh.vertexCount);
+        OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+    }
+}
+
+void Viewport::renderBeams(Scene* scene) {
+    if (!scene) return;
+    OPTICSKETCH_PROFILE_GPU_PASS("renderBeams");
+
+    // One segment stream for all beams, each at its own width. Selected beams go last
+    // so they draw over the rest.
+    beamBatch.clear();
+    const auto& beams = scene->getBeams();
+    auto addUserBeams = [&](bool selectedPass) {
+        for (size_t slot = 0; slot < beams.size(); slot++) {
+            const auto& beam = beams[slot];
+            if (!beam->visible) continue;
+            bool isSelected = scene->isSelected(beam->handle);
+            if (isSelected != selectedPass) continue;
+            if (cullSegment(beam->start, beam->end)) continue;
+            glm::vec3 beamColor = isSelected ? glm::vec3(1.0f, 1.0f, 1.0f) : beam->color;
+            // Modulate alpha by beam intensity (traced beams show power loss visually)
+            float alpha = std::clamp(beam->intensity, 0.15f, 1.0f);
+            bool animated = isPropagating(*beam);
+            beamBatch.addLine(beam->start, beam->end, glm::vec4(beamColor, alpha),
+                              encodeObjectId(SceneObjectKind::Beam, slot),
+                              isSelected ? beam->width + 2.0f : beam->width,
+                              animated ? 0.0f : -1.0f, animated ? beam->getLength() : -1.0f);
+        }
     };
+    addUserBeams(false);
+
+    const TracedRayBuffer& traced = scene->getTracedRays();
+    bool gpuTraced = traced.onGpu() && traced.gpuLineVertices > 0;
+    if (!traced.onGpu()) {
+        // Traced rays propagate with every beam, from their source
+        const bool animated = propagationDistance >= 0.0f && propagationBeamId.empty();
+        for (size_t i = 0; i < traced.size(); i++) {
+            if (cullSegment(traced.start[i], traced.end[i])) continue;
+            float alpha = std::clamp(traced.intensity[i], 0.15f, 1.0f);
+            float pathA = animated ? traced.pathStart[i] : -1.0f;
+            float pathB = pathA >= 0.0f ? pathA + glm::distance(traced.start[i], traced.end[i]) : -1.0f;
+            beamBatch.addLine(traced.start[i], traced.end[i], glm::vec4(traced.color[i], alpha), 0,
+                              kTracedLineWidth, pathA, pathB);
+        }
+    }
+    addUserBeams(true);
+    if (beamBatch.segmentCount() == 0 && !gpuTraced) return;
 
-    glBindVertexArray(beamBuffer.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-    glLineWidth(beam.width);
-    glDrawArrays(GL_LINES, 0, 2);
-    glLineWidth(1.0f);
-    glBindVertexArray(0);
-    gridShader.setFloat("uEmissive", 0.0f);
+    // Beams are self-luminous; boost brightness in Presentation mode for bloom
+    bool presentation = style && style->renderMode == RenderMode::Presentation;
+    beginLineDraw(presentation ? 2.5f : 1.0f);
+
+    // User beams are pickable; traced segments carry id 0
+    setIdWrites(true);
+
+    // Segments left on the GPU go under the batch, which holds the selection
+    if (gpuTraced) {
+        drawGpuTracedLines(traced.gpuLineBuffer, static_cast<GLsizei>(traced.gpuLineVertices));
+    }
+    uploadLineBatch(beamBatch);
+    drawLineSegments(beamBatch.segmentCount());
+
+    endLineDraw();
+    setIdWrites(false);
+}
+
+void Viewport::drawGpuTracedLines(GLuint buffer, GLsizei vertexCount) {
+    // GpuTracer's layout: position, rgba and a payload float in place of width and id.
+    // The width attributes stay disabled and read kTracedLineWidth; the id reads 0
+    // (traced segments are not pickable).
+    constexpr int kGpuLineFloats = 8;
+    if (gpuTraceVAO == 0) glGenVertexArrays(1, &gpuTraceVAO);
+    glBindVertexArray(gpuTraceVAO);
+    if (gpuTraceVAOBuffer != buffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        setLineSegmentAttributes(kGpuLineFloats, false);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gpuTraceVAOBuffer = buffer;
+    }
+    glVertexAttrib1f(2, kTracedLineWidth);
+    glVertexAttrib1f(6, kTracedLineWidth);
+    glVertexAttribI4ui(3, 0, 0, 0, 0);
+    // No path lengths on the GPU: these segments are drawn whole during propagation
+    glVertexAttrib1f(7, -1.0f);
+    glVertexAttrib1f(8, -1.0f);
+    drawLineSegments(vertexCount / 2);
+}
+
+void Viewport::setBeamPropagation(float distance, const std::string& beamId) {
+    propagationDistance = distance;
+    propagationBeamId = beamId;
+}
+
+bool Viewport::isPropagating(const Beam& beam) const {
+    return propagationDistance >= 0.0f && (propagationBeamId.empty() || propagationBeamId == beam.id);
+}
+
+void Viewport::renderBeam(const Beam& beam) {
+    overlayBatch.clear();
+    overlayBatch.addLine(beam.start, beam.end, glm::vec4(beam.color, 0.7f), 0, beam.width);
+    beginLineDraw(1.0f);
+    uploadLineBatch(overlayBatch);
+    drawLineSegments(overlayBatch.segmentCount());
+    endLineDraw();
 }
 
 void Viewport::renderGaussianBeams(Scene* scene) {
     if (!scene) return;
+    OPTICSKETCH_PROFILE_GPU_PASS("renderGaussianBeams");
 
-    const int NUM_SAMPLES = 32;
+    // One instance per visible Gaussian beam; the envelope itself is evaluated in
+    // gaussian_envelope.vert. beamRadiusAt() works in meters, the scene in mm.
+    gaussianInstances.clear();
+    for (const auto& bp : scene->getBeams()) {
+        if (!bp || !bp->visible || !bp->isGaussian) continue;
+        const Beam& beam = *bp;
 
-    gridShader.use();
-    gridShader.setMat4("uView", camera.getViewMatrix());
-    gridShader.setMat4("uProjection", camera.getProjectionMatrix());
-    gridShader.setMat4("uModel", glm::mat4(1.0f));
-    gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gridShader.setVec3("uLightPos", camera.position);
-    gridShader.setVec3("uViewPos", camera.position);
+        float beamLen = beam.getLength();  // in scene units (mm)
+        if (beamLen < 1e-6f) continue;
+        float waistZ = beam.waistPosition * beamLen; // mm
 
-    // Flat-shade the envelope: full ambient, no specular, so the color is
-    // independent of viewing angle (the strip is a flat 2D billboard).
-    gridShader.setFloat("uAmbientStrength", 1.0f);
-    gridShader.setFloat("uSpecularStrength", 0.0f);
+        // The envelope is widest at one of the ends (the waist lies between them)
+        float endRadius = std::max(beam.beamRadiusAt(std::abs(waistZ) * 0.001f),
+                                   beam.beamRadiusAt(std::abs(beamLen - waistZ) * 0.001f)) * 1000.0f;
+        if (cullSegment(beam.start, beam.end, endRadius)) continue;
+
+        // A degenerate Rayleigh range means constant width (as in beamRadiusAt); clamp it
+        // to a range the shader's float sinh/asinh handle well
+        float zR = beam.getRayleighRange() * 1000.0f;
+        if (!(zR >= 1e-12f)) zR = beamLen * 1e3f;
+        zR = std::clamp(zR, beamLen * 1e-6f, beamLen * 1e3f);
+
+        // Samples are even in asinh(z / zR): a nearly constant width needs two, a sharp
+        // focus a few per unit of that range
+        float span = std::asinh((beamLen - waistZ) / zR) - std::asinh(-waistZ / zR);
+        int samples = std::clamp(static_cast<int>(std::ceil(span * 8.0f)) + 2, 2, kMaxGaussianSamples);
+
+        const float instance[kGaussianInstanceFloats] = {
+            beam.start.x, beam.start.y, beam.start.z, beam.waistW0 * 1000.0f,
+            beam.end.x, beam.end.y, beam.end.z, zR,
+            beam.color.r, beam.color.g, beam.color.b, 0.3f,
+            waistZ, static_cast<float>(samples), isPropagating(beam) ? 1.0f : 0.0f, 0.0f
+        };
+        gaussianInstances.insert(gaussianInstances.end(), instance, instance + kGaussianInstanceFloats);
+    }
+    if (gaussianInstances.empty() || gaussianShader.getId() == 0) return;
 
-    // Lazy-init gaussian buffer
+    // Lazy-init the instance stream; the strip has no vertex data of its own
     if (gaussianBuffer.vao == 0) {
         glGenVertexArrays(1, &gaussianBuffer.vao);
         glGenBuffers(1, &gaussianBuffer.vbo);
         glBindVertexArray(gaussianBuffer.vao);
         glBindBuffer(GL_ARRAY_BUFFER, gaussianBuffer.vbo);
-        glBufferData(GL_ARRAY_BUFFER, NUM_SAMPLES * 2 * 6 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+        const GLsizei stride = kGaussianInstanceFloats * sizeof(float);
+        for (GLuint loc = 0; loc < 3; loc++) {
+            glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, stride, (void*)(loc * 4 * sizeof(float)));
+        }
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(12 * sizeof(float)));
+        for (GLuint loc = 0; loc < 4; loc++) {
+            glEnableVertexAttribArray(loc);
+            glVertexAttribDivisor(loc, 1);
+        }
     }
 
+    gaussianShader.use();
+    gaussianShader.setVec3("uCameraUp", camera.up);
+    gaussianShader.setFloat("uPropagation", propagationDistance);
+
+    // Flat-shade the envelope: full ambient, no specular, so the color is
+    // independent of viewing angle (the strip is a flat 2D billboard).
+    setFrameShading(1.0f, 0.0f, frameShininess);
+
     // Disable face culling (flat strip seen from both sides) and depth writes
     // (transparent overlay shouldn't block things behind it).
     glDisable(GL_CULL_FACE);
@@ -1831,168 +2935,74 @@ void Viewport::renderGaussianBeams(Scene* scene) {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    for (const auto& bp : scene->getBeams()) {
-        if (!bp || !bp->visible || !bp->isGaussian) continue;
-        const Beam& beam = *bp;
-
-        float beamLen = beam.getLength();  // in scene units (mm)
-        if (beamLen < 1e-6f) continue;
-
-        glm::vec3 dir = beam.getDirection();
-        float waistZ = beam.waistPosition * beamLen; // mm
-
-        // Perpendicular vector facing the camera (billboard).
-        // Compute cross product BEFORE normalizing to safely detect degenerate case.
-        glm::vec3 midpoint = (beam.start + beam.end) * 0.5f;
-        glm::vec3 toCamera = camera.position - midpoint;
-        glm::vec3 crossVec = glm::cross(dir, toCamera);
-        if (glm::dot(crossVec, crossVec) < 1e-12f) {
-            crossVec = glm::cross(dir, camera.up);
-        }
-        glm::vec3 perp = glm::normalize(crossVec);
-
-        // Build triangle strip: for each sample, upper vertex then lower vertex.
-        // beamRadiusAt() works in meters (w0 and wavelength are meters),
-        // so convert z from mm to meters, then convert result back to mm.
-        std::vector<float> verts;
-        verts.reserve(NUM_SAMPLES * 2 * 6);
-
-        for (int i = 0; i < NUM_SAMPLES; i++) {
-            float t = static_cast<float>(i) / static_cast<float>(NUM_SAMPLES - 1);
-            glm::vec3 pos = beam.start + t * (beam.end - beam.start);
-            float zMM = std::abs(t * beamLen - waistZ);  // mm
-            float zM  = zMM * 0.001f;                     // convert to meters
-            float wMM = beam.beamRadiusAt(zM) * 1000.0f;  // result in meters -> mm
-
-            glm::vec3 upper = pos + perp * wMM;
-            glm::vec3 lower = pos - perp * wMM;
-            // Normal faces toward camera for consistent lighting
-            glm::vec3 normal = glm::normalize(toCamera);
-
-            verts.push_back(upper.x); verts.push_back(upper.y); verts.push_back(upper.z);
-            verts.push_back(normal.x); verts.push_back(normal.y); verts.push_back(normal.z);
-            verts.push_back(lower.x); verts.push_back(lower.y); verts.push_back(lower.z);
-            verts.push_back(normal.x); verts.push_back(normal.y); verts.push_back(normal.z);
-        }
-
-        gridShader.setVec3("uColor", beam.color);
-        gridShader.setFloat("uAlpha", 0.3f);
-
-        glBindVertexArray(gaussianBuffer.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, gaussianBuffer.vbo);
-        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(verts.size() * sizeof(float)),
-                     verts.data(), GL_DYNAMIC_DRAW);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, NUM_SAMPLES * 2);
-        glBindVertexArray(0);
-    }
+    glBindVertexArray(gaussianBuffer.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, gaussianBuffer.vbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(gaussianInstances.size() * sizeof(float)),
+                 gaussianInstances.data(), GL_STREAM_DRAW);
+    OPTICSKETCH_PROFILE_UPLOAD(gaussianInstances.size() * sizeof(float));
+    // Every instance gets the longest strip; vertices past its own sample count collapse
+    // onto its last sample and form empty triangles
+    GLsizei count = static_cast<GLsizei>(gaussianInstances.size() / kGaussianInstanceFloats);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, kMaxGaussianSamples * 2, count);
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+    glBindVertexArray(0);
 
     // Restore state
     glDepthMask(GL_TRUE);
     glEnable(GL_CULL_FACE);
     glDisable(GL_BLEND);
 
-    // Restore lighting uniforms to scene style defaults
-    if (style) {
-        gridShader.setFloat("uAmbientStrength", style->ambientStrength);
-        gridShader.setFloat("uSpecularStrength", style->specularStrength);
-    }
+    // Restore the frame's shading terms
+    restoreFrameShading();
 }
 
 void Viewport::renderFocalPoints(Scene* scene) {
     if (!scene || !style || !style->showFocalPoints) return;
 
-    gridShader.use();
-    gridShader.setMat4("uView", camera.getViewMatrix());
-    gridShader.setMat4("uProjection", camera.getProjectionMatrix());
-    gridShader.setMat4("uModel", glm::mat4(1.0f));
-    gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gridShader.setVec3("uLightPos", camera.position);
-    gridShader.setVec3("uViewPos", camera.position);
-    // Flat shading for markers
-    gridShader.setFloat("uAmbientStrength", 1.0f);
-    gridShader.setFloat("uSpecularStrength", 0.0f);
-
-    glm::vec3 markerColor(1.0f, 0.6f, 0.1f); // Orange
-    gridShader.setVec3("uColor", markerColor);
-    gridShader.setFloat("uAlpha", 1.0f);
-
-    // Lazy-init beam buffer (reuse for line drawing)
-    if (beamBuffer.vao == 0) {
-        glGenVertexArrays(1, &beamBuffer.vao);
-        glGenBuffers(1, &beamBuffer.vbo);
-        glBindVertexArray(beamBuffer.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
-        glBufferData(GL_ARRAY_BUFFER, 48 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-    }
+    glm::vec4 markerColor(1.0f, 0.6f, 0.1f, 1.0f); // Orange
 
-    glBindVertexArray(beamBuffer.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
-    glLineWidth(2.0f);
+    // All markers go into one batch and one draw call
+    overlayBatch.clear();
+    const ElementComponents& hot = scene->syncElementComponents();
+    const auto& elements = scene->getElements();
+    for (size_t slot = 0; slot < elements.size(); slot++) {
+        if (!hot.visible[slot] || hot.opticalType[slot] != OpticalType::Lens) continue;
 
-    for (const auto& elem : scene->getElements()) {
-        if (!elem->visible) continue;
-        if (elem->optics.opticalType != OpticalType::Lens) continue;
-
-        float focalLen = elem->optics.focalLength;
+        float focalLen = elements[slot]->optics.focalLength;
         if (std::abs(focalLen) < 0.01f) continue;
 
-        glm::mat4 model = elem->transform.getMatrix();
-        glm::vec3 center = elem->getWorldBoundsCenter();
-        glm::vec3 forward = glm::normalize(glm::vec3(model * glm::vec4(0, 0, 1, 0)));
-
-        // Two focal points: +f and -f along the lens axis
-        float markerSize = 1.5f; // mm half-size of the X marker
-
-        for (int side = -1; side <= 1; side += 2) {
-            glm::vec3 fp = center + forward * (focalLen * static_cast<float>(side));
-
-            // X marker: two crossed lines. Use camera-facing perpendicular vectors.
-            glm::vec3 toCamera = camera.position - fp;
-            glm::vec3 right = glm::normalize(glm::cross(forward, toCamera));
-            if (glm::length(right) < 0.001f) right = glm::vec3(1, 0, 0);
-            glm::vec3 up = glm::normalize(glm::cross(right, forward));
-
-            // Diagonal 1: top-right to bottom-left
-            // Diagonal 2: top-left to bottom-right
-            glm::vec3 n(0, 1, 0);
-            float vertices[48] = {
-                // Line 1
-                fp.x + right.x * markerSize + up.x * markerSize,
-                fp.y + right.y * markerSize + up.y * markerSize,
-                fp.z + right.z * markerSize + up.z * markerSize,
-                n.x, n.y, n.z,
-                fp.x - right.x * markerSize - up.x * markerSize,
-                fp.y - right.y * markerSize - up.y * markerSize,
-                fp.z - right.z * markerSize - up.z * markerSize,
-                n.x, n.y, n.z,
-                // Line 2
-                fp.x - right.x * markerSize + up.x * markerSize,
-                fp.y - right.y * markerSize + up.y * markerSize,
-                fp.z - right.z * markerSize + up.z * markerSize,
-                n.x, n.y, n.z,
-                fp.x + right.x * markerSize - up.x * markerSize,
-                fp.y + right.y * markerSize - up.y * markerSize,
-                fp.z + right.z * markerSize - up.z * markerSize,
-                n.x, n.y, n.z,
-            };
-
-            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-            glDrawArrays(GL_LINES, 0, 4);
+        for (uint32_t row = hot.firstInstance[slot]; row < hot.firstInstance[slot + 1]; row++) {
+            const glm::mat4& model = hot.instanceModel[row];
+            glm::vec3 center = (hot.instanceMin[row] + hot.instanceMax[row]) * 0.5f;
+            glm::vec3 forward = glm::normalize(glm::vec3(model * glm::vec4(0, 0, 1, 0)));
+
+            // Two focal points: +f and -f along the lens axis
+            float markerSize = 1.5f; // mm half-size of the X marker
+
+            for (int side = -1; side <= 1; side += 2) {
+                glm::vec3 fp = center + forward * (focalLen * static_cast<float>(side));
+                if (cullSegment(fp, fp, markerSize)) continue;
+
+                // X marker: two crossed lines. Use camera-facing perpendicular vectors.
+                glm::vec3 toCamera = camera.position - fp;
+                glm::vec3 right = glm::normalize(glm::cross(forward, toCamera));
+                if (glm::length(right) < 0.001f) right = glm::vec3(1, 0, 0);
+                glm::vec3 up = glm::normalize(glm::cross(right, forward));
+
+                // Diagonal 1: top-right to bottom-left
+                // Diagonal 2: top-left to bottom-right
+                glm::vec3 r = right * markerSize, u = up * markerSize;
+                overlayBatch.addLine(fp + r + u, fp - r - u, markerColor, 0, 2.0f);
+                overlayBatch.addLine(fp - r + u, fp + r - u, markerColor, 0, 2.0f);
+            }
         }
     }
+    if (overlayBatch.vertexCount() == 0) return;
 
-    glBindVertexArray(0);
-    glLineWidth(1.0f);
-
-    // Restore lighting
-    if (style) {
-        gridShader.setFloat("uAmbientStrength", style->ambientStrength);
-        gridShader.setFloat("uSpecularStrength", style->specularStrength);
-    }
+    beginLineDraw(1.0f);
+    uploadLineBatch(overlayBatch);
+    drawLineSegments(overlayBatch.segmentCount());
+    endLineDraw();
 }
 
 void Viewport::renderGizmo(Scene* scene, GizmoType gizmoType, int hoveredHandle, int exclusiveHandle) {
@@ -2042,6 +3052,7 @@ void Viewport::initFullscreenQuad() {
     glBindVertexArray(fullscreenVAO);
     glBindBuffer(GL_ARRAY_BUFFER, fullscreenVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    OPTICSKETCH_PROFILE_UPLOAD(sizeof(quadVertices));
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
@@ -2051,26 +3062,65 @@ void Viewport::initFullscreenQuad() {
 
 // --- HDRI Environment Map ---
 
-void Viewport::loadHdriTexture(const std::string& path) {
-    if (path == loadedHdriPath && hdriTexture != 0) return;
-    destroyHdriTexture();
-    stbi_set_flip_vertically_on_load(1);
-    int w, h, c;
-    float* data = stbi_loadf(path.c_str(), &w, &h, &c, 3);
-    stbi_set_flip_vertically_on_load(0);
-    if (!data) {
-        std::cerr << "Failed to load HDRI: " << path << std::endl;
+struct Viewport::HdriLoad {
+    std::string path;
+    JobId job = 0;
+    bool ok = false;
+    EnvironmentMap map;
+};
+
+void Viewport::requestHdriTexture(const std::string& path, bool wait) {
+    if (hdriLoad && hdriLoad->path == path) {
+        // Picked up here rather than in the continuation, so a viewport drawing on the
+        // render thread only touches its GL objects there
+        if (wait) JobSystem::instance().wait(hdriLoad->job);
+        if (!JobSystem::instance().isPending(hdriLoad->job)) applyHdriLoad(hdriLoad);
+        return;
+    }
+    if ((path == loadedHdriPath && hdriTexture != 0) || path == failedHdriPath) return;
+
+    auto load = std::make_shared<HdriLoad>();
+    load->path = path;
+    hdriLoad = load;
+    failedHdriPath.clear();
+    std::string label = "Loading " + path.substr(path.find_last_of("/\\") + 1);
+    // The empty continuation still wakes the main loop to redraw with the result
+    load->job = JobSystem::instance().submit(label, JobPriority::Normal,
+        [load](JobContext&) { load->ok = loadEnvironmentMap(load->path, load->map); },
+        []() {});
+    if (wait) {
+        JobSystem::instance().wait(load->job);
+        applyHdriLoad(load);
+    }
+}
+
+void Viewport::applyHdriLoad(std::shared_ptr<HdriLoad> load) {
+    hdriLoad.reset();
+    if (!load->ok || load->map.levels.empty()) {
+        std::cerr << "Failed to load HDRI: " << load->path << std::endl;
+        destroyHdriTexture();
+        failedHdriPath = load->path;
         return;
     }
-    glGenTextures(1, &hdriTexture);
+    if (hdriTexture == 0) glGenTextures(1, &hdriTexture);
     glBindTexture(GL_TEXTURE_2D, hdriTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w, h, 0, GL_RGB, GL_FLOAT, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    const auto& levels = load->map.levels;
+    for (size_t i = 0; i < levels.size(); i++) {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), GL_RGB16F, levels[i].width, levels[i].height, 0,
+                     GL_RGB, GL_HALF_FLOAT, levels[i].texels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size()) - 1);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    stbi_image_free(data);
-    loadedHdriPath = path;
+    glBindTexture(GL_TEXTURE_2D, 0);
+    hdriMaxLod = static_cast<float>(levels.size() - 1);
+    loadedHdriPath = load->path;
+    failedHdriPath.clear();
 }
 
 void Viewport::destroyHdriTexture() {
@@ -2078,30 +3128,186 @@ void Viewport::destroyHdriTexture() {
         glDeleteTextures(1, &hdriTexture);
         hdriTexture = 0;
     }
+    hdriLoad.reset();
+    hdriMaxLod = 0.0f;
     loadedHdriPath.clear();
 }
 
+// --- Order-independent transparency ---
+
+static GLuint createOitTarget(GLenum internalFormat, GLenum format, int w, int h) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+}
+
+bool Viewport::beginTransparencyAccumulation() {
+    if (!oitShaderLoaded) {
+        oitShaderLoaded = true;
+        initFullscreenQuad();
+        const char* compositePaths[] = {
+            "assets/shaders/oit_composite.frag",
+            "../assets/shaders/oit_composite.frag",
+            "../../assets/shaders/oit_composite.frag"
+        };
+        bool loaded = false;
+        for (const char* fragPath : compositePaths) {
+            std::string fp(fragPath);
+            std::string vertPath = fp.substr(0, fp.rfind('/')) + "/fullscreen.vert";
+            if (oitCompositeShader.loadFromFiles(vertPath, fragPath)) {
+                loaded = true;
+                break;
+            }
+        }
+        if (!loaded) {
+            const char* compositeVert = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoords;
+out vec2 TexCoords;
+void main() { TexCoords = aTexCoords; gl_Position = vec4(aPos, 0.0, 1.0); }
+)";
+            const char* compositeFrag = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+uniform sampler2D uAccum;
+uniform sampler2D uWeight;
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(uAccum, texel, 0);
+    float revealage = accum.a;
+    if (revealage >= 0.999) discard;
+    float weight = max(texelFetch(uWeight, texel, 0).r, 1e-5);
+    FragColor = vec4(accum.rgb / weight, 1.0 - revealage);
+}
+)";
+            oitCompositeShader.loadFromSource(compositeVert, compositeFrag);
+        }
+    }
+    if (oitCompositeShader.getId() == 0 || materialOitShader.getId() == 0) return false;
+
+    if (oitFBO == 0) {
+        glGenFramebuffers(1, &oitFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, oitFBO);
+        oitAccumTexture = createOitTarget(GL_RGBA16F, GL_RGBA, width, height);
+        oitWeightTexture = createOitTarget(GL_R16F, GL_RED, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oitAccumTexture, 0);
+        if (idTextureId != 0)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, idTextureId, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, oitWeightTexture, 0);
+        // Depth-tested against the opaque pass, without writing
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbufferId);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Transparency framebuffer is not complete; blending in scene order" << std::endl;
+            glBindFramebuffer(GL_FRAMEBUFFER, framebufferId);
+            destroyOitTargets();
+            oitCompositeShader.cleanup();
+            return false;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, oitFBO);
+    // Transparent elements stay pickable: the id texture is shared with the main target
+    const GLenum buffers[3] = {GL_COLOR_ATTACHMENT0, idWrites ? GLenum(GL_COLOR_ATTACHMENT1) : GLenum(GL_NONE),
+                               GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, buffers);
+    const float clearAccum[4] = {0.0f, 0.0f, 0.0f, 1.0f};   // revealage starts at 1
+    const float clearWeight[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, clearAccum);
+    glClearBufferfv(GL_COLOR, 2, clearWeight);
+
+    // Colors and coverage add up; revealage (accum alpha) is multiplied by 1 - alpha.
+    // One blend function serves both targets, so GL 3.3 needs no per-target blending.
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    return true;
+}
+
+void Viewport::compositeTransparency() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebufferId);
+    // The resolve writes color only; leave the ids the passes wrote
+    bool ids = idWrites;
+    setIdWrites(false);
+    glDisable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    oitCompositeShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, oitAccumTexture);
+    oitCompositeShader.setInt("uAccum", 0);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, oitWeightTexture);
+    oitCompositeShader.setInt("uWeight", 2);
+    glBindVertexArray(fullscreenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glEnable(GL_DEPTH_TEST);
+    setIdWrites(ids);
+}
+
+void Viewport::destroyOitTargets() {
+    if (oitFBO) { glDeleteFramebuffers(1, &oitFBO); oitFBO = 0; }
+    if (oitAccumTexture) { glDeleteTextures(1, &oitAccumTexture); oitAccumTexture = 0; }
+    if (oitWeightTexture) { glDeleteTextures(1, &oitWeightTexture); oitWeightTexture = 0; }
+}
+
 // --- Bloom ---
 
+static void createBloomTarget(GLuint& fbo, GLuint& texture, int w, int h) {
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(1, &texture);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, w, h, 0, GL_RGB, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+}
+
+void Viewport::createBloomTargets() {
+    createBloomTarget(bloomCompositeFBO, bloomCompositeTexture, width, height);
+    // Halve until the next level would be under 2 pixels
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    bloomLevels = 0;
+    while (bloomLevels < kBloomMaxLevels) {
+        createBloomTarget(bloomMipFBO[bloomLevels], bloomMipTexture[bloomLevels], w, h);
+        bloomMipWidth[bloomLevels] = w;
+        bloomMipHeight[bloomLevels] = h;
+        bloomLevels++;
+        if (w < 4 || h < 4) break;
+        w /= 2;
+        h /= 2;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Viewport::destroyBloomTargets() {
+    for (int i = 0; i < kBloomMaxLevels; i++) {
+        if (bloomMipFBO[i]) { glDeleteFramebuffers(1, &bloomMipFBO[i]); bloomMipFBO[i] = 0; }
+        if (bloomMipTexture[i]) { glDeleteTextures(1, &bloomMipTexture[i]); bloomMipTexture[i] = 0; }
+    }
+    bloomLevels = 0;
+    if (bloomCompositeFBO) { glDeleteFramebuffers(1, &bloomCompositeFBO); bloomCompositeFBO = 0; }
+    if (bloomCompositeTexture) { glDeleteTextures(1, &bloomCompositeTexture); bloomCompositeTexture = 0; }
+}
+
 void Viewport::initBloom() {
     if (bloomInitialized) return;
 
     initFullscreenQuad();
-
-    // Create ping-pong FBOs with GL_RGB16F textures
-    for (int i = 0; i < 2; i++) {
-        glGenFramebuffers(1, &bloomFBO[i]);
-        glGenTextures(1, &bloomTexture[i]);
-        glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, bloomTexture[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomTexture[i], 0);
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    createBloomTargets();
 
     // Load bloom shaders (embedded fallback)
     const char* fsVert = R"(
@@ -2112,6 +3318,8 @@ out vec2 TexCoords;
 void main() { TexCoords = aTexCoords; gl_Position = vec4(aPos, 0.0, 1.0); }
 )";
 
+    // Bright pass into the half-resolution top level; four bilinear taps average the
+    // 4x4 source footprint so thin bright lines do not shimmer
     const char* extractFrag = R"(
 #version 330 core
 out vec4 FragColor;
@@ -2119,35 +3327,49 @@ in vec2 TexCoords;
 uniform sampler2D uScene;
 uniform float uThreshold = 0.8;
 void main() {
-    vec3 color = texture(uScene, TexCoords).rgb;
+    vec2 o = 1.0 / textureSize(uScene, 0);
+    vec3 color = (texture(uScene, TexCoords + vec2(-o.x, -o.y)).rgb + texture(uScene, TexCoords + vec2(o.x, -o.y)).rgb +
+                  texture(uScene, TexCoords + vec2(-o.x, o.y)).rgb + texture(uScene, TexCoords + vec2(o.x, o.y)).rgb) * 0.25;
     float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
     if (brightness > uThreshold) FragColor = vec4(color * (brightness - uThreshold), 1.0);
     else FragColor = vec4(0.0, 0.0, 0.0, 1.0);
 }
 )";
 
-    const char* blurFrag = R"(
+    // Dual-filter downsample: centre plus four half-texel diagonals of the source level
+    const char* downFrag = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 TexCoords;
 uniform sampler2D uImage;
-uniform bool uHorizontal;
-const float weight[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
 void main() {
-    vec2 texOffset = 1.0 / textureSize(uImage, 0);
-    vec3 result = texture(uImage, TexCoords).rgb * weight[0];
-    if (uHorizontal) {
-        for (int i = 1; i < 5; ++i) {
-            result += texture(uImage, TexCoords + vec2(texOffset.x * i, 0.0)).rgb * weight[i];
-            result += texture(uImage, TexCoords - vec2(texOffset.x * i, 0.0)).rgb * weight[i];
-        }
-    } else {
-        for (int i = 1; i < 5; ++i) {
-            result += texture(uImage, TexCoords + vec2(0.0, texOffset.y * i)).rgb * weight[i];
-            result += texture(uImage, TexCoords - vec2(0.0, texOffset.y * i)).rgb * weight[i];
-        }
-    }
-    FragColor = vec4(result, 1.0);
+    vec2 h = 0.5 / textureSize(uImage, 0);
+    vec3 sum = texture(uImage, TexCoords).rgb * 4.0;
+    sum += texture(uImage, TexCoords + vec2(-h.x, -h.y)).rgb;
+    sum += texture(uImage, TexCoords + vec2(h.x, -h.y)).rgb;
+    sum += texture(uImage, TexCoords + vec2(-h.x, h.y)).rgb;
+    sum += texture(uImage, TexCoords + vec2(h.x, h.y)).rgb;
+    FragColor = vec4(sum / 8.0, 1.0);
+}
+)";
+
+    // Dual-filter upsample: eight-tap tent over the coarser level, added onto the finer one
+    const char* upFrag = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+uniform sampler2D uImage;
+void main() {
+    vec2 h = 0.5 / textureSize(uImage, 0);
+    vec3 sum = texture(uImage, TexCoords + vec2(-h.x * 2.0, 0.0)).rgb;
+    sum += texture(uImage, TexCoords + vec2(h.x * 2.0, 0.0)).rgb;
+    sum += texture(uImage, TexCoords + vec2(0.0, -h.y * 2.0)).rgb;
+    sum += texture(uImage, TexCoords + vec2(0.0, h.y * 2.0)).rgb;
+    sum += texture(uImage, TexCoords + vec2(-h.x, h.y)).rgb * 2.0;
+    sum += texture(uImage, TexCoords + vec2(h.x, h.y)).rgb * 2.0;
+    sum += texture(uImage, TexCoords + vec2(-h.x, -h.y)).rgb * 2.0;
+    sum += texture(uImage, TexCoords + vec2(h.x, -h.y)).rgb * 2.0;
+    FragColor = vec4(sum / 12.0, 1.0);
 }
 )";
 
@@ -2168,17 +3390,15 @@ void main() {
 )";
 
     bloomExtractShader.loadFromSource(fsVert, extractFrag);
-    bloomBlurShader.loadFromSource(fsVert, blurFrag);
+    bloomDownShader.loadFromSource(fsVert, downFrag);
+    bloomUpShader.loadFromSource(fsVert, upFrag);
     bloomCompositeShader.loadFromSource(fsVert, compositeFrag);
 
     bloomInitialized = true;
 }
 
 void Viewport::destroyBloom() {
-    for (int i = 0; i < 2; i++) {
-        if (bloomFBO[i]) { glDeleteFramebuffers(1, &bloomFBO[i]); bloomFBO[i] = 0; }
-        if (bloomTexture[i]) { glDeleteTextures(1, &bloomTexture[i]); bloomTexture[i] = 0; }
-    }
+    destroyBloomTargets();
     if (fullscreenVAO) { glDeleteVertexArrays(1, &fullscreenVAO); fullscreenVAO = 0; }
     if (fullscreenVBO) { glDeleteBuffers(1, &fullscreenVBO); fullscreenVBO = 0; }
     bloomInitialized = false;
@@ -2186,135 +3406,88 @@ void Viewport::destroyBloom() {
 
 void Viewport::renderBeamHighlight(const glm::vec3& beamStart, const glm::vec3& beamEnd,
                                    const glm::vec3& snapPoint) {
-    gridShader.use();
-    gridShader.setMat4("uView", camera.getViewMatrix());
-    gridShader.setMat4("uProjection", camera.getProjectionMatrix());
-    gridShader.setMat4("uModel", glm::mat4(1.0f));
-    gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
-    gridShader.setVec3("uLightPos", camera.position);
-    gridShader.setVec3("uViewPos", camera.position);
-    gridShader.setFloat("uEmissive", 1.0f);
-
-    // Lazy-init reusable beam buffer
-    if (beamBuffer.vao == 0) {
-        glGenVertexArrays(1, &beamBuffer.vao);
-        glGenBuffers(1, &beamBuffer.vbo);
-        glBindVertexArray(beamBuffer.vao);
-        glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
-        glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-    }
-
-    glBindVertexArray(beamBuffer.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, beamBuffer.vbo);
-
-    // Draw the beam line in cyan (highlighted)
-    glm::vec3 cyan(0.0f, 1.0f, 1.0f);
-    gridShader.setVec3("uColor", cyan);
-    gridShader.setFloat("uAlpha", 0.8f);
-    glLineWidth(4.0f);
-
-    float lineVerts[12] = {
-        beamStart.x, beamStart.y, beamStart.z, 0.0f, 1.0f, 0.0f,
-        beamEnd.x, beamEnd.y, beamEnd.z, 0.0f, 1.0f, 0.0f
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(lineVerts), lineVerts, GL_DYNAMIC_DRAW);
-    glDrawArrays(GL_LINES, 0, 2);
-
-    // Draw yellow cross at snap point
-    glm::vec3 yellow(1.0f, 1.0f, 0.0f);
-    gridShader.setVec3("uColor", yellow);
-    gridShader.setFloat("uAlpha", 1.0f);
-    glLineWidth(3.0f);
-
+    // Beam line in cyan (highlighted), then a yellow cross at the snap point
     float crossSize = 2.0f;
-    float crossVerts[24] = {
-        snapPoint.x - crossSize, snapPoint.y, snapPoint.z, 0.0f, 1.0f, 0.0f,
-        snapPoint.x + crossSize, snapPoint.y, snapPoint.z, 0.0f, 1.0f, 0.0f,
-        snapPoint.x, snapPoint.y, snapPoint.z - crossSize, 0.0f, 1.0f, 0.0f,
-        snapPoint.x, snapPoint.y, snapPoint.z + crossSize, 0.0f, 1.0f, 0.0f,
-    };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(crossVerts), crossVerts, GL_DYNAMIC_DRAW);
-    glDrawArrays(GL_LINES, 0, 4);
+    glm::vec4 yellow(1.0f, 1.0f, 0.0f, 1.0f);
+    overlayBatch.clear();
+    overlayBatch.addLine(beamStart, beamEnd, glm::vec4(0.0f, 1.0f, 1.0f, 0.8f), 0, 4.0f);
+    overlayBatch.addLine(snapPoint - glm::vec3(crossSize, 0, 0), snapPoint + glm::vec3(crossSize, 0, 0), yellow, 0, 3.0f);
+    overlayBatch.addLine(snapPoint - glm::vec3(0, 0, crossSize), snapPoint + glm::vec3(0, 0, crossSize), yellow, 0, 3.0f);
 
-    glLineWidth(1.0f);
-    glBindVertexArray(0);
-    gridShader.setFloat("uEmissive", 0.0f);
+    beginLineDraw(1.0f);
+    uploadLineBatch(overlayBatch);
+    drawLineSegments(overlayBatch.segmentCount());
+    endLineDraw();
 }
 
 void Viewport::renderBloomPass() {
     if (!style || style->renderMode != RenderMode::Presentation) return;
     if (!bloomInitialized) initBloom();
+    if (bloomLevels == 0) return;
+    OPTICSKETCH_PROFILE_GPU_PASS("renderBloomPass");
 
-    // Resize bloom textures if needed
-    GLint texW, texH;
-    glBindTexture(GL_TEXTURE_2D, bloomTexture[0]);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &texW);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &texH);
-    if (texW != width || texH != height) {
-        for (int i = 0; i < 2; i++) {
-            glBindTexture(GL_TEXTURE_2D, bloomTexture[i]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, nullptr);
-        }
-    }
+    // The style's pass count sets the bloom radius as the pyramid depth; every extra level
+    // is a quarter of the previous one, so the cost barely grows with the radius
+    int levels = std::clamp(style->bloomBlurPasses, 1, bloomLevels);
 
     glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(fullscreenVAO);
+    glActiveTexture(GL_TEXTURE0);
 
-    // Step 1: Extract bright pixels from scene texture
-    glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[0]);
-    glViewport(0, 0, width, height);
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Step 1: Extract bright pixels from scene texture into the top level
+    glBindFramebuffer(GL_FRAMEBUFFER, bloomMipFBO[0]);
+    glViewport(0, 0, bloomMipWidth[0], bloomMipHeight[0]);
     bloomExtractShader.use();
     bloomExtractShader.setFloat("uThreshold", style->bloomThreshold);
-    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureId);  // scene texture
     bloomExtractShader.setInt("uScene", 0);
-    glBindVertexArray(fullscreenVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    // Step 2: Ping-pong Gaussian blur
-    bool horizontal = true;
-    bloomBlurShader.use();
-    for (int i = 0; i < style->bloomBlurPasses * 2; i++) {
-        int target = horizontal ? 1 : 0;
-        int source = horizontal ? 0 : 1;
-        glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[target]);
-        glClear(GL_COLOR_BUFFER_BIT);
-        bloomBlurShader.setBool("uHorizontal", horizontal);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, bloomTexture[source]);
-        bloomBlurShader.setInt("uImage", 0);
-        glBindVertexArray(fullscreenVAO);
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+
+    // Step 2: Downsample through the pyramid (every pixel is overwritten, no clear needed)
+    bloomDownShader.use();
+    bloomDownShader.setInt("uImage", 0);
+    for (int i = 1; i < levels; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, bloomMipFBO[i]);
+        glViewport(0, 0, bloomMipWidth[i], bloomMipHeight[i]);
+        glBindTexture(GL_TEXTURE_2D, bloomMipTexture[i - 1]);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        horizontal = !horizontal;
+        OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
     }
 
-    // Step 3: Composite bloom with scene
-    // We can't read textureId while writing to framebufferId (same attachment).
-    // So composite into bloomFBO[0], then blit back to the main FBO.
-    int bloomResult = horizontal ? 0 : 1;
+    // Step 3: Upsample back up, accumulating each coarser level onto the finer one
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    bloomUpShader.use();
+    bloomUpShader.setInt("uImage", 0);
+    for (int i = levels - 1; i > 0; i--) {
+        glBindFramebuffer(GL_FRAMEBUFFER, bloomMipFBO[i - 1]);
+        glViewport(0, 0, bloomMipWidth[i - 1], bloomMipHeight[i - 1]);
+        glBindTexture(GL_TEXTURE_2D, bloomMipTexture[i]);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
+    }
+    glDisable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Use bloomFBO[0] as composite target (reusing it)
-    int compositeTarget = (bloomResult == 0) ? 1 : 0;
-    glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[compositeTarget]);
+    // Step 4: Composite bloom with scene
+    // We can't read textureId while writing to framebufferId (same attachment),
+    // so composite into a separate target, then blit back to the main FBO.
+    glBindFramebuffer(GL_FRAMEBUFFER, bloomCompositeFBO);
     glViewport(0, 0, width, height);
-    glClear(GL_COLOR_BUFFER_BIT);
     bloomCompositeShader.use();
-    bloomCompositeShader.setFloat("uBloomIntensity", style->bloomIntensity);
-    glActiveTexture(GL_TEXTURE0);
+    // The top level holds the sum of all levels; average it so intensity does not grow with radius
+    bloomCompositeShader.setFloat("uBloomIntensity", style->bloomIntensity / levels);
     glBindTexture(GL_TEXTURE_2D, textureId);  // original scene
     bloomCompositeShader.setInt("uScene", 0);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, bloomTexture[bloomResult]);
+    glBindTexture(GL_TEXTURE_2D, bloomMipTexture[0]);
     bloomCompositeShader.setInt("uBloom", 1);
-    glBindVertexArray(fullscreenVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
 
     // Blit the composite result back to the main FBO
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, bloomFBO[compositeTarget]);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, bloomCompositeFBO);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferId);
     glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 
@@ -2325,21 +3498,164 @@ void Viewport::renderBloomPass() {
 
 // --- Thumbnail rendering for library panel ---
 
+static constexpr char kThumbnailCacheMagic[4] = {'O', 'S', 'T', 'C'};
+static constexpr uint32_t kThumbnailCacheVersion = 1;
+
+// Default element colors (matching viewport.cpp fallback colors), used without a style
+static const glm::vec3 kThumbnailDefaultColors[] = {
+    {1.0f, 0.2f, 0.2f},  // Laser
+    {0.7f, 0.7f, 0.8f},  // Mirror
+    {0.4f, 0.7f, 1.0f},  // Lens
+    {0.9f, 0.9f, 0.4f},  // BeamSplitter
+    {0.2f, 0.9f, 0.2f},  // Detector
+    {0.6f, 0.4f, 0.8f},  // Filter
+    {0.8f, 0.6f, 0.3f},  // Aperture
+    {0.5f, 0.8f, 0.9f},  // Prism
+    {0.5f, 0.8f, 0.9f},  // PrismRA
+    {0.7f, 0.5f, 0.3f},  // Grating
+    {1.0f, 0.6f, 0.2f},  // FiberCoupler
+    {0.3f, 0.8f, 0.3f},  // Screen
+    {0.5f, 0.5f, 0.55f}, // Mount
+};
+
 void Viewport::destroyThumbnails() {
     if (thumbnailFBO) { glDeleteFramebuffers(1, &thumbnailFBO); thumbnailFBO = 0; }
     if (thumbnailDepthRBO) { glDeleteRenderbuffers(1, &thumbnailDepthRBO); thumbnailDepthRBO = 0; }
     for (int i = 0; i < kMaxPrototypes; i++) {
         if (thumbnailTextures[i]) { glDeleteTextures(1, &thumbnailTextures[i]); thumbnailTextures[i] = 0; }
+        thumbnailKeys[i] = 0;
+        thumbnailPending[i] = false;
     }
-    thumbnailsGenerated = false;
 }
 
-GLuint Viewport::getThumbnailTexture(int typeIndex) const {
-    if (typeIndex < 0 || typeIndex >= kMaxPrototypes) return 0;
+// FNV-1a over everything that changes a thumbnail's pixels
+static void hashBytes(uint64_t& h, const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+}
+
+uint64_t Viewport::thumbnailKey(int typeIndex) {
+    if (!prototypesInitialized) initPrototypeGeometry();
+    uint64_t h = 14695981039346656037ull;
+    uint32_t fields[4] = {kThumbnailGeometryVersion, static_cast<uint32_t>(kThumbnailSize),
+                          static_cast<uint32_t>(typeIndex),
+                          static_cast<uint32_t>(prototypeGeometry[0][typeIndex].vertexCount)};
+    hashBytes(h, fields, sizeof(fields));
+    glm::vec3 color = style ? style->elementColors[typeIndex] : kThumbnailDefaultColors[typeIndex];
+    hashBytes(h, &color, sizeof(color));
+    return h ? h : 1;   // 0 marks an empty slot
+}
+
+// Worker side of loadThumbnailCache: the file's keys and atlas, or false if unusable
+static bool readThumbnailCache(const std::string& path, int thumbnailSize, int typeCount,
+                               std::vector<uint64_t>& keys, std::vector<unsigned char>& atlas) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    char magic[4];
+    uint32_t header[3];   // version, thumbnail size, slot count
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || std::memcmp(magic, kThumbnailCacheMagic, sizeof(magic)) != 0 ||
+        header[0] != kThumbnailCacheVersion || header[1] != static_cast<uint32_t>(thumbnailSize) ||
+        header[2] != static_cast<uint32_t>(typeCount)) {
+        return false;   // stale format: every thumbnail is simply re-rendered
+    }
+    keys.resize(typeCount);
+    atlas.resize(static_cast<size_t>(typeCount) * thumbnailSize * thumbnailSize * 4);
+    in.read(reinterpret_cast<char*>(keys.data()), static_cast<std::streamsize>(keys.size() * sizeof(uint64_t)));
+    in.read(reinterpret_cast<char*>(atlas.data()), static_cast<std::streamsize>(atlas.size()));
+    if (!in) {
+        std::cerr << "Truncated thumbnail cache: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+void Viewport::loadThumbnailCache(const std::string& path) {
+    struct Loaded {
+        bool ok = false;
+        std::vector<uint64_t> keys;
+        std::vector<unsigned char> atlas;
+    };
+    auto loaded = std::make_shared<Loaded>();
+    thumbnailCacheLoading = true;
+    JobSystem::instance().submit("", JobPriority::Normal,
+        [path, loaded](JobContext&) {
+            loaded->ok = readThumbnailCache(path, kThumbnailSize, kThumbnailTypes, loaded->keys, loaded->atlas);
+        },
+        [this, loaded]() {
+            thumbnailCacheLoading = false;
+            // Thumbnails rendered meanwhile are newer than the file
+            if (!loaded->ok || thumbnailAtlasDirty) return;
+            thumbnailAtlas = std::move(loaded->atlas);
+            std::copy(loaded->keys.begin(), loaded->keys.end(), thumbnailAtlasKeys);
+        });
+}
+
+bool Viewport::saveThumbnailCache(const std::string& path) {
+    if (!thumbnailAtlasDirty) return true;
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Failed to write thumbnail cache: " << path << "\n";
+        return false;
+    }
+    uint32_t header[3] = {kThumbnailCacheVersion, static_cast<uint32_t>(kThumbnailSize),
+                          static_cast<uint32_t>(kThumbnailTypes)};
+    out.write(kThumbnailCacheMagic, sizeof(kThumbnailCacheMagic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(thumbnailAtlasKeys), sizeof(uint64_t) * kThumbnailTypes);
+    out.write(reinterpret_cast<const char*>(thumbnailAtlas.data()), static_cast<std::streamsize>(thumbnailAtlas.size()));
+    if (!out) return false;
+    thumbnailAtlasDirty = false;
+    return true;
+}
+
+GLuint Viewport::ensureThumbnailTexture(int typeIndex) {
+    if (!thumbnailTextures[typeIndex]) {
+        glGenTextures(1, &thumbnailTextures[typeIndex]);
+        glBindTexture(GL_TEXTURE_2D, thumbnailTextures[typeIndex]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, kThumbnailSize, kThumbnailSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    return thumbnailTextures[typeIndex];
+}
+
+GLuint Viewport::acquireThumbnail(int typeIndex) {
+    if (typeIndex < 0 || typeIndex >= kThumbnailTypes) return 0;
+    uint64_t key = thumbnailKey(typeIndex);
+    if (thumbnailKeys[typeIndex] == key) return thumbnailTextures[typeIndex];
+    // Don't render what the cache being read may already hold
+    if (thumbnailCacheLoading) return thumbnailTextures[typeIndex];
+
+    if (thumbnailAtlasKeys[typeIndex] == key && !thumbnailAtlas.empty()) {
+        // Cache hit: upload the atlas slot
+        glBindTexture(GL_TEXTURE_2D, ensureThumbnailTexture(typeIndex));
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, kThumbnailTypes * kThumbnailSize);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kThumbnailSize, kThumbnailSize, GL_RGBA, GL_UNSIGNED_BYTE,
+                        thumbnailAtlas.data() + static_cast<size_t>(typeIndex) * kThumbnailSize * 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        thumbnailKeys[typeIndex] = key;
+        thumbnailPending[typeIndex] = false;
+    } else {
+        // An outdated texture stays on screen until its replacement is rendered
+        thumbnailPending[typeIndex] = true;
+    }
     return thumbnailTextures[typeIndex];
 }
 
-void Viewport::generateThumbnails() {
+bool Viewport::hasPendingThumbnails() const {
+    for (int i = 0; i < kThumbnailTypes; i++)
+        if (thumbnailPending[i]) return true;
+    return false;
+}
+
+int Viewport::renderPendingThumbnails(int maxCount) {
+    if (!hasPendingThumbnails()) return 0;
     if (!prototypesInitialized) initPrototypeGeometry();
 
     // Save current GL state
@@ -2357,24 +3673,33 @@ void Viewport::generateThumbnails() {
         glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, thumbnailDepthRBO);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
+    if (thumbnailAtlas.empty())
+        thumbnailAtlas.assign(static_cast<size_t>(kThumbnailTypes) * kThumbnailSize * kThumbnailSize * 4, 0);
 
-    // Default element colors (matching viewport.cpp fallback colors)
-    glm::vec3 defaultColors[] = {
-        {1.0f, 0.2f, 0.2f},  // Laser
-        {0.7f, 0.7f, 0.8f},  // Mirror
-        {0.4f, 0.7f, 1.0f},  // Lens
-        {0.9f, 0.9f, 0.4f},  // BeamSplitter
-        {0.2f, 0.9f, 0.2f},  // Detector
-        {0.6f, 0.4f, 0.8f},  // Filter
-        {0.8f, 0.6f, 0.3f},  // Aperture
-        {0.5f, 0.8f, 0.9f},  // Prism
-        {0.5f, 0.8f, 0.9f},  // PrismRA
-        {0.7f, 0.5f, 0.3f},  // Grating
-        {1.0f, 0.6f, 0.2f},  // FiberCoupler
-        {0.3f, 0.8f, 0.3f},  // Screen
-        {0.5f, 0.5f, 0.55f}, // Mount
-        {0.7f, 0.7f, 0.7f},  // ImportedMesh
-    };
+    int rendered = 0;
+    for (int i = 0; i < kThumbnailTypes && rendered < maxCount; i++) {
+        if (!thumbnailPending[i]) continue;
+        thumbnailPending[i] = false;
+        renderThumbnail(i);
+        rendered++;
+    }
+
+    // Restore GL state
+    glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
+    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+    glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+    return rendered;
+}
+
+void Viewport::renderThumbnail(int i) {
+    // Attach texture as color target
+    glBindFramebuffer(GL_FRAMEBUFFER, thumbnailFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ensureThumbnailTexture(i), 0);
+    glViewport(0, 0, kThumbnailSize, kThumbnailSize);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
 
     // Camera setup: 3/4 view angle
     glm::vec3 viewDir = glm::normalize(glm::vec3(1.0f, 0.7f, 1.2f));
@@ -2382,31 +3707,9 @@ void Viewport::generateThumbnails() {
     glm::vec3 eye = viewDir * distance;
     glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
-    int numTypes = (int)ElementType::ImportedMesh; // skip ImportedMesh
-
-    for (int i = 0; i < numTypes; i++) {
-        // Create output texture if needed
-        if (!thumbnailTextures[i]) {
-            glGenTextures(1, &thumbnailTextures[i]);
-            glBindTexture(GL_TEXTURE_2D, thumbnailTextures[i]);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, kThumbnailSize, kThumbnailSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        }
-
-        // Attach texture as color target
-        glBindFramebuffer(GL_FRAMEBUFFER, thumbnailFBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, thumbnailTextures[i], 0);
-        glViewport(0, 0, kThumbnailSize, kThumbnailSize);
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
-
+    CachedMesh& mesh = prototypeGeometry[0][i];
+    if (mesh.vao != 0) {
         // Fit orthographic projection to element
-        CachedMesh& mesh = prototypeGeometry[i];
-        if (mesh.vao == 0) continue;
-
         float extent = 0.8f; // default extent
         // Use larger extent for taller/wider elements
         if (i == (int)ElementType::Laser || i == (int)ElementType::Mount) extent = 1.0f;
@@ -2418,31 +3721,39 @@ void Viewport::generateThumbnails() {
         // Use grid shader for consistent look
         gridShader.use();
         gridShader.setMat4("uModel", model);
-        gridShader.setMat4("uView", view);
-        gridShader.setMat4("uProjection", proj);
         gridShader.setMat3("uNormalMatrix", glm::mat3(1.0f));
 
-        glm::vec3 color = (style && i < (int)ElementType::ImportedMesh)
-            ? style->elementColors[i] : defaultColors[i];
+        glm::vec3 color = style ? style->elementColors[i] : kThumbnailDefaultColors[i];
         gridShader.setVec3("uColor", color);
         gridShader.setFloat("uAlpha", 1.0f);
-        gridShader.setVec3("uLightPos", eye);
-        gridShader.setVec3("uViewPos", eye);
-        gridShader.setFloat("uAmbientStrength", 0.25f);
-        gridShader.setFloat("uSpecularStrength", 0.5f);
-        gridShader.setFloat("uShininess", 32.0f);
         gridShader.setFloat("uEmissive", 0.0f);
 
+        // Thumbnails use their own camera; the next beginFrame() re-uploads the view's block
+        frameUniforms.view = view;
+        frameUniforms.projection = proj;
+        frameUniforms.lightPos = eye;
+        frameUniforms.viewPos = eye;
+        frameUniforms.ambientStrength = 0.25f;
+        frameUniforms.specularStrength = 0.5f;
+        frameUniforms.shininess = 32.0f;
+        uploadFrameUniforms();
+
         glBindVertexArray(mesh.vao);
         glDrawArrays(GL_TRIANGLES, 0, mesh.vertexCount);
+        OPTICSKETCH_PROFILE_COUNT(DrawCalls, 1);
         glBindVertexArray(0);
     }
 
-    // Restore GL state
-    glBindFramebuffer(GL_FRAMEBUFFER, prevFBO);
-    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
-    glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
-    thumbnailsGenerated = true;
+    // Copy into the atlas slot for the on-disk cache (misses only, so the stall is rare)
+    glPixelStorei(GL_PACK_ROW_LENGTH, kThumbnailTypes * kThumbnailSize);
+    glReadPixels(0, 0, kThumbnailSize, kThumbnailSize, GL_RGBA, GL_UNSIGNED_BYTE,
+                 thumbnailAtlas.data() + static_cast<size_t>(i) * kThumbnailSize * 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+    uint64_t key = thumbnailKey(i);
+    thumbnailKeys[i] = key;
+    thumbnailAtlasKeys[i] = key;
+    thumbnailAtlasDirty = true;
 }
 
 // Helper: render scene to pixel buffer for export
@@ -2461,20 +3772,118 @@ static std::vector<unsigned char> renderForExport(Viewport& vp, Scene* scene) {
 
 bool Viewport::exportToPng(const std::string& path, Scene* scene) {
     if (framebufferId == 0 || !scene) return false;
+    OPTICSKETCH_PROFILE_SCOPE("exportToPng");
     auto pixels = renderForExport(*this, scene);
     return savePngToFile(path, width, height, pixels.data());
 }
 
 bool Viewport::exportToJpg(const std::string& path, Scene* scene, int quality) {
     if (framebufferId == 0 || !scene) return false;
+    OPTICSKETCH_PROFILE_SCOPE("exportToJpg");
     auto pixels = renderForExport(*this, scene);
     return saveJpgToFile(path, width, height, pixels.data(), quality);
 }
 
 bool Viewport::exportToPdf(const std::string& path, Scene* scene) {
     if (framebufferId == 0 || !scene) return false;
+    OPTICSKETCH_PROFILE_SCOPE("exportToPdf");
     auto pixels = renderForExport(*this, scene);
     return savePdfToFile(path, width, height, pixels.data());
 }
 
+void Viewport::exportImageAsync(const std::string& path, Scene* scene, ImageFormat format,
+                                std::function<void(bool)> done) {
+    if (framebufferId == 0 || !scene) {
+        if (done) done(false);
+        return;
+    }
+    OPTICSKETCH_PROFILE_SCOPE("exportImageAsync");
+    auto pixels = std::make_shared<std::vector<unsigned char>>(renderForExport(*this, scene));
+    auto ok = std::make_shared<bool>(false);
+    int w = width, h = height;
+    std::string label = "Writing " + path.substr(path.find_last_of("/\\") + 1);
+    JobSystem::instance().submit(label, JobPriority::High,
+        [path, format, pixels, ok, w, h](JobContext&) {
+            switch (format) {
+                case ImageFormat::Png: *ok = savePngToFile(path, w, h, pixels->data()); break;
+                case ImageFormat::Jpg: *ok = saveJpgToFile(path, w, h, pixels->data()); break;
+                case ImageFormat::Pdf: *ok = savePdfToFile(path, w, h, pixels->data()); break;
+            }
+        },
+        [ok, done]() {
+            if (done) done(*ok);
+        });
+}
+
+bool Viewport::exportTiled(const std::string& path, Scene* scene, int outWidth, int outHeight) {
+    if (framebufferId == 0 || !scene || outWidth <= 0 || outHeight <= 0) return false;
+    OPTICSKETCH_PROFILE_SCOPE("exportTiled");
+    bool isPdf = path.size() >= 4 && path.compare(path.size() - 4, 4, ".pdf") == 0;
+    PngStreamWriter png;
+    PdfStreamWriter pdf;
+    if (!(isPdf ? pdf.open(path, outWidth, outHeight) : png.open(path, outWidth, outHeight))) return false;
+
+    // Wide, short tiles: a band of rows is all that is buffered before encoding
+    GLint maxRenderbuffer = 0, maxTexture = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbuffer);
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexture);
+    int maxTile = std::max(64, std::min({static_cast<int>(maxRenderbuffer), static_cast<int>(maxTexture), kExportTileWidth}));
+    int tileW = std::min(outWidth, maxTile);
+    int tileH = std::min(outHeight, kExportTileRows);
+
+    int prevWidth = width, prevHeight = height;
+    resize(tileW, tileH);
+    camera.setAspectRatio(static_cast<float>(outWidth) / outHeight);
+
+    const size_t bandRowBytes = static_cast<size_t>(outWidth) * 3;
+    std::vector<unsigned char> band(bandRowBytes * tileH);
+    std::vector<unsigned char> tile(static_cast<size_t>(tileW) * tileH * 3);
+    bool ok = true;
+    for (int y0 = 0; y0 < outHeight && ok; y0 += tileH) {
+        int bandH = std::min(tileH, outHeight - y0);
+        // Image rows run top-down; NDC y runs bottom-up
+        float ndcTop = 1.0f - 2.0f * y0 / outHeight;
+        float ndcBottom = 1.0f - 2.0f * (y0 + tileH) / outHeight;
+        tileSpanTop = (ndcTop + 1.0f) * 0.5f;
+        tileSpanBottom = (ndcBottom + 1.0f) * 0.5f;
+        for (int x0 = 0; x0 < outWidth; x0 += tileW) {
+            int bandW = std::min(tileW, outWidth - x0);
+            float ndcLeft = -1.0f + 2.0f * x0 / outWidth;
+            float ndcRight = -1.0f + 2.0f * (x0 + tileW) / outWidth;
+            // Scale and shift so the tile's window of the full image fills clip space
+            glm::mat4 m(1.0f);
+            m[0][0] = 2.0f / (ndcRight - ndcLeft);
+            m[1][1] = 2.0f / (ndcTop - ndcBottom);
+            m[3][0] = -(ndcRight + ndcLeft) / (ndcRight - ndcLeft);
+            m[3][1] = -(ndcTop + ndcBottom) / (ndcTop - ndcBottom);
+            tileProjection = m;
+
+            beginFrame();
+            renderScene(scene, true);
+            renderBeams(scene);
+            renderGaussianBeams(scene);
+            // Edge tiles use only their top-left part: the rows nearest the top of the FBO
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, tileH - bandH, bandW, bandH, GL_RGB, GL_UNSIGNED_BYTE, tile.data());
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            endFrame();
+
+            const size_t tileRowBytes = static_cast<size_t>(bandW) * 3;
+            for (int r = 0; r < bandH; r++) {
+                std::memcpy(&band[r * bandRowBytes + static_cast<size_t>(x0) * 3],
+                            &tile[static_cast<size_t>(bandH - 1 - r) * tileRowBytes], tileRowBytes);
+            }
+        }
+        ok = isPdf ? pdf.writeRows(band.data(), bandH) : png.writeRows(band.data(), bandH);
+    }
+
+    tileProjection = glm::mat4(1.0f);
+    tileSpanBottom = 0.0f;
+    tileSpanTop = 1.0f;
+    resize(prevWidth, prevHeight);
+    camera.setAspectRatio(static_cast<float>(width) / height);
+    bool closed = isPdf ? pdf.close() : png.close();
+    return ok && closed;
+}
+
 } // namespace opticsketch
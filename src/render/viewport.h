@@ -2,11 +2,17 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <memory>
 #include "camera/camera.h"
 #include "render/shader.h"
+#include "render/frustum.h"
+#include "render/render_queue.h"
+#include "scene/change_journal.h"
 #include "render/gizmo.h"
 #include "style/scene_style.h"
 
@@ -16,12 +22,54 @@ namespace opticsketch {
 class Element;
 class Scene;
 class Beam;
+struct SceneHandle;
 
 struct CachedMesh {
     GLuint vao = 0, vbo = 0;
     GLsizei vertexCount = 0;
+    // Indexed meshes (imported OBJ): drawn with glDrawElements when indexCount > 0
+    GLuint ebo = 0;
+    GLenum indexType = 0;      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLsizei indexCount = 0;
 };
 
+// Batched line segments in GL_LINES order: interleaved position (3) + RGBA (4) + width in
+// pixels (1) + picking id (the bits of one uint) + optical path length in mm (1, < 0 when
+// the segment is not animated) per vertex. line.vert expands each pair into a
+// screen-space quad, so every width draws in the same call. The stream is rebuilt on the
+// CPU each frame and only re-uploaded when it changed.
+struct LineBatch {
+    static constexpr int kFloatsPerVertex = 10;
+    GLuint vao = 0, vbo = 0;
+    std::vector<float> vertices;    // staging for the current frame
+    std::vector<float> uploaded;    // contents currently in the VBO
+
+    void clear() { vertices.clear(); }
+    void addVertex(const glm::vec3& p, const glm::vec4& c, uint32_t objectId = 0, float width = 1.0f,
+                   float path = -1.0f);
+    void addLine(const glm::vec3& a, const glm::vec3& b, const glm::vec4& c, uint32_t objectId = 0,
+                 float width = 1.0f, float pathA = -1.0f, float pathB = -1.0f) {
+        addVertex(a, c, objectId, width, pathA);
+        addVertex(b, c, objectId, width, pathB);
+    }
+    GLsizei vertexCount() const { return static_cast<GLsizei>(vertices.size() / kFloatsPerVertex); }
+    GLsizei segmentCount() const { return vertexCount() / 2; }
+};
+
+// CPU mirror of the std140 FrameData uniform block declared in grid.vert, grid.frag,
+// material.frag and line.vert. Member order and padding must match the GLSL block.
+struct FrameUniforms {
+    glm::mat4 view{1.0f};
+    glm::mat4 projection{1.0f};
+    glm::vec3 lightPos{0.0f};
+    float ambientStrength = 0.14f;
+    glm::vec3 viewPos{0.0f};
+    float specularStrength = 0.55f;
+    float shininess = 48.0f;
+    float pad[3] = {0.0f, 0.0f, 0.0f};
+};
+static_assert(sizeof(FrameUniforms) == 176, "FrameUniforms must match the std140 FrameData layout");
+
 class Viewport {
 public:
     Viewport();
@@ -39,6 +87,9 @@ public:
     // End rendering and return texture ID for ImGui
     void endFrame();
     
+    // True until a frame has been rendered into the current framebuffer (e.g. after a resize)
+    bool isFrameStale() const { return frameStale; }
+    
     // Render grid
     void renderGrid(float spacing = 25.0f, int gridSize = 100);
     
@@ -51,6 +102,12 @@ public:
     // Render a single beam (for preview)
     void renderBeam(const Beam& beam);
 
+    // Beam propagation animation: beams are drawn only as far as 'distance' mm of optical
+    // path, user beams measured from their start and traced rays from their source. With
+    // 'beamId' set only that user beam is cut. The vertex data does not depend on the
+    // distance, so successive frames differ by one uniform. Negative turns it off.
+    void setBeamPropagation(float distance, const std::string& beamId = std::string());
+
     // Render Gaussian beam envelopes (semi-transparent triangle strips)
     void renderGaussianBeams(Scene* scene);
 
@@ -72,6 +129,19 @@ public:
     
     // Get texture ID for ImGui display
     GLuint getTextureId() const { return textureId; }
+
+    // GPU picking: an optional R32UI attachment that renderScene() and renderBeams() fill
+    // with per-object ids (elements and user beams). Off by default; toggling it recreates
+    // the framebuffer.
+    void setIdBufferEnabled(bool enabled);
+    bool isIdBufferEnabled() const { return idBufferEnabled; }
+    // Queue a read of the ids around (x, y) (viewport pixels, top-left origin). The read is
+    // issued at the end of the next frame and completes asynchronously.
+    void requestPick(int x, int y);
+    bool isPickPending() const { return pickRequested || pickFence != nullptr; }
+    // Once per request, when the read has completed: the object nearest the requested
+    // pixel (kind None for background). Validate with Scene::isHandleValid before use.
+    bool takePickResult(SceneHandle& out);
     
     // Style
     void setStyle(SceneStyle* s) { style = s; }
@@ -93,6 +163,32 @@ public:
 
     // Export viewport content to a single-page PDF (JPEG-compressed). Returns true on success.
     bool exportToPdf(const std::string& path, Scene* scene);
+
+    // The exports above with only the render on the calling thread: encoding and writing
+    // run as a job, and 'done' gets the result from JobSystem::pumpMainThread()
+    enum class ImageFormat { Png, Jpg, Pdf };
+    void exportImageAsync(const std::string& path, Scene* scene, ImageFormat format,
+                          std::function<void(bool)> done);
+
+    // Export at any size (e.g. posters beyond GL_MAX_RENDERBUFFER_SIZE) as PNG or PDF,
+    // chosen by extension. The camera frustum is rendered as a grid of sub-frusta and each
+    // band of tiles is streamed into the encoder, so memory stays bounded by one band.
+    bool exportTiled(const std::string& path, Scene* scene, int outWidth, int outHeight);
+    
+    // Store imported meshes as half-float positions + packed normals (12 vs 24 bytes/vertex).
+    // Changing it drops the cached GPU meshes; they are re-uploaded on next draw.
+    void setQuantizeImportedMeshes(bool enabled);
+    bool getQuantizeImportedMeshes() const { return quantizeImportedMeshes; }
+    
+    // Skip elements, beams and focal markers outside the camera frustum (on by default)
+    void setFrustumCulling(bool enabled) { frustumCulling = enabled; }
+    bool getFrustumCulling() const { return frustumCulling; }
+    // Objects skipped by frustum culling since the last beginFrame()
+    int getCulledObjectCount() const { return culledObjects; }
+    // Whether the element's bounds touch the current frustum (independent of the culling toggle)
+    bool isElementInView(const Element& elem) const;
+    // Approximate on-screen radius of the element's bounding sphere, in pixels
+    float getProjectedRadius(const Element& elem) const;
     
     // Explicit cleanup method (call before destroying OpenGL context)
     void cleanup();
@@ -103,51 +199,205 @@ private:
     
     GLuint framebufferId = 0;
     GLuint textureId = 0;
+    bool frameStale = true;
     GLuint renderbufferId = 0;
     
     Camera camera;
     SceneStyle* style = nullptr;
+
+    // Picking id attachment (COLOR_ATTACHMENT1) and its asynchronous readback.
+    // Ids are (SceneObjectKind << 24) | (slot + 1), 0 = no object.
+    static constexpr int kPickRadius = 2;   // reads a 5x5 block around the cursor
+    bool idBufferEnabled = false;
+    GLuint idTextureId = 0;
+    bool idWrites = false;
+    uint32_t idLayoutGeneration = 0;   // scene layout the ids in the buffer refer to
+    bool pickRequested = false;
+    int pickX = 0, pickY = 0;
+    GLuint pickPBO = 0;
+    GLsync pickFence = nullptr;
+    int pickRegionW = 0, pickRegionH = 0;     // size of the block read back
+    int pickCenterX = 0, pickCenterY = 0;     // requested pixel within it
+    uint32_t pickGeneration = 0;
+    // Route fragment output 1 to the id attachment (only while drawing pickable objects)
+    void setIdWrites(bool enabled);
+    void readPickRegion();
+    void destroyPickReadback();
+
     Shader gridShader;
     Shader materialShader;
+    // INSTANCED variants: per-instance model/normal matrix, color and material attributes
+    Shader gridInstancedShader;
+    Shader materialInstancedShader;
+    // OIT variant: transparent elements write weighted accumulation targets
+    Shader materialOitShader;
     Gizmo* gizmo = nullptr;
     
     // Grid rendering
     GLuint gridVAO = 0;
     GLuint gridVBO = 0;
     bool gridInitialized = false;
+    // Parameters the grid VBO was built for; rebuilt only when they change
+    float gridBuiltSpacing = 0.0f;
+    int gridBuiltSize = -1;
+    GLsizei gridVertexCount = 0;
 
-    // Cached geometry for built-in element types (indexed by (int)ElementType)
+    // Cached geometry for built-in element types (indexed by (int)ElementType).
+    // Solids come in kLodLevels detail levels, 0 = full tessellation.
     static constexpr int kMaxPrototypes = 16;
-    CachedMesh prototypeGeometry[kMaxPrototypes];
+    static constexpr int kLodLevels = 3;
+    CachedMesh prototypeGeometry[kLodLevels][kMaxPrototypes];
     CachedMesh prototypeWireframe[kMaxPrototypes];
+    CachedMesh meshPlaceholder;   // bounds outline for imported meshes not loaded yet
     bool prototypesInitialized = false;
 
-    // Per-instance mesh cache for ImportedMesh elements (keyed by element ID)
-    std::unordered_map<std::string, CachedMesh> meshCache;
+    // Instanced drawing: one stream per run of queued draws sharing a mesh
+    static constexpr int kInstanceFloats = 33;  // mat4 model, mat3 normal, vec4 color, vec3 material, id
+    std::vector<float> queueInstances;
+    GLuint instanceVBO = 0;
+    void drawMeshInstances(const CachedMesh& mesh, const std::vector<float>& instances, GLenum mode);
+
+    // renderScene's draws, collected per element then sorted by pass, shader, mesh and
+    // depth; kept as a member so its capacity carries over
+    RenderQueue renderQueue;
+    // Submits one pass of renderQueue. Runs of items sharing a mesh go out as a single
+    // instanced draw when 'instancedShader' is given, otherwise one draw each through
+    // 'shader'. Shaders and VAOs are only rebound when they change.
+    void drawQueuedPass(RenderPass pass, const Shader& shader, const Shader* instancedShader);
+
+    // GPU buffers for imported meshes, one per unique MeshAsset however many elements use it.
+    // The weak reference detects freed assets (and address reuse by a new asset).
+    struct SharedMesh {
+        std::weak_ptr<const MeshAsset> asset;
+        CachedMesh gpu[kLodLevels];   // full mesh, then the asset's simplified levels
+        int levelCount = 1;
+    };
+    std::unordered_map<const MeshAsset*, SharedMesh> meshCache;
+    bool quantizeImportedMeshes = true;
+    // Mesh for the given detail level, falling back to the coarsest the asset has
+    CachedMesh* getAssetMesh(const std::shared_ptr<const MeshAsset>& asset, int lod = 0);
+    void releaseUnusedMeshes();
+    // Scene journal version the mesh cache last caught up to; element removals since then
+    // may have freed assets
+    uint64_t meshJournalVersion = 0;
+    std::vector<SceneChangeEvent> journalEvents;
+
+    // Tiled export: maps the current tile's part of the image onto clip space, and the
+    // tile's vertical span of the image (0 = bottom, 1 = top) for the background gradient
+    static constexpr int kExportTileWidth = 2048;
+    static constexpr int kExportTileRows = 512;
+    glm::mat4 tileProjection{1.0f};
+    float tileSpanBottom = 0.0f;
+    float tileSpanTop = 1.0f;
 
-    // Reusable buffer for beam rendering
-    CachedMesh beamBuffer;
+    // Camera frustum for the current frame, extracted in beginFrame()
+    Frustum frustum;
+    bool frustumCulling = true;
+    int culledObjects = 0;
+    // True (and counted in culledObjects) when the object is entirely off-screen
+    bool cullBox(const glm::vec3& worldMin, const glm::vec3& worldMax);
+    bool cullSegment(const glm::vec3& a, const glm::vec3& b, float padding = 0.0f);
+
+    // Detail level for an element from its projected on-screen size (0 = full detail)
+    int selectLod(const Element& elem) const;
+
+    // Gaussian beam envelopes: one instance per beam (start/w0, end/zR, color, waist
+    // offset, sample count and whether propagation cuts it), expanded into strips on the GPU
+    static constexpr int kGaussianInstanceFloats = 16;
+    static constexpr int kMaxGaussianSamples = 64;
     CachedMesh gaussianBuffer;
+    std::vector<float> gaussianInstances;
+    Shader gaussianShader;
+    void initGaussianShader();
+
+    // See setBeamPropagation()
+    float propagationDistance = -1.0f;
+    std::string propagationBeamId;
+    bool isPropagating(const Beam& beam) const;
+
+    // Per-frame camera/lighting/shading block shared by the scene shaders; filled in
+    // beginFrame() and bound to kFrameBlockBinding for the whole frame
+    static constexpr GLuint kFrameBlockBinding = 0;
+    GLuint frameUBO = 0;
+    FrameUniforms frameUniforms;
+    void uploadFrameUniforms();
+    // Override the shading terms for one pass; restore with restoreFrameShading()
+    void setFrameShading(float ambient, float specular, float shininess);
+    void restoreFrameShading();
+    float frameAmbient = 0.14f, frameSpecular = 0.55f, frameShininess = 48.0f;
+
+    // Batched line rendering (beams, focal point markers, snap highlight)
+    Shader lineShader;
+    LineBatch beamBatch;
+    LineBatch overlayBatch;
+    void initLineShader();
+    // Upload staged vertices if they differ from the VBO contents, then bind the VAO
+    void uploadLineBatch(LineBatch& batch);
+    // Bind the line shader and enable blending for the anti-aliased edges
+    void beginLineDraw(float colorScale);
+    // All segments of the bound batch in one instanced draw
+    void drawLineSegments(GLsizei segmentCount);
+    void endLineDraw();
+    // Element outlines (wire.vert): prototype wireframes are stored as screen-space quads
+    Shader wireShader;
+    Shader wireInstancedShader;
+    void initWireShaders();
+    // Traced segments left on the GPU by the compute trace backend, drawn from its buffer
+    GLuint gpuTraceVAO = 0;
+    GLuint gpuTraceVAOBuffer = 0;   // buffer the VAO was set up for
+    void drawGpuTracedLines(GLuint buffer, GLsizei vertexCount);
 
     // Gradient background
     Shader gradientShader;
 
-    // HDRI environment map
+    // HDRI environment map with prefiltered mip levels. Decoded (or read from the cache) on
+    // a job and uploaded by the first frame after it finishes; until then the previous map,
+    // or none, is used.
+    // A path that failed to load is not retried until another one has been chosen.
+    struct HdriLoad;
     GLuint hdriTexture = 0;
+    float hdriMaxLod = 0.0f;
     std::string loadedHdriPath;
-    void loadHdriTexture(const std::string& path);
+    std::string failedHdriPath;
+    std::shared_ptr<HdriLoad> hdriLoad;   // job in flight or not yet uploaded
+    // Start loading 'path' unless it is loaded, loading or known bad; 'wait' (exports)
+    // blocks until it is ready
+    void requestHdriTexture(const std::string& path, bool wait);
+    void applyHdriLoad(std::shared_ptr<HdriLoad> load);   // by value: it may be hdriLoad itself
     void destroyHdriTexture();
 
-    // Bloom (Presentation mode)
-    GLuint bloomFBO[2] = {0, 0};
-    GLuint bloomTexture[2] = {0, 0};
+    // Bloom (Presentation mode): a mip pyramid starting at half resolution, blurred by
+    // dual-filter down/upsampling, plus a full-resolution composite target. Targets are
+    // reallocated on resize only.
+    static constexpr int kBloomMaxLevels = 8;
+    GLuint bloomMipFBO[kBloomMaxLevels] = {};
+    GLuint bloomMipTexture[kBloomMaxLevels] = {};
+    int bloomMipWidth[kBloomMaxLevels] = {};
+    int bloomMipHeight[kBloomMaxLevels] = {};
+    int bloomLevels = 0;            // allocated pyramid levels
+    GLuint bloomCompositeFBO = 0;
+    GLuint bloomCompositeTexture = 0;
     Shader bloomExtractShader;
-    Shader bloomBlurShader;
+    Shader bloomDownShader;
+    Shader bloomUpShader;
     Shader bloomCompositeShader;
     GLuint fullscreenVAO = 0;
     GLuint fullscreenVBO = 0;
     bool bloomInitialized = false;
 
+    // Weighted blended transparency (Presentation mode): a color/revealage target and a
+    // coverage target that share the main depth buffer and id texture, resolved over the
+    // opaque scene by one fullscreen pass. Made on first use, dropped with the framebuffer.
+    GLuint oitFBO = 0;
+    GLuint oitAccumTexture = 0;
+    GLuint oitWeightTexture = 0;
+    Shader oitCompositeShader;
+    bool oitShaderLoaded = false;
+    // Binds and clears the targets; false if they are unavailable (blend in scene order)
+    bool beginTransparencyAccumulation();
+    void compositeTransparency();
+    void destroyOitTargets();
+
     void createFramebuffer();
     void destroyFramebuffer();
     void initGrid();
@@ -155,14 +405,28 @@ private:
     void initFullscreenQuad();
     void initBloom();
     void destroyBloom();
+    void createBloomTargets();
+    void destroyBloomTargets();
 
     // Thumbnail rendering for library panel
     static constexpr int kThumbnailSize = 128;
     GLuint thumbnailFBO = 0;
     GLuint thumbnailDepthRBO = 0;
+    // Bump when a prototype generator changes, so cached thumbnails are re-rendered
+    static constexpr uint32_t kThumbnailGeometryVersion = 1;
+    static constexpr int kThumbnailTypes = kElementTypeCount - 1;  // all but ImportedMesh
     GLuint thumbnailTextures[kMaxPrototypes] = {};
-    bool thumbnailsGenerated = false;
+    uint64_t thumbnailKeys[kMaxPrototypes] = {};    // key of what each texture shows, 0 = nothing
+    bool thumbnailPending[kMaxPrototypes] = {};
+    // On-disk cache: one RGBA atlas of kThumbnailTypes slots side by side (GL row order)
+    std::vector<unsigned char> thumbnailAtlas;
+    uint64_t thumbnailAtlasKeys[kMaxPrototypes] = {};
+    bool thumbnailAtlasDirty = false;
+    bool thumbnailCacheLoading = false;     // read job in flight; nothing is queued meanwhile
     void destroyThumbnails();
+    uint64_t thumbnailKey(int typeIndex);
+    GLuint ensureThumbnailTexture(int typeIndex);
+    void renderThumbnail(int typeIndex);
 
 public:
     // Render beam highlight (cyan thick line) and snap point cross for snap-to-beam feedback
@@ -172,10 +436,17 @@ public:
     // Render bloom post-process pass (call after endFrame in Presentation mode)
     void renderBloomPass();
 
-    // Generate 3D thumbnail previews for all built-in element types
-    void generateThumbnails();
-    GLuint getThumbnailTexture(int typeIndex) const;
-    bool hasThumbnails() const { return thumbnailsGenerated; }
+    // 3D thumbnail previews for the built-in element types, rendered on demand and kept in
+    // an on-disk atlas keyed by prototype geometry version and element color. The cache is
+    // read on a job and installed from the main thread; uploads happen on first acquire.
+    void loadThumbnailCache(const std::string& path);
+    bool saveThumbnailCache(const std::string& path);   // writes only when something changed
+    // Thumbnail texture for an element type, or 0 if none has been rendered yet. A missing
+    // or outdated one (e.g. after a style change) is queued for renderPendingThumbnails().
+    GLuint acquireThumbnail(int typeIndex);
+    // Render up to maxCount queued thumbnails; returns how many were rendered
+    int renderPendingThumbnails(int maxCount = 4);
+    bool hasPendingThumbnails() const;
 };
 
 } // namespace opticsketch
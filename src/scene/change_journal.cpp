@@ -0,0 +1,50 @@
+#include "scene/change_journal.h"
+
+namespace opticsketch {
+
+uint64_t ChangeJournal::record(SceneChange change, SceneObjectKind kind, ObjectHandle handle) {
+    current++;
+    if (handle != kNoObjectHandle) {
+        if (handle >= objectVersions.size()) objectVersions.resize(handle + 1, 0);
+        objectVersions[handle] = current;
+    }
+
+    if (!events.empty()) {
+        SceneChangeEvent& newest = events[(first + events.size() - 1) % kCapacity];
+        if (newest.change == change && newest.kind == kind && newest.handle == handle) {
+            // Readers past its old version still see it: its version moves up
+            newest.version = current;
+            return current;
+        }
+    }
+    SceneChangeEvent event{current, change, kind, handle};
+    if (events.size() < kCapacity) {
+        events.push_back(event);
+    } else {
+        droppedThrough = events[first].version;
+        events[first] = event;
+        first = (first + 1) % kCapacity;
+    }
+    return current;
+}
+
+bool ChangeJournal::changesSince(uint64_t since, std::vector<SceneChangeEvent>& out) const {
+    if (since > current || since < droppedThrough) return false;
+    // Versions increase along the ring; walk back to the first event after 'since'
+    size_t count = 0;
+    while (count < events.size() && events[(first + events.size() - 1 - count) % kCapacity].version > since)
+        count++;
+    for (size_t i = events.size() - count; i < events.size(); i++)
+        out.push_back(events[(first + i) % kCapacity]);
+    return true;
+}
+
+void ChangeJournal::resumeFrom(uint64_t version) {
+    events.clear();
+    first = 0;
+    current = version;
+    droppedThrough = version;
+    objectVersions.clear();
+}
+
+} // namespace opticsketch
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "scene/object_handle.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace opticsketch {
+
+// Which collection of the scene an object lives in
+enum class SceneObjectKind : uint8_t { None, Element, Beam, Annotation, Measurement };
+
+enum class SceneChange : uint8_t {
+    Added,
+    Removed,
+    Transformed,        // placement: element transform or array, beam or measurement endpoints
+    PropertyChanged     // anything else about the object (label, optics, material, state)
+};
+
+struct SceneChangeEvent {
+    uint64_t version;       // scene version after this change
+    SceneChange change;
+    SceneObjectKind kind;
+    ObjectHandle handle;    // Scene::getObjectId() names it, also after removal
+};
+
+// Bounded log of scene changes with a monotonically increasing version per scene and per
+// object. Consumers keep the version they last caught up to and read what happened since,
+// instead of rescanning the scene; when they fall too far behind (or the cursor belongs
+// to another scene) changesSince() says so and they rebuild from scratch. Repeats of the
+// newest event (one object dragged frame after frame) fold into it.
+class ChangeJournal {
+public:
+    static constexpr size_t kCapacity = 4096;
+
+    // Append an event; returns the new scene version
+    uint64_t record(SceneChange change, SceneObjectKind kind, ObjectHandle handle);
+
+    uint64_t version() const { return current; }
+    // Version of the last change to one object (0 if none was recorded)
+    uint64_t objectVersion(ObjectHandle handle) const {
+        return handle < objectVersions.size() ? objectVersions[handle] : 0;
+    }
+
+    // Append the events after version 'since', oldest first. False if some of them were
+    // already dropped, or 'since' is not a version of this journal: rescan instead.
+    bool changesSince(uint64_t since, std::vector<SceneChangeEvent>& out) const;
+
+    // Continue from another journal's version with no events (scene snapshots), so
+    // cursors taken on the original read as up to date or as lost, never as behind
+    void resumeFrom(uint64_t version);
+
+private:
+    std::vector<SceneChangeEvent> events;   // ring, oldest at 'first'
+    size_t first = 0;
+    uint64_t current = 0;
+    uint64_t droppedThrough = 0;            // newest version no longer in the ring
+    std::vector<uint64_t> objectVersions;   // per handle
+};
+
+} // namespace opticsketch
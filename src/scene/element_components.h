@@ -0,0 +1,47 @@
+#pragma once
+
+#include "elements/element.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace opticsketch {
+
+// Hot per-frame element data in contiguous arrays, so draw, cull and trace-prep loops
+// stream through them instead of chasing one heap Element per row. Rows follow the
+// element slots of Scene::getElements(); array instances are laid out in one run per
+// element. Derived data only: the Elements stay the source of truth, and
+// Scene::syncElementComponents() refreshes the rows whose element changed.
+struct ElementComponents {
+    // One row per element slot
+    std::vector<uint8_t> visible;
+    std::vector<OpticalType> opticalType;
+    std::vector<glm::vec3> worldMin;        // bounds of every instance together
+    std::vector<glm::vec3> worldMax;
+    std::vector<uint32_t> firstInstance;    // size() + 1 entries into the instance rows
+
+    // One row per array instance (instance 0 is the element itself)
+    std::vector<glm::mat4> instanceModel;
+    std::vector<glm::mat3> instanceNormal;
+    std::vector<glm::vec3> instanceMin;
+    std::vector<glm::vec3> instanceMax;
+
+    size_t size() const { return visible.size(); }
+    int instanceCount(size_t slot) const {
+        return static_cast<int>(firstInstance[slot + 1] - firstInstance[slot]);
+    }
+
+    void clear() {
+        visible.clear();
+        opticalType.clear();
+        worldMin.clear();
+        worldMax.clear();
+        firstInstance.assign(1, 0);
+        instanceModel.clear();
+        instanceNormal.clear();
+        instanceMin.clear();
+        instanceMax.clear();
+    }
+};
+
+} // namespace opticsketch
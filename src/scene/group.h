@@ -1,5 +1,6 @@
 #pragma once
 
+#include "scene/object_handle.h"
 #include <string>
 #include <vector>
 
@@ -8,7 +9,8 @@ namespace opticsketch {
 struct Group {
     std::string id;
     std::string name;
-    std::vector<std::string> memberIds;
+    // Handles in the owning scene; Scene::getObjectId() gives the ids to save
+    std::vector<ObjectHandle> members;
 
     static std::string generateId();
 };
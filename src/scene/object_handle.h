@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace opticsketch {
+
+// Dense number for an object id, assigned by its Scene when the object is added. An id
+// keeps its handle for the scene's lifetime, so objects removed and re-added by undo get
+// the same one back. Handles index the selection bitset and make up group member lists.
+using ObjectHandle = uint32_t;
+static constexpr ObjectHandle kNoObjectHandle = UINT32_MAX;
+
+} // namespace opticsketch
@@ -0,0 +1,268 @@
+#include "scene/pick_index.h"
+#include "scene/scene.h"
+#include "elements/element.h"
+#include "render/beam.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace opticsketch {
+
+void PickIndex::clear() {
+    elementBVH.clear();
+    visibleElements.clear();
+    elementStates.clear();
+    segments.clear();
+    segmentOrder.clear();
+    segmentNodes.clear();
+    beamStates.clear();
+    indexedScene = nullptr;
+    segmentsValid = false;
+}
+
+void PickIndex::update(const Scene& scene) {
+    updateElements(scene);
+    updateSegments(scene);
+}
+
+void PickIndex::updateElements(const Scene& scene) {
+    visibleElements.clear();
+    for (const auto& elem : scene.getElements())
+        if (elem && elem->visible) visibleElements.push_back(elem.get());
+
+    auto captureStates = [this]() {
+        elementStates.resize(visibleElements.size());
+        for (size_t i = 0; i < visibleElements.size(); i++) {
+            const Element* elem = visibleElements[i];
+            elementStates[i] = {elem->getTransformGeneration(), elem->boundsMin, elem->boundsMax};
+        }
+    };
+
+    if (!elementBVH.matches(visibleElements)) {
+        elementBVH.build(visibleElements);
+        captureStates();
+        return;
+    }
+    // Same visible set: refit only if something moved or changed shape
+    for (size_t i = 0; i < visibleElements.size(); i++) {
+        const Element* elem = visibleElements[i];
+        const ElementState& st = elementStates[i];
+        if (elem->getTransformGeneration() != st.transformGeneration ||
+            elem->boundsMin != st.boundsMin || elem->boundsMax != st.boundsMax) {
+            elementBVH.refit();
+            captureStates();
+            return;
+        }
+    }
+}
+
+void PickIndex::updateSegments(const Scene& scene) {
+    const auto& beams = scene.getBeams();
+    const TracedRayBuffer& traced = scene.getTracedRays();
+
+    // Traced rays are covered by their revision; user beams are few, so compare them
+    bool valid = segmentsValid && indexedScene == &scene &&
+                 structureRevision == scene.getStructureRevision() &&
+                 tracedRevision == traced.revision && beamStates.size() == beams.size();
+    for (size_t i = 0; valid && i < beams.size(); i++) {
+        const BeamState& st = beamStates[i];
+        valid = beams[i]->start == st.start && beams[i]->end == st.end && beams[i]->visible == st.visible;
+    }
+    if (valid) return;
+
+    indexedScene = &scene;
+    structureRevision = scene.getStructureRevision();
+    tracedRevision = traced.revision;
+    beamStates.resize(beams.size());
+    segments.clear();
+    segments.reserve(beams.size() + traced.size());
+    for (size_t i = 0; i < beams.size(); i++) {
+        Beam* beam = beams[i].get();
+        beamStates[i] = {beam->start, beam->end, beam->visible};
+        if (beam->visible) segments.push_back({beam->start, beam->end, beam});
+    }
+    for (size_t i = 0; i < traced.size(); i++)
+        segments.push_back({traced.start[i], traced.end[i], nullptr});
+
+    segmentOrder.resize(segments.size());
+    for (size_t i = 0; i < segments.size(); i++) segmentOrder[i] = static_cast<int>(i);
+    segmentNodes.clear();
+    segmentNodes.reserve(segments.size() / kMaxLeafSegments * 2 + 1);
+    if (!segments.empty()) buildSegments(0, static_cast<int>(segments.size()));
+    segmentsValid = true;
+}
+
+// Median split along the longest axis of the segment midpoints
+int PickIndex::buildSegments(int begin, int end) {
+    int nodeIndex = static_cast<int>(segmentNodes.size());
+    segmentNodes.emplace_back();
+
+    glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+    for (int i = begin; i < end; i++) {
+        const Segment& s = segments[segmentOrder[i]];
+        bmin = glm::min(bmin, glm::min(s.a, s.b));
+        bmax = glm::max(bmax, glm::max(s.a, s.b));
+        glm::vec3 c = (s.a + s.b) * 0.5f;
+        cmin = glm::min(cmin, c);
+        cmax = glm::max(cmax, c);
+    }
+    segmentNodes[nodeIndex].bmin = bmin;
+    segmentNodes[nodeIndex].bmax = bmax;
+
+    if (end - begin <= kMaxLeafSegments) {
+        segmentNodes[nodeIndex].first = begin;
+        segmentNodes[nodeIndex].count = end - begin;
+        return nodeIndex;
+    }
+
+    glm::vec3 extent = cmax - cmin;
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(segmentOrder.begin() + begin, segmentOrder.begin() + mid, segmentOrder.begin() + end,
+        [&](int a, int b) {
+            return segments[a].a[axis] + segments[a].b[axis] < segments[b].a[axis] + segments[b].b[axis];
+        });
+
+    buildSegments(begin, mid);   // left child is nodeIndex + 1
+    int right = buildSegments(mid, end);
+    segmentNodes[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+Element* PickIndex::pickElement(const Raycast::Ray& ray, float& outT) const {
+    ElementBVH::Hit hit;
+    if (!elementBVH.closestHit(ray.origin, ray.direction, 0.0f, FLT_MAX, nullptr, 0, hit)) {
+        outT = FLT_MAX;
+        return nullptr;
+    }
+    outT = hit.t;
+    return hit.element;
+}
+
+Beam* PickIndex::pickBeam(const Raycast::Ray& ray, float threshold) const {
+    if (segmentNodes.empty()) return nullptr;
+    Beam* closest = nullptr;
+    float bestDist = threshold * threshold;
+    glm::vec3 pad(threshold);
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int n = stack[--stackSize];
+        const SegmentNode& node = segmentNodes[n];
+        float t;
+        // Anything within the threshold of the ray lies in the padded box
+        if (!Raycast::intersectAABB(ray, node.bmin - pad, node.bmax + pad, t)) continue;
+        if (node.count == 0) {
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = n + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const Segment& s = segments[segmentOrder[i]];
+            if (!s.beam) continue;   // traced rays are not selectable
+            float tRay, tSeg;
+            float sqDist = Raycast::rayToSegmentSqDist(ray, s.a, s.b, tRay, tSeg);
+            if (sqDist < bestDist && tRay > 0.0f) {
+                bestDist = sqDist;
+                closest = s.beam;
+            }
+        }
+    }
+    return closest;
+}
+
+// Squared distance from a point to a box (0 inside)
+static float boxSqDist(const glm::vec3& p, const glm::vec3& bmin, const glm::vec3& bmax) {
+    glm::vec3 d = glm::max(glm::max(bmin - p, p - bmax), glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
+
+PickIndex::BeamPoint PickIndex::nearestBeamPoint(const glm::vec3& pos, float radius) const {
+    BeamPoint result;
+    if (segmentNodes.empty()) return result;
+    float bestDistSq = radius * radius;
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int n = stack[--stackSize];
+        const SegmentNode& node = segmentNodes[n];
+        if (boxSqDist(pos, node.bmin, node.bmax) >= bestDistSq) continue;
+        if (node.count == 0) {
+            // Nearer child on top so the radius shrinks before the other side is visited
+            int left = n + 1, right = node.right;
+            const SegmentNode& l = segmentNodes[left];
+            const SegmentNode& r = segmentNodes[right];
+            bool leftFirst = boxSqDist(pos, l.bmin, l.bmax) <= boxSqDist(pos, r.bmin, r.bmax);
+            stack[stackSize++] = leftFirst ? right : left;
+            stack[stackSize++] = leftFirst ? left : right;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const Segment& s = segments[segmentOrder[i]];
+            float t;
+            glm::vec3 closest;
+            float distSq = Raycast::pointToSegmentSqDist(pos, s.a, s.b, t, closest);
+            if (distSq < bestDistSq) {
+                bestDistSq = distSq;
+                result.found = true;
+                result.point = closest;
+                result.start = s.a;
+                result.end = s.b;
+                result.beam = s.beam;
+            }
+        }
+    }
+    return result;
+}
+
+void PickIndex::queryFrustum(const Frustum& frustum, std::vector<Element*>& outElements,
+                             std::vector<Beam*>& outBeams) const {
+    elementBVH.queryFrustum(frustum, outElements);
+    if (segmentNodes.empty()) return;
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int n = stack[--stackSize];
+        const SegmentNode& node = segmentNodes[n];
+        if (!frustum.intersectsBox(node.bmin, node.bmax)) continue;
+        if (node.count == 0) {
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = n + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const Segment& s = segments[segmentOrder[i]];
+            if (s.beam && frustum.intersectsSegment(s.a, s.b)) outBeams.push_back(s.beam);
+        }
+    }
+}
+
+Frustum PickIndex::rectFrustum(const glm::mat4& viewProj, float minX, float minY,
+                               float maxX, float maxY, int viewportWidth, int viewportHeight) {
+    // Rectangle in NDC (viewport y runs down)
+    float x0 = minX / viewportWidth * 2.0f - 1.0f;
+    float x1 = maxX / viewportWidth * 2.0f - 1.0f;
+    float y0 = 1.0f - maxY / viewportHeight * 2.0f;
+    float y1 = 1.0f - minY / viewportHeight * 2.0f;
+    x1 = std::max(x1, x0 + 1e-6f);
+    y1 = std::max(y1, y0 + 1e-6f);
+
+    // Scale and shift so the rectangle fills clip space; its frustum is then the full one
+    glm::mat4 m(1.0f);
+    m[0][0] = 2.0f / (x1 - x0);
+    m[1][1] = 2.0f / (y1 - y0);
+    m[3][0] = -(x1 + x0) / (x1 - x0);
+    m[3][1] = -(y1 + y0) / (y1 - y0);
+    Frustum frustum;
+    frustum.extract(m * viewProj);
+    return frustum;
+}
+
+} // namespace opticsketch
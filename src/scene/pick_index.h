@@ -0,0 +1,101 @@
+#pragma once
+
+#include "optics/bvh.h"
+#include "render/frustum.h"
+#include "render/raycast.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace opticsketch {
+
+class Beam;
+class Element;
+class Scene;
+
+// Spatial index for viewport picking, beam snapping and marquee selection. Visible
+// elements live in an ElementBVH (refit when they move, rebuilt when the visible set
+// changes); user beams and traced ray segments live in a binary BVH over segment
+// bounds. update() revalidates against the scene and is cheap when nothing changed, so
+// callers run it before each batch of queries.
+class PickIndex {
+public:
+    // Nearest point on any visible beam or traced segment (beam is null for traced)
+    struct BeamPoint {
+        bool found = false;
+        glm::vec3 point{0.0f};
+        glm::vec3 start{0.0f};
+        glm::vec3 end{0.0f};
+        const Beam* beam = nullptr;
+    };
+
+    void update(const Scene& scene);
+
+    // Closest visible element under the ray (nullptr if none)
+    Element* pickElement(const Raycast::Ray& ray, float& outT) const;
+
+    // User beam passing closest to the ray, within 'threshold' and in front of its origin
+    Beam* pickBeam(const Raycast::Ray& ray, float threshold) const;
+
+    // Nearest beam point within 'radius' of pos
+    BeamPoint nearestBeamPoint(const glm::vec3& pos, float radius) const;
+
+    // Candidates for a marquee: elements and user beams whose bounds intersect the
+    // frustum (conservative; refine with an exact screen-space test)
+    void queryFrustum(const Frustum& frustum, std::vector<Element*>& outElements,
+                      std::vector<Beam*>& outBeams) const;
+
+    // Frustum through a viewport rectangle (pixels, y down) of a view-projection matrix
+    static Frustum rectFrustum(const glm::mat4& viewProj, float minX, float minY,
+                               float maxX, float maxY, int viewportWidth, int viewportHeight);
+
+    void clear();
+
+private:
+    struct Segment {
+        glm::vec3 a{0.0f};
+        glm::vec3 b{0.0f};
+        Beam* beam = nullptr;     // null for traced segments
+    };
+    // Binary node: count > 0 is a leaf range into segmentOrder, otherwise left is
+    // index + 1 and right is 'right'
+    struct SegmentNode {
+        glm::vec3 bmin{0.0f};
+        glm::vec3 bmax{0.0f};
+        int right = -1;
+        int first = 0;
+        int count = 0;
+    };
+    // What the element BVH was built from, to detect moves and visibility changes
+    struct ElementState {
+        unsigned int transformGeneration = 0;
+        glm::vec3 boundsMin{0.0f};
+        glm::vec3 boundsMax{0.0f};
+    };
+    struct BeamState {
+        glm::vec3 start{0.0f};
+        glm::vec3 end{0.0f};
+        bool visible = false;
+    };
+
+    static constexpr int kMaxLeafSegments = 4;
+
+    void updateElements(const Scene& scene);
+    void updateSegments(const Scene& scene);
+    int buildSegments(int begin, int end);
+
+    ElementBVH elementBVH;
+    std::vector<Element*> visibleElements;
+    std::vector<ElementState> elementStates;
+
+    std::vector<Segment> segments;
+    std::vector<int> segmentOrder;
+    std::vector<SegmentNode> segmentNodes;
+    std::vector<BeamState> beamStates;
+    const Scene* indexedScene = nullptr;
+    uint64_t structureRevision = 0;
+    uint32_t tracedRevision = 0;
+    bool segmentsValid = false;
+};
+
+} // namespace opticsketch
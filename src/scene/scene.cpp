@@ -4,6 +4,8 @@
 #include "elements/annotation.h"
 #include "elements/measurement.h"
 #include <algorithm>
+#include <cfloat>
+#include <cstdint>
 #include <string>
 
 namespace opticsketch {
@@ -35,309 +37,723 @@ static void ensureUniqueLabel(const std::vector<std::unique_ptr<Element>>& eleme
     }
 }
 
+// Append " 2", "_3", ... to a taken name. The next suffix to try is remembered per base,
+// so a batch of clashing names costs O(batch) rather than O(batch^2).
+template <typename Taken>
+static void makeUnique(std::string& name, const char* separator, const Taken& taken,
+                       std::unordered_map<std::string, int>& nextSuffix) {
+    if (!taken(name)) return;
+    const std::string base = name;
+    int& suffix = nextSuffix.emplace(base, 2).first->second;
+    do {
+        name = base + separator + std::to_string(suffix++);
+    } while (taken(name));
+}
+
+template <typename T>
+static void pushIndexed(Scene& scene, std::vector<std::unique_ptr<T>>& items,
+                        std::unordered_map<std::string, uint32_t>& index, std::unique_ptr<T> item) {
+    item->handle = scene.getObjectHandle(item->id);
+    index[item->id] = static_cast<uint32_t>(items.size());
+    items.push_back(std::move(item));
+}
+
+template <typename T>
+static T* findIndexed(const std::vector<std::unique_ptr<T>>& items,
+                      const std::unordered_map<std::string, uint32_t>& index, const std::string& id) {
+    auto it = index.find(id);
+    return it != index.end() ? items[it->second].get() : nullptr;
+}
+
+// Erase items[slot] and re-point the index at the objects that moved down
+template <typename T>
+static void eraseIndexed(std::vector<std::unique_ptr<T>>& items,
+                         std::unordered_map<std::string, uint32_t>& index, uint32_t slot) {
+    index.erase(items[slot]->id);
+    items.erase(items.begin() + slot);
+    for (uint32_t i = slot; i < items.size(); i++) index[items[i]->id] = i;
+}
+
+// Erase every item whose id is in 'ids' in one pass, then rebuild the index once
+template <typename T, typename OnErase>
+static size_t eraseIndexedSet(std::vector<std::unique_ptr<T>>& items,
+                              std::unordered_map<std::string, uint32_t>& index,
+                              const std::unordered_set<std::string>& ids, const OnErase& onErase) {
+    size_t before = items.size();
+    items.erase(std::remove_if(items.begin(), items.end(), [&](const std::unique_ptr<T>& item) {
+        if (!ids.count(item->id)) return false;
+        onErase(*item);
+        return true;
+    }), items.end());
+    if (items.size() != before) {
+        index.clear();
+        for (uint32_t i = 0; i < items.size(); i++) index[items[i]->id] = i;
+    }
+    return before - items.size();
+}
+
+template <typename T>
+static std::vector<T*> pushIndexedBatch(Scene& scene, std::vector<std::unique_ptr<T>>& items,
+                                        std::unordered_map<std::string, uint32_t>& index,
+                                        std::vector<std::unique_ptr<T>>& batch) {
+    std::vector<T*> added;
+    added.reserve(batch.size());
+    items.reserve(items.size() + batch.size());
+    index.reserve(items.size() + batch.size());
+    for (auto& item : batch) {
+        if (!item) continue;
+        added.push_back(item.get());
+        pushIndexed(scene, items, index, std::move(item));
+    }
+    return added;
+}
+
+// Move 'from' into items: matching ids are replaced in place, new ones appended.
+// onReplace(old) runs for each object replaced, onMerge(object) for each one moved in.
+template <typename T, typename OnReplace, typename OnMerge>
+static void mergeIndexed(Scene& scene, std::vector<std::unique_ptr<T>>& items,
+                         std::unordered_map<std::string, uint32_t>& index,
+                         std::vector<std::unique_ptr<T>>& from, const OnReplace& onReplace,
+                         const OnMerge& onMerge) {
+    for (auto& item : from) {
+        auto it = index.find(item->id);
+        if (it == index.end()) {
+            pushIndexed(scene, items, index, std::move(item));
+            onMerge(*items.back());
+            continue;
+        }
+        std::unique_ptr<T>& slot = items[it->second];
+        onReplace(*slot);
+        item->handle = slot->handle;
+        slot = std::move(item);
+        onMerge(*slot);
+    }
+    from.clear();
+}
+
+// Selected objects of one kind in scene order; costs O(selection), not O(scene)
+template <typename T>
+static std::vector<T*> selectedIndexed(const Scene& scene, const std::vector<std::unique_ptr<T>>& items,
+                                       const std::unordered_map<std::string, uint32_t>& index) {
+    std::vector<uint32_t> slots;
+    scene.forEachSelected([&](ObjectHandle handle) {
+        auto it = index.find(scene.getObjectId(handle));
+        if (it != index.end()) slots.push_back(it->second);
+    });
+    std::sort(slots.begin(), slots.end());
+    std::vector<T*> result;
+    result.reserve(slots.size());
+    for (uint32_t slot : slots) result.push_back(items[slot].get());
+    return result;
+}
+
+template <typename T>
+static T* firstSelectedIndexed(const Scene& scene, const std::vector<std::unique_ptr<T>>& items,
+                               const std::unordered_map<std::string, uint32_t>& index) {
+    uint32_t best = UINT32_MAX;
+    scene.forEachSelected([&](ObjectHandle handle) {
+        auto it = index.find(scene.getObjectId(handle));
+        if (it != index.end() && it->second < best) best = it->second;
+    });
+    return best != UINT32_MAX ? items[best].get() : nullptr;
+}
+
+ObjectHandle Scene::getObjectHandle(const std::string& id) {
+    auto inserted = handleIndex.emplace(id, static_cast<ObjectHandle>(handleIds.size()));
+    if (inserted.second) {
+        handleIds.push_back(id);
+        if (selectionBits.size() * 64 < handleIds.size()) selectionBits.push_back(0);
+    }
+    return inserted.first->second;
+}
+
+ObjectHandle Scene::findObjectHandle(const std::string& id) const {
+    auto it = handleIndex.find(id);
+    return it != handleIndex.end() ? it->second : kNoObjectHandle;
+}
+
+void Scene::setSelected(ObjectHandle handle, bool selected) {
+    if (handle >= handleIds.size()) return;
+    uint64_t& word = selectionBits[handle / 64];
+    const uint64_t bit = uint64_t(1) << (handle % 64);
+    if (((word & bit) != 0) == selected) return;
+    word ^= bit;
+    if (selected) selectionCount++;
+    else selectionCount--;
+    selectionRevision++;
+}
+
+void Scene::forgetObject(ObjectHandle handle) {
+    setSelected(handle, false);
+    // Remove from any group
+    for (auto& g : groups) {
+        auto mit = std::find(g.members.begin(), g.members.end(), handle);
+        if (mit != g.members.end()) g.members.erase(mit);
+    }
+    // Auto-dissolve empty groups
+    groups.erase(std::remove_if(groups.begin(), groups.end(),
+        [](const Group& g) { return g.members.empty(); }), groups.end());
+}
+
 void Scene::addElement(std::unique_ptr<Element> element) {
     if (!element) return;
     Element* ptr = element.get();
     ensureUniqueId(this, ptr);
     ensureUniqueLabel(elements, ptr);
-    elements.push_back(std::move(element));
+    pushIndexed(*this, elements, elementIndex, std::move(element));
+    journalChange(SceneObjectKind::Element, ptr->handle, SceneChange::Added);
+    structureRevision++;
+}
+
+std::vector<Element*> Scene::addElements(std::vector<std::unique_ptr<Element>> batch) {
+    std::vector<Element*> added;
+    added.reserve(batch.size());
+    elements.reserve(elements.size() + batch.size());
+    elementIndex.reserve(elements.size() + batch.size());
+    std::unordered_set<std::string> labels;
+    labels.reserve(elements.size() + batch.size());
+    for (const auto& e : elements) labels.insert(e->label);
+
+    // Same naming rules as addElement(): "id_2", "Label 2", ...
+    std::unordered_map<std::string, int> idSuffix, labelSuffix;
+    auto idTaken = [this](const std::string& id) { return elementIndex.count(id) != 0; };
+    auto labelTaken = [&labels](const std::string& label) { return labels.count(label) != 0; };
+    for (auto& element : batch) {
+        if (!element) continue;
+        if (element->id.empty()) element->id = "element";
+        makeUnique(element->id, "_", idTaken, idSuffix);
+        makeUnique(element->label, " ", labelTaken, labelSuffix);
+        labels.insert(element->label);
+        added.push_back(element.get());
+        pushIndexed(*this, elements, elementIndex, std::move(element));
+        journalChange(SceneObjectKind::Element, added.back()->handle, SceneChange::Added);
+    }
+    if (!added.empty()) structureRevision++;
+    return added;
 }
 
-bool Scene::removeElement(const std::string& id) {
-    auto it = std::find_if(elements.begin(), elements.end(),
-        [&id](const std::unique_ptr<Element>& elem) {
-            return elem->id == id;
-        });
-
-    if (it != elements.end()) {
-        selectedIds.erase(id);
-        // Remove from any group
-        for (auto& g : groups) {
-            auto mit = std::find(g.memberIds.begin(), g.memberIds.end(), id);
-            if (mit != g.memberIds.end()) g.memberIds.erase(mit);
-        }
-        // Auto-dissolve empty groups
-        groups.erase(std::remove_if(groups.begin(), groups.end(),
-            [](const Group& g) { return g.memberIds.empty(); }), groups.end());
-        elements.erase(it);
-        return true;
+std::vector<Beam*> Scene::addBeams(std::vector<std::unique_ptr<Beam>> batch) {
+    std::vector<Beam*> added = pushIndexedBatch(*this, beams, beamIndex, batch);
+    for (Beam* beam : added) journalChange(SceneObjectKind::Beam, beam->handle, SceneChange::Added);
+    if (!added.empty()) structureRevision++;
+    return added;
+}
+
+std::vector<Annotation*> Scene::addAnnotations(std::vector<std::unique_ptr<Annotation>> batch) {
+    std::vector<Annotation*> added = pushIndexedBatch(*this, annotations, annotationIndex, batch);
+    for (Annotation* ann : added) journalChange(SceneObjectKind::Annotation, ann->handle, SceneChange::Added);
+    if (!added.empty()) structureRevision++;
+    return added;
+}
+
+size_t Scene::removeObjects(const std::unordered_set<std::string>& ids) {
+    if (ids.empty()) return 0;
+    auto forget = [this](SceneObjectKind kind) {
+        return [this, kind](const auto& object) {
+            forgetObject(object.handle);
+            journalChange(kind, object.handle, SceneChange::Removed);
+        };
+    };
+    size_t removed = eraseIndexedSet(elements, elementIndex, ids, forget(SceneObjectKind::Element));
+    removed += eraseIndexedSet(beams, beamIndex, ids, forget(SceneObjectKind::Beam));
+    removed += eraseIndexedSet(annotations, annotationIndex, ids, forget(SceneObjectKind::Annotation));
+    removed += eraseIndexedSet(measurements, measurementIndex, ids, forget(SceneObjectKind::Measurement));
+    if (removed > 0) {
+        layoutGeneration++;
+        structureRevision++;
     }
-    return false;
+    return removed;
 }
 
-Element* Scene::getElement(const std::string& id) {
-    auto it = std::find_if(elements.begin(), elements.end(),
-        [&id](const std::unique_ptr<Element>& elem) {
-            return elem->id == id;
-        });
+void Scene::mergeObjects(Scene& from) {
+    // A replaced object is journaled as removed, then added again, so id-keyed caches
+    // (imported mesh buffers) drop what they held for it
+    auto record = [this](SceneObjectKind kind, SceneChange change) {
+        return [this, kind, change](const auto& object) { journalChange(kind, object.handle, change); };
+    };
+    mergeIndexed(*this, elements, elementIndex, from.elements,
+                 record(SceneObjectKind::Element, SceneChange::Removed),
+                 record(SceneObjectKind::Element, SceneChange::Added));
+    mergeIndexed(*this, beams, beamIndex, from.beams,
+                 record(SceneObjectKind::Beam, SceneChange::Removed),
+                 record(SceneObjectKind::Beam, SceneChange::Added));
+    mergeIndexed(*this, annotations, annotationIndex, from.annotations,
+                 record(SceneObjectKind::Annotation, SceneChange::Removed),
+                 record(SceneObjectKind::Annotation, SceneChange::Added));
+    mergeIndexed(*this, measurements, measurementIndex, from.measurements,
+                 record(SceneObjectKind::Measurement, SceneChange::Removed),
+                 record(SceneObjectKind::Measurement, SceneChange::Added));
+    from.clear();
+    structureRevision++;
+}
 
-    return (it != elements.end()) ? it->get() : nullptr;
+bool Scene::removeElement(const std::string& id) {
+    auto it = elementIndex.find(id);
+    if (it == elementIndex.end()) return false;
+    uint32_t slot = it->second;
+    forgetObject(elements[slot]->handle);
+    journalChange(SceneObjectKind::Element, elements[slot]->handle, SceneChange::Removed);
+    eraseIndexed(elements, elementIndex, slot);
+    layoutGeneration++;
+    structureRevision++;
+    return true;
+}
+
+Element* Scene::getElement(const std::string& id) {
+    return findIndexed(elements, elementIndex, id);
 }
 
 void Scene::addBeam(std::unique_ptr<Beam> beam) {
     if (!beam) return;
-    beams.push_back(std::move(beam));
+    pushIndexed(*this, beams, beamIndex, std::move(beam));
+    journalChange(SceneObjectKind::Beam, beams.back()->handle, SceneChange::Added);
+    structureRevision++;
 }
 
 bool Scene::removeBeam(const std::string& id) {
-    auto it = std::find_if(beams.begin(), beams.end(),
-        [&id](const std::unique_ptr<Beam>& beam) {
-            return beam->id == id;
-        });
-
-    if (it != beams.end()) {
-        selectedIds.erase(id);
-        for (auto& g : groups) {
-            auto mit = std::find(g.memberIds.begin(), g.memberIds.end(), id);
-            if (mit != g.memberIds.end()) g.memberIds.erase(mit);
-        }
-        groups.erase(std::remove_if(groups.begin(), groups.end(),
-            [](const Group& g) { return g.memberIds.empty(); }), groups.end());
-        beams.erase(it);
-        return true;
-    }
-    return false;
+    auto it = beamIndex.find(id);
+    if (it == beamIndex.end()) return false;
+    uint32_t slot = it->second;
+    forgetObject(beams[slot]->handle);
+    journalChange(SceneObjectKind::Beam, beams[slot]->handle, SceneChange::Removed);
+    eraseIndexed(beams, beamIndex, slot);
+    layoutGeneration++;
+    structureRevision++;
+    return true;
 }
 
 Beam* Scene::getBeam(const std::string& id) {
-    auto it = std::find_if(beams.begin(), beams.end(),
-        [&id](const std::unique_ptr<Beam>& beam) {
-            return beam->id == id;
-        });
-
-    return (it != beams.end()) ? it->get() : nullptr;
+    return findIndexed(beams, beamIndex, id);
 }
 
 void Scene::addAnnotation(std::unique_ptr<Annotation> annotation) {
     if (!annotation) return;
-    annotations.push_back(std::move(annotation));
+    pushIndexed(*this, annotations, annotationIndex, std::move(annotation));
+    journalChange(SceneObjectKind::Annotation, annotations.back()->handle, SceneChange::Added);
+    structureRevision++;
 }
 
 bool Scene::removeAnnotation(const std::string& id) {
-    auto it = std::find_if(annotations.begin(), annotations.end(),
-        [&id](const std::unique_ptr<Annotation>& ann) {
-            return ann->id == id;
-        });
-
-    if (it != annotations.end()) {
-        selectedIds.erase(id);
-        for (auto& g : groups) {
-            auto mit = std::find(g.memberIds.begin(), g.memberIds.end(), id);
-            if (mit != g.memberIds.end()) g.memberIds.erase(mit);
-        }
-        groups.erase(std::remove_if(groups.begin(), groups.end(),
-            [](const Group& g) { return g.memberIds.empty(); }), groups.end());
-        annotations.erase(it);
-        return true;
-    }
-    return false;
+    auto it = annotationIndex.find(id);
+    if (it == annotationIndex.end()) return false;
+    uint32_t slot = it->second;
+    forgetObject(annotations[slot]->handle);
+    journalChange(SceneObjectKind::Annotation, annotations[slot]->handle, SceneChange::Removed);
+    eraseIndexed(annotations, annotationIndex, slot);
+    layoutGeneration++;
+    structureRevision++;
+    return true;
 }
 
 Annotation* Scene::getAnnotation(const std::string& id) {
-    auto it = std::find_if(annotations.begin(), annotations.end(),
-        [&id](const std::unique_ptr<Annotation>& ann) {
-            return ann->id == id;
-        });
-
-    return (it != annotations.end()) ? it->get() : nullptr;
+    return findIndexed(annotations, annotationIndex, id);
 }
 
 void Scene::addMeasurement(std::unique_ptr<Measurement> measurement) {
     if (!measurement) return;
-    measurements.push_back(std::move(measurement));
+    pushIndexed(*this, measurements, measurementIndex, std::move(measurement));
+    journalChange(SceneObjectKind::Measurement, measurements.back()->handle, SceneChange::Added);
+    structureRevision++;
 }
 
 bool Scene::removeMeasurement(const std::string& id) {
-    auto it = std::find_if(measurements.begin(), measurements.end(),
-        [&id](const std::unique_ptr<Measurement>& m) { return m->id == id; });
-    if (it != measurements.end()) {
-        selectedIds.erase(id);
-        for (auto& g : groups) {
-            auto mit = std::find(g.memberIds.begin(), g.memberIds.end(), id);
-            if (mit != g.memberIds.end()) g.memberIds.erase(mit);
+    auto it = measurementIndex.find(id);
+    if (it == measurementIndex.end()) return false;
+    uint32_t slot = it->second;
+    forgetObject(measurements[slot]->handle);
+    journalChange(SceneObjectKind::Measurement, measurements[slot]->handle, SceneChange::Removed);
+    eraseIndexed(measurements, measurementIndex, slot);
+    layoutGeneration++;
+    structureRevision++;
+    return true;
+}
+
+Measurement* Scene::getMeasurement(const std::string& id) {
+    return findIndexed(measurements, measurementIndex, id);
+}
+
+SceneHandle Scene::findHandle(const std::string& id) const {
+    SceneHandle handle;
+    handle.generation = layoutGeneration;
+    const std::pair<const std::unordered_map<std::string, uint32_t>*, SceneObjectKind> indices[] = {
+        {&elementIndex, SceneObjectKind::Element},
+        {&beamIndex, SceneObjectKind::Beam},
+        {&annotationIndex, SceneObjectKind::Annotation},
+        {&measurementIndex, SceneObjectKind::Measurement},
+    };
+    for (const auto& [index, kind] : indices) {
+        auto it = index->find(id);
+        if (it != index->end()) {
+            handle.kind = kind;
+            handle.index = it->second;
+            break;
         }
-        groups.erase(std::remove_if(groups.begin(), groups.end(),
-            [](const Group& g) { return g.memberIds.empty(); }), groups.end());
-        measurements.erase(it);
-        return true;
     }
-    return false;
+    return handle;
 }
 
-Measurement* Scene::getMeasurement(const std::string& id) {
-    auto it = std::find_if(measurements.begin(), measurements.end(),
-        [&id](const std::unique_ptr<Measurement>& m) { return m->id == id; });
-    return (it != measurements.end()) ? it->get() : nullptr;
+Element* Scene::getElement(const SceneHandle& handle) const {
+    if (!isHandleValid(handle) || handle.kind != SceneObjectKind::Element) return nullptr;
+    return handle.index < elements.size() ? elements[handle.index].get() : nullptr;
+}
+
+Beam* Scene::getBeam(const SceneHandle& handle) const {
+    if (!isHandleValid(handle) || handle.kind != SceneObjectKind::Beam) return nullptr;
+    return handle.index < beams.size() ? beams[handle.index].get() : nullptr;
+}
+
+Annotation* Scene::getAnnotation(const SceneHandle& handle) const {
+    if (!isHandleValid(handle) || handle.kind != SceneObjectKind::Annotation) return nullptr;
+    return handle.index < annotations.size() ? annotations[handle.index].get() : nullptr;
+}
+
+Measurement* Scene::getMeasurement(const SceneHandle& handle) const {
+    if (!isHandleValid(handle) || handle.kind != SceneObjectKind::Measurement) return nullptr;
+    return handle.index < measurements.size() ? measurements[handle.index].get() : nullptr;
 }
 
 std::vector<Measurement*> Scene::getSelectedMeasurements() const {
-    std::vector<Measurement*> result;
-    for (const auto& m : measurements) {
-        if (selectedIds.count(m->id))
-            result.push_back(m.get());
-    }
-    return result;
+    return selectedIndexed(*this, measurements, measurementIndex);
 }
 
 Measurement* Scene::getSelectedMeasurement() const {
-    for (const auto& m : measurements) {
-        if (selectedIds.count(m->id))
-            return m.get();
-    }
-    return nullptr;
+    return firstSelectedIndexed(*this, measurements, measurementIndex);
 }
 
 void Scene::selectMeasurement(const std::string& id, bool additive) {
     if (!getMeasurement(id)) return;
-    if (!additive) selectedIds.clear();
-    selectedIds.insert(id);
-    if (!additive) {
-        Group* g = findGroupContaining(id);
-        if (g) {
-            for (const auto& mid : g->memberIds)
-                selectedIds.insert(mid);
-        }
-    }
+    selectWithGroup(findObjectHandle(id), additive);
 }
 
 void Scene::clear() {
+    for (const auto& elem : elements) journalChange(SceneObjectKind::Element, elem->handle, SceneChange::Removed);
+    for (const auto& beam : beams) journalChange(SceneObjectKind::Beam, beam->handle, SceneChange::Removed);
+    for (const auto& ann : annotations)
+        journalChange(SceneObjectKind::Annotation, ann->handle, SceneChange::Removed);
+    for (const auto& meas : measurements)
+        journalChange(SceneObjectKind::Measurement, meas->handle, SceneChange::Removed);
     elements.clear();
     beams.clear();
+    tracedRays.clear();
     annotations.clear();
     measurements.clear();
     groups.clear();
-    selectedIds.clear();
+    std::fill(selectionBits.begin(), selectionBits.end(), 0);
+    selectionCount = 0;
+    selectionRevision++;
     viewPresets.clear();
+    elementIndex.clear();
+    beamIndex.clear();
+    annotationIndex.clear();
+    measurementIndex.clear();
+    layoutGeneration++;
+    structureRevision++;
+}
+
+ElementEditState ElementEditState::capture(const Element& elem) {
+    ElementEditState state;
+    state.visible = elem.visible;
+    state.locked = elem.locked;
+    state.showLabel = elem.showLabel;
+    state.layer = elem.layer;
+    state.optics = elem.optics;
+    state.material = elem.material;
+    return state;
+}
+
+void ElementEditState::applyTo(Element& elem) const {
+    elem.visible = visible;
+    elem.locked = locked;
+    elem.showLabel = showLabel;
+    elem.layer = layer;
+    elem.optics = optics;
+    elem.material = material;
+}
+
+bool ElementEditState::operator==(const ElementEditState& o) const {
+    const OpticalProperties& a = optics;
+    const OpticalProperties& b = o.optics;
+    bool sameOptics = a.opticalType == b.opticalType && a.ior == b.ior &&
+                      a.reflectivity == b.reflectivity && a.transmissivity == b.transmissivity &&
+                      a.focalLength == b.focalLength && a.curvatureR1 == b.curvatureR1 &&
+                      a.curvatureR2 == b.curvatureR2 && a.apertureDiameter == b.apertureDiameter &&
+                      a.gratingLineDensity == b.gratingLineDensity && a.filterColor == b.filterColor &&
+                      a.cauchyB == b.cauchyB && a.sourceRayCount == b.sourceRayCount &&
+                      a.sourceBeamWidth == b.sourceBeamWidth && a.sourceIsWhiteLight == b.sourceIsWhiteLight;
+    bool sameMaterial = material.metallic == o.material.metallic && material.roughness == o.material.roughness &&
+                        material.transparency == o.material.transparency &&
+                        material.fresnelIOR == o.material.fresnelIOR;
+    return visible == o.visible && locked == o.locked && showLabel == o.showLabel &&
+           layer == o.layer && sameOptics && sameMaterial;
+}
+
+void Scene::beginElementEdit(const std::vector<Element*>& targets) {
+    if (editOpen) endElementEdit();
+    editOpen = true;
+    editIds.clear();
+    editHandles.clear();
+    editBefore.clear();
+    editIds.reserve(targets.size());
+    editHandles.reserve(targets.size());
+    editBefore.reserve(targets.size());
+    for (Element* elem : targets) {
+        if (!elem) continue;
+        editIds.push_back(elem->id);
+        editHandles.push_back(findHandle(elem->id));
+        editBefore.push_back(ElementEditState::capture(*elem));
+    }
+}
+
+std::vector<ElementEdit> Scene::endElementEdit() {
+    std::vector<ElementEdit> edits;
+    if (!editOpen) return edits;
+    editOpen = false;
+    for (size_t i = 0; i < editIds.size(); i++) {
+        Element* elem = isHandleValid(editHandles[i]) ? getElement(editHandles[i]) : getElement(editIds[i]);
+        if (!elem) continue;   // removed while the edit was open
+        ElementEditState after = ElementEditState::capture(*elem);
+        if (after == editBefore[i]) continue;
+        journalChange(SceneObjectKind::Element, elem->handle, SceneChange::PropertyChanged);
+        edits.push_back({std::move(editIds[i]), editBefore[i], after});
+    }
+    editIds.clear();
+    editHandles.clear();
+    editBefore.clear();
+    if (!edits.empty()) editRevision++;
+    return edits;
+}
+
+std::unique_ptr<Scene> Scene::snapshot(bool withSelection) const {
+    auto copy = std::make_unique<Scene>();
+    copy->handleIndex = handleIndex;
+    copy->handleIds = handleIds;
+    if (withSelection) {
+        copy->selectionBits = selectionBits;
+        copy->selectionCount = selectionCount;
+    } else {
+        copy->selectionBits.assign(selectionBits.size(), 0);
+    }
+    // Objects are pushed directly: their ids and labels are already unique
+    copy->elements.reserve(elements.size());
+    for (const auto& elem : elements) {
+        auto c = elem->clone();
+        c->id = elem->id;
+        pushIndexed(*copy, copy->elements, copy->elementIndex, std::move(c));
+    }
+    copy->beams.reserve(beams.size());
+    for (const auto& beam : beams) {
+        auto c = beam->clone();
+        c->id = beam->id;
+        pushIndexed(*copy, copy->beams, copy->beamIndex, std::move(c));
+    }
+    copy->annotations.reserve(annotations.size());
+    for (const auto& ann : annotations) {
+        auto c = ann->clone();
+        c->id = ann->id;
+        pushIndexed(*copy, copy->annotations, copy->annotationIndex, std::move(c));
+    }
+    copy->measurements.reserve(measurements.size());
+    for (const auto& meas : measurements) {
+        auto c = meas->clone();
+        c->id = meas->id;
+        pushIndexed(*copy, copy->measurements, copy->measurementIndex, std::move(c));
+    }
+    copy->tracedRays = tracedRays;
+    copy->groups = groups;          // same handles: the copy's table was interned first
+    copy->viewPresets = viewPresets;
+    // Versions carry over, the events don't: a cursor older than this reads as lost
+    copy->journal.resumeFrom(journal.version());
+    return copy;
+}
+
+void Scene::writeComponentInstances(size_t slot) {
+    const Element& elem = *elements[slot];
+    const uint32_t first = components.firstInstance[slot];
+    const int count = components.instanceCount(slot);
+    glm::vec3 worldMin(FLT_MAX), worldMax(-FLT_MAX);
+    for (int instance = 0; instance < count; instance++) {
+        const size_t row = first + instance;
+        if (instance == 0) {
+            components.instanceModel[row] = elem.getModelMatrix();
+            components.instanceNormal[row] = elem.getNormalMatrix();
+        } else {
+            components.instanceModel[row] = elem.getInstanceModelMatrix(instance);
+            components.instanceNormal[row] = glm::mat3(glm::transpose(glm::inverse(components.instanceModel[row])));
+        }
+        transformedBounds(components.instanceModel[row], elem.boundsMin, elem.boundsMax,
+                          components.instanceMin[row], components.instanceMax[row]);
+        worldMin = glm::min(worldMin, components.instanceMin[row]);
+        worldMax = glm::max(worldMax, components.instanceMax[row]);
+    }
+    components.worldMin[slot] = worldMin;
+    components.worldMax[slot] = worldMax;
+    componentKeys[slot] = {elem.getTransformGeneration(), elem.boundsMin, elem.boundsMax};
+}
+
+const ElementComponents& Scene::syncElementComponents() {
+    if (components.firstInstance.empty()) components.firstInstance.push_back(0);
+    // Slots from 'from' on are laid out again: everything after a structural change,
+    // or the tail after an element whose instance count changed (its run moves the rest)
+    size_t from = elements.size();
+    if (componentsRevision != structureRevision || components.size() != elements.size()) from = 0;
+    for (size_t slot = 0; slot < from; slot++) {
+        const Element& elem = *elements[slot];
+        if (elem.getInstanceCount() != components.instanceCount(slot)) {
+            from = slot;
+            break;
+        }
+        components.visible[slot] = elem.visible;
+        components.opticalType[slot] = elem.optics.opticalType;
+        const ComponentKey& key = componentKeys[slot];
+        if (elem.getTransformGeneration() != key.transformGeneration ||
+            elem.boundsMin != key.boundsMin || elem.boundsMax != key.boundsMax) {
+            writeComponentInstances(slot);
+        }
+    }
+    if (from < elements.size() || components.size() != elements.size()) {
+        const size_t n = elements.size();
+        components.visible.resize(n);
+        components.opticalType.resize(n);
+        components.worldMin.resize(n);
+        components.worldMax.resize(n);
+        componentKeys.resize(n);
+        components.firstInstance.resize(from + 1);
+        for (size_t slot = from; slot < n; slot++)
+            components.firstInstance.push_back(components.firstInstance[slot] + elements[slot]->getInstanceCount());
+        const size_t rows = components.firstInstance.back();
+        components.instanceModel.resize(rows);
+        components.instanceNormal.resize(rows);
+        components.instanceMin.resize(rows);
+        components.instanceMax.resize(rows);
+        for (size_t slot = from; slot < n; slot++) {
+            components.visible[slot] = elements[slot]->visible;
+            components.opticalType[slot] = elements[slot]->optics.opticalType;
+            writeComponentInstances(slot);
+        }
+    }
+    componentsRevision = structureRevision;
+    return components;
+}
+
+void Scene::journalChange(SceneObjectKind kind, ObjectHandle handle, SceneChange change) {
+    if (kind == SceneObjectKind::Element && handle != kNoObjectHandle) {
+        if (handle >= journaledTransforms.size()) journaledTransforms.resize(handle + 1, 0);
+        // An added element's transform is covered by the add
+        if (change == SceneChange::Added) journaledTransforms[handle] = 0;
+    }
+    journal.record(change, kind, handle);
+}
+
+void Scene::recordChange(const std::string& id, SceneChange change) {
+    SceneHandle where = findHandle(id);
+    if (!where) return;
+    ObjectHandle handle = findObjectHandle(id);
+    if (change == SceneChange::Transformed && where.kind == SceneObjectKind::Element) {
+        // Reported already; journalTransforms() would record it again
+        if (handle >= journaledTransforms.size()) journaledTransforms.resize(handle + 1, 0);
+        journaledTransforms[handle] = elements[where.index]->getTransformGeneration() + 1;
+    }
+    journalChange(where.kind, handle, change);
+}
+
+void Scene::recordChange(ObjectHandle handle, SceneChange change) {
+    if (handle < handleIds.size()) recordChange(handleIds[handle], change);
+}
+
+void Scene::journalTransforms() {
+    for (const auto& elem : elements) {
+        const unsigned int seen = elem->getTransformGeneration() + 1;
+        if (elem->handle >= journaledTransforms.size()) journaledTransforms.resize(elem->handle + 1, 0);
+        unsigned int& last = journaledTransforms[elem->handle];
+        if (last != 0 && last != seen)
+            journal.record(SceneChange::Transformed, SceneObjectKind::Element, elem->handle);
+        last = seen;
+    }
 }
 
 void Scene::clearTracedBeams() {
-    beams.erase(
-        std::remove_if(beams.begin(), beams.end(),
-            [this](const std::unique_ptr<Beam>& b) {
-                if (b->isTraced) {
-                    selectedIds.erase(b->id);
-                    return true;
-                }
-                return false;
-            }),
-        beams.end());
+    tracedRays.clear();
+}
+
+void Scene::clearTracedBeams(const std::string& sourceId) {
+    tracedRays.removeSource(sourceId);
 }
 
 void Scene::selectElement(const std::string& id, bool additive) {
     if (!getElement(id)) return;
-    if (!additive) selectedIds.clear();
-    selectedIds.insert(id);
-    // Auto-select group members on non-additive select
-    if (!additive) {
-        Group* g = findGroupContaining(id);
-        if (g) {
-            for (const auto& mid : g->memberIds)
-                selectedIds.insert(mid);
-        }
-    }
+    selectWithGroup(findObjectHandle(id), additive);
 }
 
 void Scene::selectBeam(const std::string& id, bool additive) {
     if (!getBeam(id)) return;
-    if (!additive) selectedIds.clear();
-    selectedIds.insert(id);
-    if (!additive) {
-        Group* g = findGroupContaining(id);
-        if (g) {
-            for (const auto& mid : g->memberIds)
-                selectedIds.insert(mid);
-        }
-    }
+    selectWithGroup(findObjectHandle(id), additive);
 }
 
 void Scene::selectAnnotation(const std::string& id, bool additive) {
     if (!getAnnotation(id)) return;
-    if (!additive) selectedIds.clear();
-    selectedIds.insert(id);
+    selectWithGroup(findObjectHandle(id), additive);
+}
+
+void Scene::selectWithGroup(ObjectHandle handle, bool additive) {
+    if (!additive) deselectAll();
+    setSelected(handle, true);
+    // Auto-select group members on non-additive select
     if (!additive) {
-        Group* g = findGroupContaining(id);
-        if (g) {
-            for (const auto& mid : g->memberIds)
-                selectedIds.insert(mid);
+        if (Group* g = findGroupContaining(handle)) {
+            for (ObjectHandle member : g->members) setSelected(member, true);
         }
     }
 }
 
 void Scene::toggleSelect(const std::string& id) {
-    if (selectedIds.count(id))
-        selectedIds.erase(id);
-    else
-        selectedIds.insert(id);
+    ObjectHandle handle = findObjectHandle(id);
+    setSelected(handle, !isSelected(handle));
 }
 
 void Scene::deselectAll() {
-    selectedIds.clear();
+    if (selectionCount == 0) return;
+    std::fill(selectionBits.begin(), selectionBits.end(), 0);
+    selectionCount = 0;
+    selectionRevision++;
 }
 
 bool Scene::isSelected(const std::string& id) const {
-    return selectedIds.count(id) > 0;
+    return isSelected(findObjectHandle(id));
 }
 
 std::vector<Element*> Scene::getSelectedElements() const {
-    std::vector<Element*> result;
-    for (const auto& elem : elements) {
-        if (selectedIds.count(elem->id))
-            result.push_back(elem.get());
-    }
-    return result;
+    return selectedIndexed(*this, elements, elementIndex);
 }
 
 std::vector<Beam*> Scene::getSelectedBeams() const {
-    std::vector<Beam*> result;
-    for (const auto& beam : beams) {
-        if (selectedIds.count(beam->id))
-            result.push_back(beam.get());
-    }
-    return result;
+    return selectedIndexed(*this, beams, beamIndex);
 }
 
 Element* Scene::getSelectedElement() const {
-    for (const auto& elem : elements) {
-        if (selectedIds.count(elem->id))
-            return elem.get();
-    }
-    return nullptr;
+    return firstSelectedIndexed(*this, elements, elementIndex);
 }
 
 Beam* Scene::getSelectedBeam() const {
-    for (const auto& beam : beams) {
-        if (selectedIds.count(beam->id))
-            return beam.get();
-    }
-    return nullptr;
+    return firstSelectedIndexed(*this, beams, beamIndex);
 }
 
 std::vector<Annotation*> Scene::getSelectedAnnotations() const {
-    std::vector<Annotation*> result;
-    for (const auto& ann : annotations) {
-        if (selectedIds.count(ann->id))
-            result.push_back(ann.get());
-    }
-    return result;
+    return selectedIndexed(*this, annotations, annotationIndex);
 }
 
 Annotation* Scene::getSelectedAnnotation() const {
-    for (const auto& ann : annotations) {
-        if (selectedIds.count(ann->id))
-            return ann.get();
-    }
-    return nullptr;
+    return firstSelectedIndexed(*this, annotations, annotationIndex);
 }
 
 void Scene::selectAll() {
     for (const auto& elem : elements)
-        selectedIds.insert(elem->id);
+        setSelected(elem->handle, true);
     for (const auto& beam : beams)
-        selectedIds.insert(beam->id);
+        setSelected(beam->handle, true);
     for (const auto& ann : annotations)
-        selectedIds.insert(ann->id);
+        setSelected(ann->handle, true);
     for (const auto& m : measurements)
-        selectedIds.insert(m->id);
+        setSelected(m->handle, true);
 }
 
 void Scene::addGroup(const Group& group) {
@@ -361,8 +777,13 @@ Group* Scene::getGroup(const std::string& groupId) {
 }
 
 Group* Scene::findGroupContaining(const std::string& objectId) {
+    ObjectHandle handle = findObjectHandle(objectId);
+    return handle != kNoObjectHandle ? findGroupContaining(handle) : nullptr;
+}
+
+Group* Scene::findGroupContaining(ObjectHandle handle) {
     for (auto& g : groups) {
-        if (std::find(g.memberIds.begin(), g.memberIds.end(), objectId) != g.memberIds.end())
+        if (std::find(g.members.begin(), g.members.end(), handle) != g.members.end())
             return &g;
     }
     return nullptr;
@@ -372,8 +793,8 @@ Group Scene::createGroupFromSelection() {
     Group g;
     g.id = Group::generateId();
     g.name = "Group";
-    for (const auto& id : selectedIds)
-        g.memberIds.push_back(id);
+    g.members.reserve(selectionCount);
+    forEachSelected([&g](ObjectHandle handle) { g.members.push_back(handle); });
     groups.push_back(g);
     return g;
 }
@@ -385,9 +806,9 @@ void Scene::dissolveGroup(const std::string& groupId) {
 void Scene::selectGroupMembers(const std::string& groupId, bool additive) {
     Group* g = getGroup(groupId);
     if (!g) return;
-    if (!additive) selectedIds.clear();
-    for (const auto& mid : g->memberIds)
-        selectedIds.insert(mid);
+    if (!additive) deselectAll();
+    for (ObjectHandle member : g->members)
+        setSelected(member, true);
 }
 
 void Scene::addViewPreset(const ViewPreset& preset) {
@@ -2,10 +2,15 @@
 
 #include "elements/element.h"
 #include "camera/camera.h"
+#include "scene/change_journal.h"
+#include "scene/element_components.h"
 #include "scene/group.h"
+#include "scene/traced_rays.h"
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace opticsketch {
@@ -15,6 +20,37 @@ class Beam;
 class Annotation;
 class Measurement;
 
+// Slot of an object within its collection. Slots shift when objects are removed, so a
+// handle is only valid while the scene's layout generation matches; after that, look the
+// id up again.
+struct SceneHandle {
+    SceneObjectKind kind = SceneObjectKind::None;
+    uint32_t index = 0;
+    uint32_t generation = 0;
+    explicit operator bool() const { return kind != SceneObjectKind::None; }
+};
+
+// Editable (non-transform) properties of an element, as captured by a batched edit
+struct ElementEditState {
+    bool visible = true;
+    bool locked = false;
+    bool showLabel = true;
+    int layer = 0;
+    OpticalProperties optics;
+    MaterialProperties material;
+
+    static ElementEditState capture(const Element& elem);
+    void applyTo(Element& elem) const;
+    bool operator==(const ElementEditState& other) const;
+};
+
+// One element's state before and after a batched edit
+struct ElementEdit {
+    std::string id;
+    ElementEditState before;
+    ElementEditState after;
+};
+
 class Scene {
 public:
     Scene();
@@ -23,6 +59,22 @@ public:
     // Add element to scene
     void addElement(std::unique_ptr<Element> element);
 
+    // Bulk insert (paste of large selections): reserves capacity once and makes ids and
+    // labels unique against hashed sets in a single pass instead of a scene scan per
+    // element. Returns the added objects in order. Elements without an id get "element".
+    std::vector<Element*> addElements(std::vector<std::unique_ptr<Element>> batch);
+    std::vector<Beam*> addBeams(std::vector<std::unique_ptr<Beam>> batch);
+    std::vector<Annotation*> addAnnotations(std::vector<std::unique_ptr<Annotation>> batch);
+
+    // Remove every element, beam, annotation and measurement whose id is in 'ids', one
+    // compaction pass per collection. Returns the number of objects removed.
+    size_t removeObjects(const std::unordered_set<std::string>& ids);
+
+    // Move every object of 'from' into this scene (project journal replay). An object
+    // whose id is already here replaces it in its slot and keeps its handle; the rest
+    // are appended. 'from' is left empty; groups and presets are not merged.
+    void mergeObjects(Scene& from);
+
     // Remove element by ID
     bool removeElement(const std::string& id);
 
@@ -32,6 +84,28 @@ public:
     // Get all elements
     const std::vector<std::unique_ptr<Element>>& getElements() const { return elements; }
 
+    // Changes whenever an element, beam, annotation or measurement is added or removed, so
+    // views can cache lists of objects and rebuild them only when this moves
+    uint64_t getStructureRevision() const { return structureRevision; }
+
+    // Change journal. Adds and removes (including clear and merge) are recorded by the
+    // scene itself, as are closed batched edits; code that edits an object in place
+    // reports it with recordChange(). Element transforms need no report: journalTransforms()
+    // picks up every markTransformDirty() once per frame. Consumers keep a version and
+    // read the journal's changesSince() instead of rescanning the scene.
+    const ChangeJournal& getChangeJournal() const { return journal; }
+    uint64_t getChangeVersion() const { return journal.version(); }
+    void recordChange(const std::string& id, SceneChange change);
+    void recordChange(ObjectHandle handle, SceneChange change);
+    // Record Transformed for each element whose transform or array changed since it was
+    // last journaled; call once per frame, before the journal's consumers run
+    void journalTransforms();
+
+    // Hot element data in contiguous arrays, brought up to date with the elements first.
+    // Only rows whose transform, bounds or array changed are rebuilt, so each consumer
+    // (renderer, tracer) can sync once per pass for the cost of one light scan.
+    const ElementComponents& syncElementComponents();
+
     // Beam management
     void addBeam(std::unique_ptr<Beam> beam);
     bool removeBeam(const std::string& id);
@@ -56,10 +130,25 @@ public:
     // Clear scene
     void clear();
 
-    // Remove all traced beams (beams where isTraced==true)
+    // Independent copy of the scene contents (ids preserved) for background serialization,
+    // or with 'withSelection' for drawing on the render thread. Imported mesh assets are
+    // immutable and shared, not copied.
+    std::unique_ptr<Scene> snapshot(bool withSelection = false) const;
+
+    // Ray tracer output (separate from user-drawn beams)
+    TracedRayBuffer& getTracedRays() { return tracedRays; }
+    const TracedRayBuffer& getTracedRays() const { return tracedRays; }
+
+    // Remove all traced rays
     void clearTracedBeams();
 
-    // Selection — supports multi-select via unordered_set of IDs
+    // Remove traced rays emitted by one source element
+    void clearTracedBeams(const std::string& sourceId);
+
+    // Number of traced ray segments
+    size_t getTracedBeamCount() const { return tracedRays.size(); }
+
+    // Selection — multi-select as one bit per object handle
     // additive=false clears selection first; additive=true adds to existing selection
     void selectElement(const std::string& id, bool additive = false);
     void selectBeam(const std::string& id, bool additive = false);
@@ -67,7 +156,22 @@ public:
     void toggleSelect(const std::string& id);
     void deselectAll();
     bool isSelected(const std::string& id) const;
-    size_t getSelectionCount() const { return selectedIds.size(); }
+    // Per-object queries in draw loops: a bit test, no id hashing
+    bool isSelected(ObjectHandle handle) const {
+        return handle < selectionBits.size() * 64 && ((selectionBits[handle / 64] >> (handle % 64)) & 1u);
+    }
+    size_t getSelectionCount() const { return selectionCount; }
+    // Changes whenever the set of selected objects does
+    uint64_t getSelectionRevision() const { return selectionRevision; }
+    // fn(handle) for every selected object, in handle order
+    template <typename Fn>
+    void forEachSelected(Fn&& fn) const {
+        for (size_t w = 0; w < selectionBits.size(); w++) {
+            uint64_t word = selectionBits[w];
+            for (uint32_t bit = 0; word != 0; bit++, word >>= 1)
+                if (word & 1u) fn(static_cast<ObjectHandle>(w * 64 + bit));
+        }
+    }
 
     // Get all selected elements/beams/annotations
     std::vector<Element*> getSelectedElements() const;
@@ -88,23 +192,103 @@ public:
     Group* getGroup(const std::string& groupId);
     const std::vector<Group>& getGroups() const { return groups; }
     Group* findGroupContaining(const std::string& objectId);
+    Group* findGroupContaining(ObjectHandle handle);
     Group createGroupFromSelection();
     void dissolveGroup(const std::string& groupId);
     void selectGroupMembers(const std::string& groupId, bool additive = false);
 
+    // Dense handle of an id (assigning the next one if the id is new, so groups can
+    // name objects that are added later), and back
+    ObjectHandle getObjectHandle(const std::string& id);
+    ObjectHandle findObjectHandle(const std::string& id) const;   // kNoObjectHandle if unknown
+    const std::string& getObjectId(ObjectHandle handle) const { return handleIds[handle]; }
+
+    // O(1) id lookup across all object kinds (kind None if the id is unknown)
+    SceneHandle findHandle(const std::string& id) const;
+    bool isHandleValid(const SceneHandle& handle) const {
+        return handle && handle.generation == layoutGeneration;
+    }
+    uint32_t getLayoutGeneration() const { return layoutGeneration; }
+    // Resolve a valid handle of the matching kind, nullptr otherwise
+    Element* getElement(const SceneHandle& handle) const;
+    Beam* getBeam(const SceneHandle& handle) const;
+    Annotation* getAnnotation(const SceneHandle& handle) const;
+    Measurement* getMeasurement(const SceneHandle& handle) const;
+
+    // Batched property edits across many elements (multi-selection panels). Open an edit
+    // on the targets, change fields through applyElementEdit() as often as needed (e.g.
+    // every slider tick), then close it: endElementEdit() returns one record per element
+    // that changed, for a single undo entry, and bumps the edit revision once. Work that
+    // reacts to property changes, such as auto-trace, waits while an edit is open.
+    void beginElementEdit(const std::vector<Element*>& targets);
+    template <typename Fn>
+    void applyElementEdit(Fn&& fn) {
+        for (size_t i = 0; i < editIds.size(); i++) {
+            Element* elem = isHandleValid(editHandles[i]) ? getElement(editHandles[i]) : getElement(editIds[i]);
+            if (elem) fn(*elem);
+        }
+    }
+    std::vector<ElementEdit> endElementEdit();
+    bool isElementEditOpen() const { return editOpen; }
+    uint64_t getEditRevision() const { return editRevision; }
+
     // View presets
     void addViewPreset(const ViewPreset& preset);
     void removeViewPreset(size_t index);
     const std::vector<ViewPreset>& getViewPresets() const { return viewPresets; }
 
 private:
+    // Drop an object from the selection and from any group (auto-dissolving empty groups)
+    void forgetObject(ObjectHandle handle);
+    void setSelected(ObjectHandle handle, bool selected);
+    // Select one object; a non-additive select takes its whole group along
+    void selectWithGroup(ObjectHandle handle, bool additive);
+    void journalChange(SceneObjectKind kind, ObjectHandle handle, SceneChange change);
+    // Rebuild the instance rows and array bounds of one slot, within its existing run
+    void writeComponentInstances(size_t slot);
+
     std::vector<std::unique_ptr<Element>> elements;
     std::vector<std::unique_ptr<Beam>> beams;
+    TracedRayBuffer tracedRays;
     std::vector<std::unique_ptr<Annotation>> annotations;
     std::vector<std::unique_ptr<Measurement>> measurements;
-    std::unordered_set<std::string> selectedIds;
     std::vector<Group> groups;
     std::vector<ViewPreset> viewPresets;
+
+    // id -> position in the matching vector; kept in sync by add/remove/clear
+    std::unordered_map<std::string, uint32_t> elementIndex;
+    std::unordered_map<std::string, uint32_t> beamIndex;
+    std::unordered_map<std::string, uint32_t> annotationIndex;
+    std::unordered_map<std::string, uint32_t> measurementIndex;
+    // id <-> dense handle; never shrinks, so handles stay put across remove, undo and clear
+    std::unordered_map<std::string, ObjectHandle> handleIndex;
+    std::vector<std::string> handleIds;
+    std::vector<uint64_t> selectionBits;
+    size_t selectionCount = 0;
+    uint64_t selectionRevision = 0;
+    uint32_t layoutGeneration = 0;   // bumped whenever slots shift (remove, clear)
+    uint64_t structureRevision = 0;  // bumped on every add, remove and clear
+    ChangeJournal journal;
+    // Per handle: element transform generation + 1 as of its last journal entry (0 = none)
+    std::vector<unsigned int> journaledTransforms;
+
+    // Derived element components and what each row was built from
+    struct ComponentKey {
+        unsigned int transformGeneration = 0;
+        glm::vec3 boundsMin{0.0f};
+        glm::vec3 boundsMax{0.0f};
+    };
+    ElementComponents components;
+    std::vector<ComponentKey> componentKeys;
+    uint64_t componentsRevision = UINT64_MAX;   // structure revision the rows were laid out for
+
+    // Open batched edit: targets (handles re-resolved by id if slots shifted meanwhile)
+    // and their state when it was opened
+    bool editOpen = false;
+    std::vector<std::string> editIds;
+    std::vector<SceneHandle> editHandles;
+    std::vector<ElementEditState> editBefore;
+    uint64_t editRevision = 0;
 };
 
 } // namespace opticsketch
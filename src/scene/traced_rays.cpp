@@ -0,0 +1,124 @@
+#include "scene/traced_rays.h"
+#include <algorithm>
+
+namespace opticsketch {
+
+void TracedRayBuffer::clear() {
+    start.clear();
+    end.clear();
+    color.clear();
+    intensity.clear();
+    pathStart.clear();
+    source.clear();
+    sourceIds.clear();
+    hits.clear();
+    gpuLineBuffer = 0;
+    gpuLineVertices = 0;
+    revision++;
+}
+
+void TracedRayBuffer::reserve(size_t count) {
+    start.reserve(count);
+    end.reserve(count);
+    color.reserve(count);
+    intensity.reserve(count);
+    pathStart.reserve(count);
+    source.reserve(count);
+}
+
+int TracedRayBuffer::sourceIndex(const std::string& sourceId) {
+    auto it = std::find(sourceIds.begin(), sourceIds.end(), sourceId);
+    if (it != sourceIds.end()) return static_cast<int>(it - sourceIds.begin());
+    sourceIds.push_back(sourceId);
+    return static_cast<int>(sourceIds.size()) - 1;
+}
+
+void TracedRayBuffer::add(const glm::vec3& s, const glm::vec3& e, const glm::vec3& c, float i, int sourceIdx,
+                          float path) {
+    start.push_back(s);
+    end.push_back(e);
+    color.push_back(c);
+    intensity.push_back(i);
+    pathStart.push_back(path);
+    source.push_back(sourceIdx);
+    revision++;
+}
+
+void TracedRayBuffer::removeSource(const std::string& sourceId) {
+    auto it = std::find(sourceIds.begin(), sourceIds.end(), sourceId);
+    if (it == sourceIds.end()) return;
+    int idx = static_cast<int>(it - sourceIds.begin());
+
+    // Compact in place; the id slot is kept so other indices stay valid
+    size_t out = 0;
+    for (size_t i = 0; i < size(); i++) {
+        if (source[i] == idx) continue;
+        if (out != i) {
+            start[out] = start[i];
+            end[out] = end[i];
+            color[out] = color[i];
+            intensity[out] = intensity[i];
+            pathStart[out] = pathStart[i];
+            source[out] = source[i];
+        }
+        out++;
+    }
+    start.resize(out);
+    end.resize(out);
+    color.resize(out);
+    intensity.resize(out);
+    pathStart.resize(out);
+    source.resize(out);
+    hits.removeSource(idx);
+    revision++;
+}
+
+void DetectorHitBuffer::clear() {
+    local.clear();
+    intensity.clear();
+    wavelength.clear();
+    detector.clear();
+    source.clear();
+    detectorIds.clear();
+}
+
+int DetectorHitBuffer::detectorIndex(const std::string& detectorId) {
+    auto it = std::find(detectorIds.begin(), detectorIds.end(), detectorId);
+    if (it != detectorIds.end()) return static_cast<int>(it - detectorIds.begin());
+    detectorIds.push_back(detectorId);
+    return static_cast<int>(detectorIds.size()) - 1;
+}
+
+void DetectorHitBuffer::add(const glm::vec3& localPos, float i, float lambda, int detectorIdx, int sourceIdx) {
+    local.push_back(localPos);
+    intensity.push_back(i);
+    wavelength.push_back(lambda);
+    detector.push_back(detectorIdx);
+    source.push_back(sourceIdx);
+}
+
+void DetectorHitBuffer::removeSource(int sourceIdx) {
+    size_t out = 0;
+    for (size_t i = 0; i < size(); i++) {
+        if (source[i] == sourceIdx) continue;
+        if (out != i) {
+            local[out] = local[i];
+            intensity[out] = intensity[i];
+            wavelength[out] = wavelength[i];
+            detector[out] = detector[i];
+            source[out] = source[i];
+        }
+        out++;
+    }
+    local.resize(out);
+    intensity.resize(out);
+    wavelength.resize(out);
+    detector.resize(out);
+    source.resize(out);
+}
+
+size_t TracedRayBuffer::countForSource(int sourceIdx) const {
+    return static_cast<size_t>(std::count(source.begin(), source.end(), sourceIdx));
+}
+
+} // namespace opticsketch
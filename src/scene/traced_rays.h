@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace opticsketch {
+
+// Ray tracer output, kept apart from user-drawn Beam objects. One entry per traced
+// segment, stored as parallel arrays so consumers can stream through them.
+// Where traced rays landed on Detector and Screen elements, filled alongside the segments.
+// Positions are in the hit element's local frame, so a spot does not move with the part.
+struct DetectorHitBuffer {
+    std::vector<glm::vec3> local;
+    std::vector<float> intensity;
+    std::vector<float> wavelength;          // meters
+    std::vector<int> detector;              // index into detectorIds
+    std::vector<int> source;                // index into TracedRayBuffer::sourceIds
+    std::vector<std::string> detectorIds;
+
+    size_t size() const { return local.size(); }
+    bool empty() const { return local.empty(); }
+
+    void clear();
+
+    // Index of a detector id in detectorIds, adding it if needed
+    int detectorIndex(const std::string& detectorId);
+
+    void add(const glm::vec3& localPos, float i, float lambda, int detectorIdx, int sourceIdx);
+
+    // Remove every hit of rays emitted by the source at sourceIdx
+    void removeSource(int sourceIdx);
+};
+
+struct TracedRayBuffer {
+    std::vector<glm::vec3> start;
+    std::vector<glm::vec3> end;
+    std::vector<glm::vec3> color;
+    std::vector<float> intensity;
+    std::vector<float> pathStart;           // mm of optical path from the source to 'start'
+                                            // (-1 = unknown: loaded or read back from the GPU)
+    std::vector<int> source;                // index into sourceIds
+    std::vector<std::string> sourceIds;     // ids of the emitting source elements
+    uint32_t revision = 0;                  // bumped by clear/add/removeSource, for caches
+    DetectorHitBuffer hits;                 // CPU traces only; cleared and pruned with the segments
+
+    // GPU trace backend: the segments live in a GL buffer of line vertices (position and
+    // color, as in the viewport's line batches) that is drawn as-is, and the arrays above
+    // stay empty until the tracer reads them back (exports, saves). The buffer is owned by
+    // the tracer; clear() drops it.
+    uint32_t gpuLineBuffer = 0;
+    uint32_t gpuLineVertices = 0;
+    bool onGpu() const { return gpuLineBuffer != 0; }
+
+    size_t size() const { return start.size(); }
+    bool empty() const { return start.empty(); }
+
+    void clear();
+    void reserve(size_t count);
+
+    // Index of a source id in sourceIds, adding it if needed
+    int sourceIndex(const std::string& sourceId);
+
+    void add(const glm::vec3& s, const glm::vec3& e, const glm::vec3& c, float i, int sourceIdx,
+             float path = -1.0f);
+
+    // Remove every segment emitted by one source
+    void removeSource(const std::string& sourceId);
+
+    // Number of segments emitted by the source at sourceIdx
+    size_t countForSource(int sourceIdx) const;
+};
+
+} // namespace opticsketch
@@ -45,7 +45,7 @@ struct SceneStyle {
     // Bloom (Presentation mode)
     float bloomThreshold = 0.3f;
     float bloomIntensity = 1.2f;
-    int bloomBlurPasses = 5;
+    int bloomBlurPasses = 5;     // bloom radius: pyramid levels blurred (1-8)
 
     // Snapping
     bool snapToGrid = false;
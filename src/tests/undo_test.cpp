@@ -0,0 +1,81 @@
+// OpticSketchUndoTest: checks of the undo history's bookkeeping (eviction under the
+// command and memory caps). Exits non-zero on the first failed check; run by ctest.
+#include <cstdio>
+#include <memory>
+#include "undo/undo.h"
+#include "scene/scene.h"
+
+using namespace opticsketch;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Adds 'step' to a shared counter on redo, takes it back on undo
+class CountCmd : public UndoCommand {
+public:
+    CountCmd(int& counter, int step) : counter(counter), step(step) {}
+    void undo(Scene&) override { counter -= step; }
+    void redo(Scene&) override { counter += step; }
+    size_t memoryBytes() const override { return sizeof(*this); }
+private:
+    int& counter;
+    int step;
+};
+
+static void pushCount(UndoStack& stack, Scene& scene, int& counter, int step) {
+    auto cmd = std::make_unique<CountCmd>(counter, step);
+    cmd->redo(scene);
+    stack.push(std::move(cmd));
+}
+
+// Lowering the caps with everything undone keeps the redo history intact
+static void testCapAfterUndoAll() {
+    Scene scene;
+    UndoStack stack;
+    stack.setMergeWindow(0.0);
+    int counter = 0;
+    for (int i = 1; i <= 4; i++) pushCount(stack, scene, counter, i);
+    CHECK(counter == 10);
+    while (stack.canUndo()) stack.undo(scene);
+    CHECK(counter == 0);
+
+    stack.setMaxCommands(2);
+    stack.setMaxBytes(sizeof(CountCmd));
+    CHECK(!stack.canUndo());
+    CHECK(stack.canRedo());
+    CHECK(stack.getCommandCount() == 4);
+    while (stack.canRedo()) stack.redo(scene);
+    CHECK(counter == 10);
+    CHECK(stack.canUndo());
+}
+
+// Normal eviction drops the oldest undo entries and keeps undoing the rest
+static void testCapEvictsOldest() {
+    Scene scene;
+    UndoStack stack;
+    stack.setMergeWindow(0.0);
+    stack.setMaxCommands(2);
+    int counter = 0;
+    for (int i = 1; i <= 4; i++) pushCount(stack, scene, counter, i);
+    CHECK(stack.getCommandCount() == 2);
+    stack.undo(scene);
+    stack.undo(scene);
+    CHECK(counter == 3);     // 1 and 2 were evicted
+    CHECK(!stack.canUndo());
+    CHECK(stack.canRedo());
+}
+
+int main() {
+    testCapAfterUndoAll();
+    testCapEvictsOldest();
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    else std::printf("undo tests passed\n");
+    return failures ? 1 : 0;
+}
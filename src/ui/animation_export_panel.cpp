@@ -3,19 +3,27 @@
 #include "scene/scene.h"
 #include "style/scene_style.h"
 #include "render/beam.h"
+#include "jobs/job_system.h"
 #include <tinyfiledialogs.h>
 #include <sstream>
 #include <cstring>
+#include <memory>
 
 namespace opticsketch {
 
 void AnimationExportPanel::render(Viewport* viewport, Scene* scene, SceneStyle* style) {
     if (!visible) return;
 
-    // Check ffmpeg on first render
+    // Check ffmpeg on first render; the probe shells out, so it runs as a job
     if (!checkedFFmpeg) {
-        ffmpegAvailable = isFFmpegAvailable();
         checkedFFmpeg = true;
+        auto available = std::make_shared<bool>(false);
+        JobSystem::instance().submit("Looking for ffmpeg", JobPriority::Low,
+            [available](JobContext&) { *available = isFFmpegAvailable(); },
+            [this, available]() {
+                ffmpegAvailable = *available;
+                ffmpegProbed = true;
+            });
     }
 
     ImGui::SetNextWindowSize(ImVec2(420, 480), ImGuiCond_FirstUseEver);
@@ -133,11 +141,16 @@ void AnimationExportPanel::render(Viewport* viewport, Scene* scene, SceneStyle*
         if (ImGui::Combo("Format", &formatIdx, formatNames, 3)) {
             settings.format = static_cast<AnimationOutputFormat>(formatIdx);
         }
+        if (settings.format != AnimationOutputFormat::ImageSequence) {
+            // Off = write temporary PNG frames and assemble them afterwards
+            ImGui::Checkbox("Stream to ffmpeg", &settings.streamToFFmpeg);
+        }
 
-        if (settings.format == AnimationOutputFormat::MP4 && !ffmpegAvailable) {
+        if (settings.format != AnimationOutputFormat::ImageSequence && !ffmpegProbed) {
+            ImGui::TextDisabled("Looking for ffmpeg...");
+        } else if (settings.format == AnimationOutputFormat::MP4 && !ffmpegAvailable) {
             ImGui::TextColored(ImVec4(1, 0.5f, 0, 1), "ffmpeg not found - MP4 unavailable");
-        }
-        if (settings.format == AnimationOutputFormat::GIF && !ffmpegAvailable) {
+        } else if (settings.format == AnimationOutputFormat::GIF && !ffmpegAvailable) {
             ImGui::TextColored(ImVec4(1, 0.5f, 0, 1), "ffmpeg not found - GIF may be unavailable");
         }
 
@@ -162,8 +175,11 @@ void AnimationExportPanel::render(Viewport* viewport, Scene* scene, SceneStyle*
         ImGui::Separator();
         ImGui::Spacing();
 
+        // The previous export may still be encoding into the same temporary folder
+        if (exportState.assembleJob) ImGui::Text("%s", exportState.statusText.c_str());
+
         // Export button
-        bool canExport = !settings.outputPath.empty();
+        bool canExport = !settings.outputPath.empty() && !exportState.assembleJob;
         if (settings.format == AnimationOutputFormat::MP4 && !ffmpegAvailable) canExport = false;
 
         if (!canExport) ImGui::BeginDisabled();
@@ -180,7 +196,7 @@ bool AnimationExportPanel::advanceExport(Viewport* viewport, Scene* scene, Scene
     if (!exportState.active) return false;
 
     if (exportState.cancelled || !advanceAnimationFrame(exportState, settings, viewport, scene, style)) {
-        endAnimationExport(exportState, settings, viewport, scene);
+        endAnimationExport(exportState, settings, viewport);
         return false;
     }
     return true;
@@ -28,7 +28,8 @@ private:
     AnimationExportSettings settings;
     AnimationExportState exportState;
     bool ffmpegAvailable = false;
-    bool checkedFFmpeg = false;
+    bool checkedFFmpeg = false;     // probe job submitted
+    bool ffmpegProbed = false;      // and answered
 };
 
 } // namespace opticsketch
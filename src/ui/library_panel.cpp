@@ -11,12 +11,6 @@ LibraryPanel::LibraryPanel() {
     loadBuiltinLibrary();
 }
 
-void LibraryPanel::setThumbnailTexture(int typeIndex, GLuint texId) {
-    if (typeIndex >= 0 && typeIndex < 14) {
-        thumbnailTextures[typeIndex] = texId;
-    }
-}
-
 void LibraryPanel::loadBuiltinLibrary() {
     items = {
         // Sources
@@ -262,7 +256,8 @@ void LibraryPanel::renderElementItem(const LibraryItem& item) {
     
     // Thumbnail or fallback icon - centered at top
     int typeIdx = static_cast<int>(item.type);
-    GLuint thumbTex = (typeIdx >= 0 && typeIdx < 14) ? thumbnailTextures[typeIdx] : 0;
+    bool onScreen = ImGui::IsRectVisible(screenPos, ImVec2(screenPos.x + cardSize.x, screenPos.y + cardSize.y));
+    GLuint thumbTex = (thumbnailProvider && onScreen) ? thumbnailProvider(typeIdx) : 0;
     if (thumbTex != 0) {
         float thumbSize = cardSize.y * 0.5f;
         ImVec2 thumbMin(screenPos.x + (cardSize.x - thumbSize) * 0.5f,
@@ -39,8 +39,11 @@ public:
         onElementDrag = callback;
     }
 
-    // Set 3D thumbnail texture for an element type
-    void setThumbnailTexture(int typeIndex, GLuint texId);
+    // Source of 3D thumbnail textures by element type (0 = not ready, icon is shown).
+    // Only asked for cards that are on screen, so thumbnails are produced as the panel scrolls.
+    void setThumbnailProvider(std::function<GLuint(int)> provider) {
+        thumbnailProvider = provider;
+    }
 
 private:
     bool visible = true;
@@ -49,8 +52,7 @@ private:
     std::string selectedCategory = "All";
     float gridSize = 80.0f;
 
-    // 3D thumbnail textures (indexed by ElementType)
-    GLuint thumbnailTextures[14] = {};
+    std::function<GLuint(int)> thumbnailProvider;
 
     std::function<void(ElementType, const std::string&)> onElementDrag;
 
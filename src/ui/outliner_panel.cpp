@@ -31,217 +31,245 @@ static const char* elementTypeLabel(ElementType type) {
     }
 }
 
-// Item types in the flat list
-enum class OutlinerItemType { Element, Beam, Annotation, Measurement };
-
-struct OutlinerItem {
-    std::string id;
-    OutlinerItemType type;
-};
-
-void OutlinerPanel::render(Scene* scene) {
-    if (!visible || !scene) return;
-
-    if (!ImGui::Begin("Outliner", &visible, ImGuiWindowFlags_None)) {
-        ImGui::End();
-        return;
+// Draw the selection highlight the same way for every kind of object row
+static bool selectableRow(const char* label, bool isSelected) {
+    if (isSelected) {
+        ImGui::PushStyleColor(ImGuiCol_Header, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
+        ImGui::PushStyleColor(ImGuiCol_HeaderHovered, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
     }
+    bool clicked = ImGui::Selectable(label, isSelected, 0, ImVec2(0, 0));
+    if (isSelected) ImGui::PopStyleColor(2);
+    return clicked;
+}
 
-    ImGui::TextUnformatted("Scene");
-    ImGui::Separator();
-
+void OutlinerPanel::rebuildRows(Scene* scene) {
+    rows.clear();
     const auto& elements = scene->getElements();
     const auto& beams = scene->getBeams();
     const auto& annotations = scene->getAnnotations();
     const auto& measurements = scene->getMeasurements();
+    const TracedRayBuffer& traced = scene->getTracedRays();
+    rows.reserve(elements.size() + beams.size() + annotations.size() + measurements.size() + 1);
 
-    if (elements.empty() && beams.empty() && annotations.empty() && measurements.empty()) {
-        ImGui::TextDisabled("(no objects)");
-        lastClickedIndex = -1;
-        ImGui::End();
-        return;
-    }
+    auto addObjects = [&](const auto& items, RowType type) {
+        for (size_t i = 0; i < items.size(); i++)
+            if (items[i]) rows.push_back({type, static_cast<uint32_t>(i), 0});
+    };
+    addObjects(elements, RowType::Element);
+    addObjects(beams, RowType::Beam);
+    addObjects(annotations, RowType::Annotation);
+    addObjects(measurements, RowType::Measurement);
 
-    // Build flat item list for range selection
-    std::vector<OutlinerItem> items;
-    items.reserve(elements.size() + beams.size() + annotations.size() + measurements.size());
-    for (const auto& e : elements)      if (e) items.push_back({e->id, OutlinerItemType::Element});
-    for (const auto& b : beams)         if (b) items.push_back({b->id, OutlinerItemType::Beam});
-    for (const auto& a : annotations)   if (a) items.push_back({a->id, OutlinerItemType::Annotation});
-    for (const auto& m : measurements)  if (m) items.push_back({m->id, OutlinerItemType::Measurement});
-
-    // Clamp lastClickedIndex if scene changed
-    if (lastClickedIndex >= static_cast<int>(items.size())) lastClickedIndex = -1;
-
-    // Helper: select a single item by its OutlinerItem (additive or not)
-    auto selectItem = [&](const OutlinerItem& item, bool additive) {
-        switch (item.type) {
-            case OutlinerItemType::Element:     scene->selectElement(item.id, additive); break;
-            case OutlinerItemType::Beam:        scene->selectBeam(item.id, additive); break;
-            case OutlinerItemType::Annotation:  scene->selectAnnotation(item.id, additive); break;
-            case OutlinerItemType::Measurement: scene->selectMeasurement(item.id, additive); break;
+    // Traced rays fold into one header, then one group per source; segments are listed
+    // only for unfolded sources
+    if (!traced.empty()) {
+        rows.push_back({RowType::TracedHeader, 0, static_cast<uint32_t>(traced.size())});
+        if (tracedExpanded) {
+            const size_t sourceCount = traced.sourceIds.size();
+            std::vector<uint32_t> counts(sourceCount, 0);
+            std::vector<std::vector<uint32_t>> segments(sourceCount);
+            std::vector<bool> expanded(sourceCount, false);
+            for (size_t si = 0; si < sourceCount; si++)
+                expanded[si] = expandedSources.count(traced.sourceIds[si]) > 0;
+            for (size_t i = 0; i < traced.size(); i++) {
+                int si = traced.source[i];
+                if (si < 0 || static_cast<size_t>(si) >= sourceCount) continue;
+                counts[si]++;
+                if (expanded[si]) segments[si].push_back(static_cast<uint32_t>(i));
+            }
+            for (size_t si = 0; si < sourceCount; si++) {
+                if (counts[si] == 0) continue;
+                rows.push_back({RowType::TracedSource, static_cast<uint32_t>(si), counts[si]});
+                for (uint32_t seg : segments[si]) rows.push_back({RowType::TracedSegment, seg, 0});
+            }
         }
-    };
+    }
 
-    int flatIndex = 0;
+    cachedScene = scene;
+    cachedStructure = scene->getStructureRevision();
+    cachedTraced = traced.revision;
+    rowsDirty = false;
+    if (lastClickedIndex >= static_cast<int>(rows.size())) lastClickedIndex = -1;
+}
 
-    // --- Elements ---
-    for (const auto& elem : elements) {
-        if (!elem) continue;
-        int myIndex = flatIndex++;
+void OutlinerPanel::renderRow(Scene* scene, int rowIndex) {
+    const Row& row = rows[rowIndex];
+    const TracedRayBuffer& traced = scene->getTracedRays();
 
-        bool isSelected = scene->isSelected(elem->id);
-        if (isSelected) {
-            ImGui::PushStyleColor(ImGuiCol_Header, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
-            ImGui::PushStyleColor(ImGuiCol_HeaderHovered, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
+    // Folding rows: the open state lives here, so a toggle means the row list must change
+    if (row.type == RowType::TracedHeader) {
+        char header[64];
+        snprintf(header, sizeof(header), "Traced Rays (%u)##traced_header", row.count);
+        ImGui::SetNextItemOpen(tracedExpanded, ImGuiCond_Always);
+        bool open = ImGui::TreeNodeEx(header, ImGuiTreeNodeFlags_NoTreePushOnOpen);
+        if (open != tracedExpanded) {
+            tracedExpanded = open;
+            rowsDirty = true;
         }
-        bool clicked = ImGui::Selectable(
-            elem->label.empty() ? elem->id.c_str() : elem->label.c_str(),
-            isSelected, 0, ImVec2(0, 0)
-        );
-        if (isSelected) ImGui::PopStyleColor(2);
-
-        if (clicked) {
-            const ImGuiIO& io = ImGui::GetIO();
-            if (io.KeyShift && lastClickedIndex >= 0 && lastClickedIndex < static_cast<int>(items.size())) {
-                // Range select: select all items between lastClicked and current
-                int lo = std::min(lastClickedIndex, myIndex);
-                int hi = std::max(lastClickedIndex, myIndex);
-                scene->deselectAll();
-                for (int i = lo; i <= hi; i++) selectItem(items[i], true);
-            } else if (io.KeyCtrl) {
-                scene->toggleSelect(elem->id);
+        return;
+    }
+    if (row.type == RowType::TracedSource || row.type == RowType::TracedSegment) {
+        int si = row.type == RowType::TracedSource ? static_cast<int>(row.index)
+               : (row.index < traced.size() ? traced.source[row.index] : -1);
+        if (si < 0 || static_cast<size_t>(si) >= traced.sourceIds.size()) return;
+        const std::string& sourceId = traced.sourceIds[si];
+        Element* source = scene->getElement(sourceId);
+
+        bool clicked = false;
+        if (row.type == RowType::TracedSource) {
+            const char* name = (source && !source->label.empty()) ? source->label.c_str() : sourceId.c_str();
+            char rowLabel[160];
+            snprintf(rowLabel, sizeof(rowLabel), "%s: %u segments##traced_%d", name, row.count, si);
+            bool wasOpen = expandedSources.count(sourceId) > 0;
+            ImGui::Indent();
+            ImGui::SetNextItemOpen(wasOpen, ImGuiCond_Always);
+            bool open = ImGui::TreeNodeEx(rowLabel, ImGuiTreeNodeFlags_NoTreePushOnOpen | ImGuiTreeNodeFlags_OpenOnArrow);
+            ImGui::Unindent();
+            if (open != wasOpen) {
+                if (open) expandedSources.insert(sourceId);
+                else expandedSources.erase(sourceId);
+                rowsDirty = true;
             } else {
-                scene->selectElement(elem->id);
+                clicked = ImGui::IsItemClicked();
             }
-            lastClickedIndex = myIndex;
-        }
-
-        if (ImGui::IsItemHovered()) {
-            ImGui::BeginTooltip();
-            ImGui::Text("%s", elem->label.c_str());
-            ImGui::TextDisabled("%s | %s", elementTypeLabel(elem->type), elem->id.c_str());
-            ImGui::EndTooltip();
+        } else {
+            char rowLabel[96];
+            snprintf(rowLabel, sizeof(rowLabel), "Segment %u (I %.2f)##seg_%u",
+                     row.index, traced.intensity[row.index], row.index);
+            ImGui::Indent(ImGui::GetStyle().IndentSpacing * 2.0f);
+            clicked = ImGui::Selectable(rowLabel, false);
+            ImGui::Unindent(ImGui::GetStyle().IndentSpacing * 2.0f);
         }
+        // Traced segments are read-only; clicking selects the source that emitted them
+        if (clicked && source) scene->selectElement(sourceId);
+        return;
     }
 
-    // --- Beams ---
-    for (const auto& beam : beams) {
-        if (!beam) continue;
-        int myIndex = flatIndex++;
-
-        bool isSelected = scene->isSelected(beam->id);
-        if (isSelected) {
-            ImGui::PushStyleColor(ImGuiCol_Header, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
-            ImGui::PushStyleColor(ImGuiCol_HeaderHovered, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
-        }
-        bool clicked = ImGui::Selectable(
-            beam->label.empty() ? beam->id.c_str() : beam->label.c_str(),
-            isSelected, 0, ImVec2(0, 0)
-        );
-        if (isSelected) ImGui::PopStyleColor(2);
-
-        if (clicked) {
-            const ImGuiIO& io = ImGui::GetIO();
-            if (io.KeyShift && lastClickedIndex >= 0 && lastClickedIndex < static_cast<int>(items.size())) {
-                int lo = std::min(lastClickedIndex, myIndex);
-                int hi = std::max(lastClickedIndex, myIndex);
-                scene->deselectAll();
-                for (int i = lo; i <= hi; i++) selectItem(items[i], true);
-            } else if (io.KeyCtrl) {
-                scene->toggleSelect(beam->id);
-            } else {
-                scene->selectBeam(beam->id);
+    // Scene objects: slots are valid because the rows were built for this structure
+    const std::string* id = nullptr;
+    ObjectHandle handle = kNoObjectHandle;
+    const std::string* label = nullptr;
+    char detail[96] = "";
+    char measLabel[128];
+    const char* display = nullptr;
+    switch (row.type) {
+        case RowType::Element: {
+            const Element* elem = scene->getElements()[row.index].get();
+            id = &elem->id;
+            handle = elem->handle;
+            label = &elem->label;
+            snprintf(detail, sizeof(detail), "%s | %s", elementTypeLabel(elem->type), elem->id.c_str());
+            if (!elem->array.isSingle()) {
+                // Arrays read "label (x24)"
+                snprintf(measLabel, sizeof(measLabel), "%s (x%d)",
+                         elem->label.empty() ? elem->id.c_str() : elem->label.c_str(), elem->getInstanceCount());
+                display = measLabel;
             }
-            lastClickedIndex = myIndex;
+            break;
         }
-
-        if (ImGui::IsItemHovered()) {
-            ImGui::BeginTooltip();
-            ImGui::Text("%s", beam->label.c_str());
-            ImGui::TextDisabled("Beam | %s", beam->id.c_str());
-            ImGui::EndTooltip();
+        case RowType::Beam: {
+            const Beam* beam = scene->getBeams()[row.index].get();
+            id = &beam->id;
+            handle = beam->handle;
+            label = &beam->label;
+            snprintf(detail, sizeof(detail), "Beam | %s", beam->id.c_str());
+            break;
+        }
+        case RowType::Annotation: {
+            const Annotation* ann = scene->getAnnotations()[row.index].get();
+            id = &ann->id;
+            handle = ann->handle;
+            label = &ann->label;
+            snprintf(detail, sizeof(detail), "Annotation | %s", ann->id.c_str());
+            break;
         }
+        case RowType::Measurement: {
+            const Measurement* meas = scene->getMeasurements()[row.index].get();
+            id = &meas->id;
+            handle = meas->handle;
+            label = &meas->label;
+            snprintf(measLabel, sizeof(measLabel), "%s (%.1f mm)",
+                     meas->label.empty() ? meas->id.c_str() : meas->label.c_str(),
+                     meas->getDistance());
+            display = measLabel;
+            snprintf(detail, sizeof(detail), "Measurement | %s | %.1f mm", meas->id.c_str(), meas->getDistance());
+            break;
+        }
+        default:
+            return;
     }
+    if (!display) display = label->empty() ? id->c_str() : label->c_str();
 
-    // --- Annotations ---
-    for (const auto& ann : annotations) {
-        if (!ann) continue;
-        int myIndex = flatIndex++;
-
-        bool isSelected = scene->isSelected(ann->id);
-        if (isSelected) {
-            ImGui::PushStyleColor(ImGuiCol_Header, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
-            ImGui::PushStyleColor(ImGuiCol_HeaderHovered, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
-        }
-        bool clicked = ImGui::Selectable(
-            ann->label.empty() ? ann->id.c_str() : ann->label.c_str(),
-            isSelected, 0, ImVec2(0, 0)
-        );
-        if (isSelected) ImGui::PopStyleColor(2);
-
-        if (clicked) {
-            const ImGuiIO& io = ImGui::GetIO();
-            if (io.KeyShift && lastClickedIndex >= 0 && lastClickedIndex < static_cast<int>(items.size())) {
-                int lo = std::min(lastClickedIndex, myIndex);
-                int hi = std::max(lastClickedIndex, myIndex);
-                scene->deselectAll();
-                for (int i = lo; i <= hi; i++) selectItem(items[i], true);
-            } else if (io.KeyCtrl) {
-                scene->toggleSelect(ann->id);
-            } else {
-                scene->selectAnnotation(ann->id);
+    // Only visible rows reach here, so the selection lookup is per row on screen
+    bool clicked = selectableRow(display, scene->isSelected(handle));
+    if (clicked) {
+        const ImGuiIO& io = ImGui::GetIO();
+        if (io.KeyShift && lastClickedIndex >= 0 && lastClickedIndex < static_cast<int>(rows.size())) {
+            // Range select: select all objects between lastClicked and current
+            int lo = std::min(lastClickedIndex, rowIndex);
+            int hi = std::max(lastClickedIndex, rowIndex);
+            scene->deselectAll();
+            for (int i = lo; i <= hi; i++) {
+                const Row& r = rows[i];
+                switch (r.type) {
+                    case RowType::Element:     scene->selectElement(scene->getElements()[r.index]->id, true); break;
+                    case RowType::Beam:        scene->selectBeam(scene->getBeams()[r.index]->id, true); break;
+                    case RowType::Annotation:  scene->selectAnnotation(scene->getAnnotations()[r.index]->id, true); break;
+                    case RowType::Measurement: scene->selectMeasurement(scene->getMeasurements()[r.index]->id, true); break;
+                    default: break;
+                }
+            }
+        } else if (io.KeyCtrl) {
+            scene->toggleSelect(*id);
+        } else {
+            switch (row.type) {
+                case RowType::Element:     scene->selectElement(*id); break;
+                case RowType::Beam:        scene->selectBeam(*id); break;
+                case RowType::Annotation:  scene->selectAnnotation(*id); break;
+                default:                   scene->selectMeasurement(*id); break;
             }
-            lastClickedIndex = myIndex;
         }
+        lastClickedIndex = rowIndex;
+    }
 
-        if (ImGui::IsItemHovered()) {
-            ImGui::BeginTooltip();
-            ImGui::Text("%s", ann->label.c_str());
-            ImGui::TextDisabled("Annotation | %s", ann->id.c_str());
-            ImGui::EndTooltip();
-        }
+    if (ImGui::IsItemHovered()) {
+        ImGui::BeginTooltip();
+        ImGui::Text("%s", label->c_str());
+        ImGui::TextDisabled("%s", detail);
+        ImGui::EndTooltip();
     }
+}
 
-    // --- Measurements ---
-    for (const auto& meas : measurements) {
-        if (!meas) continue;
-        int myIndex = flatIndex++;
+void OutlinerPanel::render(Scene* scene) {
+    if (!visible || !scene) return;
 
-        bool isSelected = scene->isSelected(meas->id);
-        if (isSelected) {
-            ImGui::PushStyleColor(ImGuiCol_Header, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
-            ImGui::PushStyleColor(ImGuiCol_HeaderHovered, ImGui::GetStyle().Colors[ImGuiCol_HeaderActive]);
-        }
-        char measLabel[128];
-        snprintf(measLabel, sizeof(measLabel), "%s (%.1f mm)",
-                 meas->label.empty() ? meas->id.c_str() : meas->label.c_str(),
-                 meas->getDistance());
-        bool clicked = ImGui::Selectable(measLabel, isSelected, 0, ImVec2(0, 0));
-        if (isSelected) ImGui::PopStyleColor(2);
-
-        if (clicked) {
-            const ImGuiIO& io = ImGui::GetIO();
-            if (io.KeyShift && lastClickedIndex >= 0 && lastClickedIndex < static_cast<int>(items.size())) {
-                int lo = std::min(lastClickedIndex, myIndex);
-                int hi = std::max(lastClickedIndex, myIndex);
-                scene->deselectAll();
-                for (int i = lo; i <= hi; i++) selectItem(items[i], true);
-            } else if (io.KeyCtrl) {
-                scene->toggleSelect(meas->id);
-            } else {
-                scene->selectMeasurement(meas->id);
-            }
-            lastClickedIndex = myIndex;
-        }
+    if (!ImGui::Begin("Outliner", &visible, ImGuiWindowFlags_None)) {
+        ImGui::End();
+        return;
+    }
 
-        if (ImGui::IsItemHovered()) {
-            ImGui::BeginTooltip();
-            ImGui::Text("%s", meas->label.c_str());
-            ImGui::TextDisabled("Measurement | %s | %.1f mm", meas->id.c_str(), meas->getDistance());
-            ImGui::EndTooltip();
-        }
+    ImGui::TextUnformatted("Scene");
+    ImGui::Separator();
+
+    if (rowsDirty || scene != cachedScene || scene->getStructureRevision() != cachedStructure ||
+        scene->getTracedRays().revision != cachedTraced) {
+        rebuildRows(scene);
+    }
+
+    if (rows.empty()) {
+        ImGui::TextDisabled("(no objects)");
+        lastClickedIndex = -1;
+        ImGui::End();
+        return;
+    }
+
+    // Only the rows in view are submitted
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(rows.size()));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) renderRow(scene, i);
     }
+    clipper.End();
 
     ImGui::End();
 }
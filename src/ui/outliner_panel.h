@@ -1,6 +1,10 @@
 #pragma once
 
 #include <imgui.h>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace opticsketch {
 
@@ -8,6 +12,9 @@ class Scene;
 
 // Maya/Blender-style outliner: flat list of scene objects with multi-select.
 // Click = single select, Ctrl+Click = toggle, Shift+Click = range select.
+// The row list is cached and rebuilt only when the scene's structure (or the traced
+// rays, or a fold) changes; only the rows in view are drawn, so the per-frame cost does
+// not grow with the scene.
 class OutlinerPanel {
 public:
     OutlinerPanel() = default;
@@ -18,8 +25,26 @@ public:
     void setVisible(bool v) { visible = v; }
 
 private:
+    enum class RowType : uint8_t { Element, Beam, Annotation, Measurement, TracedHeader, TracedSource, TracedSegment };
+    struct Row {
+        RowType type;
+        uint32_t index;     // slot in the scene collection, source index, or segment index
+        uint32_t count;     // segments under a traced header/source row
+    };
+
+    void rebuildRows(Scene* scene);
+    void renderRow(Scene* scene, int rowIndex);
+
     bool visible = true;
-    int lastClickedIndex = -1;  // flat index for Shift+click range selection
+    int lastClickedIndex = -1;  // row index for Shift+click range selection
+
+    std::vector<Row> rows;
+    const Scene* cachedScene = nullptr;
+    uint64_t cachedStructure = 0;
+    uint32_t cachedTraced = 0;
+    bool rowsDirty = true;
+    bool tracedExpanded = false;
+    std::unordered_set<std::string> expandedSources;   // traced groups unfolded, by source id
 };
 
 } // namespace opticsketch
@@ -0,0 +1,81 @@
+#include "ui/profiler_panel.h"
+#include "profile/profiler.h"
+#include <tinyfiledialogs.h>
+#include <algorithm>
+
+namespace opticsketch {
+
+void ProfilerPanel::render() {
+    Profiler& profiler = Profiler::instance();
+    // Only record while someone is looking, or a capture is running
+    profiler.setEnabled(visible || profiler.isCapturing());
+    if (!visible) return;
+
+    if (!ImGui::Begin("Profiler", &visible)) {
+        ImGui::End();
+        return;
+    }
+
+#ifndef OPTICSKETCH_PROFILE
+    ImGui::TextWrapped("Profiling is compiled out of this build. Use a Debug build, or configure "
+                       "with -DOPTICSKETCH_PROFILING=ON.");
+#else
+    const Profiler::FrameStats& frame = profiler.lastFrame();
+    profiler.frameHistory(history);
+    float peak = 0.0f;
+    for (float ms : history) peak = std::max(peak, ms);
+
+    ImGui::Text("Frame %.2f ms (%.0f FPS)", frame.frameMs, frame.frameMs > 0.0 ? 1000.0 / frame.frameMs : 0.0);
+    if (!history.empty()) {
+        ImGui::PlotLines("##frames", history.data(), static_cast<int>(history.size()), 0, nullptr,
+                         0.0f, std::max(peak, 1.0f), ImVec2(-1.0f, 60.0f));
+    }
+
+    if (ImGui::CollapsingHeader("CPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (const auto& scope : frame.scopes) {
+            ImGui::Indent(ImGui::GetStyle().IndentSpacing * scope.depth + 1.0f);
+            ImGui::Text("%-24s %7.3f ms", scope.name, scope.ms);
+            ImGui::Unindent(ImGui::GetStyle().IndentSpacing * scope.depth + 1.0f);
+        }
+        if (frame.scopes.empty()) ImGui::TextDisabled("No scopes recorded");
+    }
+
+    if (ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+        double total = 0.0;
+        for (const auto& pass : frame.gpuPasses) {
+            ImGui::Text("%-24s %7.3f ms", pass.name, pass.ms);
+            total += pass.ms;
+        }
+        if (frame.gpuPasses.empty()) ImGui::TextDisabled("No passes recorded");
+        else ImGui::Text("%-24s %7.3f ms", "Total", total);
+    }
+
+    if (ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (int i = 0; i < Profiler::kCounterCount; i++) {
+            ImGui::Text("%-24s %lld", Profiler::counterName(static_cast<Profiler::Counter>(i)),
+                        static_cast<long long>(frame.counters[i]));
+        }
+    }
+
+    ImGui::Separator();
+    ImGui::SliderInt("Frames", &captureFrames, 1, 600);
+    if (profiler.isCapturing()) {
+        ImGui::TextDisabled("Capturing...");
+    } else if (ImGui::Button("Capture")) {
+        profiler.startCapture(captureFrames);
+    }
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!profiler.hasCapture() || profiler.isCapturing());
+    if (ImGui::Button("Save Trace...")) {
+        const char* filters[] = { "*.json" };
+        const char* path = tinyfd_saveFileDialog("Save Chrome Trace", "trace.json", 1, filters, "Chrome Trace (*.json)");
+        if (path && !profiler.writeChromeTrace(path))
+            tinyfd_messageBox("Save Chrome Trace", "Could not write the trace file.", "ok", "error", 1);
+    }
+    ImGui::EndDisabled();
+#endif
+
+    ImGui::End();
+}
+
+} // namespace opticsketch
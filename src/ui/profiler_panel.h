@@ -0,0 +1,23 @@
+#pragma once
+
+#include <imgui.h>
+#include <vector>
+
+namespace opticsketch {
+
+// Frame timings from the Profiler: frame time history, the last frame's CPU scopes and
+// GPU passes, per-frame counters, and Chrome trace capture of the next few frames.
+class ProfilerPanel {
+public:
+    void render();
+
+    bool isVisible() const { return visible; }
+    void setVisible(bool v) { visible = v; }
+
+private:
+    bool visible = false;
+    int captureFrames = 60;
+    std::vector<float> history;
+};
+
+} // namespace opticsketch
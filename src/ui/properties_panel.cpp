@@ -4,6 +4,7 @@
 #include "elements/annotation.h"
 #include "elements/measurement.h"
 #include "render/beam.h"
+#include "undo/undo.h"
 #include <glm/gtc/quaternion.hpp>
 #include <glm/trigonometric.hpp>
 #include <cstring>
@@ -31,9 +32,19 @@ static const char* elementTypeLabel(ElementType type) {
     }
 }
 
-void PropertiesPanel::render(Scene* scene) {
+void PropertiesPanel::commitBatchEdit(Scene* scene, UndoStack* undoStack) {
+    std::vector<ElementEdit> edits = scene->endElementEdit();
+    if (!edits.empty() && undoStack)
+        undoStack->push(std::make_unique<EditElementsCmd>(std::move(edits)));
+}
+
+void PropertiesPanel::render(Scene* scene, UndoStack* undoStack) {
     if (!visible || !scene) return;
 
+    // A batched drag ends when its widget is released; also close one left open by a
+    // widget that is no longer drawn (selection changed mid-drag)
+    if (scene->isElementEditOpen() && !ImGui::IsAnyItemActive()) commitBatchEdit(scene, undoStack);
+
     if (!ImGui::Begin("Properties", &visible, ImGuiWindowFlags_None)) {
         ImGui::End();
         return;
@@ -63,39 +74,66 @@ void PropertiesPanel::render(Scene* scene) {
 
         ImGui::Spacing();
 
-        // Batch state toggles for selected elements
+        // Batch state toggles for selected elements. Every change goes through one scene
+        // edit over the whole selection: a click is one edit, a drag is one edit from
+        // press to release, each recorded as a single undo step.
         if (!selElems.empty()) {
             ImGui::Text("Batch Properties (Elements)");
             ImGui::Separator();
 
+            auto applyToSelection = [&](auto&& fn) {
+                if (!scene->isElementEditOpen()) scene->beginElementEdit(selElems);
+                scene->applyElementEdit(fn);
+            };
+
             // Determine mixed state for checkboxes
             bool allVisible = true, anyVisible = false;
             bool allLocked = true, anyLocked = false;
             int commonLayer = selElems[0]->layer;
             bool layerMixed = false;
+            float commonReflectivity = selElems[0]->optics.reflectivity;
+            float commonTransmissivity = selElems[0]->optics.transmissivity;
+            bool reflectivityMixed = false, transmissivityMixed = false;
             for (auto* e : selElems) {
                 if (e->visible) anyVisible = true; else allVisible = false;
                 if (e->locked) anyLocked = true; else allLocked = false;
                 if (e->layer != commonLayer) layerMixed = true;
+                if (e->optics.reflectivity != commonReflectivity) reflectivityMixed = true;
+                if (e->optics.transmissivity != commonTransmissivity) transmissivityMixed = true;
             }
 
             bool visVal = anyVisible;
             if (ImGui::Checkbox("Visible##batch", &visVal)) {
-                for (auto* e : selElems) e->visible = visVal;
+                applyToSelection([&](Element& e) { e.visible = visVal; });
+                commitBatchEdit(scene, undoStack);
             }
             if (allVisible != anyVisible) { ImGui::SameLine(); ImGui::TextDisabled("(mixed)"); }
 
             bool lockVal = anyLocked;
             if (ImGui::Checkbox("Locked##batch", &lockVal)) {
-                for (auto* e : selElems) e->locked = lockVal;
+                applyToSelection([&](Element& e) { e.locked = lockVal; });
+                commitBatchEdit(scene, undoStack);
             }
             if (allLocked != anyLocked) { ImGui::SameLine(); ImGui::TextDisabled("(mixed)"); }
 
             int layerVal = commonLayer;
             if (layerMixed) ImGui::TextDisabled("Layer: (mixed)");
             else if (ImGui::DragInt("Layer##batch", &layerVal, 1, 0, 255)) {
-                for (auto* e : selElems) e->layer = layerVal;
+                applyToSelection([&](Element& e) { e.layer = layerVal; });
             }
+
+            // Dragging sets every selected element to the slider value
+            float reflVal = commonReflectivity;
+            if (ImGui::SliderFloat("Reflectivity##batch", &reflVal, 0.0f, 1.0f, "%.3f")) {
+                applyToSelection([&](Element& e) { e.optics.reflectivity = reflVal; });
+            }
+            if (reflectivityMixed) { ImGui::SameLine(); ImGui::TextDisabled("(mixed)"); }
+
+            float transVal = commonTransmissivity;
+            if (ImGui::SliderFloat("Transmissivity##batch", &transVal, 0.0f, 1.0f, "%.3f")) {
+                applyToSelection([&](Element& e) { e.optics.transmissivity = transVal; });
+            }
+            if (transmissivityMixed) { ImGui::SameLine(); ImGui::TextDisabled("(mixed)"); }
         }
 
         ImGui::End();
@@ -105,6 +143,10 @@ void PropertiesPanel::render(Scene* scene) {
     // --- Single selection ---
     Element* elem = scene->getSelectedElement();
     Beam* beam = scene->getSelectedBeam();
+    // Edits made below, reported to the scene's change journal (element transforms are
+    // journaled by the scene itself)
+    bool edited = false;
+    bool moved = false;
 
     if (elem) {
         // Refresh buffer when selection changes
@@ -118,8 +160,10 @@ void PropertiesPanel::render(Scene* scene) {
 
         ImGui::Text("Element");
         ImGui::Separator();
-        if (ImGui::InputText("Label", labelBuf, sizeof(labelBuf)))
+        if (ImGui::InputText("Label", labelBuf, sizeof(labelBuf))) {
             elem->label = labelBuf;
+            edited = true;
+        }
 
         ImGui::Text("Type: %s", elementTypeLabel(elem->type));
         ImGui::Text("ID: %s", elem->id.c_str());
@@ -127,23 +171,51 @@ void PropertiesPanel::render(Scene* scene) {
 
         ImGui::Text("Transform");
         ImGui::Separator();
-        ImGui::DragFloat3("Position", &elem->transform.position.x, 0.1f, -1e6f, 1e6f, "%.3f");
+        if (ImGui::DragFloat3("Position", &elem->transform.position.x, 0.1f, -1e6f, 1e6f, "%.3f"))
+            elem->markTransformDirty();
 
         glm::vec3 eulerDeg = glm::degrees(glm::eulerAngles(elem->transform.rotation));
-        if (ImGui::DragFloat3("Rotation (deg)", &eulerDeg.x, 1.0f, -360.0f, 360.0f, "%.1f"))
+        if (ImGui::DragFloat3("Rotation (deg)", &eulerDeg.x, 1.0f, -360.0f, 360.0f, "%.1f")) {
             elem->transform.rotation = glm::quat(glm::radians(eulerDeg));
+            elem->markTransformDirty();
+        }
 
-        ImGui::DragFloat3("Scale", &elem->transform.scale.x, 0.01f, 0.001f, 1e6f, "%.3f");
+        if (ImGui::DragFloat3("Scale", &elem->transform.scale.x, 0.01f, 0.001f, 1e6f, "%.3f"))
+            elem->markTransformDirty();
         ImGui::Spacing();
 
         ImGui::Text("State");
         ImGui::Separator();
-        ImGui::Checkbox("Visible", &elem->visible);
-        ImGui::Checkbox("Show Label", &elem->showLabel);
-        ImGui::Checkbox("Locked", &elem->locked);
-        ImGui::DragInt("Layer", &elem->layer, 1, 0, 255);
+        edited |= ImGui::Checkbox("Visible", &elem->visible);
+        edited |= ImGui::Checkbox("Show Label", &elem->showLabel);
+        edited |= ImGui::Checkbox("Locked", &elem->locked);
+        edited |= ImGui::DragInt("Layer", &elem->layer, 1, 0, 255);
         ImGui::Spacing();
 
+        // --- Array: copies of this element on a grid ---
+        if (ImGui::CollapsingHeader("Array")) {
+            ElementArray& array = elem->array;
+            const ElementArray before = array;
+            bool arrayChanged = ImGui::DragInt3("Count##array", &array.count.x, 0.1f, 1, 256);
+            arrayChanged |= ImGui::DragFloat3("Pitch (mm)##array", &array.pitch.x, 0.5f, -1e4f, 1e4f, "%.2f");
+            if (!array.instances.empty()) {
+                ImGui::Text("%zu copies placed individually", array.instances.size());
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Clear##array")) {
+                    array.instances.clear();
+                    arrayChanged = true;
+                }
+            }
+            if (arrayChanged) {
+                array.count = glm::max(array.count, glm::ivec3(1));
+                elem->markTransformDirty();
+                if (undoStack && !(array == before))
+                    undoStack->push(std::make_unique<EditArrayCmd>(elem->id, before, array));
+            }
+            ImGui::Text("Instances: %d", elem->getInstanceCount());
+            ImGui::TextDisabled("Offsets follow the element's rotation");
+        }
+
         // --- Optical Properties ---
         if (ImGui::CollapsingHeader("Optical Properties")) {
             static const char* opticalTypeNames[] = {
@@ -153,16 +225,17 @@ void PropertiesPanel::render(Scene* scene) {
             int otIdx = static_cast<int>(elem->optics.opticalType);
             if (ImGui::Combo("Optical Type", &otIdx, opticalTypeNames, 11)) {
                 elem->optics.opticalType = static_cast<OpticalType>(otIdx);
+                edited = true;
             }
 
-            ImGui::DragFloat("IOR##optics", &elem->optics.ior, 0.01f, 1.0f, 3.0f, "%.4f");
-            ImGui::SliderFloat("Reflectivity##optics", &elem->optics.reflectivity, 0.0f, 1.0f, "%.3f");
-            ImGui::SliderFloat("Transmissivity##optics", &elem->optics.transmissivity, 0.0f, 1.0f, "%.3f");
+            edited |= ImGui::DragFloat("IOR##optics", &elem->optics.ior, 0.01f, 1.0f, 3.0f, "%.4f");
+            edited |= ImGui::SliderFloat("Reflectivity##optics", &elem->optics.reflectivity, 0.0f, 1.0f, "%.3f");
+            edited |= ImGui::SliderFloat("Transmissivity##optics", &elem->optics.transmissivity, 0.0f, 1.0f, "%.3f");
 
             if (elem->optics.opticalType == OpticalType::Lens) {
-                ImGui::DragFloat("Focal Length (mm)##optics", &elem->optics.focalLength, 0.5f, 1.0f, 10000.0f, "%.1f");
-                ImGui::DragFloat("Curvature R1 (mm)##optics", &elem->optics.curvatureR1, 1.0f, -10000.0f, 10000.0f, "%.1f");
-                ImGui::DragFloat("Curvature R2 (mm)##optics", &elem->optics.curvatureR2, 1.0f, -10000.0f, 10000.0f, "%.1f");
+                edited |= ImGui::DragFloat("Focal Length (mm)##optics", &elem->optics.focalLength, 0.5f, 1.0f, 10000.0f, "%.1f");
+                edited |= ImGui::DragFloat("Curvature R1 (mm)##optics", &elem->optics.curvatureR1, 1.0f, -10000.0f, 10000.0f, "%.1f");
+                edited |= ImGui::DragFloat("Curvature R2 (mm)##optics", &elem->optics.curvatureR2, 1.0f, -10000.0f, 10000.0f, "%.1f");
                 ImGui::Spacing();
                 // Lensmaker's equation: 1/f = (n-1) * (1/R1 - 1/R2)
                 float n = elem->optics.ior;
@@ -180,15 +253,15 @@ void PropertiesPanel::render(Scene* scene) {
             }
 
             if (elem->optics.opticalType == OpticalType::Filter) {
-                ImGui::ColorEdit3("Filter Color##optics", &elem->optics.filterColor.x);
+                edited |= ImGui::ColorEdit3("Filter Color##optics", &elem->optics.filterColor.x);
             }
 
             if (elem->optics.opticalType == OpticalType::Aperture) {
-                ImGui::SliderFloat("Opening Size##optics", &elem->optics.apertureDiameter, 0.05f, 0.95f, "%.2f");
+                edited |= ImGui::SliderFloat("Opening Size##optics", &elem->optics.apertureDiameter, 0.05f, 0.95f, "%.2f");
             }
 
             if (elem->optics.opticalType == OpticalType::Grating) {
-                ImGui::DragFloat("Line Density (lines/mm)##optics", &elem->optics.gratingLineDensity, 10.0f, 100.0f, 2400.0f, "%.0f");
+                edited |= ImGui::DragFloat("Line Density (lines/mm)##optics", &elem->optics.gratingLineDensity, 10.0f, 100.0f, 2400.0f, "%.0f");
             }
 
             // Dispersion for refractive elements
@@ -198,6 +271,7 @@ void PropertiesPanel::render(Scene* scene) {
                 float cauchyBscaled = elem->optics.cauchyB * 1e15f;
                 if (ImGui::DragFloat("Cauchy B (x1e-15 m^2)##optics", &cauchyBscaled, 0.1f, 0.0f, 20.0f, "%.1f")) {
                     elem->optics.cauchyB = cauchyBscaled * 1e-15f;
+                    edited = true;
                 }
                 ImGui::TextDisabled("0 = no dispersion, 4.2 = BK7 glass");
             }
@@ -206,23 +280,24 @@ void PropertiesPanel::render(Scene* scene) {
             if (elem->optics.opticalType == OpticalType::Source) {
                 ImGui::Separator();
                 ImGui::Text("Source Settings");
-                ImGui::DragInt("Ray Count##source", &elem->optics.sourceRayCount, 2, 1, 21);
+                edited |= ImGui::DragInt("Ray Count##source", &elem->optics.sourceRayCount, 2, 1, 21);
                 // Force odd for symmetric spread
                 if (elem->optics.sourceRayCount > 1 && elem->optics.sourceRayCount % 2 == 0)
                     elem->optics.sourceRayCount++;
-                ImGui::DragFloat("Beam Width (mm)##source", &elem->optics.sourceBeamWidth, 0.1f, 0.0f, 50.0f, "%.1f");
-                ImGui::Checkbox("White Light##source", &elem->optics.sourceIsWhiteLight);
+                edited |= ImGui::DragFloat("Beam Width (mm)##source", &elem->optics.sourceBeamWidth, 0.1f, 0.0f, 50.0f, "%.1f");
+                edited |= ImGui::Checkbox("White Light##source", &elem->optics.sourceIsWhiteLight);
                 ImGui::TextDisabled("White light emits 7 wavelengths for dispersion");
             }
         }
 
         // --- Material Properties ---
         if (ImGui::CollapsingHeader("Material")) {
-            ImGui::SliderFloat("Metallic##mat", &elem->material.metallic, 0.0f, 1.0f, "%.2f");
-            ImGui::SliderFloat("Roughness##mat", &elem->material.roughness, 0.0f, 1.0f, "%.2f");
-            ImGui::SliderFloat("Transparency##mat", &elem->material.transparency, 0.0f, 1.0f, "%.2f");
-            ImGui::DragFloat("Fresnel IOR##mat", &elem->material.fresnelIOR, 0.01f, 1.0f, 3.0f, "%.3f");
+            edited |= ImGui::SliderFloat("Metallic##mat", &elem->material.metallic, 0.0f, 1.0f, "%.2f");
+            edited |= ImGui::SliderFloat("Roughness##mat", &elem->material.roughness, 0.0f, 1.0f, "%.2f");
+            edited |= ImGui::SliderFloat("Transparency##mat", &elem->material.transparency, 0.0f, 1.0f, "%.2f");
+            edited |= ImGui::DragFloat("Fresnel IOR##mat", &elem->material.fresnelIOR, 0.01f, 1.0f, 3.0f, "%.3f");
         }
+        if (edited) scene->recordChange(elem->handle, SceneChange::PropertyChanged);
     } else if (beam) {
         // Single beam properties
         static std::string s_lastBeamId;
@@ -235,47 +310,53 @@ void PropertiesPanel::render(Scene* scene) {
 
         ImGui::Text("Beam");
         ImGui::Separator();
-        if (ImGui::InputText("Label##beam", beamLabelBuf, sizeof(beamLabelBuf)))
+        if (ImGui::InputText("Label##beam", beamLabelBuf, sizeof(beamLabelBuf))) {
             beam->label = beamLabelBuf;
+            edited = true;
+        }
 
         ImGui::Text("ID: %s", beam->id.c_str());
         ImGui::Spacing();
 
         ImGui::Text("Geometry");
         ImGui::Separator();
-        ImGui::DragFloat3("Start", &beam->start.x, 0.1f, -1e6f, 1e6f, "%.3f");
-        ImGui::DragFloat3("End", &beam->end.x, 0.1f, -1e6f, 1e6f, "%.3f");
+        moved |= ImGui::DragFloat3("Start", &beam->start.x, 0.1f, -1e6f, 1e6f, "%.3f");
+        moved |= ImGui::DragFloat3("End", &beam->end.x, 0.1f, -1e6f, 1e6f, "%.3f");
         ImGui::Spacing();
 
         ImGui::Text("Appearance");
         ImGui::Separator();
-        ImGui::ColorEdit3("Color##beam", &beam->color.x);
-        ImGui::DragFloat("Width##beam", &beam->width, 0.1f, 0.5f, 20.0f, "%.1f");
+        edited |= ImGui::ColorEdit3("Color##beam", &beam->color.x);
+        edited |= ImGui::DragFloat("Width##beam", &beam->width, 0.1f, 0.5f, 20.0f, "%.1f");
         ImGui::Spacing();
 
         ImGui::Text("State");
         ImGui::Separator();
-        ImGui::Checkbox("Visible##beam", &beam->visible);
-        ImGui::DragInt("Layer##beam", &beam->layer, 1, 0, 255);
+        edited |= ImGui::Checkbox("Visible##beam", &beam->visible);
+        edited |= ImGui::DragInt("Layer##beam", &beam->layer, 1, 0, 255);
         ImGui::Spacing();
 
         // --- Gaussian Beam section ---
         ImGui::Text("Gaussian Beam");
         ImGui::Separator();
-        ImGui::Checkbox("Enable Gaussian##beam", &beam->isGaussian);
+        edited |= ImGui::Checkbox("Enable Gaussian##beam", &beam->isGaussian);
 
         if (beam->isGaussian) {
             // Waist w0 displayed in mm (stored in meters)
             float waistMM = beam->waistW0 * 1000.0f;
-            if (ImGui::DragFloat("Waist w0 (mm)##beam", &waistMM, 0.01f, 0.001f, 100.0f, "%.3f"))
+            if (ImGui::DragFloat("Waist w0 (mm)##beam", &waistMM, 0.01f, 0.001f, 100.0f, "%.3f")) {
                 beam->waistW0 = waistMM / 1000.0f;
+                edited = true;
+            }
 
             // Wavelength displayed in nm (stored in meters)
             float wavelengthNM = beam->wavelength * 1e9f;
-            if (ImGui::DragFloat("Wavelength (nm)##beam", &wavelengthNM, 1.0f, 100.0f, 2000.0f, "%.0f"))
+            if (ImGui::DragFloat("Wavelength (nm)##beam", &wavelengthNM, 1.0f, 100.0f, 2000.0f, "%.0f")) {
                 beam->wavelength = wavelengthNM * 1e-9f;
+                edited = true;
+            }
 
-            ImGui::SliderFloat("Waist Position##beam", &beam->waistPosition, 0.0f, 1.0f, "%.2f");
+            edited |= ImGui::SliderFloat("Waist Position##beam", &beam->waistPosition, 0.0f, 1.0f, "%.2f");
 
             ImGui::Spacing();
             ImGui::Text("Computed Values");
@@ -290,6 +371,8 @@ void PropertiesPanel::render(Scene* scene) {
             ImGui::Text("Divergence: %.3f mrad", divergence * 1000.0f);
             ImGui::Text("Radius at end: %.3f mm", endRadius * 1000.0f);
         }
+        if (moved) scene->recordChange(beam->handle, SceneChange::Transformed);
+        if (edited) scene->recordChange(beam->handle, SceneChange::PropertyChanged);
     } else {
         // Check for selected annotation
         opticsketch::Annotation* ann = scene->getSelectedAnnotation();
@@ -307,33 +390,39 @@ void PropertiesPanel::render(Scene* scene) {
 
             ImGui::Text("Annotation");
             ImGui::Separator();
-            if (ImGui::InputText("Label##ann", annLabelBuf, sizeof(annLabelBuf)))
+            if (ImGui::InputText("Label##ann", annLabelBuf, sizeof(annLabelBuf))) {
                 ann->label = annLabelBuf;
+                edited = true;
+            }
 
             ImGui::Text("ID: %s", ann->id.c_str());
             ImGui::Spacing();
 
             ImGui::Text("Text");
             ImGui::Separator();
-            if (ImGui::InputTextMultiline("##anntext", annTextBuf, sizeof(annTextBuf), ImVec2(-1, 80)))
+            if (ImGui::InputTextMultiline("##anntext", annTextBuf, sizeof(annTextBuf), ImVec2(-1, 80))) {
                 ann->text = annTextBuf;
+                edited = true;
+            }
             ImGui::Spacing();
 
             ImGui::Text("Position");
             ImGui::Separator();
-            ImGui::DragFloat3("Position##ann", &ann->position.x, 0.1f, -1e6f, 1e6f, "%.3f");
+            moved |= ImGui::DragFloat3("Position##ann", &ann->position.x, 0.1f, -1e6f, 1e6f, "%.3f");
             ImGui::Spacing();
 
             ImGui::Text("Appearance");
             ImGui::Separator();
-            ImGui::ColorEdit3("Color##ann", &ann->color.x);
-            ImGui::DragFloat("Font Size##ann", &ann->fontSize, 0.5f, 6.0f, 72.0f, "%.0f");
+            edited |= ImGui::ColorEdit3("Color##ann", &ann->color.x);
+            edited |= ImGui::DragFloat("Font Size##ann", &ann->fontSize, 0.5f, 6.0f, 72.0f, "%.0f");
             ImGui::Spacing();
 
             ImGui::Text("State");
             ImGui::Separator();
-            ImGui::Checkbox("Visible##ann", &ann->visible);
-            ImGui::DragInt("Layer##ann", &ann->layer, 1, 0, 255);
+            edited |= ImGui::Checkbox("Visible##ann", &ann->visible);
+            edited |= ImGui::DragInt("Layer##ann", &ann->layer, 1, 0, 255);
+            if (moved) scene->recordChange(ann->handle, SceneChange::Transformed);
+            if (edited) scene->recordChange(ann->handle, SceneChange::PropertyChanged);
         } else {
             // Check for selected measurement
             opticsketch::Measurement* meas = scene->getSelectedMeasurement();
@@ -348,16 +437,18 @@ void PropertiesPanel::render(Scene* scene) {
 
                 ImGui::Text("Measurement");
                 ImGui::Separator();
-                if (ImGui::InputText("Label##meas", measLabelBuf, sizeof(measLabelBuf)))
+                if (ImGui::InputText("Label##meas", measLabelBuf, sizeof(measLabelBuf))) {
                     meas->label = measLabelBuf;
+                    edited = true;
+                }
 
                 ImGui::Text("ID: %s", meas->id.c_str());
                 ImGui::Spacing();
 
                 ImGui::Text("Points");
                 ImGui::Separator();
-                ImGui::DragFloat3("Start##meas", &meas->startPoint.x, 0.1f, -1e6f, 1e6f, "%.3f");
-                ImGui::DragFloat3("End##meas", &meas->endPoint.x, 0.1f, -1e6f, 1e6f, "%.3f");
+                moved |= ImGui::DragFloat3("Start##meas", &meas->startPoint.x, 0.1f, -1e6f, 1e6f, "%.3f");
+                moved |= ImGui::DragFloat3("End##meas", &meas->endPoint.x, 0.1f, -1e6f, 1e6f, "%.3f");
                 ImGui::Spacing();
 
                 ImGui::Text("Distance: %.3f", meas->getDistance());
@@ -365,14 +456,16 @@ void PropertiesPanel::render(Scene* scene) {
 
                 ImGui::Text("Appearance");
                 ImGui::Separator();
-                ImGui::ColorEdit3("Color##meas", &meas->color.x);
-                ImGui::DragFloat("Font Size##meas", &meas->fontSize, 0.5f, 6.0f, 72.0f, "%.0f");
+                edited |= ImGui::ColorEdit3("Color##meas", &meas->color.x);
+                edited |= ImGui::DragFloat("Font Size##meas", &meas->fontSize, 0.5f, 6.0f, 72.0f, "%.0f");
                 ImGui::Spacing();
 
                 ImGui::Text("State");
                 ImGui::Separator();
-                ImGui::Checkbox("Visible##meas", &meas->visible);
-                ImGui::DragInt("Layer##meas", &meas->layer, 1, 0, 255);
+                edited |= ImGui::Checkbox("Visible##meas", &meas->visible);
+                edited |= ImGui::DragInt("Layer##meas", &meas->layer, 1, 0, 255);
+                if (moved) scene->recordChange(meas->handle, SceneChange::Transformed);
+                if (edited) scene->recordChange(meas->handle, SceneChange::PropertyChanged);
             } else {
                 ImGui::TextDisabled("No selection");
                 ImGui::TextDisabled("Select an object in the viewport or outliner.");
@@ -5,17 +5,22 @@
 namespace opticsketch {
 
 class Scene;
+class UndoStack;
 
 class PropertiesPanel {
 public:
     PropertiesPanel() = default;
 
-    void render(Scene* scene);
+    // Multi-selection edits are recorded on undoStack (may be null)
+    void render(Scene* scene, UndoStack* undoStack);
 
     bool isVisible() const { return visible; }
     void setVisible(bool v) { visible = v; }
 
 private:
+    // Close the scene's open batched edit and record it as one undo step
+    void commitBatchEdit(Scene* scene, UndoStack* undoStack);
+
     bool visible = true;
 };
 
@@ -0,0 +1,203 @@
+#include "ui/spot_diagram_panel.h"
+#include "scene/scene.h"
+#include "elements/element.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace opticsketch {
+
+static bool isDetectorElement(const Element* elem) {
+    return elem->type == ElementType::Detector || elem->type == ElementType::Screen;
+}
+
+// Canvas fitted to the detector face (local XY bounds), keeping its aspect ratio
+struct FaceCanvas {
+    ImVec2 origin;      // screen position of faceMin
+    float scale = 1.0f; // pixels per mm
+    glm::vec2 faceMin{0.0f};
+    glm::vec2 faceMax{0.0f};
+
+    ImVec2 toScreen(float x, float y) const {
+        // Local +Y is up on screen
+        return ImVec2(origin.x + (x - faceMin.x) * scale, origin.y - (y - faceMin.y) * scale);
+    }
+};
+
+static FaceCanvas beginFaceCanvas(const Element* detector) {
+    FaceCanvas canvas;
+    canvas.faceMin = glm::vec2(detector->boundsMin);
+    canvas.faceMax = glm::vec2(detector->boundsMax);
+    glm::vec2 extent = glm::max(canvas.faceMax - canvas.faceMin, glm::vec2(1e-3f));
+
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    float side = std::max(64.0f, std::min(avail.x, avail.y - ImGui::GetTextLineHeightWithSpacing() * 3.0f));
+    canvas.scale = side / std::max(extent.x, extent.y);
+    ImVec2 size(extent.x * canvas.scale, extent.y * canvas.scale);
+
+    ImVec2 pos = ImGui::GetCursorScreenPos();
+    canvas.origin = ImVec2(pos.x, pos.y + size.y);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(pos, ImVec2(pos.x + size.x, pos.y + size.y), IM_COL32(16, 16, 20, 255));
+    ImGui::Dummy(size);
+    return canvas;
+}
+
+static void endFaceCanvas(const FaceCanvas& canvas) {
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImU32 frame = ImGui::GetColorU32(ImGuiCol_Border);
+    drawList->AddRect(canvas.toScreen(canvas.faceMin.x, canvas.faceMax.y),
+                      canvas.toScreen(canvas.faceMax.x, canvas.faceMin.y), frame);
+    // Crosshair through the face centre
+    glm::vec2 c = (canvas.faceMin + canvas.faceMax) * 0.5f;
+    ImU32 axis = IM_COL32(255, 255, 255, 40);
+    drawList->AddLine(canvas.toScreen(canvas.faceMin.x, c.y), canvas.toScreen(canvas.faceMax.x, c.y), axis);
+    drawList->AddLine(canvas.toScreen(c.x, canvas.faceMin.y), canvas.toScreen(c.x, canvas.faceMax.y), axis);
+}
+
+// Black -> red -> yellow -> white
+static ImU32 heatColor(float t) {
+    t = std::clamp(t, 0.0f, 1.0f);
+    float r = std::clamp(t * 3.0f, 0.0f, 1.0f);
+    float g = std::clamp(t * 3.0f - 1.0f, 0.0f, 1.0f);
+    float b = std::clamp(t * 3.0f - 2.0f, 0.0f, 1.0f);
+    return IM_COL32(static_cast<int>(r * 255), static_cast<int>(g * 255), static_cast<int>(b * 255), 255);
+}
+
+void SpotDiagramPanel::render(Scene* scene, RayTracer* tracer, const TraceConfig& config) {
+    if (!visible || !scene || !tracer) return;
+
+    if (!ImGui::Begin("Spot Diagram", &visible)) {
+        ImGui::End();
+        return;
+    }
+
+    // Detector picker; falls back to the first detector when the chosen one is gone
+    const Element* detector = nullptr;
+    std::vector<const Element*> detectors;
+    for (const auto& elem : scene->getElements()) {
+        if (!isDetectorElement(elem.get())) continue;
+        detectors.push_back(elem.get());
+        if (elem->id == detectorId) detector = elem.get();
+    }
+    if (detectors.empty()) {
+        ImGui::TextDisabled("Add a Detector or Screen to see where rays land");
+        ImGui::End();
+        return;
+    }
+    if (!detector) {
+        detector = detectors.front();
+        detectorId = detector->id;
+    }
+    if (ImGui::BeginCombo("Detector", detector->label.c_str())) {
+        for (const Element* d : detectors) {
+            ImGui::PushID(d->id.c_str());
+            if (ImGui::Selectable(d->label.c_str(), d == detector)) {
+                detector = d;
+                detectorId = d->id;
+            }
+            ImGui::PopID();
+        }
+        ImGui::EndCombo();
+    }
+
+    if (ImGui::BeginTabBar("SpotTabs")) {
+        if (ImGui::BeginTabItem("Spot Diagram")) {
+            renderSpotDiagram(scene, detector);
+            ImGui::EndTabItem();
+        }
+        if (ImGui::BeginTabItem("Irradiance")) {
+            renderIrradiance(scene, tracer, config, detector);
+            ImGui::EndTabItem();
+        }
+        ImGui::EndTabBar();
+    }
+    ImGui::End();
+}
+
+void SpotDiagramPanel::renderSpotDiagram(Scene* scene, const Element* detector) {
+    const DetectorHitBuffer& hits = scene->getTracedRays().hits;
+    auto it = std::find(hits.detectorIds.begin(), hits.detectorIds.end(), detector->id);
+    int detectorIdx = it != hits.detectorIds.end() ? static_cast<int>(it - hits.detectorIds.begin()) : -1;
+
+    int count = 0;
+    double total = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0;
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (hits.detector[i] != detectorIdx) continue;
+        const glm::vec3& p = hits.local[i];
+        double w = hits.intensity[i];
+        count++;
+        total += w;
+        sx += p.x * w;
+        sy += p.y * w;
+        sxx += static_cast<double>(p.x) * p.x * w;
+        syy += static_cast<double>(p.y) * p.y * w;
+    }
+
+    FaceCanvas canvas = beginFaceCanvas(detector);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (hits.detector[i] != detectorIdx) continue;
+        int alpha = static_cast<int>(std::clamp(hits.intensity[i], 0.2f, 1.0f) * 255.0f);
+        drawList->AddCircleFilled(canvas.toScreen(hits.local[i].x, hits.local[i].y), 2.5f,
+                                  IM_COL32(255, 210, 80, alpha), 8);
+    }
+    endFaceCanvas(canvas);
+
+    if (count == 0) {
+        ImGui::TextDisabled("No traced rays reach this detector (Optics > Trace Rays)");
+        return;
+    }
+    double mx = sx / std::max(total, 1e-12), my = sy / std::max(total, 1e-12);
+    double rms = std::sqrt(std::max(0.0, sxx / std::max(total, 1e-12) - mx * mx + syy / std::max(total, 1e-12) - my * my));
+    ImGui::Text("Hits: %d   Intensity: %.3f", count, total);
+    ImGui::Text("Centroid: (%.3f, %.3f) mm   RMS radius: %.4f mm", mx, my, rms);
+}
+
+void SpotDiagramPanel::renderIrradiance(Scene* scene, RayTracer* tracer, const TraceConfig& config,
+                                        const Element* detector) {
+    ImGui::DragInt("Rays per Source", &analysis.raysPerSource, 1000.0f, 1000, 10000000);
+    ImGui::SliderInt("Bins", &analysis.bins, 16, 512);
+    ImGui::Checkbox("Log Scale", &logScale);
+    ImGui::SameLine();
+    if (ImGui::Button("Run Analysis")) {
+        auto t0 = std::chrono::steady_clock::now();
+        tracer->traceAnalysis(scene, config, analysis, results);
+        analysisSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    const DetectorAccumulator* acc = nullptr;
+    for (const auto& r : results) {
+        if (r.elementId == detector->id) acc = &r;
+    }
+
+    FaceCanvas canvas = beginFaceCanvas(detector);
+    if (acc && acc->bins > 0) {
+        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        float peak = acc->peak();
+        float norm = logScale ? std::log1p(peak * 1000.0f) : peak;
+        glm::vec2 cell = (acc->faceMax - acc->faceMin) / static_cast<float>(acc->bins);
+        for (int y = 0; y < acc->bins; y++) {
+            for (int x = 0; x < acc->bins; x++) {
+                float v = acc->irradiance[static_cast<size_t>(y) * acc->bins + x];
+                if (v <= 0.0f || norm <= 0.0f) continue;
+                float t = logScale ? std::log1p(v * 1000.0f) / norm : v / norm;
+                glm::vec2 lo = acc->faceMin + cell * glm::vec2(static_cast<float>(x), static_cast<float>(y));
+                drawList->AddRectFilled(canvas.toScreen(lo.x, lo.y + cell.y), canvas.toScreen(lo.x + cell.x, lo.y),
+                                        heatColor(t));
+            }
+        }
+    }
+    endFaceCanvas(canvas);
+
+    if (!acc) {
+        ImGui::TextDisabled("Run an analysis trace to map the irradiance");
+        return;
+    }
+    glm::vec2 c = acc->centroid();
+    ImGui::Text("Hits: %llu   Power: %.4f   (%.2f s)", static_cast<unsigned long long>(acc->hitCount),
+                acc->totalIntensity, analysisSeconds);
+    ImGui::Text("Centroid: (%.3f, %.3f) mm   RMS radius: %.4f mm", c.x, c.y, acc->rmsRadius());
+}
+
+} // namespace opticsketch
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <imgui.h>
+#include <string>
+#include <vector>
+#include "optics/ray_tracer.h"
+
+namespace opticsketch {
+
+class Scene;
+
+// Where rays land on a Detector or Screen: a spot diagram of the hits recorded by the
+// last trace, and an irradiance map from a high-ray-count analysis trace that only fills
+// binned accumulators (no segments are created).
+class SpotDiagramPanel {
+public:
+    void render(Scene* scene, RayTracer* tracer, const TraceConfig& config);
+
+    bool isVisible() const { return visible; }
+    void setVisible(bool v) { visible = v; }
+
+private:
+    void renderSpotDiagram(Scene* scene, const Element* detector);
+    void renderIrradiance(Scene* scene, RayTracer* tracer, const TraceConfig& config, const Element* detector);
+
+    bool visible = false;
+    std::string detectorId;
+    AnalysisConfig analysis;
+    std::vector<DetectorAccumulator> results;   // last analysis trace, one per detector
+    double analysisSeconds = 0.0;
+    bool logScale = false;
+};
+
+} // namespace opticsketch
@@ -35,7 +35,7 @@ void StyleEditorPanel::render(SceneStyle* style) {
             ImGui::Spacing();
             ImGui::SliderFloat("Bloom Threshold", &style->bloomThreshold, 0.1f, 2.0f, "%.2f");
             ImGui::SliderFloat("Bloom Intensity", &style->bloomIntensity, 0.0f, 3.0f, "%.2f");
-            ImGui::SliderInt("Bloom Passes", &style->bloomBlurPasses, 1, 15);
+            ImGui::SliderInt("Bloom Radius", &style->bloomBlurPasses, 1, 8);
 
             ImGui::Separator();
             ImGui::Text("HDRI Environment");
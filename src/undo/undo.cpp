@@ -2,6 +2,10 @@
 #include "scene/scene.h"
 #include "elements/annotation.h"
 #include "elements/measurement.h"
+#include "render/mesh_store.h"
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
 
 namespace opticsketch {
 
@@ -19,7 +23,8 @@ static std::unique_ptr<Element> snapshotElement(const Element& e) {
     s->boundsMax = e.boundsMax;
     s->optics = e.optics;
     s->material = e.material;
-    s->meshVertices = e.meshVertices;
+    s->array = e.array;
+    s->mesh = e.mesh;
     s->meshSourcePath = e.meshSourcePath;
     return s;
 }
@@ -42,27 +47,103 @@ static std::unique_ptr<Beam> snapshotBeam(const Beam& b) {
     return s;
 }
 
+// --- Helpers: memory estimates ---
+
+// Heap part only; short strings live in the inline buffer
+static size_t stringHeapBytes(const std::string& str) {
+    return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+static size_t meshAssetBytes(const MeshAsset& m) {
+    size_t bytes = sizeof(MeshAsset) + m.sourcePath.capacity() +
+                   m.vertices.capacity() * sizeof(float) + m.indices.capacity() * sizeof(uint32_t) +
+                   m.bvh.memoryBytes();
+    for (const MeshLod& lod : m.lods)
+        bytes += sizeof(MeshLod) + lod.vertices.capacity() * sizeof(float) + lod.indices.capacity() * sizeof(uint32_t);
+    return bytes;
+}
+
+// Snapshots share the mesh asset by reference. It is charged only where the history
+// may be the last owner (a removed element), not for elements that live in the scene.
+static size_t elementSnapshotBytes(const Element& e, bool chargeMesh) {
+    size_t bytes = sizeof(Element) + stringHeapBytes(e.id) + stringHeapBytes(e.label) +
+                   stringHeapBytes(e.meshSourcePath) + e.array.instances.capacity() * sizeof(Transform);
+    if (chargeMesh && e.mesh) bytes += meshAssetBytes(*e.mesh);
+    return bytes;
+}
+
+static size_t beamSnapshotBytes(const Beam& b) {
+    return sizeof(Beam) + stringHeapBytes(b.id) + stringHeapBytes(b.label) + stringHeapBytes(b.sourceElementId);
+}
+
+static size_t groupHeapBytes(const Group& g) {
+    return stringHeapBytes(g.id) + stringHeapBytes(g.name) + g.members.capacity() * sizeof(ObjectHandle);
+}
+
 // --- UndoStack ---
 
+static double nowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
 void UndoStack::push(std::unique_ptr<UndoCommand> cmd) {
+    double now = nowSeconds();
+    bool withinWindow = !mergeBlocked && mergeWindow > 0.0 && now - lastPushTime <= mergeWindow;
+    lastPushTime = now;
+    mergeBlocked = false;
+    // Only the newest entry absorbs, so an undone command is never extended
+    if (withinWindow && index >= 0 && index + 1 == static_cast<int>(commands.size())) {
+        Entry& top = commands[index];
+        if (top.cmd->mergeWith(*cmd)) {
+            totalBytes -= top.bytes;
+            top.bytes = top.cmd->memoryBytes();
+            totalBytes += top.bytes;
+            evict();
+            return;
+        }
+    }
+
     // Discard any commands after current index (redo history invalidated)
-    if (index + 1 < static_cast<int>(commands.size())) {
-        commands.erase(commands.begin() + index + 1, commands.end());
+    while (index + 1 < static_cast<int>(commands.size())) {
+        totalBytes -= commands.back().bytes;
+        commands.pop_back();
     }
-    commands.push_back(std::move(cmd));
+    size_t bytes = cmd->memoryBytes();
+    commands.push_back({std::move(cmd), bytes});
+    totalBytes += bytes;
     index = static_cast<int>(commands.size()) - 1;
+    evict();
+}
+
+void UndoStack::evict() {
+    // Oldest first; redo entries are never evicted before the undo ones they follow
+    size_t drop = 0;
+    size_t bytes = totalBytes;
+    // With everything undone (index -1) only redo entries are left: nothing to drop
+    while (commands.size() - drop > 1 && static_cast<int>(drop) <= index &&
+           ((maxCommands > 0 && commands.size() - drop > maxCommands) || (maxBytes > 0 && bytes > maxBytes))) {
+        bytes -= commands[drop].bytes;
+        drop++;
+    }
+    if (drop == 0) return;
+    commands.erase(commands.begin(), commands.begin() + drop);
+    totalBytes = bytes;
+    index -= static_cast<int>(drop);
 }
 
 void UndoStack::undo(Scene& scene) {
     if (!canUndo()) return;
-    commands[index]->undo(scene);
+    commands[index].cmd->undo(scene);
     --index;
+    mergeBlocked = true;
 }
 
 void UndoStack::redo(Scene& scene) {
     if (!canRedo()) return;
     ++index;
-    commands[index]->redo(scene);
+    commands[index].cmd->redo(scene);
+    mergeBlocked = true;
 }
 
 bool UndoStack::canUndo() const {
@@ -76,6 +157,117 @@ bool UndoStack::canRedo() const {
 void UndoStack::clear() {
     commands.clear();
     index = -1;
+    totalBytes = 0;
+    mergeBlocked = true;
+}
+
+// --- TransformDeltas ---
+
+static void appendValues(std::vector<float>& values, const float* a, const float* b, int count) {
+    values.insert(values.end(), a, a + count);
+    values.insert(values.end(), b, b + count);
+}
+
+void TransformDeltas::add(const std::string& elemId, const Transform& oldT, const Transform& newT) {
+    Entry entry;
+    entry.elementId = elemId;
+    entry.offset = static_cast<uint32_t>(values.size());
+    if (oldT.position != newT.position) {
+        entry.parts |= kPosition;
+        appendValues(values, &oldT.position.x, &newT.position.x, 3);
+    }
+    if (oldT.rotation != newT.rotation) {
+        entry.parts |= kRotation;
+        const float o[4] = {oldT.rotation.w, oldT.rotation.x, oldT.rotation.y, oldT.rotation.z};
+        const float n[4] = {newT.rotation.w, newT.rotation.x, newT.rotation.y, newT.rotation.z};
+        appendValues(values, o, n, 4);
+    }
+    if (oldT.scale != newT.scale) {
+        entry.parts |= kScale;
+        appendValues(values, &oldT.scale.x, &newT.scale.x, 3);
+    }
+    // Kept even when unchanged, so consecutive commands on one selection line up in merge()
+    entries.push_back(std::move(entry));
+}
+
+Element* TransformDeltas::resolve(Scene& scene, const Entry& entry) const {
+    if (scene.isHandleValid(entry.handle)) {
+        Element* e = scene.getElement(entry.handle);
+        if (e && e->id == entry.elementId) return e;
+    }
+    entry.handle = scene.findHandle(entry.elementId);
+    return scene.getElement(entry.handle);
+}
+
+void TransformDeltas::apply(Scene& scene, bool useNew) const {
+    for (const Entry& entry : entries) {
+        Element* e = resolve(scene, entry);
+        if (!e) continue;
+        if (const float* p = partValues(entry, kPosition)) {
+            p += useNew ? 3 : 0;
+            e->transform.position = glm::vec3(p[0], p[1], p[2]);
+        }
+        if (const float* q = partValues(entry, kRotation)) {
+            q += useNew ? 4 : 0;
+            e->transform.rotation = glm::quat(q[0], q[1], q[2], q[3]);
+        }
+        if (const float* p = partValues(entry, kScale)) {
+            p += useNew ? 3 : 0;
+            e->transform.scale = glm::vec3(p[0], p[1], p[2]);
+        }
+        e->markTransformDirty();
+        scene.recordChange(e->handle, SceneChange::Transformed);
+    }
+}
+
+const float* TransformDeltas::partValues(const Entry& entry, uint8_t part) const {
+    if (!(entry.parts & part)) return nullptr;
+    uint32_t offset = entry.offset;
+    for (uint8_t p = kPosition; p < part; p <<= 1)
+        if (entry.parts & p) offset += 2 * partFloats(p);
+    return values.data() + offset;
+}
+
+bool TransformDeltas::sameIds(const TransformDeltas& other) const {
+    if (entries.size() != other.entries.size()) return false;
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].elementId != other.entries[i].elementId) return false;
+    return true;
+}
+
+void TransformDeltas::merge(const TransformDeltas& later) {
+    std::vector<Entry> mergedEntries;
+    std::vector<float> mergedValues;
+    mergedEntries.reserve(entries.size());
+    mergedValues.reserve(values.size() + later.values.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& a = entries[i];
+        const Entry& b = later.entries[i];
+        Entry entry;
+        entry.elementId = a.elementId;
+        entry.handle = a.handle;
+        entry.offset = static_cast<uint32_t>(mergedValues.size());
+        for (uint8_t part = kPosition; part <= kScale; part <<= 1) {
+            const float* va = partValues(a, part);
+            const float* vb = later.partValues(b, part);
+            if (!va && !vb) continue;
+            int n = partFloats(part);
+            const float* oldV = va ? va : vb;
+            const float* newV = vb ? vb + n : va + n;
+            if (std::equal(oldV, oldV + n, newV)) continue;   // moved back to where it started
+            entry.parts |= part;
+            appendValues(mergedValues, oldV, newV, n);
+        }
+        mergedEntries.push_back(std::move(entry));
+    }
+    entries.swap(mergedEntries);
+    values.swap(mergedValues);
+}
+
+size_t TransformDeltas::heapBytes() const {
+    size_t bytes = values.capacity() * sizeof(float) + entries.capacity() * sizeof(Entry);
+    for (const Entry& entry : entries) bytes += stringHeapBytes(entry.elementId);
+    return bytes;
 }
 
 // --- AddElementCmd ---
@@ -92,6 +284,10 @@ void AddElementCmd::redo(Scene& scene) {
     scene.selectElement(elementId);
 }
 
+size_t AddElementCmd::memoryBytes() const {
+    return sizeof(*this) + elementSnapshotBytes(*snapshot, false) + stringHeapBytes(elementId);
+}
+
 // --- RemoveElementCmd ---
 
 RemoveElementCmd::RemoveElementCmd(const Element& elem)
@@ -106,19 +302,33 @@ void RemoveElementCmd::redo(Scene& scene) {
     scene.removeElement(elementId);
 }
 
+size_t RemoveElementCmd::memoryBytes() const {
+    return sizeof(*this) + elementSnapshotBytes(*snapshot, true) + stringHeapBytes(elementId);
+}
+
 // --- TransformElementCmd ---
 
-TransformElementCmd::TransformElementCmd(const std::string& elemId, const Transform& oldT, const Transform& newT)
-    : elementId(elemId), oldTransform(oldT), newTransform(newT) {}
+TransformElementCmd::TransformElementCmd(const std::string& elemId, const Transform& oldT, const Transform& newT) {
+    deltas.add(elemId, oldT, newT);
+}
 
 void TransformElementCmd::undo(Scene& scene) {
-    Element* e = scene.getElement(elementId);
-    if (e) e->transform = oldTransform;
+    deltas.apply(scene, false);
 }
 
 void TransformElementCmd::redo(Scene& scene) {
-    Element* e = scene.getElement(elementId);
-    if (e) e->transform = newTransform;
+    deltas.apply(scene, true);
+}
+
+size_t TransformElementCmd::memoryBytes() const {
+    return sizeof(*this) + deltas.heapBytes();
+}
+
+bool TransformElementCmd::mergeWith(const UndoCommand& next) {
+    auto* t = dynamic_cast<const TransformElementCmd*>(&next);
+    if (!t || !deltas.sameIds(t->deltas)) return false;
+    deltas.merge(t->deltas);
+    return true;
 }
 
 // --- AddBeamCmd ---
@@ -135,6 +345,10 @@ void AddBeamCmd::redo(Scene& scene) {
     scene.selectBeam(beamId);
 }
 
+size_t AddBeamCmd::memoryBytes() const {
+    return sizeof(*this) + beamSnapshotBytes(*snapshot) + stringHeapBytes(beamId);
+}
+
 // --- RemoveBeamCmd ---
 
 RemoveBeamCmd::RemoveBeamCmd(const Beam& beam)
@@ -149,6 +363,10 @@ void RemoveBeamCmd::redo(Scene& scene) {
     scene.removeBeam(beamId);
 }
 
+size_t RemoveBeamCmd::memoryBytes() const {
+    return sizeof(*this) + beamSnapshotBytes(*snapshot) + stringHeapBytes(beamId);
+}
+
 // --- Helper: snapshot annotation ---
 
 static std::unique_ptr<Annotation> snapshotAnnotation(const Annotation& a) {
@@ -177,6 +395,11 @@ void AddAnnotationCmd::redo(Scene& scene) {
     scene.selectAnnotation(annotationId);
 }
 
+size_t AddAnnotationCmd::memoryBytes() const {
+    return sizeof(*this) + sizeof(Annotation) + stringHeapBytes(snapshot->id) + stringHeapBytes(snapshot->label) +
+           stringHeapBytes(snapshot->text) + stringHeapBytes(annotationId);
+}
+
 // --- RemoveAnnotationCmd ---
 
 RemoveAnnotationCmd::RemoveAnnotationCmd(const Annotation& ann)
@@ -191,6 +414,11 @@ void RemoveAnnotationCmd::redo(Scene& scene) {
     scene.removeAnnotation(annotationId);
 }
 
+size_t RemoveAnnotationCmd::memoryBytes() const {
+    return sizeof(*this) + sizeof(Annotation) + stringHeapBytes(snapshot->id) + stringHeapBytes(snapshot->label) +
+           stringHeapBytes(snapshot->text) + stringHeapBytes(annotationId);
+}
+
 // --- MoveAnnotationCmd ---
 
 MoveAnnotationCmd::MoveAnnotationCmd(const std::string& annId, const glm::vec3& oldPos, const glm::vec3& newPos)
@@ -198,12 +426,20 @@ MoveAnnotationCmd::MoveAnnotationCmd(const std::string& annId, const glm::vec3&
 
 void MoveAnnotationCmd::undo(Scene& scene) {
     Annotation* a = scene.getAnnotation(annotationId);
-    if (a) a->position = oldPosition;
+    if (!a) return;
+    a->position = oldPosition;
+    scene.recordChange(a->handle, SceneChange::Transformed);
 }
 
 void MoveAnnotationCmd::redo(Scene& scene) {
     Annotation* a = scene.getAnnotation(annotationId);
-    if (a) a->position = newPosition;
+    if (!a) return;
+    a->position = newPosition;
+    scene.recordChange(a->handle, SceneChange::Transformed);
+}
+
+size_t MoveAnnotationCmd::memoryBytes() const {
+    return sizeof(*this) + stringHeapBytes(annotationId);
 }
 
 // --- CompoundUndoCmd ---
@@ -222,24 +458,156 @@ void CompoundUndoCmd::redo(Scene& scene) {
         cmd->redo(scene);
 }
 
+size_t CompoundUndoCmd::memoryBytes() const {
+    size_t bytes = sizeof(*this) + cmds.capacity() * sizeof(cmds[0]);
+    for (const auto& cmd : cmds) bytes += cmd->memoryBytes();
+    return bytes;
+}
+
+// --- AddObjectsCmd ---
+
+AddObjectsCmd::AddObjectsCmd(const std::vector<Element*>& elements, const std::vector<Beam*>& beams,
+                             const std::vector<Annotation*>& annotations) {
+    this->elements.reserve(elements.size());
+    for (const Element* e : elements) this->elements.push_back(snapshotElement(*e));
+    this->beams.reserve(beams.size());
+    for (const Beam* b : beams) this->beams.push_back(snapshotBeam(*b));
+    this->annotations.reserve(annotations.size());
+    for (const Annotation* a : annotations) this->annotations.push_back(snapshotAnnotation(*a));
+}
+
+void AddObjectsCmd::undo(Scene& scene) {
+    std::unordered_set<std::string> ids;
+    ids.reserve(elements.size() + beams.size() + annotations.size());
+    for (const auto& e : elements) ids.insert(e->id);
+    for (const auto& b : beams) ids.insert(b->id);
+    for (const auto& a : annotations) ids.insert(a->id);
+    scene.removeObjects(ids);
+}
+
+void AddObjectsCmd::redo(Scene& scene) {
+    std::vector<std::unique_ptr<Element>> newElements;
+    newElements.reserve(elements.size());
+    for (const auto& e : elements) newElements.push_back(snapshotElement(*e));
+    std::vector<std::unique_ptr<Beam>> newBeams;
+    newBeams.reserve(beams.size());
+    for (const auto& b : beams) newBeams.push_back(snapshotBeam(*b));
+    std::vector<std::unique_ptr<Annotation>> newAnnotations;
+    newAnnotations.reserve(annotations.size());
+    for (const auto& a : annotations) newAnnotations.push_back(snapshotAnnotation(*a));
+
+    scene.deselectAll();
+    for (Element* e : scene.addElements(std::move(newElements))) scene.selectElement(e->id, true);
+    for (Beam* b : scene.addBeams(std::move(newBeams))) scene.selectBeam(b->id, true);
+    for (Annotation* a : scene.addAnnotations(std::move(newAnnotations))) scene.selectAnnotation(a->id, true);
+}
+
+size_t AddObjectsCmd::memoryBytes() const {
+    size_t bytes = sizeof(*this) + elements.capacity() * sizeof(elements[0]) +
+                   beams.capacity() * sizeof(beams[0]) + annotations.capacity() * sizeof(annotations[0]);
+    for (const auto& e : elements) bytes += elementSnapshotBytes(*e, false);
+    for (const auto& b : beams) bytes += beamSnapshotBytes(*b);
+    for (const auto& a : annotations)
+        bytes += sizeof(Annotation) + stringHeapBytes(a->id) + stringHeapBytes(a->label) + stringHeapBytes(a->text);
+    return bytes;
+}
+
+// --- EditElementsCmd ---
+
+EditElementsCmd::EditElementsCmd(std::vector<ElementEdit> edits) : edits(std::move(edits)) {}
+
+void EditElementsCmd::undo(Scene& scene) {
+    for (const ElementEdit& edit : edits) {
+        if (Element* e = scene.getElement(edit.id)) {
+            edit.before.applyTo(*e);
+            scene.recordChange(e->handle, SceneChange::PropertyChanged);
+        }
+    }
+}
+
+void EditElementsCmd::redo(Scene& scene) {
+    for (const ElementEdit& edit : edits) {
+        if (Element* e = scene.getElement(edit.id)) {
+            edit.after.applyTo(*e);
+            scene.recordChange(e->handle, SceneChange::PropertyChanged);
+        }
+    }
+}
+
+size_t EditElementsCmd::memoryBytes() const {
+    size_t bytes = sizeof(*this) + edits.capacity() * sizeof(ElementEdit);
+    for (const ElementEdit& edit : edits) bytes += stringHeapBytes(edit.id);
+    return bytes;
+}
+
 // --- MultiTransformCmd ---
 
 MultiTransformCmd::MultiTransformCmd(std::vector<std::pair<std::string, Transform>> oldTs,
-                                     std::vector<std::pair<std::string, Transform>> newTs)
-    : oldTransforms(std::move(oldTs)), newTransforms(std::move(newTs)) {}
+                                     std::vector<std::pair<std::string, Transform>> newTs) {
+    for (size_t i = 0; i < oldTs.size(); i++) {
+        const std::string& id = oldTs[i].first;
+        // Callers build both lists in the same order; fall back to a search otherwise
+        const Transform* newT = nullptr;
+        if (i < newTs.size() && newTs[i].first == id) {
+            newT = &newTs[i].second;
+        } else {
+            for (auto& [newId, t] : newTs)
+                if (newId == id) { newT = &t; break; }
+        }
+        if (newT) deltas.add(id, oldTs[i].second, *newT);
+    }
+}
 
 void MultiTransformCmd::undo(Scene& scene) {
-    for (auto& [id, t] : oldTransforms) {
-        Element* e = scene.getElement(id);
-        if (e) e->transform = t;
-    }
+    deltas.apply(scene, false);
 }
 
 void MultiTransformCmd::redo(Scene& scene) {
-    for (auto& [id, t] : newTransforms) {
-        Element* e = scene.getElement(id);
-        if (e) e->transform = t;
-    }
+    deltas.apply(scene, true);
+}
+
+size_t MultiTransformCmd::memoryBytes() const {
+    return sizeof(*this) + deltas.heapBytes();
+}
+
+bool MultiTransformCmd::mergeWith(const UndoCommand& next) {
+    auto* t = dynamic_cast<const MultiTransformCmd*>(&next);
+    if (!t || !deltas.sameIds(t->deltas)) return false;
+    deltas.merge(t->deltas);
+    return true;
+}
+
+// --- EditArrayCmd ---
+
+EditArrayCmd::EditArrayCmd(const std::string& elemId, ElementArray oldArray, ElementArray newArray)
+    : elementId(elemId), oldArray(std::move(oldArray)), newArray(std::move(newArray)) {}
+
+static void applyArray(Scene& scene, const std::string& id, const ElementArray& array) {
+    Element* e = scene.getElement(id);
+    if (!e) return;
+    e->array = array;
+    e->markTransformDirty();
+    scene.recordChange(e->handle, SceneChange::Transformed);
+}
+
+void EditArrayCmd::undo(Scene& scene) {
+    applyArray(scene, elementId, oldArray);
+}
+
+void EditArrayCmd::redo(Scene& scene) {
+    applyArray(scene, elementId, newArray);
+}
+
+size_t EditArrayCmd::memoryBytes() const {
+    return sizeof(*this) + stringHeapBytes(elementId) +
+           (oldArray.instances.capacity() + newArray.instances.capacity()) * sizeof(Transform);
+}
+
+bool EditArrayCmd::mergeWith(const UndoCommand& next) {
+    auto* a = dynamic_cast<const EditArrayCmd*>(&next);
+    if (!a || a->elementId != elementId) return false;
+    newArray = a->newArray;
+    return true;
 }
 
 // --- Helper: snapshot measurement ---
@@ -270,6 +638,11 @@ void AddMeasurementCmd::redo(Scene& scene) {
     scene.selectMeasurement(measurementId);
 }
 
+size_t AddMeasurementCmd::memoryBytes() const {
+    return sizeof(*this) + sizeof(Measurement) + stringHeapBytes(snapshot->id) + stringHeapBytes(snapshot->label) +
+           stringHeapBytes(measurementId);
+}
+
 // --- RemoveMeasurementCmd ---
 
 RemoveMeasurementCmd::RemoveMeasurementCmd(const Measurement& meas)
@@ -284,6 +657,11 @@ void RemoveMeasurementCmd::redo(Scene& scene) {
     scene.removeMeasurement(measurementId);
 }
 
+size_t RemoveMeasurementCmd::memoryBytes() const {
+    return sizeof(*this) + sizeof(Measurement) + stringHeapBytes(snapshot->id) + stringHeapBytes(snapshot->label) +
+           stringHeapBytes(measurementId);
+}
+
 // --- CreateGroupCmd ---
 
 CreateGroupCmd::CreateGroupCmd(const Group& group) : snapshot(group) {}
@@ -296,6 +674,10 @@ void CreateGroupCmd::redo(Scene& scene) {
     scene.addGroup(snapshot);
 }
 
+size_t CreateGroupCmd::memoryBytes() const {
+    return sizeof(*this) + groupHeapBytes(snapshot);
+}
+
 // --- DissolveGroupCmd ---
 
 DissolveGroupCmd::DissolveGroupCmd(const Group& group) : snapshot(group) {}
@@ -308,4 +690,8 @@ void DissolveGroupCmd::redo(Scene& scene) {
     scene.dissolveGroup(snapshot.id);
 }
 
+size_t DissolveGroupCmd::memoryBytes() const {
+    return sizeof(*this) + groupHeapBytes(snapshot);
+}
+
 } // namespace opticsketch
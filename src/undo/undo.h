@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <string>
@@ -9,20 +11,25 @@
 #include "elements/measurement.h"
 #include "scene/group.h"
 #include "render/beam.h"
+#include "scene/scene.h"
 
 namespace opticsketch {
 
-class Scene;
-
 // Base class for undoable commands
 class UndoCommand {
 public:
     virtual ~UndoCommand() = default;
     virtual void undo(Scene& scene) = 0;
     virtual void redo(Scene& scene) = 0;
+    // Approximate heap + object size held by the command, for the history budget
+    virtual size_t memoryBytes() const = 0;
+    // Absorb a command pushed right after this one (e.g. the next step of the same drag).
+    // Returns false if the two cannot be combined; 'next' is then pushed on its own.
+    virtual bool mergeWith(const UndoCommand& next) { (void)next; return false; }
 };
 
-// Undo/Redo stack
+// Undo/Redo stack. History is bounded by command count and by memory; the oldest
+// commands are evicted once either limit is exceeded (the newest is always kept).
 class UndoStack {
 public:
     void push(std::unique_ptr<UndoCommand> cmd);
@@ -31,9 +38,66 @@ public:
     bool canUndo() const;
     bool canRedo() const;
     void clear();
+
+    // Commands pushed within this many seconds of the previous one are offered to it
+    // through mergeWith() (0 = never merge)
+    void setMergeWindow(double seconds) { mergeWindow = seconds; }
+    double getMergeWindow() const { return mergeWindow; }
+    // Start a new entry with the next push even inside the merge window
+    void breakMerge() { mergeBlocked = true; }
+
+    // 0 = unlimited
+    void setMaxCommands(size_t count) { maxCommands = count; evict(); }
+    void setMaxBytes(size_t bytes) { maxBytes = bytes; evict(); }
+    size_t getMaxCommands() const { return maxCommands; }
+    size_t getMaxBytes() const { return maxBytes; }
+    size_t getCommandCount() const { return commands.size(); }
+    size_t getMemoryBytes() const { return totalBytes; }
 private:
-    std::vector<std::unique_ptr<UndoCommand>> commands;
+    struct Entry {
+        std::unique_ptr<UndoCommand> cmd;
+        size_t bytes = 0;   // memoryBytes() at push time
+    };
+    void evict();
+
+    std::vector<Entry> commands;
     int index = -1; // points to last executed command
+    size_t totalBytes = 0;
+    size_t maxCommands = 1000;
+    size_t maxBytes = size_t(256) << 20;
+    double mergeWindow = 1.0;
+    double lastPushTime = 0.0;
+    bool mergeBlocked = true;
+};
+
+// Old/new values of only the transform parts that changed, packed into one float
+// pool: a move stores 6 floats per element instead of two full Transforms.
+class TransformDeltas {
+public:
+    void add(const std::string& elemId, const Transform& oldT, const Transform& newT);
+    // Write the old (undo) or new (redo) values back to the scene's elements
+    void apply(Scene& scene, bool useNew) const;
+    bool empty() const { return entries.empty(); }
+    size_t heapBytes() const;
+    // Same elements in the same order
+    bool sameIds(const TransformDeltas& other) const;
+    // Combine with the deltas of a later command on the same ids: old values from this,
+    // new values from 'later' (parts it did not change keep this command's new values)
+    void merge(const TransformDeltas& later);
+private:
+    enum : uint8_t { kPosition = 1, kRotation = 2, kScale = 4 };
+    struct Entry {
+        std::string elementId;
+        uint32_t offset = 0;    // first float in 'values'
+        uint8_t parts = 0;      // changed parts, each stored as old then new
+        mutable SceneHandle handle;   // cached slot, re-resolved by id once stale
+    };
+    static int partFloats(uint8_t part) { return part == kRotation ? 4 : 3; }
+    Element* resolve(Scene& scene, const Entry& entry) const;
+    // Old values of one part of an entry (new values follow), or nullptr if unchanged
+    const float* partValues(const Entry& entry, uint8_t part) const;
+    std::vector<Entry> entries;
+    std::vector<float> values;
 };
 
 // --- Concrete commands ---
@@ -44,6 +108,7 @@ public:
     AddElementCmd(const Element& elem);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Element> snapshot;
     std::string elementId;
@@ -55,6 +120,7 @@ public:
     RemoveElementCmd(const Element& elem);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Element> snapshot;
     std::string elementId;
@@ -66,10 +132,10 @@ public:
     TransformElementCmd(const std::string& elemId, const Transform& oldT, const Transform& newT);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
+    bool mergeWith(const UndoCommand& next) override;
 private:
-    std::string elementId;
-    Transform oldTransform;
-    Transform newTransform;
+    TransformDeltas deltas;
 };
 
 // Add beam (undo = remove, redo = re-add)
@@ -78,6 +144,7 @@ public:
     AddBeamCmd(const Beam& beam);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Beam> snapshot;
     std::string beamId;
@@ -89,6 +156,7 @@ public:
     RemoveBeamCmd(const Beam& beam);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Beam> snapshot;
     std::string beamId;
@@ -100,6 +168,7 @@ public:
     AddAnnotationCmd(const Annotation& ann);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Annotation> snapshot;
     std::string annotationId;
@@ -111,6 +180,7 @@ public:
     RemoveAnnotationCmd(const Annotation& ann);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Annotation> snapshot;
     std::string annotationId;
@@ -122,6 +192,7 @@ public:
     MoveAnnotationCmd(const std::string& annId, const glm::vec3& oldPos, const glm::vec3& newPos);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::string annotationId;
     glm::vec3 oldPosition;
@@ -134,10 +205,26 @@ public:
     void addCommand(std::unique_ptr<UndoCommand> cmd);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::vector<std::unique_ptr<UndoCommand>> cmds;
 };
 
+// Bulk insert (paste): undo removes every object in one Scene::removeObjects pass and
+// redo re-adds them through the bulk Scene API, instead of one command per object
+class AddObjectsCmd : public UndoCommand {
+public:
+    AddObjectsCmd(const std::vector<Element*>& elements, const std::vector<Beam*>& beams,
+                  const std::vector<Annotation*>& annotations);
+    void undo(Scene& scene) override;
+    void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
+private:
+    std::vector<std::unique_ptr<Element>> elements;
+    std::vector<std::unique_ptr<Beam>> beams;
+    std::vector<std::unique_ptr<Annotation>> annotations;
+};
+
 // Multi-element transform (undo/redo all transforms at once)
 class MultiTransformCmd : public UndoCommand {
 public:
@@ -145,9 +232,35 @@ public:
                       std::vector<std::pair<std::string, Transform>> newTs);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
+    bool mergeWith(const UndoCommand& next) override;
+private:
+    TransformDeltas deltas;
+};
+
+// Batched property edit of many elements (Scene::endElementEdit), one undo step
+class EditElementsCmd : public UndoCommand {
+public:
+    explicit EditElementsCmd(std::vector<ElementEdit> edits);
+    void undo(Scene& scene) override;
+    void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
-    std::vector<std::pair<std::string, Transform>> oldTransforms;
-    std::vector<std::pair<std::string, Transform>> newTransforms;
+    std::vector<ElementEdit> edits;
+};
+
+// Array layout of one element (count, pitch, placed copies); drags merge into one step
+class EditArrayCmd : public UndoCommand {
+public:
+    EditArrayCmd(const std::string& elemId, ElementArray oldArray, ElementArray newArray);
+    void undo(Scene& scene) override;
+    void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
+    bool mergeWith(const UndoCommand& next) override;
+private:
+    std::string elementId;
+    ElementArray oldArray;
+    ElementArray newArray;
 };
 
 // Add measurement (undo = remove, redo = re-add)
@@ -156,6 +269,7 @@ public:
     AddMeasurementCmd(const Measurement& meas);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Measurement> snapshot;
     std::string measurementId;
@@ -167,6 +281,7 @@ public:
     RemoveMeasurementCmd(const Measurement& meas);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     std::unique_ptr<Measurement> snapshot;
     std::string measurementId;
@@ -178,6 +293,7 @@ public:
     CreateGroupCmd(const Group& group);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     Group snapshot;
 };
@@ -188,6 +304,7 @@ public:
     DissolveGroupCmd(const Group& group);
     void undo(Scene& scene) override;
     void redo(Scene& scene) override;
+    size_t memoryBytes() const override;
 private:
     Group snapshot;
 };